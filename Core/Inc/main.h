@@ -29,6 +29,8 @@ extern "C" {
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f7xx_hal.h"
 
+void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
+
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "vr_sensor_emulator.h"
@@ -41,7 +43,13 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
-
+/* NVIC preemption priorities (group 4, 0 is the most urgent) */
+#define VR_IRQ_PRIO_SAMPLE          0   // TIM6: DAC sample, top half only
+#define VR_IRQ_PRIO_EDGE_REFILL     1   // DMA1 Stream7: digital edge ring, half a ring of slack
+#define VR_IRQ_PRIO_DMA             5   // ECU capture rings, potentiometer, loopback capture
+#define VR_IRQ_PRIO_COMMS           6   // USART3 receive, TIM2 CH1 task release
+#define VR_IRQ_PRIO_TICK            14  // SysTick: HAL time base only
+#define VR_IRQ_PRIO_BOTTOM_HALF     15  // PendSV: sample bottom half
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
@@ -75,6 +83,12 @@ void Error_Handler(void);
 #define RPM_ADC_GPIO_Port GPIOA
 #define VR_OUTPUT_Pin GPIO_PIN_4
 #define VR_OUTPUT_GPIO_Port GPIOA
+#define VR_DIGITAL_Pin GPIO_PIN_3
+#define VR_DIGITAL_GPIO_Port GPIOA
+#define ECU_IGN_IN_Pin GPIO_PIN_3
+#define ECU_IGN_IN_GPIO_Port GPIOB
+#define ECU_INJ_IN_Pin GPIO_PIN_10
+#define ECU_INJ_IN_GPIO_Port GPIOB
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
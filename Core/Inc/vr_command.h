@@ -0,0 +1,48 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_command.h
+  * @brief          : Header for the USART3 command channel
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Text commands arrive one line at a time on USART3 (the ST-LINK virtual
+  * COM port). The receive interrupt assembles lines, and the main loop
+  * executes them and sends one reply line each.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_COMMAND_H
+#define __VR_COMMAND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_tooth_shape.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_COMMAND_LINE_MAX         160     // Longest command line, terminator included
+#define VR_COMMAND_REPLY_MAX        64      // Reply buffer the caller should provide
+
+/* Exported functions prototypes ---------------------------------------------*/
+bool VR_Command_RxByte(uint8_t byte);
+bool VR_Command_Poll(char *reply, uint32_t size);
+void VR_Command_Execute(char *line, char *reply, uint32_t size);
+uint32_t VR_Command_GetDropped(void);
+void VR_Command_SelectShape(const VR_ToothShape_t *shape);
+uint32_t VR_Command_GetScenario(const void **image);
+bool VR_Command_LoadScenario(const void *image, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_COMMAND_H */
@@ -0,0 +1,91 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_config.h
+  * @brief          : Header for the configuration store in flash
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * The runtime configuration is kept in flash sectors 10 and 11, which
+  * the linker script leaves out of the program region. Each save appends
+  * one CRC-checked record to the active sector; the newest valid record
+  * is restored at boot. Only when a sector is full is the other one
+  * erased and the record written there, so the two sectors share the
+  * erases between them.
+  *
+  * The store holds what can be changed at run time: the tooth waveform,
+  * the signal gain, the noise level and seed, the output fault, and the
+  * last scenario image uploaded. The wheel pattern is a compile-time constant. A record holds
+  * only the uploaded part of the scenario image, so saves without one
+  * stay small.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_CONFIG_H
+#define __VR_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_tooth_shape.h"
+#include "vr_scenario.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_CONFIG_SECTOR_SIZE       (256u * 1024u)
+#define VR_CONFIG_FIRST_SECTOR      FLASH_SECTOR_10     // Sectors 10 and 11, see STM32F767ZITx_FLASH.ld
+
+/* Address of flash sector 5 to 11 in single-bank mode: sectors 0-3 are
+   32 KB and sector 4 128 KB, so the 256 KB sectors start at 0x08040000 */
+#define VR_CONFIG_SECTOR_ADDRESS(sector) (0x08040000u + ((uint32_t)(sector) - 5u) * VR_CONFIG_SECTOR_SIZE)
+#define VR_CONFIG_BASE              VR_CONFIG_SECTOR_ADDRESS(VR_CONFIG_FIRST_SECTOR)    // 0x08180000
+
+#define VR_CONFIG_SHAPE             0x00000001u         // flags: shape holds the tooth waveform
+#define VR_CONFIG_GAIN              0x00000002u         // flags: amplitude holds the signal gain
+#define VR_CONFIG_NOISE             0x00000004u         // flags: noise_lsb and noise_seed hold the noise
+#define VR_CONFIG_SCENARIO          0x00000008u         // flags: scenario holds an uploaded image
+#define VR_CONFIG_FAULT             0x00000010u         // flags: fault holds the output fault
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t flags;                 // VR_CONFIG_*
+    VR_ToothShape_t shape;
+    uint16_t amplitude;             // VR_AMPLITUDE_FULL for the model as rendered
+    uint16_t noise_lsb;             // Peak noise in DAC codes, 0 for none
+    uint32_t noise_seed;
+    uint32_t fault;                 // VR_Fault_t; a word, so scenario stays word aligned
+    uint32_t scenario_length;       // Bytes of scenario uploaded
+    uint8_t scenario[VR_SCENARIO_IMAGE_SIZE(VR_SCENARIO_MAX_EVENTS)];  // Last, only scenario_length saved
+} VR_Config_t;
+
+typedef struct {
+    uint32_t sector;                // Active flash sector, 0 if none yet
+    uint32_t used;                  // Bytes written to the active sector
+    uint32_t records;               // Records in the active sector
+    uint32_t sequence;              // Number of the newest record
+    uint32_t erases[2];             // Erase count of sectors 10 and 11
+} VR_ConfigStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Config_Init(void);
+bool VR_Config_Load(VR_Config_t *config);
+bool VR_Config_Save(const VR_Config_t *config);
+bool VR_Config_Clear(void);
+void VR_Config_Capture(VR_Config_t *config);
+void VR_Config_Apply(const VR_Config_t *config);
+void VR_Config_GetStats(VR_ConfigStats_t *stats);
+uint32_t VR_Config_Crc32(const void *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_CONFIG_H */
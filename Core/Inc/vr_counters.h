@@ -0,0 +1,61 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_counters.h
+  * @brief          : Header for the output and activity counters
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Counts what the emulator has actually put out: samples, teeth and
+  * revolutions, with the speed measured from the TIM2 time of each
+  * revolution. Also collects the potentiometer conversions, parameter
+  * changes, injected faults and lost samples in one place. Each counter
+  * has a single writer, which only stores a word. VR_Counters_Snapshot()
+  * reads them all as one consistent set, without masking interrupts.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_COUNTERS_H
+#define __VR_COUNTERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t samples;               // Levels output by the DAC
+    uint32_t teeth;                 // Teeth output, missing tooth included
+    uint32_t revolutions;           // Times the output passed tooth 0
+    uint32_t revolution_ticks;      // TIM2 ticks of the last whole revolution, 0 if none
+    uint32_t rpm_milli;             // Speed from revolution_ticks in milli-RPM, 0 if stopped
+    uint32_t updates;               // Parameter changes the default emulator applied
+    uint32_t faults;                // Faults injected into the output
+    uint32_t overruns;              // TIM6 updates lost behind a long interrupt
+    uint32_t underruns;             // DAC DMA underruns
+    uint32_t adc;                   // Potentiometer conversions
+} VR_Counters_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Counters_Output(const VR_SensorState_t *state, uint32_t count, uint32_t samples);
+void VR_Counters_PhaseJump(void);
+void VR_Counters_AdcUpdate(void);
+void VR_Counters_Fault(void);
+void VR_Counters_Snapshot(VR_Counters_t *counters);
+uint32_t VR_Counters_FormatTelemetry(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_COUNTERS_H */
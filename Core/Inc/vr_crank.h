@@ -0,0 +1,92 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_crank.h
+  * @brief          : Header for the cranking and engine start model
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Drives an emulator through an engine start: the starter spins the
+  * engine up, each compression slows it and the expansion after it
+  * speeds it up again, then the engine catches, flares and settles to
+  * idle. The speed is set at the start of every tooth from the crank
+  * angle and the engine time, which advances by each tooth as rendered.
+  * The VR amplitude follows the speed, as a real sensor's does.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_CRANK_H
+#define __VR_CRANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_CRANK_MAX_CYLINDERS      12
+#define VR_CRANK_MIN_RPM            20      // Speed of the first tooth from rest
+#define VR_CRANK_FULL_AMPLITUDE_RPM 1000    // Speed at which the VR output reaches the model's amplitude
+#define VR_CRANK_SAMPLE_TICKS       5       // Longest sample period while cranking (50 us)
+#define VR_CRANK_SETTLE_SPANS       5       // Settle time constants before the speed is held at idle
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_CRANK_OFF = 0,
+    VR_CRANK_ENGAGE,                // Starter spinning the engine up
+    VR_CRANK_CRANKING,              // Starter speed, dipping at each compression
+    VR_CRANK_FLARE,                 // Caught: rising to the flare peak
+    VR_CRANK_SETTLE,                // Falling from the flare to idle
+    VR_CRANK_IDLE                   // Held at idle speed
+} VR_CrankPhase_t;
+
+typedef struct {
+    uint8_t cylinders;              // Four-stroke cylinders, 1 to VR_CRANK_MAX_CYLINDERS
+    uint8_t compression_percent;    // Speed dip at each compression, % of the mean speed
+    uint8_t crank_revs;             // Revolutions from rest before the engine catches, 0 never
+    uint16_t starter_rpm;           // Mean cranking speed with the starter up to speed
+    uint16_t engage_ms;             // Starter spin-up from rest to starter_rpm
+    uint16_t flare_rpm;             // Peak speed after the catch
+    uint16_t flare_ms;              // Catch to flare peak
+    uint16_t idle_rpm;              // Speed the flare settles to
+    uint16_t settle_ms;             // Time constant of the fall from flare to idle
+} VR_CrankConfig_t;
+
+typedef struct {
+    VR_CrankConfig_t config;
+    uint8_t phase;                  // VR_CrankPhase_t
+    uint16_t rpm;                   // Speed of the current tooth
+    uint32_t time_us;               // Engine time at the start of the current tooth
+    uint32_t phase_us;              // Engine time the phase began
+    uint32_t revolutions;           // Revolutions since the start
+    uint32_t teeth;                 // Teeth since the start
+} VR_Crank_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Crank_DefaultConfig(VR_CrankConfig_t *config);
+bool VR_Crank_IsValid(const VR_CrankConfig_t *config);
+bool VR_Crank_Start(VR_Crank_t *crank, VR_Emulator_t *emu, const VR_CrankConfig_t *config);
+void VR_Crank_Stop(VR_Crank_t *crank, VR_Emulator_t *emu);
+void VR_Crank_Tooth(VR_Emulator_t *emu, void *ctx);
+const char *VR_Crank_PhaseName(uint8_t phase);
+
+/* Default emulator */
+bool VR_Crank_Begin(const VR_CrankConfig_t *config);
+void VR_Crank_End(void);
+bool VR_Crank_IsRunning(void);
+const VR_Crank_t *VR_Crank_GetDefault(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_CRANK_H */
@@ -0,0 +1,79 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_cycles.h
+  * @brief          : Header for cycle-count profiling
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Each probe times one piece of code with the DWT cycle counter, which
+  * counts core clocks at 216 MHz. An interrupt records its own probe; the
+  * main loop reads a consistent snapshot without masking interrupts.
+  * The boot marks time the start-up stages from VR_Cycles_Init() to the
+  * first sample.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_CYCLES_H
+#define __VR_CYCLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_CYCLES_SAMPLE_ISR = 0,       // TIM6 interrupt handler, entry to exit
+    VR_CYCLES_CONTROL,              // Main loop: potentiometer update and capture processing
+    VR_CYCLES_BOTTOM_HALF,          // PendSV: sample bottom half
+    VR_CYCLES_PROBES
+} VR_CycleProbe_t;
+
+typedef enum {
+    VR_BOOT_HAL = 0,                // HAL_Init()
+    VR_BOOT_CLOCK,                  // SystemClock_Config(): PLL lock and switch to 216 MHz
+    VR_BOOT_PERIPH,                 // MX_*_Init()
+    VR_BOOT_CONFIG,                 // Configuration restored from flash
+    VR_BOOT_OUTPUT,                 // DAC and TIM6 started: the sample output runs
+    VR_BOOT_STAGES
+} VR_BootStage_t;
+
+typedef struct {
+    uint32_t count;                 // Runs recorded
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} VR_CycleStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Cycles_Init(void);
+void VR_Cycles_Record(VR_CycleProbe_t probe, uint32_t start);
+void VR_Cycles_Snapshot(VR_CycleProbe_t probe, VR_CycleStats_t *stats, bool reset);
+uint32_t VR_Cycles_FormatTelemetry(char *buffer, uint32_t size);
+void VR_Cycles_BootMark(VR_BootStage_t stage);
+uint32_t VR_Cycles_BootTime(VR_BootStage_t stage);
+uint32_t VR_Cycles_FormatBoot(char *buffer, uint32_t size);
+
+/**
+  * @brief  Current cycle count, the start argument of VR_Cycles_Record()
+  * @retval DWT cycle counter
+  */
+static inline uint32_t VR_Cycles_Now(void)
+{
+    return DWT->CYCCNT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_CYCLES_H */
@@ -0,0 +1,71 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_digital_output.h
+  * @brief          : Header for the Hall/optical digital crank output
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * TIM2 channel 4 (PA3) toggles on output compare at every tooth edge. DMA1
+  * Stream7 reloads the compare register from a ring of edge times, so edges
+  * cost no CPU time and land on the 108 MHz TIM2 clock. Edge times come
+  * from the same tooth phase as the analog VR output.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_DIGITAL_OUTPUT_H
+#define __VR_DIGITAL_OUTPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_DIGITAL_TIMER_CLOCK      108000000   // TIM2 kernel clock (APB1 x2), prescaler 0
+#define VR_DIGITAL_TICKS_PER_US     (VR_DIGITAL_TIMER_CLOCK / 1000000)
+#define VR_DIGITAL_EDGE_BUFFER      16          // Compare values in the DMA ring, refilled by halves
+#define VR_DIGITAL_MIN_LEAD_TICKS   108         // Earliest edge after a resync (1 us)
+#define VR_DIGITAL_SAMPLE_LATENCY_TICKS 27      // TIM6 update to the TIM2 read in the sample top half
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Position in the edge sequence: the output is high from each tooth start
+   for the tooth's width, low for its gap */
+typedef struct {
+    uint32_t tooth_start;           // TIM2 count at which the current tooth starts
+    uint32_t period;                // Tooth period in TIM2 ticks
+    uint32_t period_us;             // Emulator tooth period the schedule follows
+    uint8_t tooth;                  // Tooth the next edge belongs to
+    uint8_t rising;                 // Next edge starts the tooth (1) or ends it (0)
+} VR_EdgePlanner_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Digital_Start(void);
+void VR_Digital_Stop(void);
+bool VR_Digital_IsRunning(void);
+uint32_t VR_Digital_GetResyncs(void);
+void VR_Digital_SampleCallback(const VR_SensorState_t *state, uint32_t sample_count);
+void VR_Digital_PhaseJump(void);
+void VR_Digital_TransferHalfCallback(void);
+void VR_Digital_TransferCompleteCallback(void);
+
+/* Edge planning, shared with the host tests */
+void VR_Edge_Anchor(VR_EdgePlanner_t *planner, const VR_SensorState_t *state,
+                    uint32_t sample_count, uint32_t after);
+uint32_t VR_Edge_Next(VR_EdgePlanner_t *planner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_DIGITAL_OUTPUT_H */
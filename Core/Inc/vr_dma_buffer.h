@@ -0,0 +1,70 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_dma_buffer.h
+  * @brief          : Header for cache set-up and DMA buffer placement
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * With the data cache on, the CPU and the DMA controllers no longer see
+  * the same memory. A buffer that DMA reads or writes is either:
+  * - VR_DMA_BUFFER: placed in SRAM2, which the MPU maps as non-cacheable.
+  *   Nothing else to do. Used for the small rings that the CPU and DMA
+  *   share continuously (digital edges, ECU captures).
+  * - VR_DMA_CACHED_BUFFER: cacheable, aligned to whole cache lines. The
+  *   owner calls VR_DMA_Clean() before DMA reads it and VR_DMA_Invalidate()
+  *   before the CPU reads what DMA wrote. Used for large buffers that the
+  *   CPU processes in bulk (loopback capture).
+  *
+  * Build with CACHE=0 to leave both caches off for comparison.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_DMA_BUFFER_H
+#define __VR_DMA_BUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#ifndef VR_CACHE_ENABLE
+#define VR_CACHE_ENABLE             1
+#endif
+
+#define VR_DMA_CACHE_LINE           32u                 // Cortex-M7 data cache line, bytes
+#define VR_DMA_REGION_BASE          0x2007C000u         // SRAM2, see STM32F767ZITx_FLASH.ld
+#define VR_DMA_REGION_SIZE          (16u * 1024u)
+
+/* Exported macro ------------------------------------------------------------*/
+/* Buffers shared with DMA; the .dma_buffer section is laid out by STM32F767ZITx_FLASH.ld */
+#if !defined(VR_HOST_SIM)
+#define VR_DMA_BUFFER               __attribute__((section(".dma_buffer"), aligned(VR_DMA_CACHE_LINE)))
+#else
+#define VR_DMA_BUFFER               __attribute__((aligned(VR_DMA_CACHE_LINE)))
+#endif
+#define VR_DMA_CACHED_BUFFER        __attribute__((aligned(VR_DMA_CACHE_LINE)))
+
+/* Size of a VR_DMA_CACHED_BUFFER rounded up to whole cache lines */
+#define VR_DMA_LINES(bytes)         (((bytes) + VR_DMA_CACHE_LINE - 1u) & ~(VR_DMA_CACHE_LINE - 1u))
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_DMA_Init(void);
+bool VR_DMA_IsNonCacheable(const void *buffer, uint32_t size);
+void VR_DMA_Clean(const void *buffer, uint32_t size);
+bool VR_DMA_Invalidate(void *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_DMA_BUFFER_H */
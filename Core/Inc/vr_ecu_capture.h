@@ -0,0 +1,96 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_ecu_capture.h
+  * @brief          : Header for ECU ignition/injection timing capture
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * TIM2 channels 2 (PB3, ignition) and 3 (PB10, injection) capture ECU
+  * output edges on the 108 MHz TIM2 clock. DMA writes every capture into a
+  * ring, and the main loop converts them to crank angle with the emulator's
+  * own tooth phase at that instant, giving per-cylinder advance statistics.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_ECU_CAPTURE_H
+#define __VR_ECU_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_CAPTURE_RING             64      // Captures per channel DMA ring
+#define VR_CAPTURE_ANCHORS          16      // Phase history kept for captures not yet processed
+#define VR_CAPTURE_MAX_CYLINDERS    8
+#define VR_CAPTURE_CYCLE_DEG        720.0f  // Four-stroke cycle, two wheel revolutions
+#define VR_CAPTURE_MAX_RETARD_DEG   30.0f   // Latest event still counted for a cylinder, after its TDC
+#define VR_CAPTURE_DEFAULT_CYLINDERS 4
+#define VR_CAPTURE_DEFAULT_TDC_DEG  0.0f    // Cylinder 1 TDC at the start of tooth 0
+#define VR_CAPTURE_TELEMETRY_MS     1000    // Telemetry line period in the main loop
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_CAPTURE_IGNITION = 0,        // TIM2 CH2, falling edge: end of dwell
+    VR_CAPTURE_INJECTION,           // TIM2 CH3, rising edge: start of injection
+    VR_CAPTURE_CHANNELS
+} VR_CaptureChannel_t;
+
+/* Emulator phase from a TIM6 sample onwards, until the tooth period changes */
+typedef struct {
+    uint32_t sample_count;          // TIM2 count of the sample the anchor was taken at
+    uint32_t tooth_start;           // TIM2 count at which cycle_tooth started
+    uint32_t period;                // Tooth period in TIM2 ticks, 0 when stopped
+    uint8_t cycle_tooth;            // Tooth within the cycle, 0 to 2 * TRIGGER_WHEEL_TEETH - 1
+} VR_PhaseAnchor_t;
+
+/* Advance before TDC in degrees; negative values are after TDC */
+typedef struct {
+    uint32_t count;
+    float last_deg;
+    float min_deg;
+    float max_deg;
+    float mean_deg;
+    float m2;                       // Sum of squared deviations from the mean
+} VR_AdvanceStats_t;
+
+typedef struct {
+    uint32_t captures;              // Edges converted to an angle
+    uint32_t overruns;              // Edges overwritten in the ring before processing
+    uint32_t unsynced;              // Edges with no phase: wheel stopped or history too old
+} VR_CaptureStatus_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Capture_Start(void);
+void VR_Capture_Stop(void);
+void VR_Capture_Configure(uint8_t cylinders, float tdc_deg);
+void VR_Capture_Reset(void);
+void VR_Capture_SampleCallback(const VR_SensorState_t *state, uint32_t sample_count);
+void VR_Capture_PhaseJump(void);
+void VR_Capture_TransferCompleteCallback(VR_CaptureChannel_t channel);
+void VR_Capture_Process(void);
+bool VR_Capture_GetStats(VR_CaptureChannel_t channel, uint8_t cylinder, VR_AdvanceStats_t *stats);
+void VR_Capture_GetStatus(VR_CaptureChannel_t channel, VR_CaptureStatus_t *status);
+float VR_Capture_StdDev(const VR_AdvanceStats_t *stats);
+uint32_t VR_Capture_FormatTelemetry(char *buffer, uint32_t size);
+
+/* Angle conversion, shared with the host tests */
+float VR_Capture_AngleAt(const VR_PhaseAnchor_t *anchor, uint32_t count);
+uint8_t VR_Capture_Assign(float angle, uint8_t cylinders, float tdc_deg, float *advance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_ECU_CAPTURE_H */
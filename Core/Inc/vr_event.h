@@ -0,0 +1,56 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_event.h
+  * @brief          : Header for main loop events and CPU load accounting
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Interrupts post event bits; the main loop takes them all at once and
+  * sleeps in WFI while none are pending. The cycles spent asleep are
+  * counted, so the load figure is the share of time the core was awake,
+  * interrupts included.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_EVENT_H
+#define __VR_EVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_EVENT_TICK               (1u << 0)   // TIM2 channel 1: a task release is due
+#define VR_EVENT_POT                (1u << 1)   // Potentiometer conversion moved by DMA
+#define VR_EVENT_COMMAND            (1u << 2)   // USART3 command line complete
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t elapsed;               // Cycles in the window
+    uint32_t idle;                  // Cycles asleep in WFI
+    uint32_t wakeups;               // WFI exits
+    uint32_t passes;                // Wait calls that returned events
+} VR_Load_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Event_Init(void);
+void VR_Event_Post(uint32_t events);
+uint32_t VR_Event_Wait(void);
+void VR_Event_GetLoad(VR_Load_t *load, bool reset);
+uint32_t VR_Event_FormatLoad(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_EVENT_H */
@@ -0,0 +1,36 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_format.h
+  * @brief          : Header for the telemetry text formatting helper
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * The telemetry and report functions fill a caller's buffer and return
+  * the length written. VR_Format_Append() adds one printf-formatted piece
+  * and keeps that length true however short the buffer is.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_FORMAT_H
+#define __VR_FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported functions prototypes ---------------------------------------------*/
+uint32_t VR_Format_Append(char *buffer, uint32_t size, uint32_t len, const char *fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_FORMAT_H */
@@ -0,0 +1,51 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_loopback.h
+  * @brief          : Header for the DAC->ADC loopback capture
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * ADC2 samples the DAC output pin (PA4, ADC2_IN4) on TIM8 TRGO and DMA2
+  * Stream2 moves the samples, so capture costs the CPU one interrupt at
+  * the end and never touches the TIM6 render path.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_LOOPBACK_H
+#define __VR_LOOPBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_LOOPBACK_BUFFER_SIZE     8192        // Samples per capture
+#define VR_LOOPBACK_TIMER_CLOCK     216000000   // TIM8 kernel clock (APB2 x2)
+#define VR_LOOPBACK_MIN_RATE        4000        // Hz, 16-bit TIM8 period limit
+#define VR_LOOPBACK_MAX_RATE        1000000     // Hz, ADC2 at 15+12 cycles
+#define VR_LOOPBACK_REVOLUTIONS     2.5f        // Revolutions per capture
+
+/* Exported functions prototypes ---------------------------------------------*/
+uint32_t VR_Loopback_RateForRPM(uint16_t rpm);
+HAL_StatusTypeDef VR_Loopback_Start(uint32_t sample_rate_hz);
+void VR_Loopback_Stop(void);
+bool VR_Loopback_IsComplete(void);
+uint32_t VR_Loopback_GetSampleRate(void);
+const uint16_t *VR_Loopback_GetSamples(uint32_t *count);
+void VR_Loopback_CaptureCompleteCallback(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_LOOPBACK_H */
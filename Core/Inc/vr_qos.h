@@ -0,0 +1,71 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_qos.h
+  * @brief          : Header for the overload detection and render quality steps
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * The sample interrupt and the DAC report every sample they could not
+  * deliver on time: a TIM6 update still pending when the interrupt ends,
+  * a DAC DMA underrun, or a bottom half that fell a sample behind. They
+  * also report how much of the sample period the interrupt used. Once per
+  * control period VR_QoS_Update() lowers the default emulator's render
+  * quality one step if samples were lost or the interrupt ran long, and
+  * raises it again after a quiet spell with headroom to spare. Tooth
+  * timing is the same at every step, and every step is counted.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_QOS_H
+#define __VR_QOS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_QOS_BUSY_PERCENT         50      // Interrupt time, % of the sample period, that counts as busy
+#define VR_QOS_BUSY_LIMIT           8       // Busy samples in one update that step the quality down
+#define VR_QOS_RECOVER_UPDATES      2000    // Quiet updates before a step back up (2 s at 1 kHz)
+#define VR_QOS_RECOVER_PERCENT      20      // Peak interrupt time that leaves room for a step up
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint8_t level;                  // VR_Quality_t in use
+    uint8_t floor;                  // Best quality allowed, set by the QOS command
+    uint8_t worst;                  // Lowest quality used since power-up
+    uint8_t peak_percent;           // Longest sample interrupt since the last update, % of the period
+    uint32_t overruns;              // TIM6 updates lost behind a long interrupt
+    uint32_t underruns;             // DAC DMA underruns
+    uint32_t merged;                // Samples the bottom half fell behind on
+    uint32_t busy;                  // Sample interrupts over VR_QOS_BUSY_PERCENT
+    uint32_t steps_down;
+    uint32_t steps_up;
+    uint32_t saturated;             // Updates still overloaded at the lowest quality
+} VR_QosStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_QoS_Init(void);
+void VR_QoS_SampleDone(uint32_t cycles, bool overrun);
+void VR_QoS_DacUnderrun(void);
+void VR_QoS_Update(void);
+void VR_QoS_SetFloor(VR_Quality_t floor);
+void VR_QoS_GetStats(VR_QosStats_t *stats);
+uint32_t VR_QoS_FormatTelemetry(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_QOS_H */
@@ -0,0 +1,66 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_revolution.h
+  * @brief          : Header for the precomputed revolution output mode
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * At a steady RPM the analog output repeats every wheel revolution. In
+  * revolution mode the main loop renders one revolution into RAM, and
+  * TIM6 triggers the DAC, which DMA1 Stream5 reloads from that buffer in
+  * circular mode. The CPU takes only the half and full transfer
+  * interrupts, two per revolution, instead of one interrupt per sample.
+  *
+  * When the RPM or the tooth waveform changes, the next revolution is
+  * rendered into the second buffer and swapped in at the end of the one
+  * playing, with the TIM6 period that goes with it.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_REVOLUTION_H
+#define __VR_REVOLUTION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_REV_MAX_SAMPLES          6528    // Longest revolution is 6480 samples, at 926 RPM
+#define VR_REV_STOP_SAMPLES         1024    // DC level played while stopped
+#define VR_REV_RENDER_CHUNK         256     // Samples rendered per VR_Rev_Update() call
+#define VR_REV_DMA_LATENCY_TICKS    40      // TIM6 update to the TIM2 read in the transfer callback
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t length;                // Samples in the revolution playing, 0 if none
+    uint32_t tooth_period_us;       // Tooth period of that revolution
+    uint32_t revolutions;           // Revolutions played
+    uint32_t renders;               // Revolutions rendered
+    uint32_t swaps;                 // Buffers swapped in at a revolution end
+} VR_RevStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Rev_Start(void);
+void VR_Rev_Stop(void);
+bool VR_Rev_IsEnabled(void);
+bool VR_Rev_Update(void);
+void VR_Rev_TransferCallback(bool complete);
+void VR_Rev_GetStats(VR_RevStats_t *stats);
+uint32_t VR_Rev_FormatTelemetry(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_REVOLUTION_H */
@@ -0,0 +1,63 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_sample.h
+  * @brief          : Header for the TIM6 sample interrupt and its bottom half
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Each TIM6 update is split in two. The top half runs in the TIM6
+  * interrupt and does only what must happen at the sample: it renders
+  * and writes the DAC level, and records the TIM2 count and emulator
+  * state of the sample. The bottom half runs in PendSV, the lowest
+  * priority, and does the rest from that record: the digital output and
+  * ECU capture follow the new phase, adopting any RPM change. In
+  * revolution mode (vr_revolution.h) there is no TIM6 interrupt, and the
+  * DAC DMA interrupts record the samples for the bottom half instead.
+  *
+  * Build with FASTISR=0 to run both halves inside the TIM6 interrupt,
+  * dispatched through HAL_TIM_IRQHandler(), for comparison.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_SAMPLE_H
+#define __VR_SAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#ifndef VR_FAST_SAMPLE_ISR
+#define VR_FAST_SAMPLE_ISR          1
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t samples;               // Top halves run
+    uint32_t runs;                  // Bottom halves that found a new sample
+    uint32_t merged;                // Samples superseded before their bottom half ran
+} VR_SampleStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Sample_TopHalf(void);
+void VR_Sample_Publish(const VR_SensorState_t *state, uint32_t count);
+void VR_Sample_BottomHalf(void);
+void VR_Sample_GetStats(VR_SampleStats_t *stats);
+uint32_t VR_Sample_FormatTelemetry(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_SAMPLE_H */
@@ -0,0 +1,108 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_scenario.h
+  * @brief          : Header for the scenario sequencer
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Plays a test scenario: speed set points, ramps, waveform switches,
+  * fault windows, gain and noise changes on one timeline. A scenario is
+  * compiled on the host into an image of events sorted by time, so a
+  * new test case is data to upload rather than a firmware build.
+  *
+  * Image layout, little-endian as on both host and target:
+  *   VR_ScenarioHeader_t, then header.count VR_ScenarioEvent_t
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_SCENARIO_H
+#define __VR_SCENARIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_SCENARIO_MAGIC           0x4E435356u     // "VSCN"
+#define VR_SCENARIO_VERSION         1
+#define VR_SCENARIO_MAX_EVENTS      1024
+#define VR_SCENARIO_RAMP_STEP_TICKS 100     // Speed update interval on a ramp (1 ms)
+#define VR_SCENARIO_MAX_SHAPES      8       // Tables a SHAPE event can select
+#define VR_SCENARIO_IMAGE_SIZE(count) (sizeof(VR_ScenarioHeader_t) + (count) * sizeof(VR_ScenarioEvent_t))
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_SCENARIO_SPEED = 0,          // value: signed RPM
+    VR_SCENARIO_RAMP,               // value: signed RPM reached span ticks later, linearly
+    VR_SCENARIO_SHAPE,              // arg: table 1 to VR_SCENARIO_MAX_SHAPES, 0 for the built-in model
+    VR_SCENARIO_FAULT,              // arg: VR_Fault_t, VR_FAULT_NONE ends the window
+    VR_SCENARIO_GAIN,               // value: amplitude, VR_AMPLITUDE_FULL for the model as rendered
+    VR_SCENARIO_NOISE,              // value: peak LSB, 0 for none; span: seed, 0 to continue
+    VR_SCENARIO_KINDS
+} VR_ScenarioKind_t;
+
+typedef struct {
+    uint32_t magic;                 // VR_SCENARIO_MAGIC
+    uint16_t version;               // VR_SCENARIO_VERSION
+    uint16_t count;                 // Events that follow
+    uint32_t duration;              // Ticks from the start to the end of the run
+} VR_ScenarioHeader_t;
+
+typedef struct {
+    uint32_t tick;                  // TIM6 ticks (10 us) from the start
+    uint32_t span;                  // See VR_ScenarioKind_t
+    int16_t value;                  // See VR_ScenarioKind_t
+    uint8_t kind;                   // VR_ScenarioKind_t
+    uint8_t arg;                    // See VR_ScenarioKind_t
+} VR_ScenarioEvent_t;
+
+typedef struct {
+    const VR_ScenarioEvent_t *events;
+    uint32_t count;
+    uint32_t duration;              // From the header
+    const VR_ToothShape_t *shapes[VR_SCENARIO_MAX_SHAPES];
+    uint32_t next;                  // Index of the next event
+    uint32_t tick;                  // Ticks from the start at the last update
+    uint32_t due;                   // Tick of the next event or ramp step, whichever is first
+    bool running;
+    bool ramping;
+    int32_t ramp_from;              // Signed RPM at the ramp start
+    int32_t ramp_to;
+    uint32_t ramp_start;
+    uint32_t ramp_span;
+    uint32_t ramp_next;             // Tick of the next ramp step
+    uint32_t applied;               // Events applied since the start
+    uint32_t faults;                // Fault windows opened since the start
+} VR_Scenario_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+bool VR_Scenario_Load(VR_Scenario_t *scn, const void *image, uint32_t size,
+                      const VR_ToothShape_t *const *shapes, uint32_t num_shapes);
+void VR_Scenario_Start(VR_Scenario_t *scn, VR_Emulator_t *emu);
+void VR_Scenario_Sample(VR_Scenario_t *scn, VR_Emulator_t *emu);
+void VR_Scenario_Stop(VR_Scenario_t *scn, VR_Emulator_t *emu);
+bool VR_Scenario_IsDone(const VR_Scenario_t *scn);
+
+/* Default emulator */
+bool VR_Scenario_Begin(const void *image, uint32_t size, const VR_ToothShape_t *shape);
+void VR_Scenario_End(void);
+bool VR_Scenario_IsRunning(void);
+void VR_Scenario_Service(void);
+const VR_Scenario_t *VR_Scenario_GetDefault(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_SCENARIO_H */
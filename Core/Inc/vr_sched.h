@@ -0,0 +1,80 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_sched.h
+  * @brief          : Header for the cooperative background task scheduler
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * Background work runs as tasks from the main loop, timed by the TIM2
+  * count (108 MHz). A periodic task is released every period; a one-shot
+  * task is released when triggered. Of the released tasks, the one with
+  * the highest priority (lowest number) runs first, and among equals the
+  * one with the earliest deadline. Tasks run to completion, so a task
+  * must return well within the shortest deadline of the others.
+  *
+  * The task table is static (VR_SCHED_MAX_TASKS entries).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_SCHED_H
+#define __VR_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_digital_output.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_SCHED_MAX_TASKS          8
+#define VR_SCHED_TICKS_PER_US       VR_DIGITAL_TICKS_PER_US     // TIM2 timebase
+#define VR_SCHED_MAX_PERIOD_US      10000000u   // Keeps every release within half the TIM2 wrap
+#define VR_SCHED_NO_TASK            0xFFu
+
+/* Exported types ------------------------------------------------------------*/
+typedef uint8_t VR_TaskId_t;
+
+/**
+  * @brief  Task body
+  * @param  ctx: Context given when the task was added
+  * @retval None
+  */
+typedef void (*VR_TaskFunc_t)(void *ctx);
+
+typedef struct {
+    uint32_t runs;
+    uint32_t run_min;               // Run time, TIM2 ticks
+    uint32_t run_max;
+    uint64_t run_total;
+    uint32_t late_max;              // Release to start, TIM2 ticks
+    uint32_t misses;                // Runs that finished after their deadline
+    uint32_t skips;                 // Periodic releases merged into a later one
+} VR_TaskStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Sched_Init(void);
+VR_TaskId_t VR_Sched_AddPeriodic(const char *name, VR_TaskFunc_t func, void *ctx, uint8_t priority,
+                                 uint32_t period_us, uint32_t deadline_us);
+VR_TaskId_t VR_Sched_AddOneShot(const char *name, VR_TaskFunc_t func, void *ctx, uint8_t priority,
+                                uint32_t deadline_us);
+bool VR_Sched_Trigger(VR_TaskId_t id, uint32_t delay_us);
+void VR_Sched_Cancel(VR_TaskId_t id);
+uint32_t VR_Sched_RunReady(void);
+bool VR_Sched_NextRelease(uint32_t *count);
+bool VR_Sched_GetStats(VR_TaskId_t id, VR_TaskStats_t *stats, bool reset);
+uint32_t VR_Sched_FormatTelemetry(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_SCHED_H */
@@ -24,6 +24,7 @@ extern "C" {
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "stm32f7xx_hal.h"
+#include "vr_tooth_shape.h"
 #include <math.h>
 
 /* Exported types ------------------------------------------------------------*/
@@ -35,8 +36,58 @@ typedef struct {
     uint32_t tooth_timer;
     float sine_phase;
     uint16_t dac_output;
+    uint32_t sample_period_us;  // Time between TIM6 update events
+    bool reverse;               // Wheel turning backwards: teeth count down, level mirrored about DC
 } VR_SensorState_t;
 
+/* Peripherals driven by one emulator instance; NULL leaves that side virtual */
+typedef struct {
+    DAC_HandleTypeDef *hdac;    // Output DAC, NULL keeps the level in state only
+    uint32_t dac_channel;       // DAC_CHANNEL_1 or DAC_CHANNEL_2
+    TIM_HandleTypeDef *htim;    // Sample timer, NULL for a virtual timer
+    ADC_HandleTypeDef *hadc;    // RPM potentiometer, NULL if set via SetRPM only
+} VR_EmulatorBinding_t;
+
+/* Render quality, highest first; each level keeps the savings of the ones above */
+typedef enum {
+    VR_QUALITY_FULL = 0,            // Fundamental, 2nd and 3rd harmonics
+    VR_QUALITY_NO_NOISE,            // Added noise off; faults still apply
+    VR_QUALITY_NO_H3,               // 3rd harmonic dropped
+    VR_QUALITY_SINE,                // Fundamental only
+    VR_QUALITY_HALF_RATE,           // Half the samples per tooth
+    VR_QUALITY_LEVELS
+} VR_Quality_t;
+
+/* Output faults, applied to the level after it is rendered */
+typedef enum {
+    VR_FAULT_NONE = 0,
+    VR_FAULT_DROPOUT,               // Held at the DC level, as with an open sensor circuit
+    VR_FAULT_SPIKE,                 // Held at full scale
+    VR_FAULT_COUNT
+} VR_Fault_t;
+
+typedef struct VR_Emulator VR_Emulator_t;
+
+/* Called from the sample update that enters a new tooth, before its first level */
+typedef void (*VR_ToothHook_t)(VR_Emulator_t *emu, void *ctx);
+
+/* One emulated sensor: its signal state plus its output binding */
+struct VR_Emulator {
+    VR_SensorState_t state;
+    VR_EmulatorBinding_t binding;
+    const VR_ToothShape_t *shape;   // Tooth waveform table, NULL for the built-in harmonic model
+    uint8_t quality;                // VR_Quality_t; tooth timing is the same at every level
+    uint32_t updates;               // RPM, waveform and quality changes applied since VR_Emu_Init()
+    VR_ToothHook_t tooth_hook;      // Sets the speed tooth by tooth, NULL for none
+    void *tooth_ctx;                // Passed to tooth_hook
+    uint16_t amplitude;             // Tooth signal gain, VR_AMPLITUDE_FULL for the model as rendered
+    uint16_t sample_ticks_max;      // Longest sample period in TIM6 ticks, 0 for the RPM-based period
+    uint8_t fault;                  // VR_Fault_t overriding the rendered level
+    uint16_t noise_lsb;             // Peak additive noise in DAC codes, 0 for none
+    uint32_t noise_rng;             // xorshift32 state of the noise, never 0
+    uint32_t noise_seed;            // Seed the noise last started from
+};
+
 /* Exported constants --------------------------------------------------------*/
 #define TRIGGER_WHEEL_TEETH         18
 #define REGULAR_TOOTH_COUNT         17
@@ -55,10 +106,19 @@ typedef struct {
 #define DAC_RESOLUTION              4096    // 12-bit DAC
 #define DAC_MAX_VOLTAGE             3.3f    // Volts
 
+/* Sample timer (TIM6) characteristics */
+#define VR_SAMPLE_TIMER_BASE_FREQ   100000  // TIM6 tick rate after prescaler (Hz)
+#define VR_SAMPLE_TICK_US           (1000000 / VR_SAMPLE_TIMER_BASE_FREQ)
+#define VR_DEFAULT_SAMPLE_TICKS     1000    // Update period of an unbound instance until SetRPM
+
 /* VR sensor signal characteristics */
 #define VR_AMPLITUDE_SCALE          0.8f    // Scale factor for sine wave amplitude
 #define VR_DISTORTION_FACTOR        0.15f   // Distortion amount
 #define VR_DC_OFFSET                0.4f    // DC offset as fraction of full scale
+#define VR_DC_LEVEL                 ((uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET))     // DAC code at rest
+#define VR_AMPLITUDE_FULL           4096    // Gain of 1 in VR_Emulator_t.amplitude
+#define VR_NOISE_MAX_LSB            2047    // Largest peak noise
+#define VR_NOISE_DEFAULT_SEED       1u      // Noise sequence after VR_Emu_Init()
 
 /* Exported macro ------------------------------------------------------------*/
 #define DEGREES_TO_RADIANS(deg)     ((deg) * M_PI / 180.0f)
@@ -68,15 +128,47 @@ typedef struct {
 /* Exported functions prototypes ---------------------------------------------*/
 void VR_Emulator_Init(void);
 void VR_Emulator_Update(void);
+void VR_Emulator_SetPotentiometer(uint16_t adc_value);
 void VR_Emulator_SetRPM(uint16_t rpm);
 uint16_t VR_Emulator_GetRPM(void);
+void VR_Emulator_SetSpeed(int32_t rpm);
+int32_t VR_Emulator_GetSpeed(void);
+void VR_Emulator_SetReverse(bool reverse);
+float VR_Emulator_GetCrankAngle(void);
 uint16_t VR_Emulator_ReadPotentiometer(void);
 void VR_Emulator_GenerateSignal(void);
 uint16_t VR_Emulator_CalculateDAC_Value(float angle, uint8_t tooth_active);
+float VR_Emulator_ApplyDistortion(float base_sine, float angle);
+bool VR_Emulator_SetShape(const VR_ToothShape_t *shape);
 
 /* Timer callback for tooth generation */
 void VR_Emulator_TimerCallback(void);
 
+/* Instance API; the functions above operate on VR_Emulator_GetDefault() */
+VR_Emulator_t *VR_Emulator_GetDefault(void);
+void VR_Emu_Init(VR_Emulator_t *emu, const VR_EmulatorBinding_t *binding);
+void VR_Emu_Update(VR_Emulator_t *emu);
+void VR_Emu_SetPotentiometer(VR_Emulator_t *emu, uint16_t adc_value);
+void VR_Emu_SetRPM(VR_Emulator_t *emu, uint16_t rpm);
+void VR_Emu_SetSpeed(VR_Emulator_t *emu, int32_t rpm);
+void VR_Emu_SetReverse(VR_Emulator_t *emu, bool reverse);
+void VR_Emu_SetQuality(VR_Emulator_t *emu, VR_Quality_t quality);
+void VR_Emu_SetAmplitude(VR_Emulator_t *emu, uint16_t amplitude);
+void VR_Emu_SetSampleLimit(VR_Emulator_t *emu, uint16_t ticks);
+void VR_Emu_SetToothHook(VR_Emulator_t *emu, VR_ToothHook_t hook, void *ctx);
+void VR_Emu_SetFault(VR_Emulator_t *emu, VR_Fault_t fault);
+void VR_Emu_SetNoise(VR_Emulator_t *emu, uint16_t peak_lsb, uint32_t seed);
+uint16_t VR_Emu_GetRPM(const VR_Emulator_t *emu);
+int32_t VR_Emu_GetSpeed(const VR_Emulator_t *emu);
+float VR_Emu_GetCrankAngle(const VR_Emulator_t *emu);
+uint16_t VR_Emu_GetOutput(const VR_Emulator_t *emu);
+uint32_t VR_Emu_GetSamplePeriod(const VR_Emulator_t *emu);
+uint16_t VR_Emu_ReadPotentiometer(VR_Emulator_t *emu);
+void VR_Emu_GenerateSignal(VR_Emulator_t *emu);
+bool VR_Emu_SetShape(VR_Emulator_t *emu, const VR_ToothShape_t *shape);
+void VR_Emu_Skip(VR_Emulator_t *emu, uint64_t count);
+void VR_Emu_TimerCallback(VR_Emulator_t *emu);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,85 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_signal_analysis.h
+  * @brief          : Header for VR waveform analysis
+  ******************************************************************************
+  * @attention
+  *
+  * Measures a captured VR waveform (DC offset, peaks, tooth timing and
+  * missing-tooth pattern) and checks it against the emulator model.
+  * Used by the on-target DAC->ADC loopback self-test and by the host
+  * simulator on recorded DAC writes.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_SIGNAL_ANALYSIS_H
+#define __VR_SIGNAL_ANALYSIS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t sample_rate_hz;        // Rate the samples were captured at
+    uint16_t threshold_lsb;         // Deviation from DC offset that starts a tooth
+    uint8_t release_samples;        // Consecutive quiet samples that end a tooth
+} VR_AnalysisConfig_t;
+
+typedef struct {
+    uint16_t dc_tolerance_lsb;      // Allowed DC offset error
+    uint16_t amplitude_tolerance_lsb; // Allowed peak error against the model
+    float rpm_tolerance_pct;        // Allowed mean RPM error
+    float width_tolerance_deg;      // Allowed tooth/gap width error (plus one sample)
+    uint32_t render_period_us;      // Output update period, bounds tooth period jitter
+} VR_AnalysisLimits_t;
+
+typedef struct {
+    uint16_t dc_offset;             // Level between teeth
+    uint16_t peak_high;             // Highest sample
+    uint16_t peak_low;              // Lowest sample
+    uint32_t teeth;                 // Teeth with a measured period
+    uint32_t wide_teeth;            // Teeth classified as the missing-tooth position
+    uint32_t revolutions;           // Wide-to-wide intervals seen
+    bool pattern_ok;                // Every wide-to-wide interval is one revolution
+    float measured_rpm;             // From the mean tooth period
+    float period_jitter_us;         // Largest tooth period deviation from the mean
+    float regular_width_deg;        // Mean regular tooth width
+    float wide_width_deg;           // Mean wide tooth width
+    float wide_gap_deg;             // Mean gap following the wide tooth
+} VR_AnalysisResult_t;
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_ANALYSIS_DEFAULT_THRESHOLD   12      // LSB
+#define VR_ANALYSIS_DEFAULT_RELEASE     2       // Samples
+
+/* Check failure flags returned by VR_Analysis_Check() */
+#define VR_ANALYSIS_FAIL_DC             (1u << 0)
+#define VR_ANALYSIS_FAIL_AMPLITUDE      (1u << 1)
+#define VR_ANALYSIS_FAIL_RPM            (1u << 2)
+#define VR_ANALYSIS_FAIL_JITTER         (1u << 3)
+#define VR_ANALYSIS_FAIL_WIDTH          (1u << 4)
+#define VR_ANALYSIS_FAIL_PATTERN        (1u << 5)
+#define VR_ANALYSIS_NUM_CHECKS          6
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Analysis_Run(const uint16_t *samples, uint32_t count,
+                     const VR_AnalysisConfig_t *config, VR_AnalysisResult_t *result);
+uint32_t VR_Analysis_Check(const VR_AnalysisResult_t *result, uint16_t rpm,
+                           const VR_AnalysisConfig_t *config, const VR_AnalysisLimits_t *limits);
+void VR_Analysis_ModelPeaks(uint16_t *peak_high, uint16_t *peak_low);
+const char *VR_Analysis_CheckName(uint32_t flag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_SIGNAL_ANALYSIS_H */
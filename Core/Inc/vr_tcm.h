@@ -0,0 +1,62 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_tcm.h
+  * @brief          : Header for tightly-coupled memory placement
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * The code that runs on every TIM6 sample is placed in ITCM, and the state
+  * and tables it reads in DTCM. Both run at core speed with no wait states
+  * and no cache, so the sample path takes the same number of cycles
+  * whatever flash and the caches are doing. Buffers that DMA reads or
+  * writes stay in SRAM1/SRAM2 (see vr_dma_buffer.h).
+  *
+  * Build with TCM=0 to leave everything in flash and SRAM for comparison.
+  * The host build ignores the placement.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_TCM_H
+#define __VR_TCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+#ifndef VR_TCM_PLACEMENT
+#define VR_TCM_PLACEMENT            1
+#endif
+
+#define VR_ITCM_SIZE                (16u * 1024u)
+#define VR_DTCM_SIZE                (128u * 1024u)
+
+/* Exported macro ------------------------------------------------------------*/
+/* Placement of the sample path; the sections are laid out by STM32F767ZITx_FLASH.ld */
+#if VR_TCM_PLACEMENT && !defined(VR_HOST_SIM)
+#define VR_ITCM_CODE                __attribute__((section(".itcm_text")))
+#define VR_DTCM_DATA                __attribute__((section(".dtcm_data")))
+#define VR_DTCM_BSS                 __attribute__((section(".dtcm_bss")))
+#else
+#define VR_ITCM_CODE
+#define VR_DTCM_DATA
+#define VR_DTCM_BSS
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_TCM_Init(void);
+uint32_t VR_TCM_FormatUsage(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_TCM_H */
@@ -0,0 +1,62 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_tooth_shape.h
+  * @brief          : Header for table-driven tooth waveforms
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * A tooth shape is one table of levels per tooth pitch, captured from a
+  * real sensor, plus a separate table for the wide tooth. The emulator
+  * resamples it at every update by linear interpolation in tooth phase,
+  * so the same table plays back at any RPM.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_TOOTH_SHAPE_H
+#define __VR_TOOTH_SHAPE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_SHAPE_MAX_POINTS         256     // Table entries per region
+#define VR_SHAPE_MIN_POINTS         2
+#define VR_SHAPE_MAX_LEVEL          4095    // Largest offset from the DC level, DAC codes
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_SHAPE_REGULAR = 0,           // Every tooth but the wide one
+    VR_SHAPE_MISSING,               // The wide tooth (MISSING_TOOTH_INDEX)
+    VR_SHAPE_REGIONS
+} VR_ShapeRegion_t;
+
+/* Levels over one tooth pitch (tooth plus gap), evenly spaced in phase and
+   given as signed DAC codes from the DC level. Entry 0 is the tooth start. */
+typedef struct {
+    int16_t points[VR_SHAPE_REGIONS][VR_SHAPE_MAX_POINTS];
+    uint16_t length[VR_SHAPE_REGIONS];
+} VR_ToothShape_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Shape_Clear(VR_ToothShape_t *shape);
+bool VR_Shape_Append(VR_ToothShape_t *shape, VR_ShapeRegion_t region, int32_t level);
+bool VR_Shape_Parse(VR_ToothShape_t *shape, VR_ShapeRegion_t *region, const char *text);
+bool VR_Shape_IsValid(const VR_ToothShape_t *shape);
+uint16_t VR_Shape_Sample(const VR_ToothShape_t *shape, uint8_t tooth, uint32_t timer, uint32_t period);
+int32_t VR_Shape_Offset(const VR_ToothShape_t *shape, uint8_t tooth, uint32_t timer, uint32_t period);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_TOOTH_SHAPE_H */
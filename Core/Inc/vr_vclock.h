@@ -0,0 +1,71 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_vclock.h
+  * @brief          : Header for the variable sample clock output mode
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  * The analog waveform depends only on the tooth phase, so one revolution
+  * rendered at a fixed number of samples per tooth serves every speed.
+  * In variable clock mode DMA1 Stream5 plays that revolution into the DAC
+  * in a loop, and TIM7 triggers each sample. The RPM only sets the TIM7
+  * period.
+  *
+  * TIM7 counts at 108 MHz, so a tooth lasts a whole number of 9.26 ns
+  * ticks. Those ticks are spread over the 64 samples of a tooth by a
+  * table of reload values that DMA1 Stream2 writes to TIM7 ARR at every
+  * update. An RPM change rewrites that table and nothing else.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_VCLOCK_H
+#define __VR_VCLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "vr_sensor_emulator.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_VCLK_SAMPLES_PER_TOOTH   64
+#define VR_VCLK_SAMPLES             (TRIGGER_WHEEL_TEETH * VR_VCLK_SAMPLES_PER_TOOTH)
+#define VR_VCLK_TICKS_PER_US        108u                // TIM7 at the 108 MHz APB1 timer clock
+#define VR_VCLK_TOOTH_TICKS_RPM     360000000u          // Ticks per tooth times RPM: 108 MHz * 60 / 18
+#define VR_VCLK_MIN_RPM             86                  // Slowest speed with at most 65536 ticks per sample
+#define VR_VCLK_RENDER_CHUNK        256                 // Samples rendered per VR_Vclk_Update() call
+#define VR_VCLK_DMA_LATENCY_TICKS   40                  // TIM7 update to the TIM2 read in the transfer callback
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint16_t rpm;                   // Speed the TIM7 table is set for, 0 while holding
+    uint32_t tooth_ticks;           // TIM7 ticks per tooth at that speed
+    uint32_t step_mrpm;             // Gap to the next speed one tick away, milli-RPM
+    uint32_t revolutions;           // Revolutions played
+    uint32_t retunes;               // TIM7 table rewrites
+    uint32_t renders;               // Revolutions rendered
+} VR_VclkStats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Vclk_Start(void);
+void VR_Vclk_Stop(void);
+bool VR_Vclk_IsEnabled(void);
+bool VR_Vclk_Update(void);
+void VR_Vclk_TransferCallback(bool complete);
+void VR_Vclk_GetStats(VR_VclkStats_t *stats);
+uint32_t VR_Vclk_FormatTelemetry(char *buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_VCLOCK_H */
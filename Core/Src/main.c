@@ -22,6 +22,24 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "vr_sensor_emulator.h"
+#include "vr_loopback.h"
+#include "vr_digital_output.h"
+#include "vr_ecu_capture.h"
+#include "vr_command.h"
+#include "vr_tcm.h"
+#include "vr_cycles.h"
+#include "vr_dma_buffer.h"
+#include "vr_event.h"
+#include "vr_sched.h"
+#include "vr_sample.h"
+#include "vr_config.h"
+#include "vr_revolution.h"
+#include "vr_vclock.h"
+#include "vr_qos.h"
+#include "vr_counters.h"
+#include "vr_crank.h"
+#include "vr_scenario.h"
+#include <string.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -31,7 +49,17 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define MAIN_HEARTBEAT_MS           500     // LD1 toggle period
+#define MAIN_CONTROL_DEADLINE_US    1000    // One potentiometer conversion period
+#define MAIN_COMMAND_DEADLINE_US    10000   // Command reply latency budget
+#define MAIN_REVOLUTION_DEADLINE_US 10000   // One render chunk
 
+// Background task priorities, 0 runs first
+#define MAIN_PRIO_CONTROL           0
+#define MAIN_PRIO_COMMAND           1
+#define MAIN_PRIO_TELEMETRY         2
+#define MAIN_PRIO_HEARTBEAT         3
+#define MAIN_PRIO_REVOLUTION        4
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -41,29 +69,53 @@
 
 /* Private variables ---------------------------------------------------------*/
 ADC_HandleTypeDef hadc1;
+ADC_HandleTypeDef hadc2;
+DMA_HandleTypeDef hdma_adc1;
+DMA_HandleTypeDef hdma_adc2;
 
 DAC_HandleTypeDef hdac;
+DMA_HandleTypeDef hdma_dac1;
 
 TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim4;
 TIM_HandleTypeDef htim6;
+TIM_HandleTypeDef htim7;
+TIM_HandleTypeDef htim8;
+DMA_HandleTypeDef hdma_tim2_ch2;
+DMA_HandleTypeDef hdma_tim2_ch3;
+DMA_HandleTypeDef hdma_tim2_ch4;
+DMA_HandleTypeDef hdma_tim7_up;
 
 UART_HandleTypeDef huart3;
 
 /* USER CODE BEGIN PV */
-
+static uint8_t command_rx;  // USART3 receive interrupt buffer, one byte
+static volatile uint16_t pot_sample VR_DMA_BUFFER;  // Latest ADC1 conversion, written by DMA
+static VR_TaskId_t control_task;
+static VR_TaskId_t command_task;
+static VR_TaskId_t revolution_task;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART3_UART_Init(void);
 static void MX_ADC1_Init(void);
 static void MX_DAC_Init(void);
 static void MX_TIM2_Init(void);
 static void MX_TIM6_Init(void);
+static void MX_TIM7_Init(void);
+static void MX_ADC2_Init(void);
+static void MX_TIM8_Init(void);
+static void MX_TIM4_Init(void);
 
 /* USER CODE BEGIN PFP */
-
+static void Main_ControlTask(void *ctx);
+static void Main_CommandTask(void *ctx);
+static void Main_TelemetryTask(void *ctx);
+static void Main_HeartbeatTask(void *ctx);
+static void Main_RevolutionTask(void *ctx);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -78,6 +130,13 @@ static void MX_TIM6_Init(void);
 int main(void)
 {
   /* USER CODE BEGIN 1 */
+  
+  // Load the sample path into ITCM/DTCM before any interrupt can reach it
+  VR_TCM_Init();
+  
+  // Non-cacheable DMA region, then the I/D caches, before any DMA starts
+  VR_DMA_Init();
+  VR_Cycles_Init();
 
   /* USER CODE END 1 */
 
@@ -87,6 +146,10 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
+  VR_Cycles_BootMark(VR_BOOT_HAL);
+  
+  // Keep the debugger attached while the core sleeps in WFI
+  HAL_DBGMCU_EnableDBGSleepMode();
 
   /* USER CODE END Init */
 
@@ -94,21 +157,42 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  VR_Cycles_BootMark(VR_BOOT_CLOCK);
+  
+  // SysTick only keeps the HAL time base; everything else preempts it
+  HAL_NVIC_SetPriority(SysTick_IRQn, VR_IRQ_PRIO_TICK, 0);
 
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART3_UART_Init();
   MX_ADC1_Init();
   MX_DAC_Init();
   MX_TIM2_Init();
   MX_TIM6_Init();
+  MX_TIM7_Init();
+  MX_ADC2_Init();
+  MX_TIM8_Init();
+  MX_TIM4_Init();
 
   /* USER CODE BEGIN 2 */
+  VR_Cycles_BootMark(VR_BOOT_PERIPH);
   
   // Initialize VR sensor emulator
   VR_Emulator_Init();
+  VR_QoS_Init();
+  VR_Event_Init();
+  
+  // Restore the saved configuration, so the first sample already uses it
+  static VR_Config_t boot_config;
+  VR_Config_Init();
+  if (VR_Config_Load(&boot_config))
+  {
+    VR_Config_Apply(&boot_config);
+  }
+  VR_Cycles_BootMark(VR_BOOT_CONFIG);
   
   // Start ADC calibration
   if (HAL_ADCEx_Calibration_Start(&hadc1, ADC_SINGLE_ENDED) != HAL_OK)
@@ -127,11 +211,60 @@ int main(void)
   {
     Error_Handler();
   }
+  VR_Cycles_BootMark(VR_BOOT_OUTPUT);
   
   if (HAL_TIM_Base_Start(&htim2) != HAL_OK)
   {
     Error_Handler();
   }
+  
+  // Hall/optical output on PA3, edges scheduled by TIM2 and DMA
+  VR_Digital_Start();
+  
+  // Timing light: ECU ignition on PB3 and injection on PB10
+  VR_Capture_Start();
+  
+  // Potentiometer: TIM4 triggers ADC1 at 1 kHz, DMA stores each conversion
+  if (HAL_ADC_Start_DMA(&hadc1, (uint32_t *)&pot_sample, 1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_DMA_DISABLE_IT(hadc1.DMA_Handle, DMA_IT_HT);
+  if (HAL_TIM_Base_Start(&htim4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  
+  // Background tasks, woken by TIM2 channel 1 at the next release
+  VR_Sched_Init();
+  control_task = VR_Sched_AddOneShot("ctl", Main_ControlTask, NULL, MAIN_PRIO_CONTROL,
+                                     MAIN_CONTROL_DEADLINE_US);
+  command_task = VR_Sched_AddOneShot("cmd", Main_CommandTask, NULL, MAIN_PRIO_COMMAND,
+                                     MAIN_COMMAND_DEADLINE_US);
+  VR_Sched_AddPeriodic("tlm", Main_TelemetryTask, NULL, MAIN_PRIO_TELEMETRY,
+                       VR_CAPTURE_TELEMETRY_MS * 1000u, 0);
+  VR_Sched_AddPeriodic("led", Main_HeartbeatTask, NULL, MAIN_PRIO_HEARTBEAT,
+                       MAIN_HEARTBEAT_MS * 1000u, 0);
+  revolution_task = VR_Sched_AddOneShot("rev", Main_RevolutionTask, NULL, MAIN_PRIO_REVOLUTION,
+                                        MAIN_REVOLUTION_DEADLINE_US);
+  if (HAL_TIM_OC_Start_IT(&htim2, TIM_CHANNEL_1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  VR_Event_Post(VR_EVENT_TICK);
+  
+  // Command channel on USART3, one byte per receive interrupt
+  HAL_UART_Receive_IT(&huart3, &command_rx, 1);
+  
+  // Report where the sample path was linked
+  static char tcm_usage[64];
+  uint32_t tcm_len = VR_TCM_FormatUsage(tcm_usage, sizeof(tcm_usage));
+  HAL_UART_Transmit(&huart3, (uint8_t *)tcm_usage, (uint16_t)tcm_len, 100);
+  
+  // Report how long each boot stage took to reach a running output
+  static char boot_times[96];
+  uint32_t boot_len = VR_Cycles_FormatBoot(boot_times, sizeof(boot_times));
+  HAL_UART_Transmit(&huart3, (uint8_t *)boot_times, (uint16_t)boot_len, 100);
 
   /* USER CODE END 2 */
 
@@ -143,14 +276,29 @@ int main(void)
 
     /* USER CODE BEGIN 3 */
     
-    // Update VR sensor emulator (read potentiometer, update RPM)
-    VR_Emulator_Update();
+    // Sleep until an interrupt posts work
+    uint32_t events = VR_Event_Wait();
     
-    // Small delay to prevent overwhelming the system
-    HAL_Delay(10);
+    if (events & VR_EVENT_POT)
+    {
+      VR_Sched_Trigger(control_task, 0);
+    }
+    if (events & VR_EVENT_COMMAND)
+    {
+      VR_Sched_Trigger(command_task, 0);
+    }
+    VR_Sched_RunReady();
     
-    // Toggle LED to show system is alive
-    HAL_GPIO_TogglePin(LD1_GPIO_Port, LD1_Pin);
+    // Wake at the next release; one already passed is run on the next pass
+    uint32_t release;
+    if (VR_Sched_NextRelease(&release))
+    {
+      __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, release);
+      if ((int32_t)(__HAL_TIM_GET_COUNTER(&htim2) - release) >= 0)
+      {
+        VR_Event_Post(VR_EVENT_TICK);
+      }
+    }
   }
   /* USER CODE END 3 */
 }
@@ -219,6 +367,11 @@ void SystemClock_Config(void)
   */
 static void MX_ADC1_Init(void)
 {
+
+  /* USER CODE BEGIN ADC1_Init 0 */
+  // Potentiometer, converted on each TIM4 update and moved by DMA
+  /* USER CODE END ADC1_Init 0 */
+
   ADC_ChannelConfTypeDef sConfig = {0};
 
   /** Configure the global features of the ADC (Clock, Resolution, Data Alignment and number of conversion)
@@ -229,11 +382,11 @@ static void MX_ADC1_Init(void)
   hadc1.Init.ScanConvMode = ADC_SCAN_DISABLE;
   hadc1.Init.ContinuousConvMode = DISABLE;
   hadc1.Init.DiscontinuousConvMode = DISABLE;
-  hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
-  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T4_TRGO;
   hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
   hadc1.Init.NbrOfConversion = 1;
-  hadc1.Init.DMAContinuousRequests = DISABLE;
+  hadc1.Init.DMAContinuousRequests = ENABLE;
   hadc1.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
   if (HAL_ADC_Init(&hadc1) != HAL_OK)
   {
@@ -249,6 +402,52 @@ static void MX_ADC1_Init(void)
   {
     Error_Handler();
   }
+
+}
+
+/**
+  * @brief ADC2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_ADC2_Init(void)
+{
+
+  /* USER CODE BEGIN ADC2_Init 0 */
+  // Loopback capture of the DAC output pin, triggered by TIM8 and moved by DMA
+  /* USER CODE END ADC2_Init 0 */
+
+  ADC_ChannelConfTypeDef sConfig = {0};
+
+  /** Configure the global features of the ADC (Clock, Resolution, Data Alignment and number of conversion)
+  */
+  hadc2.Instance = ADC2;
+  hadc2.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV4;
+  hadc2.Init.Resolution = ADC_RESOLUTION_12B;
+  hadc2.Init.ScanConvMode = ADC_SCAN_DISABLE;
+  hadc2.Init.ContinuousConvMode = DISABLE;
+  hadc2.Init.DiscontinuousConvMode = DISABLE;
+  hadc2.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc2.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T8_TRGO;
+  hadc2.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+  hadc2.Init.NbrOfConversion = 1;
+  hadc2.Init.DMAContinuousRequests = DISABLE;
+  hadc2.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+  if (HAL_ADC_Init(&hadc2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /** Configure for the selected ADC regular channel its corresponding rank in the sequencer and its sample time.
+  */
+  sConfig.Channel = ADC_CHANNEL_4;
+  sConfig.Rank = ADC_REGULAR_RANK_1;
+  sConfig.SamplingTime = ADC_SAMPLETIME_15CYCLES;
+  if (HAL_ADC_ConfigChannel(&hadc2, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
 }
 
 /**
@@ -285,13 +484,23 @@ static void MX_DAC_Init(void)
   */
 static void MX_TIM2_Init(void)
 {
+
+  /* USER CODE BEGIN TIM2_Init 0 */
+  // Free-running 32-bit timebase at 108 MHz; CH4 toggles at each digital
+  // output edge and DMA reloads CCR4 from the edge ring; CH2 and CH3
+  // timestamp ECU ignition and injection edges into DMA rings; CH1
+  // interrupts at the next background task release
+  /* USER CODE END TIM2_Init 0 */
+
   TIM_ClockConfigTypeDef sClockSourceConfig = {0};
   TIM_MasterConfigTypeDef sMasterConfig = {0};
+  TIM_IC_InitTypeDef sConfigIC = {0};
+  TIM_OC_InitTypeDef sConfigOC = {0};
 
   htim2.Instance = TIM2;
-  htim2.Init.Prescaler = 107;
+  htim2.Init.Prescaler = 0;
   htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
-  htim2.Init.Period = 999;
+  htim2.Init.Period = 4294967295;
   htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
   htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
   if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
@@ -303,12 +512,87 @@ static void MX_TIM2_Init(void)
   {
     Error_Handler();
   }
-  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  if (HAL_TIM_IC_Init(&htim2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OC_Init(&htim2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
   sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
   if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig) != HAL_OK)
   {
     Error_Handler();
   }
+  sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_FALLING;
+  sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
+  sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+  sConfigIC.ICFilter = 0;
+  if (HAL_TIM_IC_ConfigChannel(&htim2, &sConfigIC, TIM_CHANNEL_2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+  if (HAL_TIM_IC_ConfigChannel(&htim2, &sConfigIC, TIM_CHANNEL_3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfigOC.OCMode = TIM_OCMODE_TIMING;
+  sConfigOC.Pulse = 0;
+  sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  if (HAL_TIM_OC_ConfigChannel(&htim2, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfigOC.OCMode = TIM_OCMODE_TOGGLE;
+  if (HAL_TIM_OC_ConfigChannel(&htim2, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  HAL_TIM_MspPostInit(&htim2);
+
+}
+
+/**
+  * @brief TIM4 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM4_Init(void)
+{
+
+  /* USER CODE BEGIN TIM4_Init 0 */
+  // Potentiometer sample clock: 108 MHz / 108 / 1000 = 1 kHz, TRGO to ADC1
+  /* USER CODE END TIM4_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  htim4.Instance = TIM4;
+  htim4.Init.Prescaler = 107;
+  htim4.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim4.Init.Period = 999;
+  htim4.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim4.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim4, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim4, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
 }
 
 /**
@@ -337,6 +621,80 @@ static void MX_TIM6_Init(void)
   }
 }
 
+/**
+  * @brief TIM7 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM7_Init(void)
+{
+
+  /* USER CODE BEGIN TIM7_Init 0 */
+  // Variable clock mode sample clock; DMA1 Stream2 writes ARR at every
+  // update, so preload stays off and the value sets the period starting
+  /* USER CODE END TIM7_Init 0 */
+
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = 0;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = 65535;
+  htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim7, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+}
+
+/**
+  * @brief TIM8 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM8_Init(void)
+{
+
+  /* USER CODE BEGIN TIM8_Init 0 */
+  // Loopback sample clock; the period is set per capture by VR_Loopback_Start()
+  /* USER CODE END TIM8_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  htim8.Instance = TIM8;
+  htim8.Init.Prescaler = 0;
+  htim8.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim8.Init.Period = 215;
+  htim8.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim8.Init.RepetitionCounter = 0;
+  htim8.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim8) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim8, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterOutputTrigger2 = TIM_TRGO2_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim8, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+}
+
 /**
   * @brief USART3 Initialization Function
   * @param None
@@ -360,6 +718,39 @@ static void MX_USART3_UART_Init(void)
   }
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA2_Stream0_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, VR_IRQ_PRIO_DMA, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+  /* DMA1_Stream1_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream1_IRQn, VR_IRQ_PRIO_DMA, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+  /* DMA1_Stream2 (TIM7 reload table) runs without an interrupt */
+  /* DMA1_Stream5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, VR_IRQ_PRIO_SAMPLE, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, VR_IRQ_PRIO_DMA, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+  /* DMA1_Stream7_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream7_IRQn, VR_IRQ_PRIO_EDGE_REFILL, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+  /* DMA2_Stream2_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, VR_IRQ_PRIO_DMA, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -398,18 +789,278 @@ static void MX_GPIO_Init(void)
 
 /**
   * @brief  Period elapsed callback in non blocking mode
-  * @note   This function is called  when TIM6 interrupt took place, inside
-  * HAL_TIM_IRQHandler(). It makes a direct call to HAL_IncTick() to increment
-  * a global variable "uwTick" used as application time base.
+  * @note   Reached for TIM6 only when built with FASTISR=0; the default
+  *         TIM6_DAC_IRQHandler() handles the update itself and leaves the
+  *         bottom half to PendSV. The HAL time base is SysTick alone, so
+  *         it does not run faster as the sample rate rises.
   * @param  htim : TIM handle
   * @retval None
   */
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+VR_ITCM_CODE void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
   if (htim->Instance == TIM6) {
-    HAL_IncTick();
-    // Call VR emulator timer callback for precise timing
-    VR_Emulator_TimerCallback();
+    VR_Sample_TopHalf();
+    VR_Sample_BottomHalf();
+  }
+}
+
+/**
+  * @brief  DAC DMA half transfer callback
+  * @note   Called from the DMA1 Stream5 interrupt in revolution and
+  *         variable clock modes, in place of the TIM6 sample interrupt. DMA1_Stream5_IRQHandler()
+  *         then pends the bottom half.
+  * @param  hdac : DAC handle
+  * @retval None
+  */
+void HAL_DAC_ConvHalfCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+  (void)hdac;
+  if (VR_Vclk_IsEnabled()) {
+    VR_Vclk_TransferCallback(false);
+  } else {
+    VR_Rev_TransferCallback(false);
+  }
+}
+
+/**
+  * @brief  DAC DMA transfer complete callback
+  * @note   Called from the DMA1 Stream5 interrupt at the end of each
+  *         revolution; swaps in a newly rendered one.
+  * @param  hdac : DAC handle
+  * @retval None
+  */
+void HAL_DAC_ConvCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+  (void)hdac;
+  if (VR_Vclk_IsEnabled()) {
+    VR_Vclk_TransferCallback(true);
+  } else {
+    VR_Rev_TransferCallback(true);
+  }
+}
+
+/**
+  * @brief  DAC channel 1 DMA underrun callback
+  * @note   Called from the TIM6_DAC interrupt when a trigger found no new
+  *         level from DMA in revolution or variable clock mode
+  * @param  hdac : DAC handle
+  * @retval None
+  */
+void HAL_DAC_DMAUnderrunCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+  (void)hdac;
+  VR_QoS_DacUnderrun();
+}
+
+/**
+  * @brief  DMA transfer complete callback for timer input capture channels
+  * @note   Called from the DMA1 Stream6 (CH2) and Stream1 (CH3) interrupts
+  *         each time an ECU capture ring wraps.
+  * @param  htim : TIM handle
+  * @retval None
+  */
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance != TIM2) {
+    return;
+  }
+  if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2) {
+    VR_Capture_TransferCompleteCallback(VR_CAPTURE_IGNITION);
+  } else if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_3) {
+    VR_Capture_TransferCompleteCallback(VR_CAPTURE_INJECTION);
+  }
+}
+
+/**
+  * @brief  DMA half transfer callback for timer output compare channels
+  * @note   Called from the DMA1 Stream7 interrupt once the first half of the
+  *         digital output edge ring has been loaded into CCR4.
+  * @param  htim : TIM handle
+  * @retval None
+  */
+void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_4) {
+    VR_Digital_TransferHalfCallback();
+  }
+}
+
+/**
+  * @brief  DMA transfer complete callback for timer output compare channels
+  * @note   Called from the DMA1 Stream7 interrupt once the second half of
+  *         the digital output edge ring has been loaded into CCR4.
+  * @param  htim : TIM handle
+  * @retval None
+  */
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_4) {
+    VR_Digital_TransferCompleteCallback();
+  }
+}
+
+/**
+  * @brief  Rx Transfer completed callback
+  * @note   Called from the USART3 interrupt for every command byte received.
+  * @param  huart : UART handle
+  * @retval None
+  */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart->Instance == USART3) {
+    if (VR_Command_RxByte(command_rx))
+    {
+      VR_Event_Post(VR_EVENT_COMMAND);
+    }
+    HAL_UART_Receive_IT(&huart3, &command_rx, 1);
+  }
+}
+
+/**
+  * @brief  UART error callback
+  * @note   An overrun or framing error ends the reception; restart it so
+  *         the command channel keeps listening.
+  * @param  huart : UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  if (huart->Instance == USART3) {
+    HAL_UART_Receive_IT(&huart3, &command_rx, 1);
+  }
+}
+
+/**
+  * @brief  Conversion complete callback in non blocking mode
+  * @note   Called from the DMA2 Stream0 interrupt after each potentiometer
+  *         conversion, and from the DMA2 Stream2 interrupt when the
+  *         loopback capture buffer is full.
+  * @param  hadc : ADC handle
+  * @retval None
+  */
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+  if (hadc->Instance == ADC1) {
+    VR_Counters_AdcUpdate();
+    VR_Event_Post(VR_EVENT_POT);
+  } else if (hadc->Instance == ADC2) {
+    VR_Loopback_CaptureCompleteCallback();
+  }
+}
+
+/**
+  * @brief  Output compare delay elapsed callback
+  * @note   Called from the TIM2 interrupt when the count reaches CCR1, the
+  *         next background task release.
+  * @param  htim : TIM handle
+  * @retval None
+  */
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1) {
+    VR_Event_Post(VR_EVENT_TICK);
+  }
+}
+
+/**
+  * @brief  Control task: apply the potentiometer and process ECU captures
+  * @note   Triggered by each ADC1 conversion (VR_EVENT_POT).
+  * @param  ctx : Unused
+  * @retval None
+  */
+static void Main_ControlTask(void *ctx)
+{
+  (void)ctx;
+  uint32_t cycles_start = VR_Cycles_Now();
+  
+  // Apply the new potentiometer conversion as the target RPM, unless an
+  // engine start or a scenario is setting the speed
+  if (!VR_Crank_IsRunning() && !VR_Scenario_IsRunning())
+  {
+    VR_Emulator_SetPotentiometer(pot_sample);
+  }
+  
+  // Convert ECU edges captured since the last conversion to crank angle
+  VR_Capture_Process();
+  
+  // Trade waveform detail for time if the sample path is overloaded
+  VR_QoS_Update();
+  
+  // Follow RPM changes with a newly rendered revolution or TIM7 table
+  if (VR_Rev_IsEnabled() || VR_Vclk_IsEnabled())
+  {
+    VR_Sched_Trigger(revolution_task, 0);
+  }
+  VR_Cycles_Record(VR_CYCLES_CONTROL, cycles_start);
+}
+
+/**
+  * @brief  Command task: execute received command lines, one reply line each
+  * @note   Triggered by each complete line (VR_EVENT_COMMAND).
+  * @param  ctx : Unused
+  * @retval None
+  */
+static void Main_CommandTask(void *ctx)
+{
+  (void)ctx;
+  static char reply[VR_COMMAND_REPLY_MAX];
+  
+  while (VR_Command_Poll(reply, sizeof(reply)))
+  {
+    HAL_UART_Transmit(&huart3, (uint8_t *)reply, (uint16_t)strlen(reply), 100);
+  }
+}
+
+/**
+  * @brief  Telemetry task: capture, cycle, load, task, quality, revolution and output statistics
+  * @param  ctx : Unused
+  * @retval None
+  */
+static void Main_TelemetryTask(void *ctx)
+{
+  (void)ctx;
+  static char telemetry[1024];
+  
+  uint32_t len = VR_Capture_FormatTelemetry(telemetry, sizeof(telemetry));
+  len += VR_Cycles_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  len += VR_Sample_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  len += VR_Event_FormatLoad(telemetry + len, sizeof(telemetry) - len);
+  len += VR_Sched_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  len += VR_QoS_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  len += VR_Rev_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  len += VR_Vclk_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  len += VR_Counters_FormatTelemetry(telemetry + len, sizeof(telemetry) - len);
+  HAL_UART_Transmit(&huart3, (uint8_t *)telemetry, (uint16_t)len, 100);
+}
+
+/**
+  * @brief  Heartbeat task: toggle LD1 to show the system is alive
+  * @param  ctx : Unused
+  * @retval None
+  */
+static void Main_HeartbeatTask(void *ctx)
+{
+  (void)ctx;
+  HAL_GPIO_TogglePin(LD1_GPIO_Port, LD1_Pin);
+}
+
+/**
+  * @brief  Revolution task: render the next revolution a chunk at a time
+  * @note   Triggered by the control task while revolution or variable
+  *         clock mode is on, and by itself until the render completes.
+  * @param  ctx : Unused
+  * @retval None
+  */
+static void Main_RevolutionTask(void *ctx)
+{
+  (void)ctx;
+  
+  bool more = VR_Rev_Update();
+  
+  more |= VR_Vclk_Update();
+  if (more)
+  {
+    VR_Sched_Trigger(revolution_task, 0);
   }
 }
 
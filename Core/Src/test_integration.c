@@ -156,6 +156,18 @@ TestResults_t VR_Test_RunComprehensive(void)
     overall_results.passed_tests += suite_results.passed_tests;
     overall_results.failed_tests += suite_results.failed_tests;
     
+    HAL_Delay(TEST_DELAY_MS);
+    
+    // Test Suite 6: DAC->ADC loopback signal quality
+    printf("\n=== Test Suite 6: Signal Quality ===\n");
+    const uint16_t signal_rpms[] = {800, 3000, 6000, MAX_RPM};
+    for (int i = 0; i < 4; i++) {
+        suite_results = VR_Emulator_TestSignalQuality(signal_rpms[i]);
+        overall_results.total_tests += suite_results.total_tests;
+        overall_results.passed_tests += suite_results.passed_tests;
+        overall_results.failed_tests += suite_results.failed_tests;
+    }
+    
     Print_Test_Footer(&overall_results);
     return overall_results;
 }
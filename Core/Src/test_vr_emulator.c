@@ -16,7 +16,10 @@
 /* Includes ------------------------------------------------------------------*/
 #include "test_vr_emulator.h"
 #include "vr_sensor_emulator.h"
+#include "vr_signal_analysis.h"
+#include "vr_loopback.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <math.h>
 
@@ -41,6 +44,14 @@ typedef struct {
 #define TEST_TOLERANCE_PERCENT      2.0f    // 2% tolerance for calculations
 #define NUM_RPM_TEST_CASES          20      // Number of test points across RPM range
 #define PRINTF_BUFFER_SIZE          256
+
+/* Loopback signal quality limits (DAC and ADC share VREF+) */
+#define SIGNAL_SETTLE_MS            20      // Let the new timer period take effect
+#define SIGNAL_CAPTURE_MARGIN_MS    100     // Timeout beyond the nominal capture time
+#define SIGNAL_DC_TOLERANCE_LSB     40      // ~32 mV
+#define SIGNAL_AMPLITUDE_TOLERANCE_LSB 80   // ~2% of full scale
+#define SIGNAL_RPM_TOLERANCE_PCT    0.5f
+#define SIGNAL_WIDTH_TOLERANCE_DEG  0.5f
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -75,6 +86,7 @@ typedef struct {
 /* USER CODE BEGIN PV */
 static TestResults_t test_results = {0};
 static char test_output_buffer[PRINTF_BUFFER_SIZE];
+extern TIM_HandleTypeDef htim6;
 
 // Test cases covering the full RPM range
 static const RPM_TestCase_t rpm_test_cases[NUM_RPM_TEST_CASES] = {
@@ -163,7 +175,7 @@ static void Test_ADC_To_RPM_Mapping(void)
         uint16_t simulated_adc = Simulate_ADC_Value(test_case->adc_value);
         
         // Calculate RPM from ADC value (same formula as in VR_Emulator_Update)
-        uint16_t calculated_rpm = (uint32_t)simulated_adc * MAX_RPM / ADC_RESOLUTION;
+        uint16_t calculated_rpm = (uint32_t)simulated_adc * MAX_RPM / (ADC_RESOLUTION - 1);
         
         // Test the conversion
         snprintf(test_output_buffer, sizeof(test_output_buffer), 
@@ -201,7 +213,8 @@ static void Test_RPM_Conversion(void)
         
         snprintf(test_output_buffer, sizeof(test_output_buffer), 
                 "Tooth freq %.1f Hz -> Period (expected: %lu us, got: %lu us)", 
-                calculated_tooth_freq, test_case->expected_tooth_period_us, calculated_period);
+                calculated_tooth_freq, (unsigned long)test_case->expected_tooth_period_us,
+                (unsigned long)calculated_period);
         
         TEST_ASSERT_WITHIN_TOLERANCE(calculated_period, test_case->expected_tooth_period_us, TEST_TOLERANCE_PERCENT);
     }
@@ -276,11 +289,11 @@ static void Test_Boundary_Conditions(void)
     
     // Test ADC boundary values
     uint16_t adc_min = 0;
-    uint16_t rpm_from_min_adc = (uint32_t)adc_min * MAX_RPM / ADC_RESOLUTION;
+    uint16_t rpm_from_min_adc = (uint32_t)adc_min * MAX_RPM / (ADC_RESOLUTION - 1);
     TEST_ASSERT(rpm_from_min_adc == 0, "Minimum ADC should result in 0 RPM");
     
     uint16_t adc_max = ADC_RESOLUTION - 1; // 4095 for 12-bit ADC
-    uint16_t rpm_from_max_adc = (uint32_t)adc_max * MAX_RPM / ADC_RESOLUTION;
+    uint16_t rpm_from_max_adc = (uint32_t)adc_max * MAX_RPM / (ADC_RESOLUTION - 1);
     
     snprintf(test_output_buffer, sizeof(test_output_buffer), 
             "Maximum ADC RPM (expected: close to %d, got: %d)", 
@@ -327,6 +340,89 @@ static void Test_SetRPM_Function(void)
     printf("✓ SetRPM function tests completed\n");
 }
 
+/**
+  * @brief  Test signal quality and distortion characteristics
+  * @note   Captures the DAC output through the ADC2 loopback while the
+  *         emulator keeps rendering from TIM6, then checks DC offset,
+  *         amplitude, tooth timing and the missing-tooth pattern against
+  *         the model. On the host the capture runs over recorded DAC writes.
+  * @param  test_rpm: RPM to test signal quality
+  * @retval Test results for signal quality testing, one test per check
+  */
+TestResults_t VR_Emulator_TestSignalQuality(uint16_t test_rpm)
+{
+    TestResults_t results = {0};
+    VR_AnalysisConfig_t config = {0, VR_ANALYSIS_DEFAULT_THRESHOLD, VR_ANALYSIS_DEFAULT_RELEASE};
+    VR_AnalysisResult_t analysis;
+    uint16_t saved_rpm = VR_Emulator_GetRPM();
+    
+    printf("Testing signal quality at %d RPM (DAC->ADC loopback)...\n", test_rpm);
+    
+    VR_Emulator_SetRPM(test_rpm);
+    HAL_Delay(SIGNAL_SETTLE_MS);
+    
+    // Capture runs on TIM8/ADC2/DMA2; only the completion interrupt hits the CPU
+    uint32_t rate = VR_Loopback_RateForRPM(test_rpm);
+    uint32_t timeout_ms = (uint32_t)((uint64_t)VR_LOOPBACK_BUFFER_SIZE * 1000 / rate) + SIGNAL_CAPTURE_MARGIN_MS;
+    uint32_t start = HAL_GetTick();
+    bool captured = (VR_Loopback_Start(rate) == HAL_OK);
+    
+    while (captured && !VR_Loopback_IsComplete()) {
+        if (HAL_GetTick() - start > timeout_ms) {
+            VR_Loopback_Stop();
+            captured = false;
+        }
+    }
+    
+    if (!captured) {
+        printf("TEST FAILED: %d RPM loopback capture did not complete\n", test_rpm);
+        VR_Emulator_SetRPM(saved_rpm);
+        results.failed_tests = 1;
+        results.total_tests = 1;
+        return results;
+    }
+    
+    uint32_t count;
+    const uint16_t *samples = VR_Loopback_GetSamples(&count);
+    config.sample_rate_hz = VR_Loopback_GetSampleRate();
+    VR_Analysis_Run(samples, count, &config, &analysis);
+    
+    VR_AnalysisLimits_t limits = {
+        SIGNAL_DC_TOLERANCE_LSB,
+        SIGNAL_AMPLITUDE_TOLERANCE_LSB,
+        SIGNAL_RPM_TOLERANCE_PCT,
+        SIGNAL_WIDTH_TOLERANCE_DEG,
+        (__HAL_TIM_GET_AUTORELOAD(&htim6) + 1) * VR_SAMPLE_TICK_US
+    };
+    uint32_t failures = VR_Analysis_Check(&analysis, test_rpm, &config, &limits);
+    
+    VR_Emulator_SetRPM(saved_rpm);
+    
+#if TEST_VERBOSE_OUTPUT
+    printf("  %lu Hz: DC %u, peaks %u/%u, %lu teeth, %.1f RPM, jitter %.1f us, "
+           "width %.2f/%.2f deg, gap %.2f deg\n",
+           (unsigned long)config.sample_rate_hz, analysis.dc_offset,
+           analysis.peak_low, analysis.peak_high, (unsigned long)analysis.teeth,
+           analysis.measured_rpm, analysis.period_jitter_us,
+           analysis.regular_width_deg, analysis.wide_width_deg, analysis.wide_gap_deg);
+#endif
+    
+    for (uint32_t flag = 1; flag < (1u << VR_ANALYSIS_NUM_CHECKS); flag <<= 1) {
+        if (failures & flag) {
+            printf("TEST FAILED: %d RPM signal %s out of tolerance\n", test_rpm, VR_Analysis_CheckName(flag));
+            results.failed_tests++;
+        } else {
+            results.passed_tests++;
+        }
+    }
+    
+    results.total_tests = results.passed_tests + results.failed_tests;
+    
+    printf("%s Signal quality tests completed\n", (results.failed_tests == 0) ? "✓" : "✗");
+    
+    return results;
+}
+
 /**
   * @brief  Print test results summary
   * @retval None
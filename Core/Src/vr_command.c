@@ -0,0 +1,650 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_command.c
+  * @brief          : USART3 command channel
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The USART3 receive interrupt passes each byte to VR_Command_RxByte(),
+  * which assembles lines into two alternating buffers. A line ends at CR
+  * or LF. If the main loop still holds both buffers, the incoming line is
+  * dropped whole and counted. VR_Command_Poll() executes the oldest line
+  * and formats one reply: "OK ..." or "ERR ...".
+  *
+  * Commands (case-insensitive):
+  *   SHAPE               Report the tooth waveform in use
+  *   SHAPE BEGIN         Start a new shape upload
+  *   SHAPE R|M n n ...   Append levels to the regular or wide tooth table
+  *   SHAPE END           Check the upload and switch the output to it
+  *   SHAPE OFF           Return to the built-in harmonic model
+  *   CONFIG              Report the configuration store in flash
+  *   CONFIG SAVE         Save the running configuration for the next boot
+  *   CONFIG CLEAR        Boot with the built-in defaults
+  *   REV                 Report the revolution output mode
+  *   REV ON|OFF          Play precomputed revolutions, or one sample per interrupt
+  *   VCLK                Report the variable sample clock output mode
+  *   VCLK ON|OFF         Play one revolution with TIM7 setting the speed
+  *   QOS                 Report the render quality and overload counters
+  *   QOS 0|1|2|3|4       Set the best render quality allowed, 0 for full
+  *   DIR                 Report the direction of rotation
+  *   DIR FWD|REV         Turn the wheel forwards or backwards at the same speed
+  *   CRANK               Report the engine start phase, speed and revolutions
+  *   CRANK START [c [r]] Start the engine from rest, c cylinders, r RPM starter
+  *   CRANK STOP          Return the speed to the potentiometer
+  *   SCN                 Report the scenario state, events applied and time
+  *   SCN BEGIN           Stop any scenario and start a new image upload
+  *   SCN D hex           Append image bytes, two hex digits each
+  *   SCN START           Check the image and play it from the start
+  *   SCN STOP            Stop the scenario and return the speed to the potentiometer
+  *
+  * An upload is staged and copied into whichever of two tables the output
+  * is not reading, so the waveform switches between two updates.
+  * REV ON and VCLK ON each turn the other mode off: both play through the
+  * DAC DMA stream. CRANK START turns both off, and either turns cranking
+  * off, as the start changes speed at every tooth. SCN START turns all
+  * three off, and each of them turns the scenario off. A scenario's
+  * SHAPE 1 is the uploaded waveform in use at SCN START.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_command.h"
+#include "vr_sensor_emulator.h"
+#include "vr_tooth_shape.h"
+#include "vr_config.h"
+#include "vr_revolution.h"
+#include "vr_vclock.h"
+#include "vr_qos.h"
+#include "vr_crank.h"
+#include "vr_scenario.h"
+#include "vr_tcm.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* USER CODE END Includes */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef void (*Command_Handler_t)(char *args, char *reply, uint32_t size);
+
+typedef struct {
+    const char *name;
+    Command_Handler_t handler;
+} Command_Entry_t;
+/* USER CODE END PTD */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static void VR_Command_Shape(char *args, char *reply, uint32_t size);
+static void VR_Command_Config(char *args, char *reply, uint32_t size);
+static void VR_Command_Rev(char *args, char *reply, uint32_t size);
+static void VR_Command_Vclk(char *args, char *reply, uint32_t size);
+static void VR_Command_Qos(char *args, char *reply, uint32_t size);
+static void VR_Command_Dir(char *args, char *reply, uint32_t size);
+static void VR_Command_Crank(char *args, char *reply, uint32_t size);
+static void VR_Command_Scn(char *args, char *reply, uint32_t size);
+static bool VR_Command_AppendHex(const char *hex);
+static char *VR_Command_NextWord(char **text);
+static bool VR_Command_Match(const char *word, const char *name);
+/* USER CODE END PFP */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static const Command_Entry_t commands[] = {
+    {"SHAPE", VR_Command_Shape},
+    {"CONFIG", VR_Command_Config},
+    {"REV", VR_Command_Rev},
+    {"VCLK", VR_Command_Vclk},
+    {"QOS", VR_Command_Qos},
+    {"DIR", VR_Command_Dir},
+    {"CRANK", VR_Command_Crank},
+    {"SCN", VR_Command_Scn},
+};
+
+// Line buffers, filled by the receive interrupt and released by the main loop
+static char lines[2][VR_COMMAND_LINE_MAX];
+static volatile bool line_ready[2] = {false, false};
+static bool line_overlong[2] = {false, false};
+static uint32_t rx_index = 0;
+static uint32_t rx_length = 0;
+static bool rx_discard = false;
+static uint32_t poll_index = 0;
+static volatile uint32_t lines_dropped = 0;
+
+// Shape upload in progress, and the two tables the output alternates between;
+// the output reads a table at every sample, so those live in DTCM
+static VR_ToothShape_t shape_staging;
+static VR_ShapeRegion_t shape_region = VR_SHAPE_REGULAR;
+static VR_ToothShape_t shape_tables[2] VR_DTCM_BSS;
+static uint32_t shape_next = 0;
+
+// Staging for CONFIG SAVE, too large for the main stack
+static VR_Config_t config_staging;
+
+// Scenario image, uploaded in place and read by the sample interrupt while it plays
+static uint32_t scenario_image[VR_SCENARIO_IMAGE_SIZE(VR_SCENARIO_MAX_EVENTS) / sizeof(uint32_t)];
+static uint32_t scenario_length = 0;
+/* USER CODE END PV */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Take one received byte; call from the USART3 receive interrupt
+  * @param  byte: Received byte
+  * @retval True if the byte completed a line for VR_Command_Poll()
+  */
+bool VR_Command_RxByte(uint8_t byte)
+{
+    bool end = (byte == '\r' || byte == '\n');
+
+    // Both buffers are waiting for the main loop: lose this whole line
+    if (line_ready[rx_index] || rx_discard) {
+        rx_discard = !end;
+        if (end) {
+            lines_dropped++;
+            rx_length = 0;
+        }
+        return false;
+    }
+
+    if (end) {
+        if (rx_length == 0) {
+            return false;
+        }
+        lines[rx_index][rx_length] = '\0';
+        line_ready[rx_index] = true;
+        rx_index ^= 1;
+        rx_length = 0;
+        return true;
+    }
+
+    if (rx_length + 1 < VR_COMMAND_LINE_MAX) {
+        lines[rx_index][rx_length++] = (char)byte;
+    } else {
+        line_overlong[rx_index] = true;
+    }
+    return false;
+}
+
+/**
+  * @brief  Execute the oldest received line; call from the main loop
+  * @param  reply: Filled with the reply line, CR LF terminated
+  * @param  size: Reply buffer size, at least VR_COMMAND_REPLY_MAX
+  * @retval True if a line was executed and a reply is ready
+  */
+bool VR_Command_Poll(char *reply, uint32_t size)
+{
+    uint32_t index = poll_index;
+
+    if (!line_ready[index]) {
+        return false;
+    }
+
+    if (line_overlong[index]) {
+        snprintf(reply, size, "ERR line too long\r\n");
+    } else {
+        VR_Command_Execute(lines[index], reply, size);
+    }
+
+    line_overlong[index] = false;
+    poll_index ^= 1;
+    line_ready[index] = false;
+    return true;
+}
+
+/**
+  * @brief  Execute one command line
+  * @param  line: Command text; modified while it is parsed
+  * @param  reply: Filled with the reply line, CR LF terminated
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+void VR_Command_Execute(char *line, char *reply, uint32_t size)
+{
+    char *word = VR_Command_NextWord(&line);
+
+    for (uint32_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (VR_Command_Match(word, commands[i].name)) {
+            commands[i].handler(line, reply, size);
+            return;
+        }
+    }
+
+    snprintf(reply, size, "ERR unknown command\r\n");
+}
+
+/**
+  * @brief  Lines lost because the main loop fell behind
+  * @retval Dropped lines since power-up
+  */
+uint32_t VR_Command_GetDropped(void)
+{
+    return lines_dropped;
+}
+
+/**
+  * @brief  Switch the default emulator to a tooth waveform
+  * @note   The shape is copied into whichever table the output is not
+  *         reading, so the caller's copy may be reused at once
+  * @param  shape: Valid waveform, or NULL for the built-in harmonic model
+  * @retval None
+  */
+void VR_Command_SelectShape(const VR_ToothShape_t *shape)
+{
+    if (shape == NULL) {
+        VR_Emulator_SetShape(NULL);
+        return;
+    }
+
+    // The output reads the other table until the pointer changes
+    shape_tables[shape_next] = *shape;
+    VR_Emulator_SetShape(&shape_tables[shape_next]);
+    shape_next ^= 1;
+}
+
+/**
+  * @brief  The scenario image uploaded so far
+  * @param  image: Set to the image bytes
+  * @retval Bytes uploaded, 0 if none
+  */
+uint32_t VR_Command_GetScenario(const void **image)
+{
+    *image = scenario_image;
+    return scenario_length;
+}
+
+/**
+  * @brief  Replace the uploaded scenario image, as SCN BEGIN and SCN D do
+  * @note   Stops any scenario playing; SCN START plays the new image
+  * @param  image: Image bytes, not checked until SCN START
+  * @param  length: Number of bytes
+  * @retval False if the image does not fit; the upload is then empty
+  */
+bool VR_Command_LoadScenario(const void *image, uint32_t length)
+{
+    VR_Scenario_End();
+    if (length > sizeof(scenario_image)) {
+        scenario_length = 0;
+        return false;
+    }
+    memcpy(scenario_image, image, length);
+    scenario_length = length;
+    return true;
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  SHAPE command: upload and select tooth waveforms
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Shape(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    const VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    if (*word == '\0') {
+        if (emu->shape != NULL) {
+            snprintf(reply, size, "OK SHAPE ON R=%u M=%u\r\n",
+                     emu->shape->length[VR_SHAPE_REGULAR], emu->shape->length[VR_SHAPE_MISSING]);
+        } else {
+            snprintf(reply, size, "OK SHAPE OFF\r\n");
+        }
+    } else if (VR_Command_Match(word, "BEGIN")) {
+        VR_Shape_Clear(&shape_staging);
+        shape_region = VR_SHAPE_REGULAR;
+        snprintf(reply, size, "OK\r\n");
+    } else if (VR_Command_Match(word, "END")) {
+        if (!VR_Shape_IsValid(&shape_staging)) {
+            snprintf(reply, size, "ERR need %d levels per table\r\n", VR_SHAPE_MIN_POINTS);
+            return;
+        }
+        VR_Command_SelectShape(&shape_staging);
+        snprintf(reply, size, "OK R=%u M=%u\r\n",
+                 shape_staging.length[VR_SHAPE_REGULAR], shape_staging.length[VR_SHAPE_MISSING]);
+    } else if (VR_Command_Match(word, "OFF")) {
+        VR_Command_SelectShape(NULL);
+        snprintf(reply, size, "OK\r\n");
+    } else if (VR_Shape_Parse(&shape_staging, &shape_region, word) &&
+               VR_Shape_Parse(&shape_staging, &shape_region, rest)) {
+        snprintf(reply, size, "OK R=%u M=%u\r\n",
+                 shape_staging.length[VR_SHAPE_REGULAR], shape_staging.length[VR_SHAPE_MISSING]);
+    } else {
+        snprintf(reply, size, "ERR bad level or table full\r\n");
+    }
+}
+
+/**
+  * @brief  CONFIG command: save the running configuration to flash
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Config(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    VR_ConfigStats_t stats;
+    bool ok;
+
+    if (*word == '\0') {
+        VR_Config_GetStats(&stats);
+        snprintf(reply, size, "OK CONFIG SECTOR=%lu SEQ=%lu USED=%lu ERASES=%lu/%lu\r\n",
+                 (unsigned long)stats.sector, (unsigned long)stats.sequence, (unsigned long)stats.used,
+                 (unsigned long)stats.erases[0], (unsigned long)stats.erases[1]);
+        return;
+    } else if (VR_Command_Match(word, "SAVE")) {
+        VR_Config_Capture(&config_staging);
+        ok = VR_Config_Save(&config_staging);
+    } else if (VR_Command_Match(word, "CLEAR")) {
+        ok = VR_Config_Clear();
+    } else {
+        snprintf(reply, size, "ERR unknown CONFIG command\r\n");
+        return;
+    }
+
+    if (ok) {
+        VR_Config_GetStats(&stats);
+        snprintf(reply, size, "OK SEQ=%lu\r\n", (unsigned long)stats.sequence);
+    } else {
+        snprintf(reply, size, "ERR flash write failed\r\n");
+    }
+}
+
+/**
+  * @brief  REV command: switch the revolution output mode
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Rev(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    VR_RevStats_t stats;
+
+    if (*word == '\0') {
+        VR_Rev_GetStats(&stats);
+        snprintf(reply, size, "OK REV %s LEN=%lu TOOTH=%lu REVS=%lu SWAPS=%lu\r\n",
+                 VR_Rev_IsEnabled() ? "ON" : "OFF", (unsigned long)stats.length,
+                 (unsigned long)stats.tooth_period_us, (unsigned long)stats.revolutions,
+                 (unsigned long)stats.swaps);
+    } else if (VR_Command_Match(word, "ON")) {
+        VR_Crank_End();
+        VR_Scenario_End();
+        VR_Vclk_Stop();
+        VR_Rev_Start();
+        snprintf(reply, size, "OK REV ON\r\n");
+    } else if (VR_Command_Match(word, "OFF")) {
+        VR_Rev_Stop();
+        snprintf(reply, size, "OK REV OFF\r\n");
+    } else {
+        snprintf(reply, size, "ERR unknown REV command\r\n");
+    }
+}
+
+/**
+  * @brief  VCLK command: switch the variable sample clock output mode
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Vclk(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    VR_VclkStats_t stats;
+
+    if (*word == '\0') {
+        VR_Vclk_GetStats(&stats);
+        snprintf(reply, size, "OK VCLK %s RPM=%u TOOTH=%lu STEP=%lu REVS=%lu\r\n",
+                 VR_Vclk_IsEnabled() ? "ON" : "OFF", stats.rpm, (unsigned long)stats.tooth_ticks,
+                 (unsigned long)stats.step_mrpm, (unsigned long)stats.revolutions);
+    } else if (VR_Command_Match(word, "ON")) {
+        VR_Crank_End();
+        VR_Scenario_End();
+        VR_Rev_Stop();
+        VR_Vclk_Start();
+        snprintf(reply, size, "OK VCLK ON\r\n");
+    } else if (VR_Command_Match(word, "OFF")) {
+        VR_Vclk_Stop();
+        snprintf(reply, size, "OK VCLK OFF\r\n");
+    } else {
+        snprintf(reply, size, "ERR unknown VCLK command\r\n");
+    }
+}
+
+/**
+  * @brief  QOS command: report or limit the render quality
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Qos(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    VR_QosStats_t stats;
+
+    if (*word == '\0') {
+        VR_QoS_GetStats(&stats);
+        snprintf(reply, size, "OK QOS LEVEL=%u FLOOR=%u WORST=%u DOWN=%lu UP=%lu LOST=%lu\r\n",
+                 stats.level, stats.floor, stats.worst, (unsigned long)stats.steps_down,
+                 (unsigned long)stats.steps_up,
+                 (unsigned long)(stats.overruns + stats.underruns + stats.merged));
+    } else if (word[0] >= '0' && word[0] < '0' + VR_QUALITY_LEVELS && word[1] == '\0') {
+        VR_QoS_SetFloor((VR_Quality_t)(word[0] - '0'));
+        snprintf(reply, size, "OK QOS FLOOR=%c\r\n", word[0]);
+    } else {
+        snprintf(reply, size, "ERR unknown QOS command\r\n");
+    }
+}
+
+/**
+  * @brief  DIR command: report or set the direction of rotation
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Dir(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+
+    if (*word == '\0') {
+        snprintf(reply, size, "OK DIR %s RPM=%ld\r\n",
+                 VR_Emulator_GetDefault()->state.reverse ? "REV" : "FWD", (long)VR_Emulator_GetSpeed());
+    } else if (VR_Command_Match(word, "FWD")) {
+        VR_Emulator_SetReverse(false);
+        snprintf(reply, size, "OK DIR FWD\r\n");
+    } else if (VR_Command_Match(word, "REV")) {
+        VR_Emulator_SetReverse(true);
+        snprintf(reply, size, "OK DIR REV\r\n");
+    } else {
+        snprintf(reply, size, "ERR unknown DIR command\r\n");
+    }
+}
+
+/**
+  * @brief  CRANK command: run or report an engine start
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Crank(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    const VR_Crank_t *crank = VR_Crank_GetDefault();
+
+    if (*word == '\0') {
+        snprintf(reply, size, "OK CRANK %s RPM=%u REVS=%lu T=%lu\r\n",
+                 VR_Crank_PhaseName(crank->phase), crank->rpm, (unsigned long)crank->revolutions,
+                 (unsigned long)(crank->time_us / 1000u));
+    } else if (VR_Command_Match(word, "START")) {
+        VR_CrankConfig_t config;
+        char *cylinders = VR_Command_NextWord(&rest);
+        char *starter = VR_Command_NextWord(&rest);
+
+        VR_Crank_DefaultConfig(&config);
+        if (*cylinders != '\0') {
+            config.cylinders = (uint8_t)strtoul(cylinders, NULL, 10);
+        }
+        if (*starter != '\0') {
+            config.starter_rpm = (uint16_t)strtoul(starter, NULL, 10);
+        }
+        if (!VR_Crank_IsValid(&config)) {
+            snprintf(reply, size, "ERR bad cylinders or starter RPM\r\n");
+            return;
+        }
+        VR_Scenario_End();
+        VR_Rev_Stop();
+        VR_Vclk_Stop();
+        VR_Crank_Begin(&config);
+        snprintf(reply, size, "OK CRANK START CYL=%u RPM=%u\r\n", config.cylinders, config.starter_rpm);
+    } else if (VR_Command_Match(word, "STOP")) {
+        VR_Crank_End();
+        snprintf(reply, size, "OK CRANK STOP\r\n");
+    } else {
+        snprintf(reply, size, "ERR unknown CRANK command\r\n");
+    }
+}
+
+/**
+  * @brief  SCN command: upload and play a compiled scenario
+  * @param  args: Text after the command word
+  * @param  reply: Reply buffer
+  * @param  size: Reply buffer size
+  * @retval None
+  */
+static void VR_Command_Scn(char *args, char *reply, uint32_t size)
+{
+    char *rest = args;
+    char *word = VR_Command_NextWord(&rest);
+    const VR_Scenario_t *scn = VR_Scenario_GetDefault();
+
+    if (*word == '\0') {
+        snprintf(reply, size, "OK SCN %s EV=%lu/%lu T=%lu FAULTS=%lu\r\n",
+                 VR_Scenario_IsRunning() ? "RUN" : "STOP", (unsigned long)scn->applied,
+                 (unsigned long)scn->count, (unsigned long)(scn->tick / (VR_SAMPLE_TIMER_BASE_FREQ / 1000)),
+                 (unsigned long)scn->faults);
+    } else if (VR_Command_Match(word, "BEGIN")) {
+        VR_Scenario_End();
+        scenario_length = 0;
+        snprintf(reply, size, "OK\r\n");
+    } else if (VR_Command_Match(word, "D")) {
+        VR_Scenario_End();
+        if (!VR_Command_AppendHex(VR_Command_NextWord(&rest))) {
+            snprintf(reply, size, "ERR bad hex or image full\r\n");
+            return;
+        }
+        snprintf(reply, size, "OK LEN=%lu\r\n", (unsigned long)scenario_length);
+    } else if (VR_Command_Match(word, "START")) {
+        VR_Crank_End();
+        VR_Rev_Stop();
+        VR_Vclk_Stop();
+        if (!VR_Scenario_Begin(scenario_image, scenario_length, VR_Emulator_GetDefault()->shape)) {
+            snprintf(reply, size, "ERR bad scenario image\r\n");
+            return;
+        }
+        snprintf(reply, size, "OK SCN START EV=%lu T=%lu\r\n", (unsigned long)scn->count,
+                 (unsigned long)(scn->duration / (VR_SAMPLE_TIMER_BASE_FREQ / 1000)));
+    } else if (VR_Command_Match(word, "STOP")) {
+        VR_Scenario_End();
+        snprintf(reply, size, "OK SCN STOP\r\n");
+    } else {
+        snprintf(reply, size, "ERR unknown SCN command\r\n");
+    }
+}
+
+/**
+  * @brief  Append hex-encoded bytes to the scenario image
+  * @param  hex: Pairs of hex digits
+  * @retval False if a digit is bad or the image would overflow; nothing is appended
+  */
+static bool VR_Command_AppendHex(const char *hex)
+{
+    uint32_t digits = (uint32_t)strlen(hex);
+    uint8_t *image = (uint8_t *)scenario_image;
+
+    if (digits == 0 || digits % 2u != 0 || scenario_length + digits / 2u > sizeof(scenario_image)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < digits; i++) {
+        if (!isxdigit((unsigned char)hex[i])) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < digits; i += 2u) {
+        char pair[3] = {hex[i], hex[i + 1], '\0'};
+        image[scenario_length++] = (uint8_t)strtoul(pair, NULL, 16);
+    }
+    return true;
+}
+
+/**
+  * @brief  Split off the next word
+  * @param  text: Position in the line; advanced past the word
+  * @retval The word, empty at the end of the line
+  */
+static char *VR_Command_NextWord(char **text)
+{
+    char *p = *text;
+
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    char *word = p;
+    while (*p != '\0' && *p != ' ' && *p != '\t') {
+        p++;
+    }
+
+    // Terminate the word; the rest of the line follows it
+    *text = p;
+    if (*p != '\0') {
+        *p = '\0';
+        (*text)++;
+    }
+    return word;
+}
+
+/**
+  * @brief  Compare a word with a command name, ignoring case
+  * @param  word: Word from the line
+  * @param  name: Upper-case name
+  * @retval True if they match
+  */
+static bool VR_Command_Match(const char *word, const char *name)
+{
+    while (*word != '\0' && toupper((unsigned char)*word) == *name) {
+        word++;
+        name++;
+    }
+    return *word == '\0' && *name == '\0';
+}
+
+/* USER CODE END 1 */
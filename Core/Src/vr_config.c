@@ -0,0 +1,606 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_config.c
+  * @brief          : Configuration store in flash
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * Each sector starts with a header: a magic number, a generation that
+  * grows with every sector change, the sector's erase count and a CRC.
+  * The records follow it back to back, each a 16-byte header with its own
+  * CRC and the CRC of its payload, padded to whole words. Erased flash
+  * after the last record is where the next one goes.
+  *
+  * At boot the sector with the newest valid header is active. The scan
+  * walks its record headers only, and checks the payload of the newest
+  * record, so it takes the same short time however full the sector is.
+  * A power loss while a record is written can only damage that record:
+  * if its header is torn the scan stops there, and if its payload is torn
+  * the record before it is used instead. Either way the next save moves
+  * to the other sector.
+  *
+  * When the active sector has no room, the other one is erased and gets
+  * the new record first and its header last. Until the header is written
+  * the old sector stays active, so a power loss during the change keeps
+  * the previous configuration.
+  *
+  * A settings record holds a VR_Config_t up to the end of the uploaded
+  * scenario bytes; the rest of the image is not written. Records saved
+  * before the gain, noise, fault and scenario fields end after the shape,
+  * and load with those flags clear.
+  *
+  * A save is skipped if the newest record already holds the same data.
+  * While the flash is programmed or erased, reads from it stall, and so
+  * does every interrupt whose vector or code is in flash.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_config.h"
+#include "vr_command.h"
+#include "vr_sensor_emulator.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <stddef.h>
+#include <string.h>
+/* USER CODE END Includes */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    uint32_t magic;                 // CONFIG_SECTOR_MAGIC
+    uint32_t generation;            // Newest sector has the highest
+    uint32_t erases;                // Times this sector has been erased
+    uint32_t crc;                   // Over the fields above
+} Config_Sector_t;
+
+typedef struct {
+    uint16_t type;                  // CONFIG_RECORD_*
+    uint16_t length;                // Payload bytes, before padding
+    uint32_t sequence;              // Grows with every record written
+    uint32_t payload_crc;
+    uint32_t header_crc;            // Over the fields above
+} Config_Record_t;
+/* USER CODE END PTD */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define CONFIG_SECTOR_MAGIC         0x46435256u     // "VRCF"
+#define CONFIG_RECORD_SETTINGS      0x0001u         // Payload is a VR_Config_t
+#define CONFIG_RECORD_DEFAULTS      0x0002u         // No payload: use the built-in defaults
+#define CONFIG_NO_SECTOR            0xFFFFFFFFu
+#define CONFIG_FIRST_RECORD         ((uint32_t)sizeof(Config_Sector_t))
+
+/* Payload length rounded up to whole flash words */
+#define CONFIG_PADDED(length)       (((length) + 3u) & ~3u)
+
+/* Flash as the CPU reads it */
+#if !defined(VR_HOST_SIM)
+#define CONFIG_FLASH(address)       ((const uint8_t *)(address))
+#else
+#define CONFIG_FLASH(address)       Host_Flash_Map(address)
+#endif
+/* USER CODE END PD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static const uint32_t crc_nibble[16] = {
+    0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu,
+    0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+    0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu,
+    0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+};
+
+static uint32_t active = CONFIG_NO_SECTOR;  // Index of the active sector, 0 or 1
+static uint32_t generation = 0;
+static uint32_t erases[2] = {0, 0};
+static uint32_t append = VR_CONFIG_SECTOR_SIZE; // Offset of the next record
+static uint32_t latest = 0;                 // Offset of the newest valid record, 0 if none
+static uint32_t records = 0;
+static uint32_t sequence = 0;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static uint16_t Config_Length(const VR_Config_t *config);
+static uint32_t Config_Address(uint32_t sector, uint32_t offset);
+static bool Config_ReadSector(uint32_t sector, Config_Sector_t *header);
+static void Config_Scan(uint32_t sector);
+static bool Config_IsErased(uint32_t address, uint32_t length);
+static bool Config_ReadRecord(uint32_t sector, uint32_t offset, Config_Record_t *record);
+static bool Config_CheckPayload(uint32_t sector, uint32_t offset);
+static bool Config_IsLatest(uint16_t type, const void *payload, uint16_t length);
+static bool Config_Append(uint16_t type, const void *payload, uint16_t length);
+static bool Config_Write(uint32_t sector, uint32_t offset, uint16_t type,
+                         const void *payload, uint16_t length);
+static bool Config_Format(uint32_t sector, uint16_t type, const void *payload, uint16_t length);
+static bool Config_Program(uint32_t address, const void *data, uint32_t length);
+static void Config_Invalidate(uint32_t address, uint32_t length);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Find the active sector and its newest valid record
+  * @note   Call once at boot, before VR_Config_Load()
+  * @retval None
+  */
+void VR_Config_Init(void)
+{
+    Config_Sector_t headers[2];
+    bool valid[2];
+
+    active = CONFIG_NO_SECTOR;
+    generation = 0;
+    append = VR_CONFIG_SECTOR_SIZE;
+    latest = 0;
+    records = 0;
+    sequence = 0;
+
+    for (uint32_t i = 0; i < 2; i++) {
+        valid[i] = Config_ReadSector(i, &headers[i]);
+        erases[i] = valid[i] ? headers[i].erases : 0;
+    }
+
+    if (valid[0] && (!valid[1] || (int32_t)(headers[0].generation - headers[1].generation) > 0)) {
+        active = 0;
+    } else if (valid[1]) {
+        active = 1;
+    } else {
+        return;
+    }
+
+    generation = headers[active].generation;
+    Config_Scan(active);
+}
+
+/**
+  * @brief  Read the saved configuration
+  * @param  config: Filled with the saved configuration
+  * @retval False if nothing valid is saved, or the defaults were saved last
+  */
+bool VR_Config_Load(VR_Config_t *config)
+{
+    Config_Record_t record;
+
+    if (latest == 0 || !Config_ReadRecord(active, latest, &record)
+        || record.type != CONFIG_RECORD_SETTINGS || record.length < offsetof(VR_Config_t, amplitude)) {
+        return false;
+    }
+
+    memset(config, 0, sizeof(*config));
+    memcpy(config, CONFIG_FLASH(Config_Address(active, latest + sizeof(record))), record.length);
+    return true;
+}
+
+/**
+  * @brief  Save a configuration, to be restored at the next boot
+  * @note   Blocks while the flash is written, and for a sector erase when
+  *         the active sector is full
+  * @param  config: Configuration
+  * @retval True if saved, or already the saved configuration
+  */
+bool VR_Config_Save(const VR_Config_t *config)
+{
+    return Config_Append(CONFIG_RECORD_SETTINGS, config, Config_Length(config));
+}
+
+/**
+  * @brief  Return to the built-in defaults at the next boot
+  * @retval True if recorded
+  */
+bool VR_Config_Clear(void)
+{
+    return Config_Append(CONFIG_RECORD_DEFAULTS, NULL, 0);
+}
+
+/**
+  * @brief  Take the configuration the default emulator is running with
+  * @param  config: Filled with the configuration
+  * @retval None
+  */
+void VR_Config_Capture(VR_Config_t *config)
+{
+    const VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    const void *image;
+    uint32_t length = VR_Command_GetScenario(&image);
+
+    // Cleared whole, so equal settings give equal records
+    memset(config, 0, sizeof(*config));
+    if (emu->shape != NULL) {
+        config->flags |= VR_CONFIG_SHAPE;
+        config->shape = *emu->shape;
+    }
+
+    config->flags |= VR_CONFIG_GAIN | VR_CONFIG_NOISE | VR_CONFIG_FAULT;
+    config->amplitude = emu->amplitude;
+    config->noise_lsb = emu->noise_lsb;
+    config->noise_seed = emu->noise_seed;
+    config->fault = emu->fault;
+
+    if (length > 0 && length <= sizeof(config->scenario)) {
+        config->flags |= VR_CONFIG_SCENARIO;
+        config->scenario_length = length;
+        memcpy(config->scenario, image, length);
+    }
+}
+
+/**
+  * @brief  Run the default emulator with a configuration
+  * @note   The scenario image is uploaded, not started; SCN START plays it
+  * @param  config: Configuration; a setting whose flag is clear, or an
+  *         invalid shape, returns to the built-in default
+  * @retval None
+  */
+void VR_Config_Apply(const VR_Config_t *config)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    bool shape = (config->flags & VR_CONFIG_SHAPE) != 0 && VR_Shape_IsValid(&config->shape);
+    bool gain = (config->flags & VR_CONFIG_GAIN) != 0;
+    bool noise = (config->flags & VR_CONFIG_NOISE) != 0;
+    bool fault = (config->flags & VR_CONFIG_FAULT) != 0;
+    bool scenario = (config->flags & VR_CONFIG_SCENARIO) != 0
+                 && config->scenario_length <= sizeof(config->scenario);
+
+    VR_Command_SelectShape(shape ? &config->shape : NULL);
+    VR_Emu_SetAmplitude(emu, gain ? config->amplitude : VR_AMPLITUDE_FULL);
+    VR_Emu_SetNoise(emu, noise ? config->noise_lsb : 0, noise ? config->noise_seed : 0);
+    VR_Emu_SetFault(emu, fault ? (VR_Fault_t)config->fault : VR_FAULT_NONE);
+    VR_Command_LoadScenario(config->scenario, scenario ? config->scenario_length : 0);
+}
+
+/**
+  * @brief  Read the state of the store
+  * @param  stats: Filled with the store state
+  * @retval None
+  */
+void VR_Config_GetStats(VR_ConfigStats_t *stats)
+{
+    bool none = (active == CONFIG_NO_SECTOR);
+
+    stats->sector = none ? 0 : VR_CONFIG_FIRST_SECTOR + active;
+    stats->used = none ? 0 : append;
+    stats->records = records;
+    stats->sequence = sequence;
+    stats->erases[0] = erases[0];
+    stats->erases[1] = erases[1];
+}
+
+/**
+  * @brief  CRC-32 (IEEE 802.3, reflected, as zlib computes it)
+  * @param  data: Bytes
+  * @param  length: Number of bytes
+  * @retval CRC
+  */
+uint32_t VR_Config_Crc32(const void *data, uint32_t length)
+{
+    const uint8_t *bytes = data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0Fu];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0x0Fu];
+    }
+    return ~crc;
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Payload bytes of a settings record
+  * @param  config: Configuration
+  * @retval Size up to the end of the uploaded scenario bytes
+  */
+static uint16_t Config_Length(const VR_Config_t *config)
+{
+    uint32_t length = offsetof(VR_Config_t, scenario);
+
+    if ((config->flags & VR_CONFIG_SCENARIO) != 0 && config->scenario_length <= sizeof(config->scenario)) {
+        length += config->scenario_length;
+    }
+    return (uint16_t)length;
+}
+
+/**
+  * @brief  Flash address of an offset in one of the two sectors
+  * @param  sector: Sector index, 0 or 1
+  * @param  offset: Bytes from the sector start
+  * @retval Flash address
+  */
+static uint32_t Config_Address(uint32_t sector, uint32_t offset)
+{
+    return VR_CONFIG_SECTOR_ADDRESS(VR_CONFIG_FIRST_SECTOR + sector) + offset;
+}
+
+/**
+  * @brief  Read and check a sector header
+  * @param  sector: Sector index, 0 or 1
+  * @param  header: Filled with the header
+  * @retval True if the header is valid
+  */
+static bool Config_ReadSector(uint32_t sector, Config_Sector_t *header)
+{
+    memcpy(header, CONFIG_FLASH(Config_Address(sector, 0)), sizeof(*header));
+
+    return header->magic == CONFIG_SECTOR_MAGIC
+        && header->crc == VR_Config_Crc32(header, offsetof(Config_Sector_t, crc));
+}
+
+/**
+  * @brief  Walk the records of a sector, find the append position and the
+  *         newest record with a valid payload
+  * @param  sector: Sector index, 0 or 1
+  * @retval None
+  */
+static void Config_Scan(uint32_t sector)
+{
+    uint32_t offset = CONFIG_FIRST_RECORD;
+    uint32_t newest = 0;
+    uint32_t previous = 0;
+    Config_Record_t record;
+
+    // Full unless erased flash is found; a torn header also ends the walk
+    append = VR_CONFIG_SECTOR_SIZE;
+    while (offset <= VR_CONFIG_SECTOR_SIZE - sizeof(record)) {
+        if (Config_IsErased(Config_Address(sector, offset), sizeof(record))) {
+            append = offset;
+            break;
+        }
+        if (!Config_ReadRecord(sector, offset, &record)) {
+            break;
+        }
+
+        records++;
+        sequence = record.sequence;
+        previous = newest;
+        newest = offset;
+        offset += sizeof(record) + CONFIG_PADDED(record.length);
+    }
+
+    // Only the newest record can have a torn payload
+    if (newest != 0 && Config_CheckPayload(sector, newest)) {
+        latest = newest;
+        return;
+    }
+    append = VR_CONFIG_SECTOR_SIZE;
+    if (previous != 0 && Config_CheckPayload(sector, previous)) {
+        latest = previous;
+    }
+}
+
+/**
+  * @brief  Check that flash is erased
+  * @param  address: Flash address
+  * @param  length: Number of bytes
+  * @retval True if every byte is 0xFF
+  */
+static bool Config_IsErased(uint32_t address, uint32_t length)
+{
+    const uint8_t *bytes = CONFIG_FLASH(address);
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (bytes[i] != 0xFFu) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Read and check a record header
+  * @param  sector: Sector index, 0 or 1
+  * @param  offset: Record offset in the sector
+  * @param  record: Filled with the header
+  * @retval True if the header is valid and the record fits the sector
+  */
+static bool Config_ReadRecord(uint32_t sector, uint32_t offset, Config_Record_t *record)
+{
+    memcpy(record, CONFIG_FLASH(Config_Address(sector, offset)), sizeof(*record));
+
+    return record->header_crc == VR_Config_Crc32(record, offsetof(Config_Record_t, header_crc))
+        && record->length <= sizeof(VR_Config_t)
+        && sizeof(*record) + CONFIG_PADDED(record->length) <= VR_CONFIG_SECTOR_SIZE - offset;
+}
+
+/**
+  * @brief  Check a record's payload against its CRC
+  * @param  sector: Sector index, 0 or 1
+  * @param  offset: Offset of a record with a valid header
+  * @retval True if the payload is intact
+  */
+static bool Config_CheckPayload(uint32_t sector, uint32_t offset)
+{
+    Config_Record_t record;
+
+    Config_ReadRecord(sector, offset, &record);
+    return record.payload_crc
+        == VR_Config_Crc32(CONFIG_FLASH(Config_Address(sector, offset + sizeof(record))), record.length);
+}
+
+/**
+  * @brief  Compare a record with the newest one
+  * @param  type: CONFIG_RECORD_*
+  * @param  payload: Payload, NULL if length is 0
+  * @param  length: Payload bytes
+  * @retval True if the newest record holds the same
+  */
+static bool Config_IsLatest(uint16_t type, const void *payload, uint16_t length)
+{
+    Config_Record_t record;
+
+    if (latest == 0) {
+        return false;
+    }
+    Config_ReadRecord(active, latest, &record);
+    return record.type == type && record.length == length
+        && (length == 0
+            || memcmp(CONFIG_FLASH(Config_Address(active, latest + sizeof(record))), payload, length) == 0);
+}
+
+/**
+  * @brief  Add a record, moving to the other sector if there is no room
+  * @param  type: CONFIG_RECORD_*
+  * @param  payload: Payload, NULL if length is 0
+  * @param  length: Payload bytes
+  * @retval True if the record is the newest valid one
+  */
+static bool Config_Append(uint16_t type, const void *payload, uint16_t length)
+{
+    uint32_t size = sizeof(Config_Record_t) + CONFIG_PADDED(length);
+    bool ok;
+
+    if (Config_IsLatest(type, payload, length)) {
+        return true;
+    }
+
+    HAL_FLASH_Unlock();
+    if (active != CONFIG_NO_SECTOR && size <= VR_CONFIG_SECTOR_SIZE - append) {
+        ok = Config_Write(active, append, type, payload, length);
+        if (ok) {
+            latest = append;
+            append += size;
+            records++;
+            sequence++;
+        } else {
+            // Do not write after a damaged record; the next save changes sector
+            append = VR_CONFIG_SECTOR_SIZE;
+        }
+    } else {
+        ok = Config_Format((active == CONFIG_NO_SECTOR) ? 0 : active ^ 1u, type, payload, length);
+    }
+    HAL_FLASH_Lock();
+
+    return ok;
+}
+
+/**
+  * @brief  Program one record and read it back
+  * @param  sector: Sector index, 0 or 1
+  * @param  offset: Erased space for the record
+  * @param  type: CONFIG_RECORD_*
+  * @param  payload: Payload, NULL if length is 0
+  * @param  length: Payload bytes
+  * @retval True if the record reads back valid
+  */
+static bool Config_Write(uint32_t sector, uint32_t offset, uint16_t type,
+                         const void *payload, uint16_t length)
+{
+    Config_Record_t record = {
+        .type = type,
+        .length = length,
+        .sequence = sequence + 1u,
+        .payload_crc = VR_Config_Crc32(payload, length),
+    };
+    uint32_t address = Config_Address(sector, offset);
+    Config_Record_t check;
+
+    record.header_crc = VR_Config_Crc32(&record, offsetof(Config_Record_t, header_crc));
+
+    // Header first: a torn payload then leaves the walk intact
+    bool ok = Config_Program(address, &record, sizeof(record))
+           && Config_Program(address + sizeof(record), payload, length);
+    Config_Invalidate(address, sizeof(record) + length);
+
+    return ok && Config_ReadRecord(sector, offset, &check)
+        && memcmp(&check, &record, sizeof(record)) == 0 && Config_CheckPayload(sector, offset);
+}
+
+/**
+  * @brief  Erase a sector and make it active with one record
+  * @param  sector: Sector index, 0 or 1
+  * @param  type: CONFIG_RECORD_*
+  * @param  payload: Payload, NULL if length is 0
+  * @param  length: Payload bytes
+  * @retval True if the sector is now active
+  */
+static bool Config_Format(uint32_t sector, uint16_t type, const void *payload, uint16_t length)
+{
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Sector = VR_CONFIG_FIRST_SECTOR + sector,
+        .NbSectors = 1,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+    };
+    uint32_t sector_error;
+
+    if (HAL_FLASHEx_Erase(&erase, &sector_error) != HAL_OK) {
+        return false;
+    }
+    erases[sector]++;
+    Config_Invalidate(Config_Address(sector, 0), VR_CONFIG_SECTOR_SIZE);
+
+    // The header goes last; until then the old sector stays active
+    if (!Config_Write(sector, CONFIG_FIRST_RECORD, type, payload, length)) {
+        return false;
+    }
+
+    Config_Sector_t header = {
+        .magic = CONFIG_SECTOR_MAGIC,
+        .generation = generation + 1u,
+        .erases = erases[sector],
+    };
+    header.crc = VR_Config_Crc32(&header, offsetof(Config_Sector_t, crc));
+
+    bool ok = Config_Program(Config_Address(sector, 0), &header, sizeof(header));
+    Config_Invalidate(Config_Address(sector, 0), sizeof(header));
+    if (!ok || !Config_ReadSector(sector, &header)) {
+        return false;
+    }
+
+    active = sector;
+    generation = header.generation;
+    latest = CONFIG_FIRST_RECORD;
+    append = CONFIG_FIRST_RECORD + sizeof(Config_Record_t) + CONFIG_PADDED(length);
+    records = 1;
+    sequence++;
+    return true;
+}
+
+/**
+  * @brief  Program bytes a word at a time, padding the last word with 0xFF
+  * @param  address: Word-aligned flash address
+  * @param  data: Bytes
+  * @param  length: Number of bytes
+  * @retval True if every word was programmed
+  */
+static bool Config_Program(uint32_t address, const void *data, uint32_t length)
+{
+    const uint8_t *bytes = data;
+
+    for (uint32_t i = 0; i < length; i += 4u) {
+        uint32_t word = 0xFFFFFFFFu;
+
+        memcpy(&word, bytes + i, (length - i < 4u) ? length - i : 4u);
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + i, word) != HAL_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Drop cached copies of flash that was just written
+  * @param  address: Flash address
+  * @param  length: Number of bytes
+  * @retval None
+  */
+static void Config_Invalidate(uint32_t address, uint32_t length)
+{
+    uint32_t start = address & ~(32u - 1u);
+    uint32_t end = (address + length + 32u - 1u) & ~(32u - 1u);
+
+    SCB_InvalidateDCache_by_Addr((uint32_t *)(uintptr_t)CONFIG_FLASH(start), (int32_t)(end - start));
+}
+
+/* USER CODE END 1 */
@@ -0,0 +1,255 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_counters.c
+  * @brief          : Output and activity counters
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The output is counted where a level is handed to the DAC: the TIM6
+  * top half reports each sample, and in revolution and variable clock
+  * modes the DMA transfer interrupts report the samples played since the
+  * last report. Teeth are counted from the change of tooth between two
+  * reports, and a revolution each time the tooth number wraps, in either
+  * direction. A change of direction starts a new reference. The TIM2
+  * count of that report is kept, so the time between two wraps is the
+  * length of one revolution, measured on the output itself.
+  *
+  * Each counter is written by one context only and is a single word, so
+  * the writer just stores the new value. Faults may be reported from
+  * anywhere and use an atomic add instead. VR_Counters_Snapshot() reads
+  * every counter, then reads them again until two passes agree. Every
+  * write grows at least one counter, so two equal passes had no write
+  * between them.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_counters.h"
+#include "vr_qos.h"
+#include "vr_digital_output.h"
+#include "vr_tcm.h"
+#include "vr_format.h"
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    uint32_t samples;
+    uint32_t teeth;
+    uint32_t revolutions;
+    uint32_t revolution_ticks;
+    uint32_t wrap_count;            // TIM2 count at the last wrap to tooth 0
+    uint32_t faults;
+    uint32_t overruns;
+    uint32_t underruns;
+    uint32_t adc;
+} Counters_Raw_t;
+/* USER CODE END PTD */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+// Milli-RPM times TIM2 ticks per revolution
+#define COUNTERS_MRPM_TICKS         (60ull * VR_DIGITAL_TIMER_CLOCK * 1000ull)
+/* USER CODE END PD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+extern TIM_HandleTypeDef htim2;
+
+// Written by the sample interrupts
+static volatile uint32_t counters_samples VR_DTCM_BSS = 0;
+static volatile uint32_t counters_teeth VR_DTCM_BSS = 0;
+static volatile uint32_t counters_revolutions VR_DTCM_BSS = 0;
+static volatile uint32_t counters_revolution_ticks VR_DTCM_BSS = 0;
+static volatile uint32_t counters_wrap_count VR_DTCM_BSS = 0;
+static uint8_t counters_tooth VR_DTCM_BSS = 0;         // Tooth at the last report
+static bool counters_anchored VR_DTCM_BSS = false;     // counters_tooth is valid
+static bool counters_timed VR_DTCM_BSS = false;        // counters_wrap_count is valid
+static bool counters_reverse VR_DTCM_BSS = false;      // Direction at the last report
+
+// Written by the potentiometer DMA interrupt
+static volatile uint32_t counters_adc = 0;
+
+// Written from any context
+static volatile uint32_t counters_faults = 0;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static void Counters_Collect(Counters_Raw_t *raw);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Count output samples and the teeth they moved through
+  * @note   Call from the TIM6 top half, or from the DMA transfer interrupt
+  *         that stands in for it, with the state the output reached
+  * @param  state: Emulator state after the samples
+  * @param  count: TIM2 count at the last of them
+  * @param  samples: Samples output since the last report
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Counters_Output(const VR_SensorState_t *state, uint32_t count, uint32_t samples)
+{
+    uint8_t tooth = state->current_tooth;
+    uint8_t from = counters_tooth;
+
+    counters_samples += samples;
+    if (!counters_anchored || state->reverse != counters_reverse) {
+        counters_tooth = tooth;
+        counters_reverse = state->reverse;
+        counters_anchored = true;
+        counters_timed = false;
+        return;
+    }
+    if (tooth == from) {
+        return;
+    }
+
+    // Backwards the teeth count down; swapped, the same arithmetic applies
+    if (state->reverse) {
+        from = tooth;
+        tooth = counters_tooth;
+    }
+    if (tooth > from) {
+        counters_teeth += tooth - from;
+    } else {
+        counters_teeth += tooth + TRIGGER_WHEEL_TEETH - from;
+        if (counters_timed) {
+            counters_revolution_ticks = count - counters_wrap_count;
+        }
+        counters_wrap_count = count;
+        counters_timed = true;
+        counters_revolutions++;
+    }
+    counters_tooth = state->current_tooth;
+}
+
+/**
+  * @brief  The output restarts at another phase
+  * @note   Call with the sample interrupts stopped. The next report only
+  *         sets the tooth reference, and the revolution timing restarts.
+  * @retval None
+  */
+void VR_Counters_PhaseJump(void)
+{
+    counters_anchored = false;
+}
+
+/**
+  * @brief  Count a potentiometer conversion
+  * @note   Call from the ADC1 conversion complete callback
+  * @retval None
+  */
+void VR_Counters_AdcUpdate(void)
+{
+    counters_adc++;
+}
+
+/**
+  * @brief  Count a fault injected into the output
+  * @note   Safe from any context
+  * @retval None
+  */
+void VR_Counters_Fault(void)
+{
+    __atomic_fetch_add(&counters_faults, 1u, __ATOMIC_RELAXED);
+}
+
+/**
+  * @brief  Read all counters as one consistent set
+  * @note   Call from the main loop. The speed reads 0 until two wraps
+  *         were timed, and once the output is more than two revolutions
+  *         late; revolutions over 39 s (under 2 RPM) are not timed.
+  * @param  counters: Filled with the counts since power-up
+  * @retval None
+  */
+void VR_Counters_Snapshot(VR_Counters_t *counters)
+{
+    Counters_Raw_t raw, check;
+
+    Counters_Collect(&raw);
+    for (;;) {
+        Counters_Collect(&check);
+        if (memcmp(&raw, &check, sizeof(raw)) == 0) {
+            break;
+        }
+        raw = check;
+    }
+
+    uint32_t since_wrap = __HAL_TIM_GET_COUNTER(&htim2) - raw.wrap_count;
+
+    counters->samples = raw.samples;
+    counters->teeth = raw.teeth;
+    counters->revolutions = raw.revolutions;
+    counters->revolution_ticks = raw.revolution_ticks;
+    counters->rpm_milli = 0;
+    if (raw.revolution_ticks > 0 && since_wrap / 2u <= raw.revolution_ticks) {
+        counters->rpm_milli = (uint32_t)((COUNTERS_MRPM_TICKS + raw.revolution_ticks / 2u) / raw.revolution_ticks);
+    }
+    counters->updates = VR_Emulator_GetDefault()->updates;
+    counters->faults = raw.faults;
+    counters->overruns = raw.overruns;
+    counters->underruns = raw.underruns;
+    counters->adc = raw.adc;
+}
+
+/**
+  * @brief  Format the counters as telemetry text
+  * @note   "COUNT samples=1000000 teeth=9000 revs=500 rpm=3000.300 updates=12
+  *         faults=0 ovr=0 udr=0 adc=10000"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Counters_FormatTelemetry(char *buffer, uint32_t size)
+{
+    VR_Counters_t counters;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    VR_Counters_Snapshot(&counters);
+    return VR_Format_Append(buffer, size, 0, "COUNT samples=%lu teeth=%lu revs=%lu rpm=%lu.%03lu updates=%lu faults=%lu ovr=%lu udr=%lu adc=%lu\r\n",
+                            (unsigned long)counters.samples, (unsigned long)counters.teeth,
+                            (unsigned long)counters.revolutions, (unsigned long)(counters.rpm_milli / 1000u),
+                            (unsigned long)(counters.rpm_milli % 1000u), (unsigned long)counters.updates,
+                            (unsigned long)counters.faults, (unsigned long)counters.overruns,
+                            (unsigned long)counters.underruns, (unsigned long)counters.adc);
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Read every counter once
+  * @param  raw: Filled with the counter values
+  * @retval None
+  */
+static void Counters_Collect(Counters_Raw_t *raw)
+{
+    VR_QosStats_t qos;
+
+    raw->samples = counters_samples;
+    raw->teeth = counters_teeth;
+    raw->revolutions = counters_revolutions;
+    raw->revolution_ticks = counters_revolution_ticks;
+    raw->wrap_count = counters_wrap_count;
+    raw->faults = counters_faults;
+    raw->adc = counters_adc;
+    VR_QoS_GetStats(&qos);
+    raw->overruns = qos.overruns;
+    raw->underruns = qos.underruns;
+}
+
+/* USER CODE END 1 */
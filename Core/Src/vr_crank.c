@@ -0,0 +1,316 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_crank.c
+  * @brief          : Cranking and engine start model
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The model runs as the emulator's tooth hook, in the sample interrupt,
+  * once per tooth. Each call adds the tooth just output to the engine
+  * time, moves through the start phases, and sets the speed of the next
+  * tooth from its mean and the crank angle at the tooth centre:
+  *
+  *   rpm = mean * (1 - dip * cos(2 pi * angle * cylinders / 720))
+  *
+  * where angle runs over the 720 degree four-stroke cycle from the
+  * start, so each cylinder's compression is the slowest point. The dip
+  * fades out over the flare, as the firing engine takes over from the
+  * starter. The mean speed:
+  * - ENGAGE: rises linearly from rest to the starter speed, at least
+  *   VR_CRANK_MIN_RPM so the first tooth ends.
+  * - CRANKING: the starter speed, until crank_revs revolutions from rest
+  *   have been turned.
+  * - FLARE: rises linearly to the flare peak.
+  * - SETTLE: falls exponentially to idle, for VR_CRANK_SETTLE_SPANS time
+  *   constants, then IDLE holds it there.
+  *
+  * A VR sensor's output is proportional to the rate of change of flux,
+  * so the amplitude is set to rpm / VR_CRANK_FULL_AMPLITUDE_RPM of the
+  * model's own. The sample period is limited to VR_CRANK_SAMPLE_TICKS,
+  * where it would otherwise grow to hundreds of microseconds at
+  * cranking speed.
+  *
+  * The time steps are the teeth themselves, not the 1 ms control period,
+  * so a 150 RPM tooth and a 3000 RPM tooth both get their own speed, and
+  * the engine time never runs ahead of or behind the wheel.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_crank.h"
+#include "vr_tcm.h"
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define CRANK_TOOTH_DEG             (360.0f / TRIGGER_WHEEL_TEETH)
+#define CRANK_CYCLE_DEG             720.0f
+/* USER CODE END PD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static VR_Crank_t crank_default VR_DTCM_BSS;  // Read and written by the sample interrupt
+
+static const char *const crank_phase_names[] = {
+    "OFF", "ENGAGE", "CRANKING", "FLARE", "SETTLE", "IDLE",
+};
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static void Crank_Advance(VR_Crank_t *crank);
+static void Crank_Apply(VR_Crank_t *crank, VR_Emulator_t *emu);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Fill a configuration with a typical four-cylinder start
+  * @param  config: Configuration to fill
+  * @retval None
+  */
+void VR_Crank_DefaultConfig(VR_CrankConfig_t *config)
+{
+    config->cylinders = 4;
+    config->compression_percent = 25;
+    config->crank_revs = 4;
+    config->starter_rpm = 200;
+    config->engage_ms = 300;
+    config->flare_rpm = 1500;
+    config->flare_ms = 250;
+    config->idle_rpm = 850;
+    config->settle_ms = 400;
+}
+
+/**
+  * @brief  Check a configuration
+  * @param  config: Configuration to check
+  * @retval True if it can be run
+  */
+bool VR_Crank_IsValid(const VR_CrankConfig_t *config)
+{
+    return config->cylinders >= 1 && config->cylinders <= VR_CRANK_MAX_CYLINDERS &&
+           config->compression_percent < 100 &&
+           config->starter_rpm >= VR_CRANK_MIN_RPM && config->starter_rpm <= MAX_RPM &&
+           config->idle_rpm >= VR_CRANK_MIN_RPM && config->flare_rpm >= config->idle_rpm &&
+           config->flare_rpm <= MAX_RPM;
+}
+
+/**
+  * @brief  Start an engine from rest
+  * @note   The wheel starts from where it is. Turns the wheel forwards,
+  *         limits the sample period and sets the first tooth's speed, then
+  *         takes over the speed until VR_Crank_Stop().
+  * @param  crank: Model state
+  * @param  emu: Emulator to drive
+  * @param  config: Engine and starter; copied
+  * @retval True if started, false if the configuration is invalid
+  */
+bool VR_Crank_Start(VR_Crank_t *crank, VR_Emulator_t *emu, const VR_CrankConfig_t *config)
+{
+    if (!VR_Crank_IsValid(config)) {
+        return false;
+    }
+
+    VR_Emu_SetToothHook(emu, NULL, NULL);
+    crank->config = *config;
+    crank->phase = VR_CRANK_ENGAGE;
+    crank->time_us = 0;
+    crank->phase_us = 0;
+    crank->revolutions = 0;
+    crank->teeth = 0;
+
+    VR_Emu_SetReverse(emu, false);
+    VR_Emu_SetSampleLimit(emu, VR_CRANK_SAMPLE_TICKS);
+    Crank_Apply(crank, emu);
+    VR_Emu_SetToothHook(emu, VR_Crank_Tooth, crank);
+    return true;
+}
+
+/**
+  * @brief  Return the speed to the caller
+  * @note   The wheel keeps the last tooth's speed, at the model's own
+  *         amplitude and sample period
+  * @param  crank: Model state
+  * @param  emu: Emulator it drove
+  * @retval None
+  */
+void VR_Crank_Stop(VR_Crank_t *crank, VR_Emulator_t *emu)
+{
+    VR_Emu_SetToothHook(emu, NULL, NULL);
+    VR_Emu_SetSampleLimit(emu, 0);
+    VR_Emu_SetAmplitude(emu, VR_AMPLITUDE_FULL);
+    crank->phase = VR_CRANK_OFF;
+}
+
+/**
+  * @brief  Tooth hook: account for the tooth just output and set the next
+  * @param  emu: Emulator entering a new tooth
+  * @param  ctx: VR_Crank_t
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Crank_Tooth(VR_Emulator_t *emu, void *ctx)
+{
+    VR_Crank_t *crank = (VR_Crank_t *)ctx;
+
+    crank->time_us += emu->state.tooth_period_us;
+    crank->teeth++;
+    if (emu->state.current_tooth == 0) {
+        crank->revolutions++;
+    }
+    Crank_Apply(crank, emu);
+}
+
+/**
+  * @brief  Name of a start phase
+  * @param  phase: VR_CrankPhase_t
+  * @retval Upper case name
+  */
+const char *VR_Crank_PhaseName(uint8_t phase)
+{
+    return (phase <= VR_CRANK_IDLE) ? crank_phase_names[phase] : "?";
+}
+
+/**
+  * @brief  Start the default emulator's engine
+  * @param  config: Engine and starter; copied
+  * @retval True if started
+  */
+bool VR_Crank_Begin(const VR_CrankConfig_t *config)
+{
+    return VR_Crank_Start(&crank_default, VR_Emulator_GetDefault(), config);
+}
+
+/**
+  * @brief  Return the default emulator's speed to the potentiometer
+  * @retval None
+  */
+void VR_Crank_End(void)
+{
+    if (crank_default.phase != VR_CRANK_OFF) {
+        VR_Crank_Stop(&crank_default, VR_Emulator_GetDefault());
+    }
+}
+
+/**
+  * @brief  Check whether the model sets the default emulator's speed
+  * @retval True between VR_Crank_Begin() and VR_Crank_End()
+  */
+bool VR_Crank_IsRunning(void)
+{
+    return crank_default.phase != VR_CRANK_OFF;
+}
+
+/**
+  * @brief  Get the default emulator's model state
+  * @retval Model state; written by the sample interrupt
+  */
+const VR_Crank_t *VR_Crank_GetDefault(void)
+{
+    return &crank_default;
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Move to the next phase once the current one is over
+  * @note   A phase of zero length passes straight on
+  * @param  crank: Model state
+  * @retval None
+  */
+VR_ITCM_CODE static void Crank_Advance(VR_Crank_t *crank)
+{
+    const VR_CrankConfig_t *config = &crank->config;
+
+    for (;;) {
+        uint32_t elapsed_us = crank->time_us - crank->phase_us;
+        bool done;
+
+        switch (crank->phase) {
+        case VR_CRANK_ENGAGE:
+            done = elapsed_us >= config->engage_ms * 1000u;
+            break;
+        case VR_CRANK_CRANKING:
+            done = config->crank_revs != 0 && crank->revolutions >= config->crank_revs;
+            break;
+        case VR_CRANK_FLARE:
+            done = elapsed_us >= config->flare_ms * 1000u;
+            break;
+        case VR_CRANK_SETTLE:
+            done = elapsed_us >= VR_CRANK_SETTLE_SPANS * config->settle_ms * 1000u;
+            break;
+        default:
+            done = false;
+            break;
+        }
+        if (!done) {
+            return;
+        }
+        crank->phase++;
+        crank->phase_us = crank->time_us;
+    }
+}
+
+/**
+  * @brief  Set the speed and amplitude of the tooth about to start
+  * @param  crank: Model state
+  * @param  emu: Emulator to drive
+  * @retval None
+  */
+VR_ITCM_CODE static void Crank_Apply(VR_Crank_t *crank, VR_Emulator_t *emu)
+{
+    const VR_CrankConfig_t *config = &crank->config;
+    float dip = config->compression_percent / 100.0f;
+    float mean;
+
+    Crank_Advance(crank);
+    float elapsed_ms = (float)(crank->time_us - crank->phase_us) / 1000.0f;
+
+    switch (crank->phase) {
+    case VR_CRANK_ENGAGE:
+        mean = config->starter_rpm * elapsed_ms / config->engage_ms;
+        break;
+    case VR_CRANK_CRANKING:
+        mean = config->starter_rpm;
+        break;
+    case VR_CRANK_FLARE:
+        mean = config->starter_rpm + (float)(config->flare_rpm - config->starter_rpm) * elapsed_ms / config->flare_ms;
+        dip *= 1.0f - elapsed_ms / config->flare_ms;
+        break;
+    case VR_CRANK_SETTLE:
+        mean = config->idle_rpm + (float)(config->flare_rpm - config->idle_rpm) * expf(-elapsed_ms / config->settle_ms);
+        dip = 0.0f;
+        break;
+    default:
+        mean = config->idle_rpm;
+        dip = 0.0f;
+        break;
+    }
+
+    // Centre of this tooth within the four-stroke cycle
+    float angle = (float)(crank->revolutions % 2u) * 360.0f +
+                  ((float)emu->state.current_tooth + 0.5f) * CRANK_TOOTH_DEG;
+    float rpm = mean * (1.0f - dip * cosf(2.0f * (float)M_PI * angle * config->cylinders / CRANK_CYCLE_DEG));
+
+    if (rpm < VR_CRANK_MIN_RPM) {
+        rpm = VR_CRANK_MIN_RPM;
+    } else if (rpm > MAX_RPM) {
+        rpm = MAX_RPM;
+    }
+    crank->rpm = (uint16_t)(rpm + 0.5f);
+
+    VR_Emu_SetRPM(emu, crank->rpm);
+    VR_Emu_SetAmplitude(emu, (crank->rpm >= VR_CRANK_FULL_AMPLITUDE_RPM) ? VR_AMPLITUDE_FULL :
+                        (uint16_t)((uint32_t)crank->rpm * VR_AMPLITUDE_FULL / VR_CRANK_FULL_AMPLITUDE_RPM));
+}
+
+/* USER CODE END 1 */
@@ -0,0 +1,250 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_cycles.c
+  * @brief          : Cycle-count profiling
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * A probe is recorded from one context only, normally an interrupt. The
+  * recorder makes a probe's sequence number odd while it updates the
+  * statistics and even again afterwards. A reader that sees an odd or
+  * changed sequence number was interrupted mid-update and copies again.
+  *
+  * A reset cannot clear statistics the interrupt may be writing, so the
+  * reader only requests it; the next record starts a new window.
+  *
+  * Each boot mark stores the cycle count and SystemCoreClock at the end of
+  * a stage. A stage is converted to microseconds at the clock it started
+  * at, so the clock stage counts at the 16 MHz HSI it spends waiting for
+  * the PLL. The startup code and the TCM and cache set-up before
+  * VR_Cycles_Init() are not included.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_cycles.h"
+#include "vr_tcm.h"
+#include "vr_format.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+/* USER CODE END Includes */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    volatile uint32_t sequence;     // Odd while the recorder is updating
+    volatile bool reset;            // Start a new window at the next record
+    volatile VR_CycleStats_t stats;
+} Cycles_Probe_t;
+/* USER CODE END PTD */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define CYCLES_DWT_UNLOCK           0xC5ACCE55u     // DWT lock access key (Cortex-M7)
+/* USER CODE END PD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static Cycles_Probe_t probes[VR_CYCLES_PROBES] VR_DTCM_BSS;
+
+// Cycle count and core clock at VR_Cycles_Init() and at the end of each stage
+static uint32_t boot_cycles[VR_BOOT_STAGES + 1];
+static uint32_t boot_clock[VR_BOOT_STAGES + 1];
+static uint32_t boot_marked = 0;            // Bit per stage marked
+
+static const char *const probe_names[VR_CYCLES_PROBES] = {
+    "isr",
+    "ctl",
+    "bh",
+};
+
+static const char *const boot_names[VR_BOOT_STAGES] = {
+    "hal",
+    "clock",
+    "periph",
+    "config",
+    "output",
+};
+/* USER CODE END PV */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Start the DWT cycle counter and clear all probes
+  * @retval None
+  */
+void VR_Cycles_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = CYCLES_DWT_UNLOCK;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint32_t i = 0; i < VR_CYCLES_PROBES; i++) {
+        probes[i].sequence = 0;
+        probes[i].reset = true;
+    }
+
+    boot_cycles[0] = 0;
+    boot_clock[0] = SystemCoreClock;
+    boot_marked = 0;
+}
+
+/**
+  * @brief  Record one run of a probe
+  * @param  probe: Probe
+  * @param  start: VR_Cycles_Now() when the run began
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Cycles_Record(VR_CycleProbe_t probe, uint32_t start)
+{
+    Cycles_Probe_t *p = &probes[probe];
+    uint32_t cycles = VR_Cycles_Now() - start;
+
+    p->sequence++;
+    if (p->reset) {
+        p->reset = false;
+        p->stats.count = 0;
+        p->stats.min = UINT32_MAX;
+        p->stats.max = 0;
+        p->stats.total = 0;
+    }
+    p->stats.count++;
+    p->stats.total += cycles;
+    if (cycles < p->stats.min) {
+        p->stats.min = cycles;
+    }
+    if (cycles > p->stats.max) {
+        p->stats.max = cycles;
+    }
+    p->sequence++;
+}
+
+/**
+  * @brief  Copy a probe's statistics
+  * @param  probe: Probe
+  * @param  stats: Filled with the statistics since the last reset
+  * @param  reset: Start a new window at the next record
+  * @retval None
+  */
+void VR_Cycles_Snapshot(VR_CycleProbe_t probe, VR_CycleStats_t *stats, bool reset)
+{
+    const Cycles_Probe_t *p = &probes[probe];
+    uint32_t sequence;
+
+    do {
+        sequence = p->sequence;
+        stats->count = p->stats.count;
+        stats->min = p->stats.min;
+        stats->max = p->stats.max;
+        stats->total = p->stats.total;
+    } while ((sequence & 1u) != 0 || sequence != p->sequence);
+
+    if (p->reset || stats->count == 0) {
+        // Nothing recorded since the last reset
+        *stats = (VR_CycleStats_t){0, 0, 0, 0};
+    }
+    if (reset) {
+        probes[probe].reset = true;
+    }
+}
+
+/**
+  * @brief  Format every probe with runs as telemetry text, and reset them
+  * @note   One line per probe: "CYC isr n=100000 min=402 avg=431 max=812"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Cycles_FormatTelemetry(char *buffer, uint32_t size)
+{
+    uint32_t len = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+    for (uint32_t i = 0; i < VR_CYCLES_PROBES; i++) {
+        VR_CycleStats_t stats;
+
+        VR_Cycles_Snapshot((VR_CycleProbe_t)i, &stats, true);
+        if (stats.count == 0) {
+            continue;
+        }
+
+        len = VR_Format_Append(buffer, size, len, "CYC %s n=%lu min=%lu avg=%lu max=%lu\r\n",
+                               probe_names[i], (unsigned long)stats.count, (unsigned long)stats.min,
+                               (unsigned long)(stats.total / stats.count), (unsigned long)stats.max);
+    }
+
+    return len;
+}
+
+/**
+  * @brief  Mark the end of a boot stage
+  * @note   Call once per stage, in order, from main(); a stage runs from
+  *         the previous mark
+  * @param  stage: Stage just completed
+  * @retval None
+  */
+void VR_Cycles_BootMark(VR_BootStage_t stage)
+{
+    boot_cycles[stage + 1] = VR_Cycles_Now();
+    boot_clock[stage + 1] = SystemCoreClock;
+    boot_marked |= 1u << stage;
+}
+
+/**
+  * @brief  Duration of a boot stage
+  * @param  stage: Stage, or VR_BOOT_STAGES for the whole boot
+  * @retval Microseconds; a stage not yet marked counts as 0
+  */
+uint32_t VR_Cycles_BootTime(VR_BootStage_t stage)
+{
+    uint32_t first = (stage == VR_BOOT_STAGES) ? 0 : (uint32_t)stage;
+    uint32_t last = (stage == VR_BOOT_STAGES) ? VR_BOOT_STAGES - 1u : (uint32_t)stage;
+    uint64_t us = 0;
+
+    for (uint32_t i = first; i <= last; i++) {
+        if ((boot_marked & (1u << i)) != 0) {
+            us += (uint64_t)(boot_cycles[i + 1] - boot_cycles[i]) * 1000000u / boot_clock[i];
+        }
+    }
+    return (uint32_t)us;
+}
+
+/**
+  * @brief  Format the boot stage times as telemetry text
+  * @note   "BOOT hal=45us clock=412us periph=380us config=96us output=21us total=954us"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Cycles_FormatBoot(char *buffer, uint32_t size)
+{
+    uint32_t len = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+    for (uint32_t i = 0; i < VR_BOOT_STAGES; i++) {
+        len = VR_Format_Append(buffer, size, len, "%s%s=%luus", (i == 0) ? "BOOT " : " ",
+                               boot_names[i], (unsigned long)VR_Cycles_BootTime((VR_BootStage_t)i));
+    }
+    len = VR_Format_Append(buffer, size, len, " total=%luus\r\n",
+                           (unsigned long)VR_Cycles_BootTime(VR_BOOT_STAGES));
+
+    return len;
+}
+
+/* USER CODE END 0 */
@@ -0,0 +1,341 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_digital_output.c
+  * @brief          : Hall/optical digital crank output
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * TIM2 is a free-running 32-bit counter at 108 MHz. Channel 4 is in toggle
+  * mode, and every compare match raises a DMA request. DMA1 Stream7 (channel
+  * 3, circular) then loads the next edge time from edge_buffer into CCR4.
+  * The half and full transfer interrupts refill the half just consumed, so
+  * the CPU runs once per VR_DIGITAL_EDGE_BUFFER / 2 edges.
+  *
+  * Both outputs share the emulator's tooth phase: the current tooth and the
+  * time into it. An edge time is the tooth start plus a whole number of TIM2
+  * ticks, and the emulator keeps its phase in whole microseconds of the same
+  * clock, so the two outputs never drift apart. On the first TIM6 sample
+  * after an RPM change, VR_Digital_SampleCallback() anchors the schedule to
+  * the phase at that sample and rewrites every edge not yet loaded.
+  *
+  * The output level is read back from the pin at a resync. If it disagrees
+  * with the new phase, a toggle is scheduled VR_DIGITAL_MIN_LEAD_TICKS
+  * ahead, as the analog output also changes level on that sample. The
+  * exception is an RPM change that moves the next edge by less than one
+  * sample: the pin has already made that edge on the old schedule, so the
+  * planned one is dropped instead of emitting a pulse shorter than a sample.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_digital_output.h"
+#include "vr_tcm.h"
+#include "vr_dma_buffer.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+
+/* USER CODE END Includes */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define DIGITAL_HALF                (VR_DIGITAL_EDGE_BUFFER / 2)
+#define DIGITAL_PITCH_DEG           20u     // Tooth plus gap, every tooth
+
+/* Tooth width in TIM2 ticks for an integer number of degrees of the pitch */
+#define DIGITAL_WIDTH(period, deg)  ((uint32_t)((uint64_t)(period) * (deg) / DIGITAL_PITCH_DEG))
+/* USER CODE END PD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static uint32_t edge_buffer[VR_DIGITAL_EDGE_BUFFER] VR_DMA_BUFFER;      // Non-cacheable, read by DMA
+static VR_EdgePlanner_t planner VR_DTCM_BSS;
+static volatile bool digital_enabled VR_DTCM_BSS = false;
+static bool digital_synced VR_DTCM_BSS = false;
+static uint32_t digital_resyncs = 0;
+extern TIM_HandleTypeDef htim2;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static void VR_Digital_Resync(const VR_SensorState_t *state, uint32_t sample_count);
+static void VR_Digital_Fill(uint32_t first, uint32_t count);
+static uint32_t VR_Edge_Time(const VR_EdgePlanner_t *planner);
+static void VR_Edge_Advance(VR_EdgePlanner_t *planner);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Start the digital output
+  * @note   Edges begin at the next TIM6 sample, which anchors the schedule
+  * @retval None
+  */
+void VR_Digital_Start(void)
+{
+    if (digital_enabled) {
+        return;
+    }
+
+    // No compare match and no DMA load until the first resync
+    __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, __HAL_TIM_GET_COUNTER(&htim2) - 1);
+    digital_synced = false;
+
+    if (HAL_TIM_OC_Start_DMA(&htim2, TIM_CHANNEL_4, edge_buffer, VR_DIGITAL_EDGE_BUFFER) != HAL_OK) {
+        return;
+    }
+    __HAL_TIM_DISABLE_DMA(&htim2, TIM_DMA_CC4);
+    digital_enabled = true;
+}
+
+/**
+  * @brief  Stop the digital output; the pin returns to its inactive level
+  * @retval None
+  */
+void VR_Digital_Stop(void)
+{
+    digital_enabled = false;
+    HAL_TIM_OC_Stop_DMA(&htim2, TIM_CHANNEL_4);
+}
+
+/**
+  * @brief  Check whether the digital output is enabled
+  * @retval True between VR_Digital_Start() and VR_Digital_Stop()
+  */
+bool VR_Digital_IsRunning(void)
+{
+    return digital_enabled;
+}
+
+/**
+  * @brief  Number of times the schedule was re-anchored
+  * @retval Resyncs since power-up
+  */
+uint32_t VR_Digital_GetResyncs(void)
+{
+    return digital_resyncs;
+}
+
+/**
+  * @brief  Follow the analog output; call from the sample bottom half
+  * @note   Costs one comparison unless the tooth period has changed
+  * @param  state: Default emulator state after a TIM6 sample
+  * @param  sample_count: TIM2 count at that sample
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Digital_SampleCallback(const VR_SensorState_t *state, uint32_t sample_count)
+{
+    if (!digital_enabled) {
+        return;
+    }
+
+    if (digital_synced && state->tooth_period_us == planner.period_us) {
+        return;
+    }
+
+    // Neither a refill nor a sample may run between reading the counter
+    // and arming the first edge VR_DIGITAL_MIN_LEAD_TICKS later
+    __disable_irq();
+    VR_Digital_Resync(state, sample_count);
+    __enable_irq();
+}
+
+/**
+  * @brief  The emulator phase jumped; re-anchor at the next sample
+  * @note   For a jump that keeps the tooth period, which the sample
+  *         callback alone would not notice
+  * @retval None
+  */
+void VR_Digital_PhaseJump(void)
+{
+    digital_synced = false;
+}
+
+/**
+  * @brief  First half of the ring consumed; called from
+  *         HAL_TIM_PWM_PulseFinishedHalfCpltCallback()
+  * @retval None
+  */
+void VR_Digital_TransferHalfCallback(void)
+{
+    VR_Digital_Fill(0, DIGITAL_HALF);
+}
+
+/**
+  * @brief  Second half of the ring consumed; called from
+  *         HAL_TIM_PWM_PulseFinishedCallback()
+  * @retval None
+  */
+void VR_Digital_TransferCompleteCallback(void)
+{
+    VR_Digital_Fill(DIGITAL_HALF, DIGITAL_HALF);
+}
+
+/**
+  * @brief  Place a planner on the first edge after a given time
+  * @param  planner: Planner to set up
+  * @param  state: Emulator state at a TIM6 sample
+  * @param  sample_count: TIM2 count at that sample
+  * @param  after: Plan edges strictly after this TIM2 count
+  * @retval None
+  */
+void VR_Edge_Anchor(VR_EdgePlanner_t *planner, const VR_SensorState_t *state,
+                    uint32_t sample_count, uint32_t after)
+{
+    planner->period_us = state->tooth_period_us;
+    planner->period = state->tooth_period_us * VR_DIGITAL_TICKS_PER_US;
+    planner->tooth = state->current_tooth;
+    planner->tooth_start = sample_count - state->tooth_timer * VR_DIGITAL_TICKS_PER_US;
+    planner->rising = 0;
+
+    if (planner->period == 0) {
+        return;
+    }
+
+    // Counts wrap every 39.8 s, so compare as signed distances
+    while ((int32_t)(VR_Edge_Time(planner) - after) <= 0) {
+        VR_Edge_Advance(planner);
+    }
+}
+
+/**
+  * @brief  Take the next edge
+  * @param  planner: Planner
+  * @retval TIM2 count of the edge
+  */
+uint32_t VR_Edge_Next(VR_EdgePlanner_t *planner)
+{
+    uint32_t time = VR_Edge_Time(planner);
+
+    VR_Edge_Advance(planner);
+    return time;
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Anchor the schedule to the emulator and rewrite pending edges
+  * @note   Runs with interrupts masked, so no DMA1 Stream7 refill can run
+  *         in between
+  * @param  state: Emulator state after a sample
+  * @param  sample_count: TIM2 count at the TIM6 update
+  * @retval None
+  */
+static void VR_Digital_Resync(const VR_SensorState_t *state, uint32_t sample_count)
+{
+    DMA_HandleTypeDef *hdma = htim2.hdma[TIM_DMA_ID_CC4];
+
+    // Freeze: no further DMA loads, and park the pending compare behind the counter
+    __HAL_TIM_DISABLE_DMA(&htim2, TIM_DMA_CC4);
+    uint32_t now = __HAL_TIM_GET_COUNTER(&htim2);
+    __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, now - 1);
+
+    bool high = (HAL_GPIO_ReadPin(VR_DIGITAL_GPIO_Port, VR_DIGITAL_Pin) == GPIO_PIN_SET);
+    bool was_running = digital_synced && planner.period != 0;
+    uint32_t lead = now + VR_DIGITAL_MIN_LEAD_TICKS;
+
+    digital_synced = true;
+    digital_resyncs++;
+    VR_Edge_Anchor(&planner, state, sample_count, lead);
+
+    if (planner.period == 0) {
+        // Stopped: settle in the gap and leave the DMA request off
+        if (high) {
+            __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, lead);
+        }
+        return;
+    }
+
+    // The level before the next planned edge is low if that edge is a rising one
+    VR_EdgePlanner_t peek = planner;
+    uint32_t next = VR_Edge_Next(&peek);
+    uint32_t first;
+
+    if (high != (planner.rising != 0)) {
+        first = VR_Edge_Next(&planner);
+    } else if (was_running &&
+               (int32_t)(next - lead) < (int32_t)(state->sample_period_us * VR_DIGITAL_TICKS_PER_US)) {
+        // The old schedule made this edge less than a sample early; it stands
+        // for the planned one rather than adding a sub-sample pulse
+        VR_Edge_Advance(&planner);
+        first = VR_Edge_Next(&planner);
+    } else {
+        // Align the level at the lead time; the planned edges follow
+        first = lead;
+    }
+
+    // Rewrite from the next DMA read to the end of its half, then the other half
+    uint32_t pos = VR_DIGITAL_EDGE_BUFFER - __HAL_DMA_GET_COUNTER(hdma);
+    uint32_t count = VR_DIGITAL_EDGE_BUFFER - pos % DIGITAL_HALF;
+
+    for (uint32_t i = 0; i < count; i++) {
+        edge_buffer[(pos + i) % VR_DIGITAL_EDGE_BUFFER] = VR_Edge_Next(&planner);
+    }
+
+    // A refill already pending would overwrite edges written above
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma));
+
+    __HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, first);
+    __HAL_TIM_ENABLE_DMA(&htim2, TIM_DMA_CC4);
+}
+
+/**
+  * @brief  Write the next edges into part of the ring
+  * @param  first: First ring index
+  * @param  count: Number of entries
+  * @retval None
+  */
+static void VR_Digital_Fill(uint32_t first, uint32_t count)
+{
+    if (!digital_enabled || planner.period == 0) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        edge_buffer[first + i] = VR_Edge_Next(&planner);
+    }
+}
+
+/**
+  * @brief  TIM2 count of the planner's next edge
+  * @param  planner: Planner
+  * @retval Tooth start, or tooth start plus the tooth width
+  */
+static uint32_t VR_Edge_Time(const VR_EdgePlanner_t *planner)
+{
+    if (planner->rising) {
+        return planner->tooth_start;
+    }
+
+    uint32_t width = (planner->tooth == MISSING_TOOTH_INDEX) ?
+                     DIGITAL_WIDTH(planner->period, (uint32_t)MISSING_TOOTH_ANGLE) :
+                     DIGITAL_WIDTH(planner->period, (uint32_t)REGULAR_TOOTH_ANGLE);
+    return planner->tooth_start + width;
+}
+
+/**
+  * @brief  Move the planner to the following edge
+  * @param  planner: Planner
+  * @retval None
+  */
+static void VR_Edge_Advance(VR_EdgePlanner_t *planner)
+{
+    if (planner->rising) {
+        planner->rising = 0;
+    } else {
+        planner->tooth_start += planner->period;
+        planner->tooth = (uint8_t)((planner->tooth + 1) % TRIGGER_WHEEL_TEETH);
+        planner->rising = 1;
+    }
+}
+
+/* USER CODE END 1 */
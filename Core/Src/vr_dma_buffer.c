@@ -0,0 +1,129 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_dma_buffer.c
+  * @brief          : Cache set-up and DMA buffer coherence
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * VR_DMA_Init() maps SRAM2 as normal, shareable, non-cacheable memory with
+  * MPU region 0 and then turns on the instruction and data caches. The rest
+  * of the address space keeps the default memory map (write-back,
+  * write-allocate SRAM), and ITCM/DTCM are never cached.
+  *
+  * Clean and invalidate work on whole 32-byte lines. Cleaning extra bytes
+  * on either side is harmless, so VR_DMA_Clean() rounds the range out.
+  * Invalidating them could discard the CPU's pending writes to a
+  * neighbouring variable, so VR_DMA_Invalidate() refuses a range that does
+  * not start and end on a line boundary.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_dma_buffer.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+
+/* USER CODE END Includes */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define DMA_LINE_MASK               (VR_DMA_CACHE_LINE - 1u)
+/* USER CODE END PD */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Map the DMA region as non-cacheable and enable the caches
+  * @note   Call at the top of main(), before any DMA is started
+  * @retval None
+  */
+void VR_DMA_Init(void)
+{
+    MPU_Region_InitTypeDef region = {0};
+
+    HAL_MPU_Disable();
+
+    // TEX=1, C=0, B=0: normal memory, not cached
+    region.Enable = MPU_REGION_ENABLE;
+    region.Number = MPU_REGION_NUMBER0;
+    region.BaseAddress = VR_DMA_REGION_BASE;
+    region.Size = MPU_REGION_SIZE_16KB;
+    region.SubRegionDisable = 0x00;
+    region.TypeExtField = MPU_TEX_LEVEL1;
+    region.AccessPermission = MPU_REGION_FULL_ACCESS;
+    region.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+    region.IsShareable = MPU_ACCESS_SHAREABLE;
+    region.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+    region.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+    HAL_MPU_ConfigRegion(&region);
+
+    // Everything outside region 0 keeps the default map
+    HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+
+#if VR_CACHE_ENABLE
+    SCB_EnableICache();
+    SCB_EnableDCache();
+#endif
+}
+
+/**
+  * @brief  Check whether a buffer lies wholly in the non-cacheable region
+  * @param  buffer: Buffer start
+  * @param  size: Buffer size in bytes
+  * @retval True if DMA and the CPU always see the same contents
+  */
+bool VR_DMA_IsNonCacheable(const void *buffer, uint32_t size)
+{
+    uintptr_t start = (uintptr_t)buffer;
+
+    return start >= VR_DMA_REGION_BASE && size <= VR_DMA_REGION_SIZE &&
+           start - VR_DMA_REGION_BASE <= VR_DMA_REGION_SIZE - size;
+}
+
+/**
+  * @brief  Write the CPU's changes to a buffer out to memory before DMA reads it
+  * @param  buffer: Buffer start
+  * @param  size: Buffer size in bytes
+  * @retval None
+  */
+void VR_DMA_Clean(const void *buffer, uint32_t size)
+{
+    if (size == 0 || VR_DMA_IsNonCacheable(buffer, size)) {
+        return;
+    }
+
+    uintptr_t start = (uintptr_t)buffer & ~(uintptr_t)DMA_LINE_MASK;
+    uintptr_t end = ((uintptr_t)buffer + size + DMA_LINE_MASK) & ~(uintptr_t)DMA_LINE_MASK;
+
+    SCB_CleanDCache_by_Addr((uint32_t *)start, (int32_t)(end - start));
+}
+
+/**
+  * @brief  Drop cached copies of a buffer so the CPU reads what DMA wrote
+  * @note   Also call before starting DMA into the buffer, so that no dirty
+  *         line can be evicted over the transfer
+  * @param  buffer: Buffer start, aligned to VR_DMA_CACHE_LINE
+  * @param  size: Buffer size in bytes, a multiple of VR_DMA_CACHE_LINE
+  * @retval False if the range is not whole cache lines; nothing is invalidated
+  */
+bool VR_DMA_Invalidate(void *buffer, uint32_t size)
+{
+    if (((uintptr_t)buffer & DMA_LINE_MASK) != 0 || (size & DMA_LINE_MASK) != 0) {
+        return false;
+    }
+    if (size == 0 || VR_DMA_IsNonCacheable(buffer, size)) {
+        return true;
+    }
+
+    SCB_InvalidateDCache_by_Addr((uint32_t *)buffer, (int32_t)size);
+    return true;
+}
+
+/* USER CODE END 0 */
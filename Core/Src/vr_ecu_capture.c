@@ -0,0 +1,541 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_ecu_capture.c
+  * @brief          : ECU ignition/injection timing capture
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * TIM2 input capture on channels 2 and 3 latches the 108 MHz count at each
+  * ECU edge, and DMA1 Stream6 and Stream1 (channel 3, circular) move it into
+  * a ring. No interrupt runs per edge. The only interrupt is the transfer
+  * complete at each ring wrap, which counts laps so the main loop can tell
+  * how many captures have arrived and whether any were overwritten.
+  *
+  * The phase model is the one the analog and digital outputs share. Between
+  * tooth period changes the emulator advances exactly one TIM6 sample per
+  * sample, so crank angle is linear in TIM2 time. The sample bottom half
+  * takes an anchor at the first TIM6 sample after each change, and a
+  * capture is converted with the latest anchor taken at or before it.
+  * Captures are only converted once a later sample has run, so that anchor
+  * has always been published.
+  *
+  * Cycle angle 0 is the start of tooth 0 on the first wheel revolution
+  * after VR_Capture_Start(). The wheel has no cam reference, so the two
+  * revolutions of the four-stroke cycle are told apart by counting teeth.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_ecu_capture.h"
+#include "vr_digital_output.h"
+#include "vr_tcm.h"
+#include "vr_dma_buffer.h"
+#include "vr_format.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+/* USER CODE END Includes */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    uint32_t channel;               // TIM_CHANNEL_x
+    uint16_t dma_id;                // TIM_DMA_ID_CCx
+    const char *name;               // Telemetry prefix
+} Capture_Hw_t;
+
+typedef struct {
+    volatile uint32_t laps;         // Ring wraps, counted in the DMA interrupt
+    uint32_t written;               // Captures known to have arrived
+    uint32_t consumed;              // Captures taken from the ring
+    VR_CaptureStatus_t status;
+    VR_AdvanceStats_t stats[VR_CAPTURE_MAX_CYLINDERS];
+} Capture_Channel_t;
+/* USER CODE END PTD */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define CAPTURE_PITCH_DEG           (360.0f / TRIGGER_WHEEL_TEETH)
+#define CAPTURE_CYCLE_TEETH         (2u * TRIGGER_WHEEL_TEETH)
+/* USER CODE END PD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static const Capture_Hw_t capture_hw[VR_CAPTURE_CHANNELS] = {
+    {TIM_CHANNEL_2, TIM_DMA_ID_CC2, "IGN"},
+    {TIM_CHANNEL_3, TIM_DMA_ID_CC3, "INJ"},
+};
+
+static Capture_Channel_t capture[VR_CAPTURE_CHANNELS];
+// Written by DMA, so kept out of the cache
+static uint32_t capture_ring[VR_CAPTURE_CHANNELS][VR_CAPTURE_RING] VR_DMA_BUFFER;
+// Sample path state, in DTCM
+static VR_PhaseAnchor_t anchors[VR_CAPTURE_ANCHORS] VR_DTCM_BSS;
+static volatile uint32_t anchor_head VR_DTCM_BSS = 0;       // Anchors published
+static volatile uint32_t last_sample_count VR_DTCM_BSS = 0; // TIM2 count of the latest TIM6 sample
+static uint32_t anchor_period_us VR_DTCM_BSS = 0;
+static uint8_t emu_tooth VR_DTCM_BSS = 0;                   // Emulator tooth at the latest sample
+static uint8_t cycle_tooth VR_DTCM_BSS = 0;
+static uint8_t capture_cylinders = VR_CAPTURE_DEFAULT_CYLINDERS;
+static float capture_tdc_deg = VR_CAPTURE_DEFAULT_TDC_DEG;
+static volatile bool capture_enabled VR_DTCM_BSS = false;
+extern TIM_HandleTypeDef htim2;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static uint32_t VR_Capture_Written(VR_CaptureChannel_t channel);
+static void VR_Capture_Drain(VR_CaptureChannel_t channel, uint32_t sample_count);
+static void VR_Capture_Record(VR_CaptureChannel_t channel, uint32_t count);
+static bool VR_Capture_FindAnchor(uint32_t count, VR_PhaseAnchor_t *anchor);
+static void VR_Capture_FormatDeg(char *buffer, uint32_t size, float deg);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Start capturing on both channels
+  * @note   Call after TIM2 is running and the emulator is initialised
+  * @retval None
+  */
+void VR_Capture_Start(void)
+{
+    if (capture_enabled) {
+        return;
+    }
+
+    emu_tooth = VR_Emulator_GetDefault()->state.current_tooth;
+    cycle_tooth = emu_tooth;
+    anchor_head = 0;
+    anchor_period_us = 0;
+    VR_Capture_Reset();
+
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        Capture_Channel_t *c = &capture[ch];
+
+        c->laps = 0;
+        c->written = 0;
+        c->consumed = 0;
+        if (HAL_TIM_IC_Start_DMA(&htim2, capture_hw[ch].channel, capture_ring[ch], VR_CAPTURE_RING) != HAL_OK) {
+            continue;
+        }
+        // Only ring wraps are counted
+        __HAL_DMA_DISABLE_IT(htim2.hdma[capture_hw[ch].dma_id], DMA_IT_HT);
+    }
+
+    capture_enabled = true;
+}
+
+/**
+  * @brief  Stop capturing; statistics are kept
+  * @retval None
+  */
+void VR_Capture_Stop(void)
+{
+    capture_enabled = false;
+
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        HAL_TIM_IC_Stop_DMA(&htim2, capture_hw[ch].channel);
+    }
+}
+
+/**
+  * @brief  Set the engine layout and clear the statistics
+  * @param  cylinders: Cylinders, firing at even intervals (1 to VR_CAPTURE_MAX_CYLINDERS)
+  * @param  tdc_deg: Cycle angle of cylinder 1 TDC (0 to 720)
+  * @retval None
+  */
+void VR_Capture_Configure(uint8_t cylinders, float tdc_deg)
+{
+    if (cylinders >= 1 && cylinders <= VR_CAPTURE_MAX_CYLINDERS) {
+        capture_cylinders = cylinders;
+    }
+    capture_tdc_deg = fmodf(tdc_deg, VR_CAPTURE_CYCLE_DEG);
+    if (capture_tdc_deg < 0.0f) {
+        capture_tdc_deg += VR_CAPTURE_CYCLE_DEG;
+    }
+
+    VR_Capture_Reset();
+}
+
+/**
+  * @brief  Clear statistics and counters
+  * @retval None
+  */
+void VR_Capture_Reset(void)
+{
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        memset(&capture[ch].status, 0, sizeof(capture[ch].status));
+        memset(capture[ch].stats, 0, sizeof(capture[ch].stats));
+    }
+}
+
+/**
+  * @brief  Follow the emulator phase; call from the sample bottom half
+  * @note   Costs two comparisons unless the tooth or the tooth period changed
+  * @param  state: Default emulator state after a TIM6 sample
+  * @param  sample_count: TIM2 count at that sample
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Capture_SampleCallback(const VR_SensorState_t *state, uint32_t sample_count)
+{
+    if (!capture_enabled) {
+        return;
+    }
+
+    // Count teeth through the cycle so the two revolutions can be told apart
+    if (state->current_tooth != emu_tooth) {
+        uint32_t advanced = (state->current_tooth + TRIGGER_WHEEL_TEETH - emu_tooth) % TRIGGER_WHEEL_TEETH;
+        cycle_tooth = (uint8_t)((cycle_tooth + advanced) % CAPTURE_CYCLE_TEETH);
+        emu_tooth = state->current_tooth;
+    }
+
+    if (anchor_head == 0 || state->tooth_period_us != anchor_period_us) {
+        VR_PhaseAnchor_t *anchor = &anchors[anchor_head % VR_CAPTURE_ANCHORS];
+
+        anchor->sample_count = sample_count;
+        anchor->tooth_start = sample_count - state->tooth_timer * VR_DIGITAL_TICKS_PER_US;
+        anchor->period = state->tooth_period_us * VR_DIGITAL_TICKS_PER_US;
+        anchor->cycle_tooth = cycle_tooth;
+        anchor_period_us = state->tooth_period_us;
+        anchor_head++;
+    }
+
+    // Published after the anchor: captures before this count can be converted
+    last_sample_count = sample_count;
+}
+
+/**
+  * @brief  The emulator phase jumped; take an anchor at the next sample
+  * @note   For a jump that keeps the tooth period, which the sample
+  *         callback alone would not notice
+  * @retval None
+  */
+void VR_Capture_PhaseJump(void)
+{
+    anchor_period_us = UINT32_MAX;      // Matches no tooth period
+}
+
+/**
+  * @brief  A channel's ring has wrapped; called from HAL_TIM_IC_CaptureCallback()
+  * @param  channel: Capture channel
+  * @retval None
+  */
+void VR_Capture_TransferCompleteCallback(VR_CaptureChannel_t channel)
+{
+    if (channel < VR_CAPTURE_CHANNELS) {
+        capture[channel].laps++;
+    }
+}
+
+/**
+  * @brief  Convert the captures that have arrived; call from the main loop
+  * @note   Must run at least once per VR_CAPTURE_RING edges on a channel
+  * @retval None
+  */
+void VR_Capture_Process(void)
+{
+    if (!capture_enabled) {
+        return;
+    }
+
+    uint32_t sample_count = last_sample_count;
+
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        VR_Capture_Drain((VR_CaptureChannel_t)ch, sample_count);
+    }
+}
+
+/**
+  * @brief  Advance statistics for one cylinder
+  * @param  channel: Capture channel
+  * @param  cylinder: Cylinder in firing order, 0 for cylinder 1
+  * @param  stats: Filled with the statistics
+  * @retval True if the cylinder has at least one event
+  */
+bool VR_Capture_GetStats(VR_CaptureChannel_t channel, uint8_t cylinder, VR_AdvanceStats_t *stats)
+{
+    if (channel >= VR_CAPTURE_CHANNELS || cylinder >= capture_cylinders) {
+        return false;
+    }
+
+    *stats = capture[channel].stats[cylinder];
+    return stats->count > 0;
+}
+
+/**
+  * @brief  Capture counters for one channel
+  * @param  channel: Capture channel
+  * @param  status: Filled with the counters
+  * @retval None
+  */
+void VR_Capture_GetStatus(VR_CaptureChannel_t channel, VR_CaptureStatus_t *status)
+{
+    if (channel < VR_CAPTURE_CHANNELS) {
+        *status = capture[channel].status;
+    } else {
+        memset(status, 0, sizeof(*status));
+    }
+}
+
+/**
+  * @brief  Standard deviation of the advance
+  * @param  stats: Advance statistics
+  * @retval Degrees, 0 with fewer than two events
+  */
+float VR_Capture_StdDev(const VR_AdvanceStats_t *stats)
+{
+    return (stats->count > 1) ? sqrtf(stats->m2 / (float)stats->count) : 0.0f;
+}
+
+/**
+  * @brief  Format the statistics as telemetry text
+  * @note   One counter line per channel, then one line per cylinder with
+  *         events: "IGN 1 n=120 adv=10.00 min=9.98 max=10.02 sd=0.01"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Capture_FormatTelemetry(char *buffer, uint32_t size)
+{
+    uint32_t len = 0;
+    char mean[16], min[16], max[16], sd[16];
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        const Capture_Channel_t *c = &capture[ch];
+
+        len = VR_Format_Append(buffer, size, len, "%s captures=%lu overruns=%lu unsynced=%lu\r\n",
+                               capture_hw[ch].name, (unsigned long)c->status.captures,
+                               (unsigned long)c->status.overruns, (unsigned long)c->status.unsynced);
+
+        for (uint32_t cyl = 0; cyl < capture_cylinders; cyl++) {
+            const VR_AdvanceStats_t *s = &c->stats[cyl];
+
+            if (s->count == 0) {
+                continue;
+            }
+            VR_Capture_FormatDeg(mean, sizeof(mean), s->mean_deg);
+            VR_Capture_FormatDeg(min, sizeof(min), s->min_deg);
+            VR_Capture_FormatDeg(max, sizeof(max), s->max_deg);
+            VR_Capture_FormatDeg(sd, sizeof(sd), VR_Capture_StdDev(s));
+            len = VR_Format_Append(buffer, size, len, "%s %lu n=%lu adv=%s min=%s max=%s sd=%s\r\n",
+                                   capture_hw[ch].name, (unsigned long)(cyl + 1),
+                                   (unsigned long)s->count, mean, min, max, sd);
+        }
+    }
+
+    return len;
+}
+
+/**
+  * @brief  Cycle angle of a TIM2 count
+  * @param  anchor: Phase anchor taken at or before the count
+  * @param  count: TIM2 count
+  * @retval Degrees from 0 to VR_CAPTURE_CYCLE_DEG, 0 if the wheel was stopped
+  */
+float VR_Capture_AngleAt(const VR_PhaseAnchor_t *anchor, uint32_t count)
+{
+    if (anchor->period == 0) {
+        return 0.0f;
+    }
+
+    // Whole teeth in integers so the angle stays exact over long gaps
+    uint32_t elapsed = count - anchor->tooth_start;
+    uint32_t teeth = elapsed / anchor->period;
+    uint32_t remainder = elapsed - teeth * anchor->period;
+    uint32_t tooth = (anchor->cycle_tooth + teeth) % CAPTURE_CYCLE_TEETH;
+
+    return ((float)tooth + (float)remainder / (float)anchor->period) * CAPTURE_PITCH_DEG;
+}
+
+/**
+  * @brief  Assign an event to a cylinder
+  * @note   Cylinder k (firing order, from 0) has its TDC at
+  *         tdc_deg + k * 720 / cylinders. An event belongs to the cylinder
+  *         whose TDC it precedes by less than the firing interval, allowing
+  *         up to VR_CAPTURE_MAX_RETARD_DEG after TDC.
+  * @param  angle: Cycle angle of the event
+  * @param  cylinders: Number of cylinders
+  * @param  tdc_deg: Cycle angle of cylinder 1 TDC
+  * @param  advance: Degrees before that cylinder's TDC
+  * @retval Cylinder in firing order, 0 for cylinder 1
+  */
+uint8_t VR_Capture_Assign(float angle, uint8_t cylinders, float tdc_deg, float *advance)
+{
+    float spacing = VR_CAPTURE_CYCLE_DEG / cylinders;
+    float offset = fmodf(tdc_deg - angle + VR_CAPTURE_MAX_RETARD_DEG, VR_CAPTURE_CYCLE_DEG);
+
+    if (offset < 0.0f) {
+        offset += VR_CAPTURE_CYCLE_DEG;
+    }
+
+    uint32_t behind = (uint32_t)(offset / spacing);
+    if (behind >= cylinders) {
+        behind = cylinders - 1u;
+    }
+
+    *advance = offset - (float)behind * spacing - VR_CAPTURE_MAX_RETARD_DEG;
+    return (uint8_t)((cylinders - behind) % cylinders);
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Number of captures a channel's DMA has written since the start
+  * @param  channel: Capture channel
+  * @retval Capture count, never decreasing
+  */
+static uint32_t VR_Capture_Written(VR_CaptureChannel_t channel)
+{
+    Capture_Channel_t *c = &capture[channel];
+    DMA_HandleTypeDef *hdma = htim2.hdma[capture_hw[channel].dma_id];
+    uint32_t laps, remaining;
+
+    do {
+        laps = c->laps;
+        remaining = __HAL_DMA_GET_COUNTER(hdma);
+    } while (laps != c->laps);
+
+    uint32_t written = laps * VR_CAPTURE_RING + (VR_CAPTURE_RING - remaining);
+
+    // The ring has wrapped but its interrupt has not run yet
+    if ((int32_t)(written - c->written) > 0) {
+        c->written = written;
+    }
+    return c->written;
+}
+
+/**
+  * @brief  Convert a channel's captures taken before a sample
+  * @param  channel: Capture channel
+  * @param  sample_count: TIM2 count of the latest TIM6 sample
+  * @retval None
+  */
+static void VR_Capture_Drain(VR_CaptureChannel_t channel, uint32_t sample_count)
+{
+    Capture_Channel_t *c = &capture[channel];
+
+    for (;;) {
+        uint32_t written = VR_Capture_Written(channel);
+
+        if (written - c->consumed > VR_CAPTURE_RING) {
+            c->status.overruns += written - c->consumed - VR_CAPTURE_RING;
+            c->consumed = written - VR_CAPTURE_RING;
+        }
+        if (c->consumed == written) {
+            break;
+        }
+
+        uint32_t count = capture_ring[channel][c->consumed % VR_CAPTURE_RING];
+
+        // The DMA may have reached the slot again while it was read
+        if (VR_Capture_Written(channel) - c->consumed > VR_CAPTURE_RING) {
+            continue;
+        }
+        // Captures are in time order; the rest wait for the next sample
+        if ((int32_t)(count - sample_count) >= 0) {
+            break;
+        }
+
+        c->consumed++;
+        VR_Capture_Record(channel, count);
+    }
+}
+
+/**
+  * @brief  Add one capture to the statistics
+  * @param  channel: Capture channel
+  * @param  count: TIM2 count of the edge
+  * @retval None
+  */
+static void VR_Capture_Record(VR_CaptureChannel_t channel, uint32_t count)
+{
+    Capture_Channel_t *c = &capture[channel];
+    VR_PhaseAnchor_t anchor;
+    float advance;
+
+    if (!VR_Capture_FindAnchor(count, &anchor) || anchor.period == 0) {
+        c->status.unsynced++;
+        return;
+    }
+
+    uint8_t cylinder = VR_Capture_Assign(VR_Capture_AngleAt(&anchor, count),
+                                         capture_cylinders, capture_tdc_deg, &advance);
+    VR_AdvanceStats_t *s = &c->stats[cylinder];
+
+    s->count++;
+    s->last_deg = advance;
+    if (s->count == 1) {
+        s->min_deg = advance;
+        s->max_deg = advance;
+    } else {
+        if (advance < s->min_deg) s->min_deg = advance;
+        if (advance > s->max_deg) s->max_deg = advance;
+    }
+
+    // Running mean and variance (Welford)
+    float delta = advance - s->mean_deg;
+    s->mean_deg += delta / (float)s->count;
+    s->m2 += delta * (advance - s->mean_deg);
+
+    c->status.captures++;
+}
+
+/**
+  * @brief  Find the phase anchor in force at a TIM2 count
+  * @param  count: TIM2 count
+  * @param  anchor: Filled with a copy of the anchor
+  * @retval False if the count is older than the anchor history
+  */
+static bool VR_Capture_FindAnchor(uint32_t count, VR_PhaseAnchor_t *anchor)
+{
+    uint32_t head = anchor_head;
+    uint32_t available = (head < VR_CAPTURE_ANCHORS) ? head : VR_CAPTURE_ANCHORS;
+
+    for (uint32_t i = 0; i < available; i++) {
+        *anchor = anchors[(head - 1u - i) % VR_CAPTURE_ANCHORS];
+
+        if ((int32_t)(count - anchor->sample_count) < 0) {
+            continue;
+        }
+        // Newer anchors may have reused the slot while it was copied
+        return (anchor_head - head) < (VR_CAPTURE_ANCHORS - i);
+    }
+
+    return false;
+}
+
+/**
+  * @brief  Format degrees with two decimals without float printf support
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size
+  * @param  deg: Angle in degrees
+  * @retval None
+  */
+static void VR_Capture_FormatDeg(char *buffer, uint32_t size, float deg)
+{
+    int32_t centi = (int32_t)(deg * 100.0f + ((deg < 0.0f) ? -0.5f : 0.5f));
+    uint32_t magnitude = (uint32_t)((centi < 0) ? -centi : centi);
+
+    snprintf(buffer, size, "%s%lu.%02lu", (centi < 0) ? "-" : "",
+             (unsigned long)(magnitude / 100u), (unsigned long)(magnitude % 100u));
+}
+
+/* USER CODE END 1 */
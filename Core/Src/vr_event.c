@@ -0,0 +1,151 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_event.c
+  * @brief          : Main loop events and CPU load accounting
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * Interrupts of any priority may post at the same time, so posting is an
+  * atomic OR (LDREX/STREX), and taking the events is an atomic exchange.
+  *
+  * VR_Event_Wait() checks for events with interrupts masked and then
+  * executes WFI. A masked interrupt still wakes the core, so an event
+  * posted after the check cannot be slept through. The wake-up is timed
+  * before interrupts are unmasked, so the handler that woke the core runs
+  * after the idle period ends and counts as load.
+  *
+  * Idle cycles are counted with the DWT cycle counter, which
+  * VR_Cycles_Init() starts. A load window must be read more often than
+  * the counter wraps, every 19.8 s at 216 MHz.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_event.h"
+#include "vr_cycles.h"
+#include "vr_format.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+/* USER CODE END Includes */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static volatile uint32_t pending_events = 0;
+
+// Written by the main loop only
+static uint32_t window_start = 0;
+static uint32_t idle_cycles = 0;
+static uint32_t wakeups = 0;
+static uint32_t passes = 0;
+/* USER CODE END PV */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Clear pending events and start a load window
+  * @note   Call after VR_Cycles_Init(), before the interrupts that post
+  * @retval None
+  */
+void VR_Event_Init(void)
+{
+    pending_events = 0;
+    window_start = VR_Cycles_Now();
+    idle_cycles = 0;
+    wakeups = 0;
+    passes = 0;
+}
+
+/**
+  * @brief  Post events to the main loop; safe from any interrupt
+  * @param  events: VR_EVENT_* bits
+  * @retval None
+  */
+void VR_Event_Post(uint32_t events)
+{
+    __atomic_fetch_or(&pending_events, events, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  Take the pending events, sleeping until there are some
+  * @retval VR_EVENT_* bits, never 0
+  */
+uint32_t VR_Event_Wait(void)
+{
+    for (;;) {
+        __disable_irq();
+
+        uint32_t events = __atomic_exchange_n(&pending_events, 0, __ATOMIC_ACQUIRE);
+        if (events != 0) {
+            __enable_irq();
+            passes++;
+            return events;
+        }
+
+        uint32_t start = VR_Cycles_Now();
+        __DSB();
+        __WFI();
+        idle_cycles += VR_Cycles_Now() - start;
+        wakeups++;
+
+        // The interrupt that ended the sleep runs here
+        __enable_irq();
+    }
+}
+
+/**
+  * @brief  Read the load window
+  * @param  load: Filled with the window so far
+  * @param  reset: Start a new window
+  * @retval None
+  */
+void VR_Event_GetLoad(VR_Load_t *load, bool reset)
+{
+    uint32_t now = VR_Cycles_Now();
+
+    load->elapsed = now - window_start;
+    load->idle = idle_cycles;
+    load->wakeups = wakeups;
+    load->passes = passes;
+
+    if (reset) {
+        window_start = now;
+        idle_cycles = 0;
+        wakeups = 0;
+        passes = 0;
+    }
+}
+
+/**
+  * @brief  Format the load window as telemetry text, and reset it
+  * @note   "LOAD cpu=12.4% idle=9465000 wake=101000 pass=1000"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Event_FormatLoad(char *buffer, uint32_t size)
+{
+    VR_Load_t load;
+    uint32_t permille = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    VR_Event_GetLoad(&load, true);
+    if (load.elapsed > 0 && load.idle <= load.elapsed) {
+        permille = (uint32_t)((uint64_t)(load.elapsed - load.idle) * 1000u / load.elapsed);
+    }
+
+    return VR_Format_Append(buffer, size, 0, "LOAD cpu=%lu.%lu%% idle=%lu wake=%lu pass=%lu\r\n",
+                            (unsigned long)(permille / 10u), (unsigned long)(permille % 10u),
+                            (unsigned long)load.idle, (unsigned long)load.wakeups, (unsigned long)load.passes);
+}
+
+/* USER CODE END 0 */
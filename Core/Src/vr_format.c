@@ -0,0 +1,60 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_format.c
+  * @brief          : Telemetry text formatting helper
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * snprintf() returns the length the text would have had, which is more
+  * than was written once the buffer is full, and a negative value on an
+  * encoding error. Both are folded here into the length actually in the
+  * buffer, so callers can chain appends and return the result as is.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_format.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <stdarg.h>
+#include <stdio.h>
+/* USER CODE END Includes */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Append formatted text, truncating at the end of the buffer
+  * @note   Once the buffer is full further appends write nothing
+  * @param  buffer: Output buffer, terminated after every append
+  * @param  size: Buffer size in bytes; 0 writes nothing
+  * @param  len: Length already written
+  * @param  fmt: printf format
+  * @retval New length, without the terminator
+  */
+uint32_t VR_Format_Append(char *buffer, uint32_t size, uint32_t len, const char *fmt, ...)
+{
+    va_list args;
+
+    if (len + 1 >= size) {
+        return len;
+    }
+
+    va_start(args, fmt);
+    int n = vsnprintf(buffer + len, size - len, fmt, args);
+    va_end(args);
+
+    if (n < 0) {
+        buffer[len] = '\0';
+        return len;
+    }
+    return (len + (uint32_t)n < size) ? len + (uint32_t)n : size - 1;
+}
+
+/* USER CODE END 0 */
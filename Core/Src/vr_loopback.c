@@ -0,0 +1,139 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_loopback.c
+  * @brief          : DAC->ADC loopback capture
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * PA4 is both DAC_OUT1 and ADC12_IN4, so no external wiring is needed.
+  * TIM8 update events trigger ADC2 conversions and DMA2 Stream2 (channel 1)
+  * fills the capture buffer in normal mode. The transfer-complete callback
+  * stops TIM8; analysis then runs from thread context on the finished buffer.
+  *
+  * The buffer is cacheable so the analysis reads it at cache speed. Its
+  * lines are invalidated before the transfer starts and again once it has
+  * finished, so the CPU never sees data cached before the DMA wrote it.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_loopback.h"
+#include "vr_dma_buffer.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+
+/* USER CODE END Includes */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static uint16_t capture_buffer[VR_LOOPBACK_BUFFER_SIZE] VR_DMA_CACHED_BUFFER;
+static volatile bool capture_complete = false;
+static uint32_t capture_rate_hz = 0;
+extern ADC_HandleTypeDef hadc2;
+extern TIM_HandleTypeDef htim8;
+/* USER CODE END PV */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Sample rate that fits VR_LOOPBACK_REVOLUTIONS into one capture
+  * @param  rpm: RPM that will be captured
+  * @retval Requested sample rate in Hz
+  */
+uint32_t VR_Loopback_RateForRPM(uint16_t rpm)
+{
+    float rate = (float)VR_LOOPBACK_BUFFER_SIZE * rpm / (60.0f * VR_LOOPBACK_REVOLUTIONS);
+
+    if (rate < VR_LOOPBACK_MIN_RATE) return VR_LOOPBACK_MIN_RATE;
+    if (rate > VR_LOOPBACK_MAX_RATE) return VR_LOOPBACK_MAX_RATE;
+    return (uint32_t)rate;
+}
+
+/**
+  * @brief  Start a capture of VR_LOOPBACK_BUFFER_SIZE samples
+  * @param  sample_rate_hz: Requested rate, rounded to a whole TIM8 period
+  * @retval HAL status
+  */
+HAL_StatusTypeDef VR_Loopback_Start(uint32_t sample_rate_hz)
+{
+    if (sample_rate_hz < VR_LOOPBACK_MIN_RATE || sample_rate_hz > VR_LOOPBACK_MAX_RATE) {
+        return HAL_ERROR;
+    }
+
+    uint32_t period = VR_LOOPBACK_TIMER_CLOCK / sample_rate_hz;
+    capture_rate_hz = VR_LOOPBACK_TIMER_CLOCK / period;
+    capture_complete = false;
+
+    __HAL_TIM_SET_AUTORELOAD(&htim8, period - 1);
+    __HAL_TIM_SET_COUNTER(&htim8, 0);
+    VR_DMA_Invalidate(capture_buffer, sizeof(capture_buffer));
+
+    if (HAL_ADC_Start_DMA(&hadc2, (uint32_t *)capture_buffer, VR_LOOPBACK_BUFFER_SIZE) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    // Only the completion interrupt is needed
+    __HAL_DMA_DISABLE_IT(hadc2.DMA_Handle, DMA_IT_HT);
+
+    return HAL_TIM_Base_Start(&htim8);
+}
+
+/**
+  * @brief  Abort a capture in progress
+  * @retval None
+  */
+void VR_Loopback_Stop(void)
+{
+    HAL_TIM_Base_Stop(&htim8);
+    HAL_ADC_Stop_DMA(&hadc2);
+}
+
+/**
+  * @brief  Check whether the last capture has finished
+  * @retval True once the buffer is full
+  */
+bool VR_Loopback_IsComplete(void)
+{
+    return capture_complete;
+}
+
+/**
+  * @brief  Actual rate of the last capture
+  * @retval Sample rate in Hz
+  */
+uint32_t VR_Loopback_GetSampleRate(void)
+{
+    return capture_rate_hz;
+}
+
+/**
+  * @brief  Captured samples
+  * @param  count: Receives the number of samples
+  * @retval Sample buffer, valid until the next capture starts
+  */
+const uint16_t *VR_Loopback_GetSamples(uint32_t *count)
+{
+    *count = VR_LOOPBACK_BUFFER_SIZE;
+    return capture_buffer;
+}
+
+/**
+  * @brief  DMA transfer-complete handler, called from HAL_ADC_ConvCpltCallback()
+  * @retval None
+  */
+void VR_Loopback_CaptureCompleteCallback(void)
+{
+    HAL_TIM_Base_Stop(&htim8);
+    HAL_ADC_Stop_DMA(&hadc2);
+    VR_DMA_Invalidate(capture_buffer, sizeof(capture_buffer));
+    capture_complete = true;
+}
+
+/* USER CODE END 0 */
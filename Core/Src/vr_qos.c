@@ -0,0 +1,271 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_qos.c
+  * @brief          : Overload detection and render quality steps
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The interrupts only count. VR_QoS_SampleDone() runs at the end of the
+  * TIM6 interrupt with its length in core cycles and whether another
+  * update was already pending, and VR_QoS_DacUnderrun() runs from the DAC
+  * underrun interrupt. VR_QoS_Update() runs in the control task and is the
+  * only place the quality changes:
+  * - Any lost sample (overrun, underrun, merged bottom half), or
+  *   VR_QOS_BUSY_LIMIT interrupts over VR_QOS_BUSY_PERCENT of the sample
+  *   period, steps the quality down at once. At the lowest quality the
+  *   update is counted as saturated instead.
+  * - After VR_QOS_RECOVER_UPDATES updates with neither, the quality steps
+  *   back up if no interrupt in that time used VR_QOS_RECOVER_PERCENT of
+  *   the period. That leaves room for the step up to double the cost
+  *   without reaching the busy threshold, so the levels do not oscillate.
+  *
+  * The steps are those of VR_Quality_t: the added noise, the 3rd
+  * harmonic, then the 2nd, then half of the samples per tooth. None
+  * changes the tooth period or phase, so the crank position the ECU sees
+  * stays exact; only the waveform detail degrades, and the edge
+  * resolution at the last step. The noise level set by a scenario is
+  * kept, so it returns with the step back up.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_qos.h"
+#include "vr_sample.h"
+#include "vr_tcm.h"
+#include "vr_format.h"
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+// Written by the interrupts only
+static volatile uint32_t qos_overruns VR_DTCM_BSS = 0;
+static volatile uint32_t qos_underruns VR_DTCM_BSS = 0;
+static volatile uint32_t qos_busy VR_DTCM_BSS = 0;
+static volatile uint32_t qos_peak VR_DTCM_BSS = 0;     // Percent; cleared by each update
+
+// Main loop side
+static uint8_t qos_level = VR_QUALITY_FULL;
+static uint8_t qos_floor = VR_QUALITY_FULL;
+static uint8_t qos_worst = VR_QUALITY_FULL;
+static uint8_t qos_last_peak = 0;
+static uint32_t qos_seen_overruns = 0;
+static uint32_t qos_seen_underruns = 0;
+static uint32_t qos_seen_busy = 0;
+static uint32_t qos_seen_merged = 0;
+static uint32_t qos_merged = 0;
+static uint32_t qos_steps_down = 0;
+static uint32_t qos_steps_up = 0;
+static uint32_t qos_saturated = 0;
+static uint32_t qos_quiet = 0;                          // Updates since the last overload
+static uint32_t qos_quiet_peak = 0;                     // Longest interrupt in that time, percent
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static void QoS_Apply(void);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Start at full quality, counting from the current sample counters
+  * @note   Call after VR_Emulator_Init() and before the sample interrupt starts
+  * @retval None
+  */
+void VR_QoS_Init(void)
+{
+    VR_SampleStats_t samples;
+
+    VR_Sample_GetStats(&samples);
+    qos_seen_overruns = qos_overruns;
+    qos_seen_underruns = qos_underruns;
+    qos_seen_busy = qos_busy;
+    qos_seen_merged = samples.merged;
+    qos_peak = 0;
+    qos_level = VR_QUALITY_FULL;
+    qos_floor = VR_QUALITY_FULL;
+    qos_quiet = 0;
+    qos_quiet_peak = 0;
+    QoS_Apply();
+}
+
+/**
+  * @brief  Account for one sample interrupt
+  * @note   Call at the end of the TIM6 interrupt
+  * @param  cycles: Core cycles from interrupt entry
+  * @param  overrun: True if the next TIM6 update is already pending
+  * @retval None
+  */
+VR_ITCM_CODE void VR_QoS_SampleDone(uint32_t cycles, bool overrun)
+{
+    uint32_t period = VR_Emulator_GetDefault()->state.sample_period_us * (SystemCoreClock / 1000000u);
+    uint32_t percent = (period > 0) ? cycles * 100u / period : 0;
+
+    if (overrun) {
+        qos_overruns++;
+    }
+    if (percent >= VR_QOS_BUSY_PERCENT) {
+        qos_busy++;
+    }
+    if (percent > qos_peak) {
+        qos_peak = percent;
+    }
+}
+
+/**
+  * @brief  Account for a DAC DMA underrun
+  * @note   Call from the DAC channel 1 underrun callback; the level that
+  *         trigger should have output was lost
+  * @retval None
+  */
+void VR_QoS_DacUnderrun(void)
+{
+    qos_underruns++;
+}
+
+/**
+  * @brief  Step the render quality down on overload, or back up after it
+  * @note   Call from the control task, once per potentiometer conversion
+  * @retval None
+  */
+void VR_QoS_Update(void)
+{
+    VR_SampleStats_t samples;
+    uint32_t overruns = qos_overruns;
+    uint32_t underruns = qos_underruns;
+    uint32_t busy = qos_busy;
+    uint32_t peak = __atomic_exchange_n(&qos_peak, 0u, __ATOMIC_RELAXED);
+
+    VR_Sample_GetStats(&samples);
+    uint32_t merged = samples.merged - qos_seen_merged;
+    uint32_t lost = (overruns - qos_seen_overruns) + (underruns - qos_seen_underruns) + merged;
+    uint32_t long_samples = busy - qos_seen_busy;
+
+    qos_seen_overruns = overruns;
+    qos_seen_underruns = underruns;
+    qos_seen_busy = busy;
+    qos_seen_merged = samples.merged;
+    qos_merged += merged;
+    qos_last_peak = (peak > UINT8_MAX) ? UINT8_MAX : (uint8_t)peak;
+
+    if (lost > 0 || long_samples >= VR_QOS_BUSY_LIMIT) {
+        qos_quiet = 0;
+        qos_quiet_peak = 0;
+        if (qos_level < VR_QUALITY_LEVELS - 1) {
+            qos_level++;
+            qos_steps_down++;
+            if (qos_level > qos_worst) {
+                qos_worst = qos_level;
+            }
+        } else {
+            qos_saturated++;
+        }
+    } else if (qos_level > qos_floor) {
+        if (peak > qos_quiet_peak) {
+            qos_quiet_peak = peak;
+        }
+        if (++qos_quiet >= VR_QOS_RECOVER_UPDATES) {
+            if (qos_quiet_peak < VR_QOS_RECOVER_PERCENT) {
+                qos_level--;
+                qos_steps_up++;
+            }
+            qos_quiet = 0;
+            qos_quiet_peak = 0;
+        }
+    }
+
+    QoS_Apply();
+}
+
+/**
+  * @brief  Set the best quality the automatic steps may return to
+  * @note   The quality moves to the floor at once. VR_QUALITY_FULL leaves
+  *         the steps fully automatic; a lower floor keeps the output at
+  *         that quality or below, for testing a rig at reduced quality.
+  * @param  floor: VR_Quality_t level
+  * @retval None
+  */
+void VR_QoS_SetFloor(VR_Quality_t floor)
+{
+    if (floor >= VR_QUALITY_LEVELS) {
+        floor = VR_QUALITY_HALF_RATE;
+    }
+
+    qos_floor = (uint8_t)floor;
+    qos_level = (uint8_t)floor;
+    if (qos_level > qos_worst) {
+        qos_worst = qos_level;
+    }
+    qos_quiet = 0;
+    qos_quiet_peak = 0;
+    QoS_Apply();
+}
+
+/**
+  * @brief  Read the overload counters and the quality in use
+  * @param  stats: Filled with the counts since power-up
+  * @retval None
+  */
+void VR_QoS_GetStats(VR_QosStats_t *stats)
+{
+    stats->level = qos_level;
+    stats->floor = qos_floor;
+    stats->worst = qos_worst;
+    stats->peak_percent = qos_last_peak;
+    stats->overruns = qos_overruns;
+    stats->underruns = qos_underruns;
+    stats->merged = qos_merged;
+    stats->busy = qos_busy;
+    stats->steps_down = qos_steps_down;
+    stats->steps_up = qos_steps_up;
+    stats->saturated = qos_saturated;
+}
+
+/**
+  * @brief  Format the overload counters as telemetry text
+  * @note   "QOS level=0 worst=1 down=1 up=1 ovr=0 udr=0 merged=0 busy=12 sat=0"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_QoS_FormatTelemetry(char *buffer, uint32_t size)
+{
+    VR_QosStats_t stats;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    VR_QoS_GetStats(&stats);
+    return VR_Format_Append(buffer, size, 0, "QOS level=%u worst=%u down=%lu up=%lu ovr=%lu udr=%lu merged=%lu busy=%lu sat=%lu\r\n",
+                            stats.level, stats.worst, (unsigned long)stats.steps_down,
+                            (unsigned long)stats.steps_up, (unsigned long)stats.overruns,
+                            (unsigned long)stats.underruns, (unsigned long)stats.merged,
+                            (unsigned long)stats.busy, (unsigned long)stats.saturated);
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Hand the quality in use to the default emulator
+  * @note   Also restores it after anything re-initialised the emulator
+  * @retval None
+  */
+static void QoS_Apply(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    if (emu->quality != qos_level) {
+        VR_Emu_SetQuality(emu, (VR_Quality_t)qos_level);
+    }
+}
+
+/* USER CODE END 1 */
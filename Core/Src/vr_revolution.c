@@ -0,0 +1,444 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_revolution.c
+  * @brief          : Precomputed revolution output mode
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * A revolution is rendered by an unbound emulator instance with the
+  * default instance's speed and tooth waveform, so it holds exactly the
+  * levels the per-sample path would output. Turning backwards, it is
+  * rendered from tooth 0 down, so a change of direction swapped in at the
+  * end of a revolution continues from the same position. For the buffer to loop
+  * without a seam, a revolution must be a whole number of samples, so
+  * the tooth period is rounded to a multiple of the sample period divided
+  * by its common factor with 18. That is 5 us at the 10 us sample period
+  * used from 926 RPM up, at most 1% at 13400 RPM, and at most 0.15% below
+  * 926 RPM.
+  *
+  * The DAC outputs each level at the TIM6 update after DMA loaded it, so
+  * the half and full transfer interrupts arrive as the samples two before
+  * those positions are output. Each interrupt hands the emulator state
+  * of that sample to the sample bottom half, in place of the TIM6 top
+  * half, so the digital output and ECU capture follow the revolution
+  * being played.
+  *
+  * TIM6 auto-reload preload is on in this mode. A new period written at
+  * the transfer complete interrupt then applies from the update that
+  * outputs the last sample of the revolution, so the first sample of the
+  * next buffer comes one new sample period after it.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_revolution.h"
+#include "vr_sample.h"
+#include "vr_digital_output.h"
+#include "vr_ecu_capture.h"
+#include "vr_counters.h"
+#include "vr_dma_buffer.h"
+#include "vr_format.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    uint16_t *samples;
+    uint32_t length;                // Samples per revolution
+    uint16_t rpm;                   // Parameters rendered
+    bool reverse;
+    const VR_ToothShape_t *shape;
+    uint32_t reload;                // TIM6 auto-reload for the sample period
+    uint32_t marks[2];              // Samples output at the half and full transfer interrupts
+    VR_SensorState_t states[2];     // Emulator state after those samples
+} Rev_Buffer_t;
+/* USER CODE END PTD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+
+// Read by DMA; cleaned from the cache once rendered
+static uint16_t rev_samples[2][VR_REV_MAX_SAMPLES] VR_DMA_CACHED_BUFFER;
+static Rev_Buffer_t rev_buffers[2] = {
+    {.samples = rev_samples[0]},
+    {.samples = rev_samples[1]},
+};
+
+// Main loop side
+static VR_Emulator_t rev_render;                    // Unbound instance the buffers are rendered with
+static uint32_t rev_render_pos = 0;
+static bool rev_rendering = false;
+static bool rev_enabled = false;
+static bool rev_playing = false;                    // DAC triggered by TIM6 and fed by DMA
+static VR_EmulatorBinding_t rev_binding;            // Default instance's binding, restored on stop
+
+// Shared with the transfer interrupts
+static volatile bool rev_swap = false;              // Other buffer ready for the next revolution end
+static volatile uint32_t rev_active = 0;            // Buffer DMA reads
+static VR_SensorState_t rev_last_state;             // Last state handed to the bottom half
+static bool rev_reported = false;
+static volatile uint32_t rev_revolutions = 0;
+static volatile uint32_t rev_swaps = 0;
+static uint32_t rev_renders = 0;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static bool Rev_Matches(const Rev_Buffer_t *buffer, const VR_Emulator_t *emu);
+static void Rev_Begin(Rev_Buffer_t *buffer, const VR_Emulator_t *emu);
+static bool Rev_Render(Rev_Buffer_t *buffer);
+static void Rev_StartOutput(uint32_t index);
+static void Rev_Swap(uint32_t index);
+static uint32_t Rev_Gcd(uint32_t a, uint32_t b);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Enter revolution mode
+  * @note   The output switches over once VR_Rev_Update() has rendered the
+  *         first revolution
+  * @retval None
+  */
+void VR_Rev_Start(void)
+{
+    if (rev_enabled) {
+        return;
+    }
+    rev_enabled = true;
+    rev_rendering = false;
+}
+
+/**
+  * @brief  Return to one TIM6 interrupt per sample
+  * @note   The DAC is disabled for a moment while its trigger changes. The
+  *         per-sample path carries on from the phase last reported.
+  * @retval None
+  */
+void VR_Rev_Stop(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    DAC_ChannelConfTypeDef config = {0};
+
+    if (!rev_enabled) {
+        return;
+    }
+    rev_enabled = false;
+    rev_rendering = false;
+    if (!rev_playing) {
+        return;
+    }
+
+    // No transfer interrupt may swap buffers while the DMA stops
+    __disable_irq();
+    HAL_DAC_Stop_DMA(&hdac, DAC_CHANNEL_1);
+    rev_playing = false;
+    rev_swap = false;
+    __enable_irq();
+
+    config.DAC_Trigger = DAC_TRIGGER_NONE;
+    config.DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+    HAL_DAC_ConfigChannel(&hdac, &config, DAC_CHANNEL_1);
+    HAL_DAC_Start(&hdac, DAC_CHANNEL_1);
+    CLEAR_BIT(htim6.Instance->CR1, TIM_CR1_ARPE);
+
+    if (rev_reported) {
+        emu->state.current_tooth = rev_last_state.current_tooth;
+        emu->state.tooth_timer = rev_last_state.tooth_timer;
+        rev_reported = false;
+    }
+    emu->binding = rev_binding;
+    VR_Emu_SetRPM(emu, emu->state.target_rpm);      // Sample period, or the DC level if stopped
+    VR_Digital_PhaseJump();
+    VR_Capture_PhaseJump();
+
+    __HAL_TIM_CLEAR_FLAG(&htim6, TIM_FLAG_UPDATE);
+    __HAL_TIM_ENABLE_IT(&htim6, TIM_IT_UPDATE);
+}
+
+/**
+  * @brief  Check whether revolution mode is on
+  * @retval True between VR_Rev_Start() and VR_Rev_Stop()
+  */
+bool VR_Rev_IsEnabled(void)
+{
+    return rev_enabled;
+}
+
+/**
+  * @brief  Follow the default emulator's RPM and tooth waveform
+  * @note   Call from the main loop. Renders at most VR_REV_RENDER_CHUNK
+  *         samples per call; a render is restarted if the parameters
+  *         change before it completes.
+  * @retval True if rendering is under way and the call should be repeated
+  */
+bool VR_Rev_Update(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    // The other buffer belongs to the transfer interrupt until it is swapped in
+    if (!rev_enabled || __atomic_load_n(&rev_swap, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    uint32_t index = rev_active ^ 1u;
+    Rev_Buffer_t *buffer = &rev_buffers[index];
+
+    if (rev_rendering && !Rev_Matches(buffer, emu)) {
+        rev_rendering = false;
+    }
+    if (!rev_rendering) {
+        if (rev_playing && Rev_Matches(&rev_buffers[rev_active], emu)) {
+            return false;
+        }
+        Rev_Begin(buffer, emu);
+    }
+    if (!Rev_Render(buffer)) {
+        return true;
+    }
+
+    rev_rendering = false;
+    rev_renders++;
+    VR_DMA_Clean(buffer->samples, buffer->length * sizeof(uint16_t));
+
+    if (rev_playing) {
+        __atomic_store_n(&rev_swap, true, __ATOMIC_RELEASE);
+    } else {
+        Rev_StartOutput(index);
+    }
+    return false;
+}
+
+/**
+  * @brief  Half or all of the revolution loaded; call from the DAC DMA
+  *         half and full transfer callbacks, then pend the bottom half
+  * @param  complete: False at the half transfer, true at the end of the buffer
+  * @retval None
+  */
+void VR_Rev_TransferCallback(bool complete)
+{
+    uint32_t count = __HAL_TIM_GET_COUNTER(&htim2) - VR_REV_DMA_LATENCY_TICKS;
+    const Rev_Buffer_t *buffer = &rev_buffers[rev_active];
+    const VR_SensorState_t *state = &buffer->states[complete ? 1 : 0];
+    uint32_t half = buffer->length / 2u;
+
+    VR_Counters_Output(state, count, complete ? buffer->length - half : half);
+    VR_Sample_Publish(state, count);
+    rev_last_state = *state;
+    rev_reported = true;
+    if (!complete) {
+        return;
+    }
+
+    rev_revolutions++;
+    if (__atomic_load_n(&rev_swap, __ATOMIC_ACQUIRE)) {
+        Rev_Swap(rev_active ^ 1u);
+    }
+}
+
+/**
+  * @brief  Read the revolution mode counters
+  * @param  stats: Filled with the buffer playing and the counts since power-up
+  * @retval None
+  */
+void VR_Rev_GetStats(VR_RevStats_t *stats)
+{
+    const Rev_Buffer_t *buffer = &rev_buffers[rev_active];
+
+    stats->length = rev_playing ? buffer->length : 0;
+    stats->tooth_period_us = rev_playing ? buffer->states[1].tooth_period_us : 0;
+    stats->revolutions = rev_revolutions;
+    stats->renders = rev_renders;
+    stats->swaps = rev_swaps;
+}
+
+/**
+  * @brief  Format the revolution mode counters as telemetry text
+  * @note   "REV len=448 tooth=250us revs=22300 renders=3 swaps=2";
+  *         nothing while the mode is off
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Rev_FormatTelemetry(char *buffer, uint32_t size)
+{
+    VR_RevStats_t stats;
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+    if (!rev_enabled) {
+        return 0;
+    }
+
+    VR_Rev_GetStats(&stats);
+    return VR_Format_Append(buffer, size, 0, "REV len=%lu tooth=%luus revs=%lu renders=%lu swaps=%lu\r\n",
+                            (unsigned long)stats.length, (unsigned long)stats.tooth_period_us,
+                            (unsigned long)stats.revolutions, (unsigned long)stats.renders,
+                            (unsigned long)stats.swaps);
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Check whether a buffer was rendered for the emulator's parameters
+  * @param  buffer: Revolution buffer
+  * @param  emu: Default emulator instance
+  * @retval True if the speed and tooth waveform match
+  */
+static bool Rev_Matches(const Rev_Buffer_t *buffer, const VR_Emulator_t *emu)
+{
+    return buffer->rpm == emu->state.target_rpm && buffer->reverse == emu->state.reverse &&
+           buffer->shape == emu->shape;
+}
+
+/**
+  * @brief  Size a buffer and start rendering into it from tooth 0
+  * @param  buffer: Revolution buffer
+  * @param  emu: Default emulator instance
+  * @retval None
+  */
+static void Rev_Begin(Rev_Buffer_t *buffer, const VR_Emulator_t *emu)
+{
+    VR_SensorState_t *state = &rev_render.state;
+
+    VR_Emu_Init(&rev_render, NULL);
+    VR_Emu_SetShape(&rev_render, emu->shape);
+    VR_Emu_SetSpeed(&rev_render, VR_Emu_GetSpeed(emu));
+    state->reverse = emu->state.reverse;
+    buffer->rpm = emu->state.target_rpm;
+    buffer->reverse = emu->state.reverse;
+    buffer->shape = emu->shape;
+
+    if (state->tooth_period_us == 0) {
+        // Stopped: hold the DC level at the sample period already running
+        state->sample_period_us = emu->state.sample_period_us;
+        buffer->length = VR_REV_STOP_SAMPLES;
+    } else {
+        uint32_t step = state->sample_period_us / Rev_Gcd(TRIGGER_WHEEL_TEETH, state->sample_period_us);
+        uint32_t period = (state->tooth_period_us + step / 2u) / step * step;
+
+        state->tooth_period_us = (period > 0) ? period : step;
+        buffer->length = TRIGGER_WHEEL_TEETH * state->tooth_period_us / state->sample_period_us;
+        if (buffer->length > VR_REV_MAX_SAMPLES) {
+            buffer->length = VR_REV_MAX_SAMPLES;    // Not reached for any RPM up to MAX_RPM
+        }
+    }
+
+    buffer->reload = state->sample_period_us / VR_SAMPLE_TICK_US - 1u;
+    buffer->marks[0] = buffer->length - buffer->length / 2u - 2u;     // Half transfer at NDTR = length / 2
+    buffer->marks[1] = buffer->length - 2u;
+    rev_render_pos = 0;
+    rev_rendering = true;
+}
+
+/**
+  * @brief  Render the next chunk of a revolution
+  * @param  buffer: Revolution buffer set up by Rev_Begin()
+  * @retval True once the whole revolution is rendered
+  */
+static bool Rev_Render(Rev_Buffer_t *buffer)
+{
+    uint32_t end = rev_render_pos + VR_REV_RENDER_CHUNK;
+
+    if (end > buffer->length) {
+        end = buffer->length;
+    }
+
+    for (; rev_render_pos < end; rev_render_pos++) {
+        VR_Emu_GenerateSignal(&rev_render);
+        buffer->samples[rev_render_pos] = rev_render.state.dac_output;
+        if (rev_render_pos == buffer->marks[0]) {
+            buffer->states[0] = rev_render.state;
+        }
+        if (rev_render_pos == buffer->marks[1]) {
+            buffer->states[1] = rev_render.state;
+        }
+    }
+    return rev_render_pos == buffer->length;
+}
+
+/**
+  * @brief  Hand the DAC from the TIM6 interrupt to TIM6-triggered DMA
+  * @param  index: Rendered buffer to play
+  * @retval None
+  */
+static void Rev_StartOutput(uint32_t index)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    Rev_Buffer_t *buffer = &rev_buffers[index];
+    DAC_ChannelConfTypeDef config = {0};
+
+    // The default instance keeps following the potentiometer and the
+    // commands, but no longer drives the DAC or the TIM6 period
+    __HAL_TIM_DISABLE_IT(&htim6, TIM_IT_UPDATE);
+    rev_binding = emu->binding;
+    emu->binding.hdac = NULL;
+    emu->binding.htim = NULL;
+    VR_Digital_PhaseJump();
+    VR_Capture_PhaseJump();
+    VR_Counters_PhaseJump();
+
+    SET_BIT(htim6.Instance->CR1, TIM_CR1_ARPE);
+    __HAL_TIM_SET_AUTORELOAD(&htim6, buffer->reload);
+
+    HAL_DAC_Stop(&hdac, DAC_CHANNEL_1);
+    config.DAC_Trigger = DAC_TRIGGER_T6_TRGO;
+    config.DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+    HAL_DAC_ConfigChannel(&hdac, &config, DAC_CHANNEL_1);
+
+    rev_active = index;
+    rev_playing = true;
+    HAL_DAC_Start_DMA(&hdac, DAC_CHANNEL_1, (uint32_t *)buffer->samples, buffer->length, DAC_ALIGN_12B_R);
+}
+
+/**
+  * @brief  Play the other buffer from the next revolution; call from the
+  *         transfer complete interrupt
+  * @note   DMA has just loaded the last level of the revolution, so there
+  *         is one sample period to restart it
+  * @param  index: Buffer to play
+  * @retval None
+  */
+static void Rev_Swap(uint32_t index)
+{
+    Rev_Buffer_t *buffer = &rev_buffers[index];
+
+    __HAL_TIM_SET_AUTORELOAD(&htim6, buffer->reload);
+    HAL_DMA_Abort(hdac.DMA_Handle1);
+    HAL_DAC_Start_DMA(&hdac, DAC_CHANNEL_1, (uint32_t *)buffer->samples, buffer->length, DAC_ALIGN_12B_R);
+
+    rev_active = index;
+    rev_swaps++;
+    __atomic_store_n(&rev_swap, false, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  Greatest common divisor
+  * @param  a: First value
+  * @param  b: Second value
+  * @retval Largest number dividing both
+  */
+static uint32_t Rev_Gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/* USER CODE END 1 */
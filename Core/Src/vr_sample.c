@@ -0,0 +1,165 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_sample.c
+  * @brief          : TIM6 sample interrupt and its bottom half
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The top half reads the TIM2 count first, so the time it records does
+  * not depend on how long the level takes to render. It then publishes
+  * the count and a copy of the emulator state, and bumps a sequence
+  * number.
+  *
+  * The bottom half only ever runs below the top half, so a sample can
+  * arrive while it copies the record but not the other way round. It
+  * copies again until the sequence number is unchanged across the copy.
+  * If several samples arrive before it runs, it acts on the latest one
+  * only and counts the others as merged. The digital output then adopts
+  * an RPM change a sample late, and a capture made in between is
+  * converted with the phase from before the change, so the merged count
+  * should stay at or near zero.
+  *
+  * The digital output and the ECU capture follow forward rotation only.
+  * While the wheel turns backwards they are handed the wheel at rest, as
+  * when stopped, and pick the phase up again once it turns forwards.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_sample.h"
+#include "vr_sensor_emulator.h"
+#include "vr_digital_output.h"
+#include "vr_ecu_capture.h"
+#include "vr_counters.h"
+#include "vr_scenario.h"
+#include "vr_tcm.h"
+#include "vr_format.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    VR_SensorState_t state;         // Default emulator after the sample
+    uint32_t count;                 // TIM2 count at the TIM6 update
+} Sample_Record_t;
+/* USER CODE END PTD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+extern TIM_HandleTypeDef htim2;
+
+static Sample_Record_t record VR_DTCM_BSS;
+static volatile uint32_t published VR_DTCM_BSS = 0;    // Records written by the top half
+
+// Written by the bottom half only
+static uint32_t consumed VR_DTCM_BSS = 0;
+static uint32_t runs VR_DTCM_BSS = 0;
+static uint32_t merged VR_DTCM_BSS = 0;
+/* USER CODE END PV */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Sample top half: write the DAC level and record the sample
+  * @note   Call from the TIM6 update interrupt, then pend the bottom half.
+  *         Scenario events due at this update are applied before it renders.
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Sample_TopHalf(void)
+{
+    uint32_t count = __HAL_TIM_GET_COUNTER(&htim2) - VR_DIGITAL_SAMPLE_LATENCY_TICKS;
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    VR_Scenario_Service();
+    VR_Emu_TimerCallback(emu);
+    VR_Counters_Output(&emu->state, count, 1);
+    VR_Sample_Publish(&emu->state, count);
+}
+
+/**
+  * @brief  Record a sample for the bottom half
+  * @note   Call from the top half, or from another interrupt that stands in
+  *         for it, at the same or a higher priority
+  * @param  state: Emulator state after the sample
+  * @param  count: TIM2 count at the sample
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Sample_Publish(const VR_SensorState_t *state, uint32_t count)
+{
+    record.state = *state;
+    record.count = count;
+    __atomic_store_n(&published, published + 1u, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  Sample bottom half: follow the latest sample's phase
+  * @note   Call from PendSV, below every interrupt that touches the
+  *         digital output or the capture channels
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Sample_BottomHalf(void)
+{
+    Sample_Record_t latest;
+    uint32_t sequence;
+
+    do {
+        sequence = __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+        latest = record;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&published, __ATOMIC_RELAXED) != sequence);
+
+    if (sequence == consumed) {
+        return;
+    }
+    merged += sequence - consumed - 1u;
+    consumed = sequence;
+    runs++;
+
+    if (latest.state.reverse) {
+        latest.state.tooth_period_us = 0;
+    }
+
+    VR_Digital_SampleCallback(&latest.state, latest.count);
+    VR_Capture_SampleCallback(&latest.state, latest.count);
+}
+
+/**
+  * @brief  Read the sample counters
+  * @note   Each counter is read on its own, so they may be a sample apart
+  * @param  stats: Filled with the counts since power-up
+  * @retval None
+  */
+void VR_Sample_GetStats(VR_SampleStats_t *stats)
+{
+    stats->runs = runs;
+    stats->merged = merged;
+    stats->samples = __atomic_load_n(&published, __ATOMIC_ACQUIRE);
+}
+
+/**
+  * @brief  Format the sample counters as telemetry text
+  * @note   "SAMPLE n=1000000 bh=1000000 merged=0"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Sample_FormatTelemetry(char *buffer, uint32_t size)
+{
+    VR_SampleStats_t stats;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    VR_Sample_GetStats(&stats);
+    return VR_Format_Append(buffer, size, 0, "SAMPLE n=%lu bh=%lu merged=%lu\r\n",
+                            (unsigned long)stats.samples, (unsigned long)stats.runs,
+                            (unsigned long)stats.merged);
+}
+
+/* USER CODE END 0 */
@@ -0,0 +1,381 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_scenario.c
+  * @brief          : Scenario sequencer
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The player runs in the sample interrupt, before each update renders
+  * its level. Scenario time is the sum of the sample periods the
+  * emulator has run, in TIM6 ticks, so it is the time on the output pin
+  * whatever the speed. An event takes effect at the first update at or
+  * after its tick: the same scenario always changes the same sample.
+  *
+  * The image is sorted by tick and checked once by VR_Scenario_Load(),
+  * so playing it needs no search: the player keeps the index of the next
+  * event and the tick of the next thing to do, and an update with
+  * nothing due costs one addition and one compare. A ramp sets the speed
+  * every VR_SCENARIO_RAMP_STEP_TICKS, interpolated on the scenario's own
+  * time from the speed the wheel had when the ramp began.
+  *
+  * At the end of the run the fault, gain and noise are cleared and the
+  * wheel keeps its last speed and waveform.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_scenario.h"
+#include "vr_counters.h"
+#include "vr_tcm.h"
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+static VR_Scenario_t scenario_default VR_DTCM_BSS;    // Played by the sample interrupt
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static bool Scenario_Run(VR_Scenario_t *scn, VR_Emulator_t *emu);
+static void Scenario_Apply(VR_Scenario_t *scn, VR_Emulator_t *emu, const VR_ScenarioEvent_t *event);
+static void Scenario_Ramp(VR_Scenario_t *scn, VR_Emulator_t *emu);
+static bool Scenario_IsValidEvent(const VR_ScenarioEvent_t *event, const VR_ToothShape_t *const *shapes,
+                                  uint32_t num_shapes);
+static void Scenario_CountFaults(uint32_t from, uint32_t to);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Check a compiled scenario and prepare to play it
+  * @note   The image is read while the scenario plays and must stay
+  *         unchanged until it is stopped; it must be 4-byte aligned
+  * @param  scn: Player to prepare
+  * @param  image: Header and events
+  * @param  size: Image size in bytes
+  * @param  shapes: Tables SHAPE events select, shapes[0] as table 1
+  * @param  num_shapes: Number of tables, up to VR_SCENARIO_MAX_SHAPES
+  * @retval True if the image is valid, false leaves the player stopped
+  */
+bool VR_Scenario_Load(VR_Scenario_t *scn, const void *image, uint32_t size,
+                      const VR_ToothShape_t *const *shapes, uint32_t num_shapes)
+{
+    const VR_ScenarioHeader_t *header = (const VR_ScenarioHeader_t *)image;
+    const VR_ScenarioEvent_t *events = (const VR_ScenarioEvent_t *)(header + 1);
+
+    scn->running = false;
+    scn->count = 0;
+
+    if (((uintptr_t)image & 3u) != 0 || size < sizeof(VR_ScenarioHeader_t) ||
+        num_shapes > VR_SCENARIO_MAX_SHAPES) {
+        return false;
+    }
+    if (header->magic != VR_SCENARIO_MAGIC || header->version != VR_SCENARIO_VERSION ||
+        header->count > VR_SCENARIO_MAX_EVENTS || size != VR_SCENARIO_IMAGE_SIZE(header->count)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (events[i].tick > header->duration || (i > 0 && events[i].tick < events[i - 1].tick) ||
+            !Scenario_IsValidEvent(&events[i], shapes, num_shapes)) {
+            return false;
+        }
+    }
+
+    scn->events = events;
+    scn->count = header->count;
+    scn->duration = header->duration;
+    for (uint32_t i = 0; i < VR_SCENARIO_MAX_SHAPES; i++) {
+        scn->shapes[i] = (i < num_shapes) ? shapes[i] : NULL;
+    }
+    scn->next = 0;
+    scn->tick = 0;
+    return true;
+}
+
+/**
+  * @brief  Play a loaded scenario from its start
+  * @note   Events at tick 0 are applied before this returns
+  * @param  scn: Loaded player
+  * @param  emu: Emulator to drive
+  * @retval None
+  */
+void VR_Scenario_Start(VR_Scenario_t *scn, VR_Emulator_t *emu)
+{
+    __atomic_store_n(&scn->running, false, __ATOMIC_RELEASE);
+    scn->next = 0;
+    scn->tick = 0;
+    scn->ramping = false;
+    scn->applied = 0;
+    scn->faults = 0;
+
+    if (Scenario_Run(scn, emu)) {
+        VR_Scenario_Stop(scn, emu);
+        return;
+    }
+    __atomic_store_n(&scn->running, true, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  Advance the scenario to this update and apply what is due
+  * @note   Call from the sample interrupt before the update renders
+  * @param  scn: Player
+  * @param  emu: Emulator it drives
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Scenario_Sample(VR_Scenario_t *scn, VR_Emulator_t *emu)
+{
+    if (!scn->running) {
+        return;
+    }
+
+    // The period just held; an event may change the next one
+    scn->tick += emu->state.sample_period_us / VR_SAMPLE_TICK_US;
+    if (scn->tick < scn->due) {
+        return;
+    }
+
+    if (Scenario_Run(scn, emu)) {
+        VR_Scenario_Stop(scn, emu);
+    }
+}
+
+/**
+  * @brief  Stop playing and clear the output impairments
+  * @note   The wheel keeps its speed and waveform
+  * @param  scn: Player
+  * @param  emu: Emulator it drove
+  * @retval None
+  */
+void VR_Scenario_Stop(VR_Scenario_t *scn, VR_Emulator_t *emu)
+{
+    __atomic_store_n(&scn->running, false, __ATOMIC_RELEASE);
+    scn->ramping = false;
+    VR_Emu_SetFault(emu, VR_FAULT_NONE);
+    VR_Emu_SetNoise(emu, 0, 0);
+    VR_Emu_SetAmplitude(emu, VR_AMPLITUDE_FULL);
+}
+
+/**
+  * @brief  Check whether the whole run has been played
+  * @param  scn: Player
+  * @retval True once every event has been applied and the duration reached
+  */
+bool VR_Scenario_IsDone(const VR_Scenario_t *scn)
+{
+    return !scn->running && scn->next >= scn->count && scn->tick >= scn->duration;
+}
+
+/**
+  * @brief  Play a scenario on the default emulator
+  * @note   Stops any scenario already playing first
+  * @param  image: Compiled scenario; must stay unchanged until it ends
+  * @param  size: Image size in bytes
+  * @param  shape: Table 1 for SHAPE events, NULL for none
+  * @retval True if started, false if the image is invalid
+  */
+bool VR_Scenario_Begin(const void *image, uint32_t size, const VR_ToothShape_t *shape)
+{
+    VR_Scenario_End();
+    if (!VR_Scenario_Load(&scenario_default, image, size, &shape, (shape != NULL) ? 1 : 0)) {
+        return false;
+    }
+
+    VR_Scenario_Start(&scenario_default, VR_Emulator_GetDefault());
+    Scenario_CountFaults(0, scenario_default.faults);
+    return true;
+}
+
+/**
+  * @brief  Stop the default emulator's scenario
+  * @retval None
+  */
+void VR_Scenario_End(void)
+{
+    if (scenario_default.running) {
+        VR_Scenario_Stop(&scenario_default, VR_Emulator_GetDefault());
+    }
+}
+
+/**
+  * @brief  Check whether a scenario sets the default emulator's speed
+  * @retval True from VR_Scenario_Begin() to the end of the run or VR_Scenario_End()
+  */
+bool VR_Scenario_IsRunning(void)
+{
+    return __atomic_load_n(&scenario_default.running, __ATOMIC_ACQUIRE);
+}
+
+/**
+  * @brief  Play the default emulator's scenario up to this update
+  * @note   Call from the sample top half, before the update renders
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Scenario_Service(void)
+{
+    if (!__atomic_load_n(&scenario_default.running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    uint32_t faults = scenario_default.faults;
+    VR_Scenario_Sample(&scenario_default, VR_Emulator_GetDefault());
+    Scenario_CountFaults(faults, scenario_default.faults);
+}
+
+/**
+  * @brief  Get the default emulator's player
+  * @retval Player state; written by the sample interrupt
+  */
+const VR_Scenario_t *VR_Scenario_GetDefault(void)
+{
+    return &scenario_default;
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Apply every event and ramp step due at the current tick
+  * @param  scn: Player
+  * @param  emu: Emulator it drives
+  * @retval True if the run is over
+  */
+VR_ITCM_CODE static bool Scenario_Run(VR_Scenario_t *scn, VR_Emulator_t *emu)
+{
+    while (scn->next < scn->count && scn->events[scn->next].tick <= scn->tick) {
+        Scenario_Apply(scn, emu, &scn->events[scn->next]);
+        scn->next++;
+        scn->applied++;
+    }
+    if (scn->ramping && scn->tick >= scn->ramp_next) {
+        Scenario_Ramp(scn, emu);
+    }
+
+    scn->due = (scn->next < scn->count) ? scn->events[scn->next].tick : scn->duration;
+    if (scn->ramping && scn->ramp_next < scn->due) {
+        scn->due = scn->ramp_next;
+    }
+    return scn->next >= scn->count && !scn->ramping && scn->tick >= scn->duration;
+}
+
+/**
+  * @brief  Apply one event
+  * @param  scn: Player
+  * @param  emu: Emulator it drives
+  * @param  event: Event due now
+  * @retval None
+  */
+VR_ITCM_CODE static void Scenario_Apply(VR_Scenario_t *scn, VR_Emulator_t *emu, const VR_ScenarioEvent_t *event)
+{
+    switch (event->kind) {
+    case VR_SCENARIO_SPEED:
+        scn->ramping = false;
+        VR_Emu_SetSpeed(emu, event->value);
+        break;
+    case VR_SCENARIO_RAMP:
+        // Timed from the event, not the update that applies it
+        scn->ramping = true;
+        scn->ramp_from = VR_Emu_GetSpeed(emu);
+        scn->ramp_to = event->value;
+        scn->ramp_start = event->tick;
+        scn->ramp_span = event->span;
+        scn->ramp_next = event->tick;
+        break;
+    case VR_SCENARIO_SHAPE:
+        VR_Emu_SetShape(emu, (event->arg == 0) ? NULL : scn->shapes[event->arg - 1]);
+        break;
+    case VR_SCENARIO_FAULT:
+        VR_Emu_SetFault(emu, (VR_Fault_t)event->arg);
+        if (event->arg != VR_FAULT_NONE) {
+            scn->faults++;
+        }
+        break;
+    case VR_SCENARIO_GAIN:
+        VR_Emu_SetAmplitude(emu, (uint16_t)event->value);
+        break;
+    case VR_SCENARIO_NOISE:
+        VR_Emu_SetNoise(emu, (uint16_t)event->value, event->span);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+  * @brief  Set the speed on the ramp at the current tick
+  * @param  scn: Player with a ramp in progress
+  * @param  emu: Emulator it drives
+  * @retval None
+  */
+VR_ITCM_CODE static void Scenario_Ramp(VR_Scenario_t *scn, VR_Emulator_t *emu)
+{
+    uint32_t elapsed = scn->tick - scn->ramp_start;
+    int32_t rpm;
+
+    if (elapsed >= scn->ramp_span) {
+        rpm = scn->ramp_to;
+        scn->ramping = false;
+    } else {
+        rpm = scn->ramp_from + (int32_t)((int64_t)(scn->ramp_to - scn->ramp_from) * elapsed / scn->ramp_span);
+    }
+    if (rpm != VR_Emu_GetSpeed(emu)) {
+        VR_Emu_SetSpeed(emu, rpm);
+    }
+
+    // Steps stay on the ramp's own grid after a long sample
+    while (scn->ramp_next <= scn->tick) {
+        scn->ramp_next += VR_SCENARIO_RAMP_STEP_TICKS;
+    }
+}
+
+/**
+  * @brief  Check one event's fields against its kind
+  * @param  event: Event to check
+  * @param  shapes: Tables SHAPE events select
+  * @param  num_shapes: Number of tables
+  * @retval True if the event can be applied
+  */
+static bool Scenario_IsValidEvent(const VR_ScenarioEvent_t *event, const VR_ToothShape_t *const *shapes,
+                                  uint32_t num_shapes)
+{
+    switch (event->kind) {
+    case VR_SCENARIO_SPEED:
+        return event->value >= -MAX_RPM && event->value <= MAX_RPM;
+    case VR_SCENARIO_RAMP:
+        return event->value >= -MAX_RPM && event->value <= MAX_RPM && event->span > 0;
+    case VR_SCENARIO_SHAPE:
+        return event->arg == 0 ||
+               (event->arg <= num_shapes && shapes[event->arg - 1] != NULL &&
+                VR_Shape_IsValid(shapes[event->arg - 1]));
+    case VR_SCENARIO_FAULT:
+        return event->arg < VR_FAULT_COUNT;
+    case VR_SCENARIO_GAIN:
+        return event->value >= 0 && event->value <= VR_AMPLITUDE_FULL;
+    case VR_SCENARIO_NOISE:
+        return event->value >= 0 && event->value <= VR_NOISE_MAX_LSB;
+    default:
+        return false;
+    }
+}
+
+/**
+  * @brief  Add the default scenario's new fault windows to the counters
+  * @param  from: Windows opened before
+  * @param  to: Windows opened now
+  * @retval None
+  */
+VR_ITCM_CODE static void Scenario_CountFaults(uint32_t from, uint32_t to)
+{
+    for (; from != to; from++) {
+        VR_Counters_Fault();
+    }
+}
+
+/* USER CODE END 1 */
@@ -0,0 +1,365 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_sched.c
+  * @brief          : Cooperative background task scheduler
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * Times are TIM2 counts and are compared as signed differences, so the
+  * 40 s wrap of the counter is harmless while every release lies within
+  * half of it of the present (VR_SCHED_MAX_PERIOD_US).
+  *
+  * A periodic task that starts late by one or more whole periods runs
+  * once, for its latest release; the releases it passed over are counted
+  * as skips. The next release stays on the period grid, so a late run
+  * does not shift the phase of the ones after it.
+  *
+  * VR_Sched_RunReady() runs each task at most once per call, so a task
+  * that keeps itself ready cannot hold the main loop. The caller arms a
+  * wake-up for VR_Sched_NextRelease(), which may already have passed.
+  *
+  * The scheduler belongs to the main loop; interrupts post events and the
+  * main loop triggers the tasks that handle them.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_sched.h"
+#include "vr_format.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <string.h>
+/* USER CODE END Includes */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    const char *name;
+    VR_TaskFunc_t func;
+    void *ctx;
+    uint8_t priority;               // 0 runs first
+    bool armed;                     // Has a release pending
+    uint32_t period;                // TIM2 ticks, 0 for a one-shot task
+    uint32_t deadline;              // TIM2 ticks after release
+    uint32_t release;               // TIM2 count
+    VR_TaskStats_t stats;
+} Sched_Task_t;
+/* USER CODE END PTD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+extern TIM_HandleTypeDef htim2;
+
+static Sched_Task_t tasks[VR_SCHED_MAX_TASKS];
+static uint32_t task_count = 0;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static VR_TaskId_t Sched_Add(const char *name, VR_TaskFunc_t func, void *ctx, uint8_t priority,
+                             uint32_t period_us, uint32_t deadline_us);
+static void Sched_ClearStats(VR_TaskStats_t *stats);
+static bool Sched_Before(const Sched_Task_t *a, const Sched_Task_t *b);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Remove every task
+  * @retval None
+  */
+void VR_Sched_Init(void)
+{
+    memset(tasks, 0, sizeof(tasks));
+    task_count = 0;
+}
+
+/**
+  * @brief  Add a task released every period, first one period from now
+  * @param  name: Name shown in telemetry; must outlive the scheduler
+  * @param  func: Task body
+  * @param  ctx: Passed to the task body
+  * @param  priority: 0 runs first
+  * @param  period_us: Release period, 1 us to VR_SCHED_MAX_PERIOD_US
+  * @param  deadline_us: Finish within this of each release; 0 for the period
+  * @retval Task handle, or VR_SCHED_NO_TASK if the table is full or an
+  *         argument is out of range
+  */
+VR_TaskId_t VR_Sched_AddPeriodic(const char *name, VR_TaskFunc_t func, void *ctx, uint8_t priority,
+                                 uint32_t period_us, uint32_t deadline_us)
+{
+    if (period_us == 0) {
+        return VR_SCHED_NO_TASK;
+    }
+
+    VR_TaskId_t id = Sched_Add(name, func, ctx, priority, period_us, (deadline_us != 0) ? deadline_us : period_us);
+    if (id != VR_SCHED_NO_TASK) {
+        tasks[id].release = __HAL_TIM_GET_COUNTER(&htim2) + tasks[id].period;
+        tasks[id].armed = true;
+    }
+    return id;
+}
+
+/**
+  * @brief  Add a task that runs once each time it is triggered
+  * @param  name: Name shown in telemetry; must outlive the scheduler
+  * @param  func: Task body
+  * @param  ctx: Passed to the task body
+  * @param  priority: 0 runs first
+  * @param  deadline_us: Finish within this of the release, up to VR_SCHED_MAX_PERIOD_US
+  * @retval Task handle, or VR_SCHED_NO_TASK if the table is full or an
+  *         argument is out of range
+  */
+VR_TaskId_t VR_Sched_AddOneShot(const char *name, VR_TaskFunc_t func, void *ctx, uint8_t priority,
+                                uint32_t deadline_us)
+{
+    return Sched_Add(name, func, ctx, priority, 0, deadline_us);
+}
+
+/**
+  * @brief  Release a task after a delay
+  * @note   A task already released earlier keeps its earlier release, so
+  *         triggers that arrive before it runs are served by one run.
+  *         A periodic task continues its period from the new release.
+  * @param  id: Task handle
+  * @param  delay_us: Delay from now, up to VR_SCHED_MAX_PERIOD_US
+  * @retval True if the task is released
+  */
+bool VR_Sched_Trigger(VR_TaskId_t id, uint32_t delay_us)
+{
+    if (id >= task_count || delay_us > VR_SCHED_MAX_PERIOD_US) {
+        return false;
+    }
+
+    Sched_Task_t *task = &tasks[id];
+    uint32_t release = __HAL_TIM_GET_COUNTER(&htim2) + delay_us * VR_SCHED_TICKS_PER_US;
+
+    if (!task->armed || (int32_t)(release - task->release) < 0) {
+        task->release = release;
+        task->armed = true;
+    }
+    return true;
+}
+
+/**
+  * @brief  Withdraw a task's pending release; a periodic task stops until triggered
+  * @param  id: Task handle
+  * @retval None
+  */
+void VR_Sched_Cancel(VR_TaskId_t id)
+{
+    if (id < task_count) {
+        tasks[id].armed = false;
+    }
+}
+
+/**
+  * @brief  Run the released tasks, most urgent first, each at most once
+  * @retval Number of tasks run
+  */
+uint32_t VR_Sched_RunReady(void)
+{
+    uint32_t ran = 0;                   // Bit per task run in this call
+    uint32_t runs = 0;
+
+    for (;;) {
+        uint32_t now = __HAL_TIM_GET_COUNTER(&htim2);
+        Sched_Task_t *next = NULL;
+
+        for (uint32_t i = 0; i < task_count; i++) {
+            Sched_Task_t *task = &tasks[i];
+
+            if (task->armed && (ran & (1u << i)) == 0 && (int32_t)(now - task->release) >= 0 &&
+                (next == NULL || Sched_Before(task, next))) {
+                next = task;
+            }
+        }
+        if (next == NULL) {
+            return runs;
+        }
+        ran |= 1u << (uint32_t)(next - tasks);
+
+        uint32_t release = next->release;
+        if (next->period != 0) {
+            // Serve the latest release passed; the earlier ones are skipped
+            uint32_t missed = (now - release) / next->period;
+            release += missed * next->period;
+            next->release = release + next->period;
+            next->stats.skips += missed;
+        } else {
+            next->armed = false;
+        }
+
+        uint32_t late = now - release;
+        uint32_t start = __HAL_TIM_GET_COUNTER(&htim2);
+        next->func(next->ctx);
+        uint32_t end = __HAL_TIM_GET_COUNTER(&htim2);
+        uint32_t run = end - start;
+
+        VR_TaskStats_t *stats = &next->stats;
+        stats->runs++;
+        stats->run_total += run;
+        if (run < stats->run_min) {
+            stats->run_min = run;
+        }
+        if (run > stats->run_max) {
+            stats->run_max = run;
+        }
+        if (late > stats->late_max) {
+            stats->late_max = late;
+        }
+        if ((int32_t)(end - (release + next->deadline)) > 0) {
+            stats->misses++;
+        }
+        runs++;
+    }
+}
+
+/**
+  * @brief  Find the earliest pending release
+  * @param  count: Set to its TIM2 count; it may already have passed
+  * @retval False if no task is released
+  */
+bool VR_Sched_NextRelease(uint32_t *count)
+{
+    uint32_t now = __HAL_TIM_GET_COUNTER(&htim2);
+    bool found = false;
+    int32_t soonest = 0;
+
+    for (uint32_t i = 0; i < task_count; i++) {
+        if (!tasks[i].armed) {
+            continue;
+        }
+
+        int32_t wait = (int32_t)(tasks[i].release - now);
+        if (!found || wait < soonest) {
+            soonest = wait;
+            found = true;
+        }
+    }
+
+    if (found) {
+        *count = now + (uint32_t)soonest;
+    }
+    return found;
+}
+
+/**
+  * @brief  Copy a task's statistics
+  * @param  id: Task handle
+  * @param  stats: Destination; run_min is UINT32_MAX before the first run
+  * @param  reset: Start a new window after copying
+  * @retval False for an unknown handle
+  */
+bool VR_Sched_GetStats(VR_TaskId_t id, VR_TaskStats_t *stats, bool reset)
+{
+    if (id >= task_count) {
+        return false;
+    }
+
+    *stats = tasks[id].stats;
+    if (reset) {
+        Sched_ClearStats(&tasks[id].stats);
+    }
+    return true;
+}
+
+/**
+  * @brief  Format every task with runs as telemetry text, and reset them
+  * @note   One line per task: "TASK tlm n=10 avg=85us max=112us late=4us miss=0 skip=0"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Sched_FormatTelemetry(char *buffer, uint32_t size)
+{
+    uint32_t len = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+
+    for (VR_TaskId_t id = 0; id < task_count; id++) {
+        VR_TaskStats_t stats;
+
+        VR_Sched_GetStats(id, &stats, true);
+        if (stats.runs == 0) {
+            continue;
+        }
+
+        len = VR_Format_Append(buffer, size, len, "TASK %s n=%lu avg=%luus max=%luus late=%luus miss=%lu skip=%lu\r\n",
+                               tasks[id].name, (unsigned long)stats.runs,
+                               (unsigned long)(stats.run_total / stats.runs / VR_SCHED_TICKS_PER_US),
+                               (unsigned long)(stats.run_max / VR_SCHED_TICKS_PER_US),
+                               (unsigned long)(stats.late_max / VR_SCHED_TICKS_PER_US),
+                               (unsigned long)stats.misses, (unsigned long)stats.skips);
+    }
+
+    return len;
+}
+
+/**
+  * @brief  Add a task to the table, not yet released
+  * @param  name: Name shown in telemetry
+  * @param  func: Task body
+  * @param  ctx: Passed to the task body
+  * @param  priority: 0 runs first
+  * @param  period_us: Release period, 0 for a one-shot task
+  * @param  deadline_us: Finish within this of each release
+  * @retval Task handle, or VR_SCHED_NO_TASK
+  */
+static VR_TaskId_t Sched_Add(const char *name, VR_TaskFunc_t func, void *ctx, uint8_t priority,
+                             uint32_t period_us, uint32_t deadline_us)
+{
+    if (task_count >= VR_SCHED_MAX_TASKS || name == NULL || func == NULL ||
+        period_us > VR_SCHED_MAX_PERIOD_US || deadline_us > VR_SCHED_MAX_PERIOD_US) {
+        return VR_SCHED_NO_TASK;
+    }
+
+    Sched_Task_t *task = &tasks[task_count];
+    memset(task, 0, sizeof(*task));
+    task->name = name;
+    task->func = func;
+    task->ctx = ctx;
+    task->priority = priority;
+    task->period = period_us * VR_SCHED_TICKS_PER_US;
+    task->deadline = deadline_us * VR_SCHED_TICKS_PER_US;
+    Sched_ClearStats(&task->stats);
+
+    return (VR_TaskId_t)task_count++;
+}
+
+/**
+  * @brief  Start a new statistics window
+  * @param  stats: Statistics to clear
+  * @retval None
+  */
+static void Sched_ClearStats(VR_TaskStats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->run_min = UINT32_MAX;
+}
+
+/**
+  * @brief  Order two released tasks: priority, then absolute deadline
+  * @param  a: Candidate
+  * @param  b: Current choice
+  * @retval True if a runs before b
+  */
+static bool Sched_Before(const Sched_Task_t *a, const Sched_Task_t *b)
+{
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return (int32_t)((a->release + a->deadline) - (b->release + b->deadline)) < 0;
+}
+
+/* USER CODE END 0 */
@@ -13,6 +13,10 @@
   * - 18-tooth trigger wheel with missing tooth pattern
   * - Distorted sine wave output (not square wave)
   * - RPM control via potentiometer (0-13400 RPM)
+  * - Reverse rotation: the phase steps back and the level is mirrored
+  *   about the DC offset, as the flux change reverses its sign
+  * - Tooth hook: a speed model such as cranking can set the speed and
+  *   the signal amplitude at the start of each tooth
   * - Precise timing using hardware timers
   * 
   ******************************************************************************
@@ -21,6 +25,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "vr_sensor_emulator.h"
+#include "vr_tcm.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
@@ -44,17 +49,30 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
-static VR_SensorState_t vr_state = {0};
 extern ADC_HandleTypeDef hadc1;
 extern DAC_HandleTypeDef hdac;
 extern TIM_HandleTypeDef htim6;
+
+// Default instance behind the single-sensor VR_Emulator_* API
+static VR_Emulator_t vr_default VR_DTCM_BSS;
+static const VR_EmulatorBinding_t vr_default_binding = {&hdac, DAC_CHANNEL_1, &htim6, &hadc1};
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN PFP */
-static void VR_Emulator_UpdateTimerPeriod(void);
+static void VR_Emu_UpdateTimerPeriod(VR_Emulator_t *emu);
+static void VR_Emu_WriteOutput(VR_Emulator_t *emu);
+static void VR_Emu_WrapTooth(VR_SensorState_t *state);
+static void VR_Emu_StepBack(VR_SensorState_t *state);
+static uint16_t VR_Emu_Level(int32_t offset, bool reverse);
+static uint16_t VR_Emu_Scale(uint16_t level, uint16_t amplitude);
+static void VR_Emu_EnterTooth(VR_Emulator_t *emu, uint8_t tooth);
+static void VR_Emu_Impair(VR_Emulator_t *emu);
+static void VR_Emu_NextNoise(VR_Emulator_t *emu);
+static bool VR_Emu_NoiseOn(const VR_Emulator_t *emu);
 static float VR_Emulator_CalculateToothAngle(uint8_t tooth_index, float position_in_tooth);
-static float VR_Emulator_ApplyDistortion(float base_sine, float angle);
+static uint16_t VR_Emulator_RenderLevel(float angle, uint8_t tooth_active, uint8_t quality, bool reverse);
+static float VR_Emulator_Distort(float base_sine, float angle, uint8_t quality);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -66,152 +84,655 @@ static float VR_Emulator_ApplyDistortion(float base_sine, float angle);
   */
 void VR_Emulator_Init(void)
 {
+    VR_Emu_Init(&vr_default, &vr_default_binding);
+}
+
+/**
+  * @brief  Update VR sensor emulator (call from main loop)
+  * @retval None
+  */
+void VR_Emulator_Update(void)
+{
+    VR_Emu_Update(&vr_default);
+}
+
+/**
+  * @brief  Apply a potentiometer reading taken elsewhere (e.g. by DMA)
+  * @param  adc_value: ADC value (0 to ADC_RESOLUTION-1)
+  * @retval None
+  */
+void VR_Emulator_SetPotentiometer(uint16_t adc_value)
+{
+    VR_Emu_SetPotentiometer(&vr_default, adc_value);
+}
+
+/**
+  * @brief  Set target RPM
+  * @param  rpm: Target RPM (0 to MAX_RPM)
+  * @retval None
+  */
+void VR_Emulator_SetRPM(uint16_t rpm)
+{
+    VR_Emu_SetRPM(&vr_default, rpm);
+}
+
+/**
+  * @brief  Get current target RPM
+  * @retval Current RPM setting
+  */
+uint16_t VR_Emulator_GetRPM(void)
+{
+    return VR_Emu_GetRPM(&vr_default);
+}
+
+/**
+  * @brief  Set the signed wheel speed
+  * @param  rpm: Speed (-MAX_RPM to MAX_RPM), negative to turn backwards
+  * @retval None
+  */
+void VR_Emulator_SetSpeed(int32_t rpm)
+{
+    VR_Emu_SetSpeed(&vr_default, rpm);
+}
+
+/**
+  * @brief  Get the signed wheel speed
+  * @retval Speed in RPM, negative while turning backwards
+  */
+int32_t VR_Emulator_GetSpeed(void)
+{
+    return VR_Emu_GetSpeed(&vr_default);
+}
+
+/**
+  * @brief  Set the direction of rotation, keeping the speed
+  * @param  reverse: True to turn backwards
+  * @retval None
+  */
+void VR_Emulator_SetReverse(bool reverse)
+{
+    VR_Emu_SetReverse(&vr_default, reverse);
+}
+
+/**
+  * @brief  Get the crank angle of the emulated wheel
+  * @retval Angle in degrees (0 to 360) at the current tooth position
+  */
+float VR_Emulator_GetCrankAngle(void)
+{
+    return VR_Emu_GetCrankAngle(&vr_default);
+}
+
+/**
+  * @brief  Read potentiometer value via ADC
+  * @retval ADC value (0 to ADC_RESOLUTION-1)
+  */
+uint16_t VR_Emulator_ReadPotentiometer(void)
+{
+    return VR_Emu_ReadPotentiometer(&vr_default);
+}
+
+/**
+  * @brief  Timer callback for precise tooth timing
+  * @retval None
+  */
+VR_ITCM_CODE void VR_Emulator_TimerCallback(void)
+{
+    VR_Emu_TimerCallback(&vr_default);
+}
+
+/**
+  * @brief  Generate VR sensor signal
+  * @retval None
+  */
+void VR_Emulator_GenerateSignal(void)
+{
+    VR_Emu_GenerateSignal(&vr_default);
+}
+
+/**
+  * @brief  Select the tooth waveform
+  * @param  shape: Tooth shape, or NULL for the built-in harmonic model
+  * @retval False if the shape is not valid; the built-in model is then used
+  */
+bool VR_Emulator_SetShape(const VR_ToothShape_t *shape)
+{
+    return VR_Emu_SetShape(&vr_default, shape);
+}
+
+/**
+  * @brief  Get the instance behind the VR_Emulator_* functions
+  * @retval Default emulator instance
+  */
+VR_ITCM_CODE VR_Emulator_t *VR_Emulator_GetDefault(void)
+{
+    return &vr_default;
+}
+
+/**
+  * @brief  Initialize an emulator instance
+  * @param  emu: Instance to initialize
+  * @param  binding: Peripherals the instance drives, NULL for none
+  * @retval None
+  */
+void VR_Emu_Init(VR_Emulator_t *emu, const VR_EmulatorBinding_t *binding)
+{
+    if (binding != NULL) {
+        emu->binding = *binding;
+    } else {
+        emu->binding = (VR_EmulatorBinding_t){NULL, DAC_CHANNEL_1, NULL, NULL};
+    }
+    emu->shape = NULL;
+    emu->quality = VR_QUALITY_FULL;
+    emu->updates = 0;
+    emu->tooth_hook = NULL;
+    emu->tooth_ctx = NULL;
+    emu->amplitude = VR_AMPLITUDE_FULL;
+    emu->sample_ticks_max = 0;
+    emu->fault = VR_FAULT_NONE;
+    emu->noise_lsb = 0;
+    emu->noise_rng = VR_NOISE_DEFAULT_SEED;
+    emu->noise_seed = VR_NOISE_DEFAULT_SEED;
+    
     // Initialize state structure
-    vr_state.rpm_adc_value = 0;
-    vr_state.target_rpm = 0;
-    vr_state.tooth_period_us = 0;
-    vr_state.current_tooth = 0;
-    vr_state.tooth_timer = 0;
-    vr_state.sine_phase = 0.0f;
-    vr_state.dac_output = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+    emu->state.rpm_adc_value = 0;
+    emu->state.target_rpm = 0;
+    emu->state.tooth_period_us = 0;
+    emu->state.current_tooth = 0;
+    emu->state.tooth_timer = 0;
+    emu->state.sine_phase = 0.0f;
+    emu->state.dac_output = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+    emu->state.reverse = false;
+    
+    if (emu->binding.htim != NULL) {
+        emu->state.sample_period_us = (__HAL_TIM_GET_AUTORELOAD(emu->binding.htim) + 1) * VR_SAMPLE_TICK_US;
+    } else {
+        emu->state.sample_period_us = VR_DEFAULT_SAMPLE_TICKS * VR_SAMPLE_TICK_US;
+    }
     
     // Set initial DAC output to DC offset
-    HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, DAC_ALIGN_12B_R, vr_state.dac_output);
+    VR_Emu_WriteOutput(emu);
 }
 
 /**
-  * @brief  Update VR sensor emulator (call from main loop)
+  * @brief  Read the potentiometer and apply it as the target RPM
+  * @param  emu: Emulator instance
   * @retval None
   */
-void VR_Emulator_Update(void)
+void VR_Emu_Update(VR_Emulator_t *emu)
 {
-    // Read potentiometer and update target RPM
-    uint16_t pot_value = VR_Emulator_ReadPotentiometer();
-    uint16_t new_rpm = (uint32_t)pot_value * MAX_RPM / ADC_RESOLUTION;
+    VR_Emu_SetPotentiometer(emu, VR_Emu_ReadPotentiometer(emu));
+}
+
+/**
+  * @brief  Apply a potentiometer reading as the target RPM
+  * @param  emu: Emulator instance
+  * @param  adc_value: ADC value (0 to ADC_RESOLUTION-1)
+  * @retval None
+  */
+void VR_Emu_SetPotentiometer(VR_Emulator_t *emu, uint16_t adc_value)
+{
+    if (adc_value > ADC_RESOLUTION - 1) {
+        adc_value = ADC_RESOLUTION - 1;
+    }
+    emu->state.rpm_adc_value = adc_value;
     
-    if (new_rpm != vr_state.target_rpm) {
-        VR_Emulator_SetRPM(new_rpm);
+    uint16_t new_rpm = (uint32_t)adc_value * MAX_RPM / (ADC_RESOLUTION - 1);
+    
+    if (new_rpm != emu->state.target_rpm) {
+        VR_Emu_SetRPM(emu, new_rpm);
     }
 }
 
 /**
   * @brief  Set target RPM
+  * @note   Sets the speed only; the direction of rotation is kept
+  * @param  emu: Emulator instance
   * @param  rpm: Target RPM (0 to MAX_RPM)
   * @retval None
   */
-void VR_Emulator_SetRPM(uint16_t rpm)
+void VR_Emu_SetRPM(VR_Emulator_t *emu, uint16_t rpm)
 {
     if (rpm > MAX_RPM) {
         rpm = MAX_RPM;
     }
     
-    vr_state.target_rpm = rpm;
+    if (rpm != emu->state.target_rpm) {
+        emu->updates++;
+    }
+    emu->state.target_rpm = rpm;
     
     if (rpm > 0) {
         // Calculate tooth frequency and period
         float tooth_freq = RPM_TO_TOOTH_FREQ(rpm);
-        vr_state.tooth_period_us = (uint32_t)TOOTH_FREQ_TO_PERIOD_US(tooth_freq);
+        emu->state.tooth_period_us = (uint32_t)(TOOTH_FREQ_TO_PERIOD_US(tooth_freq) + 0.5f);
         
         // Update timer period for precise timing
-        VR_Emulator_UpdateTimerPeriod();
+        VR_Emu_UpdateTimerPeriod(emu);
     } else {
-        vr_state.tooth_period_us = 0;
+        emu->state.tooth_period_us = 0;
         // Set DAC to DC offset when stopped
-        vr_state.dac_output = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
-        HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, DAC_ALIGN_12B_R, vr_state.dac_output);
+        emu->state.dac_output = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+        VR_Emu_WriteOutput(emu);
+    }
+}
+
+/**
+  * @brief  Set the signed wheel speed
+  * @note   The phase is kept, so the wheel retraces the positions it came
+  *         through when the sign changes. At 0 the output holds the DC
+  *         level and the direction is left as it was.
+  * @param  emu: Emulator instance
+  * @param  rpm: Speed (-MAX_RPM to MAX_RPM), negative to turn backwards
+  * @retval None
+  */
+void VR_Emu_SetSpeed(VR_Emulator_t *emu, int32_t rpm)
+{
+    uint32_t magnitude = (rpm < 0) ? 0u - (uint32_t)rpm : (uint32_t)rpm;
+    
+    if (rpm != 0) {
+        VR_Emu_SetReverse(emu, rpm < 0);
+    }
+    VR_Emu_SetRPM(emu, (magnitude > MAX_RPM) ? MAX_RPM : (uint16_t)magnitude);
+}
+
+/**
+  * @brief  Set the direction of rotation
+  * @note   The speed and the phase are kept, so the wheel turns back
+  *         from where it is. Works at standstill too.
+  * @param  emu: Emulator instance
+  * @param  reverse: True to turn backwards
+  * @retval None
+  */
+void VR_Emu_SetReverse(VR_Emulator_t *emu, bool reverse)
+{
+    if (reverse != emu->state.reverse) {
+        emu->state.reverse = reverse;
+        emu->updates++;
     }
 }
 
+/**
+  * @brief  Set the gain of the tooth signal about the DC offset
+  * @note   A VR sensor's output grows with speed; a speed model sets this
+  *         to follow it. Read at every update, so it may change between
+  *         any two samples.
+  * @param  emu: Emulator instance
+  * @param  amplitude: Gain, VR_AMPLITUDE_FULL for the level as rendered
+  * @retval None
+  */
+void VR_Emu_SetAmplitude(VR_Emulator_t *emu, uint16_t amplitude)
+{
+    emu->amplitude = (amplitude > VR_AMPLITUDE_FULL) ? VR_AMPLITUDE_FULL : amplitude;
+}
+
+/**
+  * @brief  Limit the sample period at low speed
+  * @note   The period otherwise grows as the speed falls, which leaves
+  *         slow teeth with coarse edges
+  * @param  emu: Emulator instance
+  * @param  ticks: Longest period in TIM6 ticks, 0 for no limit
+  * @retval None
+  */
+void VR_Emu_SetSampleLimit(VR_Emulator_t *emu, uint16_t ticks)
+{
+    emu->sample_ticks_max = ticks;
+    VR_Emu_UpdateTimerPeriod(emu);
+}
+
+/**
+  * @brief  Set the function called as each new tooth starts
+  * @note   The hook runs in the sample interrupt, once per tooth, and may
+  *         set the speed and amplitude for the tooth; the context is set
+  *         before the hook so the interrupt never sees one without the
+  *         other. With a hook, VR_Emu_Skip() steps one update at a time.
+  * @param  emu: Emulator instance
+  * @param  hook: Function to call, NULL for none
+  * @param  ctx: Passed to the hook
+  * @retval None
+  */
+void VR_Emu_SetToothHook(VR_Emulator_t *emu, VR_ToothHook_t hook, void *ctx)
+{
+    __atomic_store_n(&emu->tooth_hook, NULL, __ATOMIC_RELEASE);
+    emu->tooth_ctx = ctx;
+    __atomic_store_n(&emu->tooth_hook, hook, __ATOMIC_RELEASE);
+}
+
+/**
+  * @brief  Inject a fault into the output
+  * @note   The wheel keeps turning underneath, so the signal comes back in
+  *         phase when the fault is cleared
+  * @param  emu: Emulator instance
+  * @param  fault: VR_Fault_t, VR_FAULT_NONE to clear
+  * @retval None
+  */
+void VR_Emu_SetFault(VR_Emulator_t *emu, VR_Fault_t fault)
+{
+    emu->fault = (fault < VR_FAULT_COUNT) ? (uint8_t)fault : VR_FAULT_NONE;
+}
+
+/**
+  * @brief  Add uniform noise to the output
+  * @note   One xorshift32 step per update, so a seed gives the same noise
+  *         on every run
+  * @param  emu: Emulator instance
+  * @param  peak_lsb: Peak noise in DAC codes (up to VR_NOISE_MAX_LSB), 0 for none
+  * @param  seed: Start of the sequence, 0 to continue the current one
+  * @retval None
+  */
+void VR_Emu_SetNoise(VR_Emulator_t *emu, uint16_t peak_lsb, uint32_t seed)
+{
+    if (seed != 0) {
+        emu->noise_rng = seed;
+        emu->noise_seed = seed;
+    }
+    emu->noise_lsb = (peak_lsb > VR_NOISE_MAX_LSB) ? VR_NOISE_MAX_LSB : peak_lsb;
+}
+
+/**
+  * @brief  Set the render quality
+  * @note   Lower levels switch the added noise off, drop harmonics, then
+  *         halve the samples per tooth. The tooth period and phase are
+  *         kept, so only the waveform detail and the edge resolution
+  *         change. The noise setting is kept, and applies again when the
+  *         quality is raised.
+  * @param  emu: Emulator instance
+  * @param  quality: VR_Quality_t level
+  * @retval None
+  */
+void VR_Emu_SetQuality(VR_Emulator_t *emu, VR_Quality_t quality)
+{
+    bool rate_changed;
+    
+    if (quality >= VR_QUALITY_LEVELS) {
+        quality = VR_QUALITY_HALF_RATE;
+    }
+    
+    rate_changed = (quality >= VR_QUALITY_HALF_RATE) != (emu->quality >= VR_QUALITY_HALF_RATE);
+    if (quality != emu->quality) {
+        emu->updates++;
+    }
+    emu->quality = (uint8_t)quality;
+    if (rate_changed) {
+        VR_Emu_UpdateTimerPeriod(emu);
+    }
+}
+
+/**
+  * @brief  Select the tooth waveform
+  * @note   The table is read at every update, so it must stay unchanged
+  *         while selected; switch to a second table to change it
+  * @param  emu: Emulator instance
+  * @param  shape: Tooth shape, or NULL for the built-in harmonic model
+  * @retval False if the shape is not valid; the built-in model is then used
+  */
+bool VR_Emu_SetShape(VR_Emulator_t *emu, const VR_ToothShape_t *shape)
+{
+    bool valid = (shape == NULL) || VR_Shape_IsValid(shape);
+    
+    if (!valid) {
+        shape = NULL;
+    }
+    if (shape != emu->shape) {
+        emu->updates++;
+    }
+    emu->shape = shape;
+    return valid;
+}
+
 /**
   * @brief  Get current target RPM
+  * @param  emu: Emulator instance
   * @retval Current RPM setting
   */
-uint16_t VR_Emulator_GetRPM(void)
+uint16_t VR_Emu_GetRPM(const VR_Emulator_t *emu)
+{
+    return emu->state.target_rpm;
+}
+
+/**
+  * @brief  Get the signed wheel speed
+  * @param  emu: Emulator instance
+  * @retval Speed in RPM, negative while turning backwards
+  */
+int32_t VR_Emu_GetSpeed(const VR_Emulator_t *emu)
+{
+    int32_t rpm = emu->state.target_rpm;
+    
+    return emu->state.reverse ? -rpm : rpm;
+}
+
+/**
+  * @brief  Get the crank angle of the emulated wheel
+  * @param  emu: Emulator instance
+  * @retval Angle in degrees (0 to 360) at the current tooth position
+  */
+float VR_Emu_GetCrankAngle(const VR_Emulator_t *emu)
+{
+    float position = 0.0f;
+    
+    if (emu->state.tooth_period_us > 0) {
+        position = (float)emu->state.tooth_timer / emu->state.tooth_period_us;
+    }
+    
+    return ((float)emu->state.current_tooth + position) * (360.0f / TRIGGER_WHEEL_TEETH);
+}
+
+/**
+  * @brief  Get the last computed output level
+  * @param  emu: Emulator instance
+  * @retval DAC code (0 to DAC_RESOLUTION-1)
+  */
+uint16_t VR_Emu_GetOutput(const VR_Emulator_t *emu)
+{
+    return emu->state.dac_output;
+}
+
+/**
+  * @brief  Get the time between signal updates
+  * @param  emu: Emulator instance
+  * @retval Sample period in microseconds
+  */
+uint32_t VR_Emu_GetSamplePeriod(const VR_Emulator_t *emu)
 {
-    return vr_state.target_rpm;
+    return emu->state.sample_period_us;
 }
 
 /**
   * @brief  Read potentiometer value via ADC
-  * @retval ADC value (0 to ADC_RESOLUTION-1)
+  * @param  emu: Emulator instance
+  * @retval ADC value (0 to ADC_RESOLUTION-1), last value if no ADC is bound
   */
-uint16_t VR_Emulator_ReadPotentiometer(void)
+uint16_t VR_Emu_ReadPotentiometer(VR_Emulator_t *emu)
 {
-    HAL_ADC_Start(&hadc1);
+    ADC_HandleTypeDef *hadc = emu->binding.hadc;
     
-    if (HAL_ADC_PollForConversion(&hadc1, 100) == HAL_OK) {
-        vr_state.rpm_adc_value = HAL_ADC_GetValue(&hadc1);
+    if (hadc == NULL) {
+        return emu->state.rpm_adc_value;
     }
     
-    HAL_ADC_Stop(&hadc1);
+    HAL_ADC_Start(hadc);
     
-    return vr_state.rpm_adc_value;
+    if (HAL_ADC_PollForConversion(hadc, 100) == HAL_OK) {
+        emu->state.rpm_adc_value = HAL_ADC_GetValue(hadc);
+    }
+    
+    HAL_ADC_Stop(hadc);
+    
+    return emu->state.rpm_adc_value;
 }
 
 /**
   * @brief  Timer callback for precise tooth timing
+  * @param  emu: Emulator instance
   * @retval None
   */
-void VR_Emulator_TimerCallback(void)
+VR_ITCM_CODE void VR_Emu_TimerCallback(VR_Emulator_t *emu)
 {
-    if (vr_state.target_rpm == 0) {
+    if (emu->state.target_rpm == 0) {
         return; // No signal generation when stopped
     }
     
     // Generate VR sensor signal
-    VR_Emulator_GenerateSignal();
+    VR_Emu_GenerateSignal(emu);
 }
 
 /**
   * @brief  Generate VR sensor signal
+  * @param  emu: Emulator instance
   * @retval None
   */
-void VR_Emulator_GenerateSignal(void)
+VR_ITCM_CODE void VR_Emu_GenerateSignal(VR_Emulator_t *emu)
 {
-    static uint32_t phase_accumulator = 0;
-    static uint8_t tooth_state = 0; // 0 = gap, 1 = tooth
-    static uint32_t tooth_timer = 0;
+    VR_SensorState_t *state = &emu->state;
     
-    if (vr_state.tooth_period_us == 0) {
+    if (state->tooth_period_us == 0) {
         return;
     }
     
-    // Calculate time step based on timer frequency (1ms for TIM6)
-    uint32_t time_step_us = 1000; // 1ms timer
+    // Time step is the update period set by VR_Emu_UpdateTimerPeriod()
+    uint32_t time_step_us = state->sample_period_us;
+    uint8_t tooth = state->current_tooth;
+    
+    // Update tooth timing; backwards, the timer stays within the tooth
+    if (state->reverse) {
+        VR_Emu_StepBack(state);
+    } else {
+        state->tooth_timer += time_step_us;
+    }
     
-    // Update tooth timing
-    tooth_timer += time_step_us;
+    if (emu->shape != NULL) {
+        // Uploaded waveform, resampled at this tooth phase
+        int32_t offset = VR_Shape_Offset(emu->shape, state->current_tooth,
+                                         state->tooth_timer, state->tooth_period_us);
+        state->dac_output = VR_Emu_Level(offset, state->reverse);
+        if (emu->amplitude != VR_AMPLITUDE_FULL) {
+            state->dac_output = VR_Emu_Scale(state->dac_output, emu->amplitude);
+        }
+        if (emu->fault != VR_FAULT_NONE || VR_Emu_NoiseOn(emu)) {
+            VR_Emu_Impair(emu);
+        }
+        VR_Emu_WriteOutput(emu);
+        VR_Emu_WrapTooth(state);
+        VR_Emu_EnterTooth(emu, tooth);
+        return;
+    }
     
     // Calculate current tooth angle
-    float tooth_angle = VR_Emulator_CalculateToothAngle(vr_state.current_tooth, 
-                                                        (float)tooth_timer / vr_state.tooth_period_us);
+    float tooth_angle = VR_Emulator_CalculateToothAngle(state->current_tooth, 
+                                                        (float)state->tooth_timer / state->tooth_period_us);
     
     // Determine if we're in a tooth or gap
     uint8_t is_tooth_active = 0;
     
-    if (vr_state.current_tooth == MISSING_TOOTH_INDEX) {
+    if (state->current_tooth == MISSING_TOOTH_INDEX) {
         // Missing tooth pattern: 12° tooth, 8° gap
-        float tooth_fraction = (float)tooth_timer / vr_state.tooth_period_us;
+        float tooth_fraction = (float)state->tooth_timer / state->tooth_period_us;
         float tooth_width_fraction = MISSING_TOOTH_ANGLE / (MISSING_TOOTH_ANGLE + MISSING_TOOTH_GAP);
         is_tooth_active = (tooth_fraction < tooth_width_fraction) ? 1 : 0;
     } else {
         // Regular tooth pattern: 4° tooth, 16° gap
-        float tooth_fraction = (float)tooth_timer / vr_state.tooth_period_us;
+        float tooth_fraction = (float)state->tooth_timer / state->tooth_period_us;
         float tooth_width_fraction = REGULAR_TOOTH_ANGLE / (REGULAR_TOOTH_ANGLE + REGULAR_TOOTH_GAP);
         is_tooth_active = (tooth_fraction < tooth_width_fraction) ? 1 : 0;
     }
     
     // Calculate DAC output value
-    vr_state.dac_output = VR_Emulator_CalculateDAC_Value(tooth_angle, is_tooth_active);
+    state->dac_output = VR_Emulator_RenderLevel(tooth_angle, is_tooth_active, emu->quality, state->reverse);
+    if (emu->amplitude != VR_AMPLITUDE_FULL) {
+        state->dac_output = VR_Emu_Scale(state->dac_output, emu->amplitude);
+    }
+    if (emu->fault != VR_FAULT_NONE || VR_Emu_NoiseOn(emu)) {
+        VR_Emu_Impair(emu);
+    }
     
     // Output to DAC
-    HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, DAC_ALIGN_12B_R, vr_state.dac_output);
+    VR_Emu_WriteOutput(emu);
     
-    // Check if tooth period is complete
-    if (tooth_timer >= vr_state.tooth_period_us) {
-        tooth_timer = 0;
-        vr_state.current_tooth = (vr_state.current_tooth + 1) % TRIGGER_WHEEL_TEETH;
+    VR_Emu_WrapTooth(state);
+    VR_Emu_EnterTooth(emu, tooth);
+}
+
+/**
+  * @brief  Advance the wheel by a number of signal updates without rendering
+  * @note   Leaves the instance exactly as count calls to VR_Emu_GenerateSignal()
+  *         would, except that the output level is not recomputed; with
+  *         noise on, its sequence is stepped once per update
+  * @param  emu: Emulator instance
+  * @param  count: Number of updates to skip
+  * @retval None
+  */
+void VR_Emu_Skip(VR_Emulator_t *emu, uint64_t count)
+{
+    VR_SensorState_t *state = &emu->state;
+    uint32_t period = state->tooth_period_us;
+    
+    if (state->target_rpm == 0 || period == 0 || count == 0) {
+        return;
+    }
+    
+    if (emu->tooth_hook != NULL) {
+        // The hook may change the speed at any tooth
+        while (count > 0 && state->tooth_period_us != 0) {
+            uint8_t tooth = state->current_tooth;
+            
+            if (state->reverse) {
+                VR_Emu_StepBack(state);
+            } else {
+                state->tooth_timer += state->sample_period_us;
+            }
+            VR_Emu_WrapTooth(state);
+            VR_Emu_EnterTooth(emu, tooth);
+            if (VR_Emu_NoiseOn(emu)) {
+                VR_Emu_NextNoise(emu);
+            }
+            count--;
+        }
+        return;
+    }
+    
+    if (VR_Emu_NoiseOn(emu)) {
+        for (uint64_t i = 0; i < count; i++) {
+            VR_Emu_NextNoise(emu);
+        }
+    }
+    
+    if (state->reverse) {
+        // As VR_Emu_StepBack() while the timer is within the tooth and an
+        // update is no longer than a tooth; otherwise one update at a time
+        while (count > 0 && (state->tooth_timer > period || state->sample_period_us > period)) {
+            VR_Emu_StepBack(state);
+            count--;
+        }
+        uint64_t back = count * state->sample_period_us;
+        if (back <= state->tooth_timer) {
+            state->tooth_timer -= (uint32_t)back;
+            return;
+        }
+        uint64_t borrows = (back - state->tooth_timer + period - 1u) / period;
+        state->tooth_timer = (uint32_t)(state->tooth_timer + borrows * period - back);
+        state->current_tooth = (uint8_t)((state->current_tooth + TRIGGER_WHEEL_TEETH -
+                                          borrows % TRIGGER_WHEEL_TEETH) % TRIGGER_WHEEL_TEETH);
+        return;
     }
+    
+    // The first update may still see an overshoot left by an RPM step, so it
+    // takes the same path as VR_Emu_GenerateSignal(), as do all updates if
+    // one is ever longer than a tooth
+    do {
+        state->tooth_timer += state->sample_period_us;
+        VR_Emu_WrapTooth(state);
+        count--;
+    } while (count > 0 && state->sample_period_us > period);
+    
+    // From here the timer is below one tooth period and an update is no
+    // longer than a tooth, so each update wraps at most once and the carry
+    // is plain division
+    uint64_t total = state->tooth_timer + count * state->sample_period_us;
+    uint64_t wraps = total / period;
+    
+    state->tooth_timer = (uint32_t)(total - wraps * period);
+    state->current_tooth = (uint8_t)((state->current_tooth + wraps) % TRIGGER_WHEEL_TEETH);
 }
 
 /**
@@ -220,27 +741,9 @@ void VR_Emulator_GenerateSignal(void)
   * @param  tooth_active: 1 if tooth is active, 0 if in gap
   * @retval DAC value (0 to DAC_RESOLUTION-1)
   */
-uint16_t VR_Emulator_CalculateDAC_Value(float angle, uint8_t tooth_active)
+VR_ITCM_CODE uint16_t VR_Emulator_CalculateDAC_Value(float angle, uint8_t tooth_active)
 {
-    float output_voltage = VR_DC_OFFSET; // Start with DC offset
-    
-    if (tooth_active) {
-        // Generate distorted sine wave for tooth
-        float base_sine = sinf(angle);
-        
-        // Apply distortion to make it more realistic
-        float distorted_sine = VR_Emulator_ApplyDistortion(base_sine, angle);
-        
-        // Scale and add to DC offset
-        output_voltage += distorted_sine * VR_AMPLITUDE_SCALE;
-    }
-    
-    // Clamp to valid range
-    if (output_voltage < 0.0f) output_voltage = 0.0f;
-    if (output_voltage > 1.0f) output_voltage = 1.0f;
-    
-    // Convert to DAC value
-    return (uint16_t)(output_voltage * DAC_RESOLUTION);
+    return VR_Emulator_RenderLevel(angle, tooth_active, VR_QUALITY_FULL, false);
 }
 
 /**
@@ -249,7 +752,7 @@ uint16_t VR_Emulator_CalculateDAC_Value(float angle, uint8_t tooth_active)
   * @param  position_in_tooth: Position within tooth period (0.0-1.0)
   * @retval Angle in radians
   */
-static float VR_Emulator_CalculateToothAngle(uint8_t tooth_index, float position_in_tooth)
+VR_ITCM_CODE static float VR_Emulator_CalculateToothAngle(uint8_t tooth_index, float position_in_tooth)
 {
     // Calculate base angle for this tooth
     float tooth_base_angle = (float)tooth_index * (360.0f / TRIGGER_WHEEL_TEETH);
@@ -270,44 +773,257 @@ static float VR_Emulator_CalculateToothAngle(uint8_t tooth_index, float position
   * @param  angle: Current angle in radians
   * @retval Distorted sine wave value
   */
-static float VR_Emulator_ApplyDistortion(float base_sine, float angle)
+VR_ITCM_CODE float VR_Emulator_ApplyDistortion(float base_sine, float angle)
+{
+    return VR_Emulator_Distort(base_sine, angle, VR_QUALITY_FULL);
+}
+
+/**
+  * @brief  Calculate the output level at a render quality
+  * @param  angle: Current angle in radians
+  * @param  tooth_active: 1 if tooth is active, 0 if in gap
+  * @param  quality: VR_Quality_t level
+  * @param  reverse: True if the wheel turns backwards
+  * @retval DAC value (0 to DAC_RESOLUTION-1)
+  */
+VR_ITCM_CODE static uint16_t VR_Emulator_RenderLevel(float angle, uint8_t tooth_active, uint8_t quality, bool reverse)
+{
+    float output_voltage = VR_DC_OFFSET; // Start with DC offset
+    
+    if (tooth_active) {
+        // Generate distorted sine wave for tooth
+        float base_sine = sinf(angle);
+        
+        // Apply distortion to make it more realistic
+        float distorted_sine = VR_Emulator_Distort(base_sine, angle, quality);
+        
+        // Scale and add to DC offset
+        output_voltage += distorted_sine * VR_AMPLITUDE_SCALE;
+    }
+    
+    // Convert to a DAC code, clamped to the valid range with the direction
+    int32_t dac_value = (int32_t)(output_voltage * DAC_RESOLUTION);
+    return VR_Emu_Level(dac_value - (int32_t)VR_DC_LEVEL, reverse);
+}
+
+/**
+  * @brief  Apply the harmonics a render quality keeps
+  * @param  base_sine: Base sine wave value (-1.0 to 1.0)
+  * @param  angle: Current angle in radians
+  * @param  quality: VR_Quality_t level
+  * @retval Distorted sine wave value
+  */
+VR_ITCM_CODE static float VR_Emulator_Distort(float base_sine, float angle, uint8_t quality)
 {
-    // Add harmonic distortion to make signal more realistic
-    float harmonic2 = sinf(2.0f * angle) * VR_DISTORTION_FACTOR;
-    float harmonic3 = sinf(3.0f * angle) * (VR_DISTORTION_FACTOR * 0.5f);
+    // Add harmonic distortion to make signal more realistic; each one
+    // dropped saves a sinf() in the sample interrupt
+    float harmonic2 = 0.0f;
+    float harmonic3 = 0.0f;
+    
+    if (quality < VR_QUALITY_SINE) {
+        harmonic2 = sinf(2.0f * angle) * VR_DISTORTION_FACTOR;
+    }
+    if (quality < VR_QUALITY_NO_H3) {
+        harmonic3 = sinf(3.0f * angle) * (VR_DISTORTION_FACTOR * 0.5f);
+    }
     
     // Add some asymmetry
     float asymmetry = (base_sine > 0) ? 0.1f * VR_DISTORTION_FACTOR : -0.05f * VR_DISTORTION_FACTOR;
     
     return base_sine + harmonic2 + harmonic3 + asymmetry;
 }
-
 /**
   * @brief  Update timer period based on current RPM
+  * @param  emu: Emulator instance
   * @retval None
   */
-static void VR_Emulator_UpdateTimerPeriod(void)
+static void VR_Emu_UpdateTimerPeriod(VR_Emulator_t *emu)
 {
-    if (vr_state.target_rpm == 0) {
+    if (emu->state.target_rpm == 0) {
         return;
     }
     
     // Calculate required timer frequency for good resolution
     // We want at least 10 samples per tooth for good waveform quality
-    float tooth_freq = RPM_TO_TOOTH_FREQ(vr_state.target_rpm);
+    float tooth_freq = RPM_TO_TOOTH_FREQ(emu->state.target_rpm);
     uint32_t required_timer_freq = (uint32_t)(tooth_freq * 10.0f * TRIGGER_WHEEL_TEETH);
     
     // Timer 6 runs at 108MHz with current prescaler (1079)
     // This gives us ~100kHz base frequency
     // Adjust ARR to get desired frequency
-    uint32_t timer_base_freq = 100000; // 100kHz
+    uint32_t timer_base_freq = VR_SAMPLE_TIMER_BASE_FREQ; // 100kHz
     uint32_t arr_value = timer_base_freq / required_timer_freq;
     
     if (arr_value < 1) arr_value = 1;
+    if (emu->sample_ticks_max != 0 && arr_value > emu->sample_ticks_max) arr_value = emu->sample_ticks_max;
+    if (emu->quality >= VR_QUALITY_HALF_RATE) arr_value *= 2;
     if (arr_value > 65535) arr_value = 65535;
     
     // Update timer period
-    __HAL_TIM_SET_AUTORELOAD(&htim6, arr_value - 1);
+    if (emu->binding.htim != NULL) {
+        __HAL_TIM_SET_AUTORELOAD(emu->binding.htim, arr_value - 1);
+    }
+    
+    // Keep the signal model's time step in step with the timer
+    emu->state.sample_period_us = arr_value * VR_SAMPLE_TICK_US;
+}
+
+/**
+  * @brief  Move to the next tooth once the tooth period is complete
+  * @param  state: Signal state after the time step was added
+  * @retval None
+  */
+VR_ITCM_CODE static void VR_Emu_WrapTooth(VR_SensorState_t *state)
+{
+    // Carry the overshoot into the next tooth so sample quantisation does
+    // not stretch every tooth; drop it only if an RPM step left more than a
+    // whole period behind
+    if (state->tooth_timer >= state->tooth_period_us) {
+        state->tooth_timer -= state->tooth_period_us;
+        if (state->tooth_timer >= state->tooth_period_us) {
+            state->tooth_timer = 0;
+        }
+        state->current_tooth = (state->current_tooth + 1) % TRIGGER_WHEEL_TEETH;
+    }
+}
+
+/**
+  * @brief  Step back one update, into the previous tooth if needed
+  * @note   The borrow is carried as the forward overshoot is, so teeth
+  *         keep their length turning backwards
+  * @param  state: Signal state before the time step
+  * @retval None
+  */
+VR_ITCM_CODE static void VR_Emu_StepBack(VR_SensorState_t *state)
+{
+    uint32_t step = state->sample_period_us;
+    
+    // An RPM step may have left the timer past the end of a shorter tooth
+    if (state->tooth_timer > state->tooth_period_us) {
+        state->tooth_timer = state->tooth_period_us;
+    }
+    if (state->tooth_timer < step) {
+        state->tooth_timer += state->tooth_period_us;
+        if (state->tooth_timer < step) {
+            state->tooth_timer = step;
+        }
+        state->current_tooth = (state->current_tooth == 0) ? TRIGGER_WHEEL_TEETH - 1 : state->current_tooth - 1;
+    }
+    state->tooth_timer -= step;
+}
+
+/**
+  * @brief  Clamp a signed offset from the DC offset to a DAC code
+  * @note   A VR sensor outputs the rate of change of flux, so turning
+  *         backwards passes the same positions in reverse order with the
+  *         opposite sign. The offset is negated before the clamp, so both
+  *         directions swing over the same range. Full scale must not reach
+  *         DAC_RESOLUTION, which the 12-bit data register would wrap to 0.
+  * @param  offset: Offset rendered for forward rotation, DAC codes
+  * @param  reverse: True if the wheel turns backwards
+  * @retval DAC value (0 to DAC_RESOLUTION-1)
+  */
+VR_ITCM_CODE static uint16_t VR_Emu_Level(int32_t offset, bool reverse)
+{
+    int32_t level = (int32_t)VR_DC_LEVEL + (reverse ? -offset : offset);
+    
+    if (level < 0) {
+        return 0;
+    }
+    return (level > DAC_RESOLUTION - 1) ? (DAC_RESOLUTION - 1) : (uint16_t)level;
+}
+
+/**
+  * @brief  Scale a level's distance from the DC offset
+  * @param  level: Level at full amplitude
+  * @param  amplitude: Gain, VR_AMPLITUDE_FULL for 1
+  * @retval Scaled level
+  */
+VR_ITCM_CODE static uint16_t VR_Emu_Scale(uint16_t level, uint16_t amplitude)
+{
+    int32_t offset = (int32_t)level - (int32_t)VR_DC_LEVEL;
+    
+    return (uint16_t)((int32_t)VR_DC_LEVEL + offset * (int32_t)amplitude / VR_AMPLITUDE_FULL);
+}
+
+/**
+  * @brief  Apply the output fault and noise to the rendered level
+  * @param  emu: Emulator instance
+  * @retval None
+  */
+VR_ITCM_CODE static void VR_Emu_Impair(VR_Emulator_t *emu)
+{
+    int32_t level = emu->state.dac_output;
+    
+    if (emu->fault == VR_FAULT_DROPOUT) {
+        level = VR_DC_LEVEL;
+    } else if (emu->fault == VR_FAULT_SPIKE) {
+        level = DAC_RESOLUTION - 1;
+    }
+    
+    if (VR_Emu_NoiseOn(emu)) {
+        VR_Emu_NextNoise(emu);
+        level += (int32_t)(emu->noise_rng % (2u * emu->noise_lsb + 1u)) - emu->noise_lsb;
+    }
+    
+    if (level < 0) {
+        level = 0;
+    } else if (level > DAC_RESOLUTION - 1) {
+        level = DAC_RESOLUTION - 1;
+    }
+    emu->state.dac_output = (uint16_t)level;
+}
+
+/**
+  * @brief  Step the noise sequence
+  * @param  emu: Emulator instance
+  * @retval None
+  */
+VR_ITCM_CODE static void VR_Emu_NextNoise(VR_Emulator_t *emu)
+{
+    uint32_t x = emu->noise_rng;
+    
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emu->noise_rng = x;
+}
+
+/**
+  * @brief  Check whether noise is added at the render quality in use
+  * @param  emu: Emulator instance
+  * @retval True if a noise level is set and the quality keeps it
+  */
+VR_ITCM_CODE static bool VR_Emu_NoiseOn(const VR_Emulator_t *emu)
+{
+    return emu->noise_lsb != 0 && emu->quality < VR_QUALITY_NO_NOISE;
+}
+
+/**
+  * @brief  Run the tooth hook if the last update entered a new tooth
+  * @param  emu: Emulator instance
+  * @param  tooth: Tooth before the update
+  * @retval None
+  */
+VR_ITCM_CODE static void VR_Emu_EnterTooth(VR_Emulator_t *emu, uint8_t tooth)
+{
+    VR_ToothHook_t hook = emu->tooth_hook;
+    
+    if (hook != NULL && emu->state.current_tooth != tooth) {
+        hook(emu, emu->tooth_ctx);
+    }
+}
+
+/**
+  * @brief  Write the current level to the bound DAC channel, if any
+  * @param  emu: Emulator instance
+  * @retval None
+  */
+VR_ITCM_CODE static void VR_Emu_WriteOutput(VR_Emulator_t *emu)
+{
+    if (emu->binding.hdac != NULL) {
+        HAL_DAC_SetValue(emu->binding.hdac, emu->binding.dac_channel, DAC_ALIGN_12B_R, emu->state.dac_output);
+    }
 }
 
 /* USER CODE END 0 */
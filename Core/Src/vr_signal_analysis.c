@@ -0,0 +1,322 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_signal_analysis.c
+  * @brief          : VR waveform analysis
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * Works on a buffer of uniformly spaced 12-bit samples in two passes and
+  * needs no heap or large stack buffers, so the same code runs on the
+  * target after a loopback capture and on the host over recorded DAC writes.
+  *
+  * Pass 1: DC offset from a coarse histogram (teeth cover at most 60% of
+  *         a tooth pitch, so the no-tooth level is the most common bin),
+  *         plus the sample peaks.
+  * Pass 2: teeth are detected by deviation from the DC offset, in either
+  *         polarity, and end after release_samples quiet samples. Each
+  *         tooth's width as a fraction of its pitch separates regular teeth
+  *         (4 of 20 deg) from the wide missing-tooth position (12 of 20 deg).
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_signal_analysis.h"
+#include "vr_sensor_emulator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+
+/* USER CODE END Includes */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define HISTOGRAM_SHIFT             6       // 64 bins of 64 LSB
+#define HISTOGRAM_BINS              (DAC_RESOLUTION >> HISTOGRAM_SHIFT)
+#define TOOTH_PITCH_DEG             (360.0f / TRIGGER_WHEEL_TEETH)
+#define WIDE_TOOTH_FRACTION         ((REGULAR_TOOTH_ANGLE + MISSING_TOOTH_ANGLE) / 2.0f / TOOTH_PITCH_DEG)
+#define MODEL_SCAN_STEP_DEG         0.25f
+/* USER CODE END PD */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static uint16_t Analysis_DCOffset(const uint16_t *samples, uint32_t count);
+static uint16_t Analysis_Deviation(uint16_t sample, uint16_t dc);
+static bool Analysis_WithinDeg(float measured, float expected, float tolerance);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Measure a captured waveform
+  * @param  samples: Uniformly spaced 12-bit samples
+  * @param  count: Number of samples
+  * @param  config: Capture rate and detector settings
+  * @param  result: Measurements
+  * @retval None
+  */
+void VR_Analysis_Run(const uint16_t *samples, uint32_t count,
+                     const VR_AnalysisConfig_t *config, VR_AnalysisResult_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->pattern_ok = true;
+
+    if (count == 0 || config->sample_rate_hz == 0) {
+        return;
+    }
+
+    // Pass 1: DC offset and peaks
+    uint16_t dc = Analysis_DCOffset(samples, count);
+    result->dc_offset = dc;
+    result->peak_high = samples[0];
+    result->peak_low = samples[0];
+    for (uint32_t i = 1; i < count; i++) {
+        if (samples[i] > result->peak_high) result->peak_high = samples[i];
+        if (samples[i] < result->peak_low) result->peak_low = samples[i];
+    }
+
+    // Pass 2: tooth edges. A capture starting mid-tooth waits for the
+    // first gap so that only complete teeth are measured.
+    uint16_t release_level = config->threshold_lsb / 2;
+    bool in_tooth = Analysis_Deviation(samples[0], dc) > config->threshold_lsb;
+    bool have_rise = false, have_fall = false;
+    uint32_t rise = 0, fall = 0, quiet_start = 0, quiet = 0;
+    uint32_t period_min = UINT32_MAX, period_max = 0;
+    uint64_t period_sum = 0;
+    uint32_t regular_teeth = 0, tooth_number = 0, last_wide = 0;
+    float regular_width_sum = 0.0f, wide_width_sum = 0.0f, wide_gap_sum = 0.0f;
+
+    for (uint32_t i = 1; i < count; i++) {
+        uint16_t deviation = Analysis_Deviation(samples[i], dc);
+
+        if (in_tooth) {
+            if (deviation > release_level) {
+                quiet = 0;
+            } else if (quiet++ == 0) {
+                quiet_start = i;
+            }
+            if (quiet >= config->release_samples) {
+                in_tooth = false;
+                fall = quiet_start;
+                have_fall = have_rise;
+            }
+            continue;
+        }
+
+        if (deviation <= config->threshold_lsb) {
+            continue;
+        }
+
+        // Leading edge: the previous tooth is now complete
+        in_tooth = true;
+        quiet = 0;
+
+        if (have_rise && have_fall) {
+            uint32_t period = i - rise;
+            float width_deg = (float)(fall - rise) / period * TOOTH_PITCH_DEG;
+            float gap_deg = (float)(i - fall) / period * TOOTH_PITCH_DEG;
+
+            period_sum += period;
+            if (period < period_min) period_min = period;
+            if (period > period_max) period_max = period;
+            result->teeth++;
+            tooth_number++;
+
+            if (width_deg > WIDE_TOOTH_FRACTION * TOOTH_PITCH_DEG) {
+                if (result->wide_teeth > 0) {
+                    if (tooth_number - last_wide == TRIGGER_WHEEL_TEETH) {
+                        result->revolutions++;
+                    } else {
+                        result->pattern_ok = false;
+                    }
+                }
+                last_wide = tooth_number;
+                result->wide_teeth++;
+                wide_width_sum += width_deg;
+                wide_gap_sum += gap_deg;
+            } else {
+                regular_teeth++;
+                regular_width_sum += width_deg;
+            }
+        }
+
+        rise = i;
+        have_rise = true;
+        have_fall = false;
+    }
+
+    if (result->teeth == 0) {
+        return;
+    }
+
+    float mean_period = (float)period_sum / result->teeth;
+    float sample_us = 1000000.0f / config->sample_rate_hz;
+    float jitter_high = (float)period_max - mean_period;
+    float jitter_low = mean_period - (float)period_min;
+
+    result->measured_rpm = 60.0f * config->sample_rate_hz / (mean_period * TRIGGER_WHEEL_TEETH);
+    result->period_jitter_us = ((jitter_high > jitter_low) ? jitter_high : jitter_low) * sample_us;
+
+    if (regular_teeth > 0) {
+        result->regular_width_deg = regular_width_sum / regular_teeth;
+    }
+    if (result->wide_teeth > 0) {
+        result->wide_width_deg = wide_width_sum / result->wide_teeth;
+        result->wide_gap_deg = wide_gap_sum / result->wide_teeth;
+    }
+}
+
+/**
+  * @brief  Check measurements against the emulator model
+  * @param  result: Measurements from VR_Analysis_Run()
+  * @param  rpm: Commanded RPM
+  * @param  config: Configuration the measurements were taken with
+  * @param  limits: Tolerances
+  * @retval VR_ANALYSIS_FAIL_* flags, 0 if every check passed
+  */
+uint32_t VR_Analysis_Check(const VR_AnalysisResult_t *result, uint16_t rpm,
+                           const VR_AnalysisConfig_t *config, const VR_AnalysisLimits_t *limits)
+{
+    uint32_t failures = 0;
+    uint16_t model_high, model_low;
+    uint16_t model_dc = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+
+    VR_Analysis_ModelPeaks(&model_high, &model_low);
+
+    if (abs((int)result->dc_offset - (int)model_dc) > limits->dc_tolerance_lsb) {
+        failures |= VR_ANALYSIS_FAIL_DC;
+    }
+
+    if (abs((int)result->peak_high - (int)model_high) > limits->amplitude_tolerance_lsb ||
+        abs((int)result->peak_low - (int)model_low) > limits->amplitude_tolerance_lsb) {
+        failures |= VR_ANALYSIS_FAIL_AMPLITUDE;
+    }
+
+    if (result->teeth == 0 || rpm == 0) {
+        return failures | VR_ANALYSIS_FAIL_RPM | VR_ANALYSIS_FAIL_JITTER |
+               VR_ANALYSIS_FAIL_WIDTH | VR_ANALYSIS_FAIL_PATTERN;
+    }
+
+    if (fabsf(result->measured_rpm - rpm) / rpm * 100.0f > limits->rpm_tolerance_pct) {
+        failures |= VR_ANALYSIS_FAIL_RPM;
+    }
+
+    // Each edge can move by one capture sample and one output update
+    float sample_us = 1000000.0f / config->sample_rate_hz;
+    if (result->period_jitter_us > limits->render_period_us + 2.0f * sample_us) {
+        failures |= VR_ANALYSIS_FAIL_JITTER;
+    }
+
+    float deg_per_us = rpm * 360.0f / 60.0f / 1000000.0f;
+    float width_tolerance = limits->width_tolerance_deg +
+                            (limits->render_period_us + sample_us) * deg_per_us;
+    if (!Analysis_WithinDeg(result->regular_width_deg, REGULAR_TOOTH_ANGLE, width_tolerance) ||
+        !Analysis_WithinDeg(result->wide_width_deg, MISSING_TOOTH_ANGLE, width_tolerance) ||
+        !Analysis_WithinDeg(result->wide_gap_deg, MISSING_TOOTH_GAP, width_tolerance)) {
+        failures |= VR_ANALYSIS_FAIL_WIDTH;
+    }
+
+    if (!result->pattern_ok || result->revolutions == 0) {
+        failures |= VR_ANALYSIS_FAIL_PATTERN;
+    }
+
+    return failures;
+}
+
+/**
+  * @brief  Highest and lowest DAC codes the model produces over a revolution
+  * @param  peak_high: Highest code
+  * @param  peak_low: Lowest code
+  * @retval None
+  */
+void VR_Analysis_ModelPeaks(uint16_t *peak_high, uint16_t *peak_low)
+{
+    uint16_t high = VR_Emulator_CalculateDAC_Value(0.0f, 0);
+    uint16_t low = high;
+
+    for (uint8_t tooth = 0; tooth < TRIGGER_WHEEL_TEETH; tooth++) {
+        float start = tooth * TOOTH_PITCH_DEG;
+        float width = (tooth == MISSING_TOOTH_INDEX) ? MISSING_TOOTH_ANGLE : REGULAR_TOOTH_ANGLE;
+
+        for (float angle = start; angle < start + width; angle += MODEL_SCAN_STEP_DEG) {
+            uint16_t code = VR_Emulator_CalculateDAC_Value(DEGREES_TO_RADIANS(angle), 1);
+            if (code > high) high = code;
+            if (code < low) low = code;
+        }
+    }
+
+    *peak_high = high;
+    *peak_low = low;
+}
+
+/**
+  * @brief  Describe a check failure flag
+  * @param  flag: One VR_ANALYSIS_FAIL_* flag
+  * @retval Check name
+  */
+const char *VR_Analysis_CheckName(uint32_t flag)
+{
+    switch (flag) {
+    case VR_ANALYSIS_FAIL_DC:           return "DC offset";
+    case VR_ANALYSIS_FAIL_AMPLITUDE:    return "amplitude";
+    case VR_ANALYSIS_FAIL_RPM:          return "RPM";
+    case VR_ANALYSIS_FAIL_JITTER:       return "tooth period jitter";
+    case VR_ANALYSIS_FAIL_WIDTH:        return "tooth width";
+    case VR_ANALYSIS_FAIL_PATTERN:      return "missing tooth pattern";
+    default:                            return "unknown";
+    }
+}
+
+/**
+  * @brief  Most common level, averaged over its neighbouring histogram bins
+  * @param  samples: Samples
+  * @param  count: Number of samples
+  * @retval DC offset in LSB
+  */
+static uint16_t Analysis_DCOffset(const uint16_t *samples, uint32_t count)
+{
+    uint16_t histogram[HISTOGRAM_BINS] = {0};
+    uint32_t peak_bin = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t bin = (samples[i] >> HISTOGRAM_SHIFT) & (HISTOGRAM_BINS - 1);
+        if (histogram[bin] < UINT16_MAX) {
+            histogram[bin]++;
+        }
+        if (histogram[bin] > histogram[peak_bin]) {
+            peak_bin = bin;
+        }
+    }
+
+    uint64_t sum = 0;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t distance = (int32_t)(samples[i] >> HISTOGRAM_SHIFT) - (int32_t)peak_bin;
+        if (distance >= -1 && distance <= 1) {
+            sum += samples[i];
+            n++;
+        }
+    }
+
+    return (uint16_t)((sum + n / 2) / n);
+}
+
+static uint16_t Analysis_Deviation(uint16_t sample, uint16_t dc)
+{
+    return (sample > dc) ? sample - dc : dc - sample;
+}
+
+static bool Analysis_WithinDeg(float measured, float expected, float tolerance)
+{
+    return fabsf(measured - expected) <= tolerance;
+}
+
+/* USER CODE END 0 */
@@ -0,0 +1,89 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_tcm.c
+  * @brief          : Tightly-coupled memory set-up and usage report
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The startup code only copies .data and clears .bss, so VR_TCM_Init()
+  * does the same for the TCM sections: it copies .itcm_text and .dtcm_data
+  * from their flash images and clears .dtcm_bss. It must run first thing
+  * in main(), before any interrupt can reach code or data placed there.
+  * It also clears .dma_buffer, the other section outside .bss.
+  *
+  * Memory map (STM32F767ZITx_FLASH.ld):
+  *   ITCM   0x00000000   16 KB   sample path code
+  *   DTCM   0x20000000  128 KB   sample path state and tables, main stack
+  *   SRAM1  0x20020000  368 KB   .data, .bss, heap, cacheable DMA buffers
+  *   SRAM2  0x2007C000   16 KB   non-cacheable DMA buffers (.dma_buffer)
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_tcm.h"
+#include "main.h"
+#include "vr_format.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <string.h>
+/* USER CODE END Includes */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+// Section bounds from the linker script
+extern uint32_t _sitcm_text, _sitcm, _eitcm;
+extern uint32_t _sidtcm_data, _sdtcm_data, _edtcm_data;
+extern uint32_t _sdtcm_bss, _edtcm_bss;
+extern uint32_t _sdma_buffer, _edma_buffer;
+extern uint32_t _Min_Stack_Size;
+/* USER CODE END PV */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Load the TCM sections
+  * @note   Call at the top of main(), before HAL_Init() starts the tick
+  * @retval None
+  */
+void VR_TCM_Init(void)
+{
+    memcpy(&_sitcm, &_sitcm_text, (uint32_t)((uint8_t *)&_eitcm - (uint8_t *)&_sitcm));
+    memcpy(&_sdtcm_data, &_sidtcm_data, (uint32_t)((uint8_t *)&_edtcm_data - (uint8_t *)&_sdtcm_data));
+    memset(&_sdtcm_bss, 0, (uint32_t)((uint8_t *)&_edtcm_bss - (uint8_t *)&_sdtcm_bss));
+    memset(&_sdma_buffer, 0, (uint32_t)((uint8_t *)&_edma_buffer - (uint8_t *)&_sdma_buffer));
+
+    // Code was written through the data side; make sure it is fetched fresh
+    __DSB();
+    __ISB();
+}
+
+/**
+  * @brief  Format TCM usage as telemetry text
+  * @note   "TCM itcm=3120/16384 dtcm=9536/131072 stack=4096"
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_TCM_FormatUsage(char *buffer, uint32_t size)
+{
+    uint32_t itcm = (uint32_t)((uint8_t *)&_eitcm - (uint8_t *)&_sitcm);
+    uint32_t dtcm = (uint32_t)((uint8_t *)&_edtcm_bss - (uint8_t *)&_sdtcm_data);
+    uint32_t stack = (uint32_t)&_Min_Stack_Size;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    return VR_Format_Append(buffer, size, 0, "TCM itcm=%lu/%lu dtcm=%lu/%lu stack=%lu\r\n",
+                            (unsigned long)itcm, (unsigned long)VR_ITCM_SIZE,
+                            (unsigned long)dtcm, (unsigned long)VR_DTCM_SIZE, (unsigned long)stack);
+}
+
+/* USER CODE END 0 */
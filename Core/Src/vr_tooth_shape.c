@@ -0,0 +1,231 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_tooth_shape.c
+  * @brief          : Table-driven tooth waveforms
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * Each region's table spans one tooth pitch. The table position of an
+  * update is tooth_timer * length / tooth_period in 16.16 fixed point, and
+  * the level is interpolated between the two entries either side of it.
+  * Past the last entry it interpolates towards entry 0 of the next tooth's
+  * table, so the waveform is continuous across teeth and into and out of
+  * the wide tooth. An update costs one integer division and one multiply,
+  * against three sinf() calls for the built-in harmonic model.
+  *
+  * Shapes are uploaded as text, the same on the command channel and in a
+  * host file: "regular" or "missing" (or "R", "M") selects a region, and
+  * the numbers after it are appended to that region's table. Numbers are
+  * separated by spaces or commas, and '#' starts a comment.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_tooth_shape.h"
+#include "vr_sensor_emulator.h"
+#include "vr_tcm.h"
+
+/* Private includes ----------------------------------------------------------*/
+/* USER CODE BEGIN Includes */
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+/* USER CODE END Includes */
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+#define SHAPE_DC_LEVEL              ((int32_t)(DAC_RESOLUTION * VR_DC_OFFSET))
+#define SHAPE_TOKEN_MAX             16
+/* USER CODE END PD */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static bool VR_Shape_Keyword(const char *token, VR_ShapeRegion_t *region);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Empty both tables
+  * @param  shape: Shape to clear
+  * @retval None
+  */
+void VR_Shape_Clear(VR_ToothShape_t *shape)
+{
+    memset(shape, 0, sizeof(*shape));
+}
+
+/**
+  * @brief  Append one level to a region's table
+  * @param  shape: Shape being built
+  * @param  region: Table to extend
+  * @param  level: DAC codes from the DC level
+  * @retval False if the table is full or the level is out of range
+  */
+bool VR_Shape_Append(VR_ToothShape_t *shape, VR_ShapeRegion_t region, int32_t level)
+{
+    if (region >= VR_SHAPE_REGIONS || shape->length[region] >= VR_SHAPE_MAX_POINTS ||
+        level < -VR_SHAPE_MAX_LEVEL || level > VR_SHAPE_MAX_LEVEL) {
+        return false;
+    }
+
+    shape->points[region][shape->length[region]++] = (int16_t)level;
+    return true;
+}
+
+/**
+  * @brief  Append the levels in a piece of shape text
+  * @param  shape: Shape being built
+  * @param  region: Region the text starts in; updated by region keywords
+  * @param  text: Shape text, one line or a whole file
+  * @retval False on an unknown word, a full table or a level out of range
+  */
+bool VR_Shape_Parse(VR_ToothShape_t *shape, VR_ShapeRegion_t *region, const char *text)
+{
+    const char *p = text;
+
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r' || *p == '\n') {
+            p++;
+        }
+        if (*p == '\0') {
+            return true;
+        }
+        if (*p == '#') {
+            while (*p != '\0' && *p != '\n') {
+                p++;
+            }
+            continue;
+        }
+
+        char token[SHAPE_TOKEN_MAX];
+        uint32_t len = 0;
+        while (*p != '\0' && !isspace((unsigned char)*p) && *p != ',' && *p != '#') {
+            if (len + 1 >= sizeof(token)) {
+                return false;
+            }
+            token[len++] = *p++;
+        }
+        token[len] = '\0';
+
+        if (VR_Shape_Keyword(token, region)) {
+            continue;
+        }
+
+        char *end;
+        long level = strtol(token, &end, 10);
+        if (end == token || *end != '\0' || !VR_Shape_Append(shape, *region, (int32_t)level)) {
+            return false;
+        }
+    }
+}
+
+/**
+  * @brief  Check that both tables can be played
+  * @param  shape: Shape to check
+  * @retval True if each region has at least VR_SHAPE_MIN_POINTS levels
+  */
+bool VR_Shape_IsValid(const VR_ToothShape_t *shape)
+{
+    return shape->length[VR_SHAPE_REGULAR] >= VR_SHAPE_MIN_POINTS &&
+           shape->length[VR_SHAPE_MISSING] >= VR_SHAPE_MIN_POINTS;
+}
+
+/**
+  * @brief  Output level at a point in a tooth
+  * @param  shape: Valid shape
+  * @param  tooth: Tooth index (0 to TRIGGER_WHEEL_TEETH - 1)
+  * @param  timer: Time into the tooth, microseconds
+  * @param  period: Tooth period, microseconds, non-zero
+  * @retval DAC code (0 to DAC_RESOLUTION-1)
+  */
+VR_ITCM_CODE uint16_t VR_Shape_Sample(const VR_ToothShape_t *shape, uint8_t tooth, uint32_t timer, uint32_t period)
+{
+    int32_t level = VR_Shape_Offset(shape, tooth, timer, period) + SHAPE_DC_LEVEL;
+
+    if (level < 0) {
+        level = 0;
+    }
+    if (level > DAC_RESOLUTION - 1) {
+        level = DAC_RESOLUTION - 1;
+    }
+    return (uint16_t)level;
+}
+
+/**
+  * @brief  Signed offset from the DC level at a point in a tooth
+  * @param  shape: Valid shape
+  * @param  tooth: Tooth index (0 to TRIGGER_WHEEL_TEETH - 1)
+  * @param  timer: Time into the tooth, microseconds
+  * @param  period: Tooth period, microseconds, non-zero
+  * @retval Offset in DAC codes, not clamped to the DAC range
+  */
+VR_ITCM_CODE int32_t VR_Shape_Offset(const VR_ToothShape_t *shape, uint8_t tooth, uint32_t timer, uint32_t period)
+{
+    uint8_t next_tooth = (uint8_t)((tooth + 1) % TRIGGER_WHEEL_TEETH);
+    const int16_t *points = shape->points[(tooth == MISSING_TOOTH_INDEX) ? VR_SHAPE_MISSING : VR_SHAPE_REGULAR];
+    const int16_t *next = shape->points[(next_tooth == MISSING_TOOTH_INDEX) ? VR_SHAPE_MISSING : VR_SHAPE_REGULAR];
+    uint32_t length = shape->length[(tooth == MISSING_TOOTH_INDEX) ? VR_SHAPE_MISSING : VR_SHAPE_REGULAR];
+    int32_t level;
+
+    if (timer >= period) {
+        // An RPM step can leave the phase past the tooth end until the wrap
+        level = next[0];
+    } else {
+        // Table position in 16.16 fixed point
+        uint32_t position = (uint32_t)(((uint64_t)timer * length << 16) / period);
+        uint32_t index = position >> 16;
+        int32_t fraction = (int32_t)(position & 0xFFFFu);
+        int32_t a = points[index];
+        int32_t b = (index + 1 < length) ? points[index + 1] : next[0];
+
+        // |b - a| is at most 2 * VR_SHAPE_MAX_LEVEL, so the product fits
+        level = a + (((b - a) * fraction) >> 16);
+    }
+    return level;
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Recognise a region keyword
+  * @param  token: Word from the shape text
+  * @param  region: Set to the region the keyword names
+  * @retval True if the word is a region keyword
+  */
+static bool VR_Shape_Keyword(const char *token, VR_ShapeRegion_t *region)
+{
+    static const struct {
+        const char *name;
+        VR_ShapeRegion_t region;
+    } keywords[] = {
+        {"regular", VR_SHAPE_REGULAR}, {"r", VR_SHAPE_REGULAR},
+        {"missing", VR_SHAPE_MISSING}, {"m", VR_SHAPE_MISSING},
+    };
+
+    for (uint32_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        const char *a = token, *b = keywords[i].name;
+
+        while (*a != '\0' && tolower((unsigned char)*a) == *b) {
+            a++;
+            b++;
+        }
+        if (*a == '\0' && *b == '\0') {
+            *region = keywords[i].region;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* USER CODE END 1 */
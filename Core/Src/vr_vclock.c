@@ -0,0 +1,520 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : vr_vclock.c
+  * @brief          : Variable sample clock output mode
+  ******************************************************************************
+  * @attention
+  *
+  * VR Sensor Emulator for NUCLEO-STM32F7
+  *
+  * The revolution is rendered by an unbound emulator instance stepping one
+  * unit of time per sample with a 64-unit tooth, so each buffer holds the
+  * waveform at 64 evenly spaced phases per tooth. It is rendered again
+  * only when the tooth waveform or the direction of rotation changes;
+  * backwards it runs from tooth 0 down, so the swap at the end of a
+  * revolution keeps the position.
+  *
+  * A tooth lasts T = 360000000 / RPM TIM7 ticks, rounded down. Sample i
+  * of a tooth is given floor((i + 1) * T / 64) - floor(i * T / 64) ticks,
+  * so every sample starts within one tick of its ideal time and every
+  * tooth lasts exactly T ticks. Speeds that can be reached are
+  * 360000000 / T RPM, one tick apart; the gap between them is reported as
+  * the step. TIM7 auto-reload preload is off: DMA writes ARR at the
+  * update, while the counter is at zero, and the value applies to the
+  * sample that update starts.
+  *
+  * The tooth period in whole microseconds, which the digital output and
+  * the ECU capture work in, is not exactly T ticks. Both are therefore
+  * re-anchored at each transfer interrupt, twice per revolution.
+  *
+  * Below VR_VCLK_MIN_RPM a sample would need more than 65536 ticks. TIM7
+  * is stopped and the DAC holds the DC level until the speed rises again,
+  * when playback restarts from tooth 0.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_vclock.h"
+#include "vr_sample.h"
+#include "vr_digital_output.h"
+#include "vr_ecu_capture.h"
+#include "vr_counters.h"
+#include "vr_dma_buffer.h"
+#include "vr_format.h"
+
+/* Private define ------------------------------------------------------------*/
+/* USER CODE BEGIN PD */
+// Samples output at the half and full transfer interrupts, see vr_revolution.c
+#define VCLK_MARK_HALF              (VR_VCLK_SAMPLES - VR_VCLK_SAMPLES / 2u - 2u)
+#define VCLK_MARK_END               (VR_VCLK_SAMPLES - 2u)
+/* USER CODE END PD */
+
+/* Private typedef -----------------------------------------------------------*/
+/* USER CODE BEGIN PTD */
+typedef struct {
+    uint16_t *samples;
+    const VR_ToothShape_t *shape;   // Waveform rendered
+    bool reverse;                   // Rendered turning backwards
+    VR_SensorState_t states[2];     // State after the marked samples, in 1/64 tooth units
+} Vclk_Buffer_t;
+/* USER CODE END PTD */
+
+/* Private variables ---------------------------------------------------------*/
+/* USER CODE BEGIN PV */
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+extern TIM_HandleTypeDef htim7;
+
+// Read by DMA; cleaned from the cache once rendered
+static uint16_t vclk_samples[2][VR_VCLK_SAMPLES] VR_DMA_CACHED_BUFFER;
+static Vclk_Buffer_t vclk_buffers[2] = {
+    {.samples = vclk_samples[0]},
+    {.samples = vclk_samples[1]},
+};
+
+// TIM7 reload for each sample of a tooth; rewritten while DMA reads it
+static uint32_t vclk_reload[VR_VCLK_SAMPLES_PER_TOOTH] VR_DMA_BUFFER;
+
+// Main loop side
+static VR_Emulator_t vclk_render;                   // Unbound instance the buffers are rendered with
+static uint32_t vclk_render_pos = 0;
+static bool vclk_rendering = false;
+static bool vclk_enabled = false;
+static bool vclk_ready = false;                     // The active buffer holds the current waveform
+static bool vclk_owned = false;                     // Default instance unbound, TIM6 interrupt off
+static bool vclk_running = false;                   // TIM7 and both DMA streams running
+static VR_EmulatorBinding_t vclk_binding;           // Default instance's binding, restored on stop
+static uint32_t vclk_tooth_ticks = 0;
+static uint32_t vclk_retunes = 0;
+static uint32_t vclk_renders = 0;
+
+// Shared with the transfer interrupts
+static volatile bool vclk_swap = false;             // Other buffer ready for the next revolution end
+static volatile uint32_t vclk_active = 0;           // Buffer DMA reads
+static volatile uint16_t vclk_rpm = 0;              // Set point the table was last written for
+static volatile uint32_t vclk_period_us = 0;        // Tooth period reported with each sample
+static VR_SensorState_t vclk_last_state;            // Last state handed to the bottom half
+static bool vclk_reported = false;
+static volatile uint32_t vclk_revolutions = 0;
+/* USER CODE END PV */
+
+/* Private function prototypes -----------------------------------------------*/
+/* USER CODE BEGIN PFP */
+static void Vclk_Begin(Vclk_Buffer_t *buffer, const VR_Emulator_t *emu);
+static bool Vclk_Render(Vclk_Buffer_t *buffer);
+static void Vclk_TakeOver(VR_Emulator_t *emu);
+static void Vclk_Retune(const VR_Emulator_t *emu);
+static void Vclk_Run(void);
+static void Vclk_Hold(void);
+static void Vclk_Halt(void);
+static void Vclk_SetTrigger(uint32_t trigger);
+/* USER CODE END PFP */
+
+/* Private user code ---------------------------------------------------------*/
+/* USER CODE BEGIN 0 */
+
+/**
+  * @brief  Enter variable clock mode
+  * @note   The output switches over once VR_Vclk_Update() has rendered the
+  *         revolution
+  * @retval None
+  */
+void VR_Vclk_Start(void)
+{
+    if (vclk_enabled) {
+        return;
+    }
+    vclk_enabled = true;
+    vclk_rendering = false;
+    vclk_ready = false;
+}
+
+/**
+  * @brief  Return to one TIM6 interrupt per sample
+  * @note   The DAC is disabled for a moment while its trigger changes. The
+  *         per-sample path carries on from the phase last reported.
+  * @retval None
+  */
+void VR_Vclk_Stop(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    if (!vclk_enabled) {
+        return;
+    }
+    vclk_enabled = false;
+    vclk_rendering = false;
+    vclk_ready = false;
+    if (!vclk_owned) {
+        return;
+    }
+
+    __disable_irq();
+    Vclk_Halt();
+    __enable_irq();
+    Vclk_SetTrigger(DAC_TRIGGER_NONE);
+    HAL_DAC_Start(&hdac, DAC_CHANNEL_1);
+
+    if (vclk_reported) {
+        emu->state.current_tooth = vclk_last_state.current_tooth;
+        emu->state.tooth_timer = vclk_last_state.tooth_timer;
+        if (emu->state.tooth_timer >= emu->state.tooth_period_us && emu->state.tooth_period_us > 0) {
+            emu->state.tooth_timer = emu->state.tooth_period_us - 1u;     // Set point moved since
+        }
+        vclk_reported = false;
+    }
+    emu->binding = vclk_binding;
+    vclk_owned = false;
+    VR_Emu_SetRPM(emu, emu->state.target_rpm);      // Sample period, or the DC level if stopped
+    VR_Digital_PhaseJump();
+    VR_Capture_PhaseJump();
+
+    __HAL_TIM_CLEAR_FLAG(&htim6, TIM_FLAG_UPDATE);
+    __HAL_TIM_ENABLE_IT(&htim6, TIM_IT_UPDATE);
+}
+
+/**
+  * @brief  Check whether variable clock mode is on
+  * @retval True between VR_Vclk_Start() and VR_Vclk_Stop()
+  */
+bool VR_Vclk_IsEnabled(void)
+{
+    return vclk_enabled;
+}
+
+/**
+  * @brief  Follow the default emulator's RPM and tooth waveform
+  * @note   Call from the main loop. An RPM change rewrites the 64-entry
+  *         TIM7 table; a waveform change renders at most
+  *         VR_VCLK_RENDER_CHUNK samples per call.
+  * @retval True if rendering is under way and the call should be repeated
+  */
+bool VR_Vclk_Update(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    if (!vclk_enabled) {
+        return false;
+    }
+
+    // The other buffer belongs to the transfer interrupt until it is swapped in
+    if (!__atomic_load_n(&vclk_swap, __ATOMIC_ACQUIRE)) {
+        Vclk_Buffer_t *buffer = &vclk_buffers[vclk_active ^ 1u];
+
+        const Vclk_Buffer_t *active = &vclk_buffers[vclk_active];
+
+        if (vclk_rendering && (buffer->shape != emu->shape || buffer->reverse != emu->state.reverse)) {
+            vclk_rendering = false;
+        }
+        if (!vclk_rendering &&
+            (!vclk_ready || active->shape != emu->shape || active->reverse != emu->state.reverse)) {
+            Vclk_Begin(buffer, emu);
+        }
+        if (vclk_rendering) {
+            if (!Vclk_Render(buffer)) {
+                return true;
+            }
+            vclk_rendering = false;
+            vclk_renders++;
+            VR_DMA_Clean(buffer->samples, sizeof(vclk_samples[0]));
+
+            if (vclk_running) {
+                __atomic_store_n(&vclk_swap, true, __ATOMIC_RELEASE);
+            } else {
+                vclk_active ^= 1u;
+                vclk_ready = true;
+            }
+        }
+    }
+
+    if (!vclk_ready) {
+        return false;
+    }
+    if (!vclk_owned) {
+        Vclk_TakeOver(emu);
+    }
+    if (emu->state.target_rpm != vclk_rpm) {
+        Vclk_Retune(emu);
+    }
+    return false;
+}
+
+/**
+  * @brief  Half or all of the revolution loaded; call from the DAC DMA
+  *         half and full transfer callbacks, then pend the bottom half
+  * @param  complete: False at the half transfer, true at the end of the buffer
+  * @retval None
+  */
+void VR_Vclk_TransferCallback(bool complete)
+{
+    uint32_t count = __HAL_TIM_GET_COUNTER(&htim2) - VR_VCLK_DMA_LATENCY_TICKS;
+    VR_SensorState_t state = vclk_buffers[vclk_active].states[complete ? 1 : 0];
+    uint32_t period = vclk_period_us;
+
+    // Rendered in 1/64 tooth units; report it at the speed playing
+    state.tooth_timer = state.tooth_timer * period / VR_VCLK_SAMPLES_PER_TOOTH;
+    state.tooth_period_us = period;
+    state.sample_period_us = period / VR_VCLK_SAMPLES_PER_TOOTH;
+    state.target_rpm = vclk_rpm;
+
+    VR_Digital_PhaseJump();
+    VR_Capture_PhaseJump();
+    VR_Counters_Output(&state, count, VR_VCLK_SAMPLES / 2u);
+    VR_Sample_Publish(&state, count);
+    vclk_last_state = state;
+    vclk_reported = true;
+    if (!complete) {
+        return;
+    }
+
+    vclk_revolutions++;
+    if (__atomic_load_n(&vclk_swap, __ATOMIC_ACQUIRE)) {
+        // DMA has just loaded the last level; one sample period to restart it
+        uint32_t index = vclk_active ^ 1u;
+
+        HAL_DMA_Abort(hdac.DMA_Handle1);
+        HAL_DAC_Start_DMA(&hdac, DAC_CHANNEL_1, (uint32_t *)vclk_buffers[index].samples,
+                          VR_VCLK_SAMPLES, DAC_ALIGN_12B_R);
+        vclk_active = index;
+        __atomic_store_n(&vclk_swap, false, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+  * @brief  Read the variable clock mode counters
+  * @param  stats: Filled with the speed playing and the counts since power-up
+  * @retval None
+  */
+void VR_Vclk_GetStats(VR_VclkStats_t *stats)
+{
+    uint64_t ticks = vclk_tooth_ticks;
+
+    stats->rpm = vclk_running ? vclk_rpm : 0;
+    stats->tooth_ticks = vclk_running ? vclk_tooth_ticks : 0;
+    stats->step_mrpm = 0;
+    if (vclk_running) {
+        // 360000000 / T - 360000000 / (T + 1), rounded
+        uint64_t span = ticks * (ticks + 1u);
+        stats->step_mrpm = (uint32_t)(((uint64_t)VR_VCLK_TOOTH_TICKS_RPM * 1000u + span / 2u) / span);
+    }
+    stats->revolutions = vclk_revolutions;
+    stats->retunes = vclk_retunes;
+    stats->renders = vclk_renders;
+}
+
+/**
+  * @brief  Format the variable clock mode counters as telemetry text
+  * @note   "VCLK rpm=3000 tooth=120000t step=25mrpm revs=2500 retunes=40 renders=1";
+  *         nothing while the mode is off
+  * @param  buffer: Output buffer
+  * @param  size: Buffer size in bytes
+  * @retval Length of the text, without the terminator
+  */
+uint32_t VR_Vclk_FormatTelemetry(char *buffer, uint32_t size)
+{
+    VR_VclkStats_t stats;
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+    if (!vclk_enabled) {
+        return 0;
+    }
+
+    VR_Vclk_GetStats(&stats);
+    return VR_Format_Append(buffer, size, 0, "VCLK rpm=%u tooth=%lut step=%lumrpm revs=%lu retunes=%lu renders=%lu\r\n",
+                            stats.rpm, (unsigned long)stats.tooth_ticks, (unsigned long)stats.step_mrpm,
+                            (unsigned long)stats.revolutions, (unsigned long)stats.retunes,
+                            (unsigned long)stats.renders);
+}
+
+/* USER CODE END 0 */
+
+/* Private functions ---------------------------------------------------------*/
+/* USER CODE BEGIN 1 */
+
+/**
+  * @brief  Start rendering a buffer from tooth 0
+  * @param  buffer: Revolution buffer
+  * @param  emu: Default emulator instance, for its waveform and direction
+  * @retval None
+  */
+static void Vclk_Begin(Vclk_Buffer_t *buffer, const VR_Emulator_t *emu)
+{
+    VR_Emu_Init(&vclk_render, NULL);
+    VR_Emu_SetShape(&vclk_render, emu->shape);
+    vclk_render.state.reverse = emu->state.reverse;
+
+    // Phase only: one unit of time per sample
+    vclk_render.state.tooth_period_us = VR_VCLK_SAMPLES_PER_TOOTH;
+    vclk_render.state.sample_period_us = 1;
+    buffer->shape = emu->shape;
+    buffer->reverse = emu->state.reverse;
+    vclk_render_pos = 0;
+    vclk_rendering = true;
+}
+
+/**
+  * @brief  Render the next chunk of the revolution
+  * @param  buffer: Revolution buffer set up by Vclk_Begin()
+  * @retval True once the whole revolution is rendered
+  */
+static bool Vclk_Render(Vclk_Buffer_t *buffer)
+{
+    uint32_t end = vclk_render_pos + VR_VCLK_RENDER_CHUNK;
+
+    if (end > VR_VCLK_SAMPLES) {
+        end = VR_VCLK_SAMPLES;
+    }
+
+    for (; vclk_render_pos < end; vclk_render_pos++) {
+        VR_Emu_GenerateSignal(&vclk_render);
+        buffer->samples[vclk_render_pos] = vclk_render.state.dac_output;
+        if (vclk_render_pos == VCLK_MARK_HALF) {
+            buffer->states[0] = vclk_render.state;
+        }
+        if (vclk_render_pos == VCLK_MARK_END) {
+            buffer->states[1] = vclk_render.state;
+        }
+    }
+    return vclk_render_pos == VR_VCLK_SAMPLES;
+}
+
+/**
+  * @brief  Take the DAC from the TIM6 interrupt, holding the DC level
+  * @param  emu: Default emulator instance
+  * @retval None
+  */
+static void Vclk_TakeOver(VR_Emulator_t *emu)
+{
+    // The default instance keeps following the potentiometer and the
+    // commands, but no longer drives the DAC or the TIM6 period
+    __HAL_TIM_DISABLE_IT(&htim6, TIM_IT_UPDATE);
+    vclk_binding = emu->binding;
+    emu->binding.hdac = NULL;
+    emu->binding.htim = NULL;
+    vclk_owned = true;
+    vclk_rpm = 0;
+    vclk_last_state = emu->state;
+    Vclk_Hold();
+}
+
+/**
+  * @brief  Rewrite the TIM7 table for the default emulator's RPM
+  * @param  emu: Default emulator instance
+  * @retval None
+  */
+static void Vclk_Retune(const VR_Emulator_t *emu)
+{
+    uint16_t rpm = emu->state.target_rpm;
+    uint32_t done = 0;
+
+    vclk_rpm = rpm;
+    if (rpm < VR_VCLK_MIN_RPM) {
+        if (vclk_running) {
+            Vclk_Hold();
+        }
+        return;
+    }
+
+    // Spread the tooth's ticks over its samples, each within one tick of ideal
+    uint32_t ticks = VR_VCLK_TOOTH_TICKS_RPM / rpm;
+    for (uint32_t i = 0; i < VR_VCLK_SAMPLES_PER_TOOTH; i++) {
+        uint32_t end = ticks * (i + 1u) / VR_VCLK_SAMPLES_PER_TOOTH;
+        vclk_reload[i] = end - done - 1u;
+        done = end;
+    }
+    vclk_tooth_ticks = ticks;
+    vclk_period_us = emu->state.tooth_period_us;
+    vclk_retunes++;
+
+    if (!vclk_running) {
+        Vclk_Run();
+    }
+}
+
+/**
+  * @brief  Play the active buffer from tooth 0, triggered by TIM7
+  * @retval None
+  */
+static void Vclk_Run(void)
+{
+    Vclk_SetTrigger(DAC_TRIGGER_T7_TRGO);
+    __HAL_TIM_SET_COUNTER(&htim7, 0);
+    __HAL_TIM_SET_AUTORELOAD(&htim7, vclk_reload[VR_VCLK_SAMPLES_PER_TOOTH - 1u]);
+    VR_Digital_PhaseJump();
+    VR_Capture_PhaseJump();
+    VR_Counters_PhaseJump();
+
+    vclk_running = true;
+    HAL_DAC_Start_DMA(&hdac, DAC_CHANNEL_1, (uint32_t *)vclk_buffers[vclk_active].samples,
+                      VR_VCLK_SAMPLES, DAC_ALIGN_12B_R);
+    HAL_TIM_Base_Start_DMA(&htim7, vclk_reload, VR_VCLK_SAMPLES_PER_TOOTH);
+}
+
+/**
+  * @brief  Stop playback and hold the DC level, as the wheel at rest
+  * @retval None
+  */
+static void Vclk_Hold(void)
+{
+    VR_SensorState_t state = vclk_last_state;
+
+    __disable_irq();
+    Vclk_Halt();
+    __enable_irq();
+    Vclk_SetTrigger(DAC_TRIGGER_NONE);
+    HAL_DAC_Start(&hdac, DAC_CHANNEL_1);
+    HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, DAC_ALIGN_12B_R, (uint32_t)(DAC_RESOLUTION * VR_DC_OFFSET));
+
+    // At rest for the digital output and ECU capture. No sample interrupt
+    // runs while holding, so the bottom half is called here directly.
+    state.tooth_period_us = 0;
+    state.target_rpm = 0;
+    state.dac_output = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+    VR_Sample_Publish(&state, __HAL_TIM_GET_COUNTER(&htim2));
+    VR_Sample_BottomHalf();
+}
+
+/**
+  * @brief  Stop TIM7 and both DMA streams; call with interrupts masked
+  * @note   A buffer rendered for the next revolution end becomes active
+  * @retval None
+  */
+static void Vclk_Halt(void)
+{
+    if (!vclk_running) {
+        return;
+    }
+
+    HAL_TIM_Base_Stop_DMA(&htim7);
+    HAL_DAC_Stop_DMA(&hdac, DAC_CHANNEL_1);
+    vclk_running = false;
+    if (vclk_swap) {
+        vclk_active ^= 1u;
+        vclk_swap = false;
+    }
+}
+
+/**
+  * @brief  Select what triggers DAC channel 1
+  * @note   The channel is left disabled; starting it is up to the caller
+  * @param  trigger: DAC_TRIGGER_NONE or DAC_TRIGGER_T7_TRGO
+  * @retval None
+  */
+static void Vclk_SetTrigger(uint32_t trigger)
+{
+    DAC_ChannelConfTypeDef config = {0};
+
+    HAL_DAC_Stop(&hdac, DAC_CHANNEL_1);
+    config.DAC_Trigger = trigger;
+    config.DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+    HAL_DAC_ConfigChannel(&hdac, &config, DAC_CHANNEL_1);
+}
+
+/* USER CODE END 1 */
@@ -0,0 +1,358 @@
+/**
+  ******************************************************************************
+  * @file           : stm32f7xx_hal.h
+  * @brief          : Host simulator stand-in for the STM32F7 HAL
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Provides the subset of HAL types, macros and functions used by the
+  * emulator sources so that Core/Src modules compile unchanged on a PC.
+  * Peripheral handles keep the last written register values so the
+  * simulator can observe the DAC output and the TIM6 reload value.
+  * ADC2 is wired to the DAC channel 1 output (PA4) and converts on TIM8
+  * updates in virtual time, running TIM6 update events in between.
+  * Host_TIM6_Update() is one TIM6 update: with the DAC triggered by TIM6
+  * it outputs the level DMA loaded at the previous update and loads the
+  * next one, then raises the update interrupt if it is enabled.
+  * Host_TIM7_Update() steps a TIM7-triggered DAC the same way, then lets
+  * the update DMA load the next TIM7 reload value.
+  * TIM2 channel 4 drives PA3 in toggle mode, with DMA reloading its
+  * compare register; Host_TIM2_RunTo() advances it in virtual time.
+  * Channels 2 and 3 capture the count when Host_TIM2_Capture() is called,
+  * with DMA storing each capture into a circular buffer.
+  * The MPU and cache calls only record what was asked of them in
+  * host_cache; host memory is always coherent. Masking interrupts does
+  * nothing, and __WFI() runs the hook set by Host_SetSleepHook(), which
+  * stands in for the interrupt that would end the sleep.
+  * Flash sectors 10 and 11 are a plain array: programming can only clear
+  * bits, an erase sets the sector to 0xFF, and Host_Flash_SetWriteLimit()
+  * cuts the power after a number of programmed words.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F7xx_HAL_H
+#define __STM32F7xx_HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef struct {
+    void *Instance;
+    const uint32_t *source;     // Circular memory-to-peripheral buffer
+    uint32_t *dest;             // Circular peripheral-to-memory buffer
+    uint32_t length;
+    uint32_t NDTR;              // Transfers left before the buffer wraps
+} DMA_HandleTypeDef;
+
+typedef struct {
+    void *Instance;
+    DMA_HandleTypeDef *DMA_Handle;
+    uint32_t value;             // Next value returned by HAL_ADC_GetValue()
+    uint16_t *dma_buffer;       // Destination armed by HAL_ADC_Start_DMA()
+    uint32_t dma_length;
+} ADC_HandleTypeDef;
+
+typedef struct {
+    void *Instance;
+    DMA_HandleTypeDef *DMA_Handle1;
+    uint32_t DHR12R1;           // Channel 1 output
+    uint32_t DHR12R2;           // Channel 2 output
+    uint32_t trigger;           // Channel 1 trigger, DAC_TRIGGER_NONE to output on write
+    uint32_t dma_hold;          // Level DMA loaded, output at the next trigger
+    const uint16_t *dma_buffer; // Circular source armed by HAL_DAC_Start_DMA()
+} DAC_HandleTypeDef;
+
+typedef struct {
+    uint32_t DAC_Trigger;
+    uint32_t DAC_OutputBuffer;
+} DAC_ChannelConfTypeDef;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    uint32_t CR1;
+    uint32_t CNT;
+    uint32_t CCR2;
+    uint32_t CCR3;
+    uint32_t CCR4;
+    uint32_t DIER;
+    uint32_t CCER;
+} TIM_TypeDef;
+
+typedef struct {
+    TIM_TypeDef *Instance;
+    TIM_Base_InitTypeDef Init;
+    DMA_HandleTypeDef *hdma[7];
+    uint32_t Channel;           // Channel of the callback being raised
+} TIM_HandleTypeDef;
+
+typedef struct {
+    void *Instance;
+} UART_HandleTypeDef;
+
+typedef struct {
+    void *Instance;
+} GPIO_TypeDef;
+
+/* Cycle counter; host code sets CYCCNT to stand in for core clocks */
+typedef struct {
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+    uint32_t LAR;
+} DWT_Type;
+
+typedef struct {
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+    uint8_t Enable;
+    uint8_t Number;
+    uint32_t BaseAddress;
+    uint8_t Size;
+    uint8_t SubRegionDisable;
+    uint8_t TypeExtField;
+    uint8_t AccessPermission;
+    uint8_t DisableExec;
+    uint8_t IsShareable;
+    uint8_t IsCacheable;
+    uint8_t IsBufferable;
+} MPU_Region_InitTypeDef;
+
+/* Record of the MPU and cache maintenance calls */
+typedef struct {
+    MPU_Region_InitTypeDef region;  // Last region configured
+    uint32_t mpu_control;           // HAL_MPU_Enable() argument, 0 while disabled
+    uint32_t icache_enabled;
+    uint32_t dcache_enabled;
+    uint32_t clean_calls;
+    uintptr_t clean_addr;           // Range of the last clean
+    int32_t clean_size;
+    uint32_t invalidate_calls;
+    uintptr_t invalidate_addr;      // Range of the last invalidate
+    int32_t invalidate_size;
+} Host_Cache_t;
+
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+/**
+  * @brief  Receives every change of the TIM2 channel 4 output
+  * @param  ctx: Context given to Host_TIM2_SetEdgeHook()
+  * @param  count: TIM2 count at the edge
+  * @param  level: New output level
+  * @retval None
+  */
+typedef void (*Host_EdgeHook_t)(void *ctx, uint32_t count, uint32_t level);
+
+/**
+  * @brief  Runs in place of each WFI sleep
+  * @param  ctx: Context given to Host_SetSleepHook()
+  * @retval None
+  */
+typedef void (*Host_SleepHook_t)(void *ctx);
+
+/* Exported constants --------------------------------------------------------*/
+#define DAC_CHANNEL_1               0x00000000U
+#define DAC_CHANNEL_2               0x00000010U
+#define DAC_ALIGN_12B_R             0x00000000U
+#define DAC_TRIGGER_NONE            0x00000000U
+#define DAC_TRIGGER_T6_TRGO         0x00000004U
+#define DAC_TRIGGER_T7_TRGO         0x00000014U
+#define DAC_OUTPUTBUFFER_ENABLE     0x00000000U
+
+#define DMA_IT_HT                   0x00000008U
+
+#define TIM_CR1_ARPE                0x00000080U
+#define TIM_IT_UPDATE               0x00000001U     // DIER.UIE
+#define TIM_FLAG_UPDATE             0x00000001U
+#define TIM_CHANNEL_2               0x00000004U
+#define TIM_CHANNEL_3               0x00000008U
+#define TIM_CHANNEL_4               0x0000000CU
+#define TIM_DMA_UPDATE              0x00000100U     // DIER.UDE
+#define TIM_DMA_CC2                 0x00000400U     // DIER.CC2DE
+#define TIM_DMA_CC3                 0x00000800U     // DIER.CC3DE
+#define TIM_DMA_CC4                 0x00001000U     // DIER.CC4DE
+#define TIM_DMA_ID_UPDATE           ((uint16_t)0x0000)
+#define TIM_DMA_ID_CC2              ((uint16_t)0x0002)
+#define TIM_DMA_ID_CC3              ((uint16_t)0x0003)
+#define TIM_DMA_ID_CC4              ((uint16_t)0x0004)
+#define TIM_CCER_CC2E               0x00000010U
+#define TIM_CCER_CC3E               0x00000100U
+#define TIM_CCER_CC4E               0x00001000U
+#define HAL_TIM_ACTIVE_CHANNEL_2    0x02U
+#define HAL_TIM_ACTIVE_CHANNEL_3    0x04U
+#define HAL_TIM_ACTIVE_CHANNEL_4    0x08U
+
+#define MPU_REGION_ENABLE           ((uint8_t)0x01)
+#define MPU_REGION_NUMBER0          ((uint8_t)0x00)
+#define MPU_REGION_SIZE_16KB        ((uint8_t)0x0D)
+#define MPU_TEX_LEVEL1              ((uint8_t)0x01)
+#define MPU_REGION_FULL_ACCESS      ((uint8_t)0x03)
+#define MPU_INSTRUCTION_ACCESS_DISABLE ((uint8_t)0x01)
+#define MPU_ACCESS_SHAREABLE        ((uint8_t)0x01)
+#define MPU_ACCESS_NOT_CACHEABLE    ((uint8_t)0x00)
+#define MPU_ACCESS_NOT_BUFFERABLE   ((uint8_t)0x00)
+#define MPU_PRIVILEGED_DEFAULT      0x00000004U
+
+#define FLASH_TYPEERASE_SECTORS     0x00000000U
+#define FLASH_VOLTAGE_RANGE_3       0x00000002U
+#define FLASH_TYPEPROGRAM_BYTE      0x00000000U
+#define FLASH_TYPEPROGRAM_HALFWORD  0x00000001U
+#define FLASH_TYPEPROGRAM_WORD      0x00000002U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x00000003U
+#define FLASH_SECTOR_10             10U
+#define FLASH_SECTOR_11             11U
+#define HOST_FLASH_SECTOR_SIZE      (256U * 1024U)
+#define HOST_FLASH_SECTORS          2U              // Sectors 10 and 11
+
+#define DWT_CTRL_CYCCNTENA_Msk      0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk  0x01000000U
+
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_coredebug;
+#define DWT                         (&host_dwt)
+#define CoreDebug                   (&host_coredebug)
+extern Host_Cache_t host_cache;
+extern uint32_t SystemCoreClock;
+
+extern GPIO_TypeDef host_gpioa;
+#define GPIOA                       (&host_gpioa)
+
+#define GPIO_PIN_0                  ((uint16_t)0x0001)
+#define GPIO_PIN_3                  ((uint16_t)0x0008)
+#define GPIO_PIN_4                  ((uint16_t)0x0010)
+#define GPIO_PIN_7                  ((uint16_t)0x0080)
+#define GPIO_PIN_8                  ((uint16_t)0x0100)
+#define GPIO_PIN_9                  ((uint16_t)0x0200)
+#define GPIO_PIN_13                 ((uint16_t)0x2000)
+#define GPIO_PIN_14                 ((uint16_t)0x4000)
+
+/* Exported macro ------------------------------------------------------------*/
+#define SET_BIT(REG, BIT)           ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)         ((REG) &= ~(BIT))
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __AUTORELOAD__) \
+    ((__HANDLE__)->Init.Period = (__AUTORELOAD__))
+#define __HAL_TIM_GET_AUTORELOAD(__HANDLE__)    ((__HANDLE__)->Init.Period)
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__) \
+    ((__HANDLE__)->Instance->CNT = (__COUNTER__))
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)       ((__HANDLE__)->Instance->CNT)
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+    ((void)(__CHANNEL__), (__HANDLE__)->Instance->CCR4 = (__COMPARE__))
+#define __HAL_TIM_ENABLE_DMA(__HANDLE__, __DMA__)   ((__HANDLE__)->Instance->DIER |= (__DMA__))
+#define __HAL_TIM_DISABLE_DMA(__HANDLE__, __DMA__)  ((__HANDLE__)->Instance->DIER &= ~(__DMA__))
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)  ((__HANDLE__)->Instance->DIER |= (__INTERRUPT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__) ((__HANDLE__)->Instance->DIER &= ~(__INTERRUPT__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__) \
+    ((void)(__HANDLE__), (void)(__FLAG__))
+#define __HAL_DMA_GET_COUNTER(__HANDLE__)       ((__HANDLE__)->NDTR)
+#define __HAL_DMA_GET_HT_FLAG_INDEX(__HANDLE__) ((void)(__HANDLE__), 0U)
+#define __HAL_DMA_GET_TC_FLAG_INDEX(__HANDLE__) ((void)(__HANDLE__), 0U)
+#define __HAL_DMA_CLEAR_FLAG(__HANDLE__, __FLAG__) \
+    ((void)(__HANDLE__), (void)(__FLAG__))
+#define __HAL_DMA_DISABLE_IT(__HANDLE__, __INTERRUPT__) \
+    ((void)(__HANDLE__), (void)(__INTERRUPT__))
+
+/* Exported functions --------------------------------------------------------*/
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline void __DSB(void) {}
+void __WFI(void);
+HAL_StatusTypeDef HAL_DAC_SetValue(DAC_HandleTypeDef *hdac, uint32_t Channel,
+                                   uint32_t Alignment, uint32_t Data);
+HAL_StatusTypeDef HAL_DAC_ConfigChannel(DAC_HandleTypeDef *hdac, DAC_ChannelConfTypeDef *sConfig, uint32_t Channel);
+HAL_StatusTypeDef HAL_DAC_Start(DAC_HandleTypeDef *hdac, uint32_t Channel);
+HAL_StatusTypeDef HAL_DAC_Stop(DAC_HandleTypeDef *hdac, uint32_t Channel);
+HAL_StatusTypeDef HAL_DAC_Start_DMA(DAC_HandleTypeDef *hdac, uint32_t Channel, uint32_t *pData,
+                                    uint32_t Length, uint32_t Alignment);
+HAL_StatusTypeDef HAL_DAC_Stop_DMA(DAC_HandleTypeDef *hdac, uint32_t Channel);
+void HAL_DAC_ConvCpltCallbackCh1(DAC_HandleTypeDef *hdac);
+void HAL_DAC_ConvHalfCpltCallbackCh1(DAC_HandleTypeDef *hdac);
+void HAL_DAC_DMAUnderrunCallbackCh1(DAC_HandleTypeDef *hdac);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_Stop(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef *hadc, uint32_t Timeout);
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length);
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc);
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_DMA(TIM_HandleTypeDef *htim, uint32_t *pData, uint16_t Length);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_DMA(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_OC_Start_DMA(TIM_HandleTypeDef *htim, uint32_t Channel, uint32_t *pData, uint16_t Length);
+HAL_StatusTypeDef HAL_TIM_OC_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Start_DMA(TIM_HandleTypeDef *htim, uint32_t Channel, uint32_t *pData, uint16_t Length);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t Channel);
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_MPU_Disable(void);
+void HAL_MPU_Enable(uint32_t MPU_Control);
+void HAL_MPU_ConfigRegion(MPU_Region_InitTypeDef *MPU_Init);
+void SCB_EnableICache(void);
+void SCB_EnableDCache(void);
+void SCB_CleanDCache_by_Addr(uint32_t *addr, int32_t dsize);
+void SCB_InvalidateDCache_by_Addr(uint32_t *addr, int32_t dsize);
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError);
+
+/* Virtual TIM6 and TIM7 update events */
+void Host_TIM6_Update(void);
+void Host_TIM7_Update(void);
+
+/* Virtual TIM2 channels 2 to 4 */
+void Host_TIM2_RunTo(uint32_t count);
+void Host_TIM2_SetEdgeHook(Host_EdgeHook_t hook, void *ctx);
+void Host_TIM2_Capture(uint32_t Channel);
+
+/* Sleep in place of an interrupt */
+void Host_SetSleepHook(Host_SleepHook_t hook, void *ctx);
+
+/* Flash sectors 10 and 11 */
+const uint8_t *Host_Flash_Map(uint32_t address);
+void Host_Flash_Reset(void);
+void Host_Flash_SetWriteLimit(uint32_t words);
+uint32_t Host_Flash_GetErases(uint32_t sector);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F7xx_HAL_H */
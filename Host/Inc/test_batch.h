@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file           : test_batch.h
+  * @brief          : Header for batch renderer tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Checks the structure-of-arrays batch renderer against scalar emulator
+  * instances stepped in lockstep.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_BATCH_H
+#define __TEST_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define BATCH_TEST_LANES            1001    // Not a multiple of VR_BATCH_BLOCK
+#define BATCH_TEST_STEPS            4000    // Updates per lane
+#define BATCH_TEST_MAX_OFF_PCT      0.01    // Largest share of levels allowed 1 LSB off
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the batch renderer tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Batch(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_BATCH_H */
@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file           : test_capture.h
+  * @brief          : Header for ECU timing capture tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Drives TIM2 channels 2 and 3 from a model ECU that fires on the digital
+  * crank output, and checks the crank angles the capture module reports.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_CAPTURE_H
+#define __TEST_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define CAPTURE_TEST_MAX_EVENTS     4096    // ECU events logged per segment
+#define CAPTURE_TEST_WRAP_MS        200     // TIM2 wraps this far into the run
+#define CAPTURE_TEST_TOLERANCE_DEG  0.01f   // Allowed advance error
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the ECU timing capture tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_EcuCapture(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_CAPTURE_H */
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_config.h
+  * @brief          : Header for configuration store and boot time tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs the flash configuration store against the simulated flash
+  * sectors, with power cut mid-write, and times the boot stages.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_CONFIG_H
+#define __TEST_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the configuration store and boot time tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Config(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_CONFIG_H */
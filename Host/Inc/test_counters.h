@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_counters.h
+  * @brief          : Header for output and activity counter tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs the sample path and revolution mode and checks the samples,
+  * teeth, revolutions and speed counted, and the activity counters.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_COUNTERS_H
+#define __TEST_COUNTERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the output and activity counter tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Counters(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_COUNTERS_H */
@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file           : test_crank.h
+  * @brief          : Header for cranking and engine start tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs engine starts tooth by tooth and checks the start phases, the
+  * compression speed dips per cylinder, the catch and flare to idle,
+  * the amplitude at low speed, and the CRANK command.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_CRANK_H
+#define __TEST_CRANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the cranking and engine start tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Crank(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_CRANK_H */
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_cycles.h
+  * @brief          : Header for cycle-count profiling tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Drives the host DWT cycle counter by hand and checks the probe
+  * statistics, windows and telemetry text.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_CYCLES_H
+#define __TEST_CYCLES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the cycle-count profiling tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Cycles(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_CYCLES_H */
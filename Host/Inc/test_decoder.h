@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file           : test_decoder.h
+  * @brief          : Header for decoder-based timing accuracy tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Renders fixed-RPM runs across the full speed range and checks that the
+  * reference decoder syncs and measures the commanded RPM.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_DECODER_H
+#define __TEST_DECODER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    float start_rpm;
+    float end_rpm;
+    float step_rpm;
+    float max_rev_err_pct;      // Allowed error of any whole-revolution RPM
+} DecoderSweepConfig_t;
+
+/* Exported constants --------------------------------------------------------*/
+#define DECODER_SWEEP_STEP_RPM      10.0f
+#define DECODER_MAX_REV_ERR_PCT     0.5f
+#define DECODER_SWEEP_REVOLUTIONS   4       // Revolutions rendered per RPM point
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Decode fixed-RPM runs over a range of speeds
+  * @param  config: Sweep range and accuracy limits
+  * @retval Test results
+  */
+TestResults_t VR_Test_DecoderSweep(const DecoderSweepConfig_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_DECODER_H */
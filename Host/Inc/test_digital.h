@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file           : test_digital.h
+  * @brief          : Header for digital output timing tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs the TIM2 output-compare Hall/optical output against the analog
+  * output over an RPM profile in virtual TIM2 time.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_DIGITAL_H
+#define __TEST_DIGITAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define DIGITAL_TEST_MAX_EDGES      200000  // Edge log size for each output
+#define DIGITAL_TEST_WRAP_MS        400     // TIM2 wraps this far into the run
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the digital output timing tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_DigitalOutput(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_DIGITAL_H */
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_dma.h
+  * @brief          : Header for cache and DMA buffer tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Checks the MPU region and cache set-up, and the cache line ranges the
+  * clean and invalidate helpers hand to the host SCB stubs.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_DMA_H
+#define __TEST_DMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the cache and DMA buffer tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_DmaBuffer(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_DMA_H */
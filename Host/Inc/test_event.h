@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_event.h
+  * @brief          : Header for main loop event and load tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Replaces each WFI sleep with a hook that advances the host cycle
+  * counter and posts events, and checks the wake-ups and load figures.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_EVENT_H
+#define __TEST_EVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the main loop event and load tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Events(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_EVENT_H */
@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file           : test_export.h
+  * @brief          : Header for waveform export tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Writes exports to temporary files and reads them back, checking the
+  * WAV header, raw byte order, CSV timestamps at a resampled rate, and
+  * that a chunked parallel export matches a sequential one byte for byte.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_EXPORT_H
+#define __TEST_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the waveform export tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Export(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_EXPORT_H */
@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file           : test_farm.h
+  * @brief          : Header for simulation farm tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Checks that the work-stealing farm runs every scenario exactly once and
+  * gives the same results for any number of threads.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_FARM_H
+#define __TEST_FARM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define FARM_TEST_THREADS           4       // Parallel run compared with one thread
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run a small campaign on one and on several threads
+  * @retval Test results
+  */
+TestResults_t VR_Test_Farm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_FARM_H */
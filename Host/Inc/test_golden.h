@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file           : test_golden.h
+  * @brief          : Header for golden-waveform regression tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Renders canonical scenarios and compares the DAC output sample by
+  * sample against reference captures stored in Host/golden.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_GOLDEN_H
+#define __TEST_GOLDEN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint16_t tolerance_lsb;     // Allowed |actual - reference| at every tick
+    uint32_t max_mismatches;    // Samples allowed outside tolerance per scenario
+} GoldenConfig_t;
+
+/* Exported constants --------------------------------------------------------*/
+#define GOLDEN_DEFAULT_DIR          "Host/golden"
+#define GOLDEN_MAGIC                0x44475256u     // "VRGD"
+#define GOLDEN_VERSION              2       // Holds carry their length in ticks
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Compare every canonical scenario against its reference capture
+  * @param  dir: Directory holding the .golden files
+  * @param  config: Comparison tolerances
+  * @retval Test results, one test per scenario
+  */
+TestResults_t VR_Test_GoldenWaveforms(const char *dir, const GoldenConfig_t *config);
+
+/**
+  * @brief  Re-render every canonical scenario and overwrite its reference
+  * @param  dir: Directory receiving the .golden files
+  * @retval True if all references were written
+  */
+bool VR_Test_GoldenUpdate(const char *dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_GOLDEN_H */
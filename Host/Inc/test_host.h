@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file           : test_host.h
+  * @brief          : Header for helpers shared by the host test suites
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Each suite counts its checks with VR_Test_Record() and ends with
+  * VR_Test_Report(), so every suite tallies and reports the same way.
+  * VR_Test_Command() plays a command line as USART3 would deliver it.
+  * Suites that drive the firmware paths bound to the default instance
+  * start and end with VR_Test_ResetDefault(); logic tests build their own
+  * VR_Emulator_t instead.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_HOST_H
+#define __TEST_HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+#include <stdbool.h>
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Count one check as passed or failed
+  * @param  results: Suite results
+  * @param  passed: Outcome of the check
+  * @retval None
+  */
+void VR_Test_Record(TestResults_t *results, bool passed);
+
+/**
+  * @brief  Total a suite's checks and print its summary line
+  * @param  results: Suite results
+  * @param  name: Suite name, as in "<name> tests completed"
+  * @retval The totalled results
+  */
+TestResults_t VR_Test_Report(TestResults_t *results, const char *name);
+
+/**
+  * @brief  Feed a line to the command channel and check its reply
+  * @param  label: Names the commands in a failure message
+  * @param  line: Command, line end included
+  * @param  expected: Expected reply
+  * @retval True if exactly that reply came back
+  */
+bool VR_Test_Command(const char *label, const char *line, const char *expected);
+
+/**
+  * @brief  Return the default instance and the timers it drives to power-on state
+  * @retval None
+  */
+void VR_Test_ResetDefault(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_HOST_H */
@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file           : test_instances.h
+  * @brief          : Header for multi-instance emulator tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Checks that emulator instances share no state: many interleaved
+  * instances render exactly what each renders alone, and none of them
+  * disturbs the default instance or another instance's DAC channel.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_INSTANCES_H
+#define __TEST_INSTANCES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define INSTANCES_COUNT             2000    // Instances stepped side by side
+#define INSTANCES_STEPS             4000    // Signal updates per instance
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the multi-instance independence tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Instances(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_INSTANCES_H */
@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file           : test_parallel.h
+  * @brief          : Header for chunked parallel rendering tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Checks that seeking and chunked parallel rendering reproduce a
+  * sequential render bit for bit.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_PARALLEL_H
+#define __TEST_PARALLEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define PARALLEL_TEST_THREADS       3       // Odd, so chunk waves end part-full
+#define PARALLEL_TEST_SEEKS         200     // Random seek targets checked
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Compare seeks and chunked parallel renders with a sequential render
+  * @retval Test results
+  */
+TestResults_t VR_Test_ParallelRender(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_PARALLEL_H */
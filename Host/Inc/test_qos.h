@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_qos.h
+  * @brief          : Header for overload quality step tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Feeds overload reports to the quality steps and checks each step,
+  * its counters, and that tooth timing is the same at every level.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_QOS_H
+#define __TEST_QOS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the overload quality step tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_QoS(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_QOS_H */
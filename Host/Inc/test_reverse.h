@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file           : test_reverse.h
+  * @brief          : Header for reverse rotation tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Turns the wheel backwards and checks the waveform, the tooth order,
+  * the phase through a stop, and what the digital output, the counters,
+  * the host profiles and the DIR command make of it.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_REVERSE_H
+#define __TEST_REVERSE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the reverse rotation tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Reverse(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_REVERSE_H */
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_revolution.h
+  * @brief          : Header for revolution output mode tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Plays precomputed revolutions through the TIM6-triggered DAC and its
+  * DMA model, and compares the output with the per-sample emulator.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_REVOLUTION_H
+#define __TEST_REVOLUTION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the revolution output mode tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Revolution(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_REVOLUTION_H */
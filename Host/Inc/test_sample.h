@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_sample.h
+  * @brief          : Header for sample interrupt split tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs the sample top and bottom halves separately, as the TIM6
+  * interrupt and PendSV do on target.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_SAMPLE_H
+#define __TEST_SAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the sample interrupt split tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_SampleIsr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_SAMPLE_H */
@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file           : test_scenario.h
+  * @brief          : Header for scenario sequencer tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Compiles scenario text and plays the images, checking the sort order,
+  * when each event lands, ramps, fault windows, gain and noise, image
+  * checks, and the SCN upload command.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_SCENARIO_H
+#define __TEST_SCENARIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the scenario sequencer tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Scenario(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_SCENARIO_H */
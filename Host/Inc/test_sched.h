@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_sched.h
+  * @brief          : Header for background task scheduler tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs the scheduler against the virtual TIM2 count, with tasks that
+  * advance the count to stand in for their run time.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_SCHED_H
+#define __TEST_SCHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the background task scheduler tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Scheduler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_SCHED_H */
@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file           : test_shape.h
+  * @brief          : Header for tooth shape table tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Checks the fixed-point resampling of uploaded tooth waveforms, the shape
+  * text parser, the SHAPE commands and shaped host runs.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_SHAPE_H
+#define __TEST_SHAPE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define SHAPE_TEST_SAMPLES          200000  // Updates compared per RPM
+#define SHAPE_TEST_TOLERANCE_LSB    1       // Allowed difference from the reference resampler
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the tooth shape table tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_ToothShape(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_SHAPE_H */
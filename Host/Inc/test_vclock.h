@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file           : test_vclock.h
+  * @brief          : Header for variable clock output mode tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Plays one revolution through the TIM7-triggered DAC while DMA feeds
+  * TIM7 its reload table, and checks the sample timing and levels.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_VCLOCK_H
+#define __TEST_VCLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+  * @brief  Run the variable clock output mode tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Vclock(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TEST_VCLOCK_H */
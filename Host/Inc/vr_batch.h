@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file           : vr_batch.h
+  * @brief          : Header for the structure-of-arrays batch renderer
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Advances many independent sensors per step, one per vector lane, for
+  * Monte-Carlo studies. Tooth timing is exact against VR_Emu_*; levels are
+  * within 1 LSB of the scalar model at the nominal amplitude.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_BATCH_H
+#define __VR_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_BATCH_BLOCK              16      // Lanes per inner loop; capacity is rounded up to this
+
+/* Exported types ------------------------------------------------------------*/
+
+/* One array per state field, indexed by lane. Integer fields are 32-bit so
+   every array has the same lane width. */
+typedef struct {
+    uint32_t count;                 // Lanes in use
+    uint32_t capacity;              // Allocated lanes, multiple of VR_BATCH_BLOCK
+    uint32_t *tooth_timer;          // Phase: time into the current tooth (us)
+    uint32_t *sample_period;        // Increment: time per update (us)
+    uint32_t *tooth_period;         // Tooth period (us), 0 when stopped
+    uint32_t *tooth;                // Tooth index
+    float *amplitude;               // Sine amplitude, VR_AMPLITUDE_SCALE nominal
+    uint16_t *rpm;
+    uint16_t *output;               // DAC code after the last step
+} VR_Batch_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+bool VR_Batch_Init(VR_Batch_t *batch, uint32_t capacity);
+void VR_Batch_Free(VR_Batch_t *batch);
+int32_t VR_Batch_Add(VR_Batch_t *batch, uint16_t rpm, float amplitude);
+void VR_Batch_SetRPM(VR_Batch_t *batch, uint32_t lane, uint16_t rpm);
+void VR_Batch_Step(VR_Batch_t *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_BATCH_H */
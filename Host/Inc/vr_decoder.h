@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file           : vr_decoder.h
+  * @brief          : Header for the reference ECU-style crank decoder
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Decodes rendered DAC samples the way an ECU crank input would: tooth
+  * detection, tooth periods, missing-tooth sync and instantaneous RPM.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_DECODER_H
+#define __VR_DECODER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint16_t hysteresis_lsb;        // Deviation from baseline that arms a tooth
+    float gap_ratio;                // Gap shorter than ratio * previous gap = sync gap
+    float commanded_rpm;            // Reference for accuracy statistics (0 = none)
+} VR_DecoderConfig_t;
+
+typedef struct {
+    uint32_t teeth;                 // Tooth leading edges seen
+    uint32_t sync_gaps;             // Missing-tooth gaps found by the ratio test
+    uint32_t revolutions;           // Complete revolutions while in sync
+    uint32_t sync_losses;           // Gap found at the wrong tooth or not found
+    uint64_t first_sync_tick;       // Tick of the first sync, 0 if never synced
+    uint32_t tooth_samples;         // Tooth periods compared with commanded RPM
+    double tooth_err_max_pct;       // Worst single-tooth RPM error
+    double rev_err_sum_pct;         // Sum of per-revolution RPM errors
+    double rev_err_max_pct;         // Worst per-revolution RPM error
+} VR_DecoderStats_t;
+
+typedef struct {
+    VR_DecoderConfig_t config;
+    VR_DecoderStats_t stats;
+
+    /* Detector state */
+    float baseline;                 // Adaptive estimate of the no-tooth level
+    bool baseline_valid;
+    bool in_tooth;
+
+    /* Edge history (TIM6 ticks) */
+    uint64_t last_rise;
+    uint64_t last_fall;
+    uint64_t prev_gap;
+    uint64_t rev_start;
+    bool have_rise;
+    bool have_fall;
+
+    /* Sync state */
+    bool synced;
+    uint8_t tooth_index;            // Index of the tooth currently passing
+    float rpm;                      // Instantaneous RPM from the last tooth period
+} VR_Decoder_t;
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_DECODER_DEFAULT_HYSTERESIS   12
+#define VR_DECODER_DEFAULT_GAP_RATIO    0.75f
+
+/* Exported functions prototypes ---------------------------------------------*/
+void VR_Decoder_Init(VR_Decoder_t *dec, const VR_DecoderConfig_t *config);
+void VR_Decoder_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+double VR_Decoder_MeanRevErrorPct(const VR_Decoder_t *dec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_DECODER_H */
@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file           : vr_export.h
+  * @brief          : Header for streaming waveform export
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Writes the DAC output of the host simulator to 16-bit WAV, raw
+  * little-endian or CSV files at a fixed output sample rate.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_EXPORT_H
+#define __VR_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_EXPORT_WAV = 0,      // 16-bit signed PCM, mono, centred on mid-scale
+    VR_EXPORT_RAW,          // Raw DAC codes, uint16 little-endian
+    VR_EXPORT_CSV           // time_s,dac_code,voltage_v
+} VR_ExportFormat_t;
+
+typedef struct {
+    FILE *file;
+    VR_ExportFormat_t format;
+    uint32_t sample_rate;       // Output samples per second
+    uint64_t next_sample;       // Index of the next output sample
+    uint64_t data_bytes;        // Payload bytes written so far
+    uint8_t *buffer;            // Fixed-size staging buffer
+    size_t used;
+    bool error;
+} VR_Exporter_t;
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_EXPORT_BUFFER_SIZE       (4u * 1024u * 1024u)
+
+/* Exported functions prototypes ---------------------------------------------*/
+bool VR_Export_ParseFormat(const char *name, VR_ExportFormat_t *format);
+bool VR_Export_Open(VR_Exporter_t *ex, const char *path, VR_ExportFormat_t format, uint32_t sample_rate);
+void VR_Export_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+bool VR_Export_Close(VR_Exporter_t *ex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_EXPORT_H */
@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file           : vr_farm.h
+  * @brief          : Header for the multi-threaded simulation farm
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Renders a campaign of independent scenarios (RPM x pattern x fault x
+  * noise seed) on a work-stealing thread pool. Every scenario runs its own
+  * emulator instance through the reference decoder.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_FARM_H
+#define __VR_FARM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "vr_decoder.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_FARM_MAX_THREADS         64
+#define VR_FARM_ALL_PATTERNS        ((1u << VR_FARM_NUM_PATTERNS) - 1)
+#define VR_FARM_ALL_FAULTS          ((1u << VR_FARM_NUM_FAULTS) - 1)
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    VR_FARM_PATTERN_FIXED = 0,      // Constant RPM
+    VR_FARM_PATTERN_RAMP_UP,        // RPM/4 to RPM over the run
+    VR_FARM_PATTERN_RAMP_DOWN,      // RPM to RPM/4 over the run
+    VR_FARM_PATTERN_STOP_START,     // Stopped for 20%, ramp to RPM by 40%, hold
+    VR_FARM_NUM_PATTERNS
+} VR_FarmPattern_t;
+
+typedef enum {
+    VR_FARM_FAULT_NONE = 0,
+    VR_FARM_FAULT_DROPOUT,          // Output held at the DC offset for one revolution
+    VR_FARM_FAULT_SPIKE,            // One full-scale sample at mid-run
+    VR_FARM_NUM_FAULTS
+} VR_FarmFault_t;
+
+typedef struct {
+    uint16_t rpm;
+    VR_FarmPattern_t pattern;
+    VR_FarmFault_t fault;
+    uint32_t noise_seed;            // 0 = no noise
+    uint16_t noise_lsb;             // Peak additive noise
+    double duration_s;
+} VR_FarmScenario_t;
+
+/* Cross product that VR_Farm_BuildCampaign() expands */
+typedef struct {
+    uint16_t start_rpm;
+    uint16_t end_rpm;
+    uint16_t step_rpm;
+    uint32_t pattern_mask;          // Bit per VR_FarmPattern_t
+    uint32_t fault_mask;            // Bit per VR_FarmFault_t
+    uint32_t noise_seeds;           // Seeds per combination, 0 = noise-free only
+    uint16_t noise_lsb;
+    double duration_s;
+} VR_FarmCampaign_t;
+
+typedef struct {
+    uint64_t samples;               // DAC updates rendered
+    uint32_t checksum;              // FNV-1a over the faulted, noisy output
+    VR_DecoderStats_t decoder;
+    double wall_s;                  // Scenario wall time
+    uint32_t worker;                // Worker that ran the scenario
+} VR_FarmResult_t;
+
+typedef struct {
+    uint32_t executed;              // Scenarios run by this worker
+    uint32_t stolen;                // Of those, scenarios taken from other workers
+    uint32_t steals;                // Successful steal operations
+    double busy_s;                  // Time spent rendering
+} VR_FarmWorkerStats_t;
+
+typedef struct {
+    uint32_t threads;
+    uint32_t scenarios;
+    uint64_t samples;
+    uint32_t checksum;              // Combined in scenario order, independent of threads
+    double wall_s;
+    double busy_s;                  // Sum of scenario wall times
+    VR_FarmWorkerStats_t workers[VR_FARM_MAX_THREADS];
+} VR_FarmSummary_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+uint32_t VR_Farm_BuildCampaign(const VR_FarmCampaign_t *campaign, VR_FarmScenario_t *scenarios, uint32_t max);
+void VR_Farm_RunScenario(const VR_FarmScenario_t *scenario, VR_FarmResult_t *result);
+bool VR_Farm_Run(const VR_FarmScenario_t *scenarios, uint32_t count, uint32_t threads,
+                 VR_FarmResult_t *results, VR_FarmSummary_t *summary);
+uint32_t VR_Farm_DefaultThreads(void);
+const char *VR_Farm_PatternName(VR_FarmPattern_t pattern);
+const char *VR_Farm_FaultName(VR_FarmFault_t fault);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_FARM_H */
@@ -0,0 +1,92 @@
+/**
+  ******************************************************************************
+  * @file           : vr_host_sim.h
+  * @brief          : Header for the VR emulator host simulator
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Runs the unmodified emulator against a virtual TIM6 time base and
+  * reports every DAC level together with how long it was held.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_HOST_SIM_H
+#define __VR_HOST_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "vr_sensor_emulator.h"
+#include "vr_scenario.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_PROFILE_MAX_POINTS       256
+#define VR_HOST_CONTROL_PERIOD_TICKS 100    // 1 ms RPM update rate (TIM6 ticks)
+#define VR_HOST_CHUNK_TICKS         100000  // 1 s chunks for VR_HostSim_RunParallel()
+#define VR_HOST_MAX_THREADS         64
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    double time_s;
+    float rpm;                      // Negative turns the wheel backwards
+} VR_ProfilePoint_t;
+
+/* Piecewise-linear RPM profile, points sorted by time */
+typedef struct {
+    VR_ProfilePoint_t points[VR_PROFILE_MAX_POINTS];
+    uint32_t num_points;
+} VR_Profile_t;
+
+/* Position in a run: where the next held level starts and the state there */
+typedef struct {
+    VR_Emulator_t emu;              // Private, unbound instance
+    uint64_t tick;                  // Start of the next held level
+    uint64_t next_control;          // Tick of the next RPM update
+} VR_HostSimCursor_t;
+
+/**
+  * @brief  Receives one held DAC level
+  * @param  ctx: User context passed to VR_HostSim_Run()
+  * @param  dac_value: DAC code held on the output pin
+  * @param  start_tick: First TIM6 tick (10 us) the level is present
+  * @param  num_ticks: Number of ticks the level is held
+  * @retval None
+  */
+typedef void (*VR_SampleSink_t)(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+
+/* Exported functions prototypes ---------------------------------------------*/
+bool VR_Profile_Parse(VR_Profile_t *profile, const char *text);
+float VR_Profile_RPMAt(const VR_Profile_t *profile, double time_s);
+double VR_Profile_Duration(const VR_Profile_t *profile);
+
+bool VR_HostSim_SetShape(const VR_ToothShape_t *shape);
+bool VR_HostSim_LoadShape(VR_ToothShape_t *shape, const char *path);
+
+uint64_t VR_HostSim_Run(const VR_Profile_t *profile, uint64_t duration_ticks,
+                        uint32_t control_period_ticks, VR_SampleSink_t sink, void *ctx);
+uint64_t VR_HostSim_RunInstance(VR_Emulator_t *emu, const VR_Profile_t *profile, uint64_t duration_ticks,
+                                uint32_t control_period_ticks, VR_SampleSink_t sink, void *ctx);
+uint64_t VR_HostSim_RunScenario(VR_Emulator_t *emu, VR_Scenario_t *scenario, VR_SampleSink_t sink, void *ctx);
+
+void VR_HostSim_CursorInit(VR_HostSimCursor_t *cursor);
+void VR_HostSim_Seek(VR_HostSimCursor_t *cursor, const VR_Profile_t *profile, uint64_t target_tick,
+                     uint64_t duration_ticks, uint32_t control_period_ticks);
+uint64_t VR_HostSim_Render(VR_HostSimCursor_t *cursor, const VR_Profile_t *profile, uint64_t end_tick,
+                           uint64_t duration_ticks, uint32_t control_period_ticks,
+                           VR_SampleSink_t sink, void *ctx);
+uint64_t VR_HostSim_RunParallel(const VR_Profile_t *profile, uint64_t duration_ticks,
+                                uint32_t control_period_ticks, uint32_t threads, uint64_t chunk_ticks,
+                                VR_SampleSink_t sink, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_HOST_SIM_H */
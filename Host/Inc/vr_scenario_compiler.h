@@ -0,0 +1,48 @@
+/**
+  ******************************************************************************
+  * @file           : vr_scenario_compiler.h
+  * @brief          : Header for the scenario text compiler
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Compiles a scenario written as text, one event per line, into the
+  * sorted image the firmware plays (vr_scenario.h).
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __VR_SCENARIO_COMPILER_H
+#define __VR_SCENARIO_COMPILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "vr_scenario.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define VR_SCENARIO_TEXT_MAX        (256u * 1024u)  // Longest scenario file
+#define VR_SCENARIO_IMAGE_MAX       VR_SCENARIO_IMAGE_SIZE(VR_SCENARIO_MAX_EVENTS)
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t line;                  // Line of the error, 0 for the scenario as a whole
+    const char *message;
+} VR_ScenarioError_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+bool VR_Scenario_Compile(const char *text, uint32_t *image, uint32_t capacity, uint32_t *size,
+                         VR_ScenarioError_t *error);
+bool VR_Scenario_CompileFile(const char *path, uint32_t *image, uint32_t capacity, uint32_t *size,
+                             VR_ScenarioError_t *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_SCENARIO_COMPILER_H */
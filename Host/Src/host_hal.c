@@ -0,0 +1,1016 @@
+/**
+  ******************************************************************************
+  * @file           : host_hal.c
+  * @brief          : Host simulator stand-in for the STM32F7 HAL
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  * Implements the HAL calls used by the emulator against plain memory.
+  * Peripheral handles are initialised the same way MX_*_Init() does on
+  * target so the emulator starts from identical register values.
+  *
+  * TIM2 channel 4 is modelled in toggle mode: Host_TIM2_RunTo() walks the
+  * counter from compare match to compare match, toggles the PA3 level,
+  * performs the DMA load of the next compare value when CC4DE is set, and
+  * raises the half and full transfer callbacks as the DMA interrupt would.
+  * Channels 2 and 3 are input captures: Host_TIM2_Capture() latches the
+  * count and the DMA stores it into the armed circular buffer.
+  *
+  * With DAC channel 1 triggered by TIM6, Host_TIM6_Update() moves the
+  * held level to the output and DMA1 Stream5 loads the next halfword from
+  * the circular buffer, raising the DAC half and full transfer callbacks
+  * as the DMA interrupt would. Host_TIM7_Update() does the same for a
+  * TIM7-triggered channel, and DMA1 Stream2 then writes the next entry of
+  * its reload table to TIM7 ARR.
+  *
+  * Flash sectors 10 and 11 start erased. A program ANDs the data into the
+  * array, as a cell can only go from 1 to 0, and fails while the flash is
+  * locked or after the write limit: the words before the limit are kept,
+  * as after a power loss mid-write.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f7xx_hal.h"
+#include "vr_config.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define HOST_APB1_TIMER_CLOCK       108000000u  // TIM6 kernel clock (Hz)
+#define HOST_APB2_TIMER_CLOCK       216000000u  // TIM8 kernel clock (Hz)
+
+/* Private variables ---------------------------------------------------------*/
+static TIM_TypeDef host_tim2 = {0};
+static TIM_TypeDef host_tim6 = { .DIER = TIM_IT_UPDATE };
+static TIM_TypeDef host_tim7 = {0};
+static TIM_TypeDef host_tim8 = {0};
+
+ADC_HandleTypeDef hadc1 = {0};
+ADC_HandleTypeDef hadc2 = {0};
+DMA_HandleTypeDef hdma_dac1 = {0};
+DAC_HandleTypeDef hdac = { .DMA_Handle1 = &hdma_dac1 };
+DMA_HandleTypeDef hdma_tim2_ch2 = {0};
+DMA_HandleTypeDef hdma_tim2_ch3 = {0};
+DMA_HandleTypeDef hdma_tim2_ch4 = {0};
+DMA_HandleTypeDef hdma_tim7_up = {0};
+TIM_HandleTypeDef htim2 = {
+    .Instance = &host_tim2,
+    .Init = { .Prescaler = 0, .Period = 0xFFFFFFFFu },
+    .hdma = {
+        [TIM_DMA_ID_CC2] = &hdma_tim2_ch2,
+        [TIM_DMA_ID_CC3] = &hdma_tim2_ch3,
+        [TIM_DMA_ID_CC4] = &hdma_tim2_ch4
+    }
+};
+TIM_HandleTypeDef htim6 = { .Instance = &host_tim6, .Init = { .Prescaler = 1079, .Period = 999 } };
+TIM_HandleTypeDef htim7 = {
+    .Instance = &host_tim7,
+    .Init = { .Prescaler = 0, .Period = 0xFFFFu },
+    .hdma = { [TIM_DMA_ID_UPDATE] = &hdma_tim7_up }
+};
+TIM_HandleTypeDef htim8 = { .Instance = &host_tim8 };
+GPIO_TypeDef host_gpioa = {0};
+DWT_Type host_dwt = {0};
+CoreDebug_Type host_coredebug = {0};
+Host_Cache_t host_cache = {0};
+uint32_t SystemCoreClock = 216000000u;
+
+static uint32_t host_tick_ms = 0;
+static uint32_t host_tim2_ch4_level = 0;
+static Host_EdgeHook_t host_edge_hook = NULL;
+static void *host_edge_ctx = NULL;
+static Host_SleepHook_t host_sleep_hook = NULL;
+static void *host_sleep_ctx = NULL;
+static uint8_t host_flash[HOST_FLASH_SECTORS][HOST_FLASH_SECTOR_SIZE];
+static bool host_flash_ready = false;
+static bool host_flash_locked = true;
+static uint32_t host_flash_write_limit = UINT32_MAX;
+static uint32_t host_flash_erases[HOST_FLASH_SECTORS];
+
+/* Private function prototypes -----------------------------------------------*/
+static void Host_TIM2_SetLevel(uint32_t level);
+static void Host_DAC_Trigger(uint32_t trigger);
+static uint8_t *Host_Flash_Cell(uint32_t address, uint32_t size);
+static bool Host_TIM2_CaptureChannel(uint32_t Channel, uint16_t *dma_id, uint32_t *dier,
+                                     uint32_t *ccer, uint32_t *active);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Store a DAC data holding register value
+  * @param  hdac: DAC handle
+  * @param  Channel: DAC_CHANNEL_1 or DAC_CHANNEL_2
+  * @param  Alignment: Data alignment (only 12-bit right supported)
+  * @param  Data: Value to output
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DAC_SetValue(DAC_HandleTypeDef *hdac, uint32_t Channel,
+                                   uint32_t Alignment, uint32_t Data)
+{
+    (void)Alignment;
+
+    if (Channel == DAC_CHANNEL_1) {
+        hdac->DHR12R1 = Data & 0x0FFFU;
+    } else {
+        hdac->DHR12R2 = Data & 0x0FFFU;
+    }
+
+    return HAL_OK;
+}
+
+/**
+  * @brief  Select the channel 1 trigger
+  * @param  hdac: DAC handle
+  * @param  sConfig: DAC_TRIGGER_NONE, DAC_TRIGGER_T6_TRGO or DAC_TRIGGER_T7_TRGO
+  * @param  Channel: DAC_CHANNEL_1
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DAC_ConfigChannel(DAC_HandleTypeDef *hdac, DAC_ChannelConfTypeDef *sConfig, uint32_t Channel)
+{
+    if (Channel != DAC_CHANNEL_1) {
+        return HAL_ERROR;
+    }
+
+    hdac->trigger = sConfig->DAC_Trigger;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Enable a DAC channel (no-op on host)
+  * @param  hdac: DAC handle
+  * @param  Channel: DAC channel
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DAC_Start(DAC_HandleTypeDef *hdac, uint32_t Channel)
+{
+    (void)hdac;
+    (void)Channel;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Disable a DAC channel (no-op on host)
+  * @param  hdac: DAC handle
+  * @param  Channel: DAC channel
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DAC_Stop(DAC_HandleTypeDef *hdac, uint32_t Channel)
+{
+    (void)hdac;
+    (void)Channel;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Arm DMA to load channel 1 from a circular buffer at each trigger
+  * @param  hdac: DAC handle
+  * @param  Channel: DAC_CHANNEL_1
+  * @param  pData: Halfword levels
+  * @param  Length: Number of levels
+  * @param  Alignment: Data alignment (only 12-bit right supported)
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DAC_Start_DMA(DAC_HandleTypeDef *hdac, uint32_t Channel, uint32_t *pData,
+                                    uint32_t Length, uint32_t Alignment)
+{
+    (void)Alignment;
+
+    if (Channel != DAC_CHANNEL_1 || pData == NULL || Length < 2) {
+        return HAL_ERROR;
+    }
+
+    hdac->dma_buffer = (const uint16_t *)pData;
+    hdac->DMA_Handle1->length = Length;
+    hdac->DMA_Handle1->NDTR = Length;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop the channel 1 DMA; the output holds its level
+  * @param  hdac: DAC handle
+  * @param  Channel: DAC_CHANNEL_1
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DAC_Stop_DMA(DAC_HandleTypeDef *hdac, uint32_t Channel)
+{
+    if (Channel != DAC_CHANNEL_1) {
+        return HAL_ERROR;
+    }
+
+    HAL_DMA_Abort(hdac->DMA_Handle1);
+    hdac->dma_buffer = NULL;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop a DMA stream
+  * @param  hdma: DMA handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+    hdma->NDTR = 0;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Start an ADC conversion (no-op on host)
+  * @param  hadc: ADC handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc)
+{
+    (void)hadc;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop an ADC conversion (no-op on host)
+  * @param  hadc: ADC handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_ADC_Stop(ADC_HandleTypeDef *hadc)
+{
+    (void)hadc;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Wait for an ADC conversion (completes immediately on host)
+  * @param  hadc: ADC handle
+  * @param  Timeout: Unused
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef *hadc, uint32_t Timeout)
+{
+    (void)hadc;
+    (void)Timeout;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Return the simulated ADC reading
+  * @param  hadc: ADC handle
+  * @retval Value previously stored in hadc->value
+  */
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef *hadc)
+{
+    return hadc->value;
+}
+
+/**
+  * @brief  Arm a DMA conversion sequence
+  * @param  hadc: ADC handle
+  * @param  pData: Destination, filled with halfwords as on target
+  * @param  Length: Number of conversions
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+    hadc->dma_buffer = (uint16_t *)pData;
+    hadc->dma_length = Length;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Disarm a DMA conversion sequence
+  * @param  hadc: ADC handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc)
+{
+    hadc->dma_buffer = NULL;
+    hadc->dma_length = 0;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Start a timer
+  * @note   Starting TIM8 with ADC2 armed runs the whole capture in virtual
+  *         time: each TIM8 update converts the DAC channel 1 output, and
+  *         the TIM6 update events that fall in between are run by
+  *         Host_TIM6_Update() first. The transfer-complete
+  *         callback is raised at the end, as the DMA interrupt would.
+  * @param  htim: TIM handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+    if (htim != &htim8 || hadc2.dma_buffer == NULL) {
+        return HAL_OK;
+    }
+
+    // Time is counted in TIM8 kernel clock cycles
+    uint64_t sample_cycles = (uint64_t)htim8.Init.Period + 1;
+    uint64_t tim6_cycles_per_tick = (uint64_t)(HOST_APB2_TIMER_CLOCK / HOST_APB1_TIMER_CLOCK) *
+                                    (htim6.Init.Prescaler + 1);
+    uint64_t next_update = ((uint64_t)htim6.Init.Period + 1) * tim6_cycles_per_tick;
+    uint16_t *buffer = hadc2.dma_buffer;
+    uint32_t length = hadc2.dma_length;
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint64_t now = (i + 1) * sample_cycles;
+
+        while (next_update <= now) {
+            Host_TIM6_Update();
+            next_update += ((uint64_t)htim6.Init.Period + 1) * tim6_cycles_per_tick;
+        }
+        buffer[i] = (uint16_t)hdac.DHR12R1;
+    }
+
+    HAL_ADC_ConvCpltCallback(&hadc2);
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop a timer (no-op on host)
+  * @param  htim: TIM handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Start a timer with DMA writing ARR at every update
+  * @note   Only TIM7 is modelled; the table is used circularly and
+  *         Host_TIM7_Update() performs the transfers
+  * @param  htim: TIM handle
+  * @param  pData: Reload values
+  * @param  Length: Number of reload values
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_Base_Start_DMA(TIM_HandleTypeDef *htim, uint32_t *pData, uint16_t Length)
+{
+    DMA_HandleTypeDef *hdma = htim->hdma[TIM_DMA_ID_UPDATE];
+
+    if (htim != &htim7 || pData == NULL || Length == 0) {
+        return HAL_ERROR;
+    }
+
+    hdma->source = pData;
+    hdma->length = Length;
+    hdma->NDTR = Length;
+    htim->Instance->DIER |= TIM_DMA_UPDATE;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop a timer and its update DMA
+  * @param  htim: TIM handle
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_Base_Stop_DMA(TIM_HandleTypeDef *htim)
+{
+    if (htim != &htim7) {
+        return HAL_ERROR;
+    }
+
+    htim->Instance->DIER &= ~TIM_DMA_UPDATE;
+    HAL_DMA_Abort(htim->hdma[TIM_DMA_ID_UPDATE]);
+    htim->hdma[TIM_DMA_ID_UPDATE]->source = NULL;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Start TIM2 channel 4 output compare with DMA reloads
+  * @note   Only TIM2 channel 4 is modelled; the buffer is used circularly
+  * @param  htim: TIM handle
+  * @param  Channel: TIM_CHANNEL_4
+  * @param  pData: Compare values
+  * @param  Length: Number of compare values
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_OC_Start_DMA(TIM_HandleTypeDef *htim, uint32_t Channel, uint32_t *pData, uint16_t Length)
+{
+    DMA_HandleTypeDef *hdma = htim->hdma[TIM_DMA_ID_CC4];
+
+    if (htim != &htim2 || Channel != TIM_CHANNEL_4 || pData == NULL || Length < 2) {
+        return HAL_ERROR;
+    }
+
+    hdma->source = pData;
+    hdma->length = Length;
+    hdma->NDTR = Length;
+    htim->Instance->DIER |= TIM_DMA_CC4;
+    htim->Instance->CCER |= TIM_CCER_CC4E;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop TIM2 channel 4; the output returns to its inactive level
+  * @param  htim: TIM handle
+  * @param  Channel: TIM_CHANNEL_4
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_OC_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    if (htim != &htim2 || Channel != TIM_CHANNEL_4) {
+        return HAL_ERROR;
+    }
+
+    htim->Instance->DIER &= ~TIM_DMA_CC4;
+    htim->Instance->CCER &= ~TIM_CCER_CC4E;
+    htim->hdma[TIM_DMA_ID_CC4]->source = NULL;
+    Host_TIM2_SetLevel(0);
+    return HAL_OK;
+}
+
+/**
+  * @brief  Start TIM2 channel 2 or 3 input capture into a circular buffer
+  * @param  htim: TIM handle
+  * @param  Channel: TIM_CHANNEL_2 or TIM_CHANNEL_3
+  * @param  pData: Capture buffer
+  * @param  Length: Number of captures in the buffer
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_IC_Start_DMA(TIM_HandleTypeDef *htim, uint32_t Channel, uint32_t *pData, uint16_t Length)
+{
+    uint16_t dma_id;
+    uint32_t dier, ccer, active;
+
+    if (htim != &htim2 || !Host_TIM2_CaptureChannel(Channel, &dma_id, &dier, &ccer, &active) ||
+        pData == NULL || Length == 0) {
+        return HAL_ERROR;
+    }
+
+    DMA_HandleTypeDef *hdma = htim->hdma[dma_id];
+    hdma->dest = pData;
+    hdma->length = Length;
+    hdma->NDTR = Length;
+    htim->Instance->DIER |= dier;
+    htim->Instance->CCER |= ccer;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Stop TIM2 channel 2 or 3 input capture
+  * @param  htim: TIM handle
+  * @param  Channel: TIM_CHANNEL_2 or TIM_CHANNEL_3
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_TIM_IC_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    uint16_t dma_id;
+    uint32_t dier, ccer, active;
+
+    if (htim != &htim2 || !Host_TIM2_CaptureChannel(Channel, &dma_id, &dier, &ccer, &active)) {
+        return HAL_ERROR;
+    }
+
+    htim->Instance->DIER &= ~dier;
+    htim->Instance->CCER &= ~ccer;
+    htim->hdma[dma_id]->dest = NULL;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Input edge on TIM2 channel 2 or 3 at the current count
+  * @param  Channel: TIM_CHANNEL_2 or TIM_CHANNEL_3
+  * @retval None
+  */
+void Host_TIM2_Capture(uint32_t Channel)
+{
+    TIM_TypeDef *tim = htim2.Instance;
+    uint16_t dma_id;
+    uint32_t dier, ccer, active;
+
+    if (!Host_TIM2_CaptureChannel(Channel, &dma_id, &dier, &ccer, &active) || !(tim->CCER & ccer)) {
+        return;
+    }
+
+    if (Channel == TIM_CHANNEL_2) {
+        tim->CCR2 = tim->CNT;
+    } else {
+        tim->CCR3 = tim->CNT;
+    }
+
+    DMA_HandleTypeDef *hdma = htim2.hdma[dma_id];
+    if ((tim->DIER & dier) && hdma->dest != NULL) {
+        hdma->dest[hdma->length - hdma->NDTR] = tim->CNT;
+        if (--hdma->NDTR == 0) {
+            hdma->NDTR = hdma->length;
+            htim2.Channel = active;
+            HAL_TIM_IC_CaptureCallback(&htim2);
+            htim2.Channel = 0;
+        }
+    }
+}
+
+/**
+  * @brief  Read an input pin
+  * @param  GPIOx: GPIO port
+  * @param  GPIO_Pin: Pin mask
+  * @retval PA3 follows TIM2 channel 4; every other pin reads low
+  */
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    if (GPIOx == GPIOA && GPIO_Pin == GPIO_PIN_3) {
+        return host_tim2_ch4_level ? GPIO_PIN_SET : GPIO_PIN_RESET;
+    }
+    return GPIO_PIN_RESET;
+}
+
+/**
+  * @brief  Advance TIM2 to a count, handling every channel 4 compare match
+  * @param  count: Target count; at most 2^32 - 1 ticks ahead
+  * @retval None
+  */
+void Host_TIM2_RunTo(uint32_t count)
+{
+    TIM_TypeDef *tim = htim2.Instance;
+    DMA_HandleTypeDef *hdma = htim2.hdma[TIM_DMA_ID_CC4];
+
+    for (;;) {
+        // The counter matches CCR4 only when it arrives there
+        uint32_t to_match = tim->CCR4 - tim->CNT;
+        if (to_match == 0 || to_match > count - tim->CNT) {
+            break;
+        }
+
+        tim->CNT = tim->CCR4;
+        if (tim->CCER & TIM_CCER_CC4E) {
+            Host_TIM2_SetLevel(!host_tim2_ch4_level);
+        }
+
+        if ((tim->DIER & TIM_DMA_CC4) && hdma->source != NULL) {
+            tim->CCR4 = hdma->source[hdma->length - hdma->NDTR];
+            if (--hdma->NDTR == hdma->length / 2) {
+                htim2.Channel = HAL_TIM_ACTIVE_CHANNEL_4;
+                HAL_TIM_PWM_PulseFinishedHalfCpltCallback(&htim2);
+                htim2.Channel = 0;
+            } else if (hdma->NDTR == 0) {
+                hdma->NDTR = hdma->length;
+                htim2.Channel = HAL_TIM_ACTIVE_CHANNEL_4;
+                HAL_TIM_PWM_PulseFinishedCallback(&htim2);
+                htim2.Channel = 0;
+            }
+        }
+    }
+
+    tim->CNT = count;
+}
+
+/**
+  * @brief  Run one TIM6 update event
+  * @note   A TIM6-triggered DAC channel 1 outputs the level DMA loaded at
+  *         the previous trigger, and DMA loads the next one. The update
+  *         interrupt follows if UIE is set.
+  * @retval None
+  */
+void Host_TIM6_Update(void)
+{
+    Host_DAC_Trigger(DAC_TRIGGER_T6_TRGO);
+
+    if (htim6.Instance->DIER & TIM_IT_UPDATE) {
+        HAL_TIM_PeriodElapsedCallback(&htim6);
+    }
+}
+
+/**
+  * @brief  Run one TIM7 update event
+  * @note   A TIM7-triggered DAC channel 1 steps as in Host_TIM6_Update().
+  *         With UDE set, DMA then writes the next table entry to ARR,
+  *         which sets the length of the period starting now as preload
+  *         is off.
+  * @retval None
+  */
+void Host_TIM7_Update(void)
+{
+    DMA_HandleTypeDef *hdma = htim7.hdma[TIM_DMA_ID_UPDATE];
+
+    Host_DAC_Trigger(DAC_TRIGGER_T7_TRGO);
+
+    if ((htim7.Instance->DIER & TIM_DMA_UPDATE) && hdma->source != NULL && hdma->NDTR != 0) {
+        htim7.Init.Period = hdma->source[hdma->length - hdma->NDTR];
+        if (--hdma->NDTR == 0) {
+            hdma->NDTR = hdma->length;
+        }
+    }
+}
+
+/**
+  * @brief  Report TIM2 channel 4 output changes
+  * @param  hook: Called at every edge, NULL to stop reporting
+  * @param  ctx: Passed to the hook
+  * @retval None
+  */
+void Host_TIM2_SetEdgeHook(Host_EdgeHook_t hook, void *ctx)
+{
+    host_edge_hook = hook;
+    host_edge_ctx = ctx;
+}
+
+/**
+  * @brief  Capture DMA transfer complete callback, overridden by the application
+  * @param  htim: TIM handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+}
+
+/**
+  * @brief  Compare DMA half transfer callback, overridden by the application
+  * @param  htim: TIM handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+}
+
+/**
+  * @brief  Compare DMA transfer complete callback, overridden by the application
+  * @param  htim: TIM handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+}
+
+/**
+  * @brief  Conversion sequence complete callback, overridden by the application
+  * @param  hadc: ADC handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    (void)hadc;
+}
+
+/**
+  * @brief  DAC DMA half transfer callback, overridden by the application
+  * @param  hdac: DAC handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_DAC_ConvHalfCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+}
+
+/**
+  * @brief  DAC DMA transfer complete callback, overridden by the application
+  * @param  hdac: DAC handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_DAC_ConvCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+}
+
+/**
+  * @brief  DAC DMA underrun callback, overridden by the application
+  * @note   The host DMA never falls behind; tests call it directly
+  * @param  hdac: DAC handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_DAC_DMAUnderrunCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+}
+
+/**
+  * @brief  Timer update callback, overridden by the application
+  * @param  htim: TIM handle
+  * @retval None
+  */
+__attribute__((weak)) void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+}
+
+/**
+  * @brief  Return the virtual millisecond tick
+  * @retval Tick value in milliseconds
+  */
+uint32_t HAL_GetTick(void)
+{
+    return host_tick_ms;
+}
+
+/**
+  * @brief  Advance the virtual millisecond tick without sleeping
+  * @param  Delay: Delay in milliseconds
+  * @retval None
+  */
+void HAL_Delay(uint32_t Delay)
+{
+    host_tick_ms += Delay;
+}
+
+/**
+  * @brief  Wait for interrupt: run the sleep hook in its place
+  * @note   Without a hook nothing can wake the core; the host stops
+  * @retval None
+  */
+void __WFI(void)
+{
+    if (host_sleep_hook == NULL) {
+        fprintf(stderr, "host: WFI with no sleep hook\n");
+        abort();
+    }
+    host_sleep_hook(host_sleep_ctx);
+}
+
+/**
+  * @brief  Set the code run in place of each WFI sleep
+  * @param  hook: Called by __WFI(), NULL to remove
+  * @param  ctx: Passed to the hook
+  * @retval None
+  */
+void Host_SetSleepHook(Host_SleepHook_t hook, void *ctx)
+{
+    host_sleep_hook = hook;
+    host_sleep_ctx = ctx;
+}
+
+/**
+  * @brief  Record that the MPU was disabled
+  * @retval None
+  */
+void HAL_MPU_Disable(void)
+{
+    host_cache.mpu_control = 0;
+}
+
+/**
+  * @brief  Record that the MPU was enabled
+  * @param  MPU_Control: Background region and fault handling control
+  * @retval None
+  */
+void HAL_MPU_Enable(uint32_t MPU_Control)
+{
+    host_cache.mpu_control = MPU_Control | 1u;
+}
+
+/**
+  * @brief  Record an MPU region
+  * @param  MPU_Init: Region configuration
+  * @retval None
+  */
+void HAL_MPU_ConfigRegion(MPU_Region_InitTypeDef *MPU_Init)
+{
+    host_cache.region = *MPU_Init;
+}
+
+/**
+  * @brief  Record that the instruction cache was enabled
+  * @retval None
+  */
+void SCB_EnableICache(void)
+{
+    host_cache.icache_enabled = 1;
+}
+
+/**
+  * @brief  Record that the data cache was enabled
+  * @retval None
+  */
+void SCB_EnableDCache(void)
+{
+    host_cache.dcache_enabled = 1;
+}
+
+/**
+  * @brief  Record a data cache clean
+  * @param  addr: Start address
+  * @param  dsize: Size in bytes
+  * @retval None
+  */
+void SCB_CleanDCache_by_Addr(uint32_t *addr, int32_t dsize)
+{
+    host_cache.clean_calls++;
+    host_cache.clean_addr = (uintptr_t)addr;
+    host_cache.clean_size = dsize;
+}
+
+/**
+  * @brief  Record a data cache invalidate
+  * @param  addr: Start address
+  * @param  dsize: Size in bytes
+  * @retval None
+  */
+void SCB_InvalidateDCache_by_Addr(uint32_t *addr, int32_t dsize)
+{
+    host_cache.invalidate_calls++;
+    host_cache.invalidate_addr = (uintptr_t)addr;
+    host_cache.invalidate_size = dsize;
+}
+
+/**
+  * @brief  Allow flash program and erase
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    host_flash_locked = false;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Refuse flash program and erase
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    host_flash_locked = true;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Program a byte, half-word, word or double word of sector 10 or 11
+  * @param  TypeProgram: FLASH_TYPEPROGRAM_BYTE to _DOUBLEWORD
+  * @param  Address: Flash address
+  * @param  Data: Value, ANDed into the cells
+  * @retval HAL_ERROR while locked or past the write limit
+  */
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+    uint32_t size = 1u << TypeProgram;
+    uint8_t *cell = Host_Flash_Cell(Address, size);
+
+    if (host_flash_locked || host_flash_write_limit == 0) {
+        return HAL_ERROR;
+    }
+    if (host_flash_write_limit != UINT32_MAX) {
+        host_flash_write_limit--;
+    }
+
+    for (uint32_t i = 0; i < size; i++) {
+        cell[i] &= (uint8_t)(Data >> (8u * i));
+    }
+    return HAL_OK;
+}
+
+/**
+  * @brief  Erase sector 10 or 11
+  * @param  pEraseInit: One sector, FLASH_TYPEERASE_SECTORS
+  * @param  SectorError: Set to 0xFFFFFFFF on success, else the sector
+  * @retval HAL status
+  */
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+    *SectorError = pEraseInit->Sector;
+    if (host_flash_locked || pEraseInit->TypeErase != FLASH_TYPEERASE_SECTORS) {
+        return HAL_ERROR;
+    }
+
+    for (uint32_t n = 0; n < pEraseInit->NbSectors; n++) {
+        uint32_t sector = pEraseInit->Sector + n;
+        uint8_t *cell = Host_Flash_Cell(VR_CONFIG_SECTOR_ADDRESS(sector), HOST_FLASH_SECTOR_SIZE);
+
+        memset(cell, 0xFF, HOST_FLASH_SECTOR_SIZE);
+        host_flash_erases[sector - FLASH_SECTOR_10]++;
+    }
+    *SectorError = 0xFFFFFFFFu;
+    return HAL_OK;
+}
+
+/**
+  * @brief  Map a flash address in sector 10 or 11 for reading
+  * @param  address: Flash address
+  * @retval Host pointer to the cell
+  */
+const uint8_t *Host_Flash_Map(uint32_t address)
+{
+    return Host_Flash_Cell(address, 1);
+}
+
+/**
+  * @brief  Erase both sectors, clear the erase counts and the write limit
+  * @retval None
+  */
+void Host_Flash_Reset(void)
+{
+    memset(host_flash, 0xFF, sizeof(host_flash));
+    memset(host_flash_erases, 0, sizeof(host_flash_erases));
+    host_flash_ready = true;
+    host_flash_write_limit = UINT32_MAX;
+}
+
+/**
+  * @brief  Cut the power after a number of programs
+  * @param  words: Programs that still succeed, UINT32_MAX for no limit
+  * @retval None
+  */
+void Host_Flash_SetWriteLimit(uint32_t words)
+{
+    host_flash_write_limit = words;
+}
+
+/**
+  * @brief  Erases of one sector since Host_Flash_Reset()
+  * @param  sector: FLASH_SECTOR_10 or FLASH_SECTOR_11
+  * @retval Erase count
+  */
+uint32_t Host_Flash_GetErases(uint32_t sector)
+{
+    return host_flash_erases[sector - FLASH_SECTOR_10];
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Locate flash cells in the host array
+  * @note   An access outside sectors 10 and 11 stops the host
+  * @param  address: Flash address
+  * @param  size: Bytes accessed
+  * @retval Host pointer to the first cell
+  */
+static uint8_t *Host_Flash_Cell(uint32_t address, uint32_t size)
+{
+    if (!host_flash_ready) {
+        memset(host_flash, 0xFF, sizeof(host_flash));
+        host_flash_ready = true;
+    }
+    if (address < VR_CONFIG_BASE || size > sizeof(host_flash)
+        || address - VR_CONFIG_BASE > sizeof(host_flash) - size) {
+        fprintf(stderr, "host: flash access at 0x%08lx outside sectors 10 and 11\n",
+                (unsigned long)address);
+        abort();
+    }
+    return &host_flash[0][0] + (address - VR_CONFIG_BASE);
+}
+
+/**
+  * @brief  Step a DMA-fed DAC channel 1 on a timer trigger
+  * @note   The level DMA loaded at the previous trigger is output and the
+  *         next one loaded, raising the half and full transfer callbacks
+  *         as the DMA interrupt would
+  * @param  trigger: Trigger the update event drives
+  * @retval None
+  */
+static void Host_DAC_Trigger(uint32_t trigger)
+{
+    DMA_HandleTypeDef *hdma = hdac.DMA_Handle1;
+
+    if (hdac.trigger != trigger) {
+        return;
+    }
+
+    hdac.DHR12R1 = hdac.dma_hold;
+    if (hdac.dma_buffer != NULL && hdma->NDTR != 0) {
+        hdac.dma_hold = hdac.dma_buffer[hdma->length - hdma->NDTR] & 0x0FFFU;
+        if (--hdma->NDTR == hdma->length / 2) {
+            HAL_DAC_ConvHalfCpltCallbackCh1(&hdac);
+        } else if (hdma->NDTR == 0) {
+            hdma->NDTR = hdma->length;
+            HAL_DAC_ConvCpltCallbackCh1(&hdac);
+        }
+    }
+}
+
+/**
+  * @brief  Drive the PA3 level and report a change
+  * @param  level: New level
+  * @retval None
+  */
+static void Host_TIM2_SetLevel(uint32_t level)
+{
+    if (level != host_tim2_ch4_level) {
+        host_tim2_ch4_level = level;
+        if (host_edge_hook != NULL) {
+            host_edge_hook(host_edge_ctx, htim2.Instance->CNT, level);
+        }
+    }
+}
+
+/**
+  * @brief  Register bits of a TIM2 capture channel
+  * @param  Channel: TIM_CHANNEL_2 or TIM_CHANNEL_3
+  * @param  dma_id: DMA handle index
+  * @param  dier: DMA request enable bit
+  * @param  ccer: Capture enable bit
+  * @param  active: HAL_TIM_ACTIVE_CHANNEL_x for callbacks
+  * @retval False for any other channel
+  */
+static bool Host_TIM2_CaptureChannel(uint32_t Channel, uint16_t *dma_id, uint32_t *dier,
+                                     uint32_t *ccer, uint32_t *active)
+{
+    switch (Channel) {
+    case TIM_CHANNEL_2:
+        *dma_id = TIM_DMA_ID_CC2;
+        *dier = TIM_DMA_CC2;
+        *ccer = TIM_CCER_CC2E;
+        *active = HAL_TIM_ACTIVE_CHANNEL_2;
+        return true;
+    case TIM_CHANNEL_3:
+        *dma_id = TIM_DMA_ID_CC3;
+        *dier = TIM_DMA_CC3;
+        *ccer = TIM_CCER_CC3E;
+        *active = HAL_TIM_ACTIVE_CHANNEL_3;
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,223 @@
+/**
+  ******************************************************************************
+  * @file           : test_batch.c
+  * @brief          : Batch renderer tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * BATCH_TEST_LANES sensors are rendered by one batch and by as many scalar
+  * instances, with RPMs over the whole range, some lanes stopped, and RPM
+  * changes (including stop and restart) half way. At every update the
+  * tooth index and tooth timer must match exactly and the level within
+  * 1 LSB. Levels that differ at all must stay rare.
+  *
+  * Lanes with zero amplitude must sit at the DC offset, and a full batch
+  * must refuse further sensors.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_batch.h"
+#include "test_host.h"
+#include "vr_batch.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BATCH_STOPPED_EVERY         50      // Every 50th lane starts stopped
+#define BATCH_CHANGE_STEP           (BATCH_TEST_STEPS / 2)
+
+/* Private function prototypes -----------------------------------------------*/
+static uint16_t Batch_RPMFor(uint32_t lane);
+static uint16_t Batch_ChangedRPMFor(uint32_t lane);
+static bool Batch_TestLockstep(void);
+static bool Batch_TestAmplitude(void);
+static bool Batch_TestCapacity(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the batch renderer tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Batch(void)
+{
+    TestResults_t results = {0};
+    bool (*const tests[])(void) = {Batch_TestLockstep, Batch_TestAmplitude, Batch_TestCapacity};
+
+    printf("Testing batch renderer, %d lanes x %d updates...\n", BATCH_TEST_LANES, BATCH_TEST_STEPS);
+
+    for (uint32_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        VR_Test_Record(&results, tests[i]());
+    }
+
+    return VR_Test_Report(&results, "Batch renderer");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Starting RPM of a lane
+  * @param  lane: Lane index
+  * @retval RPM (0 for every BATCH_STOPPED_EVERY-th lane)
+  */
+static uint16_t Batch_RPMFor(uint32_t lane)
+{
+    return (lane % BATCH_STOPPED_EVERY == 0) ? 0 : (uint16_t)(1 + (lane * 7919u) % MAX_RPM);
+}
+
+/**
+  * @brief  RPM of a lane after the mid-run change
+  * @param  lane: Lane index
+  * @retval RPM; stopped lanes restart and some running lanes stop
+  */
+static uint16_t Batch_ChangedRPMFor(uint32_t lane)
+{
+    if (lane % BATCH_STOPPED_EVERY == 0) {
+        return (uint16_t)(100 + lane % MAX_RPM);
+    }
+    return (lane % 7 == 0) ? 0 : (uint16_t)(1 + (lane * 104729u) % MAX_RPM);
+}
+
+/**
+  * @brief  Step a batch and scalar instances side by side
+  * @retval True if timing matches exactly and levels within 1 LSB
+  */
+static bool Batch_TestLockstep(void)
+{
+    VR_Emulator_t *emus = malloc(BATCH_TEST_LANES * sizeof(*emus));
+    VR_Batch_t batch;
+    uint64_t compared = 0, off_by_one = 0;
+    bool ok = true;
+
+    if (emus == NULL || !VR_Batch_Init(&batch, BATCH_TEST_LANES)) {
+        printf("TEST FAILED: batch lockstep: out of memory\n");
+        free(emus);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < BATCH_TEST_LANES; i++) {
+        VR_Emu_Init(&emus[i], NULL);
+        VR_Emu_SetRPM(&emus[i], Batch_RPMFor(i));
+        VR_Batch_Add(&batch, Batch_RPMFor(i), VR_AMPLITUDE_SCALE);
+    }
+
+    for (uint32_t step = 0; step < BATCH_TEST_STEPS && ok; step++) {
+        if (step == BATCH_CHANGE_STEP) {
+            for (uint32_t i = 0; i < BATCH_TEST_LANES; i++) {
+                VR_Emu_SetRPM(&emus[i], Batch_ChangedRPMFor(i));
+                VR_Batch_SetRPM(&batch, i, Batch_ChangedRPMFor(i));
+            }
+        }
+
+        VR_Batch_Step(&batch);
+        for (uint32_t i = 0; i < BATCH_TEST_LANES; i++) {
+            const VR_SensorState_t *state = &emus[i].state;
+            int32_t diff;
+
+            VR_Emu_TimerCallback(&emus[i]);
+            diff = (int32_t)batch.output[i] - (int32_t)state->dac_output;
+
+            if (batch.tooth[i] != state->current_tooth || batch.tooth_timer[i] != state->tooth_timer) {
+                printf("TEST FAILED: batch lockstep: lane %lu timing at update %lu "
+                       "(expected tooth %u +%lu us, got %lu +%lu us)\n",
+                       (unsigned long)i, (unsigned long)step, state->current_tooth,
+                       (unsigned long)state->tooth_timer, (unsigned long)batch.tooth[i],
+                       (unsigned long)batch.tooth_timer[i]);
+                ok = false;
+                break;
+            }
+            if (diff < -1 || diff > 1) {
+                printf("TEST FAILED: batch lockstep: lane %lu level at update %lu (expected %u, got %u)\n",
+                       (unsigned long)i, (unsigned long)step, state->dac_output, batch.output[i]);
+                ok = false;
+                break;
+            }
+            off_by_one += (diff != 0);
+            compared++;
+        }
+    }
+
+    double off_pct = (compared > 0) ? 100.0 * off_by_one / compared : 0.0;
+
+    if (ok) {
+        printf("  %llu levels compared, %llu (%.4f%%) 1 LSB off\n",
+               (unsigned long long)compared, (unsigned long long)off_by_one, off_pct);
+        if (off_pct > BATCH_TEST_MAX_OFF_PCT) {
+            printf("TEST FAILED: batch lockstep: %.4f%% of levels off by 1 LSB (limit %.2f%%)\n",
+                   off_pct, BATCH_TEST_MAX_OFF_PCT);
+            ok = false;
+        }
+    }
+
+    VR_Batch_Free(&batch);
+    free(emus);
+    return ok;
+}
+
+/**
+  * @brief  Lanes with zero amplitude hold the DC offset
+  * @retval True if every level of a silent lane is the DC code
+  */
+static bool Batch_TestAmplitude(void)
+{
+    const uint16_t dc = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+    VR_Batch_t batch;
+    bool ok = true;
+
+    if (!VR_Batch_Init(&batch, 2)) {
+        printf("TEST FAILED: batch amplitude: out of memory\n");
+        return false;
+    }
+    VR_Batch_Add(&batch, 6000, 0.0f);
+    VR_Batch_Add(&batch, 6000, VR_AMPLITUDE_SCALE);
+
+    for (uint32_t step = 0; step < BATCH_TEST_STEPS && ok; step++) {
+        VR_Batch_Step(&batch);
+        if (batch.output[0] != dc) {
+            printf("TEST FAILED: batch amplitude: silent lane at %u on update %lu\n",
+                   batch.output[0], (unsigned long)step);
+            ok = false;
+        }
+        if (batch.tooth[0] != batch.tooth[1] || batch.tooth_timer[0] != batch.tooth_timer[1]) {
+            printf("TEST FAILED: batch amplitude: amplitude changed timing on update %lu\n",
+                   (unsigned long)step);
+            ok = false;
+        }
+    }
+
+    VR_Batch_Free(&batch);
+    return ok;
+}
+
+/**
+  * @brief  A full batch refuses further sensors
+  * @retval True if capacity is rounded up to whole blocks and then enforced
+  */
+static bool Batch_TestCapacity(void)
+{
+    VR_Batch_t batch;
+    bool ok;
+
+    if (!VR_Batch_Init(&batch, 1)) {
+        printf("TEST FAILED: batch capacity: out of memory\n");
+        return false;
+    }
+
+    ok = (batch.capacity == VR_BATCH_BLOCK);
+    for (uint32_t i = 0; i < VR_BATCH_BLOCK && ok; i++) {
+        ok = (VR_Batch_Add(&batch, 1000, VR_AMPLITUDE_SCALE) == (int32_t)i);
+    }
+    ok = ok && (VR_Batch_Add(&batch, 1000, VR_AMPLITUDE_SCALE) == -1) && (batch.count == VR_BATCH_BLOCK);
+    if (!ok) {
+        printf("TEST FAILED: batch capacity: %lu lanes of %lu accepted\n",
+               (unsigned long)batch.count, (unsigned long)batch.capacity);
+    }
+
+    VR_Batch_Free(&batch);
+    return ok;
+}
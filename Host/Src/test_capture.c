@@ -0,0 +1,567 @@
+/**
+  ******************************************************************************
+  * @file           : test_capture.c
+  * @brief          : ECU timing capture tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * A model ECU watches the digital crank output, as a Hall input would. It
+  * finds the cycle tooth from the wide tooth and the rise count, measures
+  * the tooth period between rises, and schedules each ignition and
+  * injection event one tooth ahead at a fixed cycle angle. When an event is
+  * due, TIM2 runs to its time and the channel captures it. The emulator and
+  * the capture module know nothing of the model ECU.
+  *
+  * Checks:
+  * - At steady 1500, 6000 and MAX_RPM, every event is captured and each
+  *   cylinder's advance is within CAPTURE_TEST_TOLERANCE_DEG of the
+  *   scheduled value, across the TIM2 wrap.
+  * - Captures left in the ring past its size are counted as overruns.
+  * - Captures while the wheel is stopped are counted as unsynced.
+  * - Angle conversion and cylinder assignment on fixed inputs.
+  * - The telemetry text carries the counters and the advance.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_capture.h"
+#include "test_host.h"
+#include "vr_ecu_capture.h"
+#include "vr_digital_output.h"
+#include "vr_sensor_emulator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+
+/* Private define ------------------------------------------------------------*/
+#define CAPTURE_CONTROL_TICKS       (1000u * VR_DIGITAL_TICKS_PER_US)   // 1 ms set point rate
+#define CAPTURE_PROCESS_MS          10      // Main loop processing interval
+#define CAPTURE_DRAIN_MS            10      // Run after the last event is scheduled
+#define CAPTURE_CYLINDERS           4
+#define CAPTURE_TDC_DEG             90.0f
+#define CAPTURE_PITCH_DEG           (360.0f / TRIGGER_WHEEL_TEETH)
+#define CAPTURE_CYCLE_TEETH         (2u * TRIGGER_WHEEL_TEETH)
+#define CAPTURE_MAX_PENDING         16
+#define CAPTURE_MIN_EVENTS          3       // Fewest events per cylinder a segment must produce
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint16_t rpm;
+    uint32_t settle_ms;             // Run before the statistics are cleared
+    uint32_t measure_ms;
+} CaptureSegment_t;
+
+typedef struct {
+    uint32_t time;                  // TIM2 count
+    uint8_t channel;                // VR_CaptureChannel_t
+    uint8_t cylinder;
+} CaptureEvent_t;
+
+typedef struct {
+    float angle[VR_CAPTURE_CHANNELS][CAPTURE_CYLINDERS];   // Cycle angle of each event
+    CaptureEvent_t pending[CAPTURE_MAX_PENDING];
+    uint32_t num_pending;
+    CaptureEvent_t *log;            // Events fired since the statistics were cleared
+    uint32_t num_log;
+    uint32_t prev_rise;
+    uint32_t last_fall;
+    uint8_t tooth;                  // Cycle tooth of the last rise
+    bool started;
+    bool armed;                     // Schedule new events
+    uint32_t slips;                 // Wide teeth found at the wrong count since the statistics were cleared
+    bool overflow;
+    uint32_t sample;                // TIM2 count of the last TIM6 sample
+    uint64_t elapsed;
+} CaptureEcu_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const CaptureSegment_t capture_profile[] = {
+    {1500, 50, 400},
+    {6000, 30, 300},
+    {MAX_RPM, 30, 300},
+};
+
+/* Degrees before TDC, firing order; cylinder 4 fires after TDC */
+static const float capture_ign_advance[CAPTURE_CYLINDERS] = {10.0f, 25.5f, 0.5f, -5.0f};
+static const float capture_inj_advance[CAPTURE_CYLINDERS] = {120.0f, 135.0f, 100.25f, 140.0f};
+
+/* Private function prototypes -----------------------------------------------*/
+static void Capture_Run(CaptureEcu_t *ecu, uint32_t ms);
+static void Capture_FireUntil(CaptureEcu_t *ecu, uint32_t target);
+static void Capture_Inject(uint32_t count, VR_CaptureChannel_t channel);
+static void Capture_OnEdge(void *ctx, uint32_t count, uint32_t level);
+static void Capture_Schedule(CaptureEcu_t *ecu, uint32_t rise, uint32_t period);
+static void Capture_ClearStats(CaptureEcu_t *ecu);
+static bool Capture_CheckSegment(const CaptureEcu_t *ecu, uint16_t rpm);
+static bool Capture_TestTelemetry(void);
+static bool Capture_TestOverrun(CaptureEcu_t *ecu);
+static bool Capture_TestStopped(CaptureEcu_t *ecu);
+static bool Capture_TestAngle(void);
+static bool Capture_TestAssign(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the ECU timing capture tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_EcuCapture(void)
+{
+    TestResults_t results = {0};
+    CaptureEcu_t ecu;
+
+    printf("Testing ECU timing capture against a model ECU...\n");
+
+    memset(&ecu, 0, sizeof(ecu));
+    ecu.log = malloc(CAPTURE_TEST_MAX_EVENTS * sizeof(CaptureEvent_t));
+    if (ecu.log == NULL) {
+        printf("TEST FAILED: ECU capture run: out of memory\n");
+        VR_Test_Record(&results, false);
+        return VR_Test_Report(&results, "ECU capture");
+    }
+
+    for (uint32_t cyl = 0; cyl < CAPTURE_CYLINDERS; cyl++) {
+        float tdc = CAPTURE_TDC_DEG + (float)cyl * VR_CAPTURE_CYCLE_DEG / CAPTURE_CYLINDERS;
+        ecu.angle[VR_CAPTURE_IGNITION][cyl] = fmodf(tdc - capture_ign_advance[cyl] + VR_CAPTURE_CYCLE_DEG,
+                                                    VR_CAPTURE_CYCLE_DEG);
+        ecu.angle[VR_CAPTURE_INJECTION][cyl] = fmodf(tdc - capture_inj_advance[cyl] + VR_CAPTURE_CYCLE_DEG,
+                                                     VR_CAPTURE_CYCLE_DEG);
+    }
+
+    VR_Test_ResetDefault();
+    ecu.sample = 0u - CAPTURE_TEST_WRAP_MS * CAPTURE_CONTROL_TICKS;
+    htim2.Instance->CNT = ecu.sample;
+    Host_TIM2_SetEdgeHook(Capture_OnEdge, &ecu);
+    VR_Digital_Start();
+    VR_Capture_Start();
+    VR_Capture_Configure(CAPTURE_CYLINDERS, CAPTURE_TDC_DEG);
+
+    for (uint32_t s = 0; s < sizeof(capture_profile) / sizeof(capture_profile[0]); s++) {
+        const CaptureSegment_t *seg = &capture_profile[s];
+
+        VR_Emulator_SetRPM(seg->rpm);
+        ecu.armed = true;
+        Capture_Run(&ecu, seg->settle_ms);
+        Capture_ClearStats(&ecu);
+        Capture_Run(&ecu, seg->measure_ms);
+
+        // Let every scheduled event fire and be converted
+        ecu.armed = false;
+        Capture_Run(&ecu, CAPTURE_DRAIN_MS);
+        VR_Capture_Process();
+
+        VR_Test_Record(&results, !ecu.overflow && Capture_CheckSegment(&ecu, seg->rpm));
+    }
+
+    VR_Test_Record(&results, Capture_TestTelemetry());
+    VR_Test_Record(&results, Capture_TestOverrun(&ecu));
+    VR_Test_Record(&results, Capture_TestStopped(&ecu));
+    VR_Test_Record(&results, Capture_TestAngle());
+    VR_Test_Record(&results, Capture_TestAssign());
+
+    VR_Capture_Stop();
+    VR_Digital_Stop();
+    Host_TIM2_SetEdgeHook(NULL, NULL);
+    free(ecu.log);
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "ECU capture");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Run the emulator in virtual time, firing due ECU events
+  * @note   The capture module is processed every CAPTURE_PROCESS_MS, as
+  *         the main loop would
+  * @param  ecu: Model ECU
+  * @param  ms: Milliseconds to run
+  * @retval None
+  */
+static void Capture_Run(CaptureEcu_t *ecu, uint32_t ms)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    for (uint32_t m = 0; m < ms; m++) {
+        uint64_t control_end = ecu->elapsed + CAPTURE_CONTROL_TICKS;
+
+        while (ecu->elapsed < control_end) {
+            uint32_t step = VR_Emu_GetSamplePeriod(emu) * VR_DIGITAL_TICKS_PER_US;
+            uint32_t target;
+
+            ecu->sample += step;
+            ecu->elapsed += step;
+            target = ecu->sample + VR_DIGITAL_SAMPLE_LATENCY_TICKS;
+            Capture_FireUntil(ecu, target);
+            Host_TIM2_RunTo(target);
+            HAL_TIM_PeriodElapsedCallback(&htim6);
+        }
+
+        if (m % CAPTURE_PROCESS_MS == CAPTURE_PROCESS_MS - 1) {
+            VR_Capture_Process();
+        }
+    }
+}
+
+/**
+  * @brief  Fire pending events up to a TIM2 count, in time order
+  * @param  ecu: Model ECU
+  * @param  target: TIM2 count
+  * @retval None
+  */
+static void Capture_FireUntil(CaptureEcu_t *ecu, uint32_t target)
+{
+    for (;;) {
+        uint32_t next = CAPTURE_MAX_PENDING;
+
+        for (uint32_t i = 0; i < ecu->num_pending; i++) {
+            int32_t due = (int32_t)(ecu->pending[i].time - target);
+            if (due <= 0 && (next == CAPTURE_MAX_PENDING ||
+                             (int32_t)(ecu->pending[i].time - ecu->pending[next].time) < 0)) {
+                next = i;
+            }
+        }
+        if (next == CAPTURE_MAX_PENDING) {
+            return;
+        }
+
+        CaptureEvent_t event = ecu->pending[next];
+        ecu->pending[next] = ecu->pending[--ecu->num_pending];
+
+        // Edges of the crank output up to the event may schedule more events
+        Host_TIM2_RunTo(event.time);
+        Capture_Inject(event.time, (VR_CaptureChannel_t)event.channel);
+
+        if (ecu->num_log < CAPTURE_TEST_MAX_EVENTS) {
+            ecu->log[ecu->num_log++] = event;
+        } else {
+            ecu->overflow = true;
+        }
+    }
+}
+
+/**
+  * @brief  Capture an ECU edge on one channel
+  * @param  count: TIM2 count, before the next TIM6 sample
+  * @param  channel: Capture channel
+  * @retval None
+  */
+static void Capture_Inject(uint32_t count, VR_CaptureChannel_t channel)
+{
+    Host_TIM2_RunTo(count);
+    Host_TIM2_Capture((channel == VR_CAPTURE_IGNITION) ? TIM_CHANNEL_2 : TIM_CHANNEL_3);
+}
+
+/**
+  * @brief  TIM2 channel 4 edge hook: the model ECU's crank input
+  * @param  ctx: Model ECU
+  * @param  count: TIM2 count of the edge
+  * @param  level: New output level
+  * @retval None
+  */
+static void Capture_OnEdge(void *ctx, uint32_t count, uint32_t level)
+{
+    CaptureEcu_t *ecu = ctx;
+
+    if (!level) {
+        ecu->last_fall = count;
+        return;
+    }
+
+    if (!ecu->started) {
+        // The wheel starts at tooth 0 of the first cycle revolution
+        ecu->started = true;
+        ecu->tooth = 0;
+        ecu->prev_rise = count;
+        return;
+    }
+
+    uint32_t period = count - ecu->prev_rise;
+    uint32_t width = ecu->last_fall - ecu->prev_rise;
+
+    // The wide tooth is 12/20 of its pitch; regular teeth are 4/20. A set
+    // point step can carry the emulator past a whole tooth pulse, and the
+    // ECU then finds its place again at the wide tooth, as a decoder would.
+    if (2u * width > period && ecu->tooth % TRIGGER_WHEEL_TEETH != MISSING_TOOTH_INDEX) {
+        ecu->slips++;
+        ecu->tooth = (ecu->tooth < TRIGGER_WHEEL_TEETH) ? MISSING_TOOTH_INDEX :
+                     (uint8_t)(TRIGGER_WHEEL_TEETH + MISSING_TOOTH_INDEX);
+    }
+    ecu->tooth = (uint8_t)((ecu->tooth + 1) % CAPTURE_CYCLE_TEETH);
+    ecu->prev_rise = count;
+
+    if (ecu->armed) {
+        Capture_Schedule(ecu, count, period);
+    }
+}
+
+/**
+  * @brief  Schedule the events that fall in the next tooth
+  * @param  ecu: Model ECU
+  * @param  rise: TIM2 count of the rise that started the current tooth
+  * @param  period: Tooth period measured at that rise
+  * @retval None
+  */
+static void Capture_Schedule(CaptureEcu_t *ecu, uint32_t rise, uint32_t period)
+{
+    uint32_t next = (ecu->tooth + 1u) % CAPTURE_CYCLE_TEETH;
+
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        for (uint32_t cyl = 0; cyl < CAPTURE_CYLINDERS; cyl++) {
+            float angle = ecu->angle[ch][cyl];
+            uint32_t tooth = (uint32_t)(angle / CAPTURE_PITCH_DEG);
+
+            if (tooth != next || ecu->num_pending >= CAPTURE_MAX_PENDING) {
+                continue;
+            }
+
+            float fraction = (angle - (float)tooth * CAPTURE_PITCH_DEG) / CAPTURE_PITCH_DEG;
+            ecu->pending[ecu->num_pending++] = (CaptureEvent_t){
+                rise + period + (uint32_t)(fraction * (float)period + 0.5f), (uint8_t)ch, (uint8_t)cyl
+            };
+        }
+    }
+}
+
+/**
+  * @brief  Convert what has arrived, then clear the statistics and the
+  *         model ECU's log from the latest sample on
+  * @param  ecu: Model ECU
+  * @retval None
+  */
+static void Capture_ClearStats(CaptureEcu_t *ecu)
+{
+    uint32_t kept = 0;
+
+    // Captures before the sample are converted here; later ones count after the reset
+    VR_Capture_Process();
+    VR_Capture_Reset();
+    ecu->slips = 0;
+
+    for (uint32_t i = 0; i < ecu->num_log; i++) {
+        if ((int32_t)(ecu->log[i].time - ecu->sample) >= 0) {
+            ecu->log[kept++] = ecu->log[i];
+        }
+    }
+    ecu->num_log = kept;
+}
+
+/**
+  * @brief  Compare the statistics with the events the model ECU fired
+  * @param  ecu: Model ECU
+  * @param  rpm: Segment speed, for messages
+  * @retval True if every event was captured at its scheduled advance
+  */
+static bool Capture_CheckSegment(const CaptureEcu_t *ecu, uint16_t rpm)
+{
+    if (ecu->slips != 0) {
+        printf("TEST FAILED: %u RPM: model ECU lost the wide tooth %u times\n", rpm, ecu->slips);
+        return false;
+    }
+
+    for (uint32_t ch = 0; ch < VR_CAPTURE_CHANNELS; ch++) {
+        const float *expected = (ch == VR_CAPTURE_IGNITION) ? capture_ign_advance : capture_inj_advance;
+        VR_CaptureStatus_t status;
+
+        VR_Capture_GetStatus((VR_CaptureChannel_t)ch, &status);
+        if (status.overruns != 0 || status.unsynced != 0) {
+            printf("TEST FAILED: %u RPM channel %u: %u overruns, %u unsynced\n",
+                   rpm, ch, status.overruns, status.unsynced);
+            return false;
+        }
+
+        for (uint32_t cyl = 0; cyl < CAPTURE_CYLINDERS; cyl++) {
+            VR_AdvanceStats_t stats;
+            uint32_t fired = 0;
+
+            for (uint32_t i = 0; i < ecu->num_log; i++) {
+                fired += (ecu->log[i].channel == ch && ecu->log[i].cylinder == cyl);
+            }
+
+            VR_Capture_GetStats((VR_CaptureChannel_t)ch, (uint8_t)cyl, &stats);
+            if (stats.count != fired || fired < CAPTURE_MIN_EVENTS) {
+                printf("TEST FAILED: %u RPM channel %u cylinder %u: %u events captured, %u fired\n",
+                       rpm, ch, cyl + 1, stats.count, fired);
+                return false;
+            }
+
+            if (fabsf(stats.mean_deg - expected[cyl]) > CAPTURE_TEST_TOLERANCE_DEG ||
+                stats.min_deg < expected[cyl] - CAPTURE_TEST_TOLERANCE_DEG ||
+                stats.max_deg > expected[cyl] + CAPTURE_TEST_TOLERANCE_DEG) {
+                printf("TEST FAILED: %u RPM channel %u cylinder %u: advance %.4f (%.4f to %.4f), expected %.4f\n",
+                       rpm, ch, cyl + 1, stats.mean_deg, stats.min_deg, stats.max_deg, expected[cyl]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Check the telemetry text for the last segment
+  * @retval True if the counters and the advance appear
+  */
+static bool Capture_TestTelemetry(void)
+{
+    char text[1024];
+    uint32_t len = VR_Capture_FormatTelemetry(text, sizeof(text));
+    const char *expected[] = {
+        "IGN captures=", "INJ captures=", "IGN 1 n=", "adv=10.00 ", "adv=-5.00 ", "adv=100.25 ",
+    };
+
+    if (len == 0 || len != strlen(text)) {
+        printf("TEST FAILED: telemetry length %u\n", len);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        if (strstr(text, expected[i]) == NULL) {
+            printf("TEST FAILED: telemetry lacks \"%s\":\n%s", expected[i], text);
+            return false;
+        }
+    }
+
+    // Truncation keeps the terminator inside the buffer
+    char small[20];
+    len = VR_Capture_FormatTelemetry(small, sizeof(small));
+    if (len != sizeof(small) - 1 || strlen(small) != len) {
+        printf("TEST FAILED: truncated telemetry length %u\n", len);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Overfill the ignition ring between two processing passes
+  * @param  ecu: Model ECU
+  * @retval True if the oldest captures are counted as overruns
+  */
+static bool Capture_TestOverrun(CaptureEcu_t *ecu)
+{
+    const uint32_t extra = 36;
+    VR_CaptureStatus_t status;
+
+    Capture_ClearStats(ecu);
+    for (uint32_t i = 0; i < VR_CAPTURE_RING + extra; i++) {
+        Capture_Inject(htim2.Instance->CNT + 2u, VR_CAPTURE_IGNITION);
+    }
+    Capture_Run(ecu, 1);
+    VR_Capture_Process();
+
+    VR_Capture_GetStatus(VR_CAPTURE_IGNITION, &status);
+    if (status.overruns != extra || status.captures != VR_CAPTURE_RING || status.unsynced != 0) {
+        printf("TEST FAILED: ring overrun: %u captures, %u overruns, %u unsynced\n",
+               status.captures, status.overruns, status.unsynced);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Capture while the wheel is stopped
+  * @param  ecu: Model ECU
+  * @retval True if the captures are counted as unsynced
+  */
+static bool Capture_TestStopped(CaptureEcu_t *ecu)
+{
+    VR_CaptureStatus_t status;
+
+    VR_Emulator_SetRPM(0);
+    Capture_Run(ecu, 5);
+    Capture_ClearStats(ecu);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        Capture_Inject(htim2.Instance->CNT + 100u, VR_CAPTURE_INJECTION);
+    }
+    Capture_Run(ecu, 1);
+    VR_Capture_Process();
+
+    VR_Capture_GetStatus(VR_CAPTURE_INJECTION, &status);
+    if (status.unsynced != 3 || status.captures != 0) {
+        printf("TEST FAILED: stopped wheel: %u captures, %u unsynced\n", status.captures, status.unsynced);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Convert counts to cycle angles across the cycle end and the TIM2 wrap
+  * @retval True if every angle matches
+  */
+static bool Capture_TestAngle(void)
+{
+    const uint32_t period = 1000u * VR_DIGITAL_TICKS_PER_US;
+    VR_PhaseAnchor_t anchor = {0xFFFFFF00u, 0xFFFFF000u, period, CAPTURE_CYCLE_TEETH - 1u};
+    const struct {
+        uint32_t count;
+        float angle;
+    } cases[] = {
+        {0xFFFFF000u, 700.0f},                          // Start of the last cycle tooth
+        {0xFFFFF000u + period / 2u, 710.0f},
+        {0xFFFFF000u + period + period / 4u, 5.0f},     // Count wrapped, next cycle
+        {0xFFFFF000u + 19u * period, 360.0f},           // Second revolution
+    };
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        float angle = VR_Capture_AngleAt(&anchor, cases[i].count);
+        if (fabsf(angle - cases[i].angle) > 1e-3f) {
+            printf("TEST FAILED: angle at %u is %.4f, expected %.4f\n", cases[i].count, angle, cases[i].angle);
+            return false;
+        }
+    }
+
+    anchor.period = 0;
+    if (VR_Capture_AngleAt(&anchor, 0xFFFFF000u) != 0.0f) {
+        printf("TEST FAILED: angle with the wheel stopped\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Assign events to cylinders at the window edges
+  * @retval True if every cylinder and advance matches
+  */
+static bool Capture_TestAssign(void)
+{
+    const struct {
+        float angle;
+        uint8_t cylinders;
+        float tdc;
+        uint8_t cylinder;
+        float advance;
+    } cases[] = {
+        {80.0f, 4, 90.0f, 0, 10.0f},
+        {120.0f, 4, 90.0f, 0, -VR_CAPTURE_MAX_RETARD_DEG},  // Latest event for cylinder 1
+        {120.5f, 4, 90.0f, 1, 149.5f},                      // Earliest for cylinder 2
+        {700.0f, 4, 90.0f, 0, 110.0f},                      // Cylinder 1 TDC in the next cycle
+        {600.0f, 6, 0.0f, 5, 0.0f},
+        {10.0f, 1, 0.0f, 0, -10.0f},
+    };
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        float advance;
+        uint8_t cylinder = VR_Capture_Assign(cases[i].angle, cases[i].cylinders, cases[i].tdc, &advance);
+
+        if (cylinder != cases[i].cylinder || fabsf(advance - cases[i].advance) > 1e-3f) {
+            printf("TEST FAILED: event at %.2f deg: cylinder %u advance %.2f, expected %u and %.2f\n",
+                   cases[i].angle, cylinder + 1, advance, cases[i].cylinder + 1, cases[i].advance);
+            return false;
+        }
+    }
+
+    return true;
+}
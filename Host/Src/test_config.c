@@ -0,0 +1,454 @@
+/**
+  ******************************************************************************
+  * @file           : test_config.c
+  * @brief          : Configuration store and boot time tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * A reboot is VR_Config_Init() over the simulated flash, which keeps its
+  * contents. Host_Flash_SetWriteLimit() cuts the power part way through a
+  * save. Checks:
+  * - The CRC-32 check value, the sector addresses of the STM32F767ZI, and
+  *   an empty store that loads nothing.
+  * - A saved configuration survives a reboot and drives the emulator; an
+  *   unchanged save writes nothing, and a cleared store boots defaults.
+  * - The gain, noise, fault and scenario upload are restored, a record
+  *   holds only the uploaded scenario bytes, and clear flags give the
+  *   defaults.
+  * - A save torn in its payload or its header, or during a sector change,
+  *   reboots to the previous configuration, and the next save works.
+  * - Many saves alternate between the two sectors, with their erase counts
+  *   at most one apart.
+  * - The boot stage times and the BOOT line.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_config.h"
+#include "test_host.h"
+#include "vr_config.h"
+#include "vr_command.h"
+#include "vr_cycles.h"
+#include "vr_sensor_emulator.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define CONFIG_RECORD_WORDS         ((16u + offsetof(VR_Config_t, scenario)) / 4u)  // Header and payload
+#define CONFIG_SCENARIO_BYTES       98u     // Not whole words, to check the padding
+#define CONFIG_WEAR_SAVES           1200u   // Enough to change sector four times
+
+/* Private variables ---------------------------------------------------------*/
+static VR_Config_t config_a;
+static VR_Config_t config_b;
+static VR_Config_t config_read;
+static VR_Config_t config_settings;
+static VR_Config_t config_captured;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Config_Make(VR_Config_t *config, int32_t amplitude);
+static bool Config_Reboot(const VR_Config_t *expected);
+static bool Config_TestCrc(void);
+static bool Config_TestRestore(void);
+static bool Config_TestSettings(void);
+static bool Config_TestPowerLoss(void);
+static bool Config_TestWear(void);
+static bool Config_TestBootTime(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the configuration store and boot time tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Config(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing configuration store...\n");
+
+    VR_Test_ResetDefault();
+    Config_Make(&config_a, 1200);
+    Config_Make(&config_b, -900);
+
+    VR_Test_Record(&results, Config_TestCrc());
+    VR_Test_Record(&results, Config_TestRestore());
+    VR_Test_Record(&results, Config_TestSettings());
+    VR_Test_Record(&results, Config_TestPowerLoss());
+    VR_Test_Record(&results, Config_TestWear());
+    VR_Test_Record(&results, Config_TestBootTime());
+
+    // Later suites run with the built-in model, no upload and an empty store
+    VR_Command_SelectShape(NULL);
+    VR_Command_LoadScenario(config_read.scenario, 0);
+    Host_Flash_Reset();
+    VR_Config_Init();
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Configuration store");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Build a configuration with a tooth waveform, full gain and no noise
+  * @param  config: Filled with the configuration
+  * @param  amplitude: Peak level of the waveform, DAC codes
+  * @retval None
+  */
+static void Config_Make(VR_Config_t *config, int32_t amplitude)
+{
+    memset(config, 0, sizeof(*config));
+    config->flags = VR_CONFIG_SHAPE | VR_CONFIG_GAIN | VR_CONFIG_NOISE | VR_CONFIG_FAULT;
+    config->amplitude = VR_AMPLITUDE_FULL;
+    config->noise_seed = VR_NOISE_DEFAULT_SEED;
+    VR_Shape_Clear(&config->shape);
+
+    for (int32_t i = 0; i < 40; i++) {
+        VR_Shape_Append(&config->shape, VR_SHAPE_REGULAR, amplitude * (i - 20) / 20);
+    }
+    for (int32_t i = 0; i < 24; i++) {
+        VR_Shape_Append(&config->shape, VR_SHAPE_MISSING, amplitude * (12 - i) / 12);
+    }
+}
+
+/**
+  * @brief  Reboot the store and check what it restores
+  * @param  expected: Configuration that should load, NULL for none
+  * @retval True if it matches
+  */
+static bool Config_Reboot(const VR_Config_t *expected)
+{
+    VR_Config_Init();
+    bool loaded = VR_Config_Load(&config_read);
+
+    if (expected == NULL) {
+        return !loaded;
+    }
+    return loaded && memcmp(&config_read, expected, sizeof(config_read)) == 0;
+}
+
+/**
+  * @brief  Check the CRC, the sector addresses and an empty store
+  * @retval True if passed
+  */
+static bool Config_TestCrc(void)
+{
+    VR_ConfigStats_t stats;
+
+    if (VR_Config_Crc32("123456789", 9) != 0xCBF43926u || VR_Config_Crc32(NULL, 0) != 0) {
+        printf("TEST FAILED: config CRC: check value 0x%08lx\n",
+               (unsigned long)VR_Config_Crc32("123456789", 9));
+        return false;
+    }
+
+    // Sector 10 follows the 1.5 MB program region; sector 11 ends the 2 MB flash
+    if (VR_CONFIG_BASE != 0x08180000u || VR_CONFIG_SECTOR_ADDRESS(FLASH_SECTOR_11) != 0x081C0000u
+        || VR_CONFIG_SECTOR_ADDRESS(FLASH_SECTOR_11) + VR_CONFIG_SECTOR_SIZE != 0x08200000u) {
+        printf("TEST FAILED: config CRC: sector 10 at 0x%08lx\n", (unsigned long)VR_CONFIG_BASE);
+        return false;
+    }
+
+    Host_Flash_Reset();
+    VR_Config_GetStats(&stats);
+    if (!Config_Reboot(NULL) || (VR_Config_GetStats(&stats), stats.sector != 0 || stats.records != 0)) {
+        printf("TEST FAILED: config CRC: empty store loaded a configuration\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check save, reboot, apply, unchanged saves and clear
+  * @retval True if passed
+  */
+static bool Config_TestRestore(void)
+{
+    VR_ConfigStats_t stats;
+
+    Host_Flash_Reset();
+    VR_Config_Init();
+    if (!VR_Config_Save(&config_a) || !Config_Reboot(&config_a)) {
+        printf("TEST FAILED: config restore: saved configuration not restored\n");
+        return false;
+    }
+
+    VR_Config_GetStats(&stats);
+    if (stats.sector != FLASH_SECTOR_10 || stats.sequence != 1 || stats.records != 1
+        || stats.erases[0] != 1 || stats.erases[1] != 0 || Host_Flash_GetErases(FLASH_SECTOR_10) != 1) {
+        printf("TEST FAILED: config restore: sector %lu seq %lu records %lu erases %lu/%lu\n",
+               (unsigned long)stats.sector, (unsigned long)stats.sequence, (unsigned long)stats.records,
+               (unsigned long)stats.erases[0], (unsigned long)stats.erases[1]);
+        return false;
+    }
+
+    // The restored waveform drives the emulator, and captures back unchanged
+    VR_Config_Apply(&config_read);
+    const VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_Config_t captured;
+    VR_Config_Capture(&captured);
+    if (emu->shape == NULL || memcmp(&captured, &config_a, sizeof(captured)) != 0) {
+        printf("TEST FAILED: config restore: emulator not running the restored shape\n");
+        return false;
+    }
+
+    // An unchanged save writes nothing
+    uint32_t used = stats.used;
+    if (!VR_Config_Save(&captured) || (VR_Config_GetStats(&stats), stats.used != used || stats.sequence != 1)) {
+        printf("TEST FAILED: config restore: unchanged save was written\n");
+        return false;
+    }
+
+    if (!VR_Config_Save(&config_b) || !Config_Reboot(&config_b)) {
+        printf("TEST FAILED: config restore: second save not restored\n");
+        return false;
+    }
+    if (!VR_Config_Clear() || !Config_Reboot(NULL)) {
+        printf("TEST FAILED: config restore: cleared store still loads a configuration\n");
+        return false;
+    }
+    if (!VR_Config_Save(&config_a) || !Config_Reboot(&config_a)
+        || (VR_Config_GetStats(&stats), stats.sequence != 4 || stats.records != 4)) {
+        printf("TEST FAILED: config restore: save after clear not restored\n");
+        return false;
+    }
+
+    // Built-in model when nothing is saved
+    VR_Config_Capture(&captured);
+    captured.flags = 0;
+    VR_Config_Apply(&captured);
+    if (emu->shape != NULL) {
+        printf("TEST FAILED: config restore: configuration without a shape kept one\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the gain, noise, fault and scenario upload through a reboot
+  * @retval True if passed
+  */
+static bool Config_TestSettings(void)
+{
+    const VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_ConfigStats_t stats;
+    const void *image;
+
+    config_settings = config_a;
+    config_settings.flags |= VR_CONFIG_SCENARIO;
+    config_settings.amplitude = 2500;
+    config_settings.noise_lsb = 30;
+    config_settings.noise_seed = 0x1234567u;
+    config_settings.fault = VR_FAULT_SPIKE;
+    config_settings.scenario_length = CONFIG_SCENARIO_BYTES;
+    for (uint32_t i = 0; i < CONFIG_SCENARIO_BYTES; i++) {
+        config_settings.scenario[i] = (uint8_t)(i * 37u + 5u);
+    }
+
+    // Only the uploaded scenario bytes are written, padded to a word
+    Host_Flash_Reset();
+    VR_Config_Init();
+    uint32_t expected = 16u + 16u + ((offsetof(VR_Config_t, scenario) + CONFIG_SCENARIO_BYTES + 3u) & ~3u);
+    if (!VR_Config_Save(&config_settings) || (VR_Config_GetStats(&stats), stats.used != expected)
+        || !Config_Reboot(&config_settings)) {
+        printf("TEST FAILED: config settings: saved %lu bytes, expected %lu, or not restored\n",
+               (unsigned long)stats.used, (unsigned long)expected);
+        return false;
+    }
+
+    VR_Config_Apply(&config_read);
+    uint32_t length = VR_Command_GetScenario(&image);
+    if (emu->amplitude != 2500 || emu->noise_lsb != 30 || emu->noise_rng != 0x1234567u
+        || emu->noise_seed != 0x1234567u || emu->fault != VR_FAULT_SPIKE || length != CONFIG_SCENARIO_BYTES
+        || memcmp(image, config_settings.scenario, CONFIG_SCENARIO_BYTES) != 0) {
+        printf("TEST FAILED: config settings: gain %u noise %u seed 0x%lx fault %u scenario %lu bytes\n",
+               emu->amplitude, emu->noise_lsb, (unsigned long)emu->noise_seed, emu->fault, (unsigned long)length);
+        return false;
+    }
+
+    // A sequence that has moved on still captures the seed it started from
+    VR_Emulator_GetDefault()->noise_rng ^= 0x5A5A5A5Au;
+    VR_Config_Capture(&config_captured);
+    if (memcmp(&config_captured, &config_settings, sizeof(config_captured)) != 0) {
+        printf("TEST FAILED: config settings: captured configuration differs\n");
+        return false;
+    }
+
+    // Without their flags the settings return to the defaults
+    config_captured.flags = VR_CONFIG_SHAPE;
+    VR_Config_Apply(&config_captured);
+    if (emu->amplitude != VR_AMPLITUDE_FULL || emu->noise_lsb != 0 || emu->fault != VR_FAULT_NONE
+        || emu->shape == NULL || VR_Command_GetScenario(&image) != 0) {
+        printf("TEST FAILED: config settings: cleared flags kept gain %u noise %u fault %u\n",
+               emu->amplitude, emu->noise_lsb, emu->fault);
+        return false;
+    }
+
+    // A fault out of range, as from a damaged record, restores as none
+    config_captured.flags = VR_CONFIG_FAULT;
+    config_captured.fault = VR_FAULT_COUNT;
+    VR_Config_Apply(&config_captured);
+    if (emu->fault != VR_FAULT_NONE) {
+        printf("TEST FAILED: config settings: fault %u restored from an invalid record\n", emu->fault);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check saves cut short by a power loss
+  * @retval True if passed
+  */
+static bool Config_TestPowerLoss(void)
+{
+    VR_ConfigStats_t stats;
+
+    Host_Flash_Reset();
+    VR_Config_Init();
+    VR_Config_Save(&config_a);
+
+    // Payload torn: the record before it is restored, the next save changes sector
+    Host_Flash_SetWriteLimit(4u + 100u);
+    if (VR_Config_Save(&config_b)) {
+        printf("TEST FAILED: config power loss: torn save reported success\n");
+        return false;
+    }
+    Host_Flash_SetWriteLimit(UINT32_MAX);
+    if (!Config_Reboot(&config_a)) {
+        printf("TEST FAILED: config power loss: torn payload lost the previous configuration\n");
+        return false;
+    }
+    if (!VR_Config_Save(&config_b) || !Config_Reboot(&config_b)
+        || (VR_Config_GetStats(&stats), stats.sector != FLASH_SECTOR_11)) {
+        printf("TEST FAILED: config power loss: save after a torn payload\n");
+        return false;
+    }
+
+    // Header torn
+    Host_Flash_SetWriteLimit(2u);
+    VR_Config_Save(&config_a);
+    Host_Flash_SetWriteLimit(UINT32_MAX);
+    if (!Config_Reboot(&config_b)) {
+        printf("TEST FAILED: config power loss: torn header lost the previous configuration\n");
+        return false;
+    }
+    if (!VR_Config_Save(&config_a) || !Config_Reboot(&config_a)
+        || (VR_Config_GetStats(&stats), stats.sector != FLASH_SECTOR_10)) {
+        printf("TEST FAILED: config power loss: save after a torn header\n");
+        return false;
+    }
+
+    // Sector change cut after the record, before the header that activates it:
+    // each save has power for one record, so the one that changes sector fails
+    const VR_Config_t *last = &config_a;
+    for (uint32_t used = 0; VR_Config_GetStats(&stats), stats.used != used; used = stats.used) {
+        const VR_Config_t *next = (last == &config_a) ? &config_b : &config_a;
+
+        Host_Flash_SetWriteLimit(CONFIG_RECORD_WORDS);
+        if (VR_Config_Save(next)) {
+            last = next;
+        }
+        Host_Flash_SetWriteLimit(UINT32_MAX);
+    }
+    if (stats.sector != FLASH_SECTOR_10 || stats.used + 4u * CONFIG_RECORD_WORDS <= VR_CONFIG_SECTOR_SIZE) {
+        printf("TEST FAILED: config power loss: sector changed without its header\n");
+        return false;
+    }
+    if (!Config_Reboot(last) || (VR_Config_GetStats(&stats), stats.sector != FLASH_SECTOR_10)) {
+        printf("TEST FAILED: config power loss: interrupted sector change lost the configuration\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that saves spread the erases over both sectors
+  * @retval True if passed
+  */
+static bool Config_TestWear(void)
+{
+    VR_ConfigStats_t stats;
+    uint32_t changes = 0;
+    uint32_t sector = 0;
+
+    Host_Flash_Reset();
+    VR_Config_Init();
+
+    for (uint32_t i = 0; i < CONFIG_WEAR_SAVES; i++) {
+        if (!VR_Config_Save((i & 1u) ? &config_b : &config_a)) {
+            printf("TEST FAILED: config wear: save %lu failed\n", (unsigned long)i);
+            return false;
+        }
+        VR_Config_GetStats(&stats);
+        if (stats.sector != sector) {
+            sector = stats.sector;
+            changes++;
+        }
+    }
+
+    uint32_t e10 = Host_Flash_GetErases(FLASH_SECTOR_10);
+    uint32_t e11 = Host_Flash_GetErases(FLASH_SECTOR_11);
+    uint32_t per_sector = (VR_CONFIG_SECTOR_SIZE - 16u) / (4u * CONFIG_RECORD_WORDS);
+    if (changes < 4 || e10 + e11 != changes || (e10 > e11 ? e10 - e11 : e11 - e10) > 1
+        || stats.erases[0] != e10 || stats.erases[1] != e11
+        || e10 + e11 > CONFIG_WEAR_SAVES / per_sector + 1) {
+        printf("TEST FAILED: config wear: %lu sector changes, erases %lu/%lu\n",
+               (unsigned long)changes, (unsigned long)e10, (unsigned long)e11);
+        return false;
+    }
+
+    if (!Config_Reboot(((CONFIG_WEAR_SAVES - 1) & 1u) ? &config_b : &config_a)
+        || (VR_Config_GetStats(&stats), stats.sequence != CONFIG_WEAR_SAVES)) {
+        printf("TEST FAILED: config wear: newest save not restored\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the boot stage times and the BOOT line
+  * @retval True if passed
+  */
+static bool Config_TestBootTime(void)
+{
+    static const uint32_t ends[VR_BOOT_STAGES] = {800, 16800, 232800, 448800, 664800};
+    static const uint32_t clocks[VR_BOOT_STAGES] = {16000000, 216000000, 216000000, 216000000, 216000000};
+    uint32_t saved_clock = SystemCoreClock;
+    char text[128];
+    char small[10];
+    bool passed = true;
+
+    // 50 us at 16 MHz, 1 ms of PLL lock at 16 MHz, then 1 ms per stage at 216 MHz
+    SystemCoreClock = 16000000u;
+    VR_Cycles_Init();
+    if (VR_Cycles_BootTime(VR_BOOT_STAGES) != 0) {
+        printf("TEST FAILED: boot time: stages timed before they were marked\n");
+        passed = false;
+    }
+    for (uint32_t i = 0; i < VR_BOOT_STAGES; i++) {
+        DWT->CYCCNT = ends[i];
+        SystemCoreClock = clocks[i];
+        VR_Cycles_BootMark((VR_BootStage_t)i);
+    }
+
+    uint32_t len = VR_Cycles_FormatBoot(text, sizeof(text));
+    const char *expected = "BOOT hal=50us clock=1000us periph=1000us config=1000us output=1000us total=4050us\r\n";
+    if (passed && (strcmp(text, expected) != 0 || len != strlen(text))) {
+        printf("TEST FAILED: boot time: \"%s\"\n", text);
+        passed = false;
+    }
+    if (passed && (VR_Cycles_FormatBoot(small, sizeof(small)) != sizeof(small) - 1
+                   || strncmp(small, "BOOT hal=", sizeof(small) - 1) != 0
+                   || VR_Cycles_FormatBoot(small, 0) != 0)) {
+        printf("TEST FAILED: boot time: short buffer \"%s\"\n", small);
+        passed = false;
+    }
+
+    SystemCoreClock = saved_clock;
+    VR_Cycles_Init();
+    return passed;
+}
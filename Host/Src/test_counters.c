@@ -0,0 +1,250 @@
+/**
+  ******************************************************************************
+  * @file           : test_counters.c
+  * @brief          : Output and activity counter tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * TIM2 is advanced by one sample period before each sample, so the
+  * counts the sample interrupts record are the device's. Checks:
+  * - The TIM6 sample path counts each sample, each tooth and each
+  *   revolution, and the speed measured from the revolution times
+  *   matches the tooth period. Once the output is two revolutions late
+  *   the speed reads 0.
+  * - In revolution mode the DMA transfer interrupts count the samples
+  *   played, and a phase jump is not counted as teeth.
+  * - Potentiometer conversions, parameter changes, faults, overruns and
+  *   underruns are counted, and parameters set unchanged are not.
+  * - The COUNT telemetry line.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_counters.h"
+#include "test_host.h"
+#include "vr_counters.h"
+#include "vr_revolution.h"
+#include "vr_sample.h"
+#include "vr_qos.h"
+#include "vr_digital_output.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define COUNTERS_RPM                3000    // 10 us samples, 1111 us teeth
+#define COUNTERS_RPM_OTHER          4000
+#define COUNTERS_REVOLUTIONS        3
+#define COUNTERS_REV_LENGTH         1998    // Revolution mode: 18 * 1110 / 10
+#define COUNTERS_REV_MRPM           3003003 // 60 s / (1998 * 10 us)
+
+/* Private variables ---------------------------------------------------------*/
+extern ADC_HandleTypeDef hadc1;
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim2;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Counters_TestSamples(void);
+static bool Counters_TestRevolutionMode(void);
+static bool Counters_TestActivity(void);
+static bool Counters_TestTelemetry(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the output and activity counter tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Counters(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing output counters...\n");
+
+    VR_Test_ResetDefault();
+    VR_Emulator_SetRPM(COUNTERS_RPM);
+    VR_Test_Record(&results, Counters_TestSamples());
+    VR_Test_Record(&results, Counters_TestRevolutionMode());
+    VR_Test_Record(&results, Counters_TestActivity());
+    VR_Test_Record(&results, Counters_TestTelemetry());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Output counter");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the counts and the speed of the TIM6 sample path
+  * @retval True if passed
+  */
+static bool Counters_TestSamples(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_Counters_t before, after;
+    uint32_t step = VR_Emu_GetSamplePeriod(emu) * VR_DIGITAL_TICKS_PER_US;
+    uint32_t samples = 0, teeth = 0, revolutions = 0;
+
+    // Start on a tooth boundary, so the first report is the reference
+    VR_Counters_PhaseJump();
+    VR_Counters_Snapshot(&before);
+    while (revolutions < COUNTERS_REVOLUTIONS) {
+        uint8_t tooth = emu->state.current_tooth;
+
+        Host_TIM2_RunTo(htim2.Instance->CNT + step);
+        VR_Sample_TopHalf();
+        VR_Sample_BottomHalf();
+        if (samples++ > 0 && emu->state.current_tooth != tooth) {
+            teeth++;
+            if (emu->state.current_tooth == 0) {
+                revolutions++;
+            }
+        }
+    }
+    VR_Counters_Snapshot(&after);
+
+    // 18 teeth of 1111 us, timed to the 10 us sample
+    uint32_t expected = (uint32_t)(60000000000ull / (TRIGGER_WHEEL_TEETH * emu->state.tooth_period_us));
+    uint32_t error = (after.rpm_milli > expected) ? after.rpm_milli - expected : expected - after.rpm_milli;
+    if (after.samples - before.samples != samples || after.teeth - before.teeth != teeth ||
+        after.revolutions - before.revolutions != revolutions || error > 2000) {
+        printf("TEST FAILED: counters samples: %lu samples, %lu teeth, %lu revs at %lu mrpm, "
+               "expected %lu, %lu, %lu at %lu\n",
+               (unsigned long)(after.samples - before.samples), (unsigned long)(after.teeth - before.teeth),
+               (unsigned long)(after.revolutions - before.revolutions), (unsigned long)after.rpm_milli,
+               (unsigned long)samples, (unsigned long)teeth, (unsigned long)revolutions,
+               (unsigned long)expected);
+        return false;
+    }
+
+    // No output for two revolutions, as if the wheel had stopped
+    Host_TIM2_RunTo(htim2.Instance->CNT + 2 * after.revolution_ticks - 4 * step);
+    VR_Counters_Snapshot(&after);
+    if (after.rpm_milli == 0) {
+        printf("TEST FAILED: counters samples: speed dropped before two revolutions\n");
+        return false;
+    }
+    Host_TIM2_RunTo(htim2.Instance->CNT + 4 * step);
+    VR_Counters_Snapshot(&after);
+    if (after.rpm_milli != 0) {
+        printf("TEST FAILED: counters samples: stopped output still at %lu mrpm\n",
+               (unsigned long)after.rpm_milli);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the counts of revolution mode and across its phase jump
+  * @retval True if passed
+  */
+static bool Counters_TestRevolutionMode(void)
+{
+    VR_Counters_t before, after;
+    uint32_t calls = 0;
+
+    VR_Counters_Snapshot(&before);
+    VR_Rev_Start();
+    while (VR_Rev_Update()) {
+        if (++calls > VR_REV_MAX_SAMPLES / VR_REV_RENDER_CHUNK + 1) {
+            printf("TEST FAILED: counters revolution mode: render did not complete\n");
+            return false;
+        }
+    }
+
+    // The first trigger outputs the level held from before the DMA started
+    Host_TIM6_Update();
+    for (uint32_t i = 0; i < COUNTERS_REVOLUTIONS * COUNTERS_REV_LENGTH; i++) {
+        htim2.Instance->CNT += 10 * VR_DIGITAL_TICKS_PER_US;
+        Host_TIM6_Update();
+    }
+    VR_Counters_Snapshot(&after);
+    VR_Rev_Stop();
+
+    // The first half revolution sets the reference after the jump to tooth 0.
+    // The last report is still in tooth 17, so the last wrap is not seen yet.
+    uint32_t teeth = (2 * COUNTERS_REVOLUTIONS - 1) * TRIGGER_WHEEL_TEETH / 2;
+    if (after.samples - before.samples != COUNTERS_REVOLUTIONS * COUNTERS_REV_LENGTH ||
+        after.teeth - before.teeth != teeth ||
+        after.revolutions - before.revolutions != COUNTERS_REVOLUTIONS - 1 ||
+        after.revolution_ticks != COUNTERS_REV_LENGTH * 10 * VR_DIGITAL_TICKS_PER_US ||
+        after.rpm_milli != COUNTERS_REV_MRPM) {
+        printf("TEST FAILED: counters revolution mode: %lu samples, %lu teeth, %lu revs at %lu mrpm\n",
+               (unsigned long)(after.samples - before.samples), (unsigned long)(after.teeth - before.teeth),
+               (unsigned long)(after.revolutions - before.revolutions), (unsigned long)after.rpm_milli);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the conversion, parameter, fault and lost sample counts
+  * @retval True if passed
+  */
+static bool Counters_TestActivity(void)
+{
+    VR_Counters_t before, after;
+
+    VR_Counters_Snapshot(&before);
+    for (uint32_t i = 0; i < 3; i++) {
+        HAL_ADC_ConvCpltCallback(&hadc1);
+    }
+    VR_Counters_Fault();
+    VR_Counters_Fault();
+
+    // Two changes; the RPM, shape and quality set unchanged count nothing
+    VR_Emulator_SetRPM(COUNTERS_RPM_OTHER);
+    VR_Emulator_SetRPM(COUNTERS_RPM_OTHER);
+    VR_Emulator_SetShape(NULL);
+    VR_Emu_SetQuality(VR_Emulator_GetDefault(), VR_QUALITY_FULL);
+    VR_Emulator_SetRPM(COUNTERS_RPM);
+
+    VR_QoS_SampleDone(0, true);
+    HAL_DAC_DMAUnderrunCallbackCh1(&hdac);
+    VR_Counters_Snapshot(&after);
+
+    // Let the quality steps see the overload, then return to full quality
+    VR_QoS_Update();
+    VR_QoS_SetFloor(VR_QUALITY_FULL);
+
+    if (after.adc != before.adc + 3 || after.faults != before.faults + 2 ||
+        after.updates != before.updates + 2 || after.overruns != before.overruns + 1 ||
+        after.underruns != before.underruns + 1) {
+        printf("TEST FAILED: counters activity: adc +%lu, faults +%lu, updates +%lu, ovr +%lu, udr +%lu\n",
+               (unsigned long)(after.adc - before.adc), (unsigned long)(after.faults - before.faults),
+               (unsigned long)(after.updates - before.updates),
+               (unsigned long)(after.overruns - before.overruns),
+               (unsigned long)(after.underruns - before.underruns));
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the COUNT telemetry line
+  * @retval True if passed
+  */
+static bool Counters_TestTelemetry(void)
+{
+    VR_Counters_t counters;
+    char line[192];
+    char expected[192];
+
+    VR_Counters_Snapshot(&counters);
+    uint32_t length = VR_Counters_FormatTelemetry(line, sizeof(line));
+    snprintf(expected, sizeof(expected),
+             "COUNT samples=%lu teeth=%lu revs=%lu rpm=3003.003 updates=%lu faults=%lu ovr=%lu udr=%lu adc=%lu\r\n",
+             (unsigned long)counters.samples, (unsigned long)counters.teeth,
+             (unsigned long)counters.revolutions, (unsigned long)counters.updates,
+             (unsigned long)counters.faults, (unsigned long)counters.overruns,
+             (unsigned long)counters.underruns, (unsigned long)counters.adc);
+
+    if (strcmp(line, expected) != 0 || length != strlen(expected)) {
+        printf("TEST FAILED: counters telemetry: \"%s\"\n", line);
+        return false;
+    }
+    return true;
+}
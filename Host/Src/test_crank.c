@@ -0,0 +1,409 @@
+/**
+  ******************************************************************************
+  * @file           : test_crank.c
+  * @brief          : Cranking and engine start tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each start runs an unbound emulator one sample at a time and records
+  * the speed the model set at every tooth. Checks:
+  * - The phases follow in order. Cranking dips at each compression and
+  *   repeats every 720 / cylinders degrees. The engine catches after the
+  *   configured revolutions, flares to its peak and settles to idle.
+  * - The engine time is the time the wheel was rendered for, and the
+  *   sample period stays within the cranking limit.
+  * - The amplitude follows the speed, scaling each level about the DC
+  *   offset, and returns to full when the model stops.
+  * - 1, 3, 6 and 12 cylinders dip at their own intervals, and an engine
+  *   that never catches keeps cranking.
+  * - Skipping updates lands where rendering them would.
+  * - The CRANK command, and REV ON ending a start.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_crank.h"
+#include "test_host.h"
+#include "vr_command.h"
+#include "vr_crank.h"
+#include "vr_revolution.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define CRANK_MAX_TEETH             2048
+#define CRANK_MAX_SAMPLES           1000000
+#define CRANK_IDLE_TEETH            36      // Recorded at idle after the settle
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint16_t rpm;
+    uint16_t amplitude;
+    uint8_t phase;
+    uint8_t tooth;
+    uint32_t revolutions;
+} CrankTooth_t;
+
+typedef struct {
+    CrankTooth_t teeth[CRANK_MAX_TEETH];
+    uint32_t count;
+    uint64_t rendered_us;           // Sum of the sample periods rendered
+    uint32_t longest_sample_us;
+} CrankTrace_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const uint8_t crank_cylinders[] = {1, 3, 6, 12};
+static CrankTrace_t crank_trace;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Crank_TestStart(void);
+static bool Crank_TestAmplitude(void);
+static bool Crank_TestCylinders(void);
+static bool Crank_TestSkip(void);
+static bool Crank_TestCommand(void);
+static bool Crank_Run(VR_Emulator_t *emu, VR_Crank_t *crank, const VR_CrankConfig_t *config,
+                      CrankTrace_t *trace, uint32_t teeth);
+static bool Crank_Differ(uint16_t a, uint16_t b);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the cranking and engine start tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Crank(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing cranking and engine start...\n");
+
+    VR_Test_ResetDefault();
+    VR_Test_Record(&results, Crank_TestStart());
+    VR_Test_Record(&results, Crank_TestAmplitude());
+    VR_Test_Record(&results, Crank_TestCylinders());
+    VR_Test_Record(&results, Crank_TestSkip());
+    VR_Test_Record(&results, Crank_TestCommand());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Cranking");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the phases, the cranking dips, the catch, flare and idle
+  * @retval True if passed
+  */
+static bool Crank_TestStart(void)
+{
+    VR_Emulator_t emu;
+    VR_Crank_t crank;
+    VR_CrankConfig_t config;
+    CrankTrace_t *trace = &crank_trace;
+    uint16_t crank_min = UINT16_MAX, crank_max = 0, flare_max = 0;
+    uint32_t catch_revs = 0;
+    uint8_t phase = VR_CRANK_ENGAGE;
+
+    VR_Crank_DefaultConfig(&config);
+    VR_Emu_Init(&emu, NULL);
+    if (!Crank_Run(&emu, &crank, &config, trace, 0)) {
+        return false;
+    }
+
+    // Engage gives way to cranking within the spin-up time
+    for (uint32_t i = 0; i < trace->count; i++) {
+        const CrankTooth_t *t = &trace->teeth[i];
+
+        if (t->phase < phase || t->phase > phase + 1) {
+            printf("TEST FAILED: crank start: phase %s after %s at tooth %lu\n",
+                   VR_Crank_PhaseName(t->phase), VR_Crank_PhaseName(phase), (unsigned long)i);
+            return false;
+        }
+        if (t->phase == VR_CRANK_FLARE && phase == VR_CRANK_CRANKING) {
+            catch_revs = t->revolutions;
+        }
+        phase = t->phase;
+
+        if (t->phase == VR_CRANK_CRANKING) {
+            crank_min = (t->rpm < crank_min) ? t->rpm : crank_min;
+            crank_max = (t->rpm > crank_max) ? t->rpm : crank_max;
+            // Half a revolution on, the next cylinder's compression
+            if (i + 9 < trace->count && trace->teeth[i + 9].phase == VR_CRANK_CRANKING &&
+                Crank_Differ(trace->teeth[i + 9].rpm, t->rpm)) {
+                printf("TEST FAILED: crank start: %u RPM at tooth %lu, %u RPM half a revolution on\n",
+                       t->rpm, (unsigned long)i, trace->teeth[i + 9].rpm);
+                return false;
+            }
+        }
+        if (t->phase >= VR_CRANK_FLARE) {
+            flare_max = (t->rpm > flare_max) ? t->rpm : flare_max;
+        }
+    }
+
+    // 200 RPM dipping 25%, sampled at the tooth centres. The dip fades
+    // over the flare, so may still lift the flare's end a little.
+    const CrankTooth_t *last = &trace->teeth[trace->count - 1];
+    if (phase != VR_CRANK_IDLE || crank_min < 150 || crank_min > 155 || crank_max < 245 || crank_max > 250 ||
+        catch_revs != config.crank_revs || flare_max < 1450 || flare_max > config.flare_rpm * 21 / 20 ||
+        last->rpm != config.idle_rpm ||
+        last->amplitude != config.idle_rpm * VR_AMPLITUDE_FULL / VR_CRANK_FULL_AMPLITUDE_RPM) {
+        printf("TEST FAILED: crank start: ended %s at %u RPM; cranked %u-%u RPM, caught after %lu revs, "
+               "flared to %u RPM\n",
+               VR_Crank_PhaseName(phase), last->rpm, crank_min, crank_max,
+               (unsigned long)catch_revs, flare_max);
+        return false;
+    }
+
+    // The engine time is the wheel's, and cranking samples are fine enough
+    if (crank.time_us + emu.state.tooth_timer != trace->rendered_us ||
+        trace->longest_sample_us > VR_CRANK_SAMPLE_TICKS * VR_SAMPLE_TICK_US) {
+        printf("TEST FAILED: crank start: engine time %lu us + %lu us, rendered %llu us, samples up to %lu us\n",
+               (unsigned long)crank.time_us, (unsigned long)emu.state.tooth_timer,
+               (unsigned long long)trace->rendered_us, (unsigned long)trace->longest_sample_us);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the amplitude scaling and that it follows the speed
+  * @retval True if passed
+  */
+static bool Crank_TestAmplitude(void)
+{
+    VR_Emulator_t full, scaled;
+    VR_Crank_t crank;
+    VR_CrankConfig_t config;
+
+    VR_Emu_Init(&full, NULL);
+    VR_Emu_SetRPM(&full, 200);
+    scaled = full;
+    VR_Emu_SetAmplitude(&scaled, VR_AMPLITUDE_FULL / 4);
+
+    for (uint32_t i = 0; i < 20000; i++) {
+        VR_Emu_GenerateSignal(&full);
+        VR_Emu_GenerateSignal(&scaled);
+        int32_t expected = VR_DC_LEVEL + ((int32_t)full.state.dac_output - VR_DC_LEVEL) / 4;
+        if (scaled.state.dac_output != expected) {
+            printf("TEST FAILED: crank amplitude: quarter amplitude %u, full %u\n",
+                   scaled.state.dac_output, full.state.dac_output);
+            return false;
+        }
+    }
+
+    VR_Crank_DefaultConfig(&config);
+    VR_Emu_Init(&scaled, NULL);
+    if (!Crank_Run(&scaled, &crank, &config, &crank_trace, 200)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < crank_trace.count; i++) {
+        const CrankTooth_t *t = &crank_trace.teeth[i];
+        uint32_t expected = (uint32_t)t->rpm * VR_AMPLITUDE_FULL / VR_CRANK_FULL_AMPLITUDE_RPM;
+
+        if (t->amplitude != ((expected > VR_AMPLITUDE_FULL) ? VR_AMPLITUDE_FULL : expected)) {
+            printf("TEST FAILED: crank amplitude: %u at %u RPM\n", t->amplitude, t->rpm);
+            return false;
+        }
+    }
+
+    VR_Crank_Stop(&crank, &scaled);
+    if (scaled.amplitude != VR_AMPLITUDE_FULL || scaled.tooth_hook != NULL || scaled.sample_ticks_max != 0) {
+        printf("TEST FAILED: crank amplitude: stopped model left amplitude %u\n", scaled.amplitude);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the dip interval per cylinder count, and an engine that never catches
+  * @retval True if passed
+  */
+static bool Crank_TestCylinders(void)
+{
+    VR_Emulator_t emu;
+    VR_Crank_t crank;
+    VR_CrankConfig_t config;
+
+    for (uint32_t c = 0; c < sizeof(crank_cylinders) / sizeof(crank_cylinders[0]); c++) {
+        uint32_t interval = 2 * TRIGGER_WHEEL_TEETH / crank_cylinders[c];
+        uint16_t low = UINT16_MAX, high = 0;
+
+        VR_Crank_DefaultConfig(&config);
+        config.cylinders = crank_cylinders[c];
+        config.crank_revs = 0;
+        VR_Emu_Init(&emu, NULL);
+        if (!Crank_Run(&emu, &crank, &config, &crank_trace, 20 * TRIGGER_WHEEL_TEETH)) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i + interval < crank_trace.count; i++) {
+            const CrankTooth_t *t = &crank_trace.teeth[i];
+
+            if (t->phase != VR_CRANK_CRANKING) {
+                continue;
+            }
+            low = (t->rpm < low) ? t->rpm : low;
+            high = (t->rpm > high) ? t->rpm : high;
+            if (Crank_Differ(crank_trace.teeth[i + interval].rpm, t->rpm)) {
+                printf("TEST FAILED: crank cylinders: %u cylinders, %u RPM at tooth %lu and %u RPM %lu teeth on\n",
+                       config.cylinders, t->rpm, (unsigned long)i, crank_trace.teeth[i + interval].rpm,
+                       (unsigned long)interval);
+                return false;
+            }
+        }
+        if (crank.phase != VR_CRANK_CRANKING || high - low < config.starter_rpm / 4) {
+            printf("TEST FAILED: crank cylinders: %u cylinders %s, cranking %u-%u RPM\n",
+                   config.cylinders, VR_Crank_PhaseName(crank.phase), low, high);
+            return false;
+        }
+    }
+
+    config.cylinders = 0;
+    if (VR_Crank_Start(&crank, &emu, &config)) {
+        printf("TEST FAILED: crank cylinders: started with no cylinders\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that skipping updates matches rendering them
+  * @retval True if passed
+  */
+static bool Crank_TestSkip(void)
+{
+    VR_Emulator_t skipped, rendered;
+    VR_Crank_t skipped_crank, rendered_crank;
+    VR_CrankConfig_t config;
+    uint64_t count = 40000;
+
+    VR_Crank_DefaultConfig(&config);
+    VR_Emu_Init(&skipped, NULL);
+    VR_Emu_Init(&rendered, NULL);
+    VR_Crank_Start(&skipped_crank, &skipped, &config);
+    VR_Crank_Start(&rendered_crank, &rendered, &config);
+
+    VR_Emu_Skip(&skipped, count);
+    for (uint64_t i = 0; i < count; i++) {
+        VR_Emu_GenerateSignal(&rendered);
+    }
+    if (skipped.state.current_tooth != rendered.state.current_tooth ||
+        skipped.state.tooth_timer != rendered.state.tooth_timer ||
+        skipped_crank.time_us != rendered_crank.time_us || skipped_crank.rpm != rendered_crank.rpm ||
+        skipped_crank.teeth == 0) {
+        printf("TEST FAILED: crank skip: tooth %u at %lu us, %u RPM; rendered tooth %u at %lu us, %u RPM\n",
+               skipped.state.current_tooth, (unsigned long)skipped.state.tooth_timer, skipped_crank.rpm,
+               rendered.state.current_tooth, (unsigned long)rendered.state.tooth_timer, rendered_crank.rpm);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the CRANK command and the default emulator hand-over
+  * @retval True if passed
+  */
+static bool Crank_TestCommand(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+
+    VR_Emulator_Init();
+    VR_Emulator_SetRPM(3000);
+
+    if (!VR_Test_Command("crank", "CRANK START 6 250\r", "OK CRANK START CYL=6 RPM=250\r\n") ||
+        !VR_Test_Command("crank", "crank\r", "OK CRANK ENGAGE RPM=20 REVS=0 T=0\r\n")) {
+        return false;
+    }
+    if (!VR_Crank_IsRunning() || emu->tooth_hook == NULL || VR_Emulator_GetRPM() != VR_CRANK_MIN_RPM) {
+        printf("TEST FAILED: crank command: default emulator not cranking\n");
+        return false;
+    }
+    if (!VR_Test_Command("crank", "CRANK START 13\r", "ERR bad cylinders or starter RPM\r\n") ||
+        !VR_Test_Command("crank", "CRANK STOP\r", "OK CRANK STOP\r\n") ||
+        !VR_Test_Command("crank", "CRANK\r", "OK CRANK OFF RPM=20 REVS=0 T=0\r\n") ||
+        !VR_Test_Command("crank", "CRANK SPIN\r", "ERR unknown CRANK command\r\n")) {
+        return false;
+    }
+    if (VR_Crank_IsRunning() || emu->tooth_hook != NULL || emu->amplitude != VR_AMPLITUDE_FULL) {
+        printf("TEST FAILED: crank command: stop left the model attached\n");
+        return false;
+    }
+
+    // Revolution mode plays fixed revolutions, so it ends a start
+    if (!VR_Test_Command("crank", "CRANK START\r", "OK CRANK START CYL=4 RPM=200\r\n") ||
+        !VR_Test_Command("crank", "REV ON\r", "OK REV ON\r\n")) {
+        return false;
+    }
+    bool running = VR_Crank_IsRunning();
+    VR_Rev_Stop();
+    if (running) {
+        printf("TEST FAILED: crank command: start kept running in revolution mode\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Start an engine and render it, recording the speed of each tooth
+  * @param  emu: Emulator to drive, initialised
+  * @param  crank: Model state
+  * @param  config: Engine and starter
+  * @param  trace: Receives the teeth
+  * @param  teeth: Teeth to record, 0 to run until CRANK_IDLE_TEETH teeth at idle
+  * @retval True if the run completed
+  */
+static bool Crank_Run(VR_Emulator_t *emu, VR_Crank_t *crank, const VR_CrankConfig_t *config,
+                      CrankTrace_t *trace, uint32_t teeth)
+{
+    uint32_t idle = 0;
+
+    memset(trace, 0, sizeof(*trace));
+    if (!VR_Crank_Start(crank, emu, config)) {
+        printf("TEST FAILED: crank: configuration rejected\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < CRANK_MAX_SAMPLES; i++) {
+        uint8_t tooth = emu->state.current_tooth;
+
+        if (i == 0 || tooth != trace->teeth[trace->count - 1].tooth) {
+            CrankTooth_t *t = &trace->teeth[trace->count++];
+
+            t->rpm = crank->rpm;
+            t->amplitude = emu->amplitude;
+            t->phase = crank->phase;
+            t->tooth = tooth;
+            t->revolutions = crank->revolutions;
+            idle += (crank->phase == VR_CRANK_IDLE) ? 1u : 0u;
+            if (trace->count == CRANK_MAX_TEETH || (teeth != 0 && trace->count == teeth) ||
+                (teeth == 0 && idle == CRANK_IDLE_TEETH)) {
+                return true;
+            }
+        }
+
+        trace->rendered_us += emu->state.sample_period_us;
+        if (emu->state.sample_period_us > trace->longest_sample_us) {
+            trace->longest_sample_us = emu->state.sample_period_us;
+        }
+        VR_Emu_GenerateSignal(emu);
+    }
+
+    printf("TEST FAILED: crank: %lu teeth in %d samples\n", (unsigned long)trace->count, CRANK_MAX_SAMPLES);
+    return false;
+}
+
+/**
+  * @brief  Compare two tooth speeds, allowing for the rounding of each
+  * @param  a: Speed in RPM
+  * @param  b: Speed in RPM
+  * @retval True if they differ by more than 1 RPM
+  */
+static bool Crank_Differ(uint16_t a, uint16_t b)
+{
+    return (a > b) ? (a - b > 1) : (b - a > 1);
+}
+
@@ -0,0 +1,198 @@
+/**
+  ******************************************************************************
+  * @file           : test_cycles.c
+  * @brief          : Cycle-count profiling tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The host DWT counter only moves when a test sets it, so each run's
+  * length is exact. Checks:
+  * - VR_Cycles_Init() starts the counter and leaves every probe empty.
+  * - Count, minimum, maximum and total over a window, including a run
+  *   across the 32-bit counter wrap.
+  * - A reset from the reader empties the window, and the next record
+  *   starts a new one.
+  * - The telemetry text, its reset, and truncation to a short buffer.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_cycles.h"
+#include "test_host.h"
+#include "vr_cycles.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private function prototypes -----------------------------------------------*/
+static void Cycles_Run(uint32_t start, uint32_t cycles);
+static bool Cycles_Expect(const char *name, uint32_t count, uint32_t min, uint32_t max, uint64_t total);
+static bool Cycles_TestInit(void);
+static bool Cycles_TestWindow(void);
+static bool Cycles_TestReset(void);
+static bool Cycles_TestTelemetry(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the cycle-count profiling tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Cycles(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing cycle-count profiling...\n");
+
+    VR_Test_Record(&results, Cycles_TestInit());
+    VR_Test_Record(&results, Cycles_TestWindow());
+    VR_Test_Record(&results, Cycles_TestReset());
+    VR_Test_Record(&results, Cycles_TestTelemetry());
+
+    return VR_Test_Report(&results, "Cycle profiling");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Record one sample-ISR run of a given length
+  * @param  start: Counter value at the start of the run
+  * @param  cycles: Run length
+  * @retval None
+  */
+static void Cycles_Run(uint32_t start, uint32_t cycles)
+{
+    DWT->CYCCNT = start + cycles;
+    VR_Cycles_Record(VR_CYCLES_SAMPLE_ISR, start);
+}
+
+/**
+  * @brief  Compare the sample-ISR probe with expected statistics
+  * @param  name: Test name for the failure message
+  * @param  count: Expected runs
+  * @param  min: Expected shortest run
+  * @param  max: Expected longest run
+  * @param  total: Expected sum of the runs
+  * @retval True if the snapshot matches
+  */
+static bool Cycles_Expect(const char *name, uint32_t count, uint32_t min, uint32_t max, uint64_t total)
+{
+    VR_CycleStats_t stats;
+
+    VR_Cycles_Snapshot(VR_CYCLES_SAMPLE_ISR, &stats, false);
+    if (stats.count != count || stats.min != min || stats.max != max || stats.total != total) {
+        printf("TEST FAILED: cycles %s: n=%lu min=%lu max=%lu total=%llu, expected %lu %lu %lu %llu\n",
+               name, (unsigned long)stats.count, (unsigned long)stats.min, (unsigned long)stats.max,
+               (unsigned long long)stats.total, (unsigned long)count, (unsigned long)min,
+               (unsigned long)max, (unsigned long long)total);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check counter start-up and empty probes
+  * @retval True if passed
+  */
+static bool Cycles_TestInit(void)
+{
+    DWT->CTRL = 0;
+    DWT->CYCCNT = 12345;
+    CoreDebug->DEMCR = 0;
+    VR_Cycles_Init();
+
+    if ((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) == 0 || (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0 ||
+        DWT->CYCCNT != 0) {
+        printf("TEST FAILED: cycles init: counter not started\n");
+        return false;
+    }
+    return Cycles_Expect("init", 0, 0, 0, 0);
+}
+
+/**
+  * @brief  Check the statistics over one window
+  * @retval True if passed
+  */
+static bool Cycles_TestWindow(void)
+{
+    VR_Cycles_Init();
+
+    Cycles_Run(1000, 420);
+    Cycles_Run(5000, 380);
+    Cycles_Run(9000, 911);
+    if (!Cycles_Expect("window", 3, 380, 911, 1711)) {
+        return false;
+    }
+
+    // The counter wraps every 20 s at 216 MHz
+    Cycles_Run(0xFFFFFF00u, 0x200u);
+    return Cycles_Expect("wrap", 4, 380, 911, 1711 + 0x200);
+}
+
+/**
+  * @brief  Check windows started by the reader
+  * @retval True if passed
+  */
+static bool Cycles_TestReset(void)
+{
+    VR_CycleStats_t stats;
+
+    VR_Cycles_Init();
+    Cycles_Run(0, 500);
+    Cycles_Run(0, 700);
+
+    VR_Cycles_Snapshot(VR_CYCLES_SAMPLE_ISR, &stats, true);
+    if (stats.count != 2 || stats.total != 1200) {
+        printf("TEST FAILED: cycles reset: snapshot before the reset is wrong\n");
+        return false;
+    }
+    if (!Cycles_Expect("reset pending", 0, 0, 0, 0)) {
+        return false;
+    }
+
+    // The old minimum and maximum must not leak into the new window
+    Cycles_Run(0, 600);
+    return Cycles_Expect("new window", 1, 600, 600, 600);
+}
+
+/**
+  * @brief  Check the telemetry text
+  * @retval True if passed
+  */
+static bool Cycles_TestTelemetry(void)
+{
+    char text[128];
+    char small[12];
+
+    VR_Cycles_Init();
+    if (VR_Cycles_FormatTelemetry(text, sizeof(text)) != 0 || text[0] != '\0') {
+        printf("TEST FAILED: cycles telemetry: text without any runs\n");
+        return false;
+    }
+
+    Cycles_Run(0, 400);
+    Cycles_Run(0, 430);
+    Cycles_Run(0, 812);
+    uint32_t len = VR_Cycles_FormatTelemetry(text, sizeof(text));
+    if (strcmp(text, "CYC isr n=3 min=400 avg=547 max=812\r\n") != 0 || len != strlen(text)) {
+        printf("TEST FAILED: cycles telemetry: \"%s\"\n", text);
+        return false;
+    }
+
+    // Reported windows are reset
+    if (VR_Cycles_FormatTelemetry(text, sizeof(text)) != 0) {
+        printf("TEST FAILED: cycles telemetry: window not reset after reporting\n");
+        return false;
+    }
+
+    Cycles_Run(0, 400);
+    len = VR_Cycles_FormatTelemetry(small, sizeof(small));
+    if (len != sizeof(small) - 1 || strlen(small) != len || strncmp(small, "CYC isr n=1", len) != 0) {
+        printf("TEST FAILED: cycles telemetry: truncated text \"%s\"\n", small);
+        return false;
+    }
+
+    return true;
+}
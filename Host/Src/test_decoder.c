@@ -0,0 +1,168 @@
+/**
+  ******************************************************************************
+  * @file           : test_decoder.c
+  * @brief          : Decoder-based timing accuracy tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each RPM point is rendered for DECODER_SWEEP_REVOLUTIONS revolutions and
+  * fed straight into the reference decoder. A point passes when the decoder
+  * syncs within the first two revolutions, never loses sync, every tooth
+  * period is within one sample period of nominal, and every whole
+  * revolution is within max_rev_err_pct of the commanded RPM.
+  *
+  * A zero-RPM run is also checked to produce no teeth at all.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_decoder.h"
+#include "test_host.h"
+#include "test_host.h"
+#include "vr_decoder.h"
+#include "vr_host_sim.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <math.h>
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim6;
+
+/* Private variables ---------------------------------------------------------*/
+static VR_Profile_t decoder_profile;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Decoder_RunPoint(float rpm, VR_Decoder_t *dec);
+static bool Decoder_CheckPoint(float rpm, const VR_Decoder_t *dec, const DecoderSweepConfig_t *config);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Decode fixed-RPM runs over a range of speeds
+  * @param  config: Sweep range and accuracy limits
+  * @retval Test results, one test per RPM point plus the zero-RPM check
+  */
+TestResults_t VR_Test_DecoderSweep(const DecoderSweepConfig_t *config)
+{
+    TestResults_t results = {0};
+    VR_Decoder_t dec;
+    uint32_t worst_tooth_rpm = 0, worst_rev_rpm = 0;
+    double worst_tooth = 0.0, worst_rev = 0.0, mean_sum = 0.0;
+    uint32_t points = 0;
+
+    printf("Testing decoder sweep %.0f-%.0f RPM in %.0f RPM steps (limit %.2f%%/rev)...\n",
+           config->start_rpm, config->end_rpm, config->step_rpm, config->max_rev_err_pct);
+
+    // A stopped wheel must not produce teeth
+    Decoder_RunPoint(0.0f, &dec);
+    if (dec.stats.teeth != 0) {
+        printf("TEST FAILED: 0 RPM: decoder saw %lu teeth\n", (unsigned long)dec.stats.teeth);
+    }
+    VR_Test_Record(&results, dec.stats.teeth == 0);
+
+    for (float rpm = config->start_rpm; rpm <= config->end_rpm + 0.5f; rpm += config->step_rpm) {
+        bool pass = Decoder_RunPoint(rpm, &dec) && Decoder_CheckPoint(rpm, &dec, config);
+
+        VR_Test_Record(&results, pass);
+
+        if (dec.stats.tooth_err_max_pct > worst_tooth) {
+            worst_tooth = dec.stats.tooth_err_max_pct;
+            worst_tooth_rpm = (uint32_t)rpm;
+        }
+        if (dec.stats.rev_err_max_pct > worst_rev) {
+            worst_rev = dec.stats.rev_err_max_pct;
+            worst_rev_rpm = (uint32_t)rpm;
+        }
+        mean_sum += VR_Decoder_MeanRevErrorPct(&dec);
+        points++;
+    }
+
+    printf("  %lu points: mean rev error %.4f%%, worst rev %.4f%% @ %lu RPM, "
+           "worst tooth %.3f%% @ %lu RPM\n",
+           (unsigned long)points, (points > 0) ? mean_sum / points : 0.0,
+           worst_rev, (unsigned long)worst_rev_rpm, worst_tooth, (unsigned long)worst_tooth_rpm);
+
+    return VR_Test_Report(&results, "Decoder sweep");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Render one fixed-RPM run through the decoder
+  * @param  rpm: Commanded RPM
+  * @param  dec: Decoder, initialised here
+  * @retval True if the run was rendered
+  */
+static bool Decoder_RunPoint(float rpm, VR_Decoder_t *dec)
+{
+    VR_DecoderConfig_t config = {
+        VR_DECODER_DEFAULT_HYSTERESIS, VR_DECODER_DEFAULT_GAP_RATIO, rpm
+    };
+    char text[32];
+    uint64_t ticks;
+
+    snprintf(text, sizeof(text), "0:%.1f", rpm);
+    if (!VR_Profile_Parse(&decoder_profile, text)) {
+        printf("TEST FAILED: %.0f RPM: invalid profile\n", rpm);
+        return false;
+    }
+
+    if (rpm > 0.0f) {
+        ticks = (uint64_t)(DECODER_SWEEP_REVOLUTIONS * 60.0 * VR_SAMPLE_TIMER_BASE_FREQ / rpm);
+    } else {
+        ticks = VR_SAMPLE_TIMER_BASE_FREQ / 10;
+    }
+
+    VR_Decoder_Init(dec, &config);
+    VR_HostSim_Run(&decoder_profile, ticks, VR_HOST_CONTROL_PERIOD_TICKS, VR_Decoder_Sink, dec);
+
+    return true;
+}
+
+/**
+  * @brief  Check one decoded run against the commanded RPM
+  * @param  rpm: Commanded RPM
+  * @param  dec: Decoder after the run
+  * @param  config: Accuracy limits
+  * @retval True if the run meets every limit
+  */
+static bool Decoder_CheckPoint(float rpm, const VR_Decoder_t *dec, const DecoderSweepConfig_t *config)
+{
+    const VR_DecoderStats_t *st = &dec->stats;
+    double rev_ticks = 60.0 * VR_SAMPLE_TIMER_BASE_FREQ / rpm;
+    double tooth_ticks = rev_ticks / TRIGGER_WHEEL_TEETH;
+
+    // Edges can only move on sample boundaries, so one tooth period may be
+    // off by up to one sample period in either direction
+    uint32_t sample_ticks = __HAL_TIM_GET_AUTORELOAD(&htim6) + 1;
+    double tooth_limit_pct = (sample_ticks + 1) / tooth_ticks * 100.0;
+
+    if (st->first_sync_tick == 0 || st->first_sync_tick > (uint64_t)(2.0 * rev_ticks)) {
+        printf("TEST FAILED: %.0f RPM: no sync within 2 revolutions\n", rpm);
+        return false;
+    }
+    if (st->sync_losses != 0) {
+        printf("TEST FAILED: %.0f RPM: %lu sync losses\n", rpm, (unsigned long)st->sync_losses);
+        return false;
+    }
+    if (st->revolutions < DECODER_SWEEP_REVOLUTIONS - 2) {
+        printf("TEST FAILED: %.0f RPM: only %lu revolutions decoded\n",
+               rpm, (unsigned long)st->revolutions);
+        return false;
+    }
+    if (st->rev_err_max_pct > config->max_rev_err_pct) {
+        printf("TEST FAILED: %.0f RPM: revolution error %.3f%% (limit %.3f%%)\n",
+               rpm, st->rev_err_max_pct, config->max_rev_err_pct);
+        return false;
+    }
+    if (st->tooth_err_max_pct > tooth_limit_pct) {
+        printf("TEST FAILED: %.0f RPM: tooth error %.3f%% (limit %.3f%%)\n",
+               rpm, st->tooth_err_max_pct, tooth_limit_pct);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,379 @@
+/**
+  ******************************************************************************
+  * @file           : test_digital.c
+  * @brief          : Digital output timing tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The default emulator and the TIM2 digital output run together over an
+  * RPM profile: steady low and high speed, ramps with a new set point every
+  * millisecond, a stop and a restart. TIM2 starts close to the end of its
+  * range so the counter wraps during the run. Each TIM6 sample lets TIM2
+  * run to the sample time plus the callback latency, then calls the update
+  * callback as on target.
+  *
+  * The analog output counts as high while it leaves the DC level. Its
+  * transitions are sampled, so they lag the digital edges by up to two
+  * samples. After a resync the digital output may instead follow a level
+  * change VR_DIGITAL_MIN_LEAD_TICKS after the callback. Checks:
+  * - Both outputs make the same transitions in the same order, within those
+  *   bounds, and the digital output ends low.
+  * - Between resyncs, rising edges are exactly one tooth period apart in
+  *   TIM2 ticks.
+  * - Tooth widths are exactly 4/20 or 12/20 of the period, and the wide
+  *   tooth comes round every TRIGGER_WHEEL_TEETH teeth.
+  * - The edge planner orders edges across the wide tooth and the TIM2 wrap.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_digital.h"
+#include "test_host.h"
+#include "vr_digital_output.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+
+/* Private define ------------------------------------------------------------*/
+#define DIGITAL_DC_LEVEL            ((uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET))
+#define DIGITAL_CONTROL_TICKS       (1000u * VR_DIGITAL_TICKS_PER_US)   // 1 ms set point rate
+#define DIGITAL_MIN_CHECKED         1000    // Fewest edge intervals each check must cover
+#define DIGITAL_PITCH_DEG           ((uint32_t)(REGULAR_TOOTH_ANGLE + REGULAR_TOOTH_GAP))
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint32_t duration_ms;
+    uint16_t rpm_from;
+    uint16_t rpm_to;
+} DigitalSegment_t;
+
+typedef struct {
+    uint32_t time;                  // TIM2 count
+    uint8_t level;
+    uint32_t resyncs;               // VR_Digital_GetResyncs() at the edge
+    uint32_t period_us;             // Scheduled tooth period at the edge
+    uint32_t sample_us;             // Emulator sample period at the edge
+} DigitalEdge_t;
+
+typedef struct {
+    DigitalEdge_t *digital;
+    uint32_t num_digital;
+    DigitalEdge_t *analog;
+    uint32_t num_analog;
+    uint32_t period_us;             // Tooth period the schedule follows since the last sample
+    bool overflow;
+} DigitalLog_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const DigitalSegment_t digital_profile[] = {
+    {500, 300, 300},
+    {300, 300, MAX_RPM},
+    {300, MAX_RPM, MAX_RPM},
+    {200, MAX_RPM, 2000},
+    {50, 0, 0},
+    {200, 1500, 1500},
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Digital_Run(DigitalLog_t *log);
+static void Digital_Record(DigitalLog_t *log, bool digital, uint32_t time, uint8_t level);
+static void Digital_OnEdge(void *ctx, uint32_t count, uint32_t level);
+static bool Digital_TestPairing(const DigitalLog_t *log);
+static bool Digital_TestSpacing(const DigitalLog_t *log);
+static bool Digital_TestWidths(const DigitalLog_t *log);
+static bool Digital_TestPlanner(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the digital output timing tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_DigitalOutput(void)
+{
+    TestResults_t results = {0};
+    DigitalLog_t log = {0};
+
+    printf("Testing digital output against the analog output...\n");
+
+    log.digital = malloc(DIGITAL_TEST_MAX_EDGES * sizeof(DigitalEdge_t));
+    log.analog = malloc(DIGITAL_TEST_MAX_EDGES * sizeof(DigitalEdge_t));
+
+    VR_Test_ResetDefault();
+    bool ran = (log.digital != NULL && log.analog != NULL) && Digital_Run(&log);
+    if (!ran) {
+        printf("TEST FAILED: digital output run: out of memory or edge log full\n");
+    } else {
+        printf("  %u edges, %u resyncs\n", log.num_digital, VR_Digital_GetResyncs());
+    }
+
+    VR_Test_Record(&results, ran && Digital_TestPairing(&log));
+    VR_Test_Record(&results, ran && Digital_TestSpacing(&log));
+    VR_Test_Record(&results, ran && Digital_TestWidths(&log));
+    VR_Test_Record(&results, Digital_TestPlanner());
+
+    free(log.digital);
+    free(log.analog);
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Digital output");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Run the profile and log the transitions of both outputs
+  * @param  log: Edge log with allocated arrays
+  * @retval True unless a log overflowed
+  */
+static bool Digital_Run(DigitalLog_t *log)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    uint32_t sample = 0u - DIGITAL_TEST_WRAP_MS * DIGITAL_CONTROL_TICKS;
+    uint64_t elapsed = 0;
+    uint8_t analog_level = 0;
+
+    htim2.Instance->CNT = sample;
+    Host_TIM2_SetEdgeHook(Digital_OnEdge, log);
+    VR_Digital_Start();
+
+    for (uint32_t s = 0; s < sizeof(digital_profile) / sizeof(digital_profile[0]); s++) {
+        const DigitalSegment_t *seg = &digital_profile[s];
+
+        for (uint32_t ms = 0; ms < seg->duration_ms; ms++) {
+            int32_t span = (int32_t)seg->rpm_to - (int32_t)seg->rpm_from;
+            VR_Emulator_SetRPM((uint16_t)(seg->rpm_from + span * (int32_t)ms / (int32_t)seg->duration_ms));
+
+            uint64_t control_end = elapsed + DIGITAL_CONTROL_TICKS;
+            while (elapsed < control_end) {
+                uint32_t step = VR_Emu_GetSamplePeriod(emu) * VR_DIGITAL_TICKS_PER_US;
+
+                sample += step;
+                elapsed += step;
+                Host_TIM2_RunTo(sample + VR_DIGITAL_SAMPLE_LATENCY_TICKS);
+                HAL_TIM_PeriodElapsedCallback(&htim6);
+                log->period_us = emu->state.tooth_period_us;
+
+                uint8_t level = (emu->state.dac_output != DIGITAL_DC_LEVEL);
+                if (level != analog_level) {
+                    analog_level = level;
+                    Digital_Record(log, false, sample, level);
+                }
+            }
+        }
+    }
+
+    VR_Digital_Stop();
+    Host_TIM2_SetEdgeHook(NULL, NULL);
+
+    return !log->overflow;
+}
+
+/**
+  * @brief  Append a transition to one of the edge logs
+  * @param  log: Edge log
+  * @param  digital: True for the digital output, false for the analog output
+  * @param  time: TIM2 count of the transition
+  * @param  level: New level
+  * @retval None
+  */
+static void Digital_Record(DigitalLog_t *log, bool digital, uint32_t time, uint8_t level)
+{
+    DigitalEdge_t *edges = digital ? log->digital : log->analog;
+    uint32_t *count = digital ? &log->num_digital : &log->num_analog;
+
+    if (*count >= DIGITAL_TEST_MAX_EDGES) {
+        log->overflow = true;
+        return;
+    }
+
+    edges[*count] = (DigitalEdge_t){
+        time, level, VR_Digital_GetResyncs(), log->period_us, VR_Emulator_GetDefault()->state.sample_period_us
+    };
+    (*count)++;
+}
+
+/**
+  * @brief  TIM2 channel 4 edge hook
+  * @param  ctx: Edge log
+  * @param  count: TIM2 count of the edge
+  * @param  level: New output level
+  * @retval None
+  */
+static void Digital_OnEdge(void *ctx, uint32_t count, uint32_t level)
+{
+    Digital_Record(ctx, true, count, (uint8_t)level);
+}
+
+/**
+  * @brief  Match digital edges to analog transitions one for one
+  * @param  log: Edge log
+  * @retval True if every pair agrees in direction and timing
+  */
+static bool Digital_TestPairing(const DigitalLog_t *log)
+{
+    const int32_t min_lag = -(int32_t)(VR_DIGITAL_MIN_LEAD_TICKS + VR_DIGITAL_SAMPLE_LATENCY_TICKS);
+
+    if (log->num_digital != log->num_analog) {
+        printf("TEST FAILED: digital output made %u edges, analog output %u\n",
+               log->num_digital, log->num_analog);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < log->num_digital; i++) {
+        const DigitalEdge_t *d = &log->digital[i];
+        const DigitalEdge_t *a = &log->analog[i];
+        int32_t lag = (int32_t)(a->time - d->time);
+        int32_t max_lag = 2 * (int32_t)(a->sample_us * VR_DIGITAL_TICKS_PER_US);
+
+        if (d->level != a->level || lag < min_lag || lag > max_lag) {
+            printf("TEST FAILED: edge %u: digital %s at %u, analog %s at %u\n", i,
+                   d->level ? "rise" : "fall", d->time, a->level ? "rise" : "fall", a->time);
+            return false;
+        }
+    }
+
+    if (log->num_digital == 0 || log->digital[log->num_digital - 1].level != 0) {
+        printf("TEST FAILED: digital output not low after the run\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Check rising edge spacing between resyncs
+  * @param  log: Edge log
+  * @retval True if every interval is exactly one tooth period
+  */
+static bool Digital_TestSpacing(const DigitalLog_t *log)
+{
+    const DigitalEdge_t *e = log->digital;
+    uint32_t checked = 0;
+
+    for (uint32_t j = 3; j < log->num_digital; j++) {
+        // Both rises planned by one resync, and neither is its first edge
+        if (e[j].level != 1 || e[j - 3].resyncs != e[j].resyncs) {
+            continue;
+        }
+
+        uint32_t expected = e[j].period_us * VR_DIGITAL_TICKS_PER_US;
+        if (e[j].time - e[j - 2].time != expected) {
+            printf("TEST FAILED: rise at %u is %u ticks after the last, expected %u\n",
+                   e[j].time, e[j].time - e[j - 2].time, expected);
+            return false;
+        }
+        checked++;
+    }
+
+    if (checked < DIGITAL_MIN_CHECKED) {
+        printf("TEST FAILED: only %u tooth periods checked\n", checked);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Check tooth widths and the wide tooth position between resyncs
+  * @param  log: Edge log
+  * @retval True if every width is exact and wide teeth are one revolution apart
+  */
+static bool Digital_TestWidths(const DigitalLog_t *log)
+{
+    const DigitalEdge_t *e = log->digital;
+    uint32_t checked = 0, wide = 0;
+    uint32_t last_wide = 0;
+    bool have_wide = false;
+
+    for (uint32_t j = 1; j + 1 < log->num_digital; j++) {
+        if (e[j].level != 1 || e[j - 1].resyncs != e[j + 1].resyncs) {
+            continue;
+        }
+
+        uint64_t period = (uint64_t)e[j].period_us * VR_DIGITAL_TICKS_PER_US;
+        uint32_t regular = (uint32_t)(period * (uint32_t)REGULAR_TOOTH_ANGLE / DIGITAL_PITCH_DEG);
+        uint32_t missing = (uint32_t)(period * (uint32_t)MISSING_TOOTH_ANGLE / DIGITAL_PITCH_DEG);
+        uint32_t width = e[j + 1].time - e[j].time;
+
+        if (width != regular && width != missing) {
+            printf("TEST FAILED: tooth at %u is %u ticks wide, expected %u or %u\n",
+                   e[j].time, width, regular, missing);
+            return false;
+        }
+        checked++;
+
+        if (width == missing) {
+            // Rises alternate with falls, so a revolution is 2 * TRIGGER_WHEEL_TEETH edges
+            if (have_wide && e[last_wide].resyncs == e[j].resyncs &&
+                j - last_wide != 2u * TRIGGER_WHEEL_TEETH) {
+                printf("TEST FAILED: wide teeth %u edges apart\n", j - last_wide);
+                return false;
+            }
+            last_wide = j;
+            have_wide = true;
+            wide++;
+        }
+    }
+
+    if (checked < DIGITAL_MIN_CHECKED || wide == 0) {
+        printf("TEST FAILED: only %u teeth (%u wide) checked\n", checked, wide);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Plan edges from the last regular tooth across the wide tooth,
+  *         with the TIM2 count wrapping in between
+  * @retval True if every edge lands where expected
+  */
+static bool Digital_TestPlanner(void)
+{
+    const uint32_t period_us = 1000;
+    const uint32_t period = period_us * VR_DIGITAL_TICKS_PER_US;
+    const uint32_t sample = 0xFFFF0000u;
+    VR_SensorState_t state;
+    VR_EdgePlanner_t planner;
+
+    memset(&state, 0, sizeof(state));
+    state.current_tooth = MISSING_TOOTH_INDEX - 1;
+    state.tooth_timer = 100;
+    state.tooth_period_us = period_us;
+
+    uint32_t start = sample - state.tooth_timer * VR_DIGITAL_TICKS_PER_US;
+    const uint32_t expected[] = {
+        start + period / 5,                 // Fall, last regular tooth
+        start + period,                     // Rise, wide tooth (count wraps)
+        start + period + period * 3 / 5,    // Fall, wide tooth
+        start + 2 * period,                 // Rise, tooth 0
+        start + 2 * period + period / 5,    // Fall, tooth 0
+    };
+
+    VR_Edge_Anchor(&planner, &state, sample, sample);
+    for (uint32_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        uint32_t edge = VR_Edge_Next(&planner);
+        if (edge != expected[i]) {
+            printf("TEST FAILED: planned edge %u at %u, expected %u\n", i, edge, expected[i]);
+            return false;
+        }
+    }
+
+    // An edge exactly at the anchor limit is already past
+    VR_Edge_Anchor(&planner, &state, sample, expected[0]);
+    if (VR_Edge_Next(&planner) != expected[1]) {
+        printf("TEST FAILED: edge at the anchor limit was planned again\n");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,223 @@
+/**
+  ******************************************************************************
+  * @file           : test_dma.c
+  * @brief          : Cache and DMA buffer tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Host memory is coherent, so these tests check what would be asked of
+  * the MPU and the cache rather than any data. Checks:
+  * - VR_DMA_Init() maps SRAM2 as one non-cacheable, non-executable region
+  *   over the default map and enables both caches.
+  * - Only ranges wholly inside that region count as non-cacheable.
+  * - Clean rounds the range out to whole lines; invalidate refuses a
+  *   range that is not whole lines; neither touches the cache for the
+  *   non-cacheable region.
+  * - A loopback capture invalidates its whole buffer before the transfer
+  *   and again when it completes.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_dma.h"
+#include "test_host.h"
+#include "vr_dma_buffer.h"
+#include "vr_loopback.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t dma_test_buffer[4 * VR_DMA_CACHE_LINE] VR_DMA_CACHED_BUFFER;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Dma_TestInit(void);
+static bool Dma_TestRegion(void);
+static bool Dma_TestClean(void);
+static bool Dma_TestInvalidate(void);
+static bool Dma_TestLoopback(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the cache and DMA buffer tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_DmaBuffer(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing cache and DMA buffers...\n");
+
+    VR_Test_ResetDefault();
+    VR_Test_Record(&results, Dma_TestInit());
+    VR_Test_Record(&results, Dma_TestRegion());
+    VR_Test_Record(&results, Dma_TestClean());
+    VR_Test_Record(&results, Dma_TestInvalidate());
+    VR_Test_Record(&results, Dma_TestLoopback());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Cache and DMA buffer");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the MPU region and the cache enables
+  * @retval True if passed
+  */
+static bool Dma_TestInit(void)
+{
+    memset(&host_cache, 0, sizeof(host_cache));
+    VR_DMA_Init();
+
+    const MPU_Region_InitTypeDef *r = &host_cache.region;
+
+    if (r->Enable != MPU_REGION_ENABLE || r->BaseAddress != VR_DMA_REGION_BASE ||
+        r->Size != MPU_REGION_SIZE_16KB || r->SubRegionDisable != 0) {
+        printf("TEST FAILED: dma init: region 0x%08lx size code %u\n",
+               (unsigned long)r->BaseAddress, (unsigned)r->Size);
+        return false;
+    }
+    // Normal memory, not cached, never executed
+    if (r->TypeExtField != MPU_TEX_LEVEL1 || r->IsCacheable != MPU_ACCESS_NOT_CACHEABLE ||
+        r->IsBufferable != MPU_ACCESS_NOT_BUFFERABLE || r->DisableExec != MPU_INSTRUCTION_ACCESS_DISABLE) {
+        printf("TEST FAILED: dma init: region attributes TEX=%u C=%u B=%u XN=%u\n",
+               (unsigned)r->TypeExtField, (unsigned)r->IsCacheable, (unsigned)r->IsBufferable,
+               (unsigned)r->DisableExec);
+        return false;
+    }
+    if ((host_cache.mpu_control & MPU_PRIVILEGED_DEFAULT) == 0) {
+        printf("TEST FAILED: dma init: MPU enabled without the default map\n");
+        return false;
+    }
+    if (!host_cache.icache_enabled || !host_cache.dcache_enabled) {
+        printf("TEST FAILED: dma init: caches not enabled\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check which ranges count as non-cacheable
+  * @retval True if passed
+  */
+static bool Dma_TestRegion(void)
+{
+    const uint8_t *base = (const uint8_t *)(uintptr_t)VR_DMA_REGION_BASE;
+
+    struct {
+        const void *buffer;
+        uint32_t size;
+        bool expected;
+    } cases[] = {
+        {base, VR_DMA_REGION_SIZE, true},
+        {base + 256, 64, true},
+        {base + VR_DMA_REGION_SIZE - 32, 32, true},
+        {base + VR_DMA_REGION_SIZE - 32, 64, false},     // Runs past the end
+        {base - 32, 64, false},                         // Starts before it
+        {base, VR_DMA_REGION_SIZE + 32, false},
+        {dma_test_buffer, sizeof(dma_test_buffer), false},
+    };
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (VR_DMA_IsNonCacheable(cases[i].buffer, cases[i].size) != cases[i].expected) {
+            printf("TEST FAILED: dma region: case %lu\n", (unsigned long)i);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the range a clean covers
+  * @retval True if passed
+  */
+static bool Dma_TestClean(void)
+{
+    uintptr_t line = (uintptr_t)dma_test_buffer;
+
+    memset(&host_cache, 0, sizeof(host_cache));
+
+    // Bytes 5 to 44 touch the first two lines
+    VR_DMA_Clean(dma_test_buffer + 5, 40);
+    if (host_cache.clean_calls != 1 || host_cache.clean_addr != line ||
+        host_cache.clean_size != 2 * (int32_t)VR_DMA_CACHE_LINE) {
+        printf("TEST FAILED: dma clean: %lu calls, offset %ld size %ld\n",
+               (unsigned long)host_cache.clean_calls, (long)(host_cache.clean_addr - line),
+               (long)host_cache.clean_size);
+        return false;
+    }
+
+    // Exactly one line
+    VR_DMA_Clean(dma_test_buffer + VR_DMA_CACHE_LINE, VR_DMA_CACHE_LINE);
+    if (host_cache.clean_addr != line + VR_DMA_CACHE_LINE || host_cache.clean_size != (int32_t)VR_DMA_CACHE_LINE) {
+        printf("TEST FAILED: dma clean: one aligned line widened to %ld bytes\n", (long)host_cache.clean_size);
+        return false;
+    }
+
+    VR_DMA_Clean(dma_test_buffer, 0);
+    VR_DMA_Clean((const void *)(uintptr_t)VR_DMA_REGION_BASE, 64);
+    if (host_cache.clean_calls != 2) {
+        printf("TEST FAILED: dma clean: empty or non-cacheable range cleaned\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check which ranges an invalidate accepts
+  * @retval True if passed
+  */
+static bool Dma_TestInvalidate(void)
+{
+    memset(&host_cache, 0, sizeof(host_cache));
+
+    if (VR_DMA_Invalidate(dma_test_buffer + 4, 2 * VR_DMA_CACHE_LINE) ||
+        VR_DMA_Invalidate(dma_test_buffer, VR_DMA_CACHE_LINE + 4) || host_cache.invalidate_calls != 0) {
+        printf("TEST FAILED: dma invalidate: partial line accepted\n");
+        return false;
+    }
+
+    if (!VR_DMA_Invalidate(dma_test_buffer, sizeof(dma_test_buffer)) || host_cache.invalidate_calls != 1 ||
+        host_cache.invalidate_addr != (uintptr_t)dma_test_buffer ||
+        host_cache.invalidate_size != (int32_t)sizeof(dma_test_buffer)) {
+        printf("TEST FAILED: dma invalidate: whole lines not invalidated\n");
+        return false;
+    }
+
+    if (!VR_DMA_Invalidate((void *)(uintptr_t)VR_DMA_REGION_BASE, 64) || host_cache.invalidate_calls != 1) {
+        printf("TEST FAILED: dma invalidate: non-cacheable range invalidated\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the loopback capture's cache maintenance
+  * @retval True if passed
+  */
+static bool Dma_TestLoopback(void)
+{
+    uint32_t count;
+    const uint16_t *samples = VR_Loopback_GetSamples(&count);
+    bool passed = true;
+
+    memset(&host_cache, 0, sizeof(host_cache));
+
+    // The host capture runs to completion inside VR_Loopback_Start()
+    if (VR_Loopback_Start(VR_LOOPBACK_MAX_RATE) != HAL_OK || !VR_Loopback_IsComplete()) {
+        printf("TEST FAILED: dma loopback: capture did not complete\n");
+        passed = false;
+    } else if (host_cache.invalidate_calls != 2 || host_cache.invalidate_addr != (uintptr_t)samples ||
+               host_cache.invalidate_size != (int32_t)(count * sizeof(samples[0]))) {
+        printf("TEST FAILED: dma loopback: %lu invalidates, last %ld bytes\n",
+               (unsigned long)host_cache.invalidate_calls, (long)host_cache.invalidate_size);
+        passed = false;
+    }
+
+    return passed;
+}
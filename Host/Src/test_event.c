@@ -0,0 +1,226 @@
+/**
+  ******************************************************************************
+  * @file           : test_event.c
+  * @brief          : Main loop event and load tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each WFI runs a hook that plays the part of the interrupt ending the
+  * sleep: it advances the host cycle counter by the sleep length and, on
+  * a chosen wake-up, posts events. Checks:
+  * - Pending events are returned at once, without sleeping, and events
+  *   posted separately are taken together.
+  * - With nothing pending the loop sleeps until an interrupt posts, and
+  *   wake-ups that post nothing do not return.
+  * - Idle cycles, elapsed cycles and the LOAD telemetry line over a window.
+  * - The event sources: a potentiometer conversion sets the target RPM,
+  *   and a command line is reported complete only at its end.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_event.h"
+#include "test_host.h"
+#include "vr_event.h"
+#include "vr_cycles.h"
+#include "vr_command.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint32_t sleep_cycles;          // Length of each sleep
+    uint32_t post_on;               // Wake-up that posts, counted from 1
+    uint32_t events;                // Events it posts
+    uint32_t sleeps;                // Sleeps so far
+} Event_Sleeper_t;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Event_Sleep(void *ctx);
+static bool Event_TestPending(void);
+static bool Event_TestSleep(void);
+static bool Event_TestLoad(void);
+static bool Event_TestSources(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the main loop event and load tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Events(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing main loop events and CPU load...\n");
+
+    VR_Test_Record(&results, Event_TestPending());
+    VR_Test_Record(&results, Event_TestSleep());
+    VR_Test_Record(&results, Event_TestLoad());
+    VR_Test_Record(&results, Event_TestSources());
+    Host_SetSleepHook(NULL, NULL);
+
+    return VR_Test_Report(&results, "Event and load");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Sleep hook: advance the cycle counter and post on one wake-up
+  * @param  ctx: Event_Sleeper_t
+  * @retval None
+  */
+static void Event_Sleep(void *ctx)
+{
+    Event_Sleeper_t *sleeper = ctx;
+
+    DWT->CYCCNT += sleeper->sleep_cycles;
+    if (++sleeper->sleeps == sleeper->post_on) {
+        VR_Event_Post(sleeper->events);
+    }
+}
+
+/**
+  * @brief  Check that pending events are returned without sleeping
+  * @retval True if passed
+  */
+static bool Event_TestPending(void)
+{
+    Event_Sleeper_t sleeper = {100, 1, VR_EVENT_TICK, 0};
+    VR_Load_t load;
+
+    VR_Cycles_Init();
+    VR_Event_Init();
+    Host_SetSleepHook(Event_Sleep, &sleeper);
+
+    VR_Event_Post(VR_EVENT_POT);
+    VR_Event_Post(VR_EVENT_COMMAND);
+    VR_Event_Post(VR_EVENT_POT);
+
+    uint32_t events = VR_Event_Wait();
+    if (events != (VR_EVENT_POT | VR_EVENT_COMMAND) || sleeper.sleeps != 0) {
+        printf("TEST FAILED: events pending: got 0x%lx after %lu sleeps\n",
+               (unsigned long)events, (unsigned long)sleeper.sleeps);
+        return false;
+    }
+
+    VR_Event_GetLoad(&load, false);
+    if (load.passes != 1 || load.wakeups != 0 || load.idle != 0) {
+        printf("TEST FAILED: events pending: pass=%lu wake=%lu idle=%lu\n",
+               (unsigned long)load.passes, (unsigned long)load.wakeups, (unsigned long)load.idle);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that the loop sleeps until an interrupt posts
+  * @retval True if passed
+  */
+static bool Event_TestSleep(void)
+{
+    Event_Sleeper_t sleeper = {2160, 3, VR_EVENT_TICK, 0};
+    VR_Load_t load;
+
+    VR_Cycles_Init();
+    VR_Event_Init();
+    Host_SetSleepHook(Event_Sleep, &sleeper);
+
+    // The first two wake-ups are interrupts with nothing for the main loop
+    uint32_t events = VR_Event_Wait();
+    VR_Event_GetLoad(&load, false);
+    if (events != VR_EVENT_TICK || sleeper.sleeps != 3 || load.wakeups != 3 || load.idle != 3 * 2160u) {
+        printf("TEST FAILED: events sleep: got 0x%lx after %lu sleeps, idle %lu\n",
+               (unsigned long)events, (unsigned long)sleeper.sleeps, (unsigned long)load.idle);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the load window and its telemetry line
+  * @retval True if passed
+  */
+static bool Event_TestLoad(void)
+{
+    Event_Sleeper_t sleeper = {0, 1, VR_EVENT_TICK, 0};
+    char text[96];
+    VR_Load_t load;
+
+    VR_Cycles_Init();
+    DWT->CYCCNT = 0xFFFF0000u;          // The window crosses the counter wrap
+    VR_Event_Init();
+    Host_SetSleepHook(Event_Sleep, &sleeper);
+
+    // Four passes: 2500 cycles of work, then 7500 asleep
+    for (uint32_t i = 0; i < 4; i++) {
+        DWT->CYCCNT += 2500;
+        sleeper.sleep_cycles = 7500;
+        sleeper.sleeps = 0;
+        VR_Event_Wait();
+    }
+
+    VR_Event_GetLoad(&load, false);
+    if (load.elapsed != 40000 || load.idle != 30000 || load.wakeups != 4 || load.passes != 4) {
+        printf("TEST FAILED: events load: elapsed=%lu idle=%lu wake=%lu pass=%lu\n",
+               (unsigned long)load.elapsed, (unsigned long)load.idle, (unsigned long)load.wakeups,
+               (unsigned long)load.passes);
+        return false;
+    }
+
+    uint32_t len = VR_Event_FormatLoad(text, sizeof(text));
+    if (strcmp(text, "LOAD cpu=25.0% idle=30000 wake=4 pass=4\r\n") != 0 || len != strlen(text)) {
+        printf("TEST FAILED: events load: \"%s\"\n", text);
+        return false;
+    }
+
+    // Reporting starts a new window
+    DWT->CYCCNT += 1000;
+    VR_Event_GetLoad(&load, false);
+    if (load.elapsed != 1000 || load.idle != 0 || load.wakeups != 0 || load.passes != 0) {
+        printf("TEST FAILED: events load: window not reset after reporting\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the potentiometer and command event sources
+  * @retval True if passed
+  */
+static bool Event_TestSources(void)
+{
+    VR_Emulator_t emu;
+    char reply[VR_COMMAND_REPLY_MAX];
+    const char *line = "SHAPE\n";
+
+    VR_Emu_Init(&emu, NULL);
+    VR_Emu_SetPotentiometer(&emu, 2048);
+    if (VR_Emu_GetRPM(&emu) != (uint16_t)(2048u * MAX_RPM / (ADC_RESOLUTION - 1))) {
+        printf("TEST FAILED: events potentiometer: %u RPM\n", VR_Emu_GetRPM(&emu));
+        return false;
+    }
+    VR_Emu_SetPotentiometer(&emu, 0xFFFF);
+    if (VR_Emu_GetRPM(&emu) != MAX_RPM) {
+        printf("TEST FAILED: events potentiometer: out of range reading gave %u RPM\n", VR_Emu_GetRPM(&emu));
+        return false;
+    }
+
+    for (const char *p = line; *p != '\0'; p++) {
+        bool complete = VR_Command_RxByte((uint8_t)*p);
+
+        if (complete != (p[1] == '\0')) {
+            printf("TEST FAILED: events command: line reported complete at byte %ld\n", (long)(p - line));
+            return false;
+        }
+    }
+    if (!VR_Command_Poll(reply, sizeof(reply)) || VR_Command_Poll(reply, sizeof(reply))) {
+        printf("TEST FAILED: events command: line not executed exactly once\n");
+        return false;
+    }
+    return true;
+}
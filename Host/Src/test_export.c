@@ -0,0 +1,343 @@
+/**
+  ******************************************************************************
+  * @file           : test_export.c
+  * @brief          : Waveform export tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each export is written to a temporary file through VR_Export_Open(),
+  * VR_Export_Sink() and VR_Export_Close(), as vr_export does, and read
+  * back. Checks:
+  * - The WAV header: RIFF and data sizes, PCM mono 16-bit, sample rate,
+  *   byte rate and block align, at 100 kHz and at 48 kHz.
+  * - Raw output is each DAC code as a little-endian 16-bit word, one per
+  *   TIM6 tick at 100 kHz.
+  * - CSV lines at 48 kHz carry exact timestamps of k / 48000 s, through
+  *   the one second carry, with the DAC code and voltage.
+  * - An export rendered in chunks on several threads (vr_export -j) is
+  *   byte-identical to the sequential one.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_export.h"
+#include "test_host.h"
+#include "vr_export.h"
+#include "vr_host_sim.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Private define ------------------------------------------------------------*/
+#define EXPORT_FILE_MAX             (2u * 1024u * 1024u)
+#define EXPORT_WAV_HEADER           44
+#define EXPORT_WAV_TICKS            2000    // 20 ms
+#define EXPORT_CSV_RATE             48000
+#define EXPORT_CSV_LEVEL            1000
+#define EXPORT_PARALLEL_PROFILE     "0:800,2:6000"
+#define EXPORT_PARALLEL_TICKS       250000  // 2.5 s, so 1 s chunks end mid-run
+#define EXPORT_THREADS              4
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t export_files[2][EXPORT_FILE_MAX];
+static uint32_t export_sizes[2];
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Export_TestWav(void);
+static bool Export_TestRaw(void);
+static bool Export_TestCsv(void);
+static bool Export_TestParallel(void);
+static bool Export_Open(VR_Exporter_t *ex, char *path, VR_ExportFormat_t format, uint32_t sample_rate);
+static bool Export_Close(VR_Exporter_t *ex, const char *path, uint32_t file);
+static uint32_t Export_Get32(const uint8_t *p);
+static uint16_t Export_Get16(const uint8_t *p);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the waveform export tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Export(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing waveform export...\n");
+
+    VR_Test_Record(&results, Export_TestWav());
+    VR_Test_Record(&results, Export_TestRaw());
+    VR_Test_Record(&results, Export_TestCsv());
+    VR_Test_Record(&results, Export_TestParallel());
+
+    return VR_Test_Report(&results, "Export");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the WAV header fields at the tick rate and at 48 kHz
+  * @retval True if passed
+  */
+static bool Export_TestWav(void)
+{
+    static const uint32_t rates[] = {VR_SAMPLE_TIMER_BASE_FREQ, EXPORT_CSV_RATE};
+    VR_Profile_t profile;
+
+    if (!VR_Profile_Parse(&profile, "0:3000")) {
+        printf("TEST FAILED: export wav: profile refused\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        VR_Exporter_t ex;
+        VR_Emulator_t emu;
+        char path[] = "/tmp/vr_export_XXXXXX";
+        uint32_t rate = rates[i];
+        // Sample k is emitted if it lies before the end of the run
+        uint32_t samples = (uint32_t)(((uint64_t)EXPORT_WAV_TICKS * rate + VR_SAMPLE_TIMER_BASE_FREQ - 1) /
+                                      VR_SAMPLE_TIMER_BASE_FREQ);
+
+        if (!Export_Open(&ex, path, VR_EXPORT_WAV, rate)) {
+            return false;
+        }
+        VR_HostSim_RunInstance(&emu, &profile, EXPORT_WAV_TICKS, VR_HOST_CONTROL_PERIOD_TICKS, VR_Export_Sink, &ex);
+        if (!Export_Close(&ex, path, 0)) {
+            return false;
+        }
+
+        const uint8_t *h = export_files[0];
+        if (export_sizes[0] != EXPORT_WAV_HEADER + 2 * samples ||
+            memcmp(h, "RIFF", 4) != 0 || Export_Get32(h + 4) != export_sizes[0] - 8 ||
+            memcmp(h + 8, "WAVEfmt ", 8) != 0 || Export_Get32(h + 16) != 16 ||
+            Export_Get16(h + 20) != 1 || Export_Get16(h + 22) != 1 ||
+            Export_Get32(h + 24) != rate || Export_Get32(h + 28) != 2 * rate ||
+            Export_Get16(h + 32) != 2 || Export_Get16(h + 34) != 16 ||
+            memcmp(h + 36, "data", 4) != 0 || Export_Get32(h + 40) != 2 * samples) {
+            printf("TEST FAILED: export wav: %lu Hz header wrong, %lu bytes for %lu samples, "
+                   "rate %lu, align %u, data %lu\n",
+                   (unsigned long)rate, (unsigned long)export_sizes[0], (unsigned long)samples,
+                   (unsigned long)Export_Get32(h + 24), Export_Get16(h + 32),
+                   (unsigned long)Export_Get32(h + 40));
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Check raw output is one little-endian word per tick
+  * @retval True if passed
+  */
+static bool Export_TestRaw(void)
+{
+    static const uint8_t expected[] = {0xBC, 0x0A, 0x23, 0x01, 0x23, 0x01, 0xFF, 0x0F};
+    VR_Exporter_t ex;
+    char path[] = "/tmp/vr_export_XXXXXX";
+
+    if (!Export_Open(&ex, path, VR_EXPORT_RAW, VR_SAMPLE_TIMER_BASE_FREQ)) {
+        return false;
+    }
+    VR_Export_Sink(&ex, 0x0ABC, 0, 1);
+    VR_Export_Sink(&ex, 0x0123, 1, 2);
+    VR_Export_Sink(&ex, DAC_RESOLUTION - 1, 3, 1);
+    if (!Export_Close(&ex, path, 0)) {
+        return false;
+    }
+
+    if (export_sizes[0] != sizeof(expected) || memcmp(export_files[0], expected, sizeof(expected)) != 0) {
+        printf("TEST FAILED: export raw: %lu bytes, first %02X %02X\n",
+               (unsigned long)export_sizes[0], export_files[0][0], export_files[0][1]);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check CSV timestamps at 48 kHz, through the one second carry
+  * @retval True if passed
+  */
+static bool Export_TestCsv(void)
+{
+    static const struct {
+        uint32_t line;
+        const char *text;
+    } lines[] = {
+        {0, "time_s,dac_code,voltage_v"},
+        {1, "0.000000000,1000,0.8057"},
+        {2, "0.000020833,1000,0.8057"},
+        {48, "0.000979166,1000,0.8057"},
+        {48000, "0.999979166,1000,0.8057"},
+        {48001, "1.000000000,4095,3.2992"},
+        {48002, "1.000020833,4095,3.2992"},
+    };
+    VR_Exporter_t ex;
+    char path[] = "/tmp/vr_export_XXXXXX";
+
+    if (!Export_Open(&ex, path, VR_EXPORT_CSV, EXPORT_CSV_RATE)) {
+        return false;
+    }
+    // One second of one level, then 100 us of another: samples 0..47999, then 48000..48004
+    VR_Export_Sink(&ex, EXPORT_CSV_LEVEL, 0, VR_SAMPLE_TIMER_BASE_FREQ);
+    VR_Export_Sink(&ex, DAC_RESOLUTION - 1, VR_SAMPLE_TIMER_BASE_FREQ, 10);
+    if (!Export_Close(&ex, path, 0)) {
+        return false;
+    }
+
+    uint32_t line = 0, next = 0;
+    char *text = (char *)export_files[0];
+    char *end = text + export_sizes[0];
+
+    while (text < end) {
+        char *eol = memchr(text, '\n', (size_t)(end - text));
+        if (eol == NULL) {
+            printf("TEST FAILED: export csv: line %lu not terminated\n", (unsigned long)line);
+            return false;
+        }
+        *eol = '\0';
+        if (next < sizeof(lines) / sizeof(lines[0]) && lines[next].line == line) {
+            if (strcmp(text, lines[next].text) != 0) {
+                printf("TEST FAILED: export csv: line %lu is \"%s\", expected \"%s\"\n",
+                       (unsigned long)line, text, lines[next].text);
+                return false;
+            }
+            next++;
+        }
+        text = eol + 1;
+        line++;
+    }
+
+    if (line != 1 + 48000 + 5 || next != sizeof(lines) / sizeof(lines[0])) {
+        printf("TEST FAILED: export csv: %lu lines, expected %u\n", (unsigned long)line, 1 + 48000 + 5);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that a chunked parallel export is byte-identical to a sequential one
+  * @retval True if passed
+  */
+static bool Export_TestParallel(void)
+{
+    VR_Profile_t profile;
+    VR_Exporter_t ex;
+    VR_Emulator_t emu;
+    char sequential[] = "/tmp/vr_export_XXXXXX";
+    char parallel[] = "/tmp/vr_export_XXXXXX";
+
+    if (!VR_Profile_Parse(&profile, EXPORT_PARALLEL_PROFILE)) {
+        printf("TEST FAILED: export parallel: profile refused\n");
+        return false;
+    }
+
+    if (!Export_Open(&ex, sequential, VR_EXPORT_WAV, EXPORT_CSV_RATE)) {
+        return false;
+    }
+    uint64_t samples = VR_HostSim_RunInstance(&emu, &profile, EXPORT_PARALLEL_TICKS, VR_HOST_CONTROL_PERIOD_TICKS,
+                                              VR_Export_Sink, &ex);
+    if (!Export_Close(&ex, sequential, 0)) {
+        return false;
+    }
+
+    if (!Export_Open(&ex, parallel, VR_EXPORT_WAV, EXPORT_CSV_RATE)) {
+        return false;
+    }
+    uint64_t chunked = VR_HostSim_RunParallel(&profile, EXPORT_PARALLEL_TICKS, VR_HOST_CONTROL_PERIOD_TICKS,
+                                              EXPORT_THREADS, 0, VR_Export_Sink, &ex);
+    if (!Export_Close(&ex, parallel, 1)) {
+        return false;
+    }
+
+    if (chunked != samples || export_sizes[1] != export_sizes[0] ||
+        memcmp(export_files[0], export_files[1], export_sizes[0]) != 0) {
+        uint32_t at = 0;
+        while (at < export_sizes[0] && at < export_sizes[1] && export_files[0][at] == export_files[1][at]) {
+            at++;
+        }
+        printf("TEST FAILED: export parallel: %lu bytes from %llu updates, sequential %lu from %llu, "
+               "first difference at byte %lu\n",
+               (unsigned long)export_sizes[1], (unsigned long long)chunked,
+               (unsigned long)export_sizes[0], (unsigned long long)samples, (unsigned long)at);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Create a temporary file and open an export on it
+  * @param  ex: Exporter to open
+  * @param  path: mkstemp() template, replaced by the file name
+  * @param  format: Output format
+  * @param  sample_rate: Output sample rate in Hz
+  * @retval True if opened
+  */
+static bool Export_Open(VR_Exporter_t *ex, char *path, VR_ExportFormat_t format, uint32_t sample_rate)
+{
+    int fd = mkstemp(path);
+
+    if (fd < 0) {
+        printf("TEST FAILED: export: cannot create %s\n", path);
+        return false;
+    }
+    close(fd);
+
+    if (!VR_Export_Open(ex, path, format, sample_rate)) {
+        printf("TEST FAILED: export: cannot open %s\n", path);
+        unlink(path);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Close an export, read the file back and remove it
+  * @param  ex: Open exporter
+  * @param  path: File name
+  * @param  file: Index in export_files to read into
+  * @retval True if closed without error and read completely
+  */
+static bool Export_Close(VR_Exporter_t *ex, const char *path, uint32_t file)
+{
+    bool ok = VR_Export_Close(ex);
+    FILE *in = ok ? fopen(path, "rb") : NULL;
+
+    export_sizes[file] = 0;
+    if (in != NULL) {
+        export_sizes[file] = (uint32_t)fread(export_files[file], 1, EXPORT_FILE_MAX, in);
+        ok = !ferror(in) && fgetc(in) == EOF;
+        fclose(in);
+    } else {
+        ok = false;
+    }
+    unlink(path);
+
+    if (!ok) {
+        printf("TEST FAILED: export: %s not written or too long to read back\n", path);
+    }
+    return ok;
+}
+
+/**
+  * @brief  Read a little-endian 32-bit field
+  * @param  p: Field
+  * @retval Value
+  */
+static uint32_t Export_Get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+  * @brief  Read a little-endian 16-bit field
+  * @param  p: Field
+  * @retval Value
+  */
+static uint16_t Export_Get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
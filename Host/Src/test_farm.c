@@ -0,0 +1,154 @@
+/**
+  ******************************************************************************
+  * @file           : test_farm.c
+  * @brief          : Simulation farm tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * A small campaign covering every pattern, fault and two noise seeds is
+  * run on one thread and on FARM_TEST_THREADS threads. The per-scenario
+  * checksums and decoder statistics must match, every scenario must run
+  * exactly once, and the clean fixed-RPM scenarios must decode without
+  * losing sync.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_farm.h"
+#include "test_host.h"
+#include "vr_farm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+static const VR_FarmCampaign_t farm_test_campaign = {
+    2000, 12000, 5000, VR_FARM_ALL_PATTERNS, VR_FARM_ALL_FAULTS, 2, 8, 0.1
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Farm_TestDeterminism(const VR_FarmScenario_t *scenarios, uint32_t count);
+static bool Farm_TestCleanDecode(const VR_FarmScenario_t *scenarios, const VR_FarmResult_t *results,
+                                 uint32_t count);
+
+/* Private variables ---------------------------------------------------------*/
+static VR_FarmResult_t *farm_single;
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run a small campaign on one and on several threads
+  * @retval Test results
+  */
+TestResults_t VR_Test_Farm(void)
+{
+    TestResults_t results = {0};
+    uint32_t count = VR_Farm_BuildCampaign(&farm_test_campaign, NULL, 0);
+    VR_FarmScenario_t *scenarios = malloc(count * sizeof(*scenarios));
+
+    farm_single = malloc(count * sizeof(*farm_single));
+
+    printf("Testing simulation farm (%lu scenarios, 1 vs %d threads)...\n",
+           (unsigned long)count, FARM_TEST_THREADS);
+
+    if (scenarios == NULL || farm_single == NULL) {
+        printf("TEST FAILED: farm: out of memory\n");
+        VR_Test_Record(&results, false);
+    } else {
+        VR_Farm_BuildCampaign(&farm_test_campaign, scenarios, count);
+        VR_Test_Record(&results, Farm_TestDeterminism(scenarios, count));
+        VR_Test_Record(&results, Farm_TestCleanDecode(scenarios, farm_single, count));
+    }
+
+    free(scenarios);
+    free(farm_single);
+
+    return VR_Test_Report(&results, "Simulation farm");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Compare a single-threaded and a multi-threaded run
+  * @param  scenarios: Campaign
+  * @param  count: Number of scenarios
+  * @retval True if both runs agree and every scenario ran once
+  */
+static bool Farm_TestDeterminism(const VR_FarmScenario_t *scenarios, uint32_t count)
+{
+    VR_FarmResult_t *parallel = malloc(count * sizeof(*parallel));
+    VR_FarmSummary_t single_summary, parallel_summary;
+    uint32_t executed = 0;
+    bool ok = true;
+
+    if (parallel == NULL) {
+        printf("TEST FAILED: farm: out of memory\n");
+        return false;
+    }
+
+    if (!VR_Farm_Run(scenarios, count, 1, farm_single, &single_summary) ||
+        !VR_Farm_Run(scenarios, count, FARM_TEST_THREADS, parallel, &parallel_summary)) {
+        printf("TEST FAILED: farm: could not start workers\n");
+        free(parallel);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < parallel_summary.threads; i++) {
+        executed += parallel_summary.workers[i].executed;
+    }
+    if (executed != count) {
+        printf("TEST FAILED: farm: %lu scenarios executed for %lu scheduled\n",
+               (unsigned long)executed, (unsigned long)count);
+        ok = false;
+    }
+
+    for (uint32_t i = 0; i < count && ok; i++) {
+        if (parallel[i].checksum != farm_single[i].checksum ||
+            parallel[i].samples != farm_single[i].samples ||
+            memcmp(&parallel[i].decoder, &farm_single[i].decoder, sizeof(VR_DecoderStats_t)) != 0) {
+            printf("TEST FAILED: farm: scenario %lu differs on %d threads\n",
+                   (unsigned long)i, FARM_TEST_THREADS);
+            ok = false;
+        }
+    }
+
+    if (ok && parallel_summary.checksum != single_summary.checksum) {
+        printf("TEST FAILED: farm: campaign checksum %08lx, expected %08lx\n",
+               (unsigned long)parallel_summary.checksum, (unsigned long)single_summary.checksum);
+        ok = false;
+    }
+
+    free(parallel);
+    return ok;
+}
+
+/**
+  * @brief  Check that clean fixed-RPM scenarios decode cleanly
+  * @param  scenarios: Campaign
+  * @param  results: Results of the campaign
+  * @param  count: Number of scenarios
+  * @retval True if every such scenario synced without a sync loss
+  */
+static bool Farm_TestCleanDecode(const VR_FarmScenario_t *scenarios, const VR_FarmResult_t *results,
+                                 uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        const VR_FarmScenario_t *sc = &scenarios[i];
+        const VR_DecoderStats_t *st = &results[i].decoder;
+
+        if (sc->pattern != VR_FARM_PATTERN_FIXED || sc->fault != VR_FARM_FAULT_NONE) {
+            continue;
+        }
+        if (st->first_sync_tick == 0 || st->sync_losses != 0 || st->revolutions == 0) {
+            printf("TEST FAILED: farm: %u RPM seed %lu: sync at %llu, %lu losses, %lu revolutions\n",
+                   sc->rpm, (unsigned long)sc->noise_seed, (unsigned long long)st->first_sync_tick,
+                   (unsigned long)st->sync_losses, (unsigned long)st->revolutions);
+            return false;
+        }
+    }
+
+    return true;
+}
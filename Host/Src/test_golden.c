@@ -0,0 +1,355 @@
+/**
+  ******************************************************************************
+  * @file           : test_golden.c
+  * @brief          : Golden-waveform regression tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each canonical scenario is rendered through VR_HostSim_Run() and every
+  * DAC level the sink receives is one sample, held for a number of TIM6
+  * ticks. The reference capture is mapped read-only with mmap and the two
+  * timelines are compared tick by tick while rendering, so a level that is
+  * right but held too long or too short is caught, and no copy of either
+  * waveform is kept in memory.
+  *
+  * Reference file layout (little-endian):
+  *   uint32 magic "VRGD", uint16 version, uint16 header size,
+  *   uint32 hold count, uint32 total ticks, then per hold
+  *   uint16 DAC code, uint16 reserved, uint32 ticks held.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_golden.h"
+#include "test_host.h"
+#include "vr_host_sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    const char *name;
+    const char *profile;
+    double duration_s;
+} GoldenScenario_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t hold_count;
+    uint32_t total_ticks;
+} GoldenHeader_t;
+
+typedef struct {
+    uint16_t dac_code;
+    uint16_t reserved;
+    uint32_t ticks;
+} GoldenHold_t;
+
+typedef struct {
+    const GoldenHold_t *reference;  // NULL while recording
+    uint32_t reference_count;
+    const GoldenConfig_t *config;
+    uint32_t ref_index;             // Reference hold under the render position
+    uint64_t ref_start;             // First tick of that hold
+    uint64_t index;                 // Samples rendered
+    uint64_t end_tick;              // One past the last rendered tick
+    uint32_t mismatches;
+    bool first_found;
+    uint64_t first_index;
+    uint64_t first_tick;
+    uint16_t first_expected;
+    uint16_t first_actual;
+    FILE *record;                   // Destination while recording
+} GoldenCompare_t;
+
+/* Private define ------------------------------------------------------------*/
+#define GOLDEN_PATH_MAX             512
+
+/* Private variables ---------------------------------------------------------*/
+static const GoldenScenario_t golden_scenarios[] = {
+    // Name                 Profile (s:RPM)             Duration (s)
+    {"fixed_800",           "0:800",                    0.10},
+    {"fixed_3000",          "0:3000",                   0.05},
+    {"fixed_6000",          "0:6000",                   0.03},
+    {"fixed_13400",         "0:13400",                  0.02},
+    {"ramp_1000_8000",      "0:1000,0.2:8000",          0.20},
+    {"ramp_8000_1000",      "0:8000,0.1:1000",          0.10},
+    {"missing_tooth_1500",  "0:1500",                   0.05},
+    {"start_stop",          "0:0,0.01:0,0.02:2000,0.06:2000,0.07:0,0.08:0", 0.08},
+};
+
+#define NUM_GOLDEN_SCENARIOS        (sizeof(golden_scenarios) / sizeof(golden_scenarios[0]))
+
+static VR_Profile_t golden_profile;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Golden_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+static double Golden_CrankAngle(const VR_Profile_t *profile, double time_s);
+static bool Golden_Render(const GoldenScenario_t *scenario, GoldenCompare_t *cmp);
+static bool Golden_Check(const char *dir, const GoldenScenario_t *scenario, const GoldenConfig_t *config);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Compare every canonical scenario against its reference capture
+  * @param  dir: Directory holding the .golden files
+  * @param  config: Comparison tolerances
+  * @retval Test results, one test per scenario
+  */
+TestResults_t VR_Test_GoldenWaveforms(const char *dir, const GoldenConfig_t *config)
+{
+    TestResults_t results = {0};
+
+    printf("Testing golden waveforms (tolerance %u LSB, %lu mismatches)...\n",
+           config->tolerance_lsb, (unsigned long)config->max_mismatches);
+
+    for (uint32_t i = 0; i < NUM_GOLDEN_SCENARIOS; i++) {
+        VR_Test_Record(&results, Golden_Check(dir, &golden_scenarios[i], config));
+    }
+
+    return VR_Test_Report(&results, "Golden waveform");
+}
+
+/**
+  * @brief  Re-render every canonical scenario and overwrite its reference
+  * @param  dir: Directory receiving the .golden files
+  * @retval True if all references were written
+  */
+bool VR_Test_GoldenUpdate(const char *dir)
+{
+    bool ok = true;
+
+    for (uint32_t i = 0; i < NUM_GOLDEN_SCENARIOS; i++) {
+        const GoldenScenario_t *scenario = &golden_scenarios[i];
+        char path[GOLDEN_PATH_MAX];
+        GoldenCompare_t rec = {0};
+        GoldenHeader_t header = {GOLDEN_MAGIC, GOLDEN_VERSION, sizeof(GoldenHeader_t), 0, 0};
+
+        snprintf(path, sizeof(path), "%s/%s.golden", dir, scenario->name);
+        rec.record = fopen(path, "wb");
+        if (rec.record == NULL) {
+            printf("Cannot create %s\n", path);
+            ok = false;
+            continue;
+        }
+
+        // Header is rewritten once the hold count and length are known
+        fwrite(&header, sizeof(header), 1, rec.record);
+        bool rendered = Golden_Render(scenario, &rec);
+
+        header.hold_count = (uint32_t)rec.index;
+        header.total_ticks = (uint32_t)rec.end_tick;
+        if (!rendered || fseek(rec.record, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, rec.record) != 1) {
+            ok = false;
+        }
+        if (fclose(rec.record) != 0) {
+            ok = false;
+        }
+
+        printf("Wrote %s (%lu samples, %lu ticks)\n", path,
+               (unsigned long)header.hold_count, (unsigned long)header.total_ticks);
+    }
+
+    return ok;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Compare one scenario against its mapped reference
+  * @param  dir: Reference directory
+  * @param  scenario: Scenario to render
+  * @param  config: Comparison tolerances
+  * @retval True if the scenario matches within tolerance
+  */
+static bool Golden_Check(const char *dir, const GoldenScenario_t *scenario, const GoldenConfig_t *config)
+{
+    char path[GOLDEN_PATH_MAX];
+    struct stat st;
+    GoldenCompare_t cmp = {0};
+    bool pass = false;
+
+    snprintf(path, sizeof(path), "%s/%s.golden", dir, scenario->name);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GoldenHeader_t)) {
+        printf("TEST FAILED: %s: cannot read reference %s\n", scenario->name, path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("TEST FAILED: %s: cannot map %s\n", scenario->name, path);
+        return false;
+    }
+
+    const GoldenHeader_t *header = (const GoldenHeader_t *)map;
+    size_t expected_size = header->header_size + (size_t)header->hold_count * sizeof(GoldenHold_t);
+    uint64_t reference_ticks = 0;
+
+    if (header->magic == GOLDEN_MAGIC && header->version == GOLDEN_VERSION &&
+        header->header_size == sizeof(GoldenHeader_t) && (size_t)st.st_size == expected_size) {
+        cmp.reference = (const GoldenHold_t *)((const uint8_t *)map + header->header_size);
+        cmp.reference_count = header->hold_count;
+        for (uint32_t i = 0; i < cmp.reference_count; i++) {
+            reference_ticks += cmp.reference[i].ticks;
+        }
+    }
+    if (cmp.reference == NULL || reference_ticks != header->total_ticks) {
+        printf("TEST FAILED: %s: %s is not a valid reference\n", scenario->name, path);
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+
+    cmp.config = config;
+
+    Golden_Render(scenario, &cmp);
+
+    if (cmp.end_tick != reference_ticks) {
+        printf("TEST FAILED: %s: rendered %lu ticks, reference has %lu\n",
+               scenario->name, (unsigned long)cmp.end_tick, (unsigned long)reference_ticks);
+    } else if (cmp.mismatches > config->max_mismatches) {
+        printf("TEST FAILED: %s: %lu samples outside tolerance\n",
+               scenario->name, (unsigned long)cmp.mismatches);
+    } else {
+        pass = true;
+    }
+
+    if (cmp.first_found) {
+        // Angle of the commanded speed at that instant, not of the level rendered
+        double time_s = (double)cmp.first_tick / VR_SAMPLE_TIMER_BASE_FREQ;
+        double angle = Golden_CrankAngle(&golden_profile, time_s);
+
+        printf("  first divergence at tick %lu, sample %lu (t=%.5f s, tooth %u, crank %.2f deg): "
+               "expected %u, got %u\n",
+               (unsigned long)cmp.first_tick, (unsigned long)cmp.first_index, time_s,
+               (unsigned)(angle / (360.0 / TRIGGER_WHEEL_TEETH)), angle,
+               cmp.first_expected, cmp.first_actual);
+    }
+
+#if TEST_VERBOSE_OUTPUT
+    if (pass) {
+        printf("  %-20s %8lu samples OK\n", scenario->name, (unsigned long)cmp.index);
+    }
+#endif
+
+    munmap(map, (size_t)st.st_size);
+    return pass;
+}
+
+/**
+  * @brief  Render one scenario into a compare or record context
+  * @param  scenario: Scenario to render
+  * @param  cmp: Compare/record context
+  * @retval True if the profile is valid
+  */
+static bool Golden_Render(const GoldenScenario_t *scenario, GoldenCompare_t *cmp)
+{
+    if (!VR_Profile_Parse(&golden_profile, scenario->profile)) {
+        printf("Invalid profile for scenario %s\n", scenario->name);
+        return false;
+    }
+
+    uint64_t ticks = (uint64_t)(scenario->duration_s * VR_SAMPLE_TIMER_BASE_FREQ + 0.5);
+    VR_HostSim_Run(&golden_profile, ticks, VR_HOST_CONTROL_PERIOD_TICKS, Golden_Sink, cmp);
+
+    return true;
+}
+
+/**
+  * @brief  Sample sink comparing against or recording the reference
+  * @note   Compares the level with every reference hold it overlaps, so
+  *         both the level and how long it is held must match
+  * @param  ctx: GoldenCompare_t context
+  * @param  dac_value: DAC level
+  * @param  start_tick: First tick of the level
+  * @param  num_ticks: Ticks the level is held
+  * @retval None
+  */
+static void Golden_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    GoldenCompare_t *cmp = (GoldenCompare_t *)ctx;
+    uint64_t index = cmp->index++;
+    uint64_t end = start_tick + num_ticks;
+    bool mismatch = false;
+
+    cmp->end_tick = end;
+
+    if (cmp->record != NULL) {
+        GoldenHold_t hold = {dac_value, 0, num_ticks};
+
+        fwrite(&hold, sizeof(hold), 1, cmp->record);
+        return;
+    }
+
+    for (uint64_t tick = start_tick; tick < end && cmp->ref_index < cmp->reference_count; ) {
+        const GoldenHold_t *ref = &cmp->reference[cmp->ref_index];
+        uint64_t ref_end = cmp->ref_start + ref->ticks;
+
+        if (ref_end <= tick) {
+            cmp->ref_index++;
+            cmp->ref_start = ref_end;
+            continue;
+        }
+
+        uint16_t diff = (dac_value > ref->dac_code) ? dac_value - ref->dac_code : ref->dac_code - dac_value;
+        if (diff > cmp->config->tolerance_lsb) {
+            mismatch = true;
+            if (!cmp->first_found) {
+                cmp->first_found = true;
+                cmp->first_index = index;
+                cmp->first_tick = tick;
+                cmp->first_expected = ref->dac_code;
+                cmp->first_actual = dac_value;
+            }
+        }
+        tick = (ref_end < end) ? ref_end : end;
+    }
+
+    if (mismatch) {
+        cmp->mismatches++;
+    }
+}
+
+/**
+  * @brief  Crank angle the profile has turned through at a given time
+  * @note   Integrates the piecewise-linear RPM, so the angle follows real
+  *         time rather than the levels rendered so far
+  * @param  profile: RPM profile
+  * @param  time_s: Time from the start of the run
+  * @retval Angle in degrees, 0 to 360
+  */
+static double Golden_CrankAngle(const VR_Profile_t *profile, double time_s)
+{
+    const VR_ProfilePoint_t *pts = profile->points;
+    double t = 0.0, degrees = 0.0;
+
+    // 1 RPM turns 6 degrees per second; the trapezoid rule is exact for linear segments
+    for (uint32_t i = 0; i <= profile->num_points && t < time_s; i++) {
+        double next = (i < profile->num_points && pts[i].time_s < time_s) ? pts[i].time_s : time_s;
+
+        if (next > t) {
+            degrees += 3.0 * (VR_Profile_RPMAt(profile, t) + VR_Profile_RPMAt(profile, next)) * (next - t);
+            t = next;
+        }
+    }
+
+    degrees = fmod(degrees, 360.0);
+    return (degrees < 0.0) ? degrees + 360.0 : degrees;
+}
@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file           : test_host.c
+  * @brief          : Helpers shared by the host test suites
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_host.h"
+#include "vr_command.h"
+#include "vr_crank.h"
+#include "vr_host_sim.h"
+#include "vr_qos.h"
+#include "vr_revolution.h"
+#include "vr_scenario.h"
+#include "vr_vclock.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Count one check as passed or failed
+  * @param  results: Suite results
+  * @param  passed: Outcome of the check
+  * @retval None
+  */
+void VR_Test_Record(TestResults_t *results, bool passed)
+{
+    if (passed) {
+        results->passed_tests++;
+    } else {
+        results->failed_tests++;
+    }
+}
+
+/**
+  * @brief  Total a suite's checks and print its summary line
+  * @param  results: Suite results
+  * @param  name: Suite name, as in "<name> tests completed"
+  * @retval The totalled results
+  */
+TestResults_t VR_Test_Report(TestResults_t *results, const char *name)
+{
+    results->total_tests = results->passed_tests + results->failed_tests;
+    printf("%s %s tests completed (%d/%d)\n",
+           (results->failed_tests == 0) ? "✓" : "✗", name, results->passed_tests, results->total_tests);
+
+    return *results;
+}
+
+/**
+  * @brief  Feed a line to the command channel and check its reply
+  * @note   The line goes in byte by byte, as from the USART3 receive interrupt
+  * @param  label: Names the commands in a failure message
+  * @param  line: Command, line end included
+  * @param  expected: Expected reply
+  * @retval True if exactly that reply came back
+  */
+bool VR_Test_Command(const char *label, const char *line, const char *expected)
+{
+    char reply[VR_COMMAND_REPLY_MAX];
+
+    for (const char *p = line; *p != '\0'; p++) {
+        VR_Command_RxByte((uint8_t)*p);
+    }
+
+    if (!VR_Command_Poll(reply, sizeof(reply))) {
+        printf("TEST FAILED: %s command: no reply to \"%.20s\"\n", label, line);
+        return false;
+    }
+    if (strcmp(reply, expected) != 0) {
+        printf("TEST FAILED: %s command: \"%.20s\" gave \"%s\", expected \"%s\"\n",
+               label, line, reply, expected);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Return the default instance and the timers it drives to power-on state
+  * @note   Stops every output mode and sequence, drops the shape tables,
+  *         zeroes TIM2 and sets TIM6 to its reset period, so a suite runs
+  *         the same whatever ran before it
+  * @retval None
+  */
+void VR_Test_ResetDefault(void)
+{
+    VR_Scenario_End();
+    VR_Crank_End();
+    VR_Vclk_Stop();
+    VR_Rev_Stop();
+    VR_HostSim_SetShape(NULL);
+
+    htim2.Instance->CNT = 0;
+    htim6.Init.Period = VR_DEFAULT_SAMPLE_TICKS - 1;
+    VR_Emulator_Init();
+    VR_QoS_Init();
+}
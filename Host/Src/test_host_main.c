@@ -0,0 +1,197 @@
+/**
+  ******************************************************************************
+  * @file           : test_host_main.c
+  * @brief          : Host test runner for the VR emulator
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Runs the on-target unit tests from test_vr_emulator.c followed by the
+  * host-only suites, and exits non-zero if any test fails.
+  *
+  * Usage: vr_host_tests [-d GOLDEN_DIR] [-t LSB] [-m MISMATCHES] [-u]
+  *
+  *   -d  Reference directory (default Host/golden)
+  *   -t  Per-sample tolerance in DAC LSB (default 0)
+  *   -m  Samples allowed outside tolerance per scenario (default 0)
+  *   -u  Regenerate the golden references instead of testing
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vr_emulator.h"
+#include "test_golden.h"
+#include "test_decoder.h"
+#include "test_instances.h"
+#include "test_farm.h"
+#include "test_parallel.h"
+#include "test_export.h"
+#include "test_batch.h"
+#include "test_digital.h"
+#include "test_capture.h"
+#include "test_shape.h"
+#include "test_cycles.h"
+#include "test_dma.h"
+#include "test_event.h"
+#include "test_sched.h"
+#include "test_sample.h"
+#include "test_config.h"
+#include "test_revolution.h"
+#include "test_vclock.h"
+#include "test_qos.h"
+#include "test_counters.h"
+#include "test_reverse.h"
+#include "test_crank.h"
+#include "test_scenario.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Private variables ---------------------------------------------------------*/
+static const uint16_t signal_quality_rpms[] = {200, 800, 3000, 6000, 9000, MAX_RPM};
+
+/* Private function prototypes -----------------------------------------------*/
+static void Accumulate(TestResults_t *overall, const TestResults_t *suite);
+
+/**
+  * @brief  Host test entry point
+  * @retval 0 if all tests passed
+  */
+int main(int argc, char *argv[])
+{
+    const char *golden_dir = GOLDEN_DEFAULT_DIR;
+    GoldenConfig_t golden_config = {0, 0};
+    DecoderSweepConfig_t sweep_config = {
+        DECODER_SWEEP_STEP_RPM, MAX_RPM, DECODER_SWEEP_STEP_RPM, DECODER_MAX_REV_ERR_PCT
+    };
+    bool update = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:t:m:u")) != -1) {
+        switch (opt) {
+        case 'd': golden_dir = optarg; break;
+        case 't': golden_config.tolerance_lsb = (uint16_t)atoi(optarg); break;
+        case 'm': golden_config.max_mismatches = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'u': update = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d GOLDEN_DIR] [-t LSB] [-m MISMATCHES] [-u]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (update) {
+        return VR_Test_GoldenUpdate(golden_dir) ? 0 : 1;
+    }
+
+    TestResults_t overall = {0};
+    TestResults_t suite;
+
+    suite = VR_Emulator_RunTests();
+    Accumulate(&overall, &suite);
+
+    printf("\n=== Host Simulator Tests ===\n");
+
+    clock_t start = clock();
+    suite = VR_Test_GoldenWaveforms(golden_dir, &golden_config);
+    printf("  (%.3f s)\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+    Accumulate(&overall, &suite);
+
+    start = clock();
+    suite = VR_Test_DecoderSweep(&sweep_config);
+    printf("  (%.3f s)\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+    Accumulate(&overall, &suite);
+
+    start = clock();
+    suite = VR_Test_Instances();
+    printf("  (%.3f s)\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Farm();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_ParallelRender();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Export();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Batch();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_DigitalOutput();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_EcuCapture();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_ToothShape();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Cycles();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_DmaBuffer();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Events();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Scheduler();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_SampleIsr();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Config();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Revolution();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Vclock();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_QoS();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Counters();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Reverse();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Crank();
+    Accumulate(&overall, &suite);
+
+    suite = VR_Test_Scenario();
+    Accumulate(&overall, &suite);
+
+    // Target loopback self-test over recorded DAC writes
+    for (uint32_t i = 0; i < sizeof(signal_quality_rpms) / sizeof(signal_quality_rpms[0]); i++) {
+        suite = VR_Emulator_TestSignalQuality(signal_quality_rpms[i]);
+        Accumulate(&overall, &suite);
+    }
+
+    printf("\n=== Host Test Summary ===\n");
+    printf("Total Tests: %d\n", overall.total_tests);
+    printf("Passed: %d\n", overall.passed_tests);
+    printf("Failed: %d\n", overall.failed_tests);
+
+    return (overall.failed_tests == 0) ? 0 : 1;
+}
+
+/**
+  * @brief  Add a suite's counts to the overall results
+  * @param  overall: Running totals
+  * @param  suite: Suite results
+  * @retval None
+  */
+static void Accumulate(TestResults_t *overall, const TestResults_t *suite)
+{
+    overall->total_tests += suite->total_tests;
+    overall->passed_tests += suite->passed_tests;
+    overall->failed_tests += suite->failed_tests;
+}
@@ -0,0 +1,193 @@
+/**
+  ******************************************************************************
+  * @file           : test_instances.c
+  * @brief          : Multi-instance emulator tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * INSTANCES_COUNT unbound instances, each at its own RPM, are stepped
+  * round-robin and every output trace is hashed. Each instance is then
+  * re-initialised and stepped on its own; the hashes must match.
+  *
+  * A second sensor bound to DAC channel 2 is run alongside the default
+  * instance on channel 1, and must match an unbound instance sample for
+  * sample without touching channel 1 or the default instance's state.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_instances.h"
+#include "test_host.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* External variables --------------------------------------------------------*/
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim6;
+
+/* Private define ------------------------------------------------------------*/
+#define FNV_OFFSET                  2166136261u
+#define FNV_PRIME                   16777619u
+#define DUAL_SENSOR_RPM             3000
+#define SECOND_SENSOR_RPM           4500
+
+/* Private function prototypes -----------------------------------------------*/
+static uint16_t Instances_RPMFor(uint32_t index);
+static uint32_t Instances_Hash(uint32_t hash, uint16_t value);
+static bool Instances_TestInterleaved(void);
+static bool Instances_TestDualSensor(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the multi-instance independence tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Instances(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing %d emulator instances x %d updates...\n", INSTANCES_COUNT, INSTANCES_STEPS);
+
+    VR_Test_Record(&results, Instances_TestInterleaved());
+    VR_Test_ResetDefault();
+    VR_Test_Record(&results, Instances_TestDualSensor());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Multi-instance");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Spread instance RPMs over the whole range
+  * @param  index: Instance index
+  * @retval RPM for this instance (1 to MAX_RPM)
+  */
+static uint16_t Instances_RPMFor(uint32_t index)
+{
+    return (uint16_t)(1 + (index * 7919u) % MAX_RPM);
+}
+
+/**
+  * @brief  Fold one output sample into an FNV-1a hash
+  * @param  hash: Running hash
+  * @param  value: DAC level
+  * @retval Updated hash
+  */
+static uint32_t Instances_Hash(uint32_t hash, uint16_t value)
+{
+    hash = (hash ^ (value & 0xFFu)) * FNV_PRIME;
+    return (hash ^ (value >> 8)) * FNV_PRIME;
+}
+
+/**
+  * @brief  Compare interleaved and solo renders of many instances
+  * @retval True if every instance rendered the same trace both ways
+  */
+static bool Instances_TestInterleaved(void)
+{
+    VR_Emulator_t *emus = malloc(INSTANCES_COUNT * sizeof(*emus));
+    uint32_t *hashes = malloc(INSTANCES_COUNT * sizeof(*hashes));
+    uint32_t mismatches = 0, first_mismatch = 0;
+
+    if (emus == NULL || hashes == NULL) {
+        printf("TEST FAILED: interleaved instances: out of memory\n");
+        free(emus);
+        free(hashes);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < INSTANCES_COUNT; i++) {
+        VR_Emu_Init(&emus[i], NULL);
+        VR_Emu_SetRPM(&emus[i], Instances_RPMFor(i));
+        hashes[i] = FNV_OFFSET;
+    }
+
+    for (uint32_t step = 0; step < INSTANCES_STEPS; step++) {
+        for (uint32_t i = 0; i < INSTANCES_COUNT; i++) {
+            VR_Emu_TimerCallback(&emus[i]);
+            hashes[i] = Instances_Hash(hashes[i], VR_Emu_GetOutput(&emus[i]));
+        }
+    }
+
+    for (uint32_t i = 0; i < INSTANCES_COUNT; i++) {
+        VR_Emulator_t solo;
+        uint32_t hash = FNV_OFFSET;
+
+        VR_Emu_Init(&solo, NULL);
+        VR_Emu_SetRPM(&solo, Instances_RPMFor(i));
+        for (uint32_t step = 0; step < INSTANCES_STEPS; step++) {
+            VR_Emu_TimerCallback(&solo);
+            hash = Instances_Hash(hash, VR_Emu_GetOutput(&solo));
+        }
+
+        if (hash != hashes[i]) {
+            if (mismatches == 0) {
+                first_mismatch = i;
+            }
+            mismatches++;
+        }
+    }
+
+    free(emus);
+    free(hashes);
+
+    if (mismatches != 0) {
+        printf("TEST FAILED: %lu of %d instances differ when interleaved (first: #%lu at %u RPM)\n",
+               (unsigned long)mismatches, INSTANCES_COUNT,
+               (unsigned long)first_mismatch, Instances_RPMFor(first_mismatch));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Run two sensors on the two DAC channels
+  * @retval True if neither sensor disturbs the other
+  */
+static bool Instances_TestDualSensor(void)
+{
+    const VR_EmulatorBinding_t second_binding = {&hdac, DAC_CHANNEL_2, NULL, NULL};
+    VR_Emulator_t second, reference;
+    uint32_t default_arr;
+
+    VR_Emulator_SetRPM(DUAL_SENSOR_RPM);
+    default_arr = __HAL_TIM_GET_AUTORELOAD(&htim6);
+
+    VR_Emu_Init(&second, &second_binding);
+    VR_Emu_Init(&reference, NULL);
+    VR_Emu_SetRPM(&second, SECOND_SENSOR_RPM);
+    VR_Emu_SetRPM(&reference, SECOND_SENSOR_RPM);
+
+    // The unbound second sensor must not retune the shared sample timer
+    if (__HAL_TIM_GET_AUTORELOAD(&htim6) != default_arr || VR_Emulator_GetRPM() != DUAL_SENSOR_RPM) {
+        printf("TEST FAILED: dual sensor: second instance changed the default instance\n");
+        return false;
+    }
+
+    for (uint32_t step = 0; step < INSTANCES_STEPS; step++) {
+        VR_Emulator_TimerCallback();
+        uint16_t ch1 = (uint16_t)hdac.DHR12R1;
+
+        VR_Emu_TimerCallback(&second);
+        VR_Emu_TimerCallback(&reference);
+
+        if (hdac.DHR12R1 != ch1 || hdac.DHR12R1 != VR_Emu_GetOutput(VR_Emulator_GetDefault())) {
+            printf("TEST FAILED: dual sensor: channel 1 disturbed at update %lu\n", (unsigned long)step);
+            return false;
+        }
+        if (hdac.DHR12R2 != VR_Emu_GetOutput(&reference)) {
+            printf("TEST FAILED: dual sensor: channel 2 at update %lu (expected %u, got %lu)\n",
+                   (unsigned long)step, VR_Emu_GetOutput(&reference), (unsigned long)hdac.DHR12R2);
+            return false;
+        }
+    }
+
+    return true;
+}
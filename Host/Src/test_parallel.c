@@ -0,0 +1,242 @@
+/**
+  ******************************************************************************
+  * @file           : test_parallel.c
+  * @brief          : Chunked parallel rendering tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The test profile has stops, very low RPM (holds of hundreds of ticks),
+  * flat segments, slow and steep ramps and a step, so chunk seams land
+  * mid-hold, mid-tooth, on RPM changes and at the end of the run.
+  *
+  * The sequential render is recorded hold by hold. Each chunked parallel
+  * render must deliver the same holds (level, start tick and length) in
+  * the same order with the same sample count. Random seeks from a fresh
+  * cursor must land on a recorded hold and continue identically from it.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_parallel.h"
+#include "test_host.h"
+#include "vr_host_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint16_t level;
+    uint64_t start_tick;
+    uint32_t num_ticks;
+} ParallelHold_t;
+
+typedef struct {
+    ParallelHold_t *holds;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t next;                  // Compare mode: next expected hold
+    uint64_t mismatch;              // Index of the first difference, UINT64_MAX if none
+} ParallelTrace_t;
+
+/* Private define ------------------------------------------------------------*/
+#define PARALLEL_TEST_PROFILE       "0:0,0.02:0,0.05:5,0.1:5,0.2:9000,0.3:9000,0.32:13400," \
+                                    "0.4:13400,0.5:300,0.55:300,0.6:0,0.62:0,0.7:2000,0.7:6000"
+#define PARALLEL_TEST_DURATION      80000   // Ticks (0.8 s)
+#define PARALLEL_SEEK_SPAN          5000    // Ticks compared after each seek
+
+/* Private variables ---------------------------------------------------------*/
+static const uint64_t parallel_chunk_ticks[] = {7, 997, 25000, 1000000};
+
+/* Private function prototypes -----------------------------------------------*/
+static void Parallel_RecordSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+static void Parallel_CompareSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+static bool Parallel_TestChunks(const VR_Profile_t *profile, ParallelTrace_t *ref, uint64_t ref_samples,
+                                uint64_t chunk_ticks);
+static bool Parallel_TestSeeks(const VR_Profile_t *profile, ParallelTrace_t *ref);
+static uint64_t Parallel_FindHold(const ParallelTrace_t *ref, uint64_t tick);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Compare seeks and chunked parallel renders with a sequential render
+  * @retval Test results
+  */
+TestResults_t VR_Test_ParallelRender(void)
+{
+    TestResults_t results = {0};
+    VR_Profile_t profile;
+    VR_Emulator_t emu;
+    ParallelTrace_t ref = {0};
+
+    printf("Testing chunked parallel rendering (%d threads)...\n", PARALLEL_TEST_THREADS);
+
+    // A hold starts on a distinct tick, so this bounds the trace
+    ref.capacity = PARALLEL_TEST_DURATION;
+    ref.holds = malloc(ref.capacity * sizeof(*ref.holds));
+
+    if (ref.holds == NULL || !VR_Profile_Parse(&profile, PARALLEL_TEST_PROFILE)) {
+        printf("TEST FAILED: parallel: setup\n");
+        free(ref.holds);
+        VR_Test_Record(&results, false);
+        return VR_Test_Report(&results, "Parallel rendering");
+    }
+
+    uint64_t ref_samples = VR_HostSim_RunInstance(&emu, &profile, PARALLEL_TEST_DURATION,
+                                                  VR_HOST_CONTROL_PERIOD_TICKS, Parallel_RecordSink, &ref);
+
+    for (uint32_t i = 0; i < sizeof(parallel_chunk_ticks) / sizeof(parallel_chunk_ticks[0]); i++) {
+        VR_Test_Record(&results, Parallel_TestChunks(&profile, &ref, ref_samples, parallel_chunk_ticks[i]));
+    }
+
+    VR_Test_Record(&results, Parallel_TestSeeks(&profile, &ref));
+
+    free(ref.holds);
+
+    return VR_Test_Report(&results, "Parallel rendering");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Render in chunks and compare with the sequential trace
+  * @param  profile: Test profile
+  * @param  ref: Sequential trace
+  * @param  ref_samples: Sample count of the sequential render
+  * @param  chunk_ticks: Chunk length
+  * @retval True if identical
+  */
+static bool Parallel_TestChunks(const VR_Profile_t *profile, ParallelTrace_t *ref, uint64_t ref_samples,
+                                uint64_t chunk_ticks)
+{
+    ref->next = 0;
+    ref->mismatch = UINT64_MAX;
+
+    uint64_t samples = VR_HostSim_RunParallel(profile, PARALLEL_TEST_DURATION, VR_HOST_CONTROL_PERIOD_TICKS,
+                                              PARALLEL_TEST_THREADS, chunk_ticks, Parallel_CompareSink, ref);
+
+    if (ref->mismatch != UINT64_MAX) {
+        const ParallelHold_t *h = &ref->holds[ref->mismatch];
+        printf("TEST FAILED: %llu-tick chunks: hold %llu differs (expected %u at tick %llu for %lu)\n",
+               (unsigned long long)chunk_ticks, (unsigned long long)ref->mismatch, h->level,
+               (unsigned long long)h->start_tick, (unsigned long)h->num_ticks);
+        return false;
+    }
+    if (ref->next != ref->count || samples != ref_samples) {
+        printf("TEST FAILED: %llu-tick chunks: %llu holds and %llu samples, expected %llu and %llu\n",
+               (unsigned long long)chunk_ticks, (unsigned long long)ref->next, (unsigned long long)samples,
+               (unsigned long long)ref->count, (unsigned long long)ref_samples);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Seek fresh cursors to random ticks and continue rendering
+  * @param  profile: Test profile
+  * @param  ref: Sequential trace
+  * @retval True if every seek matches the sequential trace
+  */
+static bool Parallel_TestSeeks(const VR_Profile_t *profile, ParallelTrace_t *ref)
+{
+    uint32_t rng = 0x2545F491u;
+
+    for (uint32_t i = 0; i < PARALLEL_TEST_SEEKS; i++) {
+        VR_HostSimCursor_t cursor;
+
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        uint64_t target = rng % PARALLEL_TEST_DURATION;
+
+        VR_HostSim_CursorInit(&cursor);
+        VR_HostSim_Seek(&cursor, profile, target, PARALLEL_TEST_DURATION, VR_HOST_CONTROL_PERIOD_TICKS);
+
+        ref->next = Parallel_FindHold(ref, target);
+        ref->mismatch = UINT64_MAX;
+
+        if (ref->next < ref->count && ref->holds[ref->next].start_tick != cursor.tick) {
+            printf("TEST FAILED: seek to %llu: landed on tick %llu, expected %llu\n",
+                   (unsigned long long)target, (unsigned long long)cursor.tick,
+                   (unsigned long long)ref->holds[ref->next].start_tick);
+            return false;
+        }
+
+        VR_HostSim_Render(&cursor, profile, target + PARALLEL_SEEK_SPAN, PARALLEL_TEST_DURATION,
+                          VR_HOST_CONTROL_PERIOD_TICKS, Parallel_CompareSink, ref);
+
+        if (ref->mismatch != UINT64_MAX) {
+            printf("TEST FAILED: seek to %llu: hold %llu differs after the seek\n",
+                   (unsigned long long)target, (unsigned long long)ref->mismatch);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Index of the first recorded hold starting at or after a tick
+  * @param  ref: Sequential trace
+  * @param  tick: Tick
+  * @retval Hold index, ref->count if none
+  */
+static uint64_t Parallel_FindHold(const ParallelTrace_t *ref, uint64_t tick)
+{
+    uint64_t lo = 0, hi = ref->count;
+
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (ref->holds[mid].start_tick < tick) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+  * @brief  Sample sink recording every hold
+  * @param  ctx: ParallelTrace_t
+  * @param  dac_value: DAC level
+  * @param  start_tick: First tick of the hold
+  * @param  num_ticks: Ticks the level is held
+  * @retval None
+  */
+static void Parallel_RecordSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    ParallelTrace_t *trace = (ParallelTrace_t *)ctx;
+
+    if (trace->count < trace->capacity) {
+        trace->holds[trace->count] = (ParallelHold_t){dac_value, start_tick, num_ticks};
+    }
+    trace->count++;
+}
+
+/**
+  * @brief  Sample sink comparing each hold with the recorded trace
+  * @param  ctx: ParallelTrace_t
+  * @param  dac_value: DAC level
+  * @param  start_tick: First tick of the hold
+  * @param  num_ticks: Ticks the level is held
+  * @retval None
+  */
+static void Parallel_CompareSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    ParallelTrace_t *trace = (ParallelTrace_t *)ctx;
+
+    if (trace->mismatch == UINT64_MAX) {
+        const ParallelHold_t *h = &trace->holds[trace->next];
+
+        if (trace->next >= trace->count || h->level != dac_value ||
+            h->start_tick != start_tick || h->num_ticks != num_ticks) {
+            trace->mismatch = trace->next;
+        }
+    }
+    trace->next++;
+}
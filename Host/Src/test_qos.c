@@ -0,0 +1,393 @@
+/**
+  ******************************************************************************
+  * @file           : test_qos.c
+  * @brief          : Overload detection and render quality tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The sample interrupt's cycle count and overrun flag are handed to
+  * VR_QoS_SampleDone() directly, as TIM6_DAC_IRQHandler() would, and the
+  * DAC underrun callback is called as its interrupt would. Checks:
+  * - Each quality level below the noise step renders a different tooth
+  *   waveform, but the same tooth and phase after the same time, at half
+  *   the samples for the last level; above half rate the gap stays at the
+  *   DC level.
+  * - The noise step renders without the noise set, and the noise returns
+  *   when the quality steps back up.
+  * - An overrun, a DAC underrun and a merged bottom half each step the
+  *   quality down once; at the lowest level the update is counted as
+  *   saturated. Half rate doubles the TIM6 period.
+  * - Long interrupts step down only from VR_QOS_BUSY_LIMIT in one update.
+  * - The quality steps back up only after VR_QOS_RECOVER_UPDATES quiet
+  *   updates with the interrupt under VR_QOS_RECOVER_PERCENT.
+  * - The QOS command, the floor it sets and the QOS telemetry line.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_qos.h"
+#include "test_host.h"
+#include "vr_qos.h"
+#include "vr_sample.h"
+#include "vr_command.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define QOS_RPM                     3000    // 10 us samples, 1111 us teeth
+#define QOS_SAMPLES                 2000    // A little over one revolution at full rate
+#define QOS_CYCLES_PER_US           216     // SystemCoreClock in MHz
+#define QOS_QUIET_CYCLES            200     // Under VR_QOS_RECOVER_PERCENT at any level
+#define QOS_BUSY_CYCLES             (10 * QOS_CYCLES_PER_US * 6 / 10)   // 60% of a 10 us sample
+#define QOS_NOISE_LSB               20
+#define QOS_NOISE_SEED              7u
+
+/* Private variables ---------------------------------------------------------*/
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim6;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool QoS_TestLevels(void);
+static bool QoS_TestNoise(void);
+static bool QoS_TestLostSamples(void);
+static bool QoS_TestBusy(void);
+static bool QoS_TestRecover(void);
+static bool QoS_TestCommand(void);
+static bool QoS_Expect(const char *name, uint8_t level, uint32_t steps_down, uint32_t steps_up);
+static void QoS_QuietUpdates(uint32_t count, uint32_t cycles);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the overload detection and render quality tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_QoS(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing overload quality steps...\n");
+
+    VR_Test_Record(&results, QoS_TestLevels());
+    VR_Test_Record(&results, QoS_TestNoise());
+
+    VR_Test_ResetDefault();
+    VR_Emulator_SetRPM(QOS_RPM);
+    VR_Test_Record(&results, QoS_TestLostSamples());
+    VR_Test_Record(&results, QoS_TestBusy());
+    VR_Test_Record(&results, QoS_TestRecover());
+    VR_Test_Record(&results, QoS_TestCommand());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Quality step");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the waveform and tooth timing at each quality level
+  * @retval True if passed
+  */
+static bool QoS_TestLevels(void)
+{
+    VR_Emulator_t emus[VR_QUALITY_LEVELS];
+    uint32_t differ[VR_QUALITY_LEVELS] = {0};
+    uint16_t dc = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+
+    for (uint32_t q = 0; q < VR_QUALITY_LEVELS; q++) {
+        VR_Emu_Init(&emus[q], NULL);
+        VR_Emu_SetQuality(&emus[q], (VR_Quality_t)q);
+        VR_Emu_SetRPM(&emus[q], QOS_RPM);
+    }
+    if (VR_Emu_GetSamplePeriod(&emus[VR_QUALITY_HALF_RATE]) != 2 * VR_Emu_GetSamplePeriod(&emus[0])) {
+        printf("TEST FAILED: quality levels: half rate samples every %lu us\n",
+               (unsigned long)VR_Emu_GetSamplePeriod(&emus[VR_QUALITY_HALF_RATE]));
+        return false;
+    }
+
+    for (uint32_t i = 0; i < QOS_SAMPLES; i++) {
+        for (uint32_t q = 0; q < VR_QUALITY_LEVELS; q++) {
+            if (q == VR_QUALITY_HALF_RATE && (i & 1u) == 0) {
+                continue;
+            }
+            VR_Emu_GenerateSignal(&emus[q]);
+            if (emus[q].state.dac_output != emus[0].state.dac_output) {
+                differ[q]++;
+                // Only the tooth is rendered differently; the gap is flat.
+                // Half rate moves the edges by up to a sample, so may differ there.
+                if (q < VR_QUALITY_HALF_RATE &&
+                    (emus[0].state.dac_output == dc || emus[q].state.dac_output == dc)) {
+                    printf("TEST FAILED: quality levels: level %lu left the DC level at sample %lu\n",
+                           (unsigned long)q, (unsigned long)i);
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Without noise set, the noise step renders as full quality
+    for (uint32_t q = 1; q < VR_QUALITY_LEVELS; q++) {
+        if ((differ[q] == 0) != (q == VR_QUALITY_NO_NOISE) || emus[q].state.current_tooth != emus[0].state.current_tooth ||
+            emus[q].state.tooth_timer != emus[0].state.tooth_timer ||
+            emus[q].state.tooth_period_us != emus[0].state.tooth_period_us) {
+            printf("TEST FAILED: quality levels: level %lu at tooth %u, %lu us, %lu samples differ\n",
+                   (unsigned long)q, emus[q].state.current_tooth,
+                   (unsigned long)emus[q].state.tooth_timer, (unsigned long)differ[q]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that the noise step drops the noise and the step up restores it
+  * @retval True if passed
+  */
+static bool QoS_TestNoise(void)
+{
+    VR_Emulator_t clean, noisy;
+    uint32_t differ = 0;
+
+    VR_Emu_Init(&clean, NULL);
+    VR_Emu_SetRPM(&clean, QOS_RPM);
+    VR_Emu_Init(&noisy, NULL);
+    VR_Emu_SetRPM(&noisy, QOS_RPM);
+    VR_Emu_SetNoise(&noisy, QOS_NOISE_LSB, QOS_NOISE_SEED);
+    VR_Emu_SetQuality(&noisy, VR_QUALITY_NO_NOISE);
+
+    for (uint32_t i = 0; i < QOS_SAMPLES; i++) {
+        VR_Emu_GenerateSignal(&clean);
+        VR_Emu_GenerateSignal(&noisy);
+        if (noisy.state.dac_output != clean.state.dac_output) {
+            printf("TEST FAILED: quality noise: level %u at sample %lu without noise, clean %u\n",
+                   noisy.state.dac_output, (unsigned long)i, clean.state.dac_output);
+            return false;
+        }
+    }
+
+    VR_Emu_SetQuality(&noisy, VR_QUALITY_FULL);
+    for (uint32_t i = 0; i < QOS_SAMPLES; i++) {
+        VR_Emu_GenerateSignal(&clean);
+        VR_Emu_GenerateSignal(&noisy);
+        int32_t delta = (int32_t)noisy.state.dac_output - (int32_t)clean.state.dac_output;
+        if (delta > QOS_NOISE_LSB || delta < -QOS_NOISE_LSB) {
+            printf("TEST FAILED: quality noise: %ld from the clean level at sample %lu\n",
+                   (long)delta, (unsigned long)i);
+            return false;
+        }
+        differ += (delta != 0) ? 1u : 0u;
+    }
+    if (differ < QOS_SAMPLES / 2 || noisy.noise_lsb != QOS_NOISE_LSB) {
+        printf("TEST FAILED: quality noise: %lu of %u levels noisy after the step up\n",
+               (unsigned long)differ, QOS_SAMPLES);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that each kind of lost sample steps the quality down
+  * @retval True if passed
+  */
+static bool QoS_TestLostSamples(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_SensorState_t state = emu->state;
+    VR_QosStats_t stats;
+
+    VR_QoS_Update();
+    if (!QoS_Expect("no overload", VR_QUALITY_FULL, 0, 0)) {
+        return false;
+    }
+
+    VR_QoS_SampleDone(QOS_QUIET_CYCLES, true);
+    VR_QoS_Update();
+    if (!QoS_Expect("overrun", VR_QUALITY_NO_NOISE, 1, 0)) {
+        return false;
+    }
+
+    HAL_DAC_DMAUnderrunCallbackCh1(&hdac);
+    VR_QoS_Update();
+    if (!QoS_Expect("underrun", VR_QUALITY_NO_H3, 2, 0)) {
+        return false;
+    }
+
+    // Two samples before the bottom half runs: one merged
+    VR_Sample_Publish(&state, 0);
+    VR_Sample_Publish(&state, 0);
+    VR_Sample_BottomHalf();
+    VR_QoS_Update();
+    if (!QoS_Expect("merged", VR_QUALITY_SINE, 3, 0)) {
+        return false;
+    }
+
+    VR_QoS_SampleDone(QOS_QUIET_CYCLES, true);
+    VR_QoS_Update();
+    if (!QoS_Expect("overrun at sine", VR_QUALITY_HALF_RATE, 4, 0)) {
+        return false;
+    }
+    if (emu->state.sample_period_us != 20 || htim6.Init.Period != 1) {
+        printf("TEST FAILED: quality lost samples: half rate at %lu us, ARR %lu\n",
+               (unsigned long)emu->state.sample_period_us, (unsigned long)htim6.Init.Period);
+        return false;
+    }
+
+    VR_QoS_SampleDone(QOS_QUIET_CYCLES, true);
+    VR_QoS_Update();
+    VR_QoS_GetStats(&stats);
+    if (!QoS_Expect("saturated", VR_QUALITY_HALF_RATE, 4, 0) || stats.saturated != 1 ||
+        stats.overruns != 3 || stats.underruns != 1 || stats.merged != 1 ||
+        stats.worst != VR_QUALITY_HALF_RATE) {
+        printf("TEST FAILED: quality lost samples: %lu saturated, %lu/%lu/%lu lost\n",
+               (unsigned long)stats.saturated, (unsigned long)stats.overruns,
+               (unsigned long)stats.underruns, (unsigned long)stats.merged);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the busy interrupt threshold
+  * @retval True if passed
+  */
+static bool QoS_TestBusy(void)
+{
+    VR_QosStats_t stats;
+
+    // Back to full quality, at 10 us samples, without counting a step
+    VR_QoS_SetFloor(VR_QUALITY_FULL);
+    if (!QoS_Expect("busy floor", VR_QUALITY_FULL, 4, 0) ||
+        VR_Emulator_GetDefault()->state.sample_period_us != 10) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < VR_QOS_BUSY_LIMIT - 1; i++) {
+        VR_QoS_SampleDone(QOS_BUSY_CYCLES, false);
+    }
+    VR_QoS_Update();
+    VR_QoS_GetStats(&stats);
+    if (!QoS_Expect("under the busy limit", VR_QUALITY_FULL, 4, 0) || stats.peak_percent != 60) {
+        printf("TEST FAILED: quality busy: peak %u%%, expected 60%%\n", stats.peak_percent);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < VR_QOS_BUSY_LIMIT; i++) {
+        VR_QoS_SampleDone(QOS_BUSY_CYCLES, false);
+    }
+    VR_QoS_Update();
+    VR_QoS_GetStats(&stats);
+    if (!QoS_Expect("busy limit", VR_QUALITY_NO_NOISE, 5, 0) ||
+        stats.busy != 2 * VR_QOS_BUSY_LIMIT - 1) {
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the step back up after a quiet spell
+  * @retval True if passed
+  */
+static bool QoS_TestRecover(void)
+{
+    QoS_QuietUpdates(VR_QOS_RECOVER_UPDATES - 1, QOS_QUIET_CYCLES);
+    if (!QoS_Expect("recover early", VR_QUALITY_NO_NOISE, 5, 0)) {
+        return false;
+    }
+    QoS_QuietUpdates(1, QOS_QUIET_CYCLES);
+    if (!QoS_Expect("recover", VR_QUALITY_FULL, 5, 1)) {
+        return false;
+    }
+
+    // Quiet but without headroom: no step up
+    VR_QoS_SampleDone(QOS_QUIET_CYCLES, true);
+    VR_QoS_Update();
+    QoS_QuietUpdates(VR_QOS_RECOVER_UPDATES, 10 * QOS_CYCLES_PER_US * 3 / 10);
+    if (!QoS_Expect("recover without headroom", VR_QUALITY_NO_NOISE, 6, 1)) {
+        return false;
+    }
+    QoS_QuietUpdates(VR_QOS_RECOVER_UPDATES, QOS_QUIET_CYCLES);
+    return QoS_Expect("recover with headroom", VR_QUALITY_FULL, 6, 2);
+}
+
+/**
+  * @brief  Check the QOS command, the floor and the telemetry line
+  * @retval True if passed
+  */
+static bool QoS_TestCommand(void)
+{
+    VR_QosStats_t stats;
+    char line[128];
+    char expected[128];
+
+    if (!VR_Test_Command("quality", "QOS 2\r", "OK QOS FLOOR=2\r\n") ||
+        !QoS_Expect("floor", VR_QUALITY_NO_H3, 6, 2)) {
+        return false;
+    }
+    QoS_QuietUpdates(VR_QOS_RECOVER_UPDATES, QOS_QUIET_CYCLES);
+    if (!QoS_Expect("floor held", VR_QUALITY_NO_H3, 6, 2)) {
+        return false;
+    }
+
+    VR_QoS_GetStats(&stats);
+    snprintf(expected, sizeof(expected), "OK QOS LEVEL=2 FLOOR=2 WORST=4 DOWN=6 UP=2 LOST=%lu\r\n",
+             (unsigned long)(stats.overruns + stats.underruns + stats.merged));
+    if (!VR_Test_Command("quality", "QOS\r", expected)) {
+        return false;
+    }
+
+    snprintf(expected, sizeof(expected),
+             "QOS level=2 worst=4 down=6 up=2 ovr=%lu udr=%lu merged=%lu busy=%lu sat=1\r\n",
+             (unsigned long)stats.overruns, (unsigned long)stats.underruns,
+             (unsigned long)stats.merged, (unsigned long)stats.busy);
+    uint32_t len = VR_QoS_FormatTelemetry(line, sizeof(line));
+    if (len != strlen(expected) || strcmp(line, expected) != 0) {
+        printf("TEST FAILED: quality telemetry: \"%s\"\n", line);
+        return false;
+    }
+
+    return VR_Test_Command("quality", "QOS 5\r", "ERR unknown QOS command\r\n") &&
+           VR_Test_Command("quality", "QOS 0\r", "OK QOS FLOOR=0\r\n") &&
+           QoS_Expect("floor released", VR_QUALITY_FULL, 6, 2);
+}
+
+/**
+  * @brief  Compare the quality in use and the step counts
+  * @param  name: Check name for the failure message
+  * @param  level: Quality expected
+  * @param  steps_down: Steps down expected
+  * @param  steps_up: Steps up expected
+  * @retval True if all matched, and the default emulator uses that quality
+  */
+static bool QoS_Expect(const char *name, uint8_t level, uint32_t steps_down, uint32_t steps_up)
+{
+    VR_QosStats_t stats;
+
+    VR_QoS_GetStats(&stats);
+    if (stats.level != level || VR_Emulator_GetDefault()->quality != level ||
+        stats.steps_down != steps_down || stats.steps_up != steps_up) {
+        printf("TEST FAILED: quality %s: level %u (emulator %u), %lu down, %lu up; expected %u, %lu, %lu\n",
+               name, stats.level, VR_Emulator_GetDefault()->quality, (unsigned long)stats.steps_down,
+               (unsigned long)stats.steps_up, level, (unsigned long)steps_down, (unsigned long)steps_up);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Run control updates with one short sample interrupt each
+  * @param  count: Number of updates
+  * @param  cycles: Length of each sample interrupt
+  * @retval None
+  */
+static void QoS_QuietUpdates(uint32_t count, uint32_t cycles)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        VR_QoS_SampleDone(cycles, false);
+        VR_QoS_Update();
+    }
+}
+
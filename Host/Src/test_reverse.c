@@ -0,0 +1,484 @@
+/**
+  ******************************************************************************
+  * @file           : test_reverse.c
+  * @brief          : Reverse rotation tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Checks:
+  * - Backwards, each level is the forward level at the same wheel
+  *   position mirrored about the DC offset before the clamp, so both
+  *   directions swing over the same range, with the built-in model and
+  *   with a table. The teeth come in descending order and keep their
+  *   forward length.
+  * - Skipping updates backwards lands where rendering them would,
+  *   including after an RPM step that left the timer past the tooth.
+  * - The phase is held through a stop, a change of direction costs one
+  *   parameter update, and turning back as far returns to the same place.
+  * - The digital output treats reverse as the wheel at rest, and picks
+  *   up again when the wheel turns forwards.
+  * - The counters count the teeth and revolutions turned backwards.
+  * - A host profile through zero into negative RPM renders identically
+  *   in sequential and chunked parallel runs.
+  * - The DIR command.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_reverse.h"
+#include "test_host.h"
+#include "vr_command.h"
+#include "vr_counters.h"
+#include "vr_digital_output.h"
+#include "vr_host_sim.h"
+#include "vr_sample.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define REVERSE_RPM                 3000    // 10 us samples, 1111 us teeth
+#define REVERSE_RPM_SLOW            1500
+#define REVERSE_SAMPLES             5000
+#define REVERSE_REVOLUTIONS         3
+#define REVERSE_PROFILE             "0:1500,0.1:-1500,0.15:-4000,0.25:0,0.3:0,0.35:-2000"
+#define REVERSE_PROFILE_TICKS       35000   // 0.35 s
+#define REVERSE_CHUNK_TICKS         3001
+#define REVERSE_THREADS             3
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint64_t hash;
+    uint64_t holds;
+} ReverseHash_t;
+
+/* Private variables ---------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+
+static const uint64_t reverse_skip_counts[] = {1, 5, 110, 111, 112, 1998, 5000, 40000};
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Reverse_TestWaveform(void);
+static bool Reverse_TestSkip(void);
+static bool Reverse_TestStop(void);
+static bool Reverse_TestDigital(void);
+static bool Reverse_TestCounters(void);
+static bool Reverse_TestProfile(void);
+static bool Reverse_TestCommand(void);
+static bool Reverse_Matches(uint16_t level, uint16_t forward);
+static void Reverse_Step(void);
+static void Reverse_HashSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the reverse rotation tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Reverse(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing reverse rotation...\n");
+
+    VR_Test_Record(&results, Reverse_TestWaveform());
+    VR_Test_Record(&results, Reverse_TestSkip());
+    VR_Test_Record(&results, Reverse_TestStop());
+
+    VR_Test_ResetDefault();
+    VR_Emulator_SetRPM(REVERSE_RPM);
+    VR_Test_Record(&results, Reverse_TestDigital());
+    VR_Test_Record(&results, Reverse_TestCounters());
+    VR_Test_Record(&results, Reverse_TestProfile());
+    VR_Test_Record(&results, Reverse_TestCommand());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Reverse rotation");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the mirrored levels and the tooth order and length
+  * @retval True if passed
+  */
+static bool Reverse_TestWaveform(void)
+{
+    VR_Emulator_t emu, forward;
+    VR_ToothShape_t shape;
+    uint32_t step, in_tooth = 0, whole_teeth = 0;
+    uint16_t forward_min = DAC_RESOLUTION, forward_max = 0, reverse_min = DAC_RESOLUTION, reverse_max = 0;
+    bool counting = false;
+
+    VR_Emu_Init(&emu, NULL);
+    VR_Emu_SetSpeed(&emu, -REVERSE_RPM);
+    VR_Emu_Init(&forward, NULL);
+    VR_Emu_SetRPM(&forward, REVERSE_RPM);
+    step = VR_Emu_GetSamplePeriod(&emu);
+
+    if (VR_Emu_GetSpeed(&emu) != -REVERSE_RPM || VR_Emu_GetRPM(&emu) != REVERSE_RPM || !emu.state.reverse) {
+        printf("TEST FAILED: reverse waveform: speed %ld, RPM %u\n",
+               (long)VR_Emu_GetSpeed(&emu), VR_Emu_GetRPM(&emu));
+        return false;
+    }
+
+    for (uint32_t i = 0; i < REVERSE_SAMPLES; i++) {
+        uint8_t tooth = emu.state.current_tooth;
+
+        VR_Emu_GenerateSignal(&emu);
+
+        // Forward rendering of the same position, reached by one step forwards
+        if (emu.state.tooth_timer >= step) {
+            forward.state.current_tooth = emu.state.current_tooth;
+            forward.state.tooth_timer = emu.state.tooth_timer - step;
+            VR_Emu_GenerateSignal(&forward);
+            if (!Reverse_Matches(emu.state.dac_output, forward.state.dac_output)) {
+                printf("TEST FAILED: reverse waveform: level %u at tooth %u, %lu us, forward %u\n",
+                       emu.state.dac_output, emu.state.current_tooth,
+                       (unsigned long)emu.state.tooth_timer, forward.state.dac_output);
+                return false;
+            }
+            forward_min = (forward.state.dac_output < forward_min) ? forward.state.dac_output : forward_min;
+            forward_max = (forward.state.dac_output > forward_max) ? forward.state.dac_output : forward_max;
+            reverse_min = (emu.state.dac_output < reverse_min) ? emu.state.dac_output : reverse_min;
+            reverse_max = (emu.state.dac_output > reverse_max) ? emu.state.dac_output : reverse_max;
+        }
+
+        in_tooth++;
+        if (emu.state.current_tooth == tooth) {
+            continue;
+        }
+        if (emu.state.current_tooth != (tooth + TRIGGER_WHEEL_TEETH - 1) % TRIGGER_WHEEL_TEETH) {
+            printf("TEST FAILED: reverse waveform: tooth %u followed tooth %u\n",
+                   emu.state.current_tooth, tooth);
+            return false;
+        }
+        // A 1111 us tooth lasts 111 or 112 samples of 10 us, as forwards
+        if (counting && in_tooth != emu.state.tooth_period_us / step &&
+            in_tooth != emu.state.tooth_period_us / step + 1) {
+            printf("TEST FAILED: reverse waveform: tooth %u lasted %lu samples\n",
+                   tooth, (unsigned long)in_tooth);
+            return false;
+        }
+        whole_teeth += counting ? 1u : 0u;
+        counting = true;
+        in_tooth = 0;
+    }
+
+    if (whole_teeth < REVERSE_SAMPLES / 112 - 1) {
+        printf("TEST FAILED: reverse waveform: only %lu teeth\n", (unsigned long)whole_teeth);
+        return false;
+    }
+
+    // The forward model clips at both ends of the DAC range, and so must reverse
+    if (reverse_max - reverse_min != forward_max - forward_min) {
+        printf("TEST FAILED: reverse waveform: %u..%u backwards, %u..%u forwards\n",
+               reverse_min, reverse_max, forward_min, forward_max);
+        return false;
+    }
+
+    // A table swinging past both ends: backwards, the negative plateau
+    // rises above twice the DC offset and the positive one clips at 0
+    VR_Shape_Clear(&shape);
+    for (uint32_t i = 0; i < 8; i++) {
+        VR_Shape_Append(&shape, VR_SHAPE_REGULAR, (i < 4) ? 3000 : -2000);
+        VR_Shape_Append(&shape, VR_SHAPE_MISSING, (i < 4) ? 3000 : -2000);
+    }
+    VR_Emu_Init(&emu, NULL);
+    VR_Emu_SetSpeed(&emu, -REVERSE_RPM);
+    VR_Emu_SetShape(&emu, &shape);
+    reverse_min = DAC_RESOLUTION;
+    reverse_max = 0;
+    for (uint32_t i = 0; i < REVERSE_SAMPLES; i++) {
+        VR_Emu_GenerateSignal(&emu);
+        reverse_min = (emu.state.dac_output < reverse_min) ? emu.state.dac_output : reverse_min;
+        reverse_max = (emu.state.dac_output > reverse_max) ? emu.state.dac_output : reverse_max;
+    }
+    if (reverse_min != 0 || reverse_max != VR_DC_LEVEL + 2000) {
+        printf("TEST FAILED: reverse waveform: table swings %u..%u backwards, expected 0..%u\n",
+               reverse_min, reverse_max, VR_DC_LEVEL + 2000);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that skipping backwards matches rendering
+  * @retval True if passed
+  */
+static bool Reverse_TestSkip(void)
+{
+    for (uint32_t slow = 0; slow < 2; slow++) {
+        for (uint32_t i = 0; i < sizeof(reverse_skip_counts) / sizeof(reverse_skip_counts[0]); i++) {
+            VR_Emulator_t skipped, rendered;
+            uint64_t count = reverse_skip_counts[i];
+
+            VR_Emu_Init(&rendered, NULL);
+            VR_Emu_SetSpeed(&rendered, slow ? -300 : -REVERSE_RPM);
+            for (uint32_t j = 0; j < 777; j++) {
+                VR_Emu_GenerateSignal(&rendered);
+            }
+            // From 300 RPM the timer is left past the end of the faster tooth
+            if (slow) {
+                VR_Emu_SetSpeed(&rendered, -6000);
+            }
+            skipped = rendered;
+
+            VR_Emu_Skip(&skipped, count);
+            for (uint64_t j = 0; j < count; j++) {
+                VR_Emu_GenerateSignal(&rendered);
+            }
+            if (skipped.state.current_tooth != rendered.state.current_tooth ||
+                skipped.state.tooth_timer != rendered.state.tooth_timer) {
+                printf("TEST FAILED: reverse skip %llu%s: tooth %u at %lu us, rendered tooth %u at %lu us\n",
+                       (unsigned long long)count, slow ? " after RPM step" : "",
+                       skipped.state.current_tooth, (unsigned long)skipped.state.tooth_timer,
+                       rendered.state.current_tooth, (unsigned long)rendered.state.tooth_timer);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the phase through a stop and a change of direction
+  * @retval True if passed
+  */
+static bool Reverse_TestStop(void)
+{
+    VR_Emulator_t emu;
+    uint8_t tooth;
+    uint32_t timer, updates;
+
+    VR_Emu_Init(&emu, NULL);
+    VR_Emu_SetSpeed(&emu, REVERSE_RPM_SLOW);
+    for (uint32_t i = 0; i < 1234; i++) {
+        VR_Emu_GenerateSignal(&emu);
+    }
+
+    // Stopped, the wheel stays where it is in either direction
+    tooth = emu.state.current_tooth;
+    timer = emu.state.tooth_timer;
+    updates = emu.updates;
+    VR_Emu_SetSpeed(&emu, 0);
+    VR_Emu_SetReverse(&emu, true);
+    for (uint32_t i = 0; i < 100; i++) {
+        VR_Emu_GenerateSignal(&emu);
+    }
+    if (emu.state.current_tooth != tooth || emu.state.tooth_timer != timer ||
+        emu.updates != updates + 2 || VR_Emu_GetSpeed(&emu) != 0) {
+        printf("TEST FAILED: reverse stop: moved to tooth %u, %lu us while stopped (%lu updates)\n",
+               emu.state.current_tooth, (unsigned long)emu.state.tooth_timer,
+               (unsigned long)(emu.updates - updates));
+        return false;
+    }
+
+    // Backwards and forwards again by as many updates returns to the start
+    VR_Emu_SetSpeed(&emu, -REVERSE_RPM_SLOW);
+    for (uint32_t i = 0; i < 3210; i++) {
+        VR_Emu_GenerateSignal(&emu);
+    }
+    VR_Emu_SetSpeed(&emu, REVERSE_RPM_SLOW);
+    for (uint32_t i = 0; i < 3210; i++) {
+        VR_Emu_GenerateSignal(&emu);
+    }
+    if (emu.state.current_tooth != tooth || emu.state.tooth_timer != timer || emu.state.reverse ||
+        emu.updates != updates + 4) {
+        printf("TEST FAILED: reverse stop: returned to tooth %u, %lu us, expected %u, %lu us\n",
+               emu.state.current_tooth, (unsigned long)emu.state.tooth_timer, tooth, (unsigned long)timer);
+        return false;
+    }
+
+    // The RPM alone keeps the direction, as the potentiometer sets it
+    VR_Emu_SetSpeed(&emu, -REVERSE_RPM_SLOW);
+    VR_Emu_SetRPM(&emu, REVERSE_RPM);
+    if (VR_Emu_GetSpeed(&emu) != -REVERSE_RPM) {
+        printf("TEST FAILED: reverse stop: RPM change gave speed %ld\n", (long)VR_Emu_GetSpeed(&emu));
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that the digital output stops backwards and restarts forwards
+  * @retval True if passed
+  */
+static bool Reverse_TestDigital(void)
+{
+    bool passed = true;
+
+    VR_Digital_Start();
+    for (uint32_t i = 0; i < 10; i++) {
+        Reverse_Step();
+    }
+    uint32_t resyncs = VR_Digital_GetResyncs();
+
+    VR_Emulator_SetReverse(true);
+    for (uint32_t i = 0; i < 500; i++) {
+        Reverse_Step();
+    }
+    if (VR_Digital_GetResyncs() != resyncs + 1 || (htim2.Instance->DIER & TIM_DMA_CC4) != 0) {
+        printf("TEST FAILED: reverse digital: %lu resyncs, edges %s\n",
+               (unsigned long)(VR_Digital_GetResyncs() - resyncs),
+               (htim2.Instance->DIER & TIM_DMA_CC4) ? "running" : "stopped");
+        passed = false;
+    }
+
+    VR_Emulator_SetReverse(false);
+    Reverse_Step();
+    if (passed && (VR_Digital_GetResyncs() != resyncs + 2 || (htim2.Instance->DIER & TIM_DMA_CC4) == 0)) {
+        printf("TEST FAILED: reverse digital: edges did not restart forwards\n");
+        passed = false;
+    }
+
+    VR_Digital_Stop();
+    return passed;
+}
+
+/**
+  * @brief  Check the teeth, revolutions and speed counted backwards
+  * @retval True if passed
+  */
+static bool Reverse_TestCounters(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_Counters_t before, after;
+    uint32_t samples = 0, teeth = 0, revolutions = 0;
+
+    VR_Emulator_SetReverse(true);
+    VR_Counters_PhaseJump();
+    VR_Counters_Snapshot(&before);
+    while (revolutions < REVERSE_REVOLUTIONS) {
+        uint8_t tooth = emu->state.current_tooth;
+
+        Reverse_Step();
+        if (samples++ > 0 && emu->state.current_tooth != tooth) {
+            teeth++;
+            if (tooth == 0) {
+                revolutions++;
+            }
+        }
+    }
+    VR_Counters_Snapshot(&after);
+    VR_Emulator_SetReverse(false);
+
+    uint32_t expected = (uint32_t)(60000000000ull / (TRIGGER_WHEEL_TEETH * emu->state.tooth_period_us));
+    uint32_t error = (after.rpm_milli > expected) ? after.rpm_milli - expected : expected - after.rpm_milli;
+    if (after.samples - before.samples != samples || after.teeth - before.teeth != teeth ||
+        after.revolutions - before.revolutions != revolutions || error > 2000) {
+        printf("TEST FAILED: reverse counters: %lu samples, %lu teeth, %lu revs at %lu mrpm, "
+               "expected %lu, %lu, %lu at %lu\n",
+               (unsigned long)(after.samples - before.samples), (unsigned long)(after.teeth - before.teeth),
+               (unsigned long)(after.revolutions - before.revolutions), (unsigned long)after.rpm_milli,
+               (unsigned long)samples, (unsigned long)teeth, (unsigned long)revolutions,
+               (unsigned long)expected);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check a profile through zero into negative RPM, sequential and parallel
+  * @retval True if passed
+  */
+static bool Reverse_TestProfile(void)
+{
+    VR_Profile_t profile;
+    VR_Emulator_t emu;
+    ReverseHash_t sequential = {14695981039346656037ull, 0};
+    ReverseHash_t parallel = {14695981039346656037ull, 0};
+
+    if (!VR_Profile_Parse(&profile, REVERSE_PROFILE) || VR_Profile_RPMAt(&profile, 0.2) >= 0.0f) {
+        printf("TEST FAILED: reverse profile: \"%s\" not parsed\n", REVERSE_PROFILE);
+        return false;
+    }
+
+    uint64_t samples = VR_HostSim_RunInstance(&emu, &profile, REVERSE_PROFILE_TICKS,
+                                              VR_HOST_CONTROL_PERIOD_TICKS, Reverse_HashSink, &sequential);
+    if (VR_Emu_GetSpeed(&emu) > -1900) {
+        printf("TEST FAILED: reverse profile: ended at %ld RPM\n", (long)VR_Emu_GetSpeed(&emu));
+        return false;
+    }
+
+    uint64_t chunked = VR_HostSim_RunParallel(&profile, REVERSE_PROFILE_TICKS, VR_HOST_CONTROL_PERIOD_TICKS,
+                                              REVERSE_THREADS, REVERSE_CHUNK_TICKS, Reverse_HashSink, &parallel);
+    if (chunked != samples || parallel.hash != sequential.hash || parallel.holds != sequential.holds) {
+        printf("TEST FAILED: reverse profile: parallel render differs (%llu/%llu samples, %llu/%llu holds)\n",
+               (unsigned long long)chunked, (unsigned long long)samples,
+               (unsigned long long)parallel.holds, (unsigned long long)sequential.holds);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the DIR command
+  * @retval True if passed
+  */
+static bool Reverse_TestCommand(void)
+{
+    VR_Emulator_SetSpeed(REVERSE_RPM);
+
+    return VR_Test_Command("reverse", "DIR\r", "OK DIR FWD RPM=3000\r\n") &&
+           VR_Test_Command("reverse", "dir rev\r", "OK DIR REV\r\n") &&
+           VR_Test_Command("reverse", "DIR\r", "OK DIR REV RPM=-3000\r\n") &&
+           VR_Test_Command("reverse", "DIR FWD\r", "OK DIR FWD\r\n") &&
+           VR_Test_Command("reverse", "DIR BACK\r", "ERR unknown DIR command\r\n") &&
+           VR_Emulator_GetSpeed() == REVERSE_RPM;
+}
+
+/**
+  * @brief  Check a reverse level against the forward level at the same position
+  * @note   The forward level is mirrored about the DC offset. Where it was
+  *         clamped at 0, the forward swing is only known to reach at least
+  *         that far, so the reverse level is at least the mirror.
+  * @param  level: Reverse level
+  * @param  forward: Forward level
+  * @retval True if the levels match
+  */
+static bool Reverse_Matches(uint16_t level, uint16_t forward)
+{
+    int32_t mirrored = 2 * (int32_t)VR_DC_LEVEL - (int32_t)forward;
+
+    if (forward == 0) {
+        return level >= mirrored;
+    }
+    return level == ((mirrored < 0) ? 0 : mirrored);
+}
+
+/**
+  * @brief  Advance TIM2 one sample period and run both halves of the sample interrupt
+  * @retval None
+  */
+static void Reverse_Step(void)
+{
+    uint32_t step = VR_Emu_GetSamplePeriod(VR_Emulator_GetDefault()) * VR_DIGITAL_TICKS_PER_US;
+
+    Host_TIM2_RunTo(htim2.Instance->CNT + step);
+    VR_Sample_TopHalf();
+    VR_Sample_BottomHalf();
+}
+
+/**
+  * @brief  Hash each held level in order
+  * @param  ctx: ReverseHash_t to update
+  * @param  dac_value: Level held
+  * @param  start_tick: First tick of the hold
+  * @param  num_ticks: Length of the hold
+  * @retval None
+  */
+static void Reverse_HashSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    ReverseHash_t *h = (ReverseHash_t *)ctx;
+    uint64_t words[3] = {dac_value, start_tick, num_ticks};
+
+    for (uint32_t i = 0; i < 3; i++) {
+        h->hash = (h->hash ^ words[i]) * 1099511628211ull;
+    }
+    h->holds++;
+}
+
@@ -0,0 +1,346 @@
+/**
+  ******************************************************************************
+  * @file           : test_revolution.c
+  * @brief          : Revolution output mode tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each Host_TIM6_Update() is one DAC trigger, so the output seen after
+  * it is the level DMA loaded at the trigger before. Checks:
+  * - The tooth period is rounded so a revolution is a whole number of
+  *   samples, and the mode takes the DAC and TIM6 over from the per-sample
+  *   interrupt.
+  * - Two revolutions played back match an unbound emulator run at the
+  *   rounded period sample for sample, with two transfer interrupts per
+  *   revolution, each handing a sample to the bottom half.
+  * - An RPM change is rendered into the other buffer and swapped in at the
+  *   end of the revolution playing, with its TIM6 period, without a seam.
+  * - Stopping hands the DAC and TIM6 back to the default instance.
+  * - The REV telemetry line and the REV command.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_revolution.h"
+#include "test_host.h"
+#include "vr_revolution.h"
+#include "vr_sample.h"
+#include "vr_digital_output.h"
+#include "vr_command.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define REV_RPM_FAST                3000    // 10 us samples, 1111 us teeth
+#define REV_RPM_SLOW                600     // 30 us samples, 5556 us teeth
+#define REV_TOOTH_FAST_US           1110    // Rounded to a multiple of 5 us
+#define REV_TOOTH_SLOW_US           5555
+#define REV_LENGTH_FAST             1998    // 18 * 1110 / 10
+#define REV_LENGTH_SLOW             3333    // 18 * 5555 / 30, odd
+
+/* Private variables ---------------------------------------------------------*/
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Rev_RenderAll(void);
+static uint16_t *Rev_Reference(uint16_t rpm, uint32_t tooth_period_us, uint32_t count);
+static bool Rev_TestStart(void);
+static bool Rev_TestPlayback(void);
+static bool Rev_TestSwap(void);
+static bool Rev_TestStop(void);
+static bool Rev_TestTelemetry(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the revolution output mode tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Revolution(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing revolution output mode...\n");
+
+    VR_Test_ResetDefault();
+    VR_Emulator_SetRPM(REV_RPM_FAST);
+    VR_Test_Record(&results, Rev_TestStart());
+    VR_Test_Record(&results, Rev_TestPlayback());
+    VR_Test_Record(&results, Rev_TestSwap());
+    VR_Test_Record(&results, Rev_TestStop());
+    VR_Test_Record(&results, Rev_TestTelemetry());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Revolution mode");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Call VR_Rev_Update() until the render in progress completes
+  * @retval True if it completed within the expected number of calls
+  */
+static bool Rev_RenderAll(void)
+{
+    uint32_t calls = 0;
+
+    while (VR_Rev_Update()) {
+        if (++calls > VR_REV_MAX_SAMPLES / VR_REV_RENDER_CHUNK + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Render levels with an unbound instance at a given tooth period
+  * @param  rpm: Set point, which selects the sample period
+  * @param  tooth_period_us: Tooth period to render at
+  * @param  count: Number of samples
+  * @retval Levels, to be freed by the caller; NULL if out of memory
+  */
+static uint16_t *Rev_Reference(uint16_t rpm, uint32_t tooth_period_us, uint32_t count)
+{
+    VR_Emulator_t ref;
+    uint16_t *levels = malloc(count * sizeof(uint16_t));
+
+    if (levels == NULL) {
+        return NULL;
+    }
+
+    VR_Emu_Init(&ref, NULL);
+    VR_Emu_SetShape(&ref, VR_Emulator_GetDefault()->shape);
+    VR_Emu_SetRPM(&ref, rpm);
+    ref.state.tooth_period_us = tooth_period_us;
+    for (uint32_t i = 0; i < count; i++) {
+        VR_Emu_GenerateSignal(&ref);
+        levels[i] = ref.state.dac_output;
+    }
+    return levels;
+}
+
+/**
+  * @brief  Check the first render and the switch to DMA output
+  * @retval True if passed
+  */
+static bool Rev_TestStart(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_RevStats_t stats;
+
+    VR_Rev_Start();
+    if (!VR_Rev_IsEnabled() || (htim6.Instance->DIER & TIM_IT_UPDATE) == 0) {
+        printf("TEST FAILED: revolution start: output switched before the render\n");
+        return false;
+    }
+    if (!Rev_RenderAll()) {
+        printf("TEST FAILED: revolution start: render did not complete\n");
+        return false;
+    }
+
+    VR_Rev_GetStats(&stats);
+    if (stats.length != REV_LENGTH_FAST || stats.tooth_period_us != REV_TOOTH_FAST_US ||
+        (TRIGGER_WHEEL_TEETH * stats.tooth_period_us) % VR_Emu_GetSamplePeriod(emu) != 0) {
+        printf("TEST FAILED: revolution start: %lu samples at %lu us, expected %u at %u us\n",
+               (unsigned long)stats.length, (unsigned long)stats.tooth_period_us,
+               REV_LENGTH_FAST, REV_TOOTH_FAST_US);
+        return false;
+    }
+    if ((htim6.Instance->DIER & TIM_IT_UPDATE) != 0 || hdac.trigger != DAC_TRIGGER_T6_TRGO ||
+        (htim6.Instance->CR1 & TIM_CR1_ARPE) == 0 || htim6.Init.Period != 0 ||
+        emu->binding.hdac != NULL || emu->binding.htim != NULL) {
+        printf("TEST FAILED: revolution start: DAC and TIM6 not handed to DMA\n");
+        return false;
+    }
+
+    // A second update with nothing changed renders nothing
+    bool again = VR_Rev_Update();
+    VR_Rev_GetStats(&stats);
+    if (again || stats.renders != 1) {
+        printf("TEST FAILED: revolution start: %lu renders for one set point\n",
+               (unsigned long)stats.renders);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check two revolutions of output against the per-sample model
+  * @retval True if passed
+  */
+static bool Rev_TestPlayback(void)
+{
+    uint16_t *expected = Rev_Reference(REV_RPM_FAST, REV_TOOTH_FAST_US, 2 * REV_LENGTH_FAST);
+    VR_SampleStats_t before, after;
+    VR_RevStats_t stats;
+    bool passed = true;
+
+    if (expected == NULL) {
+        printf("TEST FAILED: revolution playback: out of memory\n");
+        return false;
+    }
+
+    // The first trigger outputs the level held from before the DMA started
+    VR_Sample_GetStats(&before);
+    Host_TIM6_Update();
+    for (uint32_t i = 0; i < 2 * REV_LENGTH_FAST && passed; i++) {
+        htim2.Instance->CNT += 10 * VR_DIGITAL_TICKS_PER_US;
+        Host_TIM6_Update();
+        if (hdac.DHR12R1 != expected[i]) {
+            printf("TEST FAILED: revolution playback: sample %lu is %lu, expected %u\n",
+                   (unsigned long)i, (unsigned long)hdac.DHR12R1, expected[i]);
+            passed = false;
+        }
+    }
+    free(expected);
+    if (!passed) {
+        return false;
+    }
+
+    VR_Sample_GetStats(&after);
+    VR_Rev_GetStats(&stats);
+    if (stats.revolutions != 2 || after.samples != before.samples + 4 || after.runs != before.runs + 4) {
+        printf("TEST FAILED: revolution playback: %lu revolutions, %lu samples, %lu bottom halves\n",
+               (unsigned long)stats.revolutions, (unsigned long)(after.samples - before.samples),
+               (unsigned long)(after.runs - before.runs));
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that a new RPM is swapped in at the revolution end
+  * @retval True if passed
+  */
+static bool Rev_TestSwap(void)
+{
+    uint16_t *expected = Rev_Reference(REV_RPM_SLOW, REV_TOOTH_SLOW_US, REV_LENGTH_SLOW + 1);
+    VR_RevStats_t stats;
+    uint32_t played = 0;
+    bool passed = true;
+
+    if (expected == NULL) {
+        printf("TEST FAILED: revolution swap: out of memory\n");
+        return false;
+    }
+
+    // Part way into the third revolution, then a slower set point
+    for (uint32_t i = 0; i < 100; i++) {
+        Host_TIM6_Update();
+    }
+    VR_Emulator_SetRPM(REV_RPM_SLOW);
+    if (!Rev_RenderAll() || htim6.Init.Period != 0) {
+        printf("TEST FAILED: revolution swap: new period applied before the revolution end\n");
+        free(expected);
+        return false;
+    }
+
+    // The rest of the playing revolution, up to the transfer complete
+    VR_Rev_GetStats(&stats);
+    while (stats.swaps == 0 && played < REV_LENGTH_FAST) {
+        Host_TIM6_Update();
+        VR_Rev_GetStats(&stats);
+        played++;
+    }
+    if (stats.swaps != 1 || played != REV_LENGTH_FAST - 100 - 1 || htim6.Init.Period != 2 ||
+        stats.length != REV_LENGTH_SLOW || stats.tooth_period_us != REV_TOOTH_SLOW_US) {
+        printf("TEST FAILED: revolution swap: swapped after %lu samples, length %lu, ARR %lu\n",
+               (unsigned long)played, (unsigned long)stats.length, (unsigned long)htim6.Init.Period);
+        free(expected);
+        return false;
+    }
+
+    // The last level of the old revolution, then the new one from its start
+    Host_TIM6_Update();
+    for (uint32_t i = 0; i <= REV_LENGTH_SLOW && passed; i++) {
+        Host_TIM6_Update();
+        if (hdac.DHR12R1 != expected[i % REV_LENGTH_SLOW]) {
+            printf("TEST FAILED: revolution swap: sample %lu is %lu, expected %u\n",
+                   (unsigned long)i, (unsigned long)hdac.DHR12R1, expected[i % REV_LENGTH_SLOW]);
+            passed = false;
+        }
+    }
+    free(expected);
+    return passed;
+}
+
+/**
+  * @brief  Check that stopping returns to one interrupt per sample
+  * @retval True if passed
+  */
+static bool Rev_TestStop(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_SampleStats_t before, after;
+
+    VR_Rev_Stop();
+    if (VR_Rev_IsEnabled() || (htim6.Instance->DIER & TIM_IT_UPDATE) == 0 ||
+        hdac.trigger != DAC_TRIGGER_NONE || (htim6.Instance->CR1 & TIM_CR1_ARPE) != 0 ||
+        emu->binding.hdac != &hdac || emu->binding.htim != &htim6 || htim6.Init.Period != 2) {
+        printf("TEST FAILED: revolution stop: DAC and TIM6 not handed back\n");
+        return false;
+    }
+    if (emu->state.tooth_timer >= emu->state.tooth_period_us) {
+        printf("TEST FAILED: revolution stop: resumed past the end of tooth %u\n",
+               emu->state.current_tooth);
+        return false;
+    }
+
+    // Each update now renders a sample in the TIM6 interrupt
+    VR_Sample_GetStats(&before);
+    Host_TIM6_Update();
+    VR_Sample_GetStats(&after);
+    if (after.samples != before.samples + 1 || hdac.DHR12R1 != emu->state.dac_output) {
+        printf("TEST FAILED: revolution stop: TIM6 interrupt not resumed\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the REV telemetry line and the REV command
+  * @retval True if passed
+  */
+static bool Rev_TestTelemetry(void)
+{
+    VR_RevStats_t stats;
+    char line[96];
+    char expected[96];
+
+    if (VR_Rev_FormatTelemetry(line, sizeof(line)) != 0 || line[0] != '\0') {
+        printf("TEST FAILED: revolution telemetry: line while the mode is off\n");
+        return false;
+    }
+
+    if (!VR_Test_Command("revolution", "REV ON\r", "OK REV ON\r\n") || !Rev_RenderAll()) {
+        return false;
+    }
+    VR_Rev_GetStats(&stats);
+    snprintf(expected, sizeof(expected), "REV len=%u tooth=%uus revs=%lu renders=%lu swaps=%lu\r\n",
+             REV_LENGTH_SLOW, REV_TOOTH_SLOW_US, (unsigned long)stats.revolutions,
+             (unsigned long)stats.renders, (unsigned long)stats.swaps);
+    uint32_t len = VR_Rev_FormatTelemetry(line, sizeof(line));
+    if (len != strlen(expected) || strcmp(line, expected) != 0) {
+        printf("TEST FAILED: revolution telemetry: \"%s\"\n", line);
+        return false;
+    }
+    if (VR_Rev_FormatTelemetry(line, 8) != 7 || strlen(line) != 7) {
+        printf("TEST FAILED: revolution telemetry: short buffer not truncated\n");
+        return false;
+    }
+
+    snprintf(expected, sizeof(expected), "OK REV ON LEN=%u TOOTH=%u REVS=%lu SWAPS=%lu\r\n",
+             REV_LENGTH_SLOW, REV_TOOTH_SLOW_US, (unsigned long)stats.revolutions,
+             (unsigned long)stats.swaps);
+    return VR_Test_Command("revolution", "REV\r", expected) &&
+           VR_Test_Command("revolution", "REV OFF\r", "OK REV OFF\r\n") &&
+           VR_Test_Command("revolution", "REV SIDEWAYS\r", "ERR unknown REV command\r\n") && !VR_Rev_IsEnabled();
+}
+
@@ -0,0 +1,206 @@
+/**
+  ******************************************************************************
+  * @file           : test_sample.c
+  * @brief          : Sample interrupt split tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The host normally runs the bottom half straight after each top half.
+  * These tests call the two halves separately to stand in for a PendSV
+  * that is held off. Checks:
+  * - Each top half renders a sample and counts it, and a bottom half with
+  *   no new sample does nothing.
+  * - Samples that arrive before the bottom half runs are merged: it runs
+  *   once, counts the others, and the digital output adopts the latest
+  *   RPM only.
+  * - The SAMPLE telemetry line, and the "bh" cycle probe line.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_sample.h"
+#include "test_host.h"
+#include "vr_sample.h"
+#include "vr_cycles.h"
+#include "vr_digital_output.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define SAMPLE_RPM_START            1000
+#define SAMPLE_RPM_SKIPPED          3000
+#define SAMPLE_RPM_LATEST           5000
+
+/* Private variables ---------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Sample_Step(void);
+static bool Sample_TestIdle(void);
+static bool Sample_TestMerge(void);
+static bool Sample_TestTelemetry(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the sample interrupt split tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_SampleIsr(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing sample interrupt split...\n");
+
+    VR_Test_ResetDefault();
+    VR_Emulator_SetRPM(SAMPLE_RPM_START);
+    VR_Test_Record(&results, Sample_TestIdle());
+    VR_Test_Record(&results, Sample_TestMerge());
+    VR_Test_Record(&results, Sample_TestTelemetry());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Sample interrupt");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Advance TIM2 by one sample period plus the interrupt latency
+  * @retval None
+  */
+static void Sample_Step(void)
+{
+    uint32_t step = VR_Emu_GetSamplePeriod(VR_Emulator_GetDefault()) * VR_DIGITAL_TICKS_PER_US;
+
+    Host_TIM2_RunTo(htim2.Instance->CNT + step);
+}
+
+/**
+  * @brief  Check the counters, and a bottom half with nothing new
+  * @retval True if passed
+  */
+static bool Sample_TestIdle(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_SampleStats_t before, after;
+
+    VR_Sample_GetStats(&before);
+    uint32_t tooth_timer = emu->state.tooth_timer;
+    Sample_Step();
+    VR_Sample_TopHalf();
+    VR_Sample_GetStats(&after);
+
+    if (after.samples != before.samples + 1 || after.runs != before.runs
+        || emu->state.tooth_timer == tooth_timer) {
+        printf("TEST FAILED: sample idle: top half did not render and count one sample\n");
+        return false;
+    }
+
+    VR_Sample_BottomHalf();
+    VR_Sample_BottomHalf();
+    VR_Sample_GetStats(&after);
+    if (after.runs != before.runs + 1 || after.merged != before.merged) {
+        printf("TEST FAILED: sample idle: %lu bottom halves ran for one sample\n",
+               (unsigned long)(after.runs - before.runs));
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that samples pending together are merged into the latest
+  * @retval True if passed
+  */
+static bool Sample_TestMerge(void)
+{
+    VR_SampleStats_t before, after;
+    bool passed = true;
+
+    VR_Digital_Start();
+    Sample_Step();
+    VR_Sample_TopHalf();
+    VR_Sample_BottomHalf();
+
+    uint32_t resyncs = VR_Digital_GetResyncs();
+    VR_Sample_GetStats(&before);
+
+    // Two set points, each rendered, before the bottom half gets to run
+    VR_Emulator_SetRPM(SAMPLE_RPM_SKIPPED);
+    Sample_Step();
+    VR_Sample_TopHalf();
+    VR_Emulator_SetRPM(SAMPLE_RPM_LATEST);
+    Sample_Step();
+    VR_Sample_TopHalf();
+    VR_Sample_BottomHalf();
+
+    VR_Sample_GetStats(&after);
+    if (after.samples != before.samples + 2 || after.runs != before.runs + 1
+        || after.merged != before.merged + 1) {
+        printf("TEST FAILED: sample merge: %lu samples, %lu runs, %lu merged\n",
+               (unsigned long)(after.samples - before.samples),
+               (unsigned long)(after.runs - before.runs),
+               (unsigned long)(after.merged - before.merged));
+        passed = false;
+    } else if (VR_Digital_GetResyncs() != resyncs + 1) {
+        printf("TEST FAILED: sample merge: %lu resyncs for one bottom half\n",
+               (unsigned long)(VR_Digital_GetResyncs() - resyncs));
+        passed = false;
+    } else {
+        // Already on the latest period, so a steady sample needs no resync
+        Sample_Step();
+        VR_Sample_TopHalf();
+        VR_Sample_BottomHalf();
+        if (VR_Digital_GetResyncs() != resyncs + 1) {
+            printf("TEST FAILED: sample merge: digital output adopted the superseded RPM\n");
+            passed = false;
+        }
+    }
+
+    VR_Digital_Stop();
+    return passed;
+}
+
+/**
+  * @brief  Check the SAMPLE telemetry line and the bottom half probe name
+  * @retval True if passed
+  */
+static bool Sample_TestTelemetry(void)
+{
+    VR_SampleStats_t stats;
+    char line[64];
+    char expected[64];
+    char cycles[512];
+
+    VR_Sample_GetStats(&stats);
+    snprintf(expected, sizeof(expected), "SAMPLE n=%lu bh=%lu merged=%lu\r\n",
+             (unsigned long)stats.samples, (unsigned long)stats.runs, (unsigned long)stats.merged);
+
+    uint32_t len = VR_Sample_FormatTelemetry(line, sizeof(line));
+    if (len != strlen(expected) || strcmp(line, expected) != 0) {
+        printf("TEST FAILED: sample telemetry: \"%s\"\n", line);
+        return false;
+    }
+
+    if (VR_Sample_FormatTelemetry(line, 8) != 7 || strlen(line) != 7
+        || VR_Sample_FormatTelemetry(line, 0) != 0) {
+        printf("TEST FAILED: sample telemetry: short buffer not truncated\n");
+        return false;
+    }
+
+    // The bottom half as PendSV_Handler() runs it, after a reset window
+    VR_Cycles_FormatTelemetry(cycles, sizeof(cycles));
+    uint32_t start = VR_Cycles_Now();
+    VR_Sample_BottomHalf();
+    VR_Cycles_Record(VR_CYCLES_BOTTOM_HALF, start);
+
+    VR_Cycles_FormatTelemetry(cycles, sizeof(cycles));
+    if (strstr(cycles, "CYC bh n=1 ") == NULL) {
+        printf("TEST FAILED: sample telemetry: no bottom half probe\n");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,691 @@
+/**
+  ******************************************************************************
+  * @file           : test_scenario.c
+  * @brief          : Scenario sequencer tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Scenarios are compiled from text and played on unbound emulators, one
+  * update at a time or through VR_HostSim_RunScenario(). Checks:
+  * - Lines in any order compile to events sorted by time, with fault
+  *   window ends first; bad lines are reported with their number.
+  * - Each event lands on the first update at or after its tick, at any
+  *   speed, and the scenario's time is the time the wheel was rendered.
+  * - A ramp steps every millisecond along its line and ends on its
+  *   target, through zero into reverse. The line is timed from the event,
+  *   even when the update it lands on is late.
+  * - Dropout and spike windows, gain and noise change exactly the levels
+  *   in their windows, the same way on every run, and are cleared at the
+  *   end. Skipping updates steps the noise as rendering them would.
+  * - Images that are not sorted, the wrong size or select a missing
+  *   waveform are refused.
+  * - The SCN upload command plays a scenario on the default emulator,
+  *   counting its faults, and CRANK START ends it.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_scenario.h"
+#include "test_host.h"
+#include "vr_scenario.h"
+#include "vr_scenario_compiler.h"
+#include "vr_host_sim.h"
+#include "vr_command.h"
+#include "vr_counters.h"
+#include "vr_crank.h"
+#include "vr_sample.h"
+#include "vr_digital_output.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define SCENARIO_MAX_LEVELS         200000
+#define SCENARIO_MAX_UPDATES        1000000
+#define SCENARIO_NOISE_LSB          40
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint16_t levels[SCENARIO_MAX_LEVELS];
+    uint64_t ticks[SCENARIO_MAX_LEVELS];
+    uint32_t count;
+} ScenarioTrace_t;
+
+/* Private variables ---------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+
+static uint32_t scenario_image[VR_SCENARIO_IMAGE_MAX / sizeof(uint32_t)];
+static uint32_t scenario_size;
+static ScenarioTrace_t scenario_traces[2];
+
+static const char scenario_impaired[] =
+    "0     rpm 3000\n"
+    "0.02  fault dropout 0.01\n"
+    "0.04  fault spike 0.005\n"
+    "0.06  gain 50\n"
+    "0.08  gain 100\n"
+    "0.08  noise 40 7\n"
+    "0.1   end\n";
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Scenario_TestCompile(void);
+static bool Scenario_TestTiming(void);
+static bool Scenario_TestRamp(void);
+static bool Scenario_TestImpairments(void);
+static bool Scenario_TestNoiseSkip(void);
+static bool Scenario_TestLoad(void);
+static bool Scenario_TestCommand(void);
+static bool Scenario_Compile(const char *text);
+static bool Scenario_Render(const char *text, ScenarioTrace_t *trace, uint32_t *faults);
+static void Scenario_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the scenario sequencer tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Scenario(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing scenario sequencer...\n");
+
+    VR_Test_ResetDefault();
+    VR_Test_Record(&results, Scenario_TestCompile());
+    VR_Test_Record(&results, Scenario_TestTiming());
+    VR_Test_Record(&results, Scenario_TestRamp());
+    VR_Test_Record(&results, Scenario_TestImpairments());
+    VR_Test_Record(&results, Scenario_TestNoiseSkip());
+    VR_Test_Record(&results, Scenario_TestLoad());
+    VR_Test_Record(&results, Scenario_TestCommand());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Scenario");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check the sort order, the duration and the error reports
+  * @retval True if passed
+  */
+static bool Scenario_TestCompile(void)
+{
+    static const char text[] =
+        "# Lines out of order, comments and blank lines\n"
+        "0.5   gain 50\n"
+        "0     rpm 800    # start\n"
+        "\n"
+        "0.1   fault dropout 0.1\n"
+        "0.2   fault spike 0.05\n"
+        "0.3   ramp -2000 0.5\n"
+        "0.2   NOISE 10\n"
+        "0.25  shape model\n";
+    static const VR_ScenarioEvent_t expected[] = {
+        {0, 0, 800, VR_SCENARIO_SPEED, 0},
+        {10000, 0, 0, VR_SCENARIO_FAULT, VR_FAULT_DROPOUT},
+        {20000, 0, 0, VR_SCENARIO_FAULT, VR_FAULT_NONE},
+        {20000, 0, 0, VR_SCENARIO_FAULT, VR_FAULT_SPIKE},
+        {20000, VR_NOISE_DEFAULT_SEED, 10, VR_SCENARIO_NOISE, 0},
+        {25000, 0, 0, VR_SCENARIO_FAULT, VR_FAULT_NONE},
+        {25000, 0, 0, VR_SCENARIO_SHAPE, 0},
+        {30000, 50000, -2000, VR_SCENARIO_RAMP, 0},
+        {50000, 0, VR_AMPLITUDE_FULL / 2, VR_SCENARIO_GAIN, 0},
+    };
+    static const struct {
+        const char *text;
+        uint32_t line;
+    } bad[] = {
+        {"0 rpm 800\n1 warp 9\n", 2},
+        {"0 rpm 800\n0 fault dropout 0.1\n0.05 fault spike 0.1\n", 3},
+        {"0 rpm 20000\n", 1},
+        {"0 rpm 100\n2 rpm 200\n1 end\n", 0},
+        {"-1 rpm 100\n", 1},
+        {"0 ramp 100 0\n", 1},
+        {"0 gain 101\n", 1},
+    };
+    uint32_t count = sizeof(expected) / sizeof(expected[0]);
+    const VR_ScenarioHeader_t *header = (const VR_ScenarioHeader_t *)scenario_image;
+    const VR_ScenarioEvent_t *events = (const VR_ScenarioEvent_t *)(header + 1);
+    VR_ScenarioError_t error;
+
+    if (!Scenario_Compile(text)) {
+        return false;
+    }
+    if (header->magic != VR_SCENARIO_MAGIC || header->count != count || header->duration != 80000 ||
+        scenario_size != sizeof(VR_ScenarioHeader_t) + count * 12u) {
+        printf("TEST FAILED: scenario compile: %u events over %lu ticks in %lu bytes, expected %lu over 80000\n",
+               header->count, (unsigned long)header->duration, (unsigned long)scenario_size,
+               (unsigned long)count);
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (memcmp(&events[i], &expected[i], sizeof(expected[i])) != 0) {
+            printf("TEST FAILED: scenario compile: event %lu is kind %u at %lu, expected kind %u at %lu\n",
+                   (unsigned long)i, events[i].kind, (unsigned long)events[i].tick, expected[i].kind,
+                   (unsigned long)expected[i].tick);
+            return false;
+        }
+    }
+
+    // Windows may touch
+    if (!Scenario_Compile("0 fault dropout 0.1\n0.1 fault spike 0.1\n")) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        if (VR_Scenario_Compile(bad[i].text, scenario_image, sizeof(scenario_image), &scenario_size, &error) ||
+            error.line != bad[i].line || error.message == NULL) {
+            printf("TEST FAILED: scenario compile: bad scenario %lu not reported at line %lu\n",
+                   (unsigned long)i, (unsigned long)bad[i].line);
+            return false;
+        }
+    }
+    if (VR_Scenario_Compile(text, scenario_image, VR_SCENARIO_IMAGE_SIZE(count) - 1, &scenario_size, &error)) {
+        printf("TEST FAILED: scenario compile: image written past its buffer\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that each event lands on the first update at or after its tick
+  * @retval True if passed
+  */
+static bool Scenario_TestTiming(void)
+{
+    static const char text[] =
+        "0     rpm 3000\n"
+        "0.1   rpm 6000\n"
+        "0.2   rpm 300\n"
+        "0.25  rpm -1500\n"
+        "0.4   end\n";
+    static const uint32_t event_ticks[] = {10000, 20000, 25000};
+    static const int32_t event_rpm[] = {6000, 300, -1500};
+    VR_Emulator_t emu;
+    VR_Scenario_t scn;
+    uint32_t tick = 0, landed = 0;
+
+    if (!Scenario_Compile(text)) {
+        return false;
+    }
+    VR_Emu_Init(&emu, NULL);
+    if (!VR_Scenario_Load(&scn, scenario_image, scenario_size, NULL, 0)) {
+        printf("TEST FAILED: scenario timing: image refused\n");
+        return false;
+    }
+    VR_Scenario_Start(&scn, &emu);
+    if (VR_Emu_GetSpeed(&emu) != 3000 || scn.applied != 1) {
+        printf("TEST FAILED: scenario timing: first event not applied at the start\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < SCENARIO_MAX_UPDATES && scn.running; i++) {
+        uint32_t period = VR_Emu_GetSamplePeriod(&emu) / VR_SAMPLE_TICK_US;
+        uint32_t applied = scn.applied;
+
+        tick += period;
+        VR_Scenario_Sample(&scn, &emu);
+        if (scn.tick != tick) {
+            printf("TEST FAILED: scenario timing: scenario at tick %lu, wheel at %lu\n",
+                   (unsigned long)scn.tick, (unsigned long)tick);
+            return false;
+        }
+        if (scn.applied != applied) {
+            uint32_t at = event_ticks[landed];
+            if (scn.applied != applied + 1 || tick < at || tick - period >= at ||
+                VR_Emu_GetSpeed(&emu) != event_rpm[landed]) {
+                printf("TEST FAILED: scenario timing: event %lu for tick %lu landed at %lu (period %lu) as %ld RPM\n",
+                       (unsigned long)landed, (unsigned long)at, (unsigned long)tick, (unsigned long)period,
+                       (long)VR_Emu_GetSpeed(&emu));
+                return false;
+            }
+            landed++;
+        }
+        VR_Emu_TimerCallback(&emu);
+    }
+
+    if (landed != 3 || !VR_Scenario_IsDone(&scn) || tick < 40000 ||
+        tick - VR_Emu_GetSamplePeriod(&emu) / VR_SAMPLE_TICK_US >= 40000) {
+        printf("TEST FAILED: scenario timing: %lu events landed, run ended at tick %lu\n",
+               (unsigned long)landed, (unsigned long)tick);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check ramps up and through zero into reverse
+  * @retval True if passed
+  */
+static bool Scenario_TestRamp(void)
+{
+    static const char text[] =
+        "0     rpm 1000\n"
+        "0.1   ramp 3000 0.2\n"
+        "0.4   ramp -500 0.05\n"
+        "0.5   end\n";
+    VR_Emulator_t emu;
+    VR_Scenario_t scn;
+    uint32_t tick = 0, steps = 0, last_step = 0;
+    int32_t speed = 1000;
+
+    if (!Scenario_Compile(text) || !VR_Scenario_Load(&scn, scenario_image, scenario_size, NULL, 0)) {
+        printf("TEST FAILED: scenario ramp: image refused\n");
+        return false;
+    }
+    VR_Emu_Init(&emu, NULL);
+    VR_Scenario_Start(&scn, &emu);
+
+    for (uint32_t i = 0; i < SCENARIO_MAX_UPDATES && scn.running; i++) {
+        tick += VR_Emu_GetSamplePeriod(&emu) / VR_SAMPLE_TICK_US;
+        VR_Scenario_Sample(&scn, &emu);
+        int32_t now = VR_Emu_GetSpeed(&emu);
+
+        if (tick < 10000 && now != 1000) {
+            printf("TEST FAILED: scenario ramp: %ld RPM before the ramp\n", (long)now);
+            return false;
+        }
+        if (tick >= 10000 && tick < 30000) {
+            // Set at each millisecond step from the time of the update
+            int32_t line = 1000 + (int32_t)(2000ll * (tick - 10000) / 20000);
+            if (now != speed) {
+                if (now != line || now < speed || (steps > 0 && (tick - 10000) / 100 == (last_step - 10000) / 100)) {
+                    printf("TEST FAILED: scenario ramp: %ld RPM at tick %lu, line %ld, from %ld\n",
+                           (long)now, (unsigned long)tick, (long)line, (long)speed);
+                    return false;
+                }
+                steps++;
+                last_step = tick;
+            } else if (line - now > 2000 * VR_SCENARIO_RAMP_STEP_TICKS / 20000 + 1) {
+                printf("TEST FAILED: scenario ramp: %ld RPM at tick %lu fell behind the line at %ld\n",
+                       (long)now, (unsigned long)tick, (long)line);
+                return false;
+            }
+        }
+        if (tick >= 30000 && tick < 40000 && now != 3000) {
+            printf("TEST FAILED: scenario ramp: %ld RPM after the ramp, expected 3000\n", (long)now);
+            return false;
+        }
+        speed = now;
+        VR_Emu_TimerCallback(&emu);
+    }
+
+    if (steps < 190 || steps > 201 || speed != -500 || !emu.state.reverse || !VR_Scenario_IsDone(&scn)) {
+        printf("TEST FAILED: scenario ramp: %lu steps, ended at %ld RPM\n", (unsigned long)steps, (long)speed);
+        return false;
+    }
+
+    // At low speed the updates are sparse: the first step is still timed
+    // from the event, not from the update it landed on
+    static const char slow[] =
+        "0        rpm 100\n"
+        "0.10005  ramp 5000 0.01\n"
+        "0.2      end\n";
+
+    if (!Scenario_Compile(slow) || !VR_Scenario_Load(&scn, scenario_image, scenario_size, NULL, 0)) {
+        printf("TEST FAILED: scenario ramp: slow image refused\n");
+        return false;
+    }
+    VR_Emu_Init(&emu, NULL);
+    VR_Scenario_Start(&scn, &emu);
+    tick = 0;
+
+    for (uint32_t i = 0; i < SCENARIO_MAX_UPDATES && scn.running; i++) {
+        tick += VR_Emu_GetSamplePeriod(&emu) / VR_SAMPLE_TICK_US;
+        VR_Scenario_Sample(&scn, &emu);
+        int32_t now = VR_Emu_GetSpeed(&emu);
+
+        if (tick >= 10005) {
+            int32_t line = 100 + (int32_t)(4900ll * (tick - 10005) / 1000);
+            if (tick == 10005 || now != line) {
+                printf("TEST FAILED: scenario ramp: first step %ld RPM at tick %lu, line %ld\n",
+                       (long)now, (unsigned long)tick, (long)line);
+                return false;
+            }
+            break;
+        }
+        VR_Emu_TimerCallback(&emu);
+    }
+    VR_Scenario_Stop(&scn, &emu);
+    return true;
+}
+
+/**
+  * @brief  Check fault windows, gain and noise against an unimpaired run
+  * @retval True if passed
+  */
+static bool Scenario_TestImpairments(void)
+{
+    ScenarioTrace_t *ref = &scenario_traces[0];
+    ScenarioTrace_t *run = &scenario_traces[1];
+    uint32_t faults = 0, noisy = 0;
+    uint32_t window_levels[5] = {0};
+
+    if (!Scenario_Render("0 rpm 3000\n0.1 end\n", ref, NULL) ||
+        !Scenario_Render(scenario_impaired, run, &faults)) {
+        return false;
+    }
+    if (run->count != ref->count || faults != 2) {
+        printf("TEST FAILED: scenario impairments: %lu levels and %lu faults, expected %lu and 2\n",
+               (unsigned long)run->count, (unsigned long)faults, (unsigned long)ref->count);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < run->count; i++) {
+        uint64_t t = run->ticks[i];
+        int32_t level = run->levels[i];
+        int32_t expected = ref->levels[i];
+        int32_t offset = expected - (int32_t)VR_DC_LEVEL;
+        bool ok;
+
+        if (t != ref->ticks[i]) {
+            printf("TEST FAILED: scenario impairments: level %lu held from %llu, expected %llu\n",
+                   (unsigned long)i, (unsigned long long)t, (unsigned long long)ref->ticks[i]);
+            return false;
+        }
+        if (t >= 2000 && t < 3000) {
+            ok = (level == VR_DC_LEVEL);
+            window_levels[0]++;
+        } else if (t >= 4000 && t < 4500) {
+            ok = (level == DAC_RESOLUTION - 1);
+            window_levels[1]++;
+        } else if (t >= 6000 && t < 8000) {
+            ok = (level == (int32_t)VR_DC_LEVEL + offset * (VR_AMPLITUDE_FULL / 2) / VR_AMPLITUDE_FULL);
+            window_levels[2]++;
+        } else if (t >= 8000) {
+            ok = (level >= expected - SCENARIO_NOISE_LSB && level <= expected + SCENARIO_NOISE_LSB) ||
+                 level == 0 || level == DAC_RESOLUTION - 1;
+            noisy += (level != expected);
+            window_levels[3]++;
+        } else {
+            ok = (level == expected);
+            window_levels[4]++;
+        }
+        if (!ok) {
+            printf("TEST FAILED: scenario impairments: level %ld at tick %llu, unimpaired %ld\n",
+                   (long)level, (unsigned long long)t, (long)expected);
+            return false;
+        }
+    }
+    for (uint32_t w = 0; w < 5; w++) {
+        if (window_levels[w] == 0) {
+            printf("TEST FAILED: scenario impairments: no levels in window %lu\n", (unsigned long)w);
+            return false;
+        }
+    }
+    if (noisy < window_levels[3] / 2) {
+        printf("TEST FAILED: scenario impairments: only %lu of %lu levels noisy\n",
+               (unsigned long)noisy, (unsigned long)window_levels[3]);
+        return false;
+    }
+
+    // The same scenario gives the same output, noise included
+    if (!Scenario_Render(scenario_impaired, ref, NULL)) {
+        return false;
+    }
+    if (ref->count != run->count || memcmp(ref->levels, run->levels, run->count * sizeof(run->levels[0])) != 0) {
+        printf("TEST FAILED: scenario impairments: second run differs\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that skipped updates step the noise as rendered ones do
+  * @retval True if passed
+  */
+static bool Scenario_TestNoiseSkip(void)
+{
+    VR_Emulator_t rendered, skipped;
+
+    VR_Emu_Init(&rendered, NULL);
+    VR_Emu_SetRPM(&rendered, 4500);
+    VR_Emu_SetNoise(&rendered, SCENARIO_NOISE_LSB, 99);
+    skipped = rendered;
+
+    for (uint32_t i = 0; i < 1234; i++) {
+        VR_Emu_TimerCallback(&rendered);
+    }
+    VR_Emu_Skip(&skipped, 1234);
+    VR_Emu_TimerCallback(&rendered);
+    VR_Emu_TimerCallback(&skipped);
+
+    if (skipped.noise_rng != rendered.noise_rng || VR_Emu_GetOutput(&skipped) != VR_Emu_GetOutput(&rendered)) {
+        printf("TEST FAILED: scenario noise skip: level %u after a skip, %u rendered\n",
+               VR_Emu_GetOutput(&skipped), VR_Emu_GetOutput(&rendered));
+        return false;
+    }
+
+    // Noise off leaves the level as rendered, whatever the sequence
+    VR_Emu_Init(&rendered, NULL);
+    VR_Emu_SetRPM(&rendered, 4500);
+    skipped = rendered;
+    skipped.noise_rng = 12345;
+    for (uint32_t i = 0; i < 100; i++) {
+        VR_Emu_TimerCallback(&rendered);
+        VR_Emu_TimerCallback(&skipped);
+        if (VR_Emu_GetOutput(&skipped) != VR_Emu_GetOutput(&rendered)) {
+            printf("TEST FAILED: scenario noise skip: noise present when off\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that bad images are refused
+  * @retval True if passed
+  */
+static bool Scenario_TestLoad(void)
+{
+    static uint32_t copy[VR_SCENARIO_IMAGE_MAX / sizeof(uint32_t) + 1];
+    VR_ScenarioHeader_t *header = (VR_ScenarioHeader_t *)copy;
+    VR_ScenarioEvent_t *events = (VR_ScenarioEvent_t *)(header + 1);
+    VR_ToothShape_t shape;
+    const VR_ToothShape_t *tables[1] = {&shape};
+    VR_Scenario_t scn;
+    bool ok = true;
+
+    if (!Scenario_Compile("0 rpm 1000\n0.1 shape 1\n0.2 rpm 2000\n0.3 end\n")) {
+        return false;
+    }
+    VR_Shape_Clear(&shape);
+    for (int32_t i = 0; i < 4; i++) {
+        VR_Shape_Append(&shape, VR_SHAPE_REGULAR, (i % 2) ? 800 : -800);
+        VR_Shape_Append(&shape, VR_SHAPE_MISSING, (i % 2) ? 1200 : -1200);
+    }
+
+    memcpy(copy, scenario_image, scenario_size);
+    ok &= VR_Scenario_Load(&scn, copy, scenario_size, tables, 1);
+    ok &= !VR_Scenario_Load(&scn, copy, scenario_size, NULL, 0);                // No table 1
+    ok &= !VR_Scenario_Load(&scn, copy, scenario_size - 1, tables, 1);          // Short
+    ok &= !VR_Scenario_Load(&scn, (uint8_t *)copy + 2, scenario_size, tables, 1);  // Misaligned
+
+    header->magic ^= 1u;
+    ok &= !VR_Scenario_Load(&scn, copy, scenario_size, tables, 1);
+    header->magic ^= 1u;
+
+    events[1].tick = events[2].tick + 1;                                        // Out of order
+    ok &= !VR_Scenario_Load(&scn, copy, scenario_size, tables, 1);
+    events[1].tick = events[2].tick;
+    ok &= VR_Scenario_Load(&scn, copy, scenario_size, tables, 1);
+
+    events[2].kind = VR_SCENARIO_KINDS;
+    ok &= !VR_Scenario_Load(&scn, copy, scenario_size, tables, 1);
+    events[2].kind = VR_SCENARIO_SPEED;
+
+    events[2].tick = header->duration + 1;                                      // After the end
+    ok &= !VR_Scenario_Load(&scn, copy, scenario_size, tables, 1);
+
+    if (!ok || scn.running) {
+        printf("TEST FAILED: scenario load: bad image accepted\n");
+        return false;
+    }
+
+    // The table is selected where the scenario says
+    VR_Emulator_t emu;
+    VR_Emu_Init(&emu, NULL);
+    if (!VR_Scenario_Load(&scn, scenario_image, scenario_size, tables, 1)) {
+        printf("TEST FAILED: scenario load: good image refused\n");
+        return false;
+    }
+    VR_Scenario_Start(&scn, &emu);
+    for (uint32_t i = 0; i < SCENARIO_MAX_UPDATES && scn.tick < 15000; i++) {
+        VR_Scenario_Sample(&scn, &emu);
+        VR_Emu_TimerCallback(&emu);
+    }
+    if (emu.shape != &shape) {
+        printf("TEST FAILED: scenario load: shape table 1 not selected\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the SCN upload command on the default emulator
+  * @retval True if passed
+  */
+static bool Scenario_TestCommand(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    const VR_Scenario_t *scn = VR_Scenario_GetDefault();
+    VR_Counters_t before, after;
+    char line[VR_COMMAND_LINE_MAX];
+    char expected[VR_COMMAND_REPLY_MAX];
+
+    VR_Emulator_Init();
+    VR_Emulator_SetRPM(1000);
+    if (!Scenario_Compile("0 rpm 2000\n0.01 fault dropout 0.01\n0.05 end\n")) {
+        return false;
+    }
+
+    if (!VR_Test_Command("scenario", "SCN BEGIN\r", "OK\r\n")) {
+        return false;
+    }
+    for (uint32_t i = 0; i < scenario_size; i += 32) {
+        int n = snprintf(line, sizeof(line), "SCN D ");
+        for (uint32_t j = i; j < scenario_size && j < i + 32; j++) {
+            n += snprintf(line + n, sizeof(line) - (size_t)n, "%02x", ((const uint8_t *)scenario_image)[j]);
+        }
+        snprintf(line + n, sizeof(line) - (size_t)n, "\r");
+        snprintf(expected, sizeof(expected), "OK LEN=%lu\r\n",
+                 (unsigned long)((i + 32 < scenario_size) ? i + 32 : scenario_size));
+        if (!VR_Test_Command("scenario", line, expected)) {
+            return false;
+        }
+    }
+
+    VR_Counters_Snapshot(&before);
+    if (!VR_Test_Command("scenario", "SCN START\r", "OK SCN START EV=3 T=50\r\n")) {
+        return false;
+    }
+    if (!VR_Scenario_IsRunning() || VR_Emulator_GetSpeed() != 2000) {
+        printf("TEST FAILED: scenario command: default emulator not playing\n");
+        return false;
+    }
+    for (uint32_t i = 0; i < SCENARIO_MAX_UPDATES && VR_Scenario_IsRunning(); i++) {
+        Host_TIM2_RunTo(htim2.Instance->CNT + VR_Emu_GetSamplePeriod(emu) * VR_DIGITAL_TICKS_PER_US);
+        VR_Sample_TopHalf();
+        VR_Sample_BottomHalf();
+    }
+    VR_Counters_Snapshot(&after);
+
+    snprintf(expected, sizeof(expected), "OK SCN STOP EV=3/3 T=%lu FAULTS=1\r\n",
+             (unsigned long)(scn->tick / (VR_SAMPLE_TIMER_BASE_FREQ / 1000)));
+    if (VR_Scenario_IsRunning() || after.faults - before.faults != 1 || emu->fault != VR_FAULT_NONE ||
+        VR_Emulator_GetSpeed() != 2000 || scn->tick < 5000 || !VR_Test_Command("scenario", "scn\r", expected)) {
+        printf("TEST FAILED: scenario command: run ended at tick %lu with %lu faults counted\n",
+               (unsigned long)scn->tick, (unsigned long)(after.faults - before.faults));
+        return false;
+    }
+
+    // An engine start takes over the speed
+    if (!VR_Test_Command("scenario", "SCN START\r", "OK SCN START EV=3 T=50\r\n") ||
+        !VR_Test_Command("scenario", "CRANK START\r", "OK CRANK START CYL=4 RPM=200\r\n")) {
+        return false;
+    }
+    bool running = VR_Scenario_IsRunning();
+    VR_Crank_End();
+    if (running) {
+        printf("TEST FAILED: scenario command: scenario kept running through an engine start\n");
+        return false;
+    }
+
+    return VR_Test_Command("scenario", "SCN D 0G\r", "ERR bad hex or image full\r\n") &&
+           VR_Test_Command("scenario", "SCN BEGIN\r", "OK\r\n") &&
+           VR_Test_Command("scenario", "SCN START\r", "ERR bad scenario image\r\n") &&
+           VR_Test_Command("scenario", "SCN STOP\r", "OK SCN STOP\r\n") &&
+           VR_Test_Command("scenario", "SCN PLAY\r", "ERR unknown SCN command\r\n");
+}
+
+/**
+  * @brief  Compile scenario text into scenario_image
+  * @param  text: Scenario
+  * @retval True if it compiled
+  */
+static bool Scenario_Compile(const char *text)
+{
+    VR_ScenarioError_t error;
+
+    if (!VR_Scenario_Compile(text, scenario_image, sizeof(scenario_image), &scenario_size, &error)) {
+        printf("TEST FAILED: scenario: line %lu: %s\n", (unsigned long)error.line, error.message);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Compile and render a scenario through the host simulator
+  * @param  text: Scenario
+  * @param  trace: Receives the held levels
+  * @param  faults: Receives the fault windows opened, NULL if not needed
+  * @retval True if the run completed
+  */
+static bool Scenario_Render(const char *text, ScenarioTrace_t *trace, uint32_t *faults)
+{
+    VR_Emulator_t emu;
+    VR_Scenario_t scn;
+
+    trace->count = 0;
+    if (!Scenario_Compile(text) || !VR_Scenario_Load(&scn, scenario_image, scenario_size, NULL, 0)) {
+        printf("TEST FAILED: scenario render: image refused\n");
+        return false;
+    }
+    VR_HostSim_RunScenario(&emu, &scn, Scenario_Sink, trace);
+
+    if (trace->count >= SCENARIO_MAX_LEVELS || !VR_Scenario_IsDone(&scn) || emu.fault != VR_FAULT_NONE ||
+        emu.noise_lsb != 0 || emu.amplitude != VR_AMPLITUDE_FULL) {
+        printf("TEST FAILED: scenario render: run incomplete or impairments left on\n");
+        return false;
+    }
+    if (faults != NULL) {
+        *faults = scn.faults;
+    }
+    return true;
+}
+
+/**
+  * @brief  Record one held level
+  * @param  ctx: ScenarioTrace_t
+  * @param  dac_value: DAC level
+  * @param  start_tick: First tick it is held
+  * @param  num_ticks: Ticks it is held
+  * @retval None
+  */
+static void Scenario_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    ScenarioTrace_t *trace = (ScenarioTrace_t *)ctx;
+
+    (void)num_ticks;
+    if (trace->count < SCENARIO_MAX_LEVELS) {
+        trace->levels[trace->count] = dac_value;
+        trace->ticks[trace->count] = start_tick;
+        trace->count++;
+    }
+}
+
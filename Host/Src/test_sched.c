@@ -0,0 +1,403 @@
+/**
+  ******************************************************************************
+  * @file           : test_sched.c
+  * @brief          : Background task scheduler tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The scheduler reads the virtual TIM2 count, which these tests set
+  * directly. A test task logs its runs and advances the count by its
+  * configured run time. Checks:
+  * - Released tasks run by priority, then by earliest deadline, and
+  *   unreleased ones wait.
+  * - A periodic task is released on its period grid across the TIM2 wrap.
+  * - A periodic task that starts late runs once for its latest release,
+  *   counts the skipped releases and its lateness, keeps its phase, and
+  *   counts a miss when it finishes past its deadline.
+  * - One-shot triggers coalesce to the earliest release, a cancelled task
+  *   stays idle, and a task that triggers itself runs once per call.
+  * - Statistics, the TASK telemetry lines, and argument checks.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_sched.h"
+#include "test_host.h"
+#include "vr_sched.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    char label;                     // Written to the run log
+    uint32_t run_ticks;             // TIM2 ticks each run takes
+    VR_TaskId_t retrigger;          // Task to trigger from the body, or VR_SCHED_NO_TASK
+} Sched_TestTask_t;
+
+/* Private variables ---------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+
+static char run_log[16];
+static uint32_t run_count;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Sched_TestBody(void *ctx);
+static void Sched_ClearLog(void);
+static bool Sched_TestPriority(void);
+static bool Sched_TestPeriodic(void);
+static bool Sched_TestLate(void);
+static bool Sched_TestOneShot(void);
+static bool Sched_TestTelemetry(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the background task scheduler tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Scheduler(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing background task scheduler...\n");
+
+    VR_Test_ResetDefault();
+    VR_Test_Record(&results, Sched_TestPriority());
+    VR_Test_Record(&results, Sched_TestPeriodic());
+    VR_Test_Record(&results, Sched_TestLate());
+    VR_Test_Record(&results, Sched_TestOneShot());
+    VR_Test_Record(&results, Sched_TestTelemetry());
+    VR_Sched_Init();
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Scheduler");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Test task body: log the run and take the configured time
+  * @param  ctx: Sched_TestTask_t
+  * @retval None
+  */
+static void Sched_TestBody(void *ctx)
+{
+    Sched_TestTask_t *task = ctx;
+
+    if (run_count < sizeof(run_log) - 1) {
+        run_log[run_count] = task->label;
+        run_log[run_count + 1] = '\0';
+    }
+    run_count++;
+
+    htim2.Instance->CNT += task->run_ticks;
+    if (task->retrigger != VR_SCHED_NO_TASK) {
+        VR_Sched_Trigger(task->retrigger, 0);
+    }
+}
+
+/**
+  * @brief  Empty the run log
+  * @retval None
+  */
+static void Sched_ClearLog(void)
+{
+    run_log[0] = '\0';
+    run_count = 0;
+}
+
+/**
+  * @brief  Check the order released tasks run in
+  * @retval True if passed
+  */
+static bool Sched_TestPriority(void)
+{
+    Sched_TestTask_t a = {'a', 10, VR_SCHED_NO_TASK};
+    Sched_TestTask_t b = {'b', 10, VR_SCHED_NO_TASK};
+    Sched_TestTask_t c = {'c', 10, VR_SCHED_NO_TASK};
+    Sched_TestTask_t d = {'d', 10, VR_SCHED_NO_TASK};
+
+    htim2.Instance->CNT = 5000;
+    VR_Sched_Init();
+    Sched_ClearLog();
+
+    VR_TaskId_t ta = VR_Sched_AddOneShot("a", Sched_TestBody, &a, 1, 500);
+    VR_TaskId_t tb = VR_Sched_AddOneShot("b", Sched_TestBody, &b, 0, 2000);
+    VR_TaskId_t tc = VR_Sched_AddOneShot("c", Sched_TestBody, &c, 1, 100);
+    VR_TaskId_t td = VR_Sched_AddOneShot("d", Sched_TestBody, &d, 0, 100);
+
+    // b first on priority; c before a on deadline; d not yet released
+    VR_Sched_Trigger(ta, 0);
+    VR_Sched_Trigger(tb, 0);
+    VR_Sched_Trigger(tc, 0);
+    VR_Sched_Trigger(td, 50);
+
+    uint32_t runs = VR_Sched_RunReady();
+    if (runs != 3 || strcmp(run_log, "bca") != 0) {
+        printf("TEST FAILED: sched priority: ran \"%s\" (%lu)\n", run_log, (unsigned long)runs);
+        return false;
+    }
+
+    uint32_t release;
+    if (!VR_Sched_NextRelease(&release) || release != 5000u + 50u * VR_SCHED_TICKS_PER_US) {
+        printf("TEST FAILED: sched priority: next release not the delayed task\n");
+        return false;
+    }
+
+    htim2.Instance->CNT = release;
+    runs = VR_Sched_RunReady();
+    if (runs != 1 || strcmp(run_log, "bcad") != 0 || VR_Sched_NextRelease(&release)) {
+        printf("TEST FAILED: sched priority: delayed task ran \"%s\"\n", run_log);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check periodic releases across the TIM2 wrap
+  * @retval True if passed
+  */
+static bool Sched_TestPeriodic(void)
+{
+    Sched_TestTask_t p = {'p', 20, VR_SCHED_NO_TASK};
+    const uint32_t period = 1000u * VR_SCHED_TICKS_PER_US;
+    const uint32_t start = 0xFFFFFFFFu - 2u * period;
+
+    htim2.Instance->CNT = start;
+    VR_Sched_Init();
+    Sched_ClearLog();
+
+    VR_TaskId_t id = VR_Sched_AddPeriodic("p", Sched_TestBody, &p, 0, 1000, 0);
+    if (id == VR_SCHED_NO_TASK || VR_Sched_RunReady() != 0) {
+        printf("TEST FAILED: sched periodic: ran before its first release\n");
+        return false;
+    }
+
+    for (uint32_t k = 1; k <= 5; k++) {
+        uint32_t release;
+        uint32_t expected = start + k * period;
+
+        if (!VR_Sched_NextRelease(&release) || release != expected) {
+            printf("TEST FAILED: sched periodic: release %lu at 0x%08lx, expected 0x%08lx\n",
+                   (unsigned long)k, (unsigned long)release, (unsigned long)expected);
+            return false;
+        }
+
+        htim2.Instance->CNT = release - 1;
+        if (VR_Sched_RunReady() != 0) {
+            printf("TEST FAILED: sched periodic: release %lu ran early\n", (unsigned long)k);
+            return false;
+        }
+        htim2.Instance->CNT = release;
+        if (VR_Sched_RunReady() != 1) {
+            printf("TEST FAILED: sched periodic: release %lu did not run\n", (unsigned long)k);
+            return false;
+        }
+    }
+
+    VR_TaskStats_t stats;
+    VR_Sched_GetStats(id, &stats, false);
+    if (stats.runs != 5 || stats.skips != 0 || stats.misses != 0 || stats.late_max != 0) {
+        printf("TEST FAILED: sched periodic: runs=%lu skips=%lu misses=%lu late=%lu\n",
+               (unsigned long)stats.runs, (unsigned long)stats.skips, (unsigned long)stats.misses,
+               (unsigned long)stats.late_max);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check a late periodic task's skips, lateness, phase and misses
+  * @retval True if passed
+  */
+static bool Sched_TestLate(void)
+{
+    Sched_TestTask_t p = {'p', 300u * VR_SCHED_TICKS_PER_US, VR_SCHED_NO_TASK};
+    const uint32_t period = 1000u * VR_SCHED_TICKS_PER_US;
+    const uint32_t start = 1000;
+
+    htim2.Instance->CNT = start;
+    VR_Sched_Init();
+    Sched_ClearLog();
+
+    // 300 us of work against a 200 us deadline
+    VR_TaskId_t id = VR_Sched_AddPeriodic("p", Sched_TestBody, &p, 0, 1000, 200);
+
+    // Two and a half periods after the first release
+    htim2.Instance->CNT = start + period + 2u * period + period / 2u;
+    if (VR_Sched_RunReady() != 1) {
+        printf("TEST FAILED: sched late: %lu runs for three releases\n", (unsigned long)run_count);
+        return false;
+    }
+
+    VR_TaskStats_t stats;
+    VR_Sched_GetStats(id, &stats, true);
+    if (stats.skips != 2 || stats.late_max != period / 2u || stats.misses != 1 ||
+        stats.run_max != p.run_ticks || stats.run_min != p.run_ticks) {
+        printf("TEST FAILED: sched late: skips=%lu late=%lu misses=%lu run=%lu\n",
+               (unsigned long)stats.skips, (unsigned long)stats.late_max, (unsigned long)stats.misses,
+               (unsigned long)stats.run_max);
+        return false;
+    }
+
+    uint32_t release;
+    if (!VR_Sched_NextRelease(&release) || release != start + 4u * period) {
+        printf("TEST FAILED: sched late: next release moved off the period grid\n");
+        return false;
+    }
+
+    // On time, 100 us of work finishes inside the deadline
+    p.run_ticks = 100u * VR_SCHED_TICKS_PER_US;
+    htim2.Instance->CNT = release;
+    VR_Sched_RunReady();
+    VR_Sched_GetStats(id, &stats, false);
+    if (stats.runs != 1 || stats.misses != 0 || stats.skips != 0 || stats.late_max != 0) {
+        printf("TEST FAILED: sched late: on-time run counted as late or missed\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check one-shot triggers, cancelling and self-triggering
+  * @retval True if passed
+  */
+static bool Sched_TestOneShot(void)
+{
+    Sched_TestTask_t o = {'o', 10, VR_SCHED_NO_TASK};
+    Sched_TestTask_t s = {'s', 10, VR_SCHED_NO_TASK};
+    const uint32_t start = 0xFFFFF000u;
+    uint32_t release;
+
+    htim2.Instance->CNT = start;
+    VR_Sched_Init();
+    Sched_ClearLog();
+
+    VR_TaskId_t to = VR_Sched_AddOneShot("o", Sched_TestBody, &o, 0, 1000);
+    VR_TaskId_t ts = VR_Sched_AddOneShot("s", Sched_TestBody, &s, 1, 1000);
+    s.retrigger = ts;
+
+    if (VR_Sched_NextRelease(&release) || VR_Sched_RunReady() != 0) {
+        printf("TEST FAILED: sched one-shot: released without a trigger\n");
+        return false;
+    }
+
+    // A later trigger does not postpone an earlier one; an earlier one advances it
+    VR_Sched_Trigger(to, 100);
+    VR_Sched_Trigger(to, 500);
+    VR_Sched_NextRelease(&release);
+    if (release != start + 100u * VR_SCHED_TICKS_PER_US) {
+        printf("TEST FAILED: sched one-shot: later trigger moved the release\n");
+        return false;
+    }
+    VR_Sched_Trigger(to, 20);
+    VR_Sched_NextRelease(&release);
+    if (release != start + 20u * VR_SCHED_TICKS_PER_US) {
+        printf("TEST FAILED: sched one-shot: earlier trigger ignored\n");
+        return false;
+    }
+
+    htim2.Instance->CNT = start + 600u * VR_SCHED_TICKS_PER_US;
+    if (VR_Sched_RunReady() != 1 || VR_Sched_RunReady() != 0 || strcmp(run_log, "o") != 0) {
+        printf("TEST FAILED: sched one-shot: coalesced triggers ran \"%s\"\n", run_log);
+        return false;
+    }
+
+    VR_Sched_Trigger(to, 0);
+    VR_Sched_Cancel(to);
+    if (VR_Sched_RunReady() != 0 || VR_Sched_NextRelease(&release)) {
+        printf("TEST FAILED: sched one-shot: cancelled task still released\n");
+        return false;
+    }
+
+    // A task that keeps triggering itself still lets the call return
+    Sched_ClearLog();
+    VR_Sched_Trigger(ts, 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        if (VR_Sched_RunReady() != 1) {
+            printf("TEST FAILED: sched one-shot: self-triggering task ran %lu times in one call\n",
+                   (unsigned long)run_count);
+            return false;
+        }
+    }
+    if (strcmp(run_log, "sss") != 0 || !VR_Sched_NextRelease(&release)) {
+        printf("TEST FAILED: sched one-shot: self-triggering task ran \"%s\"\n", run_log);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check statistics, the telemetry text and argument checks
+  * @retval True if passed
+  */
+static bool Sched_TestTelemetry(void)
+{
+    Sched_TestTask_t t = {'t', 0, VR_SCHED_NO_TASK};
+    Sched_TestTask_t u = {'u', 10, VR_SCHED_NO_TASK};
+    char text[256];
+    VR_TaskStats_t stats;
+
+    htim2.Instance->CNT = 0;
+    VR_Sched_Init();
+    Sched_ClearLog();
+
+    VR_TaskId_t tt = VR_Sched_AddOneShot("tlm", Sched_TestBody, &t, 0, 1000);
+    VR_Sched_AddOneShot("idle", Sched_TestBody, &u, 1, 1000);
+
+    // Runs of 20, 40 and 60 us, started 0, 5 and 10 us late
+    for (uint32_t i = 0; i < 3; i++) {
+        VR_Sched_Trigger(tt, 0);
+        htim2.Instance->CNT += 5u * i * VR_SCHED_TICKS_PER_US;
+        t.run_ticks = 20u * (i + 1u) * VR_SCHED_TICKS_PER_US;
+        VR_Sched_RunReady();
+    }
+
+    VR_Sched_GetStats(tt, &stats, false);
+    if (stats.runs != 3 || stats.run_min != 20u * VR_SCHED_TICKS_PER_US ||
+        stats.run_max != 60u * VR_SCHED_TICKS_PER_US || stats.run_total != 120u * VR_SCHED_TICKS_PER_US ||
+        stats.late_max != 10u * VR_SCHED_TICKS_PER_US) {
+        printf("TEST FAILED: sched stats: runs=%lu min=%lu max=%lu late=%lu\n",
+               (unsigned long)stats.runs, (unsigned long)stats.run_min, (unsigned long)stats.run_max,
+               (unsigned long)stats.late_max);
+        return false;
+    }
+
+    // Tasks that have not run are left out
+    uint32_t len = VR_Sched_FormatTelemetry(text, sizeof(text));
+    if (strcmp(text, "TASK tlm n=3 avg=40us max=60us late=10us miss=0 skip=0\r\n") != 0 || len != strlen(text)) {
+        printf("TEST FAILED: sched telemetry: \"%s\"\n", text);
+        return false;
+    }
+
+    // Reporting starts a new window
+    VR_Sched_GetStats(tt, &stats, false);
+    if (stats.runs != 0 || stats.run_min != UINT32_MAX || VR_Sched_FormatTelemetry(text, sizeof(text)) != 0) {
+        printf("TEST FAILED: sched telemetry: window not reset after reporting\n");
+        return false;
+    }
+
+    // Argument checks and a full table
+    if (VR_Sched_AddPeriodic("z", Sched_TestBody, &u, 0, 0, 0) != VR_SCHED_NO_TASK ||
+        VR_Sched_AddPeriodic("z", Sched_TestBody, &u, 0, VR_SCHED_MAX_PERIOD_US + 1u, 0) != VR_SCHED_NO_TASK ||
+        VR_Sched_AddOneShot("z", NULL, &u, 0, 100) != VR_SCHED_NO_TASK ||
+        VR_Sched_Trigger(tt, VR_SCHED_MAX_PERIOD_US + 1u) || VR_Sched_Trigger(VR_SCHED_MAX_TASKS, 0) ||
+        VR_Sched_GetStats(VR_SCHED_NO_TASK, &stats, false)) {
+        printf("TEST FAILED: sched arguments: out of range argument accepted\n");
+        return false;
+    }
+    for (uint32_t i = 2; i < VR_SCHED_MAX_TASKS; i++) {
+        if (VR_Sched_AddOneShot("fill", Sched_TestBody, &u, 2, 100) != (VR_TaskId_t)i) {
+            printf("TEST FAILED: sched arguments: task %lu not added\n", (unsigned long)i);
+            return false;
+        }
+    }
+    if (VR_Sched_AddOneShot("over", Sched_TestBody, &u, 2, 100) != VR_SCHED_NO_TASK) {
+        printf("TEST FAILED: sched arguments: task added to a full table\n");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,487 @@
+/**
+  ******************************************************************************
+  * @file           : test_shape.c
+  * @brief          : Tooth shape table tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Checks:
+  * - VR_Shape_Sample() on a small table: table entries, interpolation
+  *   between entries, into the next tooth's table and out of the wide
+  *   tooth, past the tooth end, and clamping at the DAC range.
+  * - A shaped instance at 200, 3000 and MAX_RPM stays within
+  *   SHAPE_TEST_TOLERANCE_LSB of a floating-point resampler.
+  * - After SHAPE OFF an instance renders bit-identically to one that never
+  *   had a shape, and an invalid shape selects the built-in model.
+  * - Shape text with comments, commas and keywords parses as expected, bad
+  *   text is refused, and a shape file loads.
+  * - The SHAPE commands, fed byte by byte as from USART3: upload, report,
+  *   errors, overlong lines and lines dropped while the main loop is busy.
+  * - A shaped chunked parallel run matches the sequential run.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_shape.h"
+#include "test_host.h"
+#include "vr_tooth_shape.h"
+#include "vr_command.h"
+#include "vr_host_sim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Private define ------------------------------------------------------------*/
+#define SHAPE_DC                    ((int32_t)(DAC_RESOLUTION * VR_DC_OFFSET))
+#define SHAPE_REGULAR_POINTS        64
+#define SHAPE_MISSING_POINTS        200
+#define SHAPE_RUN_PROFILE           "0:0,0.05:3000,0.2:13400,0.3:800"
+#define SHAPE_RUN_DURATION          40000   // Ticks (0.4 s)
+#define SHAPE_RUN_CHUNK_TICKS       997
+#define SHAPE_RUN_THREADS           4
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint64_t hash;                  // FNV-1a over every hold
+    uint64_t holds;
+} ShapeDigest_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const uint16_t shape_test_rpms[] = {200, 3000, MAX_RPM};
+
+static const char shape_test_text[] =
+    "# Test shape\n"
+    "regular 0, 100 200\t300   # four levels\n"
+    "MISSING -1000\n"
+    "m 1000\n";
+
+/* Private function prototypes -----------------------------------------------*/
+static void Shape_Build(VR_ToothShape_t *shape);
+static bool Shape_TestSample(void);
+static bool Shape_TestEmulator(const VR_ToothShape_t *shape, uint16_t rpm);
+static bool Shape_TestOff(const VR_ToothShape_t *shape);
+static bool Shape_TestParse(void);
+static bool Shape_TestCommands(void);
+static bool Shape_TestParallel(const VR_ToothShape_t *shape);
+static void Shape_DigestSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the tooth shape table tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_ToothShape(void)
+{
+    TestResults_t results = {0};
+    VR_ToothShape_t *shape = malloc(sizeof(*shape));
+
+    printf("Testing tooth shape tables...\n");
+
+    if (shape == NULL) {
+        printf("TEST FAILED: tooth shape: out of memory\n");
+        VR_Test_Record(&results, false);
+        return VR_Test_Report(&results, "Tooth shape");
+    }
+    Shape_Build(shape);
+    VR_Test_ResetDefault();
+
+    VR_Test_Record(&results, Shape_TestSample());
+    for (uint32_t i = 0; i < sizeof(shape_test_rpms) / sizeof(shape_test_rpms[0]); i++) {
+        VR_Test_Record(&results, Shape_TestEmulator(shape, shape_test_rpms[i]));
+    }
+    VR_Test_Record(&results, Shape_TestOff(shape));
+    VR_Test_Record(&results, Shape_TestParse());
+    VR_Test_Record(&results, Shape_TestCommands());
+    VR_Test_Record(&results, Shape_TestParallel(shape));
+    VR_Test_ResetDefault();
+    free(shape);
+
+    return VR_Test_Report(&results, "Tooth shape");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Build an asymmetric test waveform with a longer wide-tooth table
+  * @param  shape: Shape to fill
+  * @retval None
+  */
+static void Shape_Build(VR_ToothShape_t *shape)
+{
+    VR_Shape_Clear(shape);
+
+    for (uint32_t i = 0; i < SHAPE_REGULAR_POINTS; i++) {
+        double phase = 2.0 * M_PI * i / SHAPE_REGULAR_POINTS;
+        VR_Shape_Append(shape, VR_SHAPE_REGULAR, (int32_t)lround(1200.0 * sin(phase) + 300.0 * sin(3.0 * phase)));
+    }
+    for (uint32_t i = 0; i < SHAPE_MISSING_POINTS; i++) {
+        double phase = 2.0 * M_PI * i / SHAPE_MISSING_POINTS;
+        VR_Shape_Append(shape, VR_SHAPE_MISSING, (int32_t)lround(1600.0 * sin(phase) * exp(-phase / 4.0)));
+    }
+}
+
+/**
+  * @brief  Check VR_Shape_Sample() at hand-computed points
+  * @retval True if every point matches exactly
+  */
+static bool Shape_TestSample(void)
+{
+    static const struct {
+        uint8_t tooth;
+        uint32_t timer;
+        int32_t level;              // Offset from the DC level
+    } points[] = {
+        {0, 0, 0},                  // First entry
+        {0, 250, 100},              // Second entry
+        {0, 125, 50},               // Between entries
+        {3, 875, 150},              // Last entry towards the next regular tooth
+        {16, 875, -350},            // Last entry towards the wide tooth
+        {17, 0, -1000},             // Wide tooth table
+        {17, 250, 0},
+        {17, 750, 500},             // Out of the wide tooth into tooth 0
+        {5, 1000, 0},               // Past the tooth end
+        {16, 1200, -1000},
+    };
+    VR_ToothShape_t shape;
+    VR_ShapeRegion_t region = VR_SHAPE_REGULAR;
+
+    VR_Shape_Clear(&shape);
+    VR_Shape_Parse(&shape, &region, shape_test_text);
+
+    for (uint32_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+        uint16_t level = VR_Shape_Sample(&shape, points[i].tooth, points[i].timer, 1000);
+
+        if (level != SHAPE_DC + points[i].level) {
+            printf("TEST FAILED: shape sample: tooth %u at %lu/1000 gave %u, expected %ld\n",
+                   points[i].tooth, (unsigned long)points[i].timer, level, (long)(SHAPE_DC + points[i].level));
+            return false;
+        }
+    }
+
+    // Levels beyond the DAC range clamp
+    VR_Shape_Clear(&shape);
+    VR_Shape_Append(&shape, VR_SHAPE_REGULAR, -VR_SHAPE_MAX_LEVEL);
+    VR_Shape_Append(&shape, VR_SHAPE_REGULAR, VR_SHAPE_MAX_LEVEL);
+    VR_Shape_Append(&shape, VR_SHAPE_MISSING, 0);
+    VR_Shape_Append(&shape, VR_SHAPE_MISSING, 0);
+    if (VR_Shape_Sample(&shape, 0, 0, 1000) != 0 || VR_Shape_Sample(&shape, 0, 500, 1000) != DAC_RESOLUTION - 1) {
+        printf("TEST FAILED: shape sample: levels outside the DAC range not clamped\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Compare a shaped instance with a floating-point resampler
+  * @param  shape: Test waveform
+  * @param  rpm: Engine speed
+  * @retval True if every update is within SHAPE_TEST_TOLERANCE_LSB
+  */
+static bool Shape_TestEmulator(const VR_ToothShape_t *shape, uint16_t rpm)
+{
+    VR_Emulator_t emu;
+    bool teeth_seen[VR_SHAPE_REGIONS] = {false, false};
+
+    VR_Emu_Init(&emu, NULL);
+    VR_Emu_SetRPM(&emu, rpm);
+    if (!VR_Emu_SetShape(&emu, shape)) {
+        printf("TEST FAILED: shape at %u RPM: valid shape refused\n", rpm);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < SHAPE_TEST_SAMPLES; i++) {
+        uint8_t tooth = emu.state.current_tooth;
+        uint32_t timer = emu.state.tooth_timer + emu.state.sample_period_us;
+        uint32_t period = emu.state.tooth_period_us;
+        VR_ShapeRegion_t region = (tooth == MISSING_TOOTH_INDEX) ? VR_SHAPE_MISSING : VR_SHAPE_REGULAR;
+        VR_ShapeRegion_t next = ((tooth + 1) % TRIGGER_WHEEL_TEETH == MISSING_TOOTH_INDEX) ?
+                                VR_SHAPE_MISSING : VR_SHAPE_REGULAR;
+        double expected;
+
+        if (timer >= period) {
+            expected = shape->points[next][0];
+        } else {
+            double position = (double)timer * shape->length[region] / period;
+            uint32_t index = (uint32_t)position;
+            double a = shape->points[region][index];
+            double b = (index + 1 < shape->length[region]) ? shape->points[region][index + 1] : shape->points[next][0];
+            expected = a + (b - a) * (position - index);
+        }
+        // The fixed-point resampler rounds down
+        expected = fmin(fmax(floor(expected) + SHAPE_DC, 0.0), DAC_RESOLUTION - 1);
+        teeth_seen[region] = true;
+
+        VR_Emu_GenerateSignal(&emu);
+
+        if (fabs(VR_Emu_GetOutput(&emu) - expected) > SHAPE_TEST_TOLERANCE_LSB) {
+            printf("TEST FAILED: shape at %u RPM: update %lu on tooth %u gave %u, expected %.0f\n",
+                   rpm, (unsigned long)i, tooth, VR_Emu_GetOutput(&emu), expected);
+            return false;
+        }
+    }
+
+    if (!teeth_seen[VR_SHAPE_REGULAR] || !teeth_seen[VR_SHAPE_MISSING]) {
+        printf("TEST FAILED: shape at %u RPM: run did not reach both tables\n", rpm);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Switch a shape off again and check the built-in model returns
+  * @param  shape: Test waveform
+  * @retval True if the output matches an instance that never had a shape
+  */
+static bool Shape_TestOff(const VR_ToothShape_t *shape)
+{
+    VR_Emulator_t shaped, plain;
+    VR_ToothShape_t empty;
+
+    VR_Emu_Init(&shaped, NULL);
+    VR_Emu_Init(&plain, NULL);
+    VR_Emu_SetRPM(&shaped, 3000);
+    VR_Emu_SetRPM(&plain, 3000);
+
+    // A shape without a wide-tooth table is refused for the built-in model
+    VR_Shape_Clear(&empty);
+    VR_Shape_Append(&empty, VR_SHAPE_REGULAR, 0);
+    VR_Shape_Append(&empty, VR_SHAPE_REGULAR, 1);
+    VR_Emu_SetShape(&shaped, shape);
+    if (VR_Emu_SetShape(&shaped, &empty) || shaped.shape != NULL) {
+        printf("TEST FAILED: shape off: invalid shape accepted\n");
+        return false;
+    }
+    VR_Emu_SetShape(&shaped, shape);
+
+    for (uint32_t i = 0; i < SHAPE_TEST_SAMPLES / 2; i++) {
+        VR_Emu_GenerateSignal(&shaped);
+        VR_Emu_GenerateSignal(&plain);
+    }
+
+    VR_Emu_SetShape(&shaped, NULL);
+    for (uint32_t i = 0; i < SHAPE_TEST_SAMPLES / 2; i++) {
+        VR_Emu_GenerateSignal(&shaped);
+        VR_Emu_GenerateSignal(&plain);
+        if (VR_Emu_GetOutput(&shaped) != VR_Emu_GetOutput(&plain)) {
+            printf("TEST FAILED: shape off: update %lu gave %u, built-in model %u\n",
+                   (unsigned long)i, VR_Emu_GetOutput(&shaped), VR_Emu_GetOutput(&plain));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Parse shape text and load a shape file
+  * @retval True if good text parses and bad text is refused
+  */
+static bool Shape_TestParse(void)
+{
+    static const char *const bad[] = {
+        "regular 1 2 x",                // Unknown word
+        "regular 12three",              // Trailing garbage
+        "missing 4096",                 // Level out of range
+        "regular -4096",
+        "regular 123456789012345678",   // Token too long
+    };
+    static VR_ToothShape_t shape, loaded;
+    VR_ShapeRegion_t region = VR_SHAPE_REGULAR;
+    char path[] = "/tmp/vr_shape_XXXXXX";
+
+    VR_Shape_Clear(&shape);
+    if (!VR_Shape_Parse(&shape, &region, shape_test_text) || region != VR_SHAPE_MISSING ||
+        shape.length[VR_SHAPE_REGULAR] != 4 || shape.length[VR_SHAPE_MISSING] != 2 ||
+        shape.points[VR_SHAPE_REGULAR][3] != 300 || shape.points[VR_SHAPE_MISSING][0] != -1000) {
+        printf("TEST FAILED: shape parse: test text parsed wrongly\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        VR_ToothShape_t scratch;
+        region = VR_SHAPE_REGULAR;
+        VR_Shape_Clear(&scratch);
+        if (VR_Shape_Parse(&scratch, &region, bad[i])) {
+            printf("TEST FAILED: shape parse: \"%s\" accepted\n", bad[i]);
+            return false;
+        }
+    }
+
+    // A table can take VR_SHAPE_MAX_POINTS levels and no more
+    region = VR_SHAPE_REGULAR;
+    VR_Shape_Clear(&shape);
+    for (uint32_t i = 0; i < VR_SHAPE_MAX_POINTS; i++) {
+        if (!VR_Shape_Parse(&shape, &region, "7")) {
+            printf("TEST FAILED: shape parse: table full after %lu levels\n", (unsigned long)i);
+            return false;
+        }
+    }
+    if (VR_Shape_Parse(&shape, &region, "7")) {
+        printf("TEST FAILED: shape parse: table overfilled\n");
+        return false;
+    }
+
+    int fd = mkstemp(path);
+    FILE *file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (file == NULL) {
+        printf("TEST FAILED: shape parse: cannot create %s\n", path);
+        return false;
+    }
+    fputs(shape_test_text, file);
+    fclose(file);
+
+    bool loaded_ok = VR_HostSim_LoadShape(&loaded, path);
+    unlink(path);
+    if (!loaded_ok || memcmp(loaded.length, (uint16_t[]){4, 2}, sizeof(loaded.length)) != 0 ||
+        loaded.points[VR_SHAPE_MISSING][1] != 1000) {
+        printf("TEST FAILED: shape parse: file did not load\n");
+        return false;
+    }
+    if (VR_HostSim_LoadShape(&loaded, "/nonexistent/shape.txt")) {
+        printf("TEST FAILED: shape parse: missing file loaded\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Upload shapes through the command channel
+  * @retval True if every reply and the default instance's shape are as expected
+  */
+static bool Shape_TestCommands(void)
+{
+    const VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    char line[VR_COMMAND_LINE_MAX + 40];
+    char reply[VR_COMMAND_REPLY_MAX];
+    const VR_ToothShape_t *first;
+
+    if (!VR_Test_Command("shape", "SHAPE OFF\r", "OK\r\n") ||
+        !VR_Test_Command("shape", "shape\r\n", "OK SHAPE OFF\r\n") ||
+        !VR_Test_Command("shape", "SHAPE BEGIN\n", "OK\r\n") ||
+        !VR_Test_Command("shape", "SHAPE R 0 100 200 300\r", "OK R=4 M=0\r\n") ||
+        !VR_Test_Command("shape", "SHAPE M -1000\r", "OK R=4 M=1\r\n") ||
+        !VR_Test_Command("shape", "SHAPE END\r", "ERR need 2 levels per table\r\n") ||
+        !VR_Test_Command("shape", "SHAPE 1000\r", "OK R=4 M=2\r\n") ||
+        !VR_Test_Command("shape", "SHAPE R 4096\r", "ERR bad level or table full\r\n") ||
+        !VR_Test_Command("shape", "SHAPE END\r", "OK R=4 M=2\r\n") ||
+        !VR_Test_Command("shape", "Shape\r", "OK SHAPE ON R=4 M=2\r\n")) {
+        return false;
+    }
+
+    first = emu->shape;
+    if (first == NULL || VR_Shape_Sample(first, 17, 750, 1000) != SHAPE_DC + 500) {
+        printf("TEST FAILED: shape commands: uploaded shape not in use\n");
+        return false;
+    }
+
+    // A second upload goes to the other table, leaving the first intact
+    if (!VR_Test_Command("shape", "SHAPE BEGIN\r", "OK\r\n") ||
+        !VR_Test_Command("shape", "SHAPE R 5 5 M 6 6\r", "OK R=2 M=2\r\n") ||
+        !VR_Test_Command("shape", "SHAPE END\r", "OK R=2 M=2\r\n")) {
+        return false;
+    }
+    if (emu->shape == first || first->length[VR_SHAPE_REGULAR] != 4 ||
+        VR_Shape_Sample(emu->shape, 0, 0, 1000) != SHAPE_DC + 5) {
+        printf("TEST FAILED: shape commands: second upload overwrote the table in use\n");
+        return false;
+    }
+
+    if (!VR_Test_Command("shape", "FOO 1\r", "ERR unknown command\r\n")) {
+        return false;
+    }
+
+    memset(line, 'x', sizeof(line) - 2);
+    line[sizeof(line) - 2] = '\r';
+    line[sizeof(line) - 1] = '\0';
+    if (!VR_Test_Command("shape", line, "ERR line too long\r\n")) {
+        return false;
+    }
+
+    // Three lines before the main loop polls: the third is lost whole
+    uint32_t dropped = VR_Command_GetDropped();
+    for (const char *p = "SHAPE\rSHAPE OFF\rSHAPE BEGIN\r"; *p != '\0'; p++) {
+        VR_Command_RxByte((uint8_t)*p);
+    }
+    if (!VR_Command_Poll(reply, sizeof(reply)) || strcmp(reply, "OK SHAPE ON R=2 M=2\r\n") != 0 ||
+        !VR_Command_Poll(reply, sizeof(reply)) || strcmp(reply, "OK\r\n") != 0 ||
+        VR_Command_Poll(reply, sizeof(reply)) || VR_Command_GetDropped() != dropped + 1) {
+        printf("TEST FAILED: shape commands: busy main loop handled wrongly\n");
+        return false;
+    }
+    if (emu->shape != NULL || !VR_Test_Command("shape", "SHAPE\r", "OK SHAPE OFF\r\n")) {
+        printf("TEST FAILED: shape commands: SHAPE OFF left a shape in use\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Render a shaped profile sequentially and in parallel chunks
+  * @param  shape: Test waveform
+  * @retval True if both renders deliver the same holds
+  */
+static bool Shape_TestParallel(const VR_ToothShape_t *shape)
+{
+    VR_Profile_t profile;
+    ShapeDigest_t plain = {14695981039346656037ull, 0};
+    ShapeDigest_t sequential = plain, parallel = plain;
+
+    if (!VR_Profile_Parse(&profile, SHAPE_RUN_PROFILE)) {
+        printf("TEST FAILED: shaped run: bad profile\n");
+        return false;
+    }
+
+    VR_HostSim_SetShape(NULL);
+    VR_HostSim_Run(&profile, SHAPE_RUN_DURATION, VR_HOST_CONTROL_PERIOD_TICKS, Shape_DigestSink, &plain);
+
+    VR_HostSim_SetShape(shape);
+    VR_HostSim_Run(&profile, SHAPE_RUN_DURATION, VR_HOST_CONTROL_PERIOD_TICKS, Shape_DigestSink, &sequential);
+    VR_HostSim_RunParallel(&profile, SHAPE_RUN_DURATION, VR_HOST_CONTROL_PERIOD_TICKS, SHAPE_RUN_THREADS,
+                           SHAPE_RUN_CHUNK_TICKS, Shape_DigestSink, &parallel);
+    VR_HostSim_SetShape(NULL);
+
+    if (sequential.hash == plain.hash) {
+        printf("TEST FAILED: shaped run: shape not applied\n");
+        return false;
+    }
+    if (sequential.hash != parallel.hash || sequential.holds != parallel.holds) {
+        printf("TEST FAILED: shaped run: parallel render differs (%llu holds, expected %llu)\n",
+               (unsigned long long)parallel.holds, (unsigned long long)sequential.holds);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+  * @brief  Fold one hold into a digest
+  * @param  ctx: ShapeDigest_t
+  * @param  dac_value: Output level
+  * @param  start_tick: First tick of the hold
+  * @param  num_ticks: Hold length
+  * @retval None
+  */
+static void Shape_DigestSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    ShapeDigest_t *digest = ctx;
+    uint64_t words[3] = {dac_value, start_tick, num_ticks};
+
+    for (uint32_t i = 0; i < 3; i++) {
+        for (uint32_t b = 0; b < 8; b++) {
+            digest->hash ^= (words[i] >> (8 * b)) & 0xFFu;
+            digest->hash *= 1099511628211ull;
+        }
+    }
+    digest->holds++;
+}
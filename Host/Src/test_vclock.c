@@ -0,0 +1,415 @@
+/**
+  ******************************************************************************
+  * @file           : test_vclock.c
+  * @brief          : Variable clock output mode tests
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Each Host_TIM7_Update() is one DAC trigger, followed by the DMA write of
+  * the next reload value; htim7.Init.Period + 1 is then the length of the
+  * sample starting. TIM2 and TIM7 both count at 108 MHz, so TIM2 is moved
+  * on by that many ticks. Checks:
+  * - The revolution is rendered in chunks before the mode takes the DAC
+  *   over from TIM6, and the first RPM sets the TIM7 table.
+  * - Two revolutions played back match an unbound emulator stepping 64
+  *   phases per tooth, at 1875 ticks per sample for 3000 RPM, with two
+  *   transfer interrupts per revolution.
+  * - A 1 RPM change only rewrites the table: each tooth lasts exactly
+  *   360000000 / RPM ticks and every sample starts within a tick of its
+  *   ideal time.
+  * - Below VR_VCLK_MIN_RPM the output holds the DC level, and playback
+  *   restarts when the speed rises.
+  * - Stopping hands the DAC and TIM6 back to the default instance.
+  * - The VCLK telemetry line and the VCLK command, which turns REV off.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "test_vclock.h"
+#include "test_host.h"
+#include "vr_vclock.h"
+#include "vr_revolution.h"
+#include "vr_sample.h"
+#include "vr_command.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define VCLK_RPM                    3000
+#define VCLK_TICKS                  120000  // 360000000 / 3000, 1875 per sample
+#define VCLK_STEP_MRPM              25      // 3000 - 360000000 / 120001
+#define VCLK_RPM_RETUNE             3001
+#define VCLK_TICKS_RETUNE           119960  // Rounded down from 119960.01
+#define VCLK_RPM_HOLD               50
+
+/* Private variables ---------------------------------------------------------*/
+extern DAC_HandleTypeDef hdac;
+extern DMA_HandleTypeDef hdma_tim7_up;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+extern TIM_HandleTypeDef htim7;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Vclk_UpdateAll(void);
+static uint32_t Vclk_Trigger(void);
+static uint16_t *Vclk_Reference(uint32_t count);
+static bool Vclk_TestStart(void);
+static bool Vclk_TestPlayback(void);
+static bool Vclk_TestRetune(void);
+static bool Vclk_TestHold(void);
+static bool Vclk_TestStop(void);
+static bool Vclk_TestTelemetry(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Run the variable clock output mode tests
+  * @retval Test results
+  */
+TestResults_t VR_Test_Vclock(void)
+{
+    TestResults_t results = {0};
+
+    printf("Testing variable clock output mode...\n");
+
+    VR_Test_ResetDefault();
+    VR_Emulator_SetRPM(VCLK_RPM);
+    VR_Test_Record(&results, Vclk_TestStart());
+    VR_Test_Record(&results, Vclk_TestPlayback());
+    VR_Test_Record(&results, Vclk_TestRetune());
+    VR_Test_Record(&results, Vclk_TestHold());
+    VR_Test_Record(&results, Vclk_TestStop());
+    VR_Test_Record(&results, Vclk_TestTelemetry());
+    VR_Test_ResetDefault();
+
+    return VR_Test_Report(&results, "Variable clock mode");
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Call VR_Vclk_Update() until the render in progress completes
+  * @retval True if it completed within the expected number of calls
+  */
+static bool Vclk_UpdateAll(void)
+{
+    uint32_t calls = 0;
+
+    while (VR_Vclk_Update()) {
+        if (++calls > VR_VCLK_SAMPLES / VR_VCLK_RENDER_CHUNK + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+  * @brief  Run one TIM7 update and the sample it starts
+  * @retval Length of that sample in ticks
+  */
+static uint32_t Vclk_Trigger(void)
+{
+    Host_TIM7_Update();
+    htim2.Instance->CNT += htim7.Init.Period + 1;
+    return htim7.Init.Period + 1;
+}
+
+/**
+  * @brief  Render levels at 64 phases per tooth with an unbound instance
+  * @param  count: Number of samples
+  * @retval Levels, to be freed by the caller; NULL if out of memory
+  */
+static uint16_t *Vclk_Reference(uint32_t count)
+{
+    VR_Emulator_t ref;
+    uint16_t *levels = malloc(count * sizeof(uint16_t));
+
+    if (levels == NULL) {
+        return NULL;
+    }
+
+    VR_Emu_Init(&ref, NULL);
+    VR_Emu_SetShape(&ref, VR_Emulator_GetDefault()->shape);
+    ref.state.tooth_period_us = VR_VCLK_SAMPLES_PER_TOOTH;
+    ref.state.sample_period_us = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        VR_Emu_GenerateSignal(&ref);
+        levels[i] = ref.state.dac_output;
+    }
+    return levels;
+}
+
+/**
+  * @brief  Check the first render and the switch to TIM7
+  * @retval True if passed
+  */
+static bool Vclk_TestStart(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_VclkStats_t stats;
+
+    VR_Vclk_Start();
+    if (!VR_Vclk_IsEnabled() || (htim6.Instance->DIER & TIM_IT_UPDATE) == 0) {
+        printf("TEST FAILED: vclock start: output switched before the render\n");
+        return false;
+    }
+    if (!VR_Vclk_Update() || (htim6.Instance->DIER & TIM_IT_UPDATE) == 0) {
+        printf("TEST FAILED: vclock start: revolution rendered in one call\n");
+        return false;
+    }
+    if (!Vclk_UpdateAll()) {
+        printf("TEST FAILED: vclock start: render did not complete\n");
+        return false;
+    }
+
+    VR_Vclk_GetStats(&stats);
+    if (stats.rpm != VCLK_RPM || stats.tooth_ticks != VCLK_TICKS || stats.step_mrpm != VCLK_STEP_MRPM ||
+        stats.retunes != 1 || stats.renders != 1) {
+        printf("TEST FAILED: vclock start: %u RPM, %lu ticks, step %lu, %lu retunes, %lu renders\n",
+               stats.rpm, (unsigned long)stats.tooth_ticks, (unsigned long)stats.step_mrpm,
+               (unsigned long)stats.retunes, (unsigned long)stats.renders);
+        return false;
+    }
+    if ((htim6.Instance->DIER & TIM_IT_UPDATE) != 0 || hdac.trigger != DAC_TRIGGER_T7_TRGO ||
+        (htim7.Instance->DIER & TIM_DMA_UPDATE) == 0 || hdma_tim7_up.length != VR_VCLK_SAMPLES_PER_TOOTH ||
+        hdac.DMA_Handle1->length != VR_VCLK_SAMPLES || emu->binding.hdac != NULL ||
+        emu->binding.htim != NULL) {
+        printf("TEST FAILED: vclock start: DAC not handed to TIM7\n");
+        return false;
+    }
+
+    // Nothing changed: no render and no table rewrite
+    bool again = VR_Vclk_Update();
+    VR_Vclk_GetStats(&stats);
+    if (again || stats.renders != 1 || stats.retunes != 1) {
+        printf("TEST FAILED: vclock start: %lu renders, %lu retunes for one set point\n",
+               (unsigned long)stats.renders, (unsigned long)stats.retunes);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check two revolutions of output and their sample timing
+  * @retval True if passed
+  */
+static bool Vclk_TestPlayback(void)
+{
+    uint16_t *expected = Vclk_Reference(2 * VR_VCLK_SAMPLES);
+    VR_SampleStats_t before, after;
+    VR_VclkStats_t stats;
+    bool passed = true;
+
+    if (expected == NULL) {
+        printf("TEST FAILED: vclock playback: out of memory\n");
+        return false;
+    }
+
+    // The first trigger outputs the level held from before the DMA started
+    VR_Sample_GetStats(&before);
+    Vclk_Trigger();
+    for (uint32_t i = 0; i < 2 * VR_VCLK_SAMPLES && passed; i++) {
+        uint32_t ticks = Vclk_Trigger();
+
+        if (hdac.DHR12R1 != expected[i] || ticks != VCLK_TICKS / VR_VCLK_SAMPLES_PER_TOOTH) {
+            printf("TEST FAILED: vclock playback: sample %lu is %lu for %lu ticks, expected %u\n",
+                   (unsigned long)i, (unsigned long)hdac.DHR12R1, (unsigned long)ticks, expected[i]);
+            passed = false;
+        }
+    }
+    free(expected);
+    if (!passed) {
+        return false;
+    }
+
+    VR_Sample_GetStats(&after);
+    VR_Vclk_GetStats(&stats);
+    if (stats.revolutions != 2 || after.samples != before.samples + 4 || after.runs != before.runs + 4) {
+        printf("TEST FAILED: vclock playback: %lu revolutions, %lu samples, %lu bottom halves\n",
+               (unsigned long)stats.revolutions, (unsigned long)(after.samples - before.samples),
+               (unsigned long)(after.runs - before.runs));
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that 1 RPM more only rewrites the TIM7 table
+  * @retval True if passed
+  */
+static bool Vclk_TestRetune(void)
+{
+    uint32_t position = hdac.DMA_Handle1->NDTR;
+    uint32_t elapsed = 0;
+    VR_VclkStats_t stats;
+
+    VR_Emulator_SetRPM(VCLK_RPM_RETUNE);
+    if (!Vclk_UpdateAll()) {
+        printf("TEST FAILED: vclock retune: render started for an RPM change\n");
+        return false;
+    }
+    VR_Vclk_GetStats(&stats);
+    if (stats.rpm != VCLK_RPM_RETUNE || stats.tooth_ticks != VCLK_TICKS_RETUNE ||
+        stats.step_mrpm != VCLK_STEP_MRPM || stats.retunes != 2 || stats.renders != 1 ||
+        hdac.DMA_Handle1->NDTR != position) {
+        printf("TEST FAILED: vclock retune: %u RPM, %lu ticks, %lu retunes, %lu renders\n",
+               stats.rpm, (unsigned long)stats.tooth_ticks, (unsigned long)stats.retunes,
+               (unsigned long)stats.renders);
+        return false;
+    }
+
+    // Finish the tooth in progress, then time a whole one
+    while (hdma_tim7_up.NDTR != VR_VCLK_SAMPLES_PER_TOOTH) {
+        Vclk_Trigger();
+    }
+    for (uint32_t i = 0; i < VR_VCLK_SAMPLES_PER_TOOTH; i++) {
+        uint32_t ticks = Vclk_Trigger();
+        uint64_t ideal = (uint64_t)VCLK_TICKS_RETUNE * (i + 1u);
+
+        elapsed += ticks;
+        if (ticks < VCLK_TICKS_RETUNE / VR_VCLK_SAMPLES_PER_TOOTH ||
+            ticks > VCLK_TICKS_RETUNE / VR_VCLK_SAMPLES_PER_TOOTH + 1 ||
+            (uint64_t)elapsed * VR_VCLK_SAMPLES_PER_TOOTH > ideal ||
+            (uint64_t)(elapsed + 1u) * VR_VCLK_SAMPLES_PER_TOOTH <= ideal) {
+            printf("TEST FAILED: vclock retune: sample %lu lasts %lu ticks, ends at %lu\n",
+                   (unsigned long)i, (unsigned long)ticks, (unsigned long)elapsed);
+            return false;
+        }
+    }
+    if (elapsed != VCLK_TICKS_RETUNE) {
+        printf("TEST FAILED: vclock retune: tooth lasted %lu ticks, expected %u\n",
+               (unsigned long)elapsed, VCLK_TICKS_RETUNE);
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the DC hold below the slowest speed and the restart
+  * @retval True if passed
+  */
+static bool Vclk_TestHold(void)
+{
+    VR_VclkStats_t stats;
+    uint32_t dc = (uint32_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+
+    VR_Emulator_SetRPM(VCLK_RPM_HOLD);
+    Vclk_UpdateAll();
+    VR_Vclk_GetStats(&stats);
+    if (stats.rpm != 0 || hdac.trigger != DAC_TRIGGER_NONE || hdac.DHR12R1 != dc ||
+        (htim7.Instance->DIER & TIM_DMA_UPDATE) != 0 || (htim6.Instance->DIER & TIM_IT_UPDATE) != 0) {
+        printf("TEST FAILED: vclock hold: %u RPM, output %lu at %u RPM\n",
+               stats.rpm, (unsigned long)hdac.DHR12R1, VCLK_RPM_HOLD);
+        return false;
+    }
+    Vclk_Trigger();
+    if (hdac.DHR12R1 != dc) {
+        printf("TEST FAILED: vclock hold: output moved while holding\n");
+        return false;
+    }
+
+    VR_Emulator_SetRPM(VCLK_RPM);
+    Vclk_UpdateAll();
+    VR_Vclk_GetStats(&stats);
+    if (stats.rpm != VCLK_RPM || hdac.trigger != DAC_TRIGGER_T7_TRGO ||
+        hdac.DMA_Handle1->NDTR != VR_VCLK_SAMPLES || hdma_tim7_up.NDTR != VR_VCLK_SAMPLES_PER_TOOTH) {
+        printf("TEST FAILED: vclock hold: playback not restarted from tooth 0\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check that stopping returns to one interrupt per sample
+  * @retval True if passed
+  */
+static bool Vclk_TestStop(void)
+{
+    VR_Emulator_t *emu = VR_Emulator_GetDefault();
+    VR_SampleStats_t before, after;
+
+    // Stop mid-tooth, after a half transfer has reported the phase
+    for (uint32_t i = 0; i < VR_VCLK_SAMPLES / 2 + 100; i++) {
+        Vclk_Trigger();
+    }
+    VR_Vclk_Stop();
+    if (VR_Vclk_IsEnabled() || (htim6.Instance->DIER & TIM_IT_UPDATE) == 0 ||
+        hdac.trigger != DAC_TRIGGER_NONE || (htim7.Instance->DIER & TIM_DMA_UPDATE) != 0 ||
+        emu->binding.hdac != &hdac || emu->binding.htim != &htim6) {
+        printf("TEST FAILED: vclock stop: DAC and TIM6 not handed back\n");
+        return false;
+    }
+    if (emu->state.tooth_timer >= emu->state.tooth_period_us || emu->state.current_tooth == 0) {
+        printf("TEST FAILED: vclock stop: resumed at tooth %u, %lu us\n",
+               emu->state.current_tooth, (unsigned long)emu->state.tooth_timer);
+        return false;
+    }
+
+    // Each update now renders a sample in the TIM6 interrupt
+    VR_Sample_GetStats(&before);
+    Host_TIM6_Update();
+    VR_Sample_GetStats(&after);
+    if (after.samples != before.samples + 1 || hdac.DHR12R1 != emu->state.dac_output) {
+        printf("TEST FAILED: vclock stop: TIM6 interrupt not resumed\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Check the VCLK telemetry line and the VCLK command
+  * @retval True if passed
+  */
+static bool Vclk_TestTelemetry(void)
+{
+    VR_VclkStats_t stats;
+    char line[128];
+    char expected[128];
+
+    if (VR_Vclk_FormatTelemetry(line, sizeof(line)) != 0 || line[0] != '\0') {
+        printf("TEST FAILED: vclock telemetry: line while the mode is off\n");
+        return false;
+    }
+
+    if (!VR_Test_Command("vclock", "VCLK ON\r", "OK VCLK ON\r\n") || !Vclk_UpdateAll()) {
+        return false;
+    }
+    VR_Vclk_GetStats(&stats);
+    snprintf(expected, sizeof(expected),
+             "VCLK rpm=%u tooth=%ut step=%umrpm revs=%lu retunes=%lu renders=%lu\r\n",
+             VCLK_RPM, VCLK_TICKS, VCLK_STEP_MRPM, (unsigned long)stats.revolutions,
+             (unsigned long)stats.retunes, (unsigned long)stats.renders);
+    uint32_t len = VR_Vclk_FormatTelemetry(line, sizeof(line));
+    if (len != strlen(expected) || strcmp(line, expected) != 0) {
+        printf("TEST FAILED: vclock telemetry: \"%s\"\n", line);
+        return false;
+    }
+    if (VR_Vclk_FormatTelemetry(line, 8) != 7 || strlen(line) != 7) {
+        printf("TEST FAILED: vclock telemetry: short buffer not truncated\n");
+        return false;
+    }
+
+    snprintf(expected, sizeof(expected), "OK VCLK ON RPM=%u TOOTH=%u STEP=%u REVS=%lu\r\n",
+             VCLK_RPM, VCLK_TICKS, VCLK_STEP_MRPM, (unsigned long)stats.revolutions);
+    if (!VR_Test_Command("vclock", "VCLK\r", expected)) {
+        return false;
+    }
+
+    // The two DMA modes exclude each other
+    if (!VR_Test_Command("vclock", "REV ON\r", "OK REV ON\r\n") || VR_Vclk_IsEnabled() || !VR_Rev_IsEnabled()) {
+        printf("TEST FAILED: vclock command: REV ON left variable clock mode on\n");
+        return false;
+    }
+    if (!VR_Test_Command("vclock", "VCLK ON\r", "OK VCLK ON\r\n") || VR_Rev_IsEnabled()) {
+        printf("TEST FAILED: vclock command: VCLK ON left revolution mode on\n");
+        return false;
+    }
+    return VR_Test_Command("vclock", "VCLK OFF\r", "OK VCLK OFF\r\n") &&
+           VR_Test_Command("vclock", "VCLK SIDEWAYS\r", "ERR unknown VCLK command\r\n") && !VR_Vclk_IsEnabled();
+}
+
@@ -0,0 +1,257 @@
+/**
+  ******************************************************************************
+  * @file           : vr_batch.c
+  * @brief          : Structure-of-arrays batch renderer
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * VR_Batch_Step() performs one VR_Emu_GenerateSignal() for every lane.
+  * The loop body has no branches or calls, so the compiler maps lanes onto
+  * vector registers:
+  * - The phase update and tooth wrap are the scalar integer arithmetic,
+  *   done with selects, so tooth timing matches VR_Emu_* exactly.
+  * - The three sinf() calls of the harmonic model become one sin/cos
+  *   polynomial. sin 2a and sin 3a follow from sin a and cos a.
+  * - Stopped lanes hold their output, as VR_Emu_TimerCallback() does.
+  *
+  * The polynomial is accurate to a few float ulps, so a level can differ
+  * from the scalar model by at most 1 LSB where it rounds the other way.
+  *
+  * RPM changes use VR_Emu_SetRPM() on a scratch instance, so tooth and
+  * sample periods always come from the firmware's own calculation.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_batch.h"
+#include "vr_sensor_emulator.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BATCH_ALIGN                 64
+
+/* Cody-Waite split of pi/2 and minimax coefficients on [-pi/4, pi/4] */
+#define BATCH_2_OVER_PI             0.636619772f
+#define BATCH_PIO2_HI               1.5703125f
+#define BATCH_PIO2_LO               4.83826794897e-4f
+#define BATCH_SIN_C1                -1.6666654611e-1f
+#define BATCH_SIN_C2                8.3321608736e-3f
+#define BATCH_SIN_C3                -1.9515295891e-4f
+#define BATCH_COS_C1                4.166664568298827e-2f
+#define BATCH_COS_C2                -1.388731625493765e-3f
+#define BATCH_COS_C3                2.443315711809948e-5f
+
+/* Private function prototypes -----------------------------------------------*/
+static void *Batch_Alloc(uint32_t lanes, size_t size);
+static void Batch_StepBlock(uint32_t *restrict timer, const uint32_t *restrict step,
+                            const uint32_t *restrict period, uint32_t *restrict tooth,
+                            const float *restrict amplitude, uint16_t *restrict output);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Allocate a batch
+  * @param  batch: Batch to initialise
+  * @param  capacity: Maximum number of lanes
+  * @retval True on success
+  */
+bool VR_Batch_Init(VR_Batch_t *batch, uint32_t capacity)
+{
+    uint32_t lanes = (capacity + VR_BATCH_BLOCK - 1) / VR_BATCH_BLOCK * VR_BATCH_BLOCK;
+
+    memset(batch, 0, sizeof(*batch));
+    batch->capacity = lanes;
+    batch->tooth_timer = Batch_Alloc(lanes, sizeof(uint32_t));
+    batch->sample_period = Batch_Alloc(lanes, sizeof(uint32_t));
+    batch->tooth_period = Batch_Alloc(lanes, sizeof(uint32_t));
+    batch->tooth = Batch_Alloc(lanes, sizeof(uint32_t));
+    batch->amplitude = Batch_Alloc(lanes, sizeof(float));
+    batch->rpm = Batch_Alloc(lanes, sizeof(uint16_t));
+    batch->output = Batch_Alloc(lanes, sizeof(uint16_t));
+
+    if (batch->tooth_timer == NULL || batch->sample_period == NULL || batch->tooth_period == NULL ||
+        batch->tooth == NULL || batch->amplitude == NULL || batch->rpm == NULL || batch->output == NULL) {
+        VR_Batch_Free(batch);
+        return false;
+    }
+
+    // Unused lanes in the last block are stopped sensors at the DC level
+    for (uint32_t i = 0; i < lanes; i++) {
+        batch->output[i] = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Release a batch
+  * @param  batch: Batch
+  * @retval None
+  */
+void VR_Batch_Free(VR_Batch_t *batch)
+{
+    free(batch->tooth_timer);
+    free(batch->sample_period);
+    free(batch->tooth_period);
+    free(batch->tooth);
+    free(batch->amplitude);
+    free(batch->rpm);
+    free(batch->output);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/**
+  * @brief  Add a sensor in the state VR_Emu_Init() leaves an instance
+  * @param  batch: Batch
+  * @param  rpm: Initial RPM
+  * @param  amplitude: Sine amplitude (VR_AMPLITUDE_SCALE for the nominal sensor)
+  * @retval Lane index, -1 if the batch is full
+  */
+int32_t VR_Batch_Add(VR_Batch_t *batch, uint16_t rpm, float amplitude)
+{
+    if (batch->count >= batch->capacity) {
+        return -1;
+    }
+
+    uint32_t lane = batch->count++;
+
+    batch->tooth_timer[lane] = 0;
+    batch->tooth[lane] = 0;
+    batch->amplitude[lane] = amplitude;
+    batch->output[lane] = (uint16_t)(DAC_RESOLUTION * VR_DC_OFFSET);
+    batch->sample_period[lane] = VR_DEFAULT_SAMPLE_TICKS * VR_SAMPLE_TICK_US;
+    batch->tooth_period[lane] = 0;
+    batch->rpm[lane] = 0;
+    VR_Batch_SetRPM(batch, lane, rpm);
+
+    return (int32_t)lane;
+}
+
+/**
+  * @brief  Change the RPM of one lane, as VR_Emu_SetRPM() does
+  * @param  batch: Batch
+  * @param  lane: Lane index
+  * @param  rpm: Target RPM (0 to MAX_RPM)
+  * @retval None
+  */
+void VR_Batch_SetRPM(VR_Batch_t *batch, uint32_t lane, uint16_t rpm)
+{
+    VR_Emulator_t scratch;
+
+    VR_Emu_Init(&scratch, NULL);
+    scratch.state.sample_period_us = batch->sample_period[lane];
+    VR_Emu_SetRPM(&scratch, rpm);
+
+    batch->rpm[lane] = scratch.state.target_rpm;
+    batch->tooth_period[lane] = scratch.state.tooth_period_us;
+    batch->sample_period[lane] = scratch.state.sample_period_us;
+    if (scratch.state.target_rpm == 0) {
+        batch->output[lane] = scratch.state.dac_output;
+    }
+}
+
+/**
+  * @brief  Render one update for every lane
+  * @param  batch: Batch
+  * @retval None
+  */
+void VR_Batch_Step(VR_Batch_t *batch)
+{
+    for (uint32_t i = 0; i < batch->count; i += VR_BATCH_BLOCK) {
+        Batch_StepBlock(&batch->tooth_timer[i], &batch->sample_period[i], &batch->tooth_period[i],
+                        &batch->tooth[i], &batch->amplitude[i], &batch->output[i]);
+    }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Allocate one cache-line aligned lane array
+  * @param  lanes: Number of lanes
+  * @param  size: Bytes per lane
+  * @retval Zeroed array, NULL on failure
+  */
+static void *Batch_Alloc(uint32_t lanes, size_t size)
+{
+    size_t bytes = (lanes * size + BATCH_ALIGN - 1) / BATCH_ALIGN * BATCH_ALIGN;
+    void *p = (bytes > 0) ? aligned_alloc(BATCH_ALIGN, bytes) : NULL;
+
+    if (p != NULL) {
+        memset(p, 0, bytes);
+    }
+    return p;
+}
+
+/**
+  * @brief  One update for VR_BATCH_BLOCK lanes
+  * @note   Fixed trip count, restrict pointers and selects only, so the loop
+  *         vectorises at -O2. Without trapping math GCC may evaluate both
+  *         sides of a float select; results are unchanged.
+  * @retval None
+  */
+__attribute__((optimize("no-trapping-math")))
+static void Batch_StepBlock(uint32_t *restrict timer, const uint32_t *restrict step,
+                            const uint32_t *restrict period, uint32_t *restrict tooth,
+                            const float *restrict amplitude, uint16_t *restrict output)
+{
+    const float regular_width = REGULAR_TOOTH_ANGLE / (REGULAR_TOOTH_ANGLE + REGULAR_TOOTH_GAP);
+    const float missing_width = MISSING_TOOTH_ANGLE / (MISSING_TOOTH_ANGLE + MISSING_TOOTH_GAP);
+    const float tooth_pitch = 360.0f / TRIGGER_WHEEL_TEETH;
+    const float deg_to_rad = (float)(M_PI / 180.0);
+
+    for (uint32_t i = 0; i < VR_BATCH_BLOCK; i++) {
+        // Every array is read unconditionally so the selects below need no branches
+        uint32_t p = period[i];
+        uint32_t dt = step[i];
+        uint32_t n = tooth[i];
+        float a = amplitude[i];
+        uint16_t held = output[i];
+        uint32_t running = (p != 0);
+        uint32_t t = timer[i] + (running ? dt : 0);
+        uint32_t wide = (n == MISSING_TOOTH_INDEX);
+
+        // Phase within the tooth and crank angle, as in VR_Emu_GenerateSignal()
+        float frac = (float)(int32_t)t / (float)(int32_t)(running ? p : 1);
+        uint32_t active = frac < (wide ? missing_width : regular_width);
+        float angle = ((float)(int32_t)n * tooth_pitch + frac * tooth_pitch) * deg_to_rad;
+
+        // sin and cos of the angle: quadrant reduction and polynomials
+        int32_t k = (int32_t)(angle * BATCH_2_OVER_PI + 0.5f);
+        float r = (angle - (float)k * BATCH_PIO2_HI) - (float)k * BATCH_PIO2_LO;
+        float z = r * r;
+        float sp = r + r * z * (BATCH_SIN_C1 + z * (BATCH_SIN_C2 + z * BATCH_SIN_C3));
+        float cp = 1.0f - 0.5f * z + z * z * (BATCH_COS_C1 + z * (BATCH_COS_C2 + z * BATCH_COS_C3));
+        uint32_t q = (uint32_t)k & 3u;
+        float s1 = (q & 1u) ? cp : sp;
+        float c1 = (q & 1u) ? sp : cp;
+        s1 = (q & 2u) ? -s1 : s1;
+        c1 = ((q + 1u) & 2u) ? -c1 : c1;
+
+        // VR_Emulator_ApplyDistortion() with sin 2a and sin 3a from sin a, cos a
+        float s2 = 2.0f * s1 * c1;
+        float s3 = s1 * (3.0f - 4.0f * s1 * s1);
+        float shaped = s1 + s2 * VR_DISTORTION_FACTOR + s3 * (VR_DISTORTION_FACTOR * 0.5f) +
+                       ((s1 > 0.0f) ? 0.1f * VR_DISTORTION_FACTOR : -0.05f * VR_DISTORTION_FACTOR);
+
+        // VR_Emulator_CalculateDAC_Value()
+        float v = VR_DC_OFFSET + (active ? shaped * a : 0.0f);
+        v = (v < 0.0f) ? 0.0f : v;
+        v = (v > 1.0f) ? 1.0f : v;
+        int32_t code = (int32_t)(v * DAC_RESOLUTION);
+        code = (code > DAC_RESOLUTION - 1) ? DAC_RESOLUTION - 1 : code;
+
+        // Tooth wrap with overshoot carry, as VR_Emu_WrapTooth()
+        uint32_t wrap = running && t >= p;
+        uint32_t carried = t - (wrap ? p : 0);
+        carried = (wrap && carried >= p) ? 0 : carried;
+        uint32_t next = (n + 1 == TRIGGER_WHEEL_TEETH) ? 0 : n + 1;
+
+        timer[i] = carried;
+        tooth[i] = wrap ? next : n;
+        output[i] = running ? (uint16_t)code : held;
+    }
+}
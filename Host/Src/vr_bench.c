@@ -0,0 +1,477 @@
+/**
+  ******************************************************************************
+  * @file           : vr_bench.c
+  * @brief          : Host micro-benchmarks for the VR signal path
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Measures the per-call cost of the emulator signal path:
+  * - VR_Emulator_CalculateDAC_Value() over one revolution of angles
+  * - VR_Emulator_ApplyDistortion() over one revolution of angles
+  * - VR_Emulator_SetRPM() across the RPM range
+  * - The full per-sample render path (VR_Emulator_TimerCallback) at a
+  *   sweep of RPMs
+  * - One update of BENCH_INSTANCES sensors, as scalar instances and as one
+  *   structure-of-arrays batch (cost per sensor update)
+  *
+  * Each benchmark runs warm-up repetitions, then times repeated batches
+  * and reports min, median and p99 nanoseconds per call. The process can
+  * be pinned to one CPU and, where the kernel allows it, cycles and
+  * instructions are read through perf_event.
+  *
+  * Usage: vr_bench [-o FILE.json] [-b BASELINE.json] [-t PERCENT]
+  *                 [-c CPU] [-r REPS] [-n BATCH] [-P]
+  *
+  *   -o  Write results as JSON
+  *   -b  Compare medians with a previous JSON result; exit 1 on regression
+  *   -t  Allowed regression in percent (default 10)
+  *   -c  Pin to this CPU (default 0, -1 to disable)
+  *   -r  Timed repetitions per benchmark (default 101)
+  *   -n  Calls per repetition (default 20000)
+  *   -P  Read hardware counters through perf_event
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include "vr_sensor_emulator.h"
+#include "vr_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BENCH_MAX_RESULTS           32
+#define BENCH_MAX_REPS              10001
+#define BENCH_WARMUP_REPS           10
+#define BENCH_NAME_LEN              32
+#define BENCH_INSTANCES             1000    // Sensors in the instance benchmarks
+
+/* Private typedef -----------------------------------------------------------*/
+typedef void (*Bench_Fn_t)(uint32_t iterations);
+
+typedef struct {
+    char name[BENCH_NAME_LEN];
+    double min_ns;
+    double median_ns;
+    double p99_ns;
+    double calls_per_s;
+    double cycles;              // Per call, 0 when counters are unavailable
+    double instructions;        // Per call, 0 when counters are unavailable
+} Bench_Result_t;
+
+typedef struct {
+    int cycles_fd;
+    int instr_fd;
+} Bench_Counters_t;
+
+/* Private variables ---------------------------------------------------------*/
+static Bench_Result_t results[BENCH_MAX_RESULTS];
+static uint32_t num_results = 0;
+static double rep_ns[BENCH_MAX_REPS];
+static double rep_cycles[BENCH_MAX_REPS];
+static double rep_instr[BENCH_MAX_REPS];
+static Bench_Counters_t counters = { -1, -1 };
+static uint32_t reps = 101;
+static uint32_t batch = 20000;
+static volatile uint32_t bench_sink;
+static VR_Emulator_t bench_emus[BENCH_INSTANCES];
+static VR_Batch_t bench_batch;
+
+extern DAC_HandleTypeDef hdac;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Bench_Run(const char *name, Bench_Fn_t fn);
+static void Bench_CalculateDAC(uint32_t iterations);
+static void Bench_ApplyDistortion(uint32_t iterations);
+static void Bench_SetRPM(uint32_t iterations);
+static void Bench_Render(uint32_t iterations);
+static void Bench_InstancesScalar(uint32_t iterations);
+static void Bench_InstancesBatch(uint32_t iterations);
+static uint64_t Now_ns(void);
+static int Compare_Double(const void *a, const void *b);
+static void Counters_Open(void);
+static void Counters_Start(void);
+static void Counters_Stop(double *cycles, double *instr);
+static bool Write_JSON(const char *path);
+static int Compare_Baseline(const char *path, double tolerance_pct);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Benchmark entry point
+  * @retval 0 on success, 1 on regression or error
+  */
+int main(int argc, char *argv[])
+{
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    double tolerance_pct = 10.0;
+    int cpu = 0;
+    bool use_perf = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:b:t:c:r:n:P")) != -1) {
+        switch (opt) {
+        case 'o': json_path = optarg; break;
+        case 'b': baseline_path = optarg; break;
+        case 't': tolerance_pct = strtod(optarg, NULL); break;
+        case 'c': cpu = atoi(optarg); break;
+        case 'r': reps = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'n': batch = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'P': use_perf = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-o FILE] [-b BASELINE] [-t PCT] [-c CPU] [-r REPS] [-n BATCH] [-P]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    if (reps == 0 || reps > BENCH_MAX_REPS || batch == 0) {
+        fprintf(stderr, "Repetitions must be 1..%d and batch non-zero\n", BENCH_MAX_REPS);
+        return 2;
+    }
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "Warning: could not pin to CPU %d\n", cpu);
+        }
+    }
+
+    if (use_perf) {
+        Counters_Open();
+    }
+
+    VR_Emulator_Init();
+
+    printf("%-22s %10s %10s %10s %14s %8s %8s\n",
+           "benchmark", "min ns", "median ns", "p99 ns", "calls/s", "cycles", "instr");
+
+    Bench_Run("calculate_dac_value", Bench_CalculateDAC);
+    Bench_Run("apply_distortion", Bench_ApplyDistortion);
+    Bench_Run("set_rpm_sweep", Bench_SetRPM);
+
+    static const uint16_t sweep_rpms[] = {100, 800, 3000, 6000, 9000, MAX_RPM};
+    for (uint32_t i = 0; i < sizeof(sweep_rpms) / sizeof(sweep_rpms[0]); i++) {
+        char name[BENCH_NAME_LEN];
+        snprintf(name, sizeof(name), "render_%u_rpm", sweep_rpms[i]);
+        VR_Emulator_SetRPM(sweep_rpms[i]);
+        Bench_Run(name, Bench_Render);
+    }
+
+    if (!VR_Batch_Init(&bench_batch, BENCH_INSTANCES)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < BENCH_INSTANCES; i++) {
+        uint16_t rpm = (uint16_t)(1 + (i * 7919u) % MAX_RPM);
+        VR_Emu_Init(&bench_emus[i], NULL);
+        VR_Emu_SetRPM(&bench_emus[i], rpm);
+        VR_Batch_Add(&bench_batch, rpm, VR_AMPLITUDE_SCALE);
+    }
+    Bench_Run("instances_scalar", Bench_InstancesScalar);
+    Bench_Run("instances_batch", Bench_InstancesBatch);
+    VR_Batch_Free(&bench_batch);
+
+    if (json_path != NULL && !Write_JSON(json_path)) {
+        fprintf(stderr, "Cannot write '%s'\n", json_path);
+        return 1;
+    }
+
+    if (baseline_path != NULL) {
+        return Compare_Baseline(baseline_path, tolerance_pct);
+    }
+
+    return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Time one benchmark and record its statistics
+  * @param  name: Benchmark name
+  * @param  fn: Function running the given number of calls
+  * @retval None
+  */
+static void Bench_Run(const char *name, Bench_Fn_t fn)
+{
+    Bench_Result_t *r = &results[num_results++];
+
+    for (uint32_t i = 0; i < BENCH_WARMUP_REPS; i++) {
+        fn(batch);
+    }
+
+    for (uint32_t i = 0; i < reps; i++) {
+        Counters_Start();
+        uint64_t t0 = Now_ns();
+        fn(batch);
+        uint64_t t1 = Now_ns();
+        Counters_Stop(&rep_cycles[i], &rep_instr[i]);
+
+        rep_ns[i] = (double)(t1 - t0) / batch;
+        rep_cycles[i] /= batch;
+        rep_instr[i] /= batch;
+    }
+
+    qsort(rep_ns, reps, sizeof(double), Compare_Double);
+    qsort(rep_cycles, reps, sizeof(double), Compare_Double);
+    qsort(rep_instr, reps, sizeof(double), Compare_Double);
+
+    uint32_t p99_index = (reps * 99 + 99) / 100 - 1;
+
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->min_ns = rep_ns[0];
+    r->median_ns = rep_ns[reps / 2];
+    r->p99_ns = rep_ns[p99_index];
+    r->calls_per_s = (r->median_ns > 0.0) ? 1e9 / r->median_ns : 0.0;
+    r->cycles = rep_cycles[reps / 2];
+    r->instructions = rep_instr[reps / 2];
+
+    printf("%-22s %10.2f %10.2f %10.2f %14.0f %8.1f %8.1f\n",
+           r->name, r->min_ns, r->median_ns, r->p99_ns, r->calls_per_s, r->cycles, r->instructions);
+}
+
+/**
+  * @brief  VR_Emulator_CalculateDAC_Value() over one revolution
+  * @param  iterations: Number of calls
+  * @retval None
+  */
+static void Bench_CalculateDAC(uint32_t iterations)
+{
+    uint32_t acc = 0;
+    float step = DEGREES_TO_RADIANS(360.0f) / iterations;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        acc += VR_Emulator_CalculateDAC_Value(i * step, 1);
+    }
+    bench_sink = acc;
+}
+
+/**
+  * @brief  VR_Emulator_ApplyDistortion() over one revolution
+  * @param  iterations: Number of calls
+  * @retval None
+  */
+static void Bench_ApplyDistortion(uint32_t iterations)
+{
+    float acc = 0.0f;
+    float step = DEGREES_TO_RADIANS(360.0f) / iterations;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        float angle = i * step;
+        acc += VR_Emulator_ApplyDistortion(sinf(angle), angle);
+    }
+    bench_sink = (uint32_t)acc;
+}
+
+/**
+  * @brief  VR_Emulator_SetRPM() stepping through 1..MAX_RPM
+  * @param  iterations: Number of calls
+  * @retval None
+  */
+static void Bench_SetRPM(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        VR_Emulator_SetRPM((uint16_t)(1 + (i * 7u) % MAX_RPM));
+    }
+    bench_sink = VR_Emulator_GetRPM();
+}
+
+/**
+  * @brief  Full per-sample render path at the current RPM
+  * @param  iterations: Number of TIM6 updates to render
+  * @retval None
+  */
+static void Bench_Render(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        VR_Emulator_TimerCallback();
+    }
+    bench_sink = hdac.DHR12R1;
+}
+
+/**
+  * @brief  Scalar instances updated one after another
+  * @param  iterations: Number of sensor updates
+  * @retval None
+  */
+static void Bench_InstancesScalar(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i++) {
+        VR_Emu_TimerCallback(&bench_emus[i % BENCH_INSTANCES]);
+    }
+    bench_sink = VR_Emu_GetOutput(&bench_emus[0]);
+}
+
+/**
+  * @brief  The same sensors updated as one batch
+  * @param  iterations: Number of sensor updates, rounded up to whole steps
+  * @retval None
+  */
+static void Bench_InstancesBatch(uint32_t iterations)
+{
+    for (uint32_t i = 0; i < iterations; i += BENCH_INSTANCES) {
+        VR_Batch_Step(&bench_batch);
+    }
+    bench_sink = bench_batch.output[0];
+}
+
+static uint64_t Now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int Compare_Double(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/**
+  * @brief  Open a cycles + instructions counter group for this thread
+  * @retval None
+  */
+static void Counters_Open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    counters.cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counters.cycles_fd < 0) {
+        fprintf(stderr, "Warning: perf_event unavailable, hardware counters disabled\n");
+        return;
+    }
+
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 0;
+    counters.instr_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, counters.cycles_fd, 0);
+    if (counters.instr_fd < 0) {
+        close(counters.cycles_fd);
+        counters.cycles_fd = -1;
+        fprintf(stderr, "Warning: perf_event instructions counter unavailable\n");
+    }
+}
+
+static void Counters_Start(void)
+{
+    if (counters.cycles_fd >= 0) {
+        ioctl(counters.cycles_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(counters.cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static void Counters_Stop(double *cycles, double *instr)
+{
+    uint64_t value = 0;
+
+    *cycles = 0.0;
+    *instr = 0.0;
+
+    if (counters.cycles_fd < 0) {
+        return;
+    }
+
+    ioctl(counters.cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(counters.cycles_fd, &value, sizeof(value)) == sizeof(value)) {
+        *cycles = (double)value;
+    }
+    if (read(counters.instr_fd, &value, sizeof(value)) == sizeof(value)) {
+        *instr = (double)value;
+    }
+}
+
+/**
+  * @brief  Write all results as a JSON document
+  * @param  path: Output file
+  * @retval True on success
+  */
+static bool Write_JSON(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+
+    fprintf(f, "{\n  \"reps\": %u,\n  \"batch\": %u,\n  \"results\": [\n", reps, batch);
+    for (uint32_t i = 0; i < num_results; i++) {
+        const Bench_Result_t *r = &results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"min_ns\": %.3f, \"median_ns\": %.3f, \"p99_ns\": %.3f, "
+                   "\"calls_per_s\": %.0f, \"cycles\": %.2f, \"instructions\": %.2f}%s\n",
+                r->name, r->min_ns, r->median_ns, r->p99_ns, r->calls_per_s,
+                r->cycles, r->instructions, (i + 1 < num_results) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    return fclose(f) == 0;
+}
+
+/**
+  * @brief  Compare median times against a baseline written by Write_JSON()
+  * @param  path: Baseline JSON file
+  * @param  tolerance_pct: Allowed slowdown in percent
+  * @retval 0 if no benchmark regressed, 1 otherwise
+  */
+static int Compare_Baseline(const char *path, double tolerance_pct)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int regressions = 0;
+
+    if (f == NULL) {
+        fprintf(stderr, "Cannot read baseline '%s'\n", path);
+        return 1;
+    }
+
+    printf("\nBaseline comparison (tolerance %.1f%%):\n", tolerance_pct);
+
+    // One result object per line, as produced by Write_JSON()
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[BENCH_NAME_LEN];
+        double base_median;
+        const char *p = strstr(line, "\"name\": \"");
+        const char *m = strstr(line, "\"median_ns\": ");
+
+        if (p == NULL || m == NULL ||
+            sscanf(p, "\"name\": \"%31[^\"]\"", name) != 1 ||
+            sscanf(m, "\"median_ns\": %lf", &base_median) != 1) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < num_results; i++) {
+            if (strcmp(results[i].name, name) != 0) {
+                continue;
+            }
+            double change = (results[i].median_ns - base_median) / base_median * 100.0;
+            bool regressed = change > tolerance_pct;
+            printf("  %-22s %10.2f -> %10.2f ns (%+6.1f%%) %s\n",
+                   name, base_median, results[i].median_ns, change, regressed ? "REGRESSION" : "ok");
+            regressions += regressed ? 1 : 0;
+        }
+    }
+    fclose(f);
+
+    return (regressions == 0) ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/**
+  ******************************************************************************
+  * @file           : vr_decoder.c
+  * @brief          : Reference ECU-style crank decoder
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Detection: a tooth is present while the signal deviates from the
+  * no-tooth baseline by more than the hysteresis, in either polarity.
+  * This is a zero-crossing detector referenced to an adaptive baseline,
+  * which is tracked with a slow average over gap samples only.
+  *
+  * Sync: every tooth has the same pitch. The odd tooth is wider, so the gap
+  * after it is shorter (8 deg against 16 deg). A gap shorter than
+  * gap_ratio times the previous gap marks the end of the odd tooth, so the
+  * next leading edge is tooth 0. Once synced, that gap must appear exactly
+  * every TRIGGER_WHEEL_TEETH teeth, otherwise sync is lost.
+  *
+  * RPM is computed from the leading-edge to leading-edge tooth period.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_decoder.h"
+#include "vr_sensor_emulator.h"
+#include <string.h>
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BASELINE_SHIFT              4       // Baseline follows gaps with a 1/16 weight
+
+/* Private function prototypes -----------------------------------------------*/
+static void Decoder_OnRise(VR_Decoder_t *dec, uint64_t tick);
+static double Decoder_ErrorPct(float measured_rpm, float commanded_rpm);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Initialise a decoder
+  * @param  dec: Decoder
+  * @param  config: Configuration, NULL for defaults
+  * @retval None
+  */
+void VR_Decoder_Init(VR_Decoder_t *dec, const VR_DecoderConfig_t *config)
+{
+    memset(dec, 0, sizeof(*dec));
+
+    if (config != NULL) {
+        dec->config = *config;
+    } else {
+        dec->config.hysteresis_lsb = VR_DECODER_DEFAULT_HYSTERESIS;
+        dec->config.gap_ratio = VR_DECODER_DEFAULT_GAP_RATIO;
+    }
+}
+
+/**
+  * @brief  Sample sink for VR_HostSim_Run()
+  * @param  ctx: Decoder
+  * @param  dac_value: DAC level
+  * @param  start_tick: Tick at which the level appears on the pin
+  * @param  num_ticks: Ticks the level is held (unused)
+  * @retval None
+  */
+void VR_Decoder_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    VR_Decoder_t *dec = (VR_Decoder_t *)ctx;
+    float x = (float)dac_value;
+
+    (void)num_ticks;
+
+    if (!dec->baseline_valid) {
+        dec->baseline = x;
+        dec->baseline_valid = true;
+        return;
+    }
+
+    float deviation = fabsf(x - dec->baseline);
+
+    if (!dec->in_tooth) {
+        if (deviation > dec->config.hysteresis_lsb) {
+            dec->in_tooth = true;
+            Decoder_OnRise(dec, start_tick);
+        } else {
+            dec->baseline += (x - dec->baseline) / (1 << BASELINE_SHIFT);
+        }
+    } else if (deviation <= dec->config.hysteresis_lsb / 2) {
+        dec->in_tooth = false;
+        dec->last_fall = start_tick;
+        dec->have_fall = true;
+    }
+}
+
+/**
+  * @brief  Mean per-revolution RPM error
+  * @param  dec: Decoder
+  * @retval Mean absolute error in percent, 0 if no revolution completed
+  */
+double VR_Decoder_MeanRevErrorPct(const VR_Decoder_t *dec)
+{
+    if (dec->stats.revolutions == 0) {
+        return 0.0;
+    }
+    return dec->stats.rev_err_sum_pct / dec->stats.revolutions;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Handle a tooth leading edge
+  * @param  dec: Decoder
+  * @param  tick: Edge time in TIM6 ticks
+  * @retval None
+  */
+static void Decoder_OnRise(VR_Decoder_t *dec, uint64_t tick)
+{
+    VR_DecoderStats_t *st = &dec->stats;
+    bool sync_gap = false;
+
+    st->teeth++;
+
+    if (dec->have_fall) {
+        uint64_t gap = tick - dec->last_fall;
+        if (dec->prev_gap > 0 && (float)gap < dec->config.gap_ratio * (float)dec->prev_gap) {
+            sync_gap = true;
+            st->sync_gaps++;
+        }
+        dec->prev_gap = gap;
+    }
+
+    if (dec->have_rise) {
+        uint64_t period = tick - dec->last_rise;
+        dec->rpm = 60.0f * VR_SAMPLE_TIMER_BASE_FREQ / ((float)period * TRIGGER_WHEEL_TEETH);
+
+        if (dec->synced && dec->config.commanded_rpm > 0.0f) {
+            double err = Decoder_ErrorPct(dec->rpm, dec->config.commanded_rpm);
+            st->tooth_samples++;
+            if (err > st->tooth_err_max_pct) {
+                st->tooth_err_max_pct = err;
+            }
+        }
+    }
+
+    // Advance the tooth counter and check it against the sync gap
+    if (dec->synced) {
+        dec->tooth_index = (uint8_t)((dec->tooth_index + 1) % TRIGGER_WHEEL_TEETH);
+
+        if (sync_gap != (dec->tooth_index == 0)) {
+            st->sync_losses++;
+            dec->synced = sync_gap;
+        } else if (sync_gap) {
+            st->revolutions++;
+            if (dec->config.commanded_rpm > 0.0f) {
+                float rev_rpm = 60.0f * VR_SAMPLE_TIMER_BASE_FREQ / (float)(tick - dec->rev_start);
+                double err = Decoder_ErrorPct(rev_rpm, dec->config.commanded_rpm);
+                st->rev_err_sum_pct += err;
+                if (err > st->rev_err_max_pct) {
+                    st->rev_err_max_pct = err;
+                }
+            }
+        }
+    } else if (sync_gap) {
+        dec->synced = true;
+        if (st->first_sync_tick == 0) {
+            st->first_sync_tick = tick;
+        }
+    }
+
+    if (sync_gap) {
+        dec->tooth_index = 0;
+        dec->rev_start = tick;
+    }
+
+    dec->last_rise = tick;
+    dec->have_rise = true;
+}
+
+static double Decoder_ErrorPct(float measured_rpm, float commanded_rpm)
+{
+    return fabs((double)measured_rpm - commanded_rpm) / commanded_rpm * 100.0;
+}
@@ -0,0 +1,320 @@
+/**
+  ******************************************************************************
+  * @file           : vr_export.c
+  * @brief          : Streaming waveform export
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The DAC holds each written value until the next TIM6 update, so the
+  * pin voltage is a zero-order hold of the emulator samples. The exporter
+  * samples that held level on a fixed output grid; at the default rate of
+  * VR_SAMPLE_TIMER_BASE_FREQ every DAC update lands exactly on a sample.
+  *
+  * Output is staged in one fixed buffer and written in large blocks, so
+  * memory use is constant regardless of export length.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_export.h"
+#include "vr_sensor_emulator.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define WAV_HEADER_SIZE             44
+#define CSV_MAX_LINE                48
+
+/* Private function prototypes -----------------------------------------------*/
+static void Export_Flush(VR_Exporter_t *ex);
+static void Export_WriteSample(VR_Exporter_t *ex, uint64_t index, uint16_t dac_value);
+static size_t Export_FormatCSV(char *out, uint64_t index, uint32_t sample_rate, uint16_t dac_value);
+static void Export_WriteWavHeader(VR_Exporter_t *ex);
+static void Put_LE16(uint8_t *p, uint16_t v);
+static void Put_LE32(uint8_t *p, uint32_t v);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Convert a format name to a format identifier
+  * @param  name: "wav", "raw" or "csv"
+  * @param  format: Receives the format
+  * @retval True if the name is known
+  */
+bool VR_Export_ParseFormat(const char *name, VR_ExportFormat_t *format)
+{
+    if (strcmp(name, "wav") == 0) {
+        *format = VR_EXPORT_WAV;
+    } else if (strcmp(name, "raw") == 0) {
+        *format = VR_EXPORT_RAW;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = VR_EXPORT_CSV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+  * @brief  Open an export file
+  * @param  ex: Exporter to initialise
+  * @param  path: Output file path
+  * @param  format: Output format
+  * @param  sample_rate: Output sample rate in Hz
+  * @retval True on success
+  */
+bool VR_Export_Open(VR_Exporter_t *ex, const char *path, VR_ExportFormat_t format, uint32_t sample_rate)
+{
+    memset(ex, 0, sizeof(*ex));
+
+    if (sample_rate == 0) {
+        return false;
+    }
+
+    ex->buffer = malloc(VR_EXPORT_BUFFER_SIZE);
+    if (ex->buffer == NULL) {
+        return false;
+    }
+
+    ex->file = fopen(path, "wb");
+    if (ex->file == NULL) {
+        free(ex->buffer);
+        ex->buffer = NULL;
+        return false;
+    }
+
+    // Our own buffer already batches writes; stdio buffering would only copy twice
+    setvbuf(ex->file, NULL, _IONBF, 0);
+
+    ex->format = format;
+    ex->sample_rate = sample_rate;
+
+    if (format == VR_EXPORT_WAV) {
+        // Placeholder header, sizes are patched in VR_Export_Close()
+        Export_WriteWavHeader(ex);
+    } else if (format == VR_EXPORT_CSV) {
+        static const char header[] = "time_s,dac_code,voltage_v\n";
+        memcpy(ex->buffer, header, sizeof(header) - 1);
+        ex->used = sizeof(header) - 1;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Sample sink for VR_HostSim_Run()
+  * @param  ctx: Exporter
+  * @param  dac_value: DAC level held on the pin
+  * @param  start_tick: First TIM6 tick of the level
+  * @param  num_ticks: Number of ticks the level is held
+  * @retval None
+  */
+void VR_Export_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    VR_Exporter_t *ex = (VR_Exporter_t *)ctx;
+    uint64_t end_tick = start_tick + num_ticks;
+
+    if (ex->sample_rate == VR_SAMPLE_TIMER_BASE_FREQ) {
+        // One output sample per tick, no rate conversion needed
+        for (uint32_t i = 0; i < num_ticks; i++) {
+            Export_WriteSample(ex, ex->next_sample++, dac_value);
+        }
+        return;
+    }
+
+    // Sample k lies at k * TICK_FREQ / rate ticks; emit all samples before end_tick
+    while (ex->next_sample * VR_SAMPLE_TIMER_BASE_FREQ < end_tick * ex->sample_rate) {
+        Export_WriteSample(ex, ex->next_sample++, dac_value);
+    }
+}
+
+/**
+  * @brief  Flush pending data, finalise headers and close the file
+  * @param  ex: Exporter
+  * @retval True if every write succeeded
+  */
+bool VR_Export_Close(VR_Exporter_t *ex)
+{
+    if (ex->file == NULL) {
+        return false;
+    }
+
+    Export_Flush(ex);
+
+    if (ex->format == VR_EXPORT_WAV && !ex->error) {
+        // RIFF sizes are 32-bit; longer exports keep a saturated header
+        if (fseeko(ex->file, 0, SEEK_SET) == 0) {
+            Export_WriteWavHeader(ex);
+            Export_Flush(ex);
+        } else {
+            ex->error = true;
+        }
+    }
+
+    if (fclose(ex->file) != 0) {
+        ex->error = true;
+    }
+
+    free(ex->buffer);
+    ex->buffer = NULL;
+    ex->file = NULL;
+
+    return !ex->error;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Write the staging buffer to the file
+  * @param  ex: Exporter
+  * @retval None
+  */
+static void Export_Flush(VR_Exporter_t *ex)
+{
+    if (ex->used > 0 && fwrite(ex->buffer, 1, ex->used, ex->file) != ex->used) {
+        ex->error = true;
+    }
+    ex->used = 0;
+}
+
+/**
+  * @brief  Append one output sample in the selected format
+  * @param  ex: Exporter
+  * @param  index: Output sample index
+  * @param  dac_value: DAC code
+  * @retval None
+  */
+static void Export_WriteSample(VR_Exporter_t *ex, uint64_t index, uint16_t dac_value)
+{
+    if (ex->used + CSV_MAX_LINE > VR_EXPORT_BUFFER_SIZE) {
+        Export_Flush(ex);
+    }
+
+    uint8_t *p = ex->buffer + ex->used;
+
+    switch (ex->format) {
+    case VR_EXPORT_WAV:
+        // 12-bit unsigned DAC code to 16-bit signed PCM around mid-scale
+        Put_LE16(p, (uint16_t)(int16_t)(((int32_t)dac_value - DAC_RESOLUTION / 2) * 16));
+        ex->used += 2;
+        ex->data_bytes += 2;
+        break;
+
+    case VR_EXPORT_RAW:
+        Put_LE16(p, dac_value);
+        ex->used += 2;
+        ex->data_bytes += 2;
+        break;
+
+    case VR_EXPORT_CSV: {
+        size_t len = Export_FormatCSV((char *)p, index, ex->sample_rate, dac_value);
+        ex->used += len;
+        ex->data_bytes += len;
+        break;
+    }
+    }
+}
+
+/**
+  * @brief  Format one CSV line without printf
+  * @param  out: Destination, at least CSV_MAX_LINE bytes
+  * @param  index: Output sample index
+  * @param  sample_rate: Output sample rate in Hz
+  * @param  dac_value: DAC code
+  * @retval Number of characters written
+  */
+static size_t Export_FormatCSV(char *out, uint64_t index, uint32_t sample_rate, uint16_t dac_value)
+{
+    char tmp[24];
+    size_t len = 0;
+    int n;
+
+    // Exact timestamp: whole seconds plus nanoseconds from the remainder
+    uint64_t secs = index / sample_rate;
+    uint64_t ns = (index % sample_rate) * 1000000000ull / sample_rate;
+
+    n = 0;
+    do {
+        tmp[n++] = (char)('0' + secs % 10);
+        secs /= 10;
+    } while (secs > 0);
+    while (n > 0) {
+        out[len++] = tmp[--n];
+    }
+
+    out[len++] = '.';
+    for (int i = 8; i >= 0; i--) {
+        out[len + i] = (char)('0' + ns % 10);
+        ns /= 10;
+    }
+    len += 9;
+    out[len++] = ',';
+
+    uint32_t code = dac_value;
+    n = 0;
+    do {
+        tmp[n++] = (char)('0' + code % 10);
+        code /= 10;
+    } while (code > 0);
+    while (n > 0) {
+        out[len++] = tmp[--n];
+    }
+    out[len++] = ',';
+
+    // Voltage with four decimals
+    uint32_t volts_e4 = ((uint32_t)dac_value * 33000u + DAC_RESOLUTION / 2) / DAC_RESOLUTION;
+    out[len++] = (char)('0' + volts_e4 / 10000);
+    out[len++] = '.';
+    out[len++] = (char)('0' + (volts_e4 / 1000) % 10);
+    out[len++] = (char)('0' + (volts_e4 / 100) % 10);
+    out[len++] = (char)('0' + (volts_e4 / 10) % 10);
+    out[len++] = (char)('0' + volts_e4 % 10);
+    out[len++] = '\n';
+
+    return len;
+}
+
+/**
+  * @brief  Stage a canonical 44-byte PCM WAV header
+  * @param  ex: Exporter
+  * @retval None
+  */
+static void Export_WriteWavHeader(VR_Exporter_t *ex)
+{
+    uint8_t *h = ex->buffer + ex->used;
+    uint32_t data_size = (ex->data_bytes > 0xFFFFFFFFull - WAV_HEADER_SIZE) ?
+                         (uint32_t)(0xFFFFFFFFull - WAV_HEADER_SIZE) : (uint32_t)ex->data_bytes;
+
+    memcpy(h + 0, "RIFF", 4);
+    Put_LE32(h + 4, data_size + WAV_HEADER_SIZE - 8);
+    memcpy(h + 8, "WAVE", 4);
+    memcpy(h + 12, "fmt ", 4);
+    Put_LE32(h + 16, 16);                       // PCM fmt chunk size
+    Put_LE16(h + 20, 1);                        // PCM
+    Put_LE16(h + 22, 1);                        // Mono
+    Put_LE32(h + 24, ex->sample_rate);
+    Put_LE32(h + 28, ex->sample_rate * 2);      // Byte rate
+    Put_LE16(h + 32, 2);                        // Block align
+    Put_LE16(h + 34, 16);                       // Bits per sample
+    memcpy(h + 36, "data", 4);
+    Put_LE32(h + 40, data_size);
+
+    ex->used += WAV_HEADER_SIZE;
+}
+
+static void Put_LE16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void Put_LE32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
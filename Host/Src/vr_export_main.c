@@ -0,0 +1,176 @@
+/**
+  ******************************************************************************
+  * @file           : vr_export_main.c
+  * @brief          : Command line front end for waveform export
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Usage: vr_export -p PROFILE|-c SCENARIO -o FILE [-f wav|raw|csv] [-r RATE] [-d SECONDS]
+  *                  [-j THREADS] [-s SHAPE]
+  *
+  *   -p  RPM profile "t0:rpm0,t1:rpm1,..." (seconds:RPM, linear ramps)
+  *   -c  Scenario file (vr_scenario_compiler.c) in place of a profile. The
+  *       run lasts the scenario and is rendered on one thread, as the
+  *       firmware would play it.
+  *   -o  Output file
+  *   -f  Output format (default wav)
+  *   -r  Output sample rate in Hz (default 100000, the TIM6 tick rate)
+  *   -d  Duration in seconds (default: time of the last profile point)
+  *   -j  Render 1 s chunks on this many threads (default 1). The output is
+  *       bit-identical to a single-threaded render.
+  *   -s  Tooth shape file: "regular" and "missing" tables of levels from
+  *       the DC level in DAC codes, as for the SHAPE command; a scenario's
+  *       shape table 1
+  *
+  * Example: vr_export -p 0:800,10:6000,20:6000 -f wav -o ramp.wav
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_host_sim.h"
+#include "vr_export.h"
+#include "vr_scenario_compiler.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Private variables ---------------------------------------------------------*/
+static VR_Profile_t profile;
+static VR_Exporter_t exporter;
+static VR_ToothShape_t shape;
+static VR_Scenario_t scenario;
+static VR_Emulator_t scenario_emu;
+static uint32_t scenario_image[VR_SCENARIO_IMAGE_MAX / sizeof(uint32_t)];
+
+/* Private function prototypes -----------------------------------------------*/
+static void Print_Usage(const char *prog);
+
+/**
+  * @brief  Export entry point
+  * @retval Process exit code
+  */
+int main(int argc, char *argv[])
+{
+    const char *profile_text = NULL;
+    const char *out_path = NULL;
+    VR_ExportFormat_t format = VR_EXPORT_WAV;
+    uint32_t sample_rate = VR_SAMPLE_TIMER_BASE_FREQ;
+    double duration_s = -1.0;
+    uint32_t threads = 1;
+    const char *shape_path = NULL;
+    const char *scenario_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:c:o:f:r:d:j:s:h")) != -1) {
+        switch (opt) {
+        case 'p': profile_text = optarg; break;
+        case 'c': scenario_path = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'f':
+            if (!VR_Export_ParseFormat(optarg, &format)) {
+                fprintf(stderr, "Unknown format '%s'\n", optarg);
+                return 2;
+            }
+            break;
+        case 'r': sample_rate = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'd': duration_s = strtod(optarg, NULL); break;
+        case 'j': threads = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 's': shape_path = optarg; break;
+        default:
+            Print_Usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if ((profile_text == NULL) == (scenario_path == NULL) || out_path == NULL) {
+        Print_Usage(argv[0]);
+        return 2;
+    }
+
+    if (profile_text != NULL && !VR_Profile_Parse(&profile, profile_text)) {
+        fprintf(stderr, "Invalid profile '%s'\n", profile_text);
+        return 2;
+    }
+
+    if (shape_path != NULL) {
+        if (!VR_HostSim_LoadShape(&shape, shape_path)) {
+            fprintf(stderr, "Invalid shape file '%s'\n", shape_path);
+            return 2;
+        }
+        VR_HostSim_SetShape(&shape);
+    }
+
+    if (scenario_path != NULL) {
+        const VR_ToothShape_t *tables[1] = {&shape};
+        VR_ScenarioError_t error;
+        uint32_t size;
+
+        if (!VR_Scenario_CompileFile(scenario_path, scenario_image, sizeof(scenario_image), &size, &error)) {
+            fprintf(stderr, "%s:%lu: %s\n", scenario_path, (unsigned long)error.line, error.message);
+            return 2;
+        }
+        if (!VR_Scenario_Load(&scenario, scenario_image, size, tables, (shape_path != NULL) ? 1 : 0)) {
+            fprintf(stderr, "Scenario '%s' selects a shape table not given with -s\n", scenario_path);
+            return 2;
+        }
+        duration_s = (double)scenario.duration / VR_SAMPLE_TIMER_BASE_FREQ;
+    } else if (duration_s < 0.0) {
+        duration_s = VR_Profile_Duration(&profile);
+    }
+    uint64_t duration_ticks = (uint64_t)(duration_s * VR_SAMPLE_TIMER_BASE_FREQ + 0.5);
+
+    if (!VR_Export_Open(&exporter, out_path, format, sample_rate)) {
+        fprintf(stderr, "Cannot open '%s' for writing\n", out_path);
+        return 1;
+    }
+
+    struct timespec start, end;
+    uint64_t dac_samples;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (scenario_path != NULL) {
+        dac_samples = VR_HostSim_RunScenario(&scenario_emu, &scenario, VR_Export_Sink, &exporter);
+    } else if (threads > 1) {
+        dac_samples = VR_HostSim_RunParallel(&profile, duration_ticks, VR_HOST_CONTROL_PERIOD_TICKS,
+                                             threads, VR_HOST_CHUNK_TICKS, VR_Export_Sink, &exporter);
+    } else {
+        dac_samples = VR_HostSim_Run(&profile, duration_ticks, VR_HOST_CONTROL_PERIOD_TICKS,
+                                     VR_Export_Sink, &exporter);
+    }
+    uint64_t out_samples = exporter.next_sample;
+    uint64_t out_bytes = exporter.data_bytes;
+
+    if (!VR_Export_Close(&exporter)) {
+        fprintf(stderr, "Write error on '%s'\n", out_path);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    printf("Rendered %.3f s: %llu DAC updates, %llu output samples at %lu Hz, %llu bytes in %.2f s\n",
+           duration_s, (unsigned long long)dac_samples, (unsigned long long)out_samples,
+           (unsigned long)sample_rate, (unsigned long long)out_bytes, elapsed);
+
+    return 0;
+}
+
+/**
+  * @brief  Print command line help
+  * @param  prog: Program name
+  * @retval None
+  */
+static void Print_Usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s -p PROFILE|-c SCENARIO -o FILE [-f wav|raw|csv] [-r RATE] [-d SECONDS] [-j THREADS]\n"
+            "          [-s SHAPE]\n"
+            "  PROFILE   t0:rpm0,t1:rpm1,... (seconds:RPM, linear ramps between points)\n"
+            "  SCENARIO  Scenario file, one timed event per line (rpm, ramp, shape, fault, gain, noise, end)\n"
+            "  SHAPE     Tooth shape file (\"regular\" and \"missing\" level tables)\n",
+            prog);
+}
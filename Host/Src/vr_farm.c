@@ -0,0 +1,495 @@
+/**
+  ******************************************************************************
+  * @file           : vr_farm.c
+  * @brief          : Multi-threaded simulation farm
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Scheduling: the scenario list is split into one contiguous range per
+  * worker. A worker takes scenarios from the front of its own range; when
+  * it runs dry it steals the back half of another worker's range. Work is
+  * only ever moved between ranges, never created, so a worker that finds
+  * every range empty can exit. Each range has its own lock, which is only
+  * contended while a steal is in progress.
+  *
+  * Isolation: each scenario is compiled into a sequencer image (speed
+  * pattern, noise and fault window as timed events) and played on its own
+  * VR_Emulator_t through VR_HostSim_RunScenario(), as the target plays a
+  * scenario. The sink and decoder on the worker's stack only observe the
+  * output. Results go to the scenario's own slot, and worker statistics to
+  * the worker's own record, so threads share no mutable state apart from
+  * the range locks. Results are therefore identical for
+  * any thread count, and are combined in scenario order at the end.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_farm.h"
+#include "vr_host_sim.h"
+#include "vr_sensor_emulator.h"
+#include "vr_scenario.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Per-worker queue and statistics, padded to a cache line of its own */
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t head;                  // Next scenario for the owner
+    uint32_t tail;                  // One past the last scenario; thieves take from here
+    VR_FarmWorkerStats_t stats;
+    pthread_t thread;
+} __attribute__((aligned(64))) Farm_Worker_t;
+
+typedef struct {
+    const VR_FarmScenario_t *scenarios;
+    VR_FarmResult_t *results;
+    Farm_Worker_t *workers;
+    uint32_t threads;
+} Farm_Pool_t;
+
+typedef struct {
+    Farm_Pool_t *pool;
+    uint32_t index;
+} Farm_WorkerArg_t;
+
+typedef struct {
+    VR_Decoder_t decoder;
+    uint32_t checksum;
+} Farm_Sink_t;
+
+/* Compiled scenario: two speed events, noise and a fault window at most */
+typedef struct {
+    VR_ScenarioHeader_t header;
+    VR_ScenarioEvent_t events[5];
+} Farm_Image_t;
+
+/* Private define ------------------------------------------------------------*/
+#define FNV_OFFSET                  2166136261u
+#define FNV_PRIME                   16777619u
+#define FARM_DROPOUT_AT             0.4     // Fraction of the run
+#define FARM_SPIKE_AT               0.5
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const farm_pattern_names[VR_FARM_NUM_PATTERNS] = {
+    "fixed", "ramp_up", "ramp_down", "stop_start"
+};
+static const VR_Fault_t farm_faults[VR_FARM_NUM_FAULTS] = {
+    VR_FAULT_NONE, VR_FAULT_DROPOUT, VR_FAULT_SPIKE
+};
+
+static const char *const farm_fault_names[VR_FARM_NUM_FAULTS] = {
+    "none", "dropout", "spike"
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static void *Farm_WorkerMain(void *arg);
+static bool Farm_Take(Farm_Worker_t *worker, uint32_t *index);
+static bool Farm_Steal(Farm_Pool_t *pool, uint32_t self);
+static uint32_t Farm_BuildImage(const VR_FarmScenario_t *scenario, Farm_Image_t *image);
+static void Farm_AddEvent(Farm_Image_t *image, uint64_t tick, VR_ScenarioKind_t kind, int32_t value,
+                          uint32_t span, uint8_t arg);
+static void Farm_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+static uint32_t Farm_Hash(uint32_t hash, uint32_t value);
+static double Farm_Now(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Expand a campaign into its scenarios
+  * @param  campaign: RPM range, pattern and fault masks, noise seeds
+  * @param  scenarios: Destination, may be NULL to count only
+  * @param  max: Capacity of scenarios
+  * @retval Number of scenarios in the campaign (may exceed max)
+  */
+uint32_t VR_Farm_BuildCampaign(const VR_FarmCampaign_t *campaign, VR_FarmScenario_t *scenarios, uint32_t max)
+{
+    uint32_t count = 0;
+    uint32_t seeds = (campaign->noise_seeds > 0) ? campaign->noise_seeds : 1;
+    uint32_t step = (campaign->step_rpm > 0) ? campaign->step_rpm : 1;
+
+    for (uint32_t rpm = campaign->start_rpm; rpm <= campaign->end_rpm; rpm += step) {
+        for (uint32_t p = 0; p < VR_FARM_NUM_PATTERNS; p++) {
+            if ((campaign->pattern_mask & (1u << p)) == 0) {
+                continue;
+            }
+            for (uint32_t f = 0; f < VR_FARM_NUM_FAULTS; f++) {
+                if ((campaign->fault_mask & (1u << f)) == 0) {
+                    continue;
+                }
+                for (uint32_t s = 0; s < seeds; s++) {
+                    if (scenarios != NULL && count < max) {
+                        VR_FarmScenario_t *sc = &scenarios[count];
+                        sc->rpm = (uint16_t)rpm;
+                        sc->pattern = (VR_FarmPattern_t)p;
+                        sc->fault = (VR_FarmFault_t)f;
+                        sc->noise_seed = (campaign->noise_seeds > 0) ? s + 1 : 0;
+                        sc->noise_lsb = campaign->noise_lsb;
+                        sc->duration_s = campaign->duration_s;
+                    }
+                    count++;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+  * @brief  Render and decode one scenario on the calling thread
+  * @param  scenario: Scenario to run
+  * @param  result: Receives samples, checksum, decoder statistics and wall time
+  * @retval None
+  */
+void VR_Farm_RunScenario(const VR_FarmScenario_t *scenario, VR_FarmResult_t *result)
+{
+    VR_Emulator_t emu;
+    VR_Scenario_t player;
+    Farm_Image_t image;
+    Farm_Sink_t sink;
+    VR_DecoderConfig_t config = {
+        VR_DECODER_DEFAULT_HYSTERESIS, VR_DECODER_DEFAULT_GAP_RATIO,
+        (scenario->pattern == VR_FARM_PATTERN_FIXED) ? (float)scenario->rpm : 0.0f
+    };
+    double start = Farm_Now();
+
+    memset(&sink, 0, sizeof(sink));
+    VR_Decoder_Init(&sink.decoder, &config);
+    sink.checksum = FNV_OFFSET;
+
+    // A rejected image renders nothing, so it shows up as an empty result
+    uint32_t size = Farm_BuildImage(scenario, &image);
+    result->samples = VR_Scenario_Load(&player, &image, size, NULL, 0)
+                    ? VR_HostSim_RunScenario(&emu, &player, Farm_Sink, &sink) : 0;
+    result->checksum = sink.checksum;
+    result->decoder = sink.decoder.stats;
+    result->wall_s = Farm_Now() - start;
+}
+
+/**
+  * @brief  Run scenarios on a work-stealing thread pool
+  * @param  scenarios: Scenarios to run
+  * @param  count: Number of scenarios
+  * @param  threads: Worker threads (1 to VR_FARM_MAX_THREADS)
+  * @param  results: One result per scenario, in scenario order
+  * @param  summary: Aggregated totals and per-worker statistics
+  * @retval True if every worker was started
+  */
+bool VR_Farm_Run(const VR_FarmScenario_t *scenarios, uint32_t count, uint32_t threads,
+                 VR_FarmResult_t *results, VR_FarmSummary_t *summary)
+{
+    Farm_Worker_t workers[VR_FARM_MAX_THREADS];
+    Farm_WorkerArg_t args[VR_FARM_MAX_THREADS];
+    Farm_Pool_t pool = {scenarios, results, workers, 0};
+    uint32_t started = 0;
+    bool ok = true;
+
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > VR_FARM_MAX_THREADS) {
+        threads = VR_FARM_MAX_THREADS;
+    }
+    pool.threads = threads;
+
+    // Contiguous initial split; stealing evens out the cost differences
+    for (uint32_t i = 0; i < threads; i++) {
+        memset(&workers[i].stats, 0, sizeof(workers[i].stats));
+        pthread_mutex_init(&workers[i].lock, NULL);
+        workers[i].head = (uint32_t)((uint64_t)count * i / threads);
+        workers[i].tail = (uint32_t)((uint64_t)count * (i + 1) / threads);
+        args[i].pool = &pool;
+        args[i].index = i;
+    }
+
+    double start = Farm_Now();
+
+    // Worker 0 is the calling thread
+    for (uint32_t i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, Farm_WorkerMain, &args[i]) != 0) {
+            ok = false;
+            break;
+        }
+        started++;
+    }
+    Farm_WorkerMain(&args[0]);
+    for (uint32_t i = 1; i <= started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    // A worker that failed to start left its range to be stolen, so every
+    // scenario has still run once the remaining workers exit
+    memset(summary, 0, sizeof(*summary));
+    summary->wall_s = Farm_Now() - start;
+    summary->threads = threads;
+    summary->scenarios = count;
+    summary->checksum = FNV_OFFSET;
+
+    for (uint32_t i = 0; i < count; i++) {
+        summary->samples += results[i].samples;
+        summary->busy_s += results[i].wall_s;
+        summary->checksum = Farm_Hash(summary->checksum, results[i].checksum);
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        summary->workers[i] = workers[i].stats;
+        pthread_mutex_destroy(&workers[i].lock);
+    }
+
+    return ok;
+}
+
+/**
+  * @brief  Number of worker threads to use by default
+  * @retval Online CPU count, at least 1 and at most VR_FARM_MAX_THREADS
+  */
+uint32_t VR_Farm_DefaultThreads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus < 1) {
+        return 1;
+    }
+    return (cpus > VR_FARM_MAX_THREADS) ? VR_FARM_MAX_THREADS : (uint32_t)cpus;
+}
+
+/**
+  * @brief  Get the name of a pattern
+  * @param  pattern: Pattern
+  * @retval Name, "?" if out of range
+  */
+const char *VR_Farm_PatternName(VR_FarmPattern_t pattern)
+{
+    return (pattern < VR_FARM_NUM_PATTERNS) ? farm_pattern_names[pattern] : "?";
+}
+
+/**
+  * @brief  Get the name of a fault
+  * @param  fault: Fault
+  * @retval Name, "?" if out of range
+  */
+const char *VR_Farm_FaultName(VR_FarmFault_t fault)
+{
+    return (fault < VR_FARM_NUM_FAULTS) ? farm_fault_names[fault] : "?";
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Worker loop: drain the own range, then steal until all are empty
+  * @param  arg: Farm_WorkerArg_t
+  * @retval NULL
+  */
+static void *Farm_WorkerMain(void *arg)
+{
+    Farm_WorkerArg_t *wa = (Farm_WorkerArg_t *)arg;
+    Farm_Pool_t *pool = wa->pool;
+    Farm_Worker_t *self = &pool->workers[wa->index];
+    uint32_t index;
+
+    for (;;) {
+        while (Farm_Take(self, &index)) {
+            VR_FarmResult_t *result = &pool->results[index];
+
+            VR_Farm_RunScenario(&pool->scenarios[index], result);
+            result->worker = wa->index;
+            self->stats.executed++;
+            self->stats.busy_s += result->wall_s;
+        }
+
+        if (!Farm_Steal(pool, wa->index)) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+  * @brief  Take the next scenario from the front of a worker's range
+  * @param  worker: Owning worker
+  * @param  index: Receives the scenario index
+  * @retval True if a scenario was taken
+  */
+static bool Farm_Take(Farm_Worker_t *worker, uint32_t *index)
+{
+    bool taken = false;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->head < worker->tail) {
+        *index = worker->head++;
+        taken = true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return taken;
+}
+
+/**
+  * @brief  Move the back half of another worker's range to this worker
+  * @param  pool: Thread pool
+  * @param  self: Index of the stealing worker, whose range is empty
+  * @retval True if anything was stolen, false if every range is empty
+  */
+static bool Farm_Steal(Farm_Pool_t *pool, uint32_t self)
+{
+    Farm_Worker_t *thief = &pool->workers[self];
+
+    for (uint32_t n = 1; n < pool->threads; n++) {
+        Farm_Worker_t *victim = &pool->workers[(self + n) % pool->threads];
+        uint32_t first = 0, last = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        uint32_t left = victim->tail - victim->head;
+        if (left > 0) {
+            // Leave the victim the larger half, it is already working on it
+            uint32_t take = (left > 1) ? left / 2 : 1;
+            last = victim->tail;
+            first = last - take;
+            victim->tail = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (last > first) {
+            pthread_mutex_lock(&thief->lock);
+            thief->head = first;
+            thief->tail = last;
+            pthread_mutex_unlock(&thief->lock);
+
+            thief->stats.steals++;
+            thief->stats.stolen += last - first;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+  * @brief  Compile a scenario into a sequencer image
+  * @note   Events are added in time order, as VR_Scenario_Load() requires:
+  *         noise and the speed pattern at the start, a ramp, then the
+  *         fault window
+  * @param  scenario: Scenario
+  * @param  image: Image to fill
+  * @retval Image size in bytes
+  */
+static uint32_t Farm_BuildImage(const VR_FarmScenario_t *scenario, Farm_Image_t *image)
+{
+    uint64_t ticks = (uint64_t)(scenario->duration_s * VR_SAMPLE_TIMER_BASE_FREQ);
+    int32_t rpm = scenario->rpm;
+    uint64_t fault_start = 0, fault_end = 0;
+
+    memset(image, 0, sizeof(*image));
+    image->header.magic = VR_SCENARIO_MAGIC;
+    image->header.version = VR_SCENARIO_VERSION;
+    image->header.duration = (uint32_t)ticks;
+
+    // Noise from the first update, so every rendered level carries it
+    if (scenario->noise_lsb > 0 && scenario->noise_seed != 0) {
+        Farm_AddEvent(image, 0, VR_SCENARIO_NOISE, scenario->noise_lsb, scenario->noise_seed, 0);
+    }
+
+    switch (scenario->pattern) {
+    case VR_FARM_PATTERN_RAMP_UP:
+        Farm_AddEvent(image, 0, VR_SCENARIO_SPEED, rpm / 4, 0, 0);
+        Farm_AddEvent(image, 0, VR_SCENARIO_RAMP, rpm, (uint32_t)ticks, 0);
+        break;
+    case VR_FARM_PATTERN_RAMP_DOWN:
+        Farm_AddEvent(image, 0, VR_SCENARIO_SPEED, rpm, 0, 0);
+        Farm_AddEvent(image, 0, VR_SCENARIO_RAMP, rpm / 4, (uint32_t)ticks, 0);
+        break;
+    case VR_FARM_PATTERN_STOP_START:
+        // Stopped for the first 20%, then a ramp to full speed by 40%
+        Farm_AddEvent(image, 0, VR_SCENARIO_SPEED, 0, 0, 0);
+        Farm_AddEvent(image, (uint64_t)(ticks * 0.2), VR_SCENARIO_RAMP, rpm, (uint32_t)(ticks * 0.2), 0);
+        break;
+    case VR_FARM_PATTERN_FIXED:
+    default:
+        Farm_AddEvent(image, 0, VR_SCENARIO_SPEED, rpm, 0, 0);
+        break;
+    }
+
+    if (scenario->fault == VR_FARM_FAULT_DROPOUT && scenario->rpm > 0) {
+        fault_start = (uint64_t)(ticks * FARM_DROPOUT_AT);
+        fault_end = fault_start + (uint64_t)(60.0 * VR_SAMPLE_TIMER_BASE_FREQ / scenario->rpm);
+    } else if (scenario->fault == VR_FARM_FAULT_SPIKE) {
+        fault_start = (uint64_t)(ticks * FARM_SPIKE_AT);
+        fault_end = fault_start + 1;
+    }
+    if (fault_end > fault_start && fault_start < ticks) {
+        Farm_AddEvent(image, fault_start, VR_SCENARIO_FAULT, 0, 0, (uint8_t)farm_faults[scenario->fault]);
+        Farm_AddEvent(image, (fault_end < ticks) ? fault_end : ticks, VR_SCENARIO_FAULT, 0, 0, VR_FAULT_NONE);
+    }
+
+    return VR_SCENARIO_IMAGE_SIZE(image->header.count);
+}
+
+/**
+  * @brief  Append one event to a scenario image
+  * @param  image: Image being built
+  * @param  tick: TIM6 ticks from the start
+  * @param  kind: VR_ScenarioKind_t
+  * @param  value: See VR_ScenarioKind_t
+  * @param  span: See VR_ScenarioKind_t
+  * @param  arg: See VR_ScenarioKind_t
+  * @retval None
+  */
+static void Farm_AddEvent(Farm_Image_t *image, uint64_t tick, VR_ScenarioKind_t kind, int32_t value,
+                          uint32_t span, uint8_t arg)
+{
+    VR_ScenarioEvent_t *event = &image->events[image->header.count++];
+
+    event->tick = (uint32_t)tick;
+    event->span = span;
+    event->value = (int16_t)value;
+    event->kind = (uint8_t)kind;
+    event->arg = arg;
+}
+
+/**
+  * @brief  Hash and decode one held level
+  * @param  ctx: Farm_Sink_t
+  * @param  dac_value: DAC level
+  * @param  start_tick: Tick at which the level appears on the pin
+  * @param  num_ticks: Ticks the level is held
+  * @retval None
+  */
+static void Farm_Sink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    Farm_Sink_t *sink = (Farm_Sink_t *)ctx;
+
+    sink->checksum = Farm_Hash(sink->checksum, dac_value);
+    VR_Decoder_Sink(&sink->decoder, dac_value, start_tick, num_ticks);
+}
+
+/**
+  * @brief  Fold a value into an FNV-1a hash, one byte at a time
+  * @param  hash: Running hash
+  * @param  value: Value to add
+  * @retval Updated hash
+  */
+static uint32_t Farm_Hash(uint32_t hash, uint32_t value)
+{
+    for (uint32_t i = 0; i < 4; i++) {
+        hash = (hash ^ ((value >> (8 * i)) & 0xFFu)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+  * @brief  Monotonic time
+  * @retval Seconds
+  */
+static double Farm_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
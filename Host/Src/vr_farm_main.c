@@ -0,0 +1,254 @@
+/**
+  ******************************************************************************
+  * @file           : vr_farm_main.c
+  * @brief          : Command line front end for the simulation farm
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Usage: vr_farm [-j THREADS] [-r START:END:STEP] [-s SEEDS] [-n LSB]
+  *                [-d SECONDS] [-o FILE] [-S]
+  *
+  *   -j  Worker threads (default: online CPUs)
+  *   -r  RPM range (default 500:13000:500)
+  *   -s  Noise seeds per RPM/pattern/fault combination (default 4, 0 = none)
+  *   -n  Peak additive noise in DAC LSB (default 8)
+  *   -d  Scenario length in seconds (default 0.5)
+  *   -o  Write one CSV line per scenario, including its wall time
+  *   -S  Scaling run: repeat the campaign at 1, 2, 4 ... THREADS workers
+  *
+  * Every pattern and fault is rendered for each RPM and seed.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_farm.h"
+#include "vr_sensor_emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Private define ------------------------------------------------------------*/
+#define FARM_SLOWEST_SHOWN          5
+
+/* Private function prototypes -----------------------------------------------*/
+static void Print_Usage(const char *prog);
+static void Print_Summary(const VR_FarmScenario_t *scenarios, const VR_FarmResult_t *results,
+                          const VR_FarmSummary_t *summary);
+static bool Write_CSV(const char *path, const VR_FarmScenario_t *scenarios, const VR_FarmResult_t *results,
+                      uint32_t count);
+
+/**
+  * @brief  Farm entry point
+  * @retval Process exit code
+  */
+int main(int argc, char *argv[])
+{
+    VR_FarmCampaign_t campaign = {
+        500, 13000, 500, VR_FARM_ALL_PATTERNS, VR_FARM_ALL_FAULTS, 4, 8, 0.5
+    };
+    uint32_t threads = VR_Farm_DefaultThreads();
+    const char *csv_path = NULL;
+    bool scaling = false;
+    unsigned start, end, step;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:r:s:n:d:o:Sh")) != -1) {
+        switch (opt) {
+        case 'j': threads = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'r':
+            if (sscanf(optarg, "%u:%u:%u", &start, &end, &step) != 3 || step == 0 || end > MAX_RPM) {
+                fprintf(stderr, "Invalid RPM range '%s'\n", optarg);
+                return 2;
+            }
+            campaign.start_rpm = (uint16_t)start;
+            campaign.end_rpm = (uint16_t)end;
+            campaign.step_rpm = (uint16_t)step;
+            break;
+        case 's': campaign.noise_seeds = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'n': campaign.noise_lsb = (uint16_t)atoi(optarg); break;
+        case 'd': campaign.duration_s = strtod(optarg, NULL); break;
+        case 'o': csv_path = optarg; break;
+        case 'S': scaling = true; break;
+        default:
+            Print_Usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (threads < 1 || threads > VR_FARM_MAX_THREADS || campaign.duration_s <= 0.0) {
+        Print_Usage(argv[0]);
+        return 2;
+    }
+
+    uint32_t count = VR_Farm_BuildCampaign(&campaign, NULL, 0);
+    VR_FarmScenario_t *scenarios = malloc(count * sizeof(*scenarios));
+    VR_FarmResult_t *results = malloc(count * sizeof(*results));
+    VR_FarmSummary_t summary;
+
+    if (count == 0 || scenarios == NULL || results == NULL) {
+        fprintf(stderr, "Empty campaign or out of memory\n");
+        return 1;
+    }
+    VR_Farm_BuildCampaign(&campaign, scenarios, count);
+
+    printf("Campaign: %lu scenarios (%u-%u RPM step %u, %d patterns, %d faults, %lu seeds), %.2f s each\n",
+           (unsigned long)count, campaign.start_rpm, campaign.end_rpm, campaign.step_rpm,
+           VR_FARM_NUM_PATTERNS, VR_FARM_NUM_FAULTS, (unsigned long)campaign.noise_seeds,
+           campaign.duration_s);
+
+    if (scaling) {
+        double base_rate = 0.0;
+        uint32_t base_checksum = 0;
+        bool consistent = true;
+
+        printf("threads  wall (s)  scenarios/s  speedup  efficiency  checksum\n");
+        for (uint32_t n = 1; ; n = (n * 2 > threads && n < threads) ? threads : n * 2) {
+            if (!VR_Farm_Run(scenarios, count, n, results, &summary)) {
+                fprintf(stderr, "Could not start all %lu workers\n", (unsigned long)n);
+            }
+            double rate = summary.scenarios / summary.wall_s;
+            if (n == 1) {
+                base_rate = rate;
+                base_checksum = summary.checksum;
+            }
+            consistent = consistent && (summary.checksum == base_checksum);
+            printf("%7lu  %8.3f  %11.1f  %7.2f  %9.1f%%  %08lx\n",
+                   (unsigned long)n, summary.wall_s, rate, rate / base_rate,
+                   100.0 * rate / base_rate / n, (unsigned long)summary.checksum);
+            if (n >= threads) {
+                break;
+            }
+        }
+        if (!consistent) {
+            printf("Results differ between thread counts\n");
+            return 1;
+        }
+    } else {
+        if (!VR_Farm_Run(scenarios, count, threads, results, &summary)) {
+            fprintf(stderr, "Could not start all %lu workers\n", (unsigned long)threads);
+        }
+        Print_Summary(scenarios, results, &summary);
+    }
+
+    if (csv_path != NULL && !Write_CSV(csv_path, scenarios, results, count)) {
+        fprintf(stderr, "Cannot write %s\n", csv_path);
+        return 1;
+    }
+
+    free(scenarios);
+    free(results);
+    return 0;
+}
+
+/**
+  * @brief  Print totals, per-worker load and the slowest scenarios
+  * @param  scenarios: Campaign
+  * @param  results: Results in scenario order
+  * @param  summary: Run summary
+  * @retval None
+  */
+static void Print_Summary(const VR_FarmScenario_t *scenarios, const VR_FarmResult_t *results,
+                          const VR_FarmSummary_t *summary)
+{
+    uint32_t slowest[FARM_SLOWEST_SHOWN];
+    uint32_t shown = 0;
+    uint32_t sync_losses = 0;
+
+    printf("%lu threads: %.3f s wall, %.3f s rendering, %.1f scenarios/s, %.2f Msamples/s\n",
+           (unsigned long)summary->threads, summary->wall_s, summary->busy_s,
+           summary->scenarios / summary->wall_s, summary->samples / summary->wall_s / 1e6);
+    printf("  parallel efficiency %.1f%%, checksum %08lx\n",
+           100.0 * summary->busy_s / (summary->wall_s * summary->threads),
+           (unsigned long)summary->checksum);
+
+    for (uint32_t i = 0; i < summary->threads; i++) {
+        const VR_FarmWorkerStats_t *w = &summary->workers[i];
+        printf("  worker %2lu: %5lu scenarios (%lu stolen in %lu steals), %.3f s busy\n",
+               (unsigned long)i, (unsigned long)w->executed, (unsigned long)w->stolen,
+               (unsigned long)w->steals, w->busy_s);
+    }
+
+    // Insertion into a short sorted list of the slowest scenarios
+    for (uint32_t i = 0; i < summary->scenarios; i++) {
+        uint32_t pos = shown;
+
+        sync_losses += results[i].decoder.sync_losses;
+        while (pos > 0 && results[slowest[pos - 1]].wall_s < results[i].wall_s) {
+            if (pos < FARM_SLOWEST_SHOWN) {
+                slowest[pos] = slowest[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < FARM_SLOWEST_SHOWN) {
+            slowest[pos] = i;
+            if (shown < FARM_SLOWEST_SHOWN) {
+                shown++;
+            }
+        }
+    }
+
+    printf("  decoder sync losses across campaign: %lu\n", (unsigned long)sync_losses);
+    printf("  slowest scenarios:\n");
+    for (uint32_t i = 0; i < shown; i++) {
+        const VR_FarmScenario_t *sc = &scenarios[slowest[i]];
+        printf("    #%-6lu %5u RPM %-10s %-7s seed %-3lu %.2f ms\n",
+               (unsigned long)slowest[i], sc->rpm, VR_Farm_PatternName(sc->pattern),
+               VR_Farm_FaultName(sc->fault), (unsigned long)sc->noise_seed,
+               results[slowest[i]].wall_s * 1e3);
+    }
+}
+
+/**
+  * @brief  Write one CSV line per scenario
+  * @param  path: Output file
+  * @param  scenarios: Campaign
+  * @param  results: Results in scenario order
+  * @param  count: Number of scenarios
+  * @retval True if the file was written
+  */
+static bool Write_CSV(const char *path, const VR_FarmScenario_t *scenarios, const VR_FarmResult_t *results,
+                      uint32_t count)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    fprintf(f, "id,rpm,pattern,fault,seed,samples,checksum,teeth,revolutions,sync_losses,"
+               "rev_err_max_pct,worker,wall_ms\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const VR_FarmScenario_t *sc = &scenarios[i];
+        const VR_FarmResult_t *r = &results[i];
+        fprintf(f, "%lu,%u,%s,%s,%lu,%llu,%08lx,%lu,%lu,%lu,%.4f,%lu,%.3f\n",
+                (unsigned long)i, sc->rpm, VR_Farm_PatternName(sc->pattern), VR_Farm_FaultName(sc->fault),
+                (unsigned long)sc->noise_seed, (unsigned long long)r->samples, (unsigned long)r->checksum,
+                (unsigned long)r->decoder.teeth, (unsigned long)r->decoder.revolutions,
+                (unsigned long)r->decoder.sync_losses, r->decoder.rev_err_max_pct,
+                (unsigned long)r->worker, r->wall_s * 1e3);
+    }
+
+    return fclose(f) == 0;
+}
+
+/**
+  * @brief  Print command line usage
+  * @param  prog: Program name
+  * @retval None
+  */
+static void Print_Usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-j THREADS] [-r START:END:STEP] [-s SEEDS] [-n LSB] [-d SECONDS] [-o FILE] [-S]\n"
+            "  -j  Worker threads, 1-%d (default: online CPUs)\n"
+            "  -r  RPM range (default 500:13000:500)\n"
+            "  -s  Noise seeds per combination (default 4, 0 = noise-free)\n"
+            "  -n  Peak additive noise in DAC LSB (default 8)\n"
+            "  -d  Scenario length in seconds (default 0.5)\n"
+            "  -o  Per-scenario CSV output\n"
+            "  -S  Scaling run at 1, 2, 4 ... THREADS workers\n",
+            prog, VR_FARM_MAX_THREADS);
+}
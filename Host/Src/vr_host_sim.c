@@ -0,0 +1,774 @@
+/**
+  ******************************************************************************
+  * @file           : vr_host_sim.c
+  * @brief          : VR emulator host simulator
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * The simulator replaces the NVIC and TIM6 with a virtual tick counter.
+  * Every TIM6 update event runs the sample top half and then its bottom
+  * half, as TIM6_DAC_IRQHandler() and the PendSV it pends do on target,
+  * and the resulting DAC
+  * level is handed to a sink together with the number of ticks it is held
+  * until the next update. RPM set points are applied at a fixed control
+  * rate, mirroring the main loop calling VR_Emulator_SetRPM().
+  *
+  * Seeking: the emulator state only changes at RPM updates and by a fixed
+  * step per sample in between, so VR_HostSim_Seek() jumps one control
+  * interval (or one constant-RPM profile segment) at a time with
+  * VR_Emu_Skip() and renders only the last sample before the target.
+  * VR_HostSim_RunParallel() uses it to start every chunk of a long run in
+  * exactly the state a sequential run would reach there, renders the
+  * chunks on worker threads and hands them to the sink in order.
+  *
+  * VR_HostSim_SetShape() selects a tooth waveform table for every run
+  * started afterwards; VR_HostSim_LoadShape() reads one from a text file.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_host_sim.h"
+#include "vr_sensor_emulator.h"
+#include "vr_loopback.h"
+#include "vr_digital_output.h"
+#include "vr_ecu_capture.h"
+#include "vr_sample.h"
+#include "vr_revolution.h"
+#include "vr_vclock.h"
+#include "vr_qos.h"
+#include "vr_counters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Private define ------------------------------------------------------------*/
+#define HOST_SHAPE_FILE_MAX         (64u * 1024u)   // Largest shape file read
+
+/* Private variables ---------------------------------------------------------*/
+extern ADC_HandleTypeDef hadc1;
+extern ADC_HandleTypeDef hadc2;
+extern DAC_HandleTypeDef hdac;
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim6;
+
+static const VR_ToothShape_t *host_shape = NULL;  // Tooth waveform for new runs
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint16_t level;
+    uint32_t num_ticks;
+} HostSim_Hold_t;
+
+/* One chunk of a parallel run, rendered into its own buffer */
+typedef struct {
+    const VR_Profile_t *profile;
+    VR_HostSimCursor_t cursor;
+    uint64_t end_tick;
+    uint64_t duration_ticks;
+    uint32_t control_period_ticks;
+    uint64_t first_tick;            // Start of the first hold
+    HostSim_Hold_t *holds;
+    uint64_t num_holds;
+    uint64_t samples;
+    pthread_t thread;
+} HostSim_Chunk_t;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint64_t HostSim_Loop(VR_Emulator_t *emu, uint64_t *tick, uint64_t *next_control,
+                             const VR_Profile_t *profile, uint64_t end_tick, uint64_t duration_ticks,
+                             uint32_t control_period_ticks, VR_SampleSink_t sink, void *ctx);
+static bool HostSim_Control(VR_Emulator_t *emu, uint64_t tick, uint64_t *next_control,
+                            const VR_Profile_t *profile, uint32_t control_period_ticks);
+static uint64_t HostSim_FlatUntil(const VR_Profile_t *profile, uint64_t tick);
+static void *HostSim_ChunkMain(void *arg);
+static void HostSim_ChunkSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Parse an RPM profile of the form "t0:rpm0,t1:rpm1,..."
+  * @param  profile: Profile to fill
+  * @param  text: Comma separated time (s) and RPM pairs, times ascending;
+  *         a negative RPM turns the wheel backwards
+  * @retval True if the text is a valid profile, false otherwise
+  */
+bool VR_Profile_Parse(VR_Profile_t *profile, const char *text)
+{
+    const char *p = text;
+
+    profile->num_points = 0;
+
+    while (*p != '\0') {
+        char *end;
+        VR_ProfilePoint_t point;
+
+        if (profile->num_points >= VR_PROFILE_MAX_POINTS) {
+            return false;
+        }
+
+        point.time_s = strtod(p, &end);
+        if (end == p || *end != ':') {
+            return false;
+        }
+        p = end + 1;
+
+        point.rpm = strtof(p, &end);
+        if (end == p) {
+            return false;
+        }
+        p = end;
+
+        if (profile->num_points > 0 &&
+            point.time_s < profile->points[profile->num_points - 1].time_s) {
+            return false;
+        }
+
+        profile->points[profile->num_points++] = point;
+
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return false;
+        }
+    }
+
+    return profile->num_points > 0;
+}
+
+/**
+  * @brief  Evaluate the profile at a point in time
+  * @param  profile: RPM profile
+  * @param  time_s: Time in seconds
+  * @retval Interpolated RPM, held constant outside the profile
+  */
+float VR_Profile_RPMAt(const VR_Profile_t *profile, double time_s)
+{
+    const VR_ProfilePoint_t *pts = profile->points;
+    uint32_t n = profile->num_points;
+
+    if (time_s <= pts[0].time_s) {
+        return pts[0].rpm;
+    }
+    if (time_s >= pts[n - 1].time_s) {
+        return pts[n - 1].rpm;
+    }
+
+    // Profiles are short, a linear scan keeps this simple
+    uint32_t i = 1;
+    while (pts[i].time_s < time_s) {
+        i++;
+    }
+
+    double span = pts[i].time_s - pts[i - 1].time_s;
+    double frac = (span > 0.0) ? (time_s - pts[i - 1].time_s) / span : 1.0;
+
+    return (float)(pts[i - 1].rpm + (pts[i].rpm - pts[i - 1].rpm) * frac);
+}
+
+/**
+  * @brief  Get the time of the last profile point
+  * @param  profile: RPM profile
+  * @retval Duration in seconds
+  */
+double VR_Profile_Duration(const VR_Profile_t *profile)
+{
+    return profile->points[profile->num_points - 1].time_s;
+}
+
+/**
+  * @brief  Select the tooth waveform for runs started from now on
+  * @note   Set it before starting threads; the table must outlive the runs
+  * @param  shape: Valid tooth shape, or NULL for the built-in harmonic model
+  * @retval False if the shape is not valid; the built-in model is then used
+  */
+bool VR_HostSim_SetShape(const VR_ToothShape_t *shape)
+{
+    bool valid = (shape == NULL) || VR_Shape_IsValid(shape);
+
+    host_shape = valid ? shape : NULL;
+    return valid;
+}
+
+/**
+  * @brief  Read a tooth shape from a text file
+  * @note   Same text as the SHAPE command: "regular" and "missing" select
+  *         a table, numbers are levels from the DC level in DAC codes, and
+  *         '#' starts a comment
+  * @param  shape: Shape to fill
+  * @param  path: File to read
+  * @retval True if the file was read and both tables are valid
+  */
+bool VR_HostSim_LoadShape(VR_ToothShape_t *shape, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    VR_ShapeRegion_t region = VR_SHAPE_REGULAR;
+
+    if (file == NULL) {
+        return false;
+    }
+
+    char *text = malloc(HOST_SHAPE_FILE_MAX + 1);
+    size_t len = (text != NULL) ? fread(text, 1, HOST_SHAPE_FILE_MAX + 1, file) : 0;
+    bool ok = (text != NULL) && !ferror(file) && len <= HOST_SHAPE_FILE_MAX;
+    fclose(file);
+
+    if (ok) {
+        text[len] = '\0';
+        VR_Shape_Clear(shape);
+        ok = VR_Shape_Parse(shape, &region, text) && VR_Shape_IsValid(shape);
+    }
+
+    free(text);
+    return ok;
+}
+
+/**
+  * @brief  Run the emulator over an RPM profile on a virtual time base
+  * @param  profile: RPM profile to follow
+  * @param  duration_ticks: Length of the run in TIM6 ticks
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @param  sink: Receives every held DAC level in order
+  * @param  ctx: User context for the sink
+  * @retval Number of TIM6 update events (DAC samples) rendered
+  */
+uint64_t VR_HostSim_Run(const VR_Profile_t *profile, uint64_t duration_ticks,
+                        uint32_t control_period_ticks, VR_SampleSink_t sink, void *ctx)
+{
+    uint64_t tick = 0, next_control = 0;
+
+    htim6.Init.Period = 999;
+    VR_Emulator_Init();
+    VR_Emulator_SetShape(host_shape);
+
+    return HostSim_Loop(VR_Emulator_GetDefault(), &tick, &next_control, profile, duration_ticks,
+                        duration_ticks, control_period_ticks, sink, ctx);
+}
+
+/**
+  * @brief  Run a private, unbound emulator instance over an RPM profile
+  * @note   Touches no global state, so separate instances may run on
+  *         separate threads
+  * @param  emu: Instance to initialise and run
+  * @param  profile: RPM profile to follow
+  * @param  duration_ticks: Length of the run in TIM6 ticks
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @param  sink: Receives every held DAC level in order
+  * @param  ctx: User context for the sink
+  * @retval Number of update events (DAC samples) rendered
+  */
+uint64_t VR_HostSim_RunInstance(VR_Emulator_t *emu, const VR_Profile_t *profile, uint64_t duration_ticks,
+                                uint32_t control_period_ticks, VR_SampleSink_t sink, void *ctx)
+{
+    uint64_t tick = 0, next_control = 0;
+
+    VR_Emu_Init(emu, NULL);
+    VR_Emu_SetShape(emu, host_shape);
+
+    return HostSim_Loop(emu, &tick, &next_control, profile, duration_ticks,
+                        duration_ticks, control_period_ticks, sink, ctx);
+}
+
+/**
+  * @brief  Play a loaded scenario on a private, unbound emulator instance
+  * @note   The scenario sets the speed in place of a profile; the run
+  *         lasts its duration, and events land on the same updates as on
+  *         the target
+  * @param  emu: Instance to initialise and run
+  * @param  scenario: Player loaded with VR_Scenario_Load()
+  * @param  sink: Receives every held DAC level in order
+  * @param  ctx: User context for the sink
+  * @retval Number of update events (DAC samples) rendered
+  */
+uint64_t VR_HostSim_RunScenario(VR_Emulator_t *emu, VR_Scenario_t *scenario, VR_SampleSink_t sink, void *ctx)
+{
+    uint64_t tick = 0, samples = 0;
+    uint64_t duration_ticks = scenario->duration;
+
+    VR_Emu_Init(emu, NULL);
+    VR_Emu_SetShape(emu, host_shape);
+    VR_Scenario_Start(scenario, emu);
+
+    while (tick < duration_ticks) {
+        uint64_t period = VR_Emu_GetSamplePeriod(emu) / VR_SAMPLE_TICK_US;
+        uint64_t held = period;
+        if (tick + held > duration_ticks) {
+            held = duration_ticks - tick;
+        }
+
+        sink(ctx, VR_Emu_GetOutput(emu), tick, (uint32_t)held);
+        tick += held;
+
+        if (held == period) {
+            VR_Scenario_Sample(scenario, emu);
+            VR_Emu_TimerCallback(emu);
+            samples++;
+        }
+    }
+
+    VR_Scenario_Stop(scenario, emu);
+    return samples;
+}
+
+/**
+  * @brief  Place a cursor at the start of a run on a private, unbound instance
+  * @param  cursor: Cursor to initialise
+  * @retval None
+  */
+void VR_HostSim_CursorInit(VR_HostSimCursor_t *cursor)
+{
+    VR_Emu_Init(&cursor->emu, NULL);
+    VR_Emu_SetShape(&cursor->emu, host_shape);
+    cursor->tick = 0;
+    cursor->next_control = 0;
+}
+
+/**
+  * @brief  Move a cursor forward to the first held level starting at or after a tick
+  * @note   The result is exactly the state a sequential run has there. Work is
+  *         one step per control interval on ramps and one per segment where the
+  *         profile is constant, plus one rendered sample per step.
+  * @param  cursor: Cursor to move
+  * @param  profile: RPM profile of the run
+  * @param  target_tick: Tick to seek to
+  * @param  duration_ticks: Length of the run in TIM6 ticks
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @retval None
+  */
+void VR_HostSim_Seek(VR_HostSimCursor_t *cursor, const VR_Profile_t *profile, uint64_t target_tick,
+                     uint64_t duration_ticks, uint32_t control_period_ticks)
+{
+    VR_Emulator_t *emu = &cursor->emu;
+
+    if (target_tick > duration_ticks) {
+        target_tick = duration_ticks;
+    }
+
+    while (cursor->tick < target_tick) {
+        uint64_t tick = cursor->tick;
+        bool updated = HostSim_Control(emu, tick, &cursor->next_control, profile, control_period_ticks);
+        uint64_t period = VR_Emu_GetSamplePeriod(emu) / VR_SAMPLE_TICK_US;
+
+        // Holds starting before the limit see no RPM change: up to the next
+        // control tick, or to the end of a constant profile segment if the
+        // RPM was just read from the profile
+        uint64_t limit = cursor->next_control;
+        if (updated) {
+            uint64_t flat = HostSim_FlatUntil(profile, tick);
+            if (flat > limit) {
+                limit = flat;
+            }
+        }
+        if (limit > target_tick) {
+            limit = target_tick;
+        }
+
+        uint64_t holds = (limit - tick + period - 1) / period;
+        uint64_t last = tick + (holds - 1) * period;
+        uint64_t updates = holds;
+
+        // A final hold cut short by the end of the run has no update
+        if (last + period > duration_ticks) {
+            updates--;
+        }
+        if (updates > 0) {
+            VR_Emu_Skip(emu, updates - 1);
+            VR_Emu_TimerCallback(emu);
+        }
+
+        cursor->tick = (last + period > duration_ticks) ? duration_ticks : last + period;
+        cursor->next_control = (last / control_period_ticks + 1) * control_period_ticks;
+    }
+}
+
+/**
+  * @brief  Render the held levels that start before a tick
+  * @param  cursor: Cursor to render from, left after the last rendered hold
+  * @param  profile: RPM profile of the run
+  * @param  end_tick: Render holds starting before this tick (the last may extend past it)
+  * @param  duration_ticks: Length of the run in TIM6 ticks
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @param  sink: Receives every held DAC level in order
+  * @param  ctx: User context for the sink
+  * @retval Number of update events (DAC samples) rendered
+  */
+uint64_t VR_HostSim_Render(VR_HostSimCursor_t *cursor, const VR_Profile_t *profile, uint64_t end_tick,
+                           uint64_t duration_ticks, uint32_t control_period_ticks,
+                           VR_SampleSink_t sink, void *ctx)
+{
+    return HostSim_Loop(&cursor->emu, &cursor->tick, &cursor->next_control, profile, end_tick,
+                        duration_ticks, control_period_ticks, sink, ctx);
+}
+
+/**
+  * @brief  Render one run in chunks on several threads
+  * @note   The sink is called from the calling thread only, with exactly the
+  *         sequence of levels VR_HostSim_RunInstance() produces
+  * @param  profile: RPM profile to follow
+  * @param  duration_ticks: Length of the run in TIM6 ticks
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @param  threads: Chunks rendered at a time (1 to VR_HOST_MAX_THREADS)
+  * @param  chunk_ticks: Chunk length in ticks, 0 for VR_HOST_CHUNK_TICKS
+  * @param  sink: Receives every held DAC level in order
+  * @param  ctx: User context for the sink
+  * @retval Number of update events (DAC samples) rendered
+  */
+uint64_t VR_HostSim_RunParallel(const VR_Profile_t *profile, uint64_t duration_ticks,
+                                uint32_t control_period_ticks, uint32_t threads, uint64_t chunk_ticks,
+                                VR_SampleSink_t sink, void *ctx)
+{
+    HostSim_Chunk_t chunks[VR_HOST_MAX_THREADS];
+    VR_HostSimCursor_t seek;
+    uint64_t samples = 0;
+
+    if (chunk_ticks == 0) {
+        chunk_ticks = VR_HOST_CHUNK_TICKS;
+    }
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > VR_HOST_MAX_THREADS) {
+        threads = VR_HOST_MAX_THREADS;
+    }
+
+    // Holds start on distinct ticks, so a chunk has at most chunk_ticks of them
+    for (uint32_t i = 0; i < threads; i++) {
+        chunks[i].holds = malloc(chunk_ticks * sizeof(HostSim_Hold_t));
+        if (chunks[i].holds == NULL) {
+            for (uint32_t j = 0; j < i; j++) {
+                free(chunks[j].holds);
+            }
+            return 0;
+        }
+    }
+
+    VR_HostSim_CursorInit(&seek);
+
+    for (uint64_t start = 0; start < duration_ticks; start += threads * chunk_ticks) {
+        uint32_t count = 0;
+
+        // Chunk start states are found in order, which only costs the seeks
+        for (uint32_t i = 0; i < threads && start + i * chunk_ticks < duration_ticks; i++) {
+            HostSim_Chunk_t *chunk = &chunks[i];
+            uint64_t end = start + (i + 1) * chunk_ticks;
+
+            chunk->profile = profile;
+            chunk->end_tick = (end < duration_ticks) ? end : duration_ticks;
+            chunk->duration_ticks = duration_ticks;
+            chunk->control_period_ticks = control_period_ticks;
+            chunk->cursor = seek;
+            VR_HostSim_Seek(&seek, profile, chunk->end_tick, duration_ticks, control_period_ticks);
+            count++;
+        }
+
+        // Chunk 0 renders on this thread; a worker that cannot start runs here too
+        for (uint32_t i = 1; i < count; i++) {
+            if (pthread_create(&chunks[i].thread, NULL, HostSim_ChunkMain, &chunks[i]) != 0) {
+                chunks[i].thread = pthread_self();
+            }
+        }
+        HostSim_ChunkMain(&chunks[0]);
+        for (uint32_t i = 1; i < count; i++) {
+            if (pthread_equal(chunks[i].thread, pthread_self())) {
+                HostSim_ChunkMain(&chunks[i]);
+            } else {
+                pthread_join(chunks[i].thread, NULL);
+            }
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t tick = chunks[i].first_tick;
+
+            for (uint64_t h = 0; h < chunks[i].num_holds; h++) {
+                sink(ctx, chunks[i].holds[h].level, tick, chunks[i].holds[h].num_ticks);
+                tick += chunks[i].holds[h].num_ticks;
+            }
+            samples += chunks[i].samples;
+        }
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        free(chunks[i].holds);
+    }
+
+    return samples;
+}
+
+/**
+  * @brief  TIM6 update: the sample interrupt, then the PendSV bottom half
+  *         it pends, which runs as soon as the interrupt returns
+  * @param  htim: TIM handle
+  * @retval None
+  */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim == &htim6) {
+        VR_Sample_TopHalf();
+        VR_Sample_BottomHalf();
+    }
+}
+
+/**
+  * @brief  DAC DMA half transfer: the revolution or variable clock mode
+  *         sample interrupt, then the bottom half DMA1_Stream5_IRQHandler()
+  *         pends
+  * @param  hdac: DAC handle
+  * @retval None
+  */
+void HAL_DAC_ConvHalfCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+    if (VR_Vclk_IsEnabled()) {
+        VR_Vclk_TransferCallback(false);
+    } else {
+        VR_Rev_TransferCallback(false);
+    }
+    VR_Sample_BottomHalf();
+}
+
+/**
+  * @brief  DAC DMA transfer complete, as the half transfer above
+  * @param  hdac: DAC handle
+  * @retval None
+  */
+void HAL_DAC_ConvCpltCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+    if (VR_Vclk_IsEnabled()) {
+        VR_Vclk_TransferCallback(true);
+    } else {
+        VR_Rev_TransferCallback(true);
+    }
+    VR_Sample_BottomHalf();
+}
+
+/**
+  * @brief  DAC DMA underrun, as in main.c
+  * @param  hdac: DAC handle
+  * @retval None
+  */
+void HAL_DAC_DMAUnderrunCallbackCh1(DAC_HandleTypeDef *hdac)
+{
+    (void)hdac;
+    VR_QoS_DacUnderrun();
+}
+
+/**
+  * @brief  Capture DMA transfer complete callback, as in main.c
+  * @param  htim: TIM handle
+  * @retval None
+  */
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim != &htim2) {
+        return;
+    }
+    if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2) {
+        VR_Capture_TransferCompleteCallback(VR_CAPTURE_IGNITION);
+    } else if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_3) {
+        VR_Capture_TransferCompleteCallback(VR_CAPTURE_INJECTION);
+    }
+}
+
+/**
+  * @brief  Compare DMA half transfer callback, as in main.c
+  * @param  htim: TIM handle
+  * @retval None
+  */
+void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim == &htim2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_4) {
+        VR_Digital_TransferHalfCallback();
+    }
+}
+
+/**
+  * @brief  Compare DMA transfer complete callback, as in main.c
+  * @param  htim: TIM handle
+  * @retval None
+  */
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim == &htim2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_4) {
+        VR_Digital_TransferCompleteCallback();
+    }
+}
+
+/**
+  * @brief  ADC conversion sequence complete callback, as in main.c
+  * @param  hadc: ADC handle
+  * @retval None
+  */
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    if (hadc == &hadc1) {
+        VR_Counters_AdcUpdate();
+    } else if (hadc == &hadc2) {
+        VR_Loopback_CaptureCompleteCallback();
+    }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Step an initialised instance through the profile
+  * @param  emu: Emulator instance
+  * @param  tick: Start of the next hold, advanced past the last rendered hold
+  * @param  next_control: Tick of the next RPM update, advanced with tick
+  * @param  profile: RPM profile to follow
+  * @param  end_tick: Render holds starting before this tick
+  * @param  duration_ticks: Length of the run in TIM6 ticks
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @param  sink: Receives every held DAC level in order
+  * @param  ctx: User context for the sink
+  * @retval Number of update events (DAC samples) rendered
+  */
+static uint64_t HostSim_Loop(VR_Emulator_t *emu, uint64_t *tick, uint64_t *next_control,
+                             const VR_Profile_t *profile, uint64_t end_tick, uint64_t duration_ticks,
+                             uint32_t control_period_ticks, VR_SampleSink_t sink, void *ctx)
+{
+    uint64_t samples = 0;
+
+    if (end_tick > duration_ticks) {
+        end_tick = duration_ticks;
+    }
+
+    while (*tick < end_tick) {
+        HostSim_Control(emu, *tick, next_control, profile, control_period_ticks);
+
+        // The current level is held until the next update event, whose
+        // period follows the instance's (real or virtual) sample timer
+        uint64_t period = VR_Emu_GetSamplePeriod(emu) / VR_SAMPLE_TICK_US;
+        uint64_t held = period;
+        if (*tick + held > duration_ticks) {
+            held = duration_ticks - *tick;
+        }
+
+        sink(ctx, VR_Emu_GetOutput(emu), *tick, (uint32_t)held);
+        *tick += held;
+
+        if (held == period) {
+            VR_Emu_TimerCallback(emu);
+            samples++;
+        }
+    }
+
+    return samples;
+}
+
+/**
+  * @brief  Apply the profile RPM if a control tick has been reached
+  * @param  emu: Emulator instance
+  * @param  tick: Current tick
+  * @param  next_control: Tick of the next RPM update, advanced past tick
+  * @param  profile: RPM profile to follow
+  * @param  control_period_ticks: Interval between RPM updates in ticks
+  * @retval True if the RPM was read from the profile at this tick
+  */
+static bool HostSim_Control(VR_Emulator_t *emu, uint64_t tick, uint64_t *next_control,
+                            const VR_Profile_t *profile, uint32_t control_period_ticks)
+{
+    if (tick < *next_control) {
+        return false;
+    }
+
+    float rpm = VR_Profile_RPMAt(profile, (double)tick / VR_SAMPLE_TIMER_BASE_FREQ);
+    int32_t target = (rpm < 0.0f) ? -(int32_t)(0.5f - rpm) : (int32_t)(rpm + 0.5f);
+
+    if (target != VR_Emu_GetSpeed(emu)) {
+        VR_Emu_SetSpeed(emu, target);
+    }
+    while (*next_control <= tick) {
+        *next_control += control_period_ticks;
+    }
+
+    return true;
+}
+
+/**
+  * @brief  Find how long the profile keeps the RPM it has at a tick
+  * @param  profile: RPM profile
+  * @param  tick: Start tick
+  * @retval First tick at which the RPM may differ, tick itself on a ramp,
+  *         UINT64_MAX if it never changes
+  */
+static uint64_t HostSim_FlatUntil(const VR_Profile_t *profile, uint64_t tick)
+{
+    const VR_ProfilePoint_t *pts = profile->points;
+    uint32_t n = profile->num_points;
+    double t = (double)tick / VR_SAMPLE_TIMER_BASE_FREQ;
+    uint32_t i = 0;
+
+    // Index of the first point after t; before the first point the RPM is
+    // held at its value, as if a flat segment led up to it
+    while (i < n && pts[i].time_s <= t) {
+        i++;
+    }
+    if (i == n) {
+        return UINT64_MAX;
+    }
+    if (i > 0 && pts[i - 1].rpm != pts[i].rpm) {
+        return tick;
+    }
+
+    // Extend over following points with the same RPM
+    while (i + 1 < n && pts[i + 1].rpm == pts[i].rpm) {
+        i++;
+    }
+    if (i + 1 == n) {
+        return UINT64_MAX;
+    }
+
+    // VR_Profile_RPMAt() is still flat at exactly pts[i].time_s; find the
+    // first tick whose time, computed the same way, lies beyond it
+    double end = pts[i].time_s;
+    uint64_t limit = (uint64_t)(end * VR_SAMPLE_TIMER_BASE_FREQ);
+
+    while (limit > tick && (double)(limit - 1) / VR_SAMPLE_TIMER_BASE_FREQ > end) {
+        limit--;
+    }
+    while ((double)limit / VR_SAMPLE_TIMER_BASE_FREQ <= end) {
+        limit++;
+    }
+
+    return limit;
+}
+
+/**
+  * @brief  Render one chunk into its buffer (worker thread entry)
+  * @param  arg: HostSim_Chunk_t
+  * @retval NULL
+  */
+static void *HostSim_ChunkMain(void *arg)
+{
+    HostSim_Chunk_t *chunk = (HostSim_Chunk_t *)arg;
+
+    chunk->first_tick = chunk->cursor.tick;
+    chunk->num_holds = 0;
+    chunk->samples = VR_HostSim_Render(&chunk->cursor, chunk->profile, chunk->end_tick,
+                                       chunk->duration_ticks, chunk->control_period_ticks,
+                                       HostSim_ChunkSink, chunk);
+
+    return NULL;
+}
+
+/**
+  * @brief  Sample sink appending to a chunk buffer
+  * @param  ctx: HostSim_Chunk_t
+  * @param  dac_value: DAC level
+  * @param  start_tick: First tick of the hold (implied by the order)
+  * @param  num_ticks: Ticks the level is held
+  * @retval None
+  */
+static void HostSim_ChunkSink(void *ctx, uint16_t dac_value, uint64_t start_tick, uint32_t num_ticks)
+{
+    HostSim_Chunk_t *chunk = (HostSim_Chunk_t *)ctx;
+
+    (void)start_tick;
+
+    chunk->holds[chunk->num_holds].level = dac_value;
+    chunk->holds[chunk->num_holds].num_ticks = num_ticks;
+    chunk->num_holds++;
+}
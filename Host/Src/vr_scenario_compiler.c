@@ -0,0 +1,393 @@
+/**
+  ******************************************************************************
+  * @file           : vr_scenario_compiler.c
+  * @brief          : Scenario text compiler
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * One event per line, the time in seconds from the start first; '#'
+  * starts a comment and keywords are case-insensitive:
+  *
+  *   0      rpm 800              # Speed, negative turns the wheel backwards
+  *   0.5    ramp 3000 1.5        # Linear to 3000 RPM over 1.5 s
+  *   2      shape 1              # Waveform table 1, "model" for the built-in one
+  *   2.5    fault dropout 0.05   # Fault window, dropout or spike, 50 ms long
+  *   3      gain 50              # Amplitude, % of the waveform as rendered
+  *   3.2    noise 40 7           # +/-40 LSB of noise from seed 7 (default 1)
+  *   5      end                  # End of the run
+  *
+  * Lines may come in any order. Events are sorted by time, those at the
+  * same time keep the order of their lines, and a fault window ends
+  * before anything else at its end time, so windows may touch but not
+  * overlap. Without "end" the run ends with its last event, ramp or
+  * fault window.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_scenario_compiler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Private define ------------------------------------------------------------*/
+#define COMPILER_LINE_MAX           256
+#define COMPILER_MAX_WORDS          5
+#define COMPILER_MAX_SECONDS        ((double)UINT32_MAX / VR_SAMPLE_TIMER_BASE_FREQ)
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    VR_ScenarioEvent_t event;
+    uint32_t line;
+    uint32_t order;                 // Position in the file, window ends first
+} Compiler_Entry_t;
+
+typedef struct {
+    Compiler_Entry_t *entries;
+    uint32_t count;
+    uint32_t end_tick;              // Latest tick any line reaches
+    bool has_end;
+    uint32_t duration;              // From "end"
+    VR_ScenarioError_t *error;
+} Compiler_t;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool Compiler_Line(Compiler_t *c, char *text, uint32_t line);
+static bool Compiler_Add(Compiler_t *c, uint32_t line, uint32_t tick, uint8_t kind, uint8_t arg,
+                         int32_t value, uint32_t span);
+static bool Compiler_Ticks(const char *word, uint32_t *ticks);
+static bool Compiler_Integer(const char *word, long min, long max, long *value);
+static int Compiler_Order(const void *a, const void *b);
+static bool Compiler_Fail(VR_ScenarioError_t *error, uint32_t line, const char *message);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Compile scenario text into an image
+  * @param  text: Scenario, one event per line
+  * @param  image: Receives the image; 4-byte aligned as the firmware reads it
+  * @param  capacity: Image buffer size in bytes
+  * @param  size: Receives the image size in bytes
+  * @param  error: Receives the line and reason on failure
+  * @retval True if the scenario compiled
+  */
+bool VR_Scenario_Compile(const char *text, uint32_t *image, uint32_t capacity, uint32_t *size,
+                         VR_ScenarioError_t *error)
+{
+    Compiler_t c = {0};
+    uint32_t line = 0;
+    bool ok = true;
+
+    error->line = 0;
+    error->message = NULL;
+    c.error = error;
+    c.entries = malloc(VR_SCENARIO_MAX_EVENTS * sizeof(Compiler_Entry_t));
+    if (c.entries == NULL) {
+        return Compiler_Fail(error, 0, "out of memory");
+    }
+
+    while (ok && *text != '\0') {
+        char buffer[COMPILER_LINE_MAX];
+        size_t len = strcspn(text, "\n");
+
+        line++;
+        if (len >= sizeof(buffer)) {
+            ok = Compiler_Fail(error, line, "line too long");
+            break;
+        }
+        memcpy(buffer, text, len);
+        buffer[len] = '\0';
+        text += len;
+        if (*text == '\n') {
+            text++;
+        }
+        ok = Compiler_Line(&c, buffer, line);
+    }
+
+    if (ok && c.has_end) {
+        if (c.end_tick > c.duration) {
+            ok = Compiler_Fail(error, 0, "events after the end");
+        }
+    } else {
+        c.duration = c.end_tick;
+    }
+
+    if (ok) {
+        qsort(c.entries, c.count, sizeof(Compiler_Entry_t), Compiler_Order);
+
+        // Windows may touch but not overlap, as each end clears the fault
+        bool open = false;
+        for (uint32_t i = 0; ok && i < c.count; i++) {
+            const VR_ScenarioEvent_t *event = &c.entries[i].event;
+            if (event->kind == VR_SCENARIO_FAULT) {
+                if (event->arg != VR_FAULT_NONE && open) {
+                    ok = Compiler_Fail(error, c.entries[i].line, "fault windows overlap");
+                }
+                open = (event->arg != VR_FAULT_NONE);
+            }
+        }
+    }
+
+    if (ok && VR_SCENARIO_IMAGE_SIZE(c.count) > capacity) {
+        ok = Compiler_Fail(error, 0, "image buffer too small");
+    }
+
+    if (ok) {
+        VR_ScenarioHeader_t *header = (VR_ScenarioHeader_t *)image;
+        VR_ScenarioEvent_t *events = (VR_ScenarioEvent_t *)(header + 1);
+
+        header->magic = VR_SCENARIO_MAGIC;
+        header->version = VR_SCENARIO_VERSION;
+        header->count = (uint16_t)c.count;
+        header->duration = c.duration;
+        for (uint32_t i = 0; i < c.count; i++) {
+            events[i] = c.entries[i].event;
+        }
+        *size = (uint32_t)VR_SCENARIO_IMAGE_SIZE(c.count);
+    }
+
+    free(c.entries);
+    return ok;
+}
+
+/**
+  * @brief  Compile a scenario file into an image
+  * @param  path: Scenario text file
+  * @param  image: Receives the image
+  * @param  capacity: Image buffer size in bytes
+  * @param  size: Receives the image size in bytes
+  * @param  error: Receives the line and reason on failure
+  * @retval True if the file was read and compiled
+  */
+bool VR_Scenario_CompileFile(const char *path, uint32_t *image, uint32_t capacity, uint32_t *size,
+                             VR_ScenarioError_t *error)
+{
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        return Compiler_Fail(error, 0, "cannot open file");
+    }
+
+    char *text = malloc(VR_SCENARIO_TEXT_MAX + 1);
+    size_t len = (text != NULL) ? fread(text, 1, VR_SCENARIO_TEXT_MAX + 1, file) : 0;
+    bool ok = (text != NULL) && !ferror(file) && len <= VR_SCENARIO_TEXT_MAX;
+    fclose(file);
+
+    if (ok) {
+        text[len] = '\0';
+        ok = VR_Scenario_Compile(text, image, capacity, size, error);
+    } else {
+        Compiler_Fail(error, 0, "cannot read file");
+    }
+
+    free(text);
+    return ok;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Compile one line into events
+  * @param  c: Compiler state
+  * @param  text: Line without its newline; modified
+  * @param  line: Line number
+  * @retval False on an error
+  */
+static bool Compiler_Line(Compiler_t *c, char *text, uint32_t line)
+{
+    char *words[COMPILER_MAX_WORDS];
+    uint32_t n = 0;
+    char *save = NULL;
+
+    text[strcspn(text, "#\r")] = '\0';
+    for (char *word = strtok_r(text, " \t", &save); word != NULL; word = strtok_r(NULL, " \t", &save)) {
+        if (n == COMPILER_MAX_WORDS) {
+            return Compiler_Fail(c->error, line, "too many words");
+        }
+        words[n++] = word;
+    }
+    if (n == 0) {
+        return true;
+    }
+
+    uint32_t tick, span;
+    long value;
+    if (n < 2 || !Compiler_Ticks(words[0], &tick)) {
+        return Compiler_Fail(c->error, line, "expected a time and an event");
+    }
+    const char *kind = words[1];
+
+    if (strcasecmp(kind, "end") == 0 && n == 2) {
+        if (c->has_end) {
+            return Compiler_Fail(c->error, line, "second end");
+        }
+        c->has_end = true;
+        c->duration = tick;
+        return true;
+    }
+    if (strcasecmp(kind, "rpm") == 0 && n == 3) {
+        if (!Compiler_Integer(words[2], -MAX_RPM, MAX_RPM, &value)) {
+            return Compiler_Fail(c->error, line, "bad RPM");
+        }
+        return Compiler_Add(c, line, tick, VR_SCENARIO_SPEED, 0, value, 0);
+    }
+    if (strcasecmp(kind, "ramp") == 0 && n == 4) {
+        if (!Compiler_Integer(words[2], -MAX_RPM, MAX_RPM, &value)) {
+            return Compiler_Fail(c->error, line, "bad RPM");
+        }
+        if (!Compiler_Ticks(words[3], &span) || span == 0 || tick + (uint64_t)span > UINT32_MAX) {
+            return Compiler_Fail(c->error, line, "bad ramp time");
+        }
+        return Compiler_Add(c, line, tick, VR_SCENARIO_RAMP, 0, value, span) &&
+               Compiler_Add(c, line, tick + span, VR_SCENARIO_KINDS, 0, 0, 0);
+    }
+    if (strcasecmp(kind, "shape") == 0 && n == 3) {
+        if (strcasecmp(words[2], "model") == 0) {
+            value = 0;
+        } else if (!Compiler_Integer(words[2], 1, VR_SCENARIO_MAX_SHAPES, &value)) {
+            return Compiler_Fail(c->error, line, "bad shape table");
+        }
+        return Compiler_Add(c, line, tick, VR_SCENARIO_SHAPE, (uint8_t)value, 0, 0);
+    }
+    if (strcasecmp(kind, "fault") == 0 && n == 4) {
+        uint8_t fault;
+        if (strcasecmp(words[2], "dropout") == 0) {
+            fault = VR_FAULT_DROPOUT;
+        } else if (strcasecmp(words[2], "spike") == 0) {
+            fault = VR_FAULT_SPIKE;
+        } else {
+            return Compiler_Fail(c->error, line, "bad fault, dropout or spike");
+        }
+        if (!Compiler_Ticks(words[3], &span) || span == 0 || tick + (uint64_t)span > UINT32_MAX) {
+            return Compiler_Fail(c->error, line, "bad fault time");
+        }
+        return Compiler_Add(c, line, tick, VR_SCENARIO_FAULT, fault, 0, 0) &&
+               Compiler_Add(c, line, tick + span, VR_SCENARIO_FAULT, VR_FAULT_NONE, 0, 0);
+    }
+    if (strcasecmp(kind, "gain") == 0 && n == 3) {
+        if (!Compiler_Integer(words[2], 0, 100, &value)) {
+            return Compiler_Fail(c->error, line, "bad gain percentage");
+        }
+        return Compiler_Add(c, line, tick, VR_SCENARIO_GAIN, 0, (value * VR_AMPLITUDE_FULL + 50) / 100, 0);
+    }
+    if (strcasecmp(kind, "noise") == 0 && (n == 3 || n == 4)) {
+        long seed = VR_NOISE_DEFAULT_SEED;
+        if (!Compiler_Integer(words[2], 0, VR_NOISE_MAX_LSB, &value) ||
+            (n == 4 && !Compiler_Integer(words[3], 1, UINT32_MAX, &seed))) {
+            return Compiler_Fail(c->error, line, "bad noise level or seed");
+        }
+        return Compiler_Add(c, line, tick, VR_SCENARIO_NOISE, 0, value, (uint32_t)seed);
+    }
+
+    return Compiler_Fail(c->error, line, "unknown event");
+}
+
+/**
+  * @brief  Append one event
+  * @note   VR_SCENARIO_KINDS marks only where a ramp ends, for the duration
+  * @param  c: Compiler state
+  * @param  line: Line it came from
+  * @param  tick: Time in TIM6 ticks
+  * @param  kind: VR_ScenarioKind_t
+  * @param  arg: Event argument
+  * @param  value: Event value
+  * @param  span: Event span
+  * @retval False if the scenario is full
+  */
+static bool Compiler_Add(Compiler_t *c, uint32_t line, uint32_t tick, uint8_t kind, uint8_t arg,
+                         int32_t value, uint32_t span)
+{
+    if (tick > c->end_tick) {
+        c->end_tick = tick;
+    }
+    if (kind == VR_SCENARIO_KINDS) {
+        return true;
+    }
+    if (c->count == VR_SCENARIO_MAX_EVENTS) {
+        return Compiler_Fail(c->error, line, "too many events");
+    }
+
+    Compiler_Entry_t *entry = &c->entries[c->count];
+    entry->event = (VR_ScenarioEvent_t){tick, span, (int16_t)value, kind, arg};
+    entry->line = line;
+    entry->order = (kind == VR_SCENARIO_FAULT && arg == VR_FAULT_NONE) ? 0 : c->count + 1;
+    c->count++;
+    return true;
+}
+
+/**
+  * @brief  Convert a time in seconds to TIM6 ticks
+  * @param  word: Non-negative decimal seconds
+  * @param  ticks: Receives the nearest tick
+  * @retval False if not a number or out of range
+  */
+static bool Compiler_Ticks(const char *word, uint32_t *ticks)
+{
+    char *end;
+    double seconds = strtod(word, &end);
+
+    if (end == word || *end != '\0' || !(seconds >= 0.0) || seconds > COMPILER_MAX_SECONDS) {
+        return false;
+    }
+    *ticks = (uint32_t)llround(seconds * VR_SAMPLE_TIMER_BASE_FREQ);
+    return true;
+}
+
+/**
+  * @brief  Read a decimal integer within limits
+  * @param  word: Text
+  * @param  min: Smallest value allowed
+  * @param  max: Largest value allowed
+  * @param  value: Receives the value
+  * @retval False if not an integer or out of range
+  */
+static bool Compiler_Integer(const char *word, long min, long max, long *value)
+{
+    char *end;
+    long v = strtol(word, &end, 10);
+
+    if (end == word || *end != '\0' || v < min || v > max) {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+/**
+  * @brief  qsort order: by tick, then window ends, then file order
+  * @param  a: Compiler_Entry_t
+  * @param  b: Compiler_Entry_t
+  * @retval Negative, zero or positive
+  */
+static int Compiler_Order(const void *a, const void *b)
+{
+    const Compiler_Entry_t *x = (const Compiler_Entry_t *)a;
+    const Compiler_Entry_t *y = (const Compiler_Entry_t *)b;
+
+    if (x->event.tick != y->event.tick) {
+        return (x->event.tick < y->event.tick) ? -1 : 1;
+    }
+    if (x->order != y->order) {
+        return (x->order < y->order) ? -1 : 1;
+    }
+    return (x->line < y->line) ? -1 : (x->line > y->line);
+}
+
+/**
+  * @brief  Record an error
+  * @param  error: Error to fill
+  * @param  line: Line number, 0 for the scenario as a whole
+  * @param  message: Reason
+  * @retval False, for returning directly
+  */
+static bool Compiler_Fail(VR_ScenarioError_t *error, uint32_t line, const char *message)
+{
+    error->line = line;
+    error->message = message;
+    return false;
+}
@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file           : vr_scenario_main.c
+  * @brief          : Command line front end for the scenario compiler
+  ******************************************************************************
+  * @attention
+  *
+  * Host simulator for VR Sensor Emulator
+  *
+  * Usage: vr_scenario SCENARIO [-o IMAGE] [-u]
+  *
+  *   -o  Write the compiled image
+  *   -u  Print the SCN command lines that upload and start the image
+  *       over USART3
+  *
+  * Example: vr_scenario stall.scn -u > stall.txt
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "vr_scenario_compiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Private define ------------------------------------------------------------*/
+#define UPLOAD_BYTES_PER_LINE       64      // 128 hex digits, within VR_COMMAND_LINE_MAX
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t image[VR_SCENARIO_IMAGE_MAX / sizeof(uint32_t)];
+
+/* Private function prototypes -----------------------------------------------*/
+static void Print_Upload(const uint8_t *bytes, uint32_t size);
+static void Print_Usage(const char *prog);
+
+/**
+  * @brief  Compiler entry point
+  * @retval Process exit code
+  */
+int main(int argc, char *argv[])
+{
+    const char *out_path = NULL;
+    bool upload = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:uh")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'u': upload = true; break;
+        default:
+            Print_Usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (optind != argc - 1) {
+        Print_Usage(argv[0]);
+        return 2;
+    }
+
+    const char *path = argv[optind];
+    VR_ScenarioError_t error;
+    uint32_t size;
+
+    if (!VR_Scenario_CompileFile(path, image, sizeof(image), &size, &error)) {
+        fprintf(stderr, "%s:%lu: %s\n", path, (unsigned long)error.line, error.message);
+        return 1;
+    }
+
+    const VR_ScenarioHeader_t *header = (const VR_ScenarioHeader_t *)image;
+    fprintf(upload ? stderr : stdout, "%s: %u events, %.3f s, %lu bytes\n", path, header->count,
+            (double)header->duration / VR_SAMPLE_TIMER_BASE_FREQ, (unsigned long)size);
+
+    if (out_path != NULL) {
+        FILE *file = fopen(out_path, "wb");
+        bool ok = (file != NULL) && fwrite(image, 1, size, file) == size;
+
+        if (file != NULL && fclose(file) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Write error on '%s'\n", out_path);
+            return 1;
+        }
+    }
+
+    if (upload) {
+        Print_Upload((const uint8_t *)image, size);
+    }
+    return 0;
+}
+
+/**
+  * @brief  Print the image as SCN upload commands
+  * @param  bytes: Image
+  * @param  size: Image size in bytes
+  * @retval None
+  */
+static void Print_Upload(const uint8_t *bytes, uint32_t size)
+{
+    printf("SCN BEGIN\n");
+    for (uint32_t i = 0; i < size; i += UPLOAD_BYTES_PER_LINE) {
+        printf("SCN D ");
+        for (uint32_t j = i; j < size && j < i + UPLOAD_BYTES_PER_LINE; j++) {
+            printf("%02X", bytes[j]);
+        }
+        printf("\n");
+    }
+    printf("SCN START\n");
+}
+
+/**
+  * @brief  Print command line help
+  * @param  prog: Program name
+  * @retval None
+  */
+static void Print_Usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s SCENARIO [-o IMAGE] [-u]\n"
+            "  SCENARIO  One timed event per line: rpm, ramp, shape, fault, gain, noise, end\n"
+            "  -o        Write the compiled image\n"
+            "  -u        Print the SCN commands that upload and start it\n",
+            prog);
+}